@@ -10,7 +10,613 @@
 
 #include "CAN_STM32F1xx.h"
 
-#include <math.h>
+#include <string.h>
+
+/*****************************************************************************
+ * @defgroup Private types and variables of CAN.
+ * @{
+ */
+
+#define CAN1_TX_QUEUE_ENABLE                                                   \
+    (CAN1_ENABLE && CAN1_ENABLE_TX_IT && (CAN1_TX_QUEUE_SIZE > 0))
+#define CAN2_TX_QUEUE_ENABLE                                                   \
+    (CAN2_ENABLE && CAN2_ENABLE_TX_IT && (CAN2_TX_QUEUE_SIZE > 0))
+
+#define CAN1_RX0_RING_ENABLE                                                   \
+    (CAN1_ENABLE && CAN1_ENABLE_RX0_IT && (CAN1_RX0_RING_SIZE > 0))
+#define CAN1_RX1_RING_ENABLE                                                   \
+    (CAN1_ENABLE && CAN1_ENABLE_RX1_IT && (CAN1_RX1_RING_SIZE > 0))
+#define CAN2_RX0_RING_ENABLE                                                   \
+    (CAN2_ENABLE && CAN2_ENABLE_RX0_IT && (CAN2_RX0_RING_SIZE > 0))
+#define CAN2_RX1_RING_ENABLE                                                   \
+    (CAN2_ENABLE && CAN2_ENABLE_RX1_IT && (CAN2_RX1_RING_SIZE > 0))
+
+#define CAN_RX_RING_ENABLE                                                     \
+    (CAN1_RX0_RING_ENABLE || CAN1_RX1_RING_ENABLE || CAN2_RX0_RING_ENABLE ||   \
+     CAN2_RX1_RING_ENABLE)
+
+#define CAN_DISPATCH_IRQ (CAN_DISPATCH_ENABLE && CAN_DISPATCH_IN_ISR)
+
+/* Read the frames from FIFO in receive interrupt, even without ring. */
+#define CAN_RX_IRQ_HOOK                                                        \
+    (CAN_DISPATCH_IRQ || CAN_ISOTP_ENABLE || CAN_GATEWAY_ENABLE ||             \
+     CAN_J1939_ENABLE || CAN_RESPOND_ENABLE)
+
+/* Read the frames from FIFO in receive interrupt. */
+#define CAN_RX_IRQ_ENABLE (CAN_RX_RING_ENABLE || CAN_RX_IRQ_HOOK)
+
+#define CAN1_TIME_ENABLE  (CAN1_ENABLE && CAN1_TTCM)
+#define CAN2_TIME_ENABLE  (CAN2_ENABLE && CAN2_TTCM)
+#define CAN_TIME_ENABLE   (CAN1_TIME_ENABLE || CAN2_TIME_ENABLE)
+
+/* CAN2 needs CAN1, so `CAN1_STATS_ENABLE` also guards the common code. */
+#define CAN1_STATS_ENABLE (CAN1_ENABLE && CAN_STATS_ENABLE)
+#define CAN2_STATS_ENABLE (CAN2_ENABLE && CAN_STATS_ENABLE)
+
+/* Software bus-off recovery, `can_recovery_poll()`. */
+#define CAN_RECOVERY_ENABLE (CAN1_ENABLE && (CAN_BUS_OFF_RECOVERY == 2))
+
+/* Any CAN with transmit interrupt. */
+#define CAN_TX_IT_ENABLE                                                       \
+    ((CAN1_ENABLE && CAN1_ENABLE_TX_IT) || (CAN2_ENABLE && CAN2_ENABLE_TX_IT))
+
+/* Any CAN with status change and error interrupt. */
+#define CAN_SCE_IT_ENABLE                                                      \
+    ((CAN1_ENABLE && CAN1_ENABLE_SCE_IT) ||                                    \
+     (CAN2_ENABLE && CAN2_ENABLE_SCE_IT))
+
+/* The hardware time stamp counter is 16 bits. */
+#define CAN_TIME_PERIOD 0x10000U
+/* Allowed delay between the capture of time stamp and extend it, it must be
+ * far longer than the interrupt latency plus one tick. Unit: bit time. */
+#define CAN_TIME_MARGIN 0x4000U
+
+/**
+ * @brief Entry of CAN software transmit queue.
+ */
+typedef struct {
+    uint32_t key;      /*!< ID word (`CAN_ID_WORD_xxx()`), the smaller is
+                            the higher arbitration priority.             */
+    uint32_t seq;      /*!< Push sequence, keep the order of same key.   */
+    uint32_t time;     /*!< Time stamp when pushed, valid in TTCM.       */
+    can_frame_t frame; /*!< The frame to send.                           */
+} can_tx_entry_t;
+
+/**
+ * @brief Software transmit queue of CAN, a binary min-heap keyed on
+ *        arbitration priority.
+ */
+typedef struct {
+    can_tx_entry_t *heap;          /*!< The storage area of heap, it has 3
+                                        more places for aborted frames.  */
+    uint16_t size;                 /*!< Maximum frames can be pushed.    */
+    uint8_t preempt;               /*!< Abort lower priority mailbox.    */
+    uint8_t mailbox_used;          /*!< Mailboxes loaded from queue.     */
+    uint8_t mailbox_abort;         /*!< Mailboxes requested to abort.    */
+    uint8_t paused;                /*!< Do not load mailboxes, bus-off.  */
+    uint32_t seq;                  /*!< Next push sequence.              */
+    can_tx_entry_t mailbox[3];     /*!< Frames in mailboxes.             */
+    can_tx_queue_stats_t stats;    /*!< Statistics, `depth` is the number
+                                        of frames in heap.               */
+} can_tx_queue_t;
+
+#if CAN1_TX_QUEUE_ENABLE
+static can_tx_entry_t can1_tx_queue_buf[CAN1_TX_QUEUE_SIZE + 3];
+static can_tx_queue_t can1_tx_queue = {.heap = can1_tx_queue_buf,
+                                       .size = CAN1_TX_QUEUE_SIZE,
+                                       .preempt = CAN1_TX_PREEMPT};
+#endif /* CAN1_TX_QUEUE_ENABLE */
+
+#if CAN2_TX_QUEUE_ENABLE
+static can_tx_entry_t can2_tx_queue_buf[CAN2_TX_QUEUE_SIZE + 3];
+static can_tx_queue_t can2_tx_queue = {.heap = can2_tx_queue_buf,
+                                       .size = CAN2_TX_QUEUE_SIZE,
+                                       .preempt = CAN2_TX_PREEMPT};
+#endif /* CAN2_TX_QUEUE_ENABLE */
+
+/**
+ * @brief Software receive ring of CAN FIFO. Single producer (receive
+ *        interrupt) and single consumer (`can_receive_batch()`), no lock.
+ */
+typedef struct {
+    can_frame_t *frames;        /*!< The storage area of ring, one place is
+                                     always empty.                       */
+    uint16_t size;              /*!< Size of `frames`.                   */
+    volatile uint16_t head;     /*!< Next place to write, only ISR.      */
+    volatile uint16_t tail;     /*!< Next place to read, only reader.    */
+    volatile uint32_t dropped;  /*!< Frames dropped because ring is full. */
+} can_rx_ring_t;
+
+#if CAN1_RX0_RING_ENABLE
+static can_frame_t can1_rx0_ring_buf[CAN1_RX0_RING_SIZE + 1];
+static can_rx_ring_t can1_rx0_ring = {.frames = can1_rx0_ring_buf,
+                                      .size = CAN1_RX0_RING_SIZE + 1};
+#endif /* CAN1_RX0_RING_ENABLE */
+
+#if CAN1_RX1_RING_ENABLE
+static can_frame_t can1_rx1_ring_buf[CAN1_RX1_RING_SIZE + 1];
+static can_rx_ring_t can1_rx1_ring = {.frames = can1_rx1_ring_buf,
+                                      .size = CAN1_RX1_RING_SIZE + 1};
+#endif /* CAN1_RX1_RING_ENABLE */
+
+#if CAN2_RX0_RING_ENABLE
+static can_frame_t can2_rx0_ring_buf[CAN2_RX0_RING_SIZE + 1];
+static can_rx_ring_t can2_rx0_ring = {.frames = can2_rx0_ring_buf,
+                                      .size = CAN2_RX0_RING_SIZE + 1};
+#endif /* CAN2_RX0_RING_ENABLE */
+
+#if CAN2_RX1_RING_ENABLE
+static can_frame_t can2_rx1_ring_buf[CAN2_RX1_RING_SIZE + 1];
+static can_rx_ring_t can2_rx1_ring = {.frames = can2_rx1_ring_buf,
+                                      .size = CAN2_RX1_RING_SIZE + 1};
+#endif /* CAN2_RX1_RING_ENABLE */
+
+/**
+ * @brief Time stamp extension of CAN in Time Triggered Communication Mode.
+ *        The hardware counter is 16 bits and counts CAN bit time, the wraps
+ *        are recovered by `HAL_GetTick()`, so it still works if the bus is
+ *        idle for more than one period.
+ */
+typedef struct {
+    uint64_t last;                /*!< The latest extended time stamp.   */
+    uint32_t last_tick;           /*!< `HAL_GetTick()` of `last`.        */
+    uint32_t bits_per_ms;         /*!< Baud rate. Unit: Kbps.            */
+    can_latency_stats_t latency;  /*!< Transmit latency statistics.      */
+} can_time_t;
+
+#if CAN1_TIME_ENABLE
+static can_time_t can1_time;
+#endif /* CAN1_TIME_ENABLE */
+
+#if CAN2_TIME_ENABLE
+static can_time_t can2_time;
+#endif /* CAN2_TIME_ENABLE */
+
+/**
+ * @brief Bus statistics of CAN.
+ */
+typedef struct {
+    can_bus_stats_t stats;      /*!< Statistics reported.                */
+    uint32_t window_tick;       /*!< `HAL_GetTick()` of window start.    */
+    uint32_t rx_frames;         /*!< Frames received in this window.     */
+    uint32_t tx_frames;         /*!< Frames transmitted in this window.  */
+    uint32_t rx_bits;           /*!< Bits received in this window.       */
+    uint32_t tx_bits;           /*!< Bits transmitted in this window.    */
+    uint32_t bits_per_ms;       /*!< Baud rate. Unit: Kbps.              */
+} can_stats_t;
+
+#if CAN1_STATS_ENABLE
+static can_stats_t can1_stats;
+#endif /* CAN1_STATS_ENABLE */
+
+#if CAN2_STATS_ENABLE
+static can_stats_t can2_stats;
+#endif /* CAN2_STATS_ENABLE */
+
+/* Length of rate window. Unit: ms. */
+#define CAN_STATS_WINDOW 1000U
+
+/**
+ * @brief Software bus-off recovery of CAN.
+ */
+typedef struct {
+    volatile uint8_t state;   /*!< `CAN_RECOVER_xxx`.                   */
+    uint8_t attempt;          /*!< Failed recoveries, doubles backoff.  */
+    uint32_t deadline;        /*!< `HAL_GetTick()` to start recovery.   */
+    uint32_t recovered_tick;  /*!< `HAL_GetTick()` of last recovered.   */
+} can_recovery_t;
+
+#if CAN_RECOVERY_ENABLE
+static can_recovery_t can1_recovery;
+#endif /* CAN_RECOVERY_ENABLE */
+
+#if CAN_RECOVERY_ENABLE && CAN2_ENABLE
+static can_recovery_t can2_recovery;
+#endif /* CAN_RECOVERY_ENABLE && CAN2_ENABLE */
+
+#if CAN_ISOTP_ENABLE
+
+/* State of ISO-TP transfer. */
+#define CAN_ISOTP_IDLE      0 /*!< No transfer.                         */
+#define CAN_ISOTP_WAIT_FC   1 /*!< Sent FF or a block, wait for FC.     */
+#define CAN_ISOTP_SENDING   2 /*!< Sending consecutive frames.          */
+#define CAN_ISOTP_RECEIVING 3 /*!< Receiving consecutive frames.        */
+
+/* Frame type, high nibble of protocol control information byte. */
+#define CAN_ISOTP_PCI_SF 0x00 /*!< Single frame.                        */
+#define CAN_ISOTP_PCI_FF 0x10 /*!< First frame.                         */
+#define CAN_ISOTP_PCI_CF 0x20 /*!< Consecutive frame.                   */
+#define CAN_ISOTP_PCI_FC 0x30 /*!< Flow control.                        */
+
+/* Flow status of flow control frame. */
+#define CAN_ISOTP_FS_CTS   0  /*!< Continue to send.                    */
+#define CAN_ISOTP_FS_WAIT  1  /*!< Wait for the next flow control.      */
+#define CAN_ISOTP_FS_OVFLW 2  /*!< Overflow, abort.                     */
+
+/* The maximum message length of 12-bit first frame. */
+#define CAN_ISOTP_FF_DL_MAX 4095U
+
+/**
+ * @brief ISO-TP channel.
+ */
+typedef struct {
+    can_isotp_config_t config;  /*!< Configuration, set by open.         */
+    uint8_t opened;             /*!< Channel is opened.                  */
+
+    volatile uint8_t tx_state;  /*!< `CAN_ISOTP_xxx` of transmission.    */
+    uint8_t tx_sn;              /*!< Next sequence number.               */
+    uint8_t tx_bs;              /*!< Block size from receiver.           */
+    uint8_t tx_bs_left;         /*!< Frames left in this block.          */
+    uint8_t tx_st_min;          /*!< STmin from receiver. Unit: ms.      */
+    const uint8_t *tx_data;     /*!< Message to send, not copied.        */
+    uint32_t tx_len;            /*!< Length of message.                  */
+    uint32_t tx_pos;            /*!< Bytes sent.                         */
+    uint32_t tx_tick;           /*!< `HAL_GetTick()` of last activity.   */
+
+    volatile uint8_t rx_state;  /*!< `CAN_ISOTP_xxx` of reception.       */
+    uint8_t rx_sn;              /*!< Expected sequence number.           */
+    uint8_t rx_bs_left;         /*!< Frames left before next FC.         */
+    uint32_t rx_len;            /*!< Length of message.                  */
+    uint32_t rx_pos;            /*!< Bytes received.                     */
+    uint32_t rx_tick;           /*!< `HAL_GetTick()` of last activity.   */
+} can_isotp_t;
+
+static can_isotp_t can_isotp[CAN_ISOTP_CHANNELS];
+
+#endif /* CAN_ISOTP_ENABLE */
+
+#if CAN_GATEWAY_ENABLE
+
+/**
+ * @brief Routing table of gateway.
+ */
+typedef struct {
+    can_gateway_route_t route[CAN_GATEWAY_ROUTES]; /*!< Routes.          */
+    can_gateway_stats_t stats[CAN_GATEWAY_ROUTES]; /*!< Counters.        */
+    volatile uint32_t count;                       /*!< Routes used.     */
+} can_gateway_t;
+
+static can_gateway_t can_gateway;
+
+#endif /* CAN_GATEWAY_ENABLE */
+
+#if CAN_SCHED_ENABLE
+
+/**
+ * @brief Entry of cyclic scheduler.
+ */
+typedef struct {
+    can_sched_entry_t entry;    /*!< The message.                          */
+    uint32_t period;            /*!< Period in ticks.                      */
+    uint32_t offset;            /*!< Phase in ticks, `0 - (period - 1)`.   */
+    uint32_t next;              /*!< Tick of next send.                    */
+    uint32_t last_cycles;       /*!< `DWT->CYCCNT` of last send.           */
+    can_sched_stats_t stats;    /*!< Period and jitter statistics.         */
+} can_sched_slot_t;
+
+/**
+ * @brief Schedule table of cyclic scheduler.
+ */
+typedef struct {
+    can_sched_slot_t slot[CAN_SCHED_SIZE]; /*!< Entries.                  */
+    volatile uint32_t count;               /*!< Entries used.             */
+    uint32_t tick;                         /*!< Ticks since init.         */
+    uint32_t cycles_per_us;                /*!< Core clock in MHz.        */
+} can_sched_t;
+
+static can_sched_t can_sched;
+
+#endif /* CAN_SCHED_ENABLE */
+
+#if CAN_CHANGE_ENABLE
+
+/**
+ * @brief Cached payload of ID in change filter.
+ */
+typedef struct {
+    uint32_t key;               /*!< ID, bit 31 is set for extended ID.    */
+    uint32_t timeout;           /*!< Deliver timeout, 0 means never.       */
+    uint32_t tick;              /*!< `HAL_GetTick()` of last delivered.    */
+    uint8_t dlc;                /*!< Length of last delivered payload.     */
+    uint8_t data[8];            /*!< Last delivered payload.               */
+} can_change_slot_t;
+
+/**
+ * @brief Change filter of CAN.
+ */
+typedef struct {
+    can_change_slot_t slot[CAN_CHANGE_SIZE]; /*!< IDs, sorted by key.     */
+    uint32_t count;                          /*!< IDs used.               */
+    can_change_stats_t stats;                /*!< Counters.               */
+    volatile uint8_t ready;                  /*!< Table is built.         */
+} can_change_t;
+
+#if CAN1_ENABLE
+static can_change_t can1_change;
+#endif /* CAN1_ENABLE */
+
+#if CAN2_ENABLE
+static can_change_t can2_change;
+#endif /* CAN2_ENABLE */
+
+#endif /* CAN_CHANGE_ENABLE */
+
+#if CAN_RESPOND_ENABLE
+
+/**
+ * @brief ID of remote frame responder.
+ */
+typedef struct {
+    uint32_t key;               /*!< ID word without `RTR`.                */
+    uint8_t dlc;                /*!< Length of answered payload.           */
+    const uint8_t *data;        /*!< Current payload.                      */
+} can_respond_slot_t;
+
+/**
+ * @brief Remote frame responder of CAN.
+ */
+typedef struct {
+    can_respond_slot_t slot[CAN_RESPOND_SIZE]; /*!< IDs, sorted by key.   */
+    uint32_t count;                            /*!< IDs used.             */
+    can_respond_stats_t stats;                 /*!< Counters.             */
+    volatile uint8_t ready;                    /*!< Table is built.       */
+} can_respond_t;
+
+#if CAN1_ENABLE
+static can_respond_t can1_respond;
+#endif /* CAN1_ENABLE */
+
+#if CAN2_ENABLE
+static can_respond_t can2_respond;
+#endif /* CAN2_ENABLE */
+
+#endif /* CAN_RESPOND_ENABLE */
+
+#if CAN_J1939_ENABLE
+
+/* PGNs of network management and transport protocol. */
+#define CAN_J1939_PGN_REQUEST 0xEA00U /*!< Request.                     */
+#define CAN_J1939_PGN_CLAIM   0xEE00U /*!< Address claimed.             */
+#define CAN_J1939_PGN_TP_CM   0xEC00U /*!< Transport connection manage. */
+#define CAN_J1939_PGN_TP_DT   0xEB00U /*!< Transport data transfer.     */
+
+/* Control byte of TP.CM. */
+#define CAN_J1939_CM_RTS   16  /*!< Request to send.                    */
+#define CAN_J1939_CM_CTS   17  /*!< Clear to send.                      */
+#define CAN_J1939_CM_EOMA  19  /*!< End of message acknowledge.         */
+#define CAN_J1939_CM_BAM   32  /*!< Broadcast announce message.         */
+#define CAN_J1939_CM_ABORT 255 /*!< Connection abort.                   */
+
+/* Reason of connection abort. */
+#define CAN_J1939_ABORT_BUSY     1 /*!< Already in a session.           */
+#define CAN_J1939_ABORT_RESOURCE 2 /*!< No resources.                   */
+#define CAN_J1939_ABORT_TIMEOUT  3 /*!< Timeout.                        */
+#define CAN_J1939_ABORT_SEQUENCE 7 /*!< Bad sequence number.            */
+
+/* Timeouts of J1939-21. Unit: ms. */
+#define CAN_J1939_T1 750  /*!< Receiver, between data packets.          */
+#define CAN_J1939_T2 1250 /*!< Receiver, after CTS.                     */
+#define CAN_J1939_T3 1250 /*!< Sender, waiting for CTS or EOMA.         */
+#define CAN_J1939_T4 1050 /*!< Sender, after CTS to hold connection.    */
+
+/* The minimum time between BAM data packets. Unit: ms. */
+#define CAN_J1939_BAM_GAP   50
+/* Wait after address claim before other messages. Unit: ms. */
+#define CAN_J1939_CLAIM_WAIT 250
+/* The maximum message length of transport protocol. */
+#define CAN_J1939_TP_MAX    1785U
+
+/* State of address claim. */
+#define CAN_J1939_CLAIMING 0 /*!< Address claim sent, waiting.          */
+#define CAN_J1939_CLAIMED  1 /*!< Address is ours.                      */
+#define CAN_J1939_LOST     2 /*!< No address, cannot claim sent.        */
+
+/* State of transport session. */
+#define CAN_J1939_TP_IDLE     0 /*!< No transfer.                       */
+#define CAN_J1939_TP_BAM      1 /*!< Sending or receiving BAM.          */
+#define CAN_J1939_TP_WAIT_CTS 2 /*!< Sent RTS or a window, wait for CTS. */
+#define CAN_J1939_TP_SENDING  3 /*!< Sending the data of CTS window.    */
+#define CAN_J1939_TP_WAIT_END 4 /*!< Sent all data, wait for EOMA.      */
+#define CAN_J1939_TP_CMDT     5 /*!< Receiving connection mode data.    */
+
+/**
+ * @brief Transport session of J1939.
+ */
+typedef struct {
+    volatile uint8_t state;     /*!< `CAN_J1939_TP_xxx`.                 */
+    uint8_t peer;               /*!< Address of the other node.          */
+    uint8_t priority;           /*!< Priority of sent message.           */
+    uint8_t packets;            /*!< Number of data packets.             */
+    uint8_t next;               /*!< Next sequence number, from 1.       */
+    uint8_t window_end;         /*!< Last sequence number of CTS window. */
+    uint8_t window_max;         /*!< Maximum packets of CTS window.      */
+    uint32_t pgn;               /*!< PGN of message.                     */
+    uint32_t len;               /*!< Length of message.                  */
+    uint32_t tick;              /*!< `HAL_GetTick()` of last activity.   */
+    uint32_t timeout;           /*!< Timeout from `tick`. Unit: ms.      */
+    const uint8_t *tx_data;     /*!< Message to send, not copied.        */
+} can_j1939_session_t;
+
+/**
+ * @brief J1939 node.
+ */
+typedef struct {
+    can_j1939_config_t config;  /*!< Configuration, set by init.         */
+    uint32_t pgn[CAN_J1939_PGNS]; /*!< PGNs of handlers, sorted.         */
+    can_j1939_handler_t handler[CAN_J1939_PGNS]; /*!< Handlers.          */
+    uint32_t pgn_count;         /*!< Number of `pgn`.                    */
+    volatile uint8_t ready;     /*!< Node is initialized.                */
+    volatile uint8_t claim;     /*!< `CAN_J1939_CLAIMING` etc.           */
+    uint8_t address;            /*!< Address claimed or claiming.        */
+    uint32_t claim_tick;        /*!< `HAL_GetTick()` of address claim.   */
+    uint32_t used[8];           /*!< Addresses claimed by other nodes.   */
+    can_j1939_session_t tx;     /*!< Transmit session.                   */
+    can_j1939_session_t rx[CAN_J1939_RX_SESSIONS]; /*!< Receive sessions. */
+    /* Message buffer of receive sessions. */
+    uint8_t rx_buf[CAN_J1939_RX_SESSIONS][CAN_J1939_RX_SIZE];
+} can_j1939_t;
+
+static can_j1939_t can_j1939;
+
+#endif /* CAN_J1939_ENABLE */
+
+#ifdef CAN2
+/* Connectivity line, CAN1 and CAN2 share 28 filter banks. */
+#define CAN_FILTER_BANK_NUM 28
+#else /* CAN2 */
+#define CAN_FILTER_BANK_NUM 14
+#endif /* CAN2 */
+
+/* Kind of filter bank. */
+#define CAN_FILTER_KIND_16_LIST 0 /*!< 4 standard IDs.                  */
+#define CAN_FILTER_KIND_16_MASK 1 /*!< 2 standard ID masks.             */
+#define CAN_FILTER_KIND_32_LIST 2 /*!< 2 extended IDs.                  */
+#define CAN_FILTER_KIND_32_MASK 3 /*!< 1 extended ID mask.              */
+
+/**
+ * @brief Allocated CAN filter bank.
+ */
+typedef struct {
+    uint32_t fr1;  /*!< Value of `FxR1` register.                       */
+    uint32_t fr2;  /*!< Value of `FxR2` register.                       */
+    uint8_t kind;  /*!< `CAN_FILTER_KIND_xxx`.                           */
+    uint8_t fifo;  /*!< `CAN_FILTER_FIFO0` or `CAN_FILTER_FIFO1`.        */
+    uint8_t used;  /*!< Slots used.                                     */
+} can_filter_bank_t;
+
+/**
+ * @brief Filter banks allocation of CAN1 and CAN2.
+ */
+typedef struct {
+    can_filter_bank_t bank[CAN_FILTER_BANK_NUM]; /*!< Filter banks.      */
+    uint8_t count;                               /*!< Banks used.        */
+    uint8_t slave_start;                         /*!< First bank of CAN2. */
+} can_filter_table_t;
+
+/* The filter banks allocation applied now. */
+static can_filter_table_t can_filter_table;
+
+/* The hardware is same as `can_filter_table`, cleared by `canx_init()`. */
+static uint8_t can_filter_synced;
+
+/* The wanted IDs of CAN1 and CAN2, for changing at runtime. */
+static can_filter_id_t can_filter_ids[2][CAN_FILTER_IDS];
+static uint32_t can_filter_id_count[2];
+
+/* Slots number of each kind of filter bank. */
+static const uint8_t can_filter_kind_slots[4] = {4, 2, 2, 1};
+
+#if CAN_DISPATCH_ENABLE
+
+/**
+ * @brief Receive dispatch table of CAN.
+ */
+typedef struct {
+    can_rx_handler_t handler[CAN_DISPATCH_SIZE]; /*!< Handlers, index is
+                                                      slot - 1.          */
+    uint32_t ext_id[CAN_DISPATCH_SIZE];   /*!< Extended IDs, sorted.     */
+    uint8_t ext_slot[CAN_DISPATCH_SIZE];  /*!< Slot of `ext_id`.         */
+    uint8_t ext_count;                    /*!< Number of `ext_id`.       */
+    uint8_t std_slot[0x800];              /*!< Slot of standard ID, 0
+                                               means no handler.         */
+    uint8_t fmi_slot[2][CAN_FILTER_BANK_NUM * 4]; /*!< Slot of filter
+                                                       match index.      */
+    can_rx_handler_t default_handler;     /*!< Handler of other IDs.     */
+    volatile uint8_t ready;               /*!< Table is built.           */
+} can_dispatch_t;
+
+#if CAN1_ENABLE
+static can_dispatch_t can1_dispatch;
+#endif /* CAN1_ENABLE */
+
+#if CAN2_ENABLE
+static can_dispatch_t can2_dispatch;
+#endif /* CAN2_ENABLE */
+
+#endif /* CAN_DISPATCH_ENABLE */
+
+/**
+ * @}
+ */
+
+/*****************************************************************************
+ * @defgroup Private functions of CAN.
+ * @{
+ */
+
+static uint8_t can_tx_write(CAN_HandleTypeDef *can_handle, uint32_t id_word,
+                            const can_frame_t *frame, uint32_t *mailbox);
+static uint8_t can_send_frame(can_selected_t can_selected, uint32_t id_word,
+                              const can_frame_t *frame);
+
+#if CAN1_TX_QUEUE_ENABLE || CAN2_TX_QUEUE_ENABLE
+static void can_tx_queue_reset(can_tx_queue_t *tx_queue);
+static void can_tx_queue_irq_handler(CAN_HandleTypeDef *can_handle,
+                                     can_tx_queue_t *tx_queue);
+#endif /* CAN1_TX_QUEUE_ENABLE || CAN2_TX_QUEUE_ENABLE */
+
+#if CAN_RX_RING_ENABLE
+static void can_rx_ring_reset(can_rx_ring_t *rx_ring);
+#endif /* CAN_RX_RING_ENABLE */
+
+#if CAN_TIME_ENABLE
+static void can_time_reset(can_time_t *time, uint32_t baud_rate);
+#endif /* CAN_TIME_ENABLE */
+
+#if CAN1_STATS_ENABLE
+static void can_stats_reset(can_stats_t *can_stats, uint32_t baud_rate);
+#endif /* CAN1_STATS_ENABLE */
+
+#if CAN1_STATS_ENABLE && CAN_TX_IT_ENABLE
+static void can_stats_tx_irq(CAN_HandleTypeDef *can_handle,
+                             can_stats_t *can_stats);
+#endif /* CAN1_STATS_ENABLE && CAN_TX_IT_ENABLE */
+
+#if CAN1_STATS_ENABLE && CAN_SCE_IT_ENABLE
+static void can_stats_sce_irq(CAN_HandleTypeDef *can_handle,
+                              can_stats_t *can_stats);
+#endif /* CAN1_STATS_ENABLE && CAN_SCE_IT_ENABLE */
+
+#if CAN_RECOVERY_ENABLE && CAN_SCE_IT_ENABLE
+static void can_recovery_sce_irq(CAN_HandleTypeDef *can_handle,
+                                 can_recovery_t *recovery);
+#endif /* CAN_RECOVERY_ENABLE && CAN_SCE_IT_ENABLE */
+
+#if CAN_ISOTP_ENABLE
+static uint8_t can_isotp_rx_frame(can_selected_t can_selected,
+                                  const can_frame_t *frame);
+static void can_isotp_tx_irq(can_selected_t can_selected);
+#endif /* CAN_ISOTP_ENABLE */
+
+#if CAN_GATEWAY_ENABLE
+static uint8_t can_gateway_rx_frame(can_selected_t can_selected,
+                                    const can_frame_t *frame);
+#endif /* CAN_GATEWAY_ENABLE */
+
+#if CAN_CHANGE_ENABLE
+static uint8_t can_change_rx_frame(can_selected_t can_selected,
+                                   const can_frame_t *frame);
+#endif /* CAN_CHANGE_ENABLE */
+
+#if CAN_RESPOND_ENABLE
+static uint8_t can_respond_rx_frame(can_selected_t can_selected,
+                                    const can_frame_t *frame);
+#endif /* CAN_RESPOND_ENABLE */
+
+#if CAN_J1939_ENABLE
+static uint8_t can_j1939_rx_frame(can_selected_t can_selected,
+                                  const can_frame_t *frame);
+static void can_j1939_tx_irq(can_selected_t can_selected);
+#endif /* CAN_J1939_ENABLE */
+
+#if CAN_RX_IRQ_ENABLE
+static void can_rx_irq_handler(CAN_HandleTypeDef *can_handle, uint32_t rx_fifo,
+                               can_rx_ring_t *rx_ring);
+#endif /* CAN_RX_IRQ_ENABLE */
+
+/**
+ * @}
+ */
 
 /*****************************************************************************
  * @defgroup CAN1 Functions.
@@ -21,8 +627,12 @@
 
 CAN_HandleTypeDef can1_handle = {.Instance = CAN1,
                                  .Init = {.Mode = CAN_MODE_NORMAL,
-                                          .TimeTriggeredMode = DISABLE,
-                                          .AutoBusOff = DISABLE,
+                                          .TimeTriggeredMode =
+                                              CAN1_TTCM ? ENABLE : DISABLE,
+                                          .AutoBusOff =
+                                              (CAN_BUS_OFF_RECOVERY == 1)
+                                                  ? ENABLE
+                                                  : DISABLE,
                                           .AutoWakeUp = DISABLE,
                                           .AutoRetransmission = ENABLE,
                                           .ReceiveFifoLocked = DISABLE,
@@ -74,7 +684,8 @@ uint8_t can1_init(uint32_t baud_rate, uint32_t prop_delay) {
     can_filter_config.FilterMaskIdHigh = 0x0000;
     can_filter_config.FilterMaskIdLow = 0x0000;
     can_filter_config.FilterActivation = CAN_FILTER_ENABLE;
-    can_filter_config.SlaveStartFilterBank = 0;
+    /* CAN2SB must be 1-27, the banks from it belong to CAN2. */
+    can_filter_config.SlaveStartFilterBank = CAN_FILTER_BANK_NUM / 2;
 
 #if CAN1_ENABLE_RX0_IT
     can_filter_config.FilterFIFOAssignment = CAN_FILTER_FIFO0;
@@ -98,6 +709,49 @@ uint8_t can1_init(uint32_t baud_rate, uint32_t prop_delay) {
     }
 #endif /* CAN1_ENABLE_RX1_IT */
 
+    /* The accept-all filter is not in the shadow table. */
+    can_filter_synced = 0;
+
+#if CAN1_ENABLE_TX_IT
+    if (HAL_CAN_ActivateNotification(&can1_handle,
+                                     CAN_IT_TX_MAILBOX_EMPTY) != HAL_OK) {
+        return CAN_INIT_NOTIFY_FAIL;
+    }
+#endif /* CAN1_ENABLE_TX_IT */
+
+#if CAN1_ENABLE_SCE_IT
+    if (HAL_CAN_ActivateNotification(
+            &can1_handle, CAN_IT_ERROR_WARNING | CAN_IT_ERROR_PASSIVE |
+                              CAN_IT_BUSOFF | CAN_IT_LAST_ERROR_CODE |
+                              CAN_IT_ERROR) != HAL_OK) {
+        return CAN_INIT_NOTIFY_FAIL;
+    }
+#endif /* CAN1_ENABLE_SCE_IT */
+
+#if CAN1_TX_QUEUE_ENABLE
+    can_tx_queue_reset(&can1_tx_queue);
+#endif /* CAN1_TX_QUEUE_ENABLE */
+
+#if CAN1_RX0_RING_ENABLE
+    can_rx_ring_reset(&can1_rx0_ring);
+#endif /* CAN1_RX0_RING_ENABLE */
+
+#if CAN1_RX1_RING_ENABLE
+    can_rx_ring_reset(&can1_rx1_ring);
+#endif /* CAN1_RX1_RING_ENABLE */
+
+#if CAN1_TIME_ENABLE
+    can_time_reset(&can1_time, baud_rate);
+#endif /* CAN1_TIME_ENABLE */
+
+#if CAN1_STATS_ENABLE
+    can_stats_reset(&can1_stats, baud_rate);
+#endif /* CAN1_STATS_ENABLE */
+
+#if CAN_RECOVERY_ENABLE
+    memset(&can1_recovery, 0, sizeof(can_recovery_t));
+#endif /* CAN_RECOVERY_ENABLE */
+
     if (HAL_CAN_Start(&can1_handle) != HAL_OK) {
         return CAN_INIT_START_FAIL;
     }
@@ -112,7 +766,24 @@ uint8_t can1_init(uint32_t baud_rate, uint32_t prop_delay) {
  *
  */
 void CAN1_TX_IRQHandler(void) {
+#if CAN1_STATS_ENABLE
+    can_stats_tx_irq(&can1_handle, &can1_stats);
+#endif /* CAN1_STATS_ENABLE */
+
+#if CAN1_TX_QUEUE_ENABLE
+    can_tx_queue_irq_handler(&can1_handle, &can1_tx_queue);
+#else  /* CAN1_TX_QUEUE_ENABLE */
     HAL_CAN_IRQHandler(&can1_handle);
+#endif /* CAN1_TX_QUEUE_ENABLE */
+
+#if CAN_ISOTP_ENABLE
+    /* Load the next consecutive frames into the free mailboxes. */
+    can_isotp_tx_irq(can1_selected);
+#endif /* CAN_ISOTP_ENABLE */
+
+#if CAN_J1939_ENABLE
+    can_j1939_tx_irq(can1_selected);
+#endif /* CAN_J1939_ENABLE */
 }
 
 #endif /* CAN1_ENABLE_TX_IT */
@@ -124,6 +795,12 @@ void CAN1_TX_IRQHandler(void) {
  *
  */
 void CAN1_RX0_IRQHandler(void) {
+#if CAN1_RX0_RING_ENABLE
+    can_rx_irq_handler(&can1_handle, CAN_RX_FIFO0, &can1_rx0_ring);
+#elif CAN_RX_IRQ_HOOK
+    can_rx_irq_handler(&can1_handle, CAN_RX_FIFO0, NULL);
+#endif /* CAN1_RX0_RING_ENABLE */
+
     HAL_CAN_IRQHandler(&can1_handle);
 }
 
@@ -136,6 +813,12 @@ void CAN1_RX0_IRQHandler(void) {
  *
  */
 void CAN1_RX1_IRQHandler(void) {
+#if CAN1_RX1_RING_ENABLE
+    can_rx_irq_handler(&can1_handle, CAN_RX_FIFO1, &can1_rx1_ring);
+#elif CAN_RX_IRQ_HOOK
+    can_rx_irq_handler(&can1_handle, CAN_RX_FIFO1, NULL);
+#endif /* CAN1_RX1_RING_ENABLE */
+
     HAL_CAN_IRQHandler(&can1_handle);
 }
 
@@ -148,6 +831,14 @@ void CAN1_RX1_IRQHandler(void) {
  *
  */
 void CAN1_SCE_IRQHandler(void) {
+#if CAN1_STATS_ENABLE
+    can_stats_sce_irq(&can1_handle, &can1_stats);
+#endif /* CAN1_STATS_ENABLE */
+
+#if CAN_RECOVERY_ENABLE
+    can_recovery_sce_irq(&can1_handle, &can1_recovery);
+#endif /* CAN_RECOVERY_ENABLE */
+
     HAL_CAN_IRQHandler(&can1_handle);
 }
 
@@ -174,6 +865,18 @@ uint8_t can1_deinit(void) {
         return CAN_DEINIT_FAIL;
     }
 
+#if CAN1_TX_QUEUE_ENABLE
+    can_tx_queue_reset(&can1_tx_queue);
+#endif /* CAN1_TX_QUEUE_ENABLE */
+
+#if CAN1_RX0_RING_ENABLE
+    can_rx_ring_reset(&can1_rx0_ring);
+#endif /* CAN1_RX0_RING_ENABLE */
+
+#if CAN1_RX1_RING_ENABLE
+    can_rx_ring_reset(&can1_rx1_ring);
+#endif /* CAN1_RX1_RING_ENABLE */
+
     return CAN_DEINIT_OK;
 }
 
@@ -191,8 +894,12 @@ uint8_t can1_deinit(void) {
 
 CAN_HandleTypeDef can2_handle = {.Instance = CAN2,
                                  .Init = {.Mode = CAN_MODE_NORMAL,
-                                          .TimeTriggeredMode = DISABLE,
-                                          .AutoBusOff = DISABLE,
+                                          .TimeTriggeredMode =
+                                              CAN2_TTCM ? ENABLE : DISABLE,
+                                          .AutoBusOff =
+                                              (CAN_BUS_OFF_RECOVERY == 1)
+                                                  ? ENABLE
+                                                  : DISABLE,
                                           .AutoWakeUp = DISABLE,
                                           .AutoRetransmission = ENABLE,
                                           .ReceiveFifoLocked = DISABLE,
@@ -236,7 +943,7 @@ uint8_t can2_init(uint32_t baud_rate, uint32_t prop_delay) {
 
     CAN_FilterTypeDef can_filter_config;
 
-    can_filter_config.FilterBank = 0;
+    can_filter_config.FilterBank = CAN_FILTER_BANK_NUM / 2;
     can_filter_config.FilterMode = CAN_FILTERMODE_IDMASK;
     can_filter_config.FilterScale = CAN_FILTERSCALE_32BIT;
     can_filter_config.FilterIdHigh = 0x0000;
@@ -244,7 +951,8 @@ uint8_t can2_init(uint32_t baud_rate, uint32_t prop_delay) {
     can_filter_config.FilterMaskIdHigh = 0x0000;
     can_filter_config.FilterMaskIdLow = 0x0000;
     can_filter_config.FilterActivation = CAN_FILTER_ENABLE;
-    can_filter_config.SlaveStartFilterBank = 0;
+    /* The first bank of CAN2, same split as `can1_init()`. */
+    can_filter_config.SlaveStartFilterBank = CAN_FILTER_BANK_NUM / 2;
 
 #if CAN2_ENABLE_RX0_IT
     can_filter_config.FilterFIFOAssignment = CAN_FILTER_FIFO0;
@@ -268,6 +976,49 @@ uint8_t can2_init(uint32_t baud_rate, uint32_t prop_delay) {
     }
 #endif /* CAN2_ENABLE_RX1_IT */
 
+    /* The accept-all filter is not in the shadow table. */
+    can_filter_synced = 0;
+
+#if CAN2_ENABLE_TX_IT
+    if (HAL_CAN_ActivateNotification(&can2_handle,
+                                     CAN_IT_TX_MAILBOX_EMPTY) != HAL_OK) {
+        return CAN_INIT_NOTIFY_FAIL;
+    }
+#endif /* CAN2_ENABLE_TX_IT */
+
+#if CAN2_ENABLE_SCE_IT
+    if (HAL_CAN_ActivateNotification(
+            &can2_handle, CAN_IT_ERROR_WARNING | CAN_IT_ERROR_PASSIVE |
+                              CAN_IT_BUSOFF | CAN_IT_LAST_ERROR_CODE |
+                              CAN_IT_ERROR) != HAL_OK) {
+        return CAN_INIT_NOTIFY_FAIL;
+    }
+#endif /* CAN2_ENABLE_SCE_IT */
+
+#if CAN2_TX_QUEUE_ENABLE
+    can_tx_queue_reset(&can2_tx_queue);
+#endif /* CAN2_TX_QUEUE_ENABLE */
+
+#if CAN2_RX0_RING_ENABLE
+    can_rx_ring_reset(&can2_rx0_ring);
+#endif /* CAN2_RX0_RING_ENABLE */
+
+#if CAN2_RX1_RING_ENABLE
+    can_rx_ring_reset(&can2_rx1_ring);
+#endif /* CAN2_RX1_RING_ENABLE */
+
+#if CAN2_TIME_ENABLE
+    can_time_reset(&can2_time, baud_rate);
+#endif /* CAN2_TIME_ENABLE */
+
+#if CAN2_STATS_ENABLE
+    can_stats_reset(&can2_stats, baud_rate);
+#endif /* CAN2_STATS_ENABLE */
+
+#if CAN_RECOVERY_ENABLE
+    memset(&can2_recovery, 0, sizeof(can_recovery_t));
+#endif /* CAN_RECOVERY_ENABLE */
+
     if (HAL_CAN_Start(&can2_handle) != HAL_OK) {
         return CAN_INIT_START_FAIL;
     }
@@ -282,7 +1033,24 @@ uint8_t can2_init(uint32_t baud_rate, uint32_t prop_delay) {
  *
  */
 void CAN2_TX_IRQHandler(void) {
+#if CAN2_STATS_ENABLE
+    can_stats_tx_irq(&can2_handle, &can2_stats);
+#endif /* CAN2_STATS_ENABLE */
+
+#if CAN2_TX_QUEUE_ENABLE
+    can_tx_queue_irq_handler(&can2_handle, &can2_tx_queue);
+#else  /* CAN2_TX_QUEUE_ENABLE */
     HAL_CAN_IRQHandler(&can2_handle);
+#endif /* CAN2_TX_QUEUE_ENABLE */
+
+#if CAN_ISOTP_ENABLE
+    /* Load the next consecutive frames into the free mailboxes. */
+    can_isotp_tx_irq(can2_selected);
+#endif /* CAN_ISOTP_ENABLE */
+
+#if CAN_J1939_ENABLE
+    can_j1939_tx_irq(can2_selected);
+#endif /* CAN_J1939_ENABLE */
 }
 
 #endif /* CAN2_ENABLE_TX_IT */
@@ -294,6 +1062,12 @@ void CAN2_TX_IRQHandler(void) {
  *
  */
 void CAN2_RX0_IRQHandler(void) {
+#if CAN2_RX0_RING_ENABLE
+    can_rx_irq_handler(&can2_handle, CAN_RX_FIFO0, &can2_rx0_ring);
+#elif CAN_RX_IRQ_HOOK
+    can_rx_irq_handler(&can2_handle, CAN_RX_FIFO0, NULL);
+#endif /* CAN2_RX0_RING_ENABLE */
+
     HAL_CAN_IRQHandler(&can2_handle);
 }
 
@@ -306,6 +1080,12 @@ void CAN2_RX0_IRQHandler(void) {
  *
  */
 void CAN2_RX1_IRQHandler(void) {
+#if CAN2_RX1_RING_ENABLE
+    can_rx_irq_handler(&can2_handle, CAN_RX_FIFO1, &can2_rx1_ring);
+#elif CAN_RX_IRQ_HOOK
+    can_rx_irq_handler(&can2_handle, CAN_RX_FIFO1, NULL);
+#endif /* CAN2_RX1_RING_ENABLE */
+
     HAL_CAN_IRQHandler(&can2_handle);
 }
 
@@ -318,6 +1098,14 @@ void CAN2_RX1_IRQHandler(void) {
  *
  */
 void CAN2_SCE_IRQHandler(void) {
+#if CAN2_STATS_ENABLE
+    can_stats_sce_irq(&can2_handle, &can2_stats);
+#endif /* CAN2_STATS_ENABLE */
+
+#if CAN_RECOVERY_ENABLE
+    can_recovery_sce_irq(&can2_handle, &can2_recovery);
+#endif /* CAN_RECOVERY_ENABLE */
+
     HAL_CAN_IRQHandler(&can2_handle);
 }
 
@@ -344,6 +1132,18 @@ uint8_t can2_deinit(void) {
         return CAN_DEINIT_FAIL;
     }
 
+#if CAN2_TX_QUEUE_ENABLE
+    can_tx_queue_reset(&can2_tx_queue);
+#endif /* CAN2_TX_QUEUE_ENABLE */
+
+#if CAN2_RX0_RING_ENABLE
+    can_rx_ring_reset(&can2_rx0_ring);
+#endif /* CAN2_RX0_RING_ENABLE */
+
+#if CAN2_RX1_RING_ENABLE
+    can_rx_ring_reset(&can2_rx1_ring);
+#endif /* CAN2_RX1_RING_ENABLE */
+
     return CAN_DEINIT_OK;
 }
 
@@ -502,242 +1302,5413 @@ void HAL_CAN_MspDeInit(CAN_HandleTypeDef *hcan) {
 }
 
 /**
- * @brief Calculate parameters of specific CAN baudrate.
+ * @brief Evaluate a bit timing, fill the bit rate error, sample point and
+ *        oscillator tolerance.
  *
  * @param[in] baud_rate CAN band rate. Unit: bps.
- * @param[in] prop_delay The propagation delay of bus, include cable and can
- *                       transceiver. Unit: ns.
- * @param[out] base_freq Base frequency of peripherals. Unit: Hz.
- * @param[out] prescale The prescale of `base_freq`.
- * @param[out] tsjw Syncronisation Jump Width
- * @param[out] tseg1 Time of segment 1.
- * @param[out] tseg2 Time of segment 2.
- * @return Calculate status.
- *  @retval - 0: No error;
- *  @retval - 1: Can not satisfied this baudrate in this condition.
+ * @param[in] prop_delay The propagation delay of bus. Unit: ns.
+ * @param[in] base_freq Base frequency of peripherals. Unit: Hz.
+ * @param[in,out] timing `prescale`, `tseg1`, `tseg2` and `tsjw` are input, the
+ *                       others are output.
+ * @return Evaluate status.
+ *  @retval - 0: The timing satisfies `CAN_RATE_TOLERANCE`, `CAN_OSC_TOLERANCE`
+ *               and the propagation delay.
+ *  @retval - 1: Not satisfied.
  */
-uint8_t can_rate_calc(uint32_t baud_rate, uint32_t prop_delay,
-                      uint32_t base_freq, uint32_t *prescale, uint32_t *tsjw,
-                      uint32_t *tseg1, uint32_t *tseg2) {
-
-    /*## step 1: determine minimum permissible time for the prop_seg
-                 segment. #################################################*/
-    uint32_t t_prop_seg = 2 * prop_delay;
-
-    /*## step 2: choose can system clock frequency. #######################*/
-    uint32_t f_div;
-    *prescale = 0;
-
-    while (1) {
-        ++(*prescale);
-        f_div = base_freq / (*prescale);
-
-        if (f_div / baud_rate > 25) {
-            continue;
-        }
-
-        if (f_div / baud_rate < 8) {
-            /* cannot divide this baudrate. */
-            return 1;
-        }
-
-        if (f_div % baud_rate != 0) {
-            continue;
-        } else {
-            break;
-        }
+static uint8_t can_bit_timing_check(uint32_t baud_rate, uint32_t prop_delay,
+                                    uint32_t base_freq,
+                                    can_bit_timing_t *timing) {
+    uint32_t tq_per_bit = 1 + timing->tseg1 + timing->tseg2;
+    uint32_t tq_freq = base_freq / timing->prescale;
+
+    int64_t rate_diff = (int64_t)base_freq * 1000000 /
+                            (timing->prescale * tq_per_bit) -
+                        (int64_t)baud_rate * 1000000;
+    timing->error = (int32_t)(rate_diff / baud_rate);
+    if ((timing->error > CAN_RATE_TOLERANCE) ||
+        (timing->error < -CAN_RATE_TOLERANCE)) {
+        return 1;
     }
 
-    /*## step 3: calculate prop_seg duration. ##########################*/
-    uint32_t tq_per_bit = f_div / baud_rate;
+    /* The signal goes to the farthest node and back before sampling. */
     uint32_t prop_seg =
-        (uint32_t)ceilf((float)(t_prop_seg * f_div) / 1000000000.0f);
-
-    /*## step 4: determine phase_seg1, phase_seg2 */
-    uint32_t tq_remain = tq_per_bit - prop_seg - 1;
-    if (tq_remain < 3) {
-        /* frequency division is from small to large, which means that if
-         * the condition is met, the frequency division coefficient must be
-         * the highest. if even the highest frequency cannot meet this
-         * condition, then there is no other way. */
+        (uint32_t)(((uint64_t)2 * prop_delay * tq_freq + 999999999) /
+                   1000000000);
+    if (timing->tseg1 < prop_seg + 1) {
         return 1;
     }
 
-    if (tq_remain == 3) {
-        /* if the remaining number is equal to 3, than phase_seg1 = 1 and
-         * phase_seg2 = 2 */
-        *tseg1 = 1;
-        *tseg2 = 2;
-    } else {
-        /* if the remain number is an odd number greater than 3, than add
-         * one to the prop_seg (also subtract one to the remain number)*/
-        tq_remain = (tq_remain % 2 == 0) ? (tq_remain) : (tq_remain - 1);
-
-        /* divide the remaining number by to and assign the result to
-         * phase_seg1 and phase_seg2. */
-        *tseg1 = tq_remain / 2;
-        *tseg2 = tq_remain - *tseg1;
+    /* Oscillator tolerance (AN1798):
+     * df <= SJW / (20 * NBT)
+     * df <= min(PS1, PS2) / (2 * (13 * NBT - PS2)) */
+    uint32_t phase_seg1 = timing->tseg1 - prop_seg;
+    uint32_t phase_min =
+        (phase_seg1 < timing->tseg2) ? phase_seg1 : timing->tseg2;
+    uint32_t df1 = timing->tsjw * 1000000 / (20 * tq_per_bit);
+    uint32_t df2 =
+        phase_min * 1000000 / (2 * (13 * tq_per_bit - timing->tseg2));
+    timing->osc_tolerance = (df1 < df2) ? df1 : df2;
+    if (timing->osc_tolerance < CAN_OSC_TOLERANCE) {
+        return 1;
     }
 
-    *tseg1 += prop_seg;
+    timing->sample_point = (1 + timing->tseg1) * 1000 / tq_per_bit;
 
-    if (*tseg2 > 8) {
-        /* STM32F1 CAN BS2 range: 1-8 */
-        *tseg2 = 8;
-        *tseg1 = tq_remain - *tseg2;
-    }
-    if (*tseg1 > 16) {
-        /* STM32F1 CAN BS1 range: 1-16 */
-        return 1;
+    return 0;
+}
+
+/**
+ * @brief Whether the timing `a` is better than `b`: less bit rate error, then
+ *        closer to the sample point, then larger oscillator tolerance.
+ *
+ * @param a Timing a.
+ * @param b Timing b.
+ * @param sample_point The target sample point.
+ * @return Return 1 if `a` is better.
+ */
+static uint8_t can_bit_timing_better(const can_bit_timing_t *a,
+                                     const can_bit_timing_t *b,
+                                     uint16_t sample_point) {
+    uint32_t a_error = (a->error < 0) ? -a->error : a->error;
+    uint32_t b_error = (b->error < 0) ? -b->error : b->error;
+    if (a_error != b_error) {
+        return a_error < b_error;
     }
 
-    /*## step 5: determine trjw (also called tsjw) #########################*/
-    /* rjw is the smaller of 4 and phase_seg1. */
-    *tsjw = (*tseg1 > 4) ? (4) : (*tseg1);
+    int32_t a_sp = (int32_t)a->sample_point - sample_point;
+    int32_t b_sp = (int32_t)b->sample_point - sample_point;
+    a_sp = (a_sp < 0) ? -a_sp : a_sp;
+    b_sp = (b_sp < 0) ? -b_sp : b_sp;
+    if (a_sp != b_sp) {
+        return a_sp < b_sp;
+    }
 
-    /*## skip step 6: calculate required oscillator. #######################*/
-    return 0;
+    return a->osc_tolerance > b->osc_tolerance;
 }
 
 /**
- * @brief Get the CAN handle with specificd CAN.
+ * @brief Precomputed bit timing of common clock and bit rate, with sample
+ *        point 87.5% and no propagation delay. Generated by the same search
+ *        as `can_bit_timing_calc()`.
+ */
+static const struct {
+    uint32_t base_freq;
+    uint32_t baud_rate;
+    uint16_t prescale;
+    uint8_t tseg1;
+    uint8_t tseg2;
+} can_bit_timing_table[] = {
+    {36000000, 1000000, 2, 15, 2},
+    {36000000, 800000, 3, 12, 2},
+    {36000000, 500000, 4, 15, 2},
+    {36000000, 250000, 9, 13, 2},
+    {36000000, 125000, 18, 13, 2},
+    {36000000, 100000, 24, 12, 2},
+    {36000000, 50000, 45, 13, 2},
+    {36000000, 20000, 120, 12, 2},
+    {36000000, 10000, 225, 13, 2},
+    {32000000, 1000000, 2, 13, 2},
+    {32000000, 800000, 2, 16, 3},
+    {32000000, 500000, 4, 13, 2},
+    {32000000, 250000, 8, 13, 2},
+    {32000000, 125000, 16, 13, 2},
+    {32000000, 100000, 20, 13, 2},
+    {32000000, 50000, 40, 13, 2},
+    {32000000, 20000, 100, 13, 2},
+    {32000000, 10000, 200, 13, 2},
+    {24000000, 1000000, 2, 9, 2},
+    {24000000, 800000, 2, 12, 2},
+    {24000000, 500000, 3, 13, 2},
+    {24000000, 250000, 6, 13, 2},
+    {24000000, 125000, 12, 13, 2},
+    {24000000, 100000, 15, 13, 2},
+    {24000000, 50000, 30, 13, 2},
+    {24000000, 20000, 75, 13, 2},
+    {24000000, 10000, 150, 13, 2},
+    {8000000, 1000000, 1, 5, 2},
+    {8000000, 800000, 1, 7, 2},
+    {8000000, 500000, 1, 13, 2},
+    {8000000, 250000, 2, 13, 2},
+    {8000000, 125000, 4, 13, 2},
+    {8000000, 100000, 5, 13, 2},
+    {8000000, 50000, 10, 13, 2},
+    {8000000, 20000, 25, 13, 2},
+    {8000000, 10000, 50, 13, 2},
+};
+
+/* Sample point of `can_bit_timing_table`. */
+#define CAN_BIT_TIMING_TABLE_SP 875
+
+/**
+ * @brief Calculate the bit timing of specific CAN baudrate. Find it in the
+ *        precomputed table first, otherwise search all the prescale, time
+ *        segment 1 and time segment 2.
  *
- * @param can_selected Specific which can will to get.
- * @return The handle of CAN. return NULL which the CAN doesn't exist.
+ * @param[in] baud_rate CAN band rate. Unit: bps.
+ * @param[in] prop_delay The propagation delay of bus, include cable and can
+ *                       transceiver. Unit: ns.
+ * @param[in] base_freq Base frequency of peripherals. Unit: Hz.
+ * @param[in] sample_point The target sample point. Unit: 0.1%.
+ * @param[out] timing The bit timing.
+ * @return Calculate status.
+ *  @retval - 0: No error;
+ *  @retval - 1: Can not satisfied this baudrate in this condition.
+ * @note Only integer arithmetic. Time quanta per bit is 8 to 25, time
+ *       segment 2 is at least 2, SJW is the smallest of 4 and the time
+ *       segments.
  */
-CAN_HandleTypeDef *can_get_handle(can_selected_t can_selected) {
-    switch (can_selected) {
+uint8_t can_bit_timing_calc(uint32_t baud_rate, uint32_t prop_delay,
+                            uint32_t base_freq, uint16_t sample_point,
+                            can_bit_timing_t *timing) {
+    if ((baud_rate == 0) || (baud_rate > 1000000) || (timing == NULL)) {
+        /* Classical CAN is up to 1 Mbps. */
+        return 1;
+    }
 
-#if CAN1_ENABLE
-        case can1_selected:
-            return &can1_handle;
-#endif /* CAN1_ENABLE */
+    if (sample_point == CAN_BIT_TIMING_TABLE_SP) {
+        for (uint32_t i = 0;
+             i < sizeof(can_bit_timing_table) / sizeof(can_bit_timing_table[0]);
+             ++i) {
+            if ((can_bit_timing_table[i].base_freq != base_freq) ||
+                (can_bit_timing_table[i].baud_rate != baud_rate)) {
+                continue;
+            }
+
+            timing->prescale = can_bit_timing_table[i].prescale;
+            timing->tseg1 = can_bit_timing_table[i].tseg1;
+            timing->tseg2 = can_bit_timing_table[i].tseg2;
+            timing->tsjw = (timing->tseg2 > 4) ? 4 : timing->tseg2;
+            timing->tsjw =
+                (timing->tsjw > timing->tseg1) ? timing->tseg1 : timing->tsjw;
+            if (can_bit_timing_check(baud_rate, prop_delay, base_freq,
+                                     timing) == 0) {
+                return 0;
+            }
+
+            /* The propagation delay is too long, search it. */
+            break;
+        }
+    }
 
-#if CAN2_ENABLE
-        case can2_selected:
-            return &can2_handle;
-#endif /* CAN2_ENABLE */
+    can_bit_timing_t best = {0};
+    can_bit_timing_t test;
+
+    uint32_t prescale_min = base_freq / (baud_rate * 25);
+    uint32_t prescale_max = base_freq / (baud_rate * 8) + 1;
+    prescale_min = (prescale_min < 1) ? 1 : prescale_min;
+    prescale_max = (prescale_max > 1024) ? 1024 : prescale_max;
+
+    for (uint32_t prescale = prescale_min; prescale <= prescale_max;
+         ++prescale) {
+        for (uint32_t tq_per_bit = 8; tq_per_bit <= 25; ++tq_per_bit) {
+            for (uint32_t tseg2 = 2; tseg2 <= 8; ++tseg2) {
+                uint32_t tseg1 = tq_per_bit - 1 - tseg2;
+                if (tseg1 > 16) {
+                    continue;
+                }
+
+                test.prescale = prescale;
+                test.tseg1 = tseg1;
+                test.tseg2 = tseg2;
+                test.tsjw = (tseg2 > 4) ? 4 : tseg2;
+                test.tsjw = (test.tsjw > tseg1) ? tseg1 : test.tsjw;
+                if (can_bit_timing_check(baud_rate, prop_delay, base_freq,
+                                         &test) != 0) {
+                    continue;
+                }
+
+                if ((best.prescale == 0) ||
+                    can_bit_timing_better(&test, &best, sample_point)) {
+                    best = test;
+                }
+            }
+        }
+    }
 
-        default:
-            return NULL;
+    if (best.prescale == 0) {
+        return 1;
     }
+
+    *timing = best;
+    return 0;
 }
 
 /**
- * @brief CAN send message.
+ * @brief Calculate parameters of specific CAN baudrate.
+ *
+ * @param[in] baud_rate CAN band rate. Unit: bps.
+ * @param[in] prop_delay The propagation delay of bus, include cable and can
+ *                       transceiver. Unit: ns.
+ * @param[out] base_freq Base frequency of peripherals. Unit: Hz.
+ * @param[out] prescale The prescale of `base_freq`.
+ * @param[out] tsjw Syncronisation Jump Width
+ * @param[out] tseg1 Time of segment 1.
+ * @param[out] tseg2 Time of segment 2.
+ * @return Calculate status.
+ *  @retval - 0: No error;
+ *  @retval - 1: Can not satisfied this baudrate in this condition.
+ * @note Target sample point is `CAN_SAMPLE_POINT`, see
+ *       `can_bit_timing_calc()`.
+ */
+uint8_t can_rate_calc(uint32_t baud_rate, uint32_t prop_delay,
+                      uint32_t base_freq, uint32_t *prescale, uint32_t *tsjw,
+                      uint32_t *tseg1, uint32_t *tseg2) {
+    can_bit_timing_t timing;
+
+    if (can_bit_timing_calc(baud_rate, prop_delay, base_freq, CAN_SAMPLE_POINT,
+                            &timing) != 0) {
+        return 1;
+    }
+
+    *prescale = timing.prescale;
+    *tsjw = timing.tsjw;
+    *tseg1 = timing.tseg1;
+    *tseg2 = timing.tseg2;
+
+    return 0;
+}
+
+/**
+ * @brief Get the CAN handle with specificd CAN.
+ *
+ * @param can_selected Specific which can will to get.
+ * @return The handle of CAN. return NULL which the CAN doesn't exist.
+ */
+CAN_HandleTypeDef *can_get_handle(can_selected_t can_selected) {
+    switch (can_selected) {
+
+#if CAN1_ENABLE
+        case can1_selected:
+            return &can1_handle;
+#endif /* CAN1_ENABLE */
+
+#if CAN2_ENABLE
+        case can2_selected:
+            return &can2_handle;
+#endif /* CAN2_ENABLE */
+
+        default:
+            return NULL;
+    }
+}
+
+#if CAN_DISPATCH_ENABLE
+
+/**
+ * @brief Identify the receive dispatch table of CAN.
+ *
+ * @param can_selected Specific which CAN.
+ * @return The dispatch table. Return NULL if the CAN is not enabled.
+ */
+static inline can_dispatch_t *
+can_dispatch_identify(can_selected_t can_selected) {
+    switch (can_selected) {
+
+#if CAN1_ENABLE
+        case can1_selected:
+            return &can1_dispatch;
+#endif /* CAN1_ENABLE */
+
+#if CAN2_ENABLE
+        case can2_selected:
+            return &can2_dispatch;
+#endif /* CAN2_ENABLE */
+
+        default:
+            return NULL;
+    }
+}
+
+/**
+ * @brief Map the filter match index of list mode filters to the handler slot,
+ *        so the lookup by ID is skipped.
+ *
+ * @param can_selected Specific which CAN.
+ * @param dispatch The dispatch table.
+ * @note Mask mode filters match more than one ID, they are not mapped.
+ */
+static void can_dispatch_map_fmi(can_selected_t can_selected,
+                                 can_dispatch_t *dispatch) {
+    const can_filter_table_t *table = &can_filter_table;
+    uint32_t first = (can_selected == can1_selected) ? 0 : table->slave_start;
+    uint32_t last = (can_selected == can1_selected) ? table->slave_start
+                                                    : table->count;
+    uint32_t fmi[2] = {0, 0};
+
+    memset(dispatch->fmi_slot, 0, sizeof(dispatch->fmi_slot));
+
+    /* Filter numbers are counted in order of banks, separately for each
+     * FIFO. */
+    for (uint32_t i = first; i < last; ++i) {
+        const can_filter_bank_t *bank = &table->bank[i];
+        uint8_t *fmi_slot = &dispatch->fmi_slot[bank->fifo][fmi[bank->fifo]];
+        uint8_t slots = can_filter_kind_slots[bank->kind];
+
+        fmi[bank->fifo] += slots;
+
+        for (uint8_t j = 0; j < slots; ++j) {
+            uint32_t reg = (j < (slots + 1) / 2) ? bank->fr1 : bank->fr2;
+            uint8_t slot = 0;
+
+            if (bank->kind == CAN_FILTER_KIND_16_LIST) {
+                /* 16-bit layout: STID[10:0] RTR IDE EXID[17:15] */
+                uint32_t value = (j & 0x01U) ? (reg >> 16) : (reg & 0xFFFFU);
+                slot = dispatch->std_slot[(value >> 5) & 0x7FFU];
+            } else if (bank->kind == CAN_FILTER_KIND_32_LIST) {
+                if (reg & CAN_TI0R_IDE) {
+                    uint32_t id = reg >> CAN_TI0R_EXID_Pos;
+                    for (uint8_t k = 0; k < dispatch->ext_count; ++k) {
+                        if (dispatch->ext_id[k] == id) {
+                            slot = dispatch->ext_slot[k];
+                            break;
+                        }
+                    }
+                } else {
+                    slot = dispatch->std_slot[reg >> CAN_TI0R_STID_Pos];
+                }
+            }
+
+            fmi_slot[j] = slot;
+        }
+    }
+}
+
+/**
+ * @brief Find the handler of frame and call it.
+ *
+ * @param can_selected Specific which CAN.
+ * @param rx_fifo The FIFO which the frame is received from, use the filter
+ *                match index to skip the lookup. Greater than
+ *                `CAN_RX_FIFO1` means unknown.
+ * @param frame The frame.
+ * @return Dispatch status.
+ *  @retval - 0: The handler is called.
+ *  @retval - 1: No handler.
+ */
+static uint8_t can_dispatch_frame(can_selected_t can_selected,
+                                  uint32_t rx_fifo, const can_frame_t *frame) {
+    can_dispatch_t *dispatch = can_dispatch_identify(can_selected);
+    if ((dispatch == NULL) || (dispatch->ready == 0)) {
+        return 1;
+    }
+
+    uint8_t slot = 0;
+
+    if ((rx_fifo <= CAN_RX_FIFO1) &&
+        (frame->fmi < sizeof(dispatch->fmi_slot[0]))) {
+        slot = dispatch->fmi_slot[rx_fifo][frame->fmi];
+    }
+
+    if (slot != 0) {
+        /* Found by filter match index. */
+    } else if (frame->ide == CAN_ID_STD) {
+        slot = dispatch->std_slot[frame->id & 0x7FFU];
+    } else {
+        /* Binary search. */
+        uint32_t low = 0;
+        uint32_t high = dispatch->ext_count;
+        while (low < high) {
+            uint32_t mid = (low + high) / 2;
+            if (dispatch->ext_id[mid] < frame->id) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        if ((low < dispatch->ext_count) &&
+            (dispatch->ext_id[low] == frame->id)) {
+            slot = dispatch->ext_slot[low];
+        }
+    }
+
+    can_rx_handler_t handler =
+        (slot != 0) ? dispatch->handler[slot - 1] : dispatch->default_handler;
+    if (handler == NULL) {
+        return 1;
+    }
+
+    handler(can_selected, frame);
+    return 0;
+}
+
+#endif /* CAN_DISPATCH_ENABLE */
+
+/**
+ * @brief Context of building filter banks allocation.
+ */
+typedef struct {
+    can_filter_table_t *table; /*!< The table to build.                  */
+    int8_t open[2][4];         /*!< Bank not full of each FIFO and kind,
+                                    -1 means none.                       */
+    uint32_t load[2];          /*!< Slots used of each FIFO.             */
+    uint8_t fifo_allowed;      /*!< FIFOs can be chosen automatically,
+                                    bit0: FIFO0, bit1: FIFO1.            */
+} can_filter_builder_t;
+
+/**
+ * @brief Put a pattern into a filter bank, open a new bank if needed.
+ *
+ * @param builder The build context.
+ * @param kind `CAN_FILTER_KIND_xxx`.
+ * @param value The ID value, in register layout (16-bit or 32-bit).
+ * @param mask The mask, in register layout. Not used in list mode.
+ * @param fifo `CAN_FILTER_FIFO0`, `CAN_FILTER_FIFO1` or
+ *             `CAN_FILTER_FIFO_AUTO`.
+ * @return Add status.
+ *  @retval - 0: Success.
+ *  @retval - 1: No free filter bank.
+ */
+static uint8_t can_filter_add_pattern(can_filter_builder_t *builder,
+                                      uint8_t kind, uint32_t value,
+                                      uint32_t mask, uint8_t fifo) {
+    can_filter_table_t *table = builder->table;
+    can_filter_bank_t *bank;
+
+    if (fifo == CAN_FILTER_FIFO_AUTO) {
+        /* Prefer filling a bank not full, then the FIFO with less load. */
+        uint8_t candidate[2] = {0, 1};
+        uint8_t n = 0;
+
+        for (uint8_t i = 0; i < 2; ++i) {
+            if ((builder->fifo_allowed & (1U << i)) &&
+                (builder->open[i][kind] >= 0)) {
+                candidate[n++] = i;
+            }
+        }
+        if (n == 0) {
+            for (uint8_t i = 0; i < 2; ++i) {
+                if (builder->fifo_allowed & (1U << i)) {
+                    candidate[n++] = i;
+                }
+            }
+        }
+
+        fifo = candidate[0];
+        if ((n == 2) && (builder->load[1] < builder->load[0])) {
+            fifo = candidate[1];
+        }
+    }
+
+    if (builder->open[fifo][kind] < 0) {
+        if (table->count == CAN_FILTER_BANK_NUM) {
+            return 1;
+        }
+
+        builder->open[fifo][kind] = (int8_t)table->count;
+        bank = &table->bank[table->count++];
+        bank->fr1 = 0;
+        bank->fr2 = 0;
+        bank->kind = kind;
+        bank->fifo = fifo;
+        bank->used = 0;
+    }
+
+    bank = &table->bank[builder->open[fifo][kind]];
+
+    switch (kind) {
+        case CAN_FILTER_KIND_16_LIST: {
+            uint32_t shift = (bank->used & 0x01U) * 16;
+            if (bank->used < 2) {
+                bank->fr1 |= value << shift;
+            } else {
+                bank->fr2 |= value << shift;
+            }
+        } break;
+
+        case CAN_FILTER_KIND_16_MASK:
+        case CAN_FILTER_KIND_32_LIST: {
+            uint32_t reg = (kind == CAN_FILTER_KIND_16_MASK)
+                               ? ((mask << 16) | value)
+                               : value;
+            if (bank->used == 0) {
+                bank->fr1 = reg;
+            } else {
+                bank->fr2 = reg;
+            }
+        } break;
+
+        default: {
+            bank->fr1 = value;
+            bank->fr2 = mask;
+        } break;
+    }
+
+    ++builder->load[fifo];
+    if (++bank->used == can_filter_kind_slots[kind]) {
+        builder->open[fifo][kind] = -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Split the ID range into aligned blocks, and put them into filter
+ *        banks. A single ID uses list mode, a block uses mask mode. Standard
+ *        IDs use 16-bit scale, extended IDs use 32-bit scale.
+ *
+ * @param builder The build context.
+ * @param wanted The wanted ID or ID range.
+ * @param fifo The FIFO of this ID, overrides `wanted->fifo`.
+ * @return Add status.
+ *  @retval - 0: Success.
+ *  @retval - 1: No free filter bank.
+ */
+static uint8_t can_filter_add_id(can_filter_builder_t *builder,
+                                 const can_filter_id_t *wanted, uint8_t fifo) {
+    uint8_t std = (wanted->ide == CAN_ID_STD);
+    uint32_t id_bits = std ? 11 : 29;
+    uint32_t id_mask = std ? 0x7FFU : 0x1FFFFFFFU;
+    uint32_t lo = wanted->id;
+    uint32_t hi = wanted->last;
+
+    while (1) {
+        uint32_t k = 0;
+        while ((k < id_bits) && ((lo & ((2U << k) - 1)) == 0) &&
+               (lo + (2U << k) - 1 <= hi)) {
+            ++k;
+        }
+
+        uint32_t block_mask = ~((1U << k) - 1) & id_mask;
+        uint8_t kind;
+        uint32_t value, mask, rtr;
+
+        if (std) {
+            /* 16-bit layout: STID[10:0] RTR IDE EXID[17:15] */
+            kind = (k == 0) ? CAN_FILTER_KIND_16_LIST : CAN_FILTER_KIND_16_MASK;
+            value = lo << 5;
+            rtr = 1U << 4;
+            mask = (block_mask << 5) | (1U << 3);
+        } else {
+            /* 32-bit layout: same as `CAN_ID_WORD_EXT()` */
+            kind = (k == 0) ? CAN_FILTER_KIND_32_LIST : CAN_FILTER_KIND_32_MASK;
+            value = CAN_ID_WORD_EXT(lo);
+            rtr = CAN_ID_WORD_RTR;
+            mask = (block_mask << CAN_TI0R_EXID_Pos) | CAN_TI0R_IDE;
+        }
+
+        if (wanted->remote == 0) {
+            /* Only data frame. */
+            mask |= rtr;
+        }
+
+        if (can_filter_add_pattern(builder, kind, value, mask, fifo) != 0) {
+            return 1;
+        }
+
+        if ((wanted->remote != 0) &&
+            ((kind == CAN_FILTER_KIND_16_LIST) ||
+             (kind == CAN_FILTER_KIND_32_LIST))) {
+            /* List mode compares the RTR bit, add the remote frame. */
+            if (can_filter_add_pattern(builder, kind, value | rtr, 0, fifo) !=
+                0) {
+                return 1;
+            }
+        }
+
+        if (hi - lo <= (1U << k) - 1) {
+            break;
+        }
+        lo += 1U << k;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Build the filter banks of one CAN.
+ *
+ * @param table The table to build, banks are appended.
+ * @param ids The wanted IDs.
+ * @param count Number of `ids`. Accept all frames if it is 0.
+ * @param fifo_allowed FIFOs can be chosen automatically, bit0: FIFO0,
+ *                     bit1: FIFO1.
+ * @return Build status.
+ *  @retval - 0: Success.
+ *  @retval - 1: No enough filter banks.
+ */
+static uint8_t can_filter_build(can_filter_table_t *table,
+                                const can_filter_id_t *ids, uint32_t count,
+                                uint8_t fifo_allowed) {
+    can_filter_builder_t builder = {.table = table,
+                                    .open = {{-1, -1, -1, -1},
+                                             {-1, -1, -1, -1}},
+                                    .fifo_allowed = fifo_allowed};
+
+    if (count == 0) {
+        /* Value 0 and mask 0: accept all frames. */
+        return can_filter_add_pattern(&builder, CAN_FILTER_KIND_32_MASK, 0, 0,
+                                      CAN_FILTER_FIFO_AUTO);
+    }
+
+    /* The fixed FIFO first, so the automatic ones can fill the banks not
+     * full. */
+    for (uint8_t pass = 0; pass < 2; ++pass) {
+        for (uint32_t i = 0; i < count; ++i) {
+            uint8_t fifo = ids[i].fifo;
+            if ((fifo == CAN_FILTER_FIFO_AUTO) != (pass == 1)) {
+                continue;
+            }
+            if (can_filter_add_id(&builder, &ids[i], fifo) != 0) {
+                return 1;
+            }
+        }
+    }
+
+    /* Fill the unused slots with the first one, otherwise ID 0 is
+     * accepted. */
+    for (uint8_t i = 0; i < 2; ++i) {
+        for (uint8_t kind = 0; kind < 4; ++kind) {
+            if (builder.open[i][kind] < 0) {
+                continue;
+            }
+
+            can_filter_bank_t *bank = &table->bank[builder.open[i][kind]];
+            if (kind == CAN_FILTER_KIND_16_LIST) {
+                uint32_t first = bank->fr1 & 0xFFFFU;
+                if (bank->used < 2) {
+                    bank->fr1 = (first << 16) | first;
+                }
+                if (bank->used < 4) {
+                    bank->fr2 = (bank->used == 3)
+                                    ? (bank->fr2 | (first << 16))
+                                    : ((first << 16) | first);
+                }
+            } else if (bank->used < 2) {
+                bank->fr2 = bank->fr1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Get the FIFOs which the receive interrupt is enabled.
+ *
+ * @param can_selected Specific which CAN.
+ * @return bit0: FIFO0, bit1: FIFO1. Both if no receive interrupt is enabled.
+ */
+static uint8_t can_filter_fifo_allowed(can_selected_t can_selected) {
+    uint8_t allowed = 0;
+
+    switch (can_selected) {
+#if CAN1_ENABLE
+        case can1_selected: {
+            allowed = (CAN1_ENABLE_RX0_IT ? 0x01U : 0) |
+                      (CAN1_ENABLE_RX1_IT ? 0x02U : 0);
+        } break;
+#endif /* CAN1_ENABLE */
+
+#if CAN2_ENABLE
+        case can2_selected: {
+            allowed = (CAN2_ENABLE_RX0_IT ? 0x01U : 0) |
+                      (CAN2_ENABLE_RX1_IT ? 0x02U : 0);
+        } break;
+#endif /* CAN2_ENABLE */
+
+        default:
+            break;
+    }
+
+    return (allowed == 0) ? 0x03U : allowed;
+}
+
+/**
+ * @brief Write a filter bank into hardware.
+ *
+ * @param can The CAN holds the filter registers.
+ * @param index Index of filter bank.
+ * @param bank The filter bank, NULL to disable it.
+ * @note Called in filter init mode.
+ */
+static void can_filter_write(CAN_TypeDef *can, uint32_t index,
+                             const can_filter_bank_t *bank) {
+    uint32_t bit = 1U << index;
+
+    can->FA1R &= ~bit;
+    if (bank == NULL) {
+        return;
+    }
+
+    if (bank->kind <= CAN_FILTER_KIND_16_MASK) {
+        can->FS1R &= ~bit;
+    } else {
+        can->FS1R |= bit;
+    }
+
+    if ((bank->kind == CAN_FILTER_KIND_16_LIST) ||
+        (bank->kind == CAN_FILTER_KIND_32_LIST)) {
+        can->FM1R |= bit;
+    } else {
+        can->FM1R &= ~bit;
+    }
+
+    if (bank->fifo == CAN_FILTER_FIFO1) {
+        can->FFA1R |= bit;
+    } else {
+        can->FFA1R &= ~bit;
+    }
+
+    can->sFilterRegister[index].FR1 = bank->fr1;
+    can->sFilterRegister[index].FR2 = bank->fr2;
+    can->FA1R |= bit;
+}
+
+/**
+ * @brief Write the changed filter banks into hardware.
+ *
+ * @param table The filter banks allocation.
+ * @note Only the banks different from `can_filter_table` are written, in
+ *       one filter init window with interrupt disabled. The reception is
+ *       stopped in filter init mode, it takes a few microseconds.
+ */
+static void can_filter_apply(const can_filter_table_t *table) {
+    const can_filter_table_t *applied = &can_filter_table;
+    uint8_t all = (can_filter_synced == 0);
+
+    /* The filter registers are in CAN1, shared by CAN2. */
+    CAN_TypeDef *can = CAN1;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    can->FMR |= CAN_FMR_FINIT;
+
+#ifdef CAN2
+    if (all || (table->slave_start != applied->slave_start)) {
+        can->FMR = (can->FMR & ~CAN_FMR_CAN2SB) |
+                   ((uint32_t)table->slave_start << CAN_FMR_CAN2SB_Pos);
+    }
+#endif /* CAN2 */
+
+    for (uint32_t i = 0; i < CAN_FILTER_BANK_NUM; ++i) {
+        const can_filter_bank_t *bank =
+            (i < table->count) ? &table->bank[i] : NULL;
+        const can_filter_bank_t *old =
+            (i < applied->count) ? &applied->bank[i] : NULL;
+
+        if (!all) {
+            if ((bank == NULL) && (old == NULL)) {
+                continue;
+            }
+            if ((bank != NULL) && (old != NULL) && (bank->fr1 == old->fr1) &&
+                (bank->fr2 == old->fr2) && (bank->kind == old->kind) &&
+                (bank->fifo == old->fifo)) {
+                continue;
+            }
+        }
+
+        can_filter_write(can, i, bank);
+    }
+
+    can->FMR &= ~CAN_FMR_FINIT;
+
+    __set_PRIMASK(primask);
+
+    can_filter_synced = 1;
+}
+
+/**
+ * @brief Check the wanted IDs.
+ *
+ * @param ids The wanted IDs.
+ * @param count Number of `ids`.
+ * @return Return 0 if all IDs are valid.
+ */
+static uint8_t can_filter_check(const can_filter_id_t *ids, uint32_t count) {
+    if ((count != 0) && (ids == NULL)) {
+        return 1;
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t id_max = (ids[i].ide == CAN_ID_STD) ? 0x7FFU : 0x1FFFFFFFU;
+        if ((ids[i].last < ids[i].id) || (ids[i].last > id_max) ||
+            (ids[i].fifo > CAN_FILTER_FIFO_AUTO)) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Build the filter banks of CAN1 and CAN2, and write the changed
+ *        banks into hardware.
+ *
+ * @param ids The wanted IDs of CAN1 and CAN2, checked by
+ *            `can_filter_check()`.
+ * @param count Number of IDs of CAN1 and CAN2. 0: Accept all frames.
+ * @return Update status, same as `can_filter_alloc()`.
+ */
+static uint8_t can_filter_update(const can_filter_id_t *const ids[2],
+                                 const uint32_t count[2]) {
+    uint8_t inited = 0;
+    can_filter_table_t table = {0};
+
+    for (uint8_t n = 0; n < 2; ++n) {
+        CAN_HandleTypeDef *handle = can_get_handle((can_selected_t)n);
+        if (handle == NULL) {
+            if (count[n] != 0) {
+                return 3;
+            }
+            if (n == 0) {
+                /* CAN1 is disabled, all banks are given to CAN2. */
+                table.slave_start = 0;
+            }
+            continue;
+        }
+
+        if (HAL_CAN_GetState(handle) != HAL_CAN_STATE_RESET) {
+            inited = 1;
+        }
+
+        if (can_filter_build(&table, ids[n], count[n],
+                             can_filter_fifo_allowed((can_selected_t)n)) != 0) {
+            return 1;
+        }
+
+        if (n == 0) {
+            table.slave_start = table.count;
+        }
+    }
+
+    if (inited == 0) {
+        return 4;
+    }
+
+    can_filter_apply(&table);
+    can_filter_table = table;
+
+#if CAN_DISPATCH_ENABLE
+    /* The filter match index is changed. */
+    for (uint8_t n = 0; n < 2; ++n) {
+        can_dispatch_t *dispatch = can_dispatch_identify((can_selected_t)n);
+        if ((dispatch != NULL) && (dispatch->ready != 0)) {
+            dispatch->ready = 0;
+            __DMB();
+            can_dispatch_map_fmi((can_selected_t)n, dispatch);
+            __DMB();
+            dispatch->ready = 1;
+        }
+    }
+#endif /* CAN_DISPATCH_ENABLE */
+
+    return 0;
+}
+
+/**
+ * @brief Allocate the hardware filter banks from the wanted IDs, so the
+ *        unwanted frames are rejected in hardware.
+ *
+ * @param can1_ids The wanted IDs of CAN1.
+ * @param can1_count Number of `can1_ids`. 0: Accept all frames.
+ * @param can2_ids The wanted IDs of CAN2.
+ * @param can2_count Number of `can2_ids`. 0: Accept all frames.
+ * @return Allocate status.
+ *  @retval - 0: Success.
+ *  @retval - 1: No enough filter banks (14, or 28 on connectivity line).
+ *  @retval - 3: Parameter invalid, or too many IDs (`CAN_FILTER_IDS`).
+ *  @retval - 4: No CAN is initialized.
+ * @note Single IDs are put into list mode, ranges are split into aligned
+ *       blocks in mask mode. Standard IDs use 16-bit scale (4 IDs or 2 masks
+ *       per bank), extended IDs use 32-bit scale (2 IDs or 1 mask per bank).
+ *       CAN1 uses the banks from 0, CAN2 uses the banks after CAN1
+ *       (`SlaveStartFilterBank`). `CAN_FILTER_FIFO_AUTO` chooses the FIFO
+ *       with less IDs in the FIFOs which the receive interrupt is enabled.
+ * @note Call it after `canx_init()`, it replaces the accept-all filter
+ *       installed by init. The IDs are kept for `can_filter_add()`,
+ *       `can_filter_remove()` and `can_filter_replace()`.
+ */
+uint8_t can_filter_alloc(const can_filter_id_t *can1_ids, uint32_t can1_count,
+                         const can_filter_id_t *can2_ids, uint32_t can2_count) {
+    const can_filter_id_t *const ids[2] = {can1_ids, can2_ids};
+    const uint32_t count[2] = {can1_count, can2_count};
+
+    for (uint8_t n = 0; n < 2; ++n) {
+        if ((count[n] > CAN_FILTER_IDS) ||
+            (can_filter_check(ids[n], count[n]) != 0)) {
+            return 3;
+        }
+    }
+
+    uint8_t res = can_filter_update(ids, count);
+    if (res != 0) {
+        return res;
+    }
+
+    for (uint8_t n = 0; n < 2; ++n) {
+        if (count[n] != 0) {
+            memcpy(can_filter_ids[n], ids[n],
+                   count[n] * sizeof(can_filter_id_t));
+        }
+        can_filter_id_count[n] = count[n];
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Subscribe an ID or ID range at runtime, the controller keeps
+ *        running.
+ *
+ * @param can_selected Specific which CAN.
+ * @param id The wanted ID or ID range.
+ * @return Add status.
+ *  @retval - 0: Success.
+ *  @retval - 1: No enough filter banks.
+ *  @retval - 2: Too many IDs (`CAN_FILTER_IDS`).
+ *  @retval - 3: Parameter invalid.
+ *  @retval - 4: No CAN is initialized.
+ * @note The filter banks are rebuilt in RAM, only the changed banks are
+ *       written in one filter init window. If the CAN accepted all frames
+ *       (no ID), only this ID is accepted now. Don't call it in ISR.
+ */
+uint8_t can_filter_add(can_selected_t can_selected, const can_filter_id_t *id) {
+    if ((can_selected > can2_selected) || (can_filter_check(id, 1) != 0)) {
+        return 3;
+    }
+
+    uint32_t *count = &can_filter_id_count[can_selected];
+    if (*count == CAN_FILTER_IDS) {
+        return 2;
+    }
+
+    can_filter_ids[can_selected][(*count)++] = *id;
+
+    const can_filter_id_t *const ids[2] = {can_filter_ids[0],
+                                           can_filter_ids[1]};
+    uint8_t res = can_filter_update(ids, can_filter_id_count);
+    if (res != 0) {
+        --*count;
+    }
+
+    return res;
+}
+
+/**
+ * @brief Unsubscribe an ID or ID range at runtime, the controller keeps
+ *        running.
+ *
+ * @param can_selected Specific which CAN.
+ * @param id The ID or ID range added before, `id`, `last` and `ide` must be
+ *           the same.
+ * @return Remove status.
+ *  @retval - 0: Success.
+ *  @retval - 1: No enough filter banks, the FIFO assignment is changed and
+ *               the IDs can not be packed again.
+ *  @retval - 3: Parameter invalid, or the ID is not added.
+ *  @retval - 4: No CAN is initialized.
+ * @note If the last ID is removed, the CAN accepts all frames, same as
+ *       `can_filter_alloc()`. Don't call it in ISR.
+ */
+uint8_t can_filter_remove(can_selected_t can_selected,
+                          const can_filter_id_t *id) {
+    if ((can_selected > can2_selected) || (id == NULL)) {
+        return 3;
+    }
+
+    can_filter_id_t *list = can_filter_ids[can_selected];
+    uint32_t *count = &can_filter_id_count[can_selected];
+    uint32_t i = 0;
+
+    while ((i < *count) &&
+           ((list[i].id != id->id) || (list[i].last != id->last) ||
+            (list[i].ide != id->ide))) {
+        ++i;
+    }
+
+    if (i == *count) {
+        return 3;
+    }
+
+    can_filter_id_t removed = list[i];
+    memmove(&list[i], &list[i + 1], (*count - i - 1) * sizeof(list[0]));
+    --*count;
+
+    const can_filter_id_t *const ids[2] = {can_filter_ids[0],
+                                           can_filter_ids[1]};
+    uint8_t res = can_filter_update(ids, can_filter_id_count);
+    if (res != 0) {
+        memmove(&list[i + 1], &list[i], (*count - i) * sizeof(list[0]));
+        list[i] = removed;
+        ++*count;
+    }
+
+    return res;
+}
+
+/**
+ * @brief Replace all wanted IDs of one CAN at runtime, the other CAN is
+ *        not changed and the controllers keep running.
+ *
+ * @param can_selected Specific which CAN.
+ * @param ids The wanted IDs.
+ * @param count Number of `ids`. 0: Accept all frames.
+ * @return Replace status, same as `can_filter_alloc()`.
+ * @note Don't call it in ISR.
+ */
+uint8_t can_filter_replace(can_selected_t can_selected,
+                           const can_filter_id_t *ids, uint32_t count) {
+    if ((can_selected > can2_selected) || (count > CAN_FILTER_IDS) ||
+        (can_filter_check(ids, count) != 0)) {
+        return 3;
+    }
+
+    const can_filter_id_t *list[2] = {can_filter_ids[0], can_filter_ids[1]};
+    uint32_t list_count[2] = {can_filter_id_count[0], can_filter_id_count[1]};
+    list[can_selected] = ids;
+    list_count[can_selected] = count;
+
+    uint8_t res = can_filter_update(list, list_count);
+    if (res != 0) {
+        return res;
+    }
+
+    if (count != 0) {
+        memcpy(can_filter_ids[can_selected], ids,
+               count * sizeof(can_filter_id_t));
+    }
+    can_filter_id_count[can_selected] = count;
+
+    return 0;
+}
+
+/**
+ * @brief Write a frame into a free mailbox.
+ *
+ * @param can_handle The handle of CAN.
+ * @param id_word The ID word of frame, only used in fast path.
+ * @param frame The frame to send.
+ * @param[out] mailbox The mailbox number (0-2) is used, can be NULL.
+ * @return Write status.
+ *  @retval - 0: Success.
+ *  @retval - 1: No free mailbox or HAL error.
+ * @note The mailbox is chosen and loaded with interrupts disabled, so it is
+ *       not taken by a frame sent in ISR between the two steps.
+ */
+static uint8_t can_tx_write(CAN_HandleTypeDef *can_handle, uint32_t id_word,
+                            const can_frame_t *frame, uint32_t *mailbox) {
+#if CAN_FAST_PATH
+    CAN_TypeDef *can = can_handle->Instance;
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    uint32_t tsr = can->TSR;
+    if ((tsr & CAN_TSR_TME) == 0) {
+        __set_PRIMASK(primask);
+        return 1;
+    }
+
+    /* `CODE` is the number of next free mailbox. */
+    uint32_t free_mailbox = (tsr & CAN_TSR_CODE) >> CAN_TSR_CODE_Pos;
+    CAN_TxMailBox_TypeDef *tx_mailbox = &can->sTxMailBox[free_mailbox];
+    const uint8_t *data = frame->data;
+
+    tx_mailbox->TDTR = frame->dlc;
+    tx_mailbox->TDLR = ((uint32_t)data[3] << 24) | ((uint32_t)data[2] << 16) |
+                       ((uint32_t)data[1] << 8) | (uint32_t)data[0];
+    tx_mailbox->TDHR = ((uint32_t)data[7] << 24) | ((uint32_t)data[6] << 16) |
+                       ((uint32_t)data[5] << 8) | (uint32_t)data[4];
+    /* Write the identifier and request the transmission at the same time. */
+    tx_mailbox->TIR = id_word | CAN_TI0R_TXRQ;
+
+    __set_PRIMASK(primask);
+
+    if (mailbox != NULL) {
+        *mailbox = free_mailbox;
+    }
+
+    return 0;
+#else  /* CAN_FAST_PATH */
+    UNUSED(id_word);
+    uint32_t tx_mail_box = CAN_TX_MAILBOX0;
+
+    CAN_TxHeaderTypeDef tx_header = {0};
+    tx_header.IDE = frame->ide;
+    tx_header.RTR = frame->rtr;
+    tx_header.DLC = frame->dlc;
+    if (frame->ide == CAN_ID_STD) {
+        tx_header.StdId = frame->id;
+    } else {
+        tx_header.ExtId = frame->id;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    HAL_StatusTypeDef res = HAL_CAN_AddTxMessage(can_handle, &tx_header,
+                                                 frame->data, &tx_mail_box);
+    __set_PRIMASK(primask);
+
+    if (res != HAL_OK) {
+        return 1;
+    }
+
+    if (mailbox != NULL) {
+        /* `CAN_TX_MAILBOXx` is bit mask, convert it to number. */
+        *mailbox = (tx_mail_box == CAN_TX_MAILBOX0)   ? 0
+                   : (tx_mail_box == CAN_TX_MAILBOX1) ? 1
+                                                      : 2;
+    }
+
+    return 0;
+#endif /* CAN_FAST_PATH */
+}
+
+/**
+ * @brief Get the ID word of frame.
+ *
+ * @param frame The frame.
+ * @return The ID word, see `CAN_ID_WORD_xxx()`.
+ */
+static inline uint32_t can_frame_id_word(const can_frame_t *frame) {
+    uint32_t id_word = (frame->ide == CAN_ID_STD)
+                           ? CAN_ID_WORD_STD(frame->id)
+                           : CAN_ID_WORD_EXT(frame->id);
+
+    return (frame->rtr == CAN_RTR_REMOTE) ? (id_word | CAN_ID_WORD_RTR)
+                                          : id_word;
+}
+
+#if CAN_TIME_ENABLE
+
+/**
+ * @brief Identify the time stamp extension of CAN.
+ *
+ * @param can_handle The handle of CAN.
+ * @return The time stamp extension. Return NULL if TTCM is not enabled.
+ */
+static inline can_time_t *can_time_identify(CAN_HandleTypeDef *can_handle) {
+#if CAN1_TIME_ENABLE
+    if (can_handle->Instance == CAN1) {
+        return &can1_time;
+    }
+#endif /* CAN1_TIME_ENABLE */
+
+#if CAN2_TIME_ENABLE
+    if (can_handle->Instance == CAN2) {
+        return &can2_time;
+    }
+#endif /* CAN2_TIME_ENABLE */
+
+    UNUSED(can_handle);
+    return NULL;
+}
+
+/**
+ * @brief Reset the time stamp extension and the latency statistics.
+ *
+ * @param time The time stamp extension.
+ * @param baud_rate Baud rate. Unit: Kbps.
+ */
+static void can_time_reset(can_time_t *time, uint32_t baud_rate) {
+    /* Start from one period, so the time stamps captured before the first
+     * update never go below 0. */
+    time->last = CAN_TIME_PERIOD;
+    time->last_tick = HAL_GetTick();
+    time->bits_per_ms = baud_rate;
+    memset(&time->latency, 0, sizeof(time->latency));
+    time->latency.min = UINT32_MAX;
+}
+
+/**
+ * @brief Estimate the time stamp of now.
+ *
+ * @param time The time stamp extension.
+ * @return The 64-bit time stamp. Unit: bit time.
+ * @note Called with interrupt disabled.
+ */
+static inline uint64_t can_time_estimate(const can_time_t *time) {
+    return time->last +
+           (uint64_t)(HAL_GetTick() - time->last_tick) * time->bits_per_ms;
+}
+
+/**
+ * @brief Extend the 16-bit hardware time stamp to 64 bits.
+ *
+ * @param time The time stamp extension.
+ * @param stamp The hardware time stamp, captured a moment ago.
+ * @return The 64-bit time stamp. Unit: bit time.
+ */
+static uint64_t can_time_extend(can_time_t *time, uint16_t stamp) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    /* The latest value ends with `stamp` and not later than now. */
+    uint64_t limit = can_time_estimate(time) + CAN_TIME_MARGIN;
+    uint64_t result = (limit & ~(uint64_t)(CAN_TIME_PERIOD - 1)) | stamp;
+    if (result > limit) {
+        result -= CAN_TIME_PERIOD;
+    }
+
+    /* Frames of FIFO0, FIFO1 and mailboxes may be handled out of order. */
+    if (result > time->last) {
+        time->last = result;
+        time->last_tick = HAL_GetTick();
+    }
+
+    __set_PRIMASK(primask);
+
+    return result;
+}
+
+/**
+ * @brief Get the time stamp of now.
+ *
+ * @param time The time stamp extension.
+ * @return The 64-bit time stamp. Unit: bit time.
+ */
+static uint64_t can_time_now(const can_time_t *time) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint64_t now = can_time_estimate(time);
+    __set_PRIMASK(primask);
+
+    return now;
+}
+
+#endif /* CAN_TIME_ENABLE */
+
+#if CAN1_STATS_ENABLE
+
+/**
+ * @brief Identify the bus statistics of CAN.
+ *
+ * @param can_handle The handle of CAN.
+ * @return The bus statistics.
+ */
+static inline can_stats_t *can_stats_identify(CAN_HandleTypeDef *can_handle) {
+#if CAN2_STATS_ENABLE
+    if (can_handle->Instance == CAN2) {
+        return &can2_stats;
+    }
+#endif /* CAN2_STATS_ENABLE */
+
+    UNUSED(can_handle);
+    return &can1_stats;
+}
+
+/**
+ * @brief Get the length of frame on bus, from SOF to intermission.
+ *
+ * @param ide `CAN_ID_STD` or `CAN_ID_EXT`.
+ * @param rtr `CAN_RTR_DATA` or `CAN_RTR_REMOTE`.
+ * @param dlc Data length.
+ * @return The bits of frame, without stuff bits.
+ */
+static inline uint32_t can_frame_bits(uint32_t ide, uint32_t rtr,
+                                      uint32_t dlc) {
+    uint32_t bits = (ide == CAN_ID_STD) ? 47 : 67;
+
+    if (rtr == CAN_RTR_DATA) {
+        bits += 8 * ((dlc > 8) ? 8 : dlc);
+    }
+
+    return bits;
+}
+
+/**
+ * @brief Clear the bus statistics.
+ *
+ * @param can_stats The bus statistics.
+ * @param baud_rate Baud rate. Unit: Kbps.
+ */
+static void can_stats_reset(can_stats_t *can_stats, uint32_t baud_rate) {
+    memset(can_stats, 0, sizeof(can_stats_t));
+    can_stats->bits_per_ms = baud_rate;
+    can_stats->window_tick = HAL_GetTick();
+}
+
+/**
+ * @brief Update the rates if the window is over.
+ *
+ * @param can_stats The bus statistics.
+ * @note Called with interrupt disabled.
+ */
+static void can_stats_roll(can_stats_t *can_stats) {
+    uint32_t tick = HAL_GetTick();
+    uint32_t elapsed = tick - can_stats->window_tick;
+    can_bus_stats_t *stats = &can_stats->stats;
+
+    if (elapsed < CAN_STATS_WINDOW) {
+        return;
+    }
+
+    /* The window is longer if no frame and no one read the statistics. */
+    stats->rx_fps = (uint64_t)can_stats->rx_frames * 1000 / elapsed;
+    stats->tx_fps = (uint64_t)can_stats->tx_frames * 1000 / elapsed;
+    stats->rx_bps = (uint64_t)can_stats->rx_bits * 1000 / elapsed;
+    stats->tx_bps = (uint64_t)can_stats->tx_bits * 1000 / elapsed;
+
+    /* Unit of `bits_per_ms` is bit per second / 1000, so it's 0.1%. */
+    uint32_t load = (stats->rx_bps + stats->tx_bps) / can_stats->bits_per_ms;
+    stats->bus_load = (load > 1000) ? 1000 : load;
+
+    can_stats->rx_frames = 0;
+    can_stats->tx_frames = 0;
+    can_stats->rx_bits = 0;
+    can_stats->tx_bits = 0;
+    can_stats->window_tick = tick;
+}
+
+#if CAN_TX_IT_ENABLE || CAN_RX_IRQ_ENABLE
+
+/**
+ * @brief Count a frame.
+ *
+ * @param can_stats The bus statistics.
+ * @param tx 0: Received frame, 1: Transmitted frame.
+ * @param bits Bits of frame, see `can_frame_bits()`.
+ */
+static void can_stats_count(can_stats_t *can_stats, uint8_t tx,
+                            uint32_t bits) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    can_stats_roll(can_stats);
+
+    if (tx) {
+        ++can_stats->stats.tx_frames;
+        ++can_stats->tx_frames;
+        can_stats->tx_bits += bits;
+    } else {
+        ++can_stats->stats.rx_frames;
+        ++can_stats->rx_frames;
+        can_stats->rx_bits += bits;
+    }
+
+    __set_PRIMASK(primask);
+}
+
+#endif /* CAN_TX_IT_ENABLE || CAN_RX_IRQ_ENABLE */
+
+/**
+ * @brief Sample the error counters and error state from `ESR`, count the
+ *        state transitions and the errors.
+ *
+ * @param can_stats The bus statistics.
+ * @param esr Value of `ESR` register.
+ * @note Called with interrupt disabled.
+ */
+static void can_stats_sample(can_stats_t *can_stats, uint32_t esr) {
+    can_bus_stats_t *stats = &can_stats->stats;
+    uint8_t state = CAN_BUS_ACTIVE;
+
+    if (esr & CAN_ESR_BOFF) {
+        state = CAN_BUS_OFF;
+    } else if (esr & CAN_ESR_EPVF) {
+        state = CAN_BUS_PASSIVE;
+    } else if (esr & CAN_ESR_EWGF) {
+        state = CAN_BUS_WARNING;
+    }
+
+    /* Count the transitions to worse state only. */
+    if (state > stats->state) {
+        if ((state >= CAN_BUS_WARNING) && (stats->state < CAN_BUS_WARNING)) {
+            ++stats->warning_count;
+        }
+        if ((state >= CAN_BUS_PASSIVE) && (stats->state < CAN_BUS_PASSIVE)) {
+            ++stats->passive_count;
+        }
+        if (state == CAN_BUS_OFF) {
+            ++stats->bus_off_count;
+        }
+    }
+
+    stats->state = state;
+    stats->tec = (esr & CAN_ESR_TEC) >> CAN_ESR_TEC_Pos;
+    stats->rec = (esr & CAN_ESR_REC) >> CAN_ESR_REC_Pos;
+    stats->lec = (esr & CAN_ESR_LEC) >> CAN_ESR_LEC_Pos;
+}
+
+#if CAN_TX_IT_ENABLE
+
+/**
+ * @brief Count the transmitted frames in transmit interrupt.
+ *
+ * @param can_handle The handle of CAN.
+ * @param can_stats The bus statistics.
+ * @note Must be called before `HAL_CAN_IRQHandler()`, which clears the
+ *       `RQCPx` flags.
+ */
+static void can_stats_tx_irq(CAN_HandleTypeDef *can_handle,
+                             can_stats_t *can_stats) {
+    CAN_TypeDef *can = can_handle->Instance;
+    uint32_t tsr = can->TSR;
+
+    for (uint32_t mailbox = 0; mailbox < 3; ++mailbox) {
+        uint32_t ok = (CAN_TSR_RQCP0 | CAN_TSR_TXOK0) << (8 * mailbox);
+
+        if ((tsr & ok) != ok) {
+            continue;
+        }
+
+        /* The mailbox keeps the frame after transmission. */
+        uint32_t tir = can->sTxMailBox[mailbox].TIR;
+        can_stats_count(can_stats, 1,
+                        can_frame_bits(tir & CAN_TI0R_IDE, tir & CAN_TI0R_RTR,
+                                       can->sTxMailBox[mailbox].TDTR &
+                                           CAN_TDT0R_DLC));
+    }
+}
+
+#endif /* CAN_TX_IT_ENABLE */
+
+#if CAN_SCE_IT_ENABLE
+
+/**
+ * @brief Record the error state in status change and error interrupt.
+ *
+ * @param can_handle The handle of CAN.
+ * @param can_stats The bus statistics.
+ * @note Must be called before `HAL_CAN_IRQHandler()`, which clears the `LEC`.
+ */
+static void can_stats_sce_irq(CAN_HandleTypeDef *can_handle,
+                              can_stats_t *can_stats) {
+    uint32_t esr = can_handle->Instance->ESR;
+    uint32_t lec = (esr & CAN_ESR_LEC) >> CAN_ESR_LEC_Pos;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    can_stats_sample(can_stats, esr);
+
+    /* 7 is set by software, no error after it. */
+    if ((lec != 0) && (lec != 7)) {
+        ++can_stats->stats.error_count[lec];
+    }
+
+    __set_PRIMASK(primask);
+}
+
+#endif /* CAN_SCE_IT_ENABLE */
+
+#endif /* CAN1_STATS_ENABLE */
+
+#if CAN1_TX_QUEUE_ENABLE || CAN2_TX_QUEUE_ENABLE
+
+/**
+ * @brief Identify the software transmit queue of CAN.
+ *
+ * @param can_selected Specific which CAN.
+ * @return The transmit queue. Return NULL if the queue is not enabled.
+ */
+static inline can_tx_queue_t *
+can_tx_queue_identify(can_selected_t can_selected) {
+    switch (can_selected) {
+
+#if CAN1_TX_QUEUE_ENABLE
+        case can1_selected:
+            return &can1_tx_queue;
+#endif /* CAN1_TX_QUEUE_ENABLE */
+
+#if CAN2_TX_QUEUE_ENABLE
+        case can2_selected:
+            return &can2_tx_queue;
+#endif /* CAN2_TX_QUEUE_ENABLE */
+
+        default:
+            return NULL;
+    }
+}
+
+/**
+ * @brief Whether entry `a` should be sent before entry `b`.
+ *
+ * @param a Entry a.
+ * @param b Entry b.
+ * @return Return 1 if `a` has higher priority, or same priority but pushed
+ *         earlier.
+ */
+static inline uint8_t can_tx_entry_before(const can_tx_entry_t *a,
+                                          const can_tx_entry_t *b) {
+    if (a->key != b->key) {
+        return a->key < b->key;
+    }
+
+    return (int32_t)(a->seq - b->seq) < 0;
+}
+
+#if CAN_TIME_ENABLE
+
+/**
+ * @brief Record the transmit latency of entry, from pushed into queue to the
+ *        SOF on bus.
+ *
+ * @param time The time stamp extension.
+ * @param entry The entry transmitted.
+ * @param stamp The hardware time stamp of SOF.
+ */
+static void can_time_tx_complete(can_time_t *time, const can_tx_entry_t *entry,
+                                 uint16_t stamp) {
+    can_latency_stats_t *latency = &time->latency;
+    uint32_t sof = (uint32_t)can_time_extend(time, stamp);
+    uint32_t delay = sof - entry->time;
+
+    /* The time of push is estimated by ms, it may be later than the SOF of
+     * a frame sent at once. */
+    if ((int32_t)delay < 0) {
+        delay = 0;
+    }
+
+    latency->tx_timestamp = sof;
+    latency->last = delay;
+    latency->total += delay;
+    ++latency->count;
+
+    if (delay < latency->min) {
+        latency->min = delay;
+    }
+    if (delay > latency->max) {
+        latency->max = delay;
+    }
+}
+
+#endif /* CAN_TIME_ENABLE */
+
+/**
+ * @brief Insert an entry into the heap.
+ *
+ * @param tx_queue The transmit queue.
+ * @param entry The entry.
+ * @note Caller must make sure there is free place.
+ */
+static void can_tx_heap_insert(can_tx_queue_t *tx_queue,
+                               const can_tx_entry_t *entry) {
+    can_tx_entry_t *heap = tx_queue->heap;
+    uint16_t i = tx_queue->stats.depth++;
+
+    while (i != 0) {
+        uint16_t parent = (i - 1) / 2;
+        if (!can_tx_entry_before(entry, &heap[parent])) {
+            break;
+        }
+        heap[i] = heap[parent];
+        i = parent;
+    }
+
+    heap[i] = *entry;
+
+    if (tx_queue->stats.depth > tx_queue->stats.max_depth) {
+        tx_queue->stats.max_depth = tx_queue->stats.depth;
+    }
+}
+
+/**
+ * @brief Remove the top (highest priority) entry of the heap.
+ *
+ * @param tx_queue The transmit queue, must not be empty.
+ */
+static void can_tx_heap_remove_top(can_tx_queue_t *tx_queue) {
+    can_tx_entry_t *heap = tx_queue->heap;
+    uint16_t depth = --tx_queue->stats.depth;
+    const can_tx_entry_t *last = &heap[depth];
+    uint16_t i = 0;
+
+    while (1) {
+        uint16_t child = 2 * i + 1;
+        if (child >= depth) {
+            break;
+        }
+        if ((child + 1 < depth) &&
+            can_tx_entry_before(&heap[child + 1], &heap[child])) {
+            ++child;
+        }
+        if (!can_tx_entry_before(&heap[child], last)) {
+            break;
+        }
+        heap[i] = heap[child];
+        i = child;
+    }
+
+    heap[i] = *last;
+}
+
+/**
+ * @brief Clear the software transmit queue and the statistics.
+ *
+ * @param tx_queue The transmit queue.
+ */
+static void can_tx_queue_reset(can_tx_queue_t *tx_queue) {
+    tx_queue->mailbox_used = 0;
+    tx_queue->mailbox_abort = 0;
+    tx_queue->paused = 0;
+    tx_queue->seq = 0;
+    memset(&tx_queue->stats, 0, sizeof(tx_queue->stats));
+}
+
+/**
+ * @brief Release a completed mailbox, queue the aborted frame again.
+ *
+ * @param can_handle The handle of CAN.
+ * @param tx_queue The transmit queue.
+ * @param mailbox The mailbox number (0-2).
+ * @param flags `RQCP0`, `TXOK0` of `TSR`, shifted to mailbox 0. Without
+ *              `RQCP0` the flags are lost and `TXOK0` is a guess.
+ */
+static void can_tx_queue_finish(CAN_HandleTypeDef *can_handle,
+                                can_tx_queue_t *tx_queue, uint32_t mailbox,
+                                uint32_t flags) {
+    uint32_t mask = 1U << mailbox;
+
+    tx_queue->mailbox_used &= ~mask;
+
+    if (flags & CAN_TSR_TXOK0) {
+        ++tx_queue->stats.sent;
+#if CAN_TIME_ENABLE
+        can_time_t *time = can_time_identify(can_handle);
+        if ((time != NULL) && (flags & CAN_TSR_RQCP0)) {
+            can_time_tx_complete(
+                time, &tx_queue->mailbox[mailbox],
+                can_handle->Instance->sTxMailBox[mailbox].TDTR >>
+                    CAN_TDT0R_TIME_Pos);
+        }
+#else  /* CAN_TIME_ENABLE */
+        UNUSED(can_handle);
+#endif /* CAN_TIME_ENABLE */
+    } else if (tx_queue->mailbox_abort & mask) {
+        /* Aborted before transmission, keep the original sequence so it
+         * is still sent before the later frames with the same ID. */
+        can_tx_heap_insert(tx_queue, &tx_queue->mailbox[mailbox]);
+        ++tx_queue->stats.aborted;
+    } else {
+        ++tx_queue->stats.dropped;
+    }
+
+    tx_queue->mailbox_abort &= ~mask;
+}
+
+/**
+ * @brief Check the completed mailboxes, queue the aborted frames again.
+ *
+ * @param can_handle The handle of CAN.
+ * @param tx_queue The transmit queue.
+ * @note Must be called before `HAL_CAN_IRQHandler()`, which clears the
+ *       `RQCPx` flags.
+ */
+static void can_tx_queue_complete(CAN_HandleTypeDef *can_handle,
+                                  can_tx_queue_t *tx_queue) {
+    uint32_t tsr = can_handle->Instance->TSR;
+
+    for (uint32_t mailbox = 0; mailbox < 3; ++mailbox) {
+        uint32_t flags = tsr >> (8 * mailbox);
+
+        if ((tx_queue->mailbox_used & (1U << mailbox)) == 0) {
+            continue;
+        }
+
+        if (flags & CAN_TSR_RQCP0) {
+            can_tx_queue_finish(can_handle, tx_queue, mailbox, flags);
+        } else if (tsr & (CAN_TSR_TME0 << mailbox)) {
+            /* Completed after the last check, `HAL_CAN_IRQHandler()` has
+             * cleared the flags. Only an aborted frame is not sent. */
+            can_tx_queue_finish(can_handle, tx_queue, mailbox,
+                                (tx_queue->mailbox_abort & (1U << mailbox))
+                                    ? 0
+                                    : CAN_TSR_TXOK0);
+        }
+    }
+}
+
+/**
+ * @brief Load the queued frames into the free mailboxes. If all mailboxes are
+ *        busy and the top frame has higher priority than one of them, abort
+ *        the lowest priority mailbox. The aborted frame will be queued again
+ *        in `can_tx_queue_complete()`.
+ *
+ * @param can_handle The handle of CAN.
+ * @param tx_queue The transmit queue.
+ * @note Called with interrupt disabled.
+ */
+static void can_tx_queue_drain(CAN_HandleTypeDef *can_handle,
+                               can_tx_queue_t *tx_queue) {
+    uint32_t mailbox;
+
+    if (tx_queue->paused) {
+        return;
+    }
+
+    /* Loading a mailbox clears its `RQCPx`, take the completed ones first. */
+    can_tx_queue_complete(can_handle, tx_queue);
+
+    while ((tx_queue->stats.depth != 0) &&
+           (HAL_CAN_GetTxMailboxesFreeLevel(can_handle) != 0)) {
+        /* bxCAN sends the pending mailboxes with the same ID by mailbox
+         * number, not by load order. The next frame of this ID waits until
+         * the earlier one is completed. */
+        for (mailbox = 0; mailbox < 3; ++mailbox) {
+            if ((tx_queue->mailbox_used & (1U << mailbox)) &&
+                (tx_queue->mailbox[mailbox].key == tx_queue->heap[0].key)) {
+                break;
+            }
+        }
+        if (mailbox < 3) {
+            break;
+        }
+
+        if (can_tx_write(can_handle, tx_queue->heap[0].key,
+                         &tx_queue->heap[0].frame, &mailbox) != 0) {
+            return;
+        }
+
+        if (tx_queue->mailbox_used & (1U << mailbox)) {
+            /* Completed after `can_tx_queue_complete()`, the flags are
+             * cleared by this load. */
+            can_tx_queue_finish(can_handle, tx_queue, mailbox,
+                                (tx_queue->mailbox_abort & (1U << mailbox))
+                                    ? 0
+                                    : CAN_TSR_TXOK0);
+        }
+
+        tx_queue->mailbox[mailbox] = tx_queue->heap[0];
+        tx_queue->mailbox_used |= 1U << mailbox;
+        can_tx_heap_remove_top(tx_queue);
+    }
+
+    /* Only one abort request at the same time, the urgent frame will wait at
+     * most one frame time plus the abort. */
+    if ((tx_queue->stats.depth == 0) || (tx_queue->preempt == 0) ||
+        (tx_queue->mailbox_abort != 0) || (tx_queue->mailbox_used != 0x07)) {
+        return;
+    }
+
+    /* Find the lowest priority mailbox. */
+    uint32_t lowest = 0;
+    for (mailbox = 1; mailbox < 3; ++mailbox) {
+        if (can_tx_entry_before(&tx_queue->mailbox[lowest],
+                                &tx_queue->mailbox[mailbox])) {
+            lowest = mailbox;
+        }
+    }
+
+    if (tx_queue->heap[0].key < tx_queue->mailbox[lowest].key) {
+        tx_queue->mailbox_abort = 1U << lowest;
+        HAL_CAN_AbortTxRequest(can_handle, CAN_TX_MAILBOX0 << lowest);
+    }
+}
+
+/**
+ * @brief Transmit interrupt handler of CAN with software transmit queue.
+ *
+ * @param can_handle The handle of CAN.
+ * @param tx_queue The transmit queue.
+ */
+static void can_tx_queue_irq_handler(CAN_HandleTypeDef *can_handle,
+                                     can_tx_queue_t *tx_queue) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    can_tx_queue_complete(can_handle, tx_queue);
+    HAL_CAN_IRQHandler(can_handle);
+    can_tx_queue_drain(can_handle, tx_queue);
+
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Push a frame into the software transmit queue.
+ *
+ * @param can_handle The handle of CAN.
+ * @param tx_queue The transmit queue.
+ * @param id_word The ID word of frame, it's the key of queue.
+ * @param frame The frame to send.
+ * @return Push status.
+ *  @retval - 0: Success.
+ *  @retval - 2: The queue is full, the frame is dropped.
+ * @note It's O(log n) and can be called in ISR.
+ */
+static uint8_t can_tx_queue_push(CAN_HandleTypeDef *can_handle,
+                                 can_tx_queue_t *tx_queue, uint32_t id_word,
+                                 const can_frame_t *frame) {
+    can_tx_entry_t entry = {.key = id_word, .frame = *frame};
+
+#if CAN_TIME_ENABLE
+    can_time_t *time = can_time_identify(can_handle);
+    if (time != NULL) {
+        entry.time = (uint32_t)can_time_now(time);
+    }
+#endif /* CAN_TIME_ENABLE */
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (tx_queue->stats.depth >= tx_queue->size) {
+        ++tx_queue->stats.dropped;
+        __set_PRIMASK(primask);
+        return 2;
+    }
+
+    entry.seq = tx_queue->seq++;
+    can_tx_heap_insert(tx_queue, &entry);
+    ++tx_queue->stats.queued;
+
+    /* Send it immediately if there is a free mailbox. */
+    can_tx_queue_drain(can_handle, tx_queue);
+
+    __set_PRIMASK(primask);
+
+    return 0;
+}
+
+/**
+ * @brief Push frames into the software transmit queue in one critical
+ *        section.
+ *
+ * @param can_handle The handle of CAN.
+ * @param tx_queue The transmit queue.
+ * @param frames The frames to send.
+ * @param count Number of frames.
+ * @return The number of frames pushed, the others are not dropped.
+ */
+static uint32_t can_tx_queue_push_batch(CAN_HandleTypeDef *can_handle,
+                                        can_tx_queue_t *tx_queue,
+                                        const can_frame_t *frames,
+                                        uint32_t count) {
+    can_tx_entry_t entry = {0};
+    uint32_t pushed;
+
+#if CAN_TIME_ENABLE
+    can_time_t *time = can_time_identify(can_handle);
+    if (time != NULL) {
+        entry.time = (uint32_t)can_time_now(time);
+    }
+#endif /* CAN_TIME_ENABLE */
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    for (pushed = 0; pushed < count; ++pushed) {
+        if (tx_queue->stats.depth >= tx_queue->size) {
+            /* Move the top frames into the free mailboxes to make place. */
+            can_tx_queue_drain(can_handle, tx_queue);
+            if (tx_queue->stats.depth >= tx_queue->size) {
+                break;
+            }
+        }
+
+        entry.key = can_frame_id_word(&frames[pushed]);
+        entry.seq = tx_queue->seq++;
+        entry.frame = frames[pushed];
+        can_tx_heap_insert(tx_queue, &entry);
+        ++tx_queue->stats.queued;
+    }
+
+    can_tx_queue_drain(can_handle, tx_queue);
+
+    __set_PRIMASK(primask);
+
+    return pushed;
+}
+
+#if CAN_RECOVERY_ENABLE
+
+/**
+ * @brief Pause or resume the software transmit queue. When paused, the
+ *        frames in mailboxes are aborted and go back to the queue, so they
+ *        are sent by priority after resumed.
+ *
+ * @param can_handle The handle of CAN.
+ * @param tx_queue The transmit queue.
+ * @param paused 0: Resume, 1: Pause.
+ * @note Called with interrupt disabled.
+ */
+static void can_tx_queue_pause(CAN_HandleTypeDef *can_handle,
+                               can_tx_queue_t *tx_queue, uint8_t paused) {
+    tx_queue->paused = paused;
+
+    if (paused == 0) {
+        can_tx_queue_drain(can_handle, tx_queue);
+        return;
+    }
+
+    /* The aborted frames are queued again in `can_tx_queue_complete()`. */
+    uint8_t abort = tx_queue->mailbox_used & ~tx_queue->mailbox_abort;
+    if (abort != 0) {
+        tx_queue->mailbox_abort |= abort;
+        HAL_CAN_AbortTxRequest(can_handle, CAN_TX_MAILBOX0 * abort);
+    }
+}
+
+#endif /* CAN_RECOVERY_ENABLE */
+
+#endif /* CAN1_TX_QUEUE_ENABLE || CAN2_TX_QUEUE_ENABLE */
+
+#if CAN_GATEWAY_ENABLE || CAN_SCHED_ENABLE || CAN_RESPOND_ENABLE
+
+/**
+ * @brief Send the frame, never wait for a free mailbox.
+ *
+ * @param can_selected The CAN to send.
+ * @param frame The frame.
+ * @return Return 0 if the frame is loaded into mailbox or pushed into queue.
+ * @note Can be called in ISR.
+ */
+static uint8_t can_send_nowait(can_selected_t can_selected,
+                               const can_frame_t *frame) {
+    CAN_HandleTypeDef *can_handle = can_get_handle(can_selected);
+    if ((can_handle == NULL) ||
+        (HAL_CAN_GetState(can_handle) == HAL_CAN_STATE_RESET)) {
+        return 1;
+    }
+
+#if CAN1_TX_QUEUE_ENABLE || CAN2_TX_QUEUE_ENABLE
+    can_tx_queue_t *tx_queue = can_tx_queue_identify(can_selected);
+    if (tx_queue != NULL) {
+        return can_tx_queue_push(can_handle, tx_queue,
+                                 can_frame_id_word(frame), frame);
+    }
+#endif /* CAN1_TX_QUEUE_ENABLE || CAN2_TX_QUEUE_ENABLE */
+
+    return can_tx_write(can_handle, can_frame_id_word(frame), frame, NULL);
+}
+
+#endif /* CAN_GATEWAY_ENABLE || CAN_SCHED_ENABLE || CAN_RESPOND_ENABLE */
+
+#if CAN_ISOTP_ENABLE || CAN_J1939_ENABLE
+
+/**
+ * @brief Load a frame of transport protocol, never wait for a free mailbox.
+ *        If the transmit queue is enabled, the frame goes through it, so it
+ *        doesn't overtake the queued frames.
+ *
+ * @param can_selected The CAN to send.
+ * @param id_word The ID word of frame.
+ * @param frame The frame.
+ * @return Return 0 if the frame is loaded into mailbox or pushed into queue,
+ *         otherwise try again in transmit interrupt.
+ * @note Called with interrupt disabled. The frame is pushed only if the queue
+ *       is empty, so a transfer never fills the queue.
+ */
+static uint8_t can_tp_write(can_selected_t can_selected, uint32_t id_word,
+                            const can_frame_t *frame) {
+    CAN_HandleTypeDef *can_handle = can_get_handle(can_selected);
+
+#if CAN1_TX_QUEUE_ENABLE || CAN2_TX_QUEUE_ENABLE
+    can_tx_queue_t *tx_queue = can_tx_queue_identify(can_selected);
+    if (tx_queue != NULL) {
+        if (tx_queue->stats.depth != 0) {
+            return 2;
+        }
+
+        return can_tx_queue_push(can_handle, tx_queue, id_word, frame);
+    }
+#endif /* CAN1_TX_QUEUE_ENABLE || CAN2_TX_QUEUE_ENABLE */
+
+    return can_tx_write(can_handle, id_word, frame, NULL);
+}
+
+#endif /* CAN_ISOTP_ENABLE || CAN_J1939_ENABLE */
+
+#if CAN_RECOVERY_ENABLE
+
+/**
+ * @brief Identify the bus-off recovery of CAN.
+ *
+ * @param can_handle The handle of CAN.
+ * @return The bus-off recovery.
+ */
+static inline can_recovery_t *
+can_recovery_identify(CAN_HandleTypeDef *can_handle) {
+#if CAN2_ENABLE
+    if (can_handle->Instance == CAN2) {
+        return &can2_recovery;
+    }
+#endif /* CAN2_ENABLE */
+
+    UNUSED(can_handle);
+    return &can1_recovery;
+}
+
+/**
+ * @brief Pause or resume the transmit queue of CAN, if it's enabled.
+ *
+ * @param can_handle The handle of CAN.
+ * @param paused 0: Resume, 1: Pause.
+ * @note Called with interrupt disabled.
+ */
+static void can_recovery_pause(CAN_HandleTypeDef *can_handle, uint8_t paused) {
+#if CAN1_TX_QUEUE_ENABLE || CAN2_TX_QUEUE_ENABLE
+    can_tx_queue_t *tx_queue = can_tx_queue_identify(
+        (can_handle->Instance == CAN1) ? can1_selected : can2_selected);
+    if (tx_queue != NULL) {
+        can_tx_queue_pause(can_handle, tx_queue, paused);
+    }
+#else  /* CAN1_TX_QUEUE_ENABLE || CAN2_TX_QUEUE_ENABLE */
+    UNUSED(can_handle);
+    UNUSED(paused);
+#endif /* CAN1_TX_QUEUE_ENABLE || CAN2_TX_QUEUE_ENABLE */
+}
+
+/**
+ * @brief CAN went bus-off, wait for the backoff time before recovery.
+ *
+ * @param can_handle The handle of CAN.
+ * @param recovery The bus-off recovery.
+ * @note Called with interrupt disabled.
+ */
+static void can_recovery_enter(CAN_HandleTypeDef *can_handle,
+                               can_recovery_t *recovery) {
+    if (recovery->state == CAN_RECOVER_WAIT) {
+        return;
+    }
+
+    if (recovery->state == CAN_RECOVER_BUSY) {
+        /* Went bus-off again before recovered. */
+        ++recovery->attempt;
+    } else {
+        can_recovery_pause(can_handle, 1);
+    }
+
+    uint32_t backoff = CAN_BUS_OFF_BACKOFF_MIN;
+    for (uint8_t i = 0; (i < recovery->attempt) &&
+                        (backoff < CAN_BUS_OFF_BACKOFF_MAX);
+         ++i) {
+        backoff *= 2;
+    }
+    if (backoff > CAN_BUS_OFF_BACKOFF_MAX) {
+        backoff = CAN_BUS_OFF_BACKOFF_MAX;
+    }
+
+    recovery->deadline = HAL_GetTick() + backoff;
+    recovery->state = CAN_RECOVER_WAIT;
+}
+
+/**
+ * @brief CAN recovered from bus-off, resume the transmit queue.
+ *
+ * @param can_handle The handle of CAN.
+ * @param recovery The bus-off recovery.
+ * @note Called with interrupt disabled.
+ */
+static void can_recovery_done(CAN_HandleTypeDef *can_handle,
+                              can_recovery_t *recovery) {
+    recovery->state = CAN_RECOVER_NONE;
+    recovery->recovered_tick = HAL_GetTick();
+    can_recovery_pause(can_handle, 0);
+}
+
+#if CAN_SCE_IT_ENABLE
+
+/**
+ * @brief Handle bus-off in status change and error interrupt.
+ *
+ * @param can_handle The handle of CAN.
+ * @param recovery The bus-off recovery.
+ */
+static void can_recovery_sce_irq(CAN_HandleTypeDef *can_handle,
+                                 can_recovery_t *recovery) {
+    uint32_t esr = can_handle->Instance->ESR;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (esr & CAN_ESR_BOFF) {
+        can_recovery_enter(can_handle, recovery);
+    } else if (recovery->state == CAN_RECOVER_BUSY) {
+        can_recovery_done(can_handle, recovery);
+    }
+
+    __set_PRIMASK(primask);
+}
+
+#endif /* CAN_SCE_IT_ENABLE */
+
+#endif /* CAN_RECOVERY_ENABLE */
+
+#if CAN_RX_RING_ENABLE
+
+/**
+ * @brief Identify the software receive ring of CAN FIFO.
+ *
+ * @param can_selected Specific which CAN.
+ * @param rx_fifo `CAN_RX_FIFO0` or `CAN_RX_FIFO1`.
+ * @return The receive ring. Return NULL if the ring is not enabled.
+ */
+static inline can_rx_ring_t *can_rx_ring_identify(can_selected_t can_selected,
+                                                  uint32_t rx_fifo) {
+    switch (can_selected) {
+
+#if CAN1_ENABLE
+        case can1_selected: {
+#if CAN1_RX0_RING_ENABLE
+            if (rx_fifo == CAN_RX_FIFO0) {
+                return &can1_rx0_ring;
+            }
+#endif /* CAN1_RX0_RING_ENABLE */
+
+#if CAN1_RX1_RING_ENABLE
+            if (rx_fifo == CAN_RX_FIFO1) {
+                return &can1_rx1_ring;
+            }
+#endif /* CAN1_RX1_RING_ENABLE */
+        } break;
+#endif /* CAN1_ENABLE */
+
+#if CAN2_ENABLE
+        case can2_selected: {
+#if CAN2_RX0_RING_ENABLE
+            if (rx_fifo == CAN_RX_FIFO0) {
+                return &can2_rx0_ring;
+            }
+#endif /* CAN2_RX0_RING_ENABLE */
+
+#if CAN2_RX1_RING_ENABLE
+            if (rx_fifo == CAN_RX_FIFO1) {
+                return &can2_rx1_ring;
+            }
+#endif /* CAN2_RX1_RING_ENABLE */
+        } break;
+#endif /* CAN2_ENABLE */
+
+        default:
+            break;
+    }
+
+    UNUSED(rx_fifo);
+    return NULL;
+}
+
+/**
+ * @brief Clear the software receive ring.
+ *
+ * @param rx_ring The receive ring.
+ */
+static void can_rx_ring_reset(can_rx_ring_t *rx_ring) {
+    rx_ring->head = 0;
+    rx_ring->tail = 0;
+    rx_ring->dropped = 0;
+}
+
+/**
+ * @brief Read frames from the receive ring.
+ *
+ * @param rx_ring The receive ring.
+ * @param[out] frames The buffer to store frames.
+ * @param max The maximum number of frames to read.
+ * @return The number of frames read.
+ */
+static uint32_t can_rx_ring_read(can_rx_ring_t *rx_ring, can_frame_t *frames,
+                                 uint32_t max) {
+    uint16_t head = rx_ring->head;
+    uint16_t tail = rx_ring->tail;
+    uint32_t count = 0;
+
+    /* Read `head` before the frames. */
+    __DMB();
+
+    while ((tail != head) && (count < max)) {
+        frames[count++] = rx_ring->frames[tail];
+        if (++tail == rx_ring->size) {
+            tail = 0;
+        }
+    }
+
+    /* Make sure the frames are copied before the ISR overwrite them. */
+    __DMB();
+    rx_ring->tail = tail;
+
+    return count;
+}
+
+#endif /* CAN_RX_RING_ENABLE */
+
+#if CAN_RX_IRQ_ENABLE
+
+/**
+ * @brief Read a frame from the output mailbox of hardware FIFO and release
+ *        it.
+ *
+ * @param can_handle The handle of CAN.
+ * @param rx_fifo `CAN_RX_FIFO0` or `CAN_RX_FIFO1`.
+ * @param[out] frame The frame read.
+ * @return Read status.
+ *  @retval - 0: Success.
+ *  @retval - 1: FIFO is empty or HAL error.
+ */
+static uint8_t can_rx_read(CAN_HandleTypeDef *can_handle, uint32_t rx_fifo,
+                           can_frame_t *frame) {
+#if CAN_FAST_PATH
+    CAN_TypeDef *can = can_handle->Instance;
+    __IO uint32_t *rfr = (rx_fifo == CAN_RX_FIFO0) ? &can->RF0R : &can->RF1R;
+
+    if ((*rfr & CAN_RF0R_FMP0) == 0) {
+        return 1;
+    }
+
+    CAN_FIFOMailBox_TypeDef *rx_mailbox = &can->sFIFOMailBox[rx_fifo];
+    uint32_t rir = rx_mailbox->RIR;
+    uint32_t rdtr = rx_mailbox->RDTR;
+    uint32_t rdlr = rx_mailbox->RDLR;
+    uint32_t rdhr = rx_mailbox->RDHR;
+
+    /* Release the output mailbox. `RFOM1` is same as `RFOM0`. */
+    *rfr = CAN_RF0R_RFOM0;
+
+    frame->ide = rir & CAN_RI0R_IDE;
+    frame->rtr = rir & CAN_RI0R_RTR;
+    frame->id = (frame->ide == CAN_ID_STD) ? (rir >> CAN_RI0R_STID_Pos)
+                                           : (rir >> CAN_RI0R_EXID_Pos);
+    frame->dlc = rdtr & CAN_RDT0R_DLC;
+    frame->fmi = (rdtr & CAN_RDT0R_FMI) >> CAN_RDT0R_FMI_Pos;
+    frame->timestamp = (rdtr & CAN_RDT0R_TIME) >> CAN_RDT0R_TIME_Pos;
+    memcpy(&frame->data[0], &rdlr, 4);
+    memcpy(&frame->data[4], &rdhr, 4);
+
+    return 0;
+#else  /* CAN_FAST_PATH */
+    CAN_RxHeaderTypeDef rx_header;
+
+    if (HAL_CAN_GetRxMessage(can_handle, rx_fifo, &rx_header, frame->data) !=
+        HAL_OK) {
+        return 1;
+    }
+
+    frame->ide = rx_header.IDE;
+    frame->rtr = rx_header.RTR;
+    frame->dlc = rx_header.DLC;
+    frame->fmi = rx_header.FilterMatchIndex;
+    frame->timestamp = rx_header.Timestamp;
+    frame->id =
+        (rx_header.IDE == CAN_ID_STD) ? rx_header.StdId : rx_header.ExtId;
+
+    return 0;
+#endif /* CAN_FAST_PATH */
+}
+
+/**
+ * @brief Read all pending frames of hardware FIFO, forward the frames by
+ *        gateway, pass the ISO-TP frames to the channels, drop the
+ *        unchanged frames, call the handlers by the dispatch table, and put
+ *        the others into the receive ring.
+ *
+ * @param can_handle The handle of CAN.
+ * @param rx_fifo `CAN_RX_FIFO0` or `CAN_RX_FIFO1`.
+ * @param rx_ring The receive ring, NULL if the ring is not enabled.
+ * @note Called in receive interrupt before `HAL_CAN_IRQHandler()`, so the
+ *       HAL message pending callback is not called for these frames.
+ */
+static void can_rx_irq_handler(CAN_HandleTypeDef *can_handle, uint32_t rx_fifo,
+                               can_rx_ring_t *rx_ring) {
+    can_frame_t frame;
+
+#if CAN_RX_IRQ_HOOK || CAN_CHANGE_ENABLE
+    can_selected_t can_selected =
+        (can_handle->Instance == CAN1) ? can1_selected : can2_selected;
+#endif /* CAN_RX_IRQ_HOOK || CAN_CHANGE_ENABLE */
+
+#if CAN_TIME_ENABLE
+    can_time_t *time = can_time_identify(can_handle);
+#endif /* CAN_TIME_ENABLE */
+
+#if CAN1_STATS_ENABLE
+    can_stats_t *can_stats = can_stats_identify(can_handle);
+#endif /* CAN1_STATS_ENABLE */
+
+    while (can_rx_read(can_handle, rx_fifo, &frame) == 0) {
+#if CAN_TIME_ENABLE
+        if (time != NULL) {
+            /* Extend it in ISR, the frame may stay in ring for a long time. */
+            frame.timestamp = (uint32_t)can_time_extend(time, frame.timestamp);
+        }
+#endif /* CAN_TIME_ENABLE */
+
+#if CAN1_STATS_ENABLE
+        can_stats_count(can_stats, 0,
+                        can_frame_bits(frame.ide, frame.rtr, frame.dlc));
+#endif /* CAN1_STATS_ENABLE */
+
+#if CAN_RESPOND_ENABLE
+        if (can_respond_rx_frame(can_selected, &frame) == 0) {
+            continue;
+        }
+#endif /* CAN_RESPOND_ENABLE */
+
+#if CAN_GATEWAY_ENABLE
+        if (can_gateway_rx_frame(can_selected, &frame) == 0) {
+            continue;
+        }
+#endif /* CAN_GATEWAY_ENABLE */
+
+#if CAN_ISOTP_ENABLE
+        if (can_isotp_rx_frame(can_selected, &frame) == 0) {
+            continue;
+        }
+#endif /* CAN_ISOTP_ENABLE */
+
+#if CAN_J1939_ENABLE
+        if (can_j1939_rx_frame(can_selected, &frame) == 0) {
+            continue;
+        }
+#endif /* CAN_J1939_ENABLE */
+
+#if CAN_CHANGE_ENABLE
+        if (can_change_rx_frame(can_selected, &frame) == 0) {
+            continue;
+        }
+#endif /* CAN_CHANGE_ENABLE */
+
+#if CAN_DISPATCH_IRQ
+        if (can_dispatch_frame(can_selected, rx_fifo, &frame) == 0) {
+            continue;
+        }
+#endif /* CAN_DISPATCH_IRQ */
+
+        if (rx_ring == NULL) {
+            continue;
+        }
+
+        uint16_t head = rx_ring->head;
+        uint16_t next = head + 1;
+        if (next == rx_ring->size) {
+            next = 0;
+        }
+
+        if (next == rx_ring->tail) {
+            /* Ring is full, the FIFO output mailbox is released anyway. */
+            ++rx_ring->dropped;
+            continue;
+        }
+
+        rx_ring->frames[head] = frame;
+
+        /* Make sure the frame is written before the reader see it. */
+        __DMB();
+        rx_ring->head = next;
+    }
+}
+
+#endif /* CAN_RX_IRQ_ENABLE */
+
+/**
+ * @brief Send a frame, queue it if the software transmit queue is enabled,
+ *        otherwise wait for a free mailbox.
+ *
+ * @param can_selected Specific which CAN to send message.
+ * @param id_word The ID word of frame, see `CAN_ID_WORD_xxx()`.
+ * @param frame The frame to send.
+ * @return Send status.
+ *  @retval - 0: Success.
+ *  @retval - 1: Send error.
+ *  @retval - 2: Timeout, or the transmit queue is full.
+ *  @retval - 3: Parameter invalid.
+ *  @retval - 4: This CAN is not initialized.
+ */
+static uint8_t can_send_frame(can_selected_t can_selected, uint32_t id_word,
+                              const can_frame_t *frame) {
+    CAN_HandleTypeDef *can_handle = can_get_handle(can_selected);
+    if (can_handle == NULL) {
+        return 3;
+    }
+
+    if (frame->dlc > 8) {
+        return 3;
+    }
+
+    if (HAL_CAN_GetState(can_handle) == HAL_CAN_STATE_RESET) {
+        return 4;
+    }
+
+#if CAN1_TX_QUEUE_ENABLE || CAN2_TX_QUEUE_ENABLE
+    can_tx_queue_t *tx_queue = can_tx_queue_identify(can_selected);
+    if (tx_queue != NULL) {
+        return can_tx_queue_push(can_handle, tx_queue, id_word, frame);
+    }
+#endif /* CAN1_TX_QUEUE_ENABLE || CAN2_TX_QUEUE_ENABLE */
+
+    uint16_t wait_time = 0;
+
+    while (HAL_CAN_GetTxMailboxesFreeLevel(can_handle) == 0) {
+        /* Wait to all mailbox is empty. */
+        ++wait_time;
+        if (wait_time > CAN_SEND_TIMEOUT) {
+            return 2;
+        }
+    }
+
+    return can_tx_write(can_handle, id_word, frame, NULL);
+}
+
+/**
+ * @brief CAN send message.
+ *
+ * @param can_selected Specific which CAN to send message.
+ * @param can_ide Specific standard ID or Extend ID.
+ * @param id Specific message id.
+ * @param len Specific message length.
+ * @param msg Specific message content.
+ * @return Send status.
+ *  @retval - 0: Success.
+ *  @retval - 1: Send error.
+ *  @retval - 2: Timeout, or the transmit queue is full.
+ *  @retval - 3: Parameter invalid.
+ *  @retval - 4: This CAN is not initialized.
+ * @note If the software transmit queue is enabled (`CANx_TX_QUEUE_SIZE`), the
+ *       frame is queued and sent in transmit interrupt, it never waits for a
+ *       free mailbox and can be called in ISR. The queued frames are sent in
+ *       order of arbitration priority (smaller ID first), frames with same ID
+ *       keep the order of calls.
+ */
+uint8_t can_send_message(can_selected_t can_selected, uint32_t can_ide,
+                         uint32_t id, uint8_t len, const uint8_t *msg) {
+    if ((len > 8) || ((len != 0) && (msg == NULL))) {
+        return 3;
+    }
+
+    can_frame_t frame = {
+        .id = id, .ide = can_ide, .rtr = CAN_RTR_DATA, .dlc = len};
+    if (len != 0) {
+        memcpy(frame.data, msg, len);
+    }
+
+    uint32_t id_word = (can_ide == CAN_ID_STD) ? CAN_ID_WORD_STD(id)
+                                               : CAN_ID_WORD_EXT(id);
+
+    return can_send_frame(can_selected, id_word, &frame);
+}
+
+/**
+ * @brief CAN send remote message.
+ *
+ * @param can_selected Specific which CAN to send message.
+ * @param can_ide Specific standard ID or Extend ID.
+ * @param id Specific message id.
+ * @param len Specific message length.
+ * @param msg Specific message content.
+ * @return Send status.
+ *  @retval - 0: Success.
+ *  @retval - 1: Send error.
+ *  @retval - 2: Timeout, or the transmit queue is full.
+ *  @retval - 3: Parameter invalid.
+ *  @retval - 4: This CAN is not initialized.
+ * @note Same as `can_send_message()` when the transmit queue is enabled.
+ */
+uint8_t can_send_remote(can_selected_t can_selected, uint32_t can_ide,
+                        uint32_t id, uint8_t len, const uint8_t *msg) {
+    if ((len > 8) || ((len != 0) && (msg == NULL))) {
+        return 3;
+    }
+
+    can_frame_t frame = {
+        .id = id, .ide = can_ide, .rtr = CAN_RTR_REMOTE, .dlc = len};
+    if (len != 0) {
+        memcpy(frame.data, msg, len);
+    }
+
+    uint32_t id_word = (can_ide == CAN_ID_STD) ? CAN_ID_WORD_STD(id)
+                                               : CAN_ID_WORD_EXT(id);
+
+    return can_send_frame(can_selected, id_word | CAN_ID_WORD_RTR, &frame);
+}
+
+/**
+ * @brief CAN send message with precomputed ID word.
+ *
+ * @param can_selected Specific which CAN to send message.
+ * @param id_word The ID word, make it by `CAN_ID_WORD_STD()` or
+ *                `CAN_ID_WORD_EXT()`, or with `CAN_ID_WORD_RTR` to send remote
+ *                frame. It's written into `TIxR` register directly in fast
+ *                path (`CAN_FAST_PATH`).
+ * @param len Specific message length.
+ * @param msg Specific message content.
+ * @return Send status. Same as `can_send_message()`.
+ */
+uint8_t can_send_word(can_selected_t can_selected, uint32_t id_word,
+                      uint8_t len, const uint8_t *msg) {
+    if ((len > 8) || ((len != 0) && (msg == NULL))) {
+        return 3;
+    }
+
+    can_frame_t frame = {.ide = id_word & CAN_ID_EXT,
+                         .rtr = id_word & CAN_RTR_REMOTE,
+                         .dlc = len};
+    frame.id = (frame.ide == CAN_ID_STD) ? (id_word >> CAN_TI0R_STID_Pos)
+                                         : (id_word >> CAN_TI0R_EXID_Pos);
+    if (len != 0) {
+        memcpy(frame.data, msg, len);
+    }
+
+    return can_send_frame(can_selected, id_word & ~CAN_TI0R_TXRQ, &frame);
+}
+
+/**
+ * @brief Send frames, load them into the free mailboxes, or push them into
+ *        the software transmit queue if it's enabled.
+ *
+ * @param can_selected Specific which CAN to send message.
+ * @param frames The frames to send, `id`, `ide`, `rtr`, `dlc` and `data`
+ *               are used.
+ * @param count Number of frames.
+ * @return The number of frames sent or queued, from the first frame. The
+ *         others are not sent, e.g. mailboxes or queue is full, or the frame
+ *         is invalid. Return 0 if parameter invalid or this CAN is not
+ *         initialized.
+ * @note It never waits for a free mailbox. The handle and state are checked
+ *       once for all frames.
+ */
+uint32_t can_send_batch(can_selected_t can_selected, const can_frame_t *frames,
+                        uint32_t count) {
+    CAN_HandleTypeDef *can_handle = can_get_handle(can_selected);
+    if ((can_handle == NULL) || (frames == NULL)) {
+        return 0;
+    }
+
+    if (HAL_CAN_GetState(can_handle) == HAL_CAN_STATE_RESET) {
+        return 0;
+    }
+
+    /* Stop at the first invalid frame. */
+    uint32_t valid = 0;
+    while ((valid < count) && (frames[valid].dlc <= 8)) {
+        ++valid;
+    }
+
+#if CAN1_TX_QUEUE_ENABLE || CAN2_TX_QUEUE_ENABLE
+    can_tx_queue_t *tx_queue = can_tx_queue_identify(can_selected);
+    if (tx_queue != NULL) {
+        return can_tx_queue_push_batch(can_handle, tx_queue, frames, valid);
+    }
+#endif /* CAN1_TX_QUEUE_ENABLE || CAN2_TX_QUEUE_ENABLE */
+
+    uint32_t sent = 0;
+    while ((sent < valid) &&
+           (can_tx_write(can_handle, can_frame_id_word(&frames[sent]),
+                         &frames[sent], NULL) == 0)) {
+        ++sent;
+    }
+
+    return sent;
+}
+
+/**
+ * @brief Get the statistics of software transmit queue.
+ *
+ * @param can_selected Specific which CAN.
+ * @param[out] stats The statistics.
+ * @return Get status.
+ *  @retval - 0: Success.
+ *  @retval - 1: The transmit queue of this CAN is not enabled.
+ *  @retval - 3: Parameter invalid.
+ */
+uint8_t can_tx_queue_get_stats(can_selected_t can_selected,
+                               can_tx_queue_stats_t *stats) {
+    if (stats == NULL) {
+        return 3;
+    }
+
+#if CAN1_TX_QUEUE_ENABLE || CAN2_TX_QUEUE_ENABLE
+    can_tx_queue_t *tx_queue = can_tx_queue_identify(can_selected);
+    if (tx_queue != NULL) {
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+        *stats = tx_queue->stats;
+        __set_PRIMASK(primask);
+        return 0;
+    }
+#else  /* CAN1_TX_QUEUE_ENABLE || CAN2_TX_QUEUE_ENABLE */
+    UNUSED(can_selected);
+#endif /* CAN1_TX_QUEUE_ENABLE || CAN2_TX_QUEUE_ENABLE */
+
+    return 1;
+}
+
+/**
+ * @brief Read the received frames from the software receive rings.
+ *
+ * @param can_selected Specific which CAN.
+ * @param[out] frames The buffer to store frames.
+ * @param max The maximum number of frames to read, it's the size of `frames`.
+ * @return The number of frames read. Return 0 if no frame or the receive ring
+ *         is not enabled (`CANx_RXx_RING_SIZE`).
+ * @note Frames of FIFO0 are read first, then FIFO1. Only one caller (thread or
+ *       ISR) can read the same CAN at the same time.
+ */
+uint32_t can_receive_batch(can_selected_t can_selected, can_frame_t *frames,
+                           uint32_t max) {
+    if (frames == NULL) {
+        return 0;
+    }
+
+#if CAN_RX_RING_ENABLE
+    uint32_t count = 0;
+    can_rx_ring_t *rx_ring;
+
+    rx_ring = can_rx_ring_identify(can_selected, CAN_RX_FIFO0);
+    if (rx_ring != NULL) {
+        count += can_rx_ring_read(rx_ring, frames, max);
+    }
+
+    rx_ring = can_rx_ring_identify(can_selected, CAN_RX_FIFO1);
+    if (rx_ring != NULL) {
+        count += can_rx_ring_read(rx_ring, frames + count, max - count);
+    }
+
+    return count;
+#else  /* CAN_RX_RING_ENABLE */
+    UNUSED(can_selected);
+    UNUSED(max);
+    return 0;
+#endif /* CAN_RX_RING_ENABLE */
+}
+
+/**
+ * @brief Get the number of frames dropped because the receive ring is full.
+ *
+ * @param can_selected Specific which CAN.
+ * @return The total dropped frames of FIFO0 and FIFO1 ring.
+ */
+uint32_t can_rx_ring_get_dropped(can_selected_t can_selected) {
+    uint32_t dropped = 0;
+
+#if CAN_RX_RING_ENABLE
+    can_rx_ring_t *rx_ring;
+
+    rx_ring = can_rx_ring_identify(can_selected, CAN_RX_FIFO0);
+    if (rx_ring != NULL) {
+        dropped += rx_ring->dropped;
+    }
+
+    rx_ring = can_rx_ring_identify(can_selected, CAN_RX_FIFO1);
+    if (rx_ring != NULL) {
+        dropped += rx_ring->dropped;
+    }
+#else  /* CAN_RX_RING_ENABLE */
+    UNUSED(can_selected);
+#endif /* CAN_RX_RING_ENABLE */
+
+    return dropped;
+}
+
+/**
+ * @brief Build the receive dispatch table from ID and handler list.
+ *
+ * @param can_selected Specific which CAN.
+ * @param entries The IDs and handlers.
+ * @param count Number of `entries`, not greater than `CAN_DISPATCH_SIZE`.
+ * @param default_handler The handler of the IDs not in `entries`, can be
+ *                        NULL.
+ * @return Init status.
+ *  @retval - 0: Success.
+ *  @retval - 1: Dispatch is not enabled (`CAN_DISPATCH_ENABLE`).
+ *  @retval - 3: Parameter invalid, or the same ID is repeated.
+ * @note Standard IDs are looked up by direct index, extended IDs by binary
+ *       search. If `can_filter_alloc()` put the ID in list mode, the filter
+ *       match index is used and the lookup is skipped. Call it again to
+ *       rebuild the table, the frames received during rebuild go to the
+ *       receive ring.
+ */
+uint8_t can_dispatch_init(can_selected_t can_selected,
+                          const can_dispatch_entry_t *entries, uint32_t count,
+                          can_rx_handler_t default_handler) {
+#if CAN_DISPATCH_ENABLE
+    can_dispatch_t *dispatch = can_dispatch_identify(can_selected);
+    if ((dispatch == NULL) || (count > CAN_DISPATCH_SIZE) ||
+        ((count != 0) && (entries == NULL))) {
+        return 3;
+    }
+
+    dispatch->ready = 0;
+    __DMB();
+
+    memset(dispatch->std_slot, 0, sizeof(dispatch->std_slot));
+    dispatch->ext_count = 0;
+    dispatch->default_handler = default_handler;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        const can_dispatch_entry_t *entry = &entries[i];
+        uint8_t slot = i + 1;
+
+        if (entry->handler == NULL) {
+            return 3;
+        }
+        dispatch->handler[i] = entry->handler;
+
+        if (entry->ide == CAN_ID_STD) {
+            if ((entry->id > 0x7FFU) || (dispatch->std_slot[entry->id] != 0)) {
+                return 3;
+            }
+            dispatch->std_slot[entry->id] = slot;
+            continue;
+        }
+
+        if (entry->id > 0x1FFFFFFFU) {
+            return 3;
+        }
+
+        /* Insertion sort, keep `ext_id` in ascending order. */
+        uint32_t j = dispatch->ext_count;
+        while ((j != 0) && (dispatch->ext_id[j - 1] >= entry->id)) {
+            if (dispatch->ext_id[j - 1] == entry->id) {
+                return 3;
+            }
+            dispatch->ext_id[j] = dispatch->ext_id[j - 1];
+            dispatch->ext_slot[j] = dispatch->ext_slot[j - 1];
+            --j;
+        }
+        dispatch->ext_id[j] = entry->id;
+        dispatch->ext_slot[j] = slot;
+        ++dispatch->ext_count;
+    }
+
+    can_dispatch_map_fmi(can_selected, dispatch);
+
+    __DMB();
+    dispatch->ready = 1;
+
+    return 0;
+#else  /* CAN_DISPATCH_ENABLE */
+    UNUSED(can_selected);
+    UNUSED(entries);
+    UNUSED(count);
+    UNUSED(default_handler);
+    return 1;
+#endif /* CAN_DISPATCH_ENABLE */
+}
+
+/**
+ * @brief Call the handler of frame by the dispatch table.
+ *
+ * @param can_selected Specific which CAN.
+ * @param frame The frame, e.g. read by `can_receive_batch()`.
+ * @return Dispatch status.
+ *  @retval - 0: The handler is called.
+ *  @retval - 1: No handler, or dispatch is not enabled.
+ */
+uint8_t can_dispatch(can_selected_t can_selected, const can_frame_t *frame) {
+    if (frame == NULL) {
+        return 1;
+    }
+
+#if CAN_DISPATCH_ENABLE
+    /* The filter match index of this frame may come from any FIFO. */
+    return can_dispatch_frame(can_selected, CAN_RX_FIFO1 + 1, frame);
+#else  /* CAN_DISPATCH_ENABLE */
+    UNUSED(can_selected);
+    return 1;
+#endif /* CAN_DISPATCH_ENABLE */
+}
+
+/**
+ * @brief Get the time stamp of now, same time base as `can_frame_t`
+ *        `timestamp`.
+ *
+ * @param can_selected Specific which CAN.
+ * @return The 64-bit time stamp. Unit: bit time. Return 0 if Time Triggered
+ *         Communication Mode (`CANx_TTCM`) is not enabled.
+ * @note The time base starts from an arbitrary point, only the difference
+ *       makes sense.
+ */
+uint64_t can_timestamp_now(can_selected_t can_selected) {
+#if CAN_TIME_ENABLE
+    CAN_HandleTypeDef *can_handle = can_get_handle(can_selected);
+    if (can_handle == NULL) {
+        return 0;
+    }
+
+    can_time_t *time = can_time_identify(can_handle);
+    if (time != NULL) {
+        return can_time_now(time);
+    }
+#else  /* CAN_TIME_ENABLE */
+    UNUSED(can_selected);
+#endif /* CAN_TIME_ENABLE */
+
+    return 0;
+}
+
+/**
+ * @brief Get the receive latency of frame, from the SOF on bus to now.
+ *
+ * @param can_selected Specific which CAN.
+ * @param frame The frame, read by `can_receive_batch()` or passed to the
+ *              dispatch handler.
+ * @return The latency. Unit: bit time. Return 0 if Time Triggered
+ *         Communication Mode (`CANx_TTCM`) is not enabled.
+ */
+uint32_t can_rx_latency(can_selected_t can_selected,
+                        const can_frame_t *frame) {
+    if (frame == NULL) {
+        return 0;
+    }
+
+    uint64_t now = can_timestamp_now(can_selected);
+    if (now == 0) {
+        return 0;
+    }
+
+    return (uint32_t)now - frame->timestamp;
+}
+
+/**
+ * @brief Get the transmit latency statistics, from the frame pushed into
+ *        software transmit queue to the SOF on bus.
+ *
+ * @param can_selected Specific which CAN.
+ * @param[out] stats The statistics.
+ * @return Get status.
+ *  @retval - 0: Success.
+ *  @retval - 1: TTCM (`CANx_TTCM`) or the transmit queue of this CAN is not
+ *               enabled.
+ *  @retval - 3: Parameter invalid.
+ * @note The time of push is estimated by ms (`HAL_GetTick()`), so the
+ *       latency is accurate to about 1 ms.
+ */
+uint8_t can_latency_get_stats(can_selected_t can_selected,
+                              can_latency_stats_t *stats) {
+    if (stats == NULL) {
+        return 3;
+    }
+
+#if CAN_TIME_ENABLE && (CAN1_TX_QUEUE_ENABLE || CAN2_TX_QUEUE_ENABLE)
+    CAN_HandleTypeDef *can_handle = can_get_handle(can_selected);
+    if ((can_handle == NULL) || (can_tx_queue_identify(can_selected) == NULL)) {
+        return 1;
+    }
+
+    can_time_t *time = can_time_identify(can_handle);
+    if (time != NULL) {
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+        *stats = time->latency;
+        __set_PRIMASK(primask);
+        return 0;
+    }
+#else  /* CAN_TIME_ENABLE && (CAN1_TX_QUEUE_ENABLE || CAN2_TX_QUEUE_ENABLE) */
+    UNUSED(can_selected);
+#endif /* CAN_TIME_ENABLE && (CAN1_TX_QUEUE_ENABLE || CAN2_TX_QUEUE_ENABLE) */
+
+    return 1;
+}
+
+/**
+ * @brief Run the software bus-off recovery. Detect bus-off (if `SCE`
+ *        interrupt is disabled), request the recovery when the backoff time
+ *        is over, and resume the transmit queue when recovered.
+ *
+ * @param can_selected Specific which CAN.
+ * @return The recovery state.
+ *  @retval - 0: `CAN_RECOVER_NONE`: Not bus-off.
+ *  @retval - 1: `CAN_RECOVER_WAIT`: Bus-off, waiting for the backoff time.
+ *  @retval - 2: `CAN_RECOVER_BUSY`: Waiting for 128 x 11 recessive bits.
+ * @note Call it periodically in thread, not in interrupt, it may wait the
+ *       CAN to enter and leave initialization mode. The backoff time starts
+ *       from `CAN_BUS_OFF_BACKOFF_MIN`, doubles on each failed recovery, and
+ *       resets after the CAN works for `CAN_BUS_OFF_BACKOFF_MAX`. The frames
+ *       in transmit queue are kept and sent after recovered. Always return
+ *       `CAN_RECOVER_NONE` if `CAN_BUS_OFF_RECOVERY` is not software.
+ */
+uint8_t can_recovery_poll(can_selected_t can_selected) {
+#if CAN_RECOVERY_ENABLE
+    CAN_HandleTypeDef *can_handle = can_get_handle(can_selected);
+    if ((can_handle == NULL) ||
+        (HAL_CAN_GetState(can_handle) == HAL_CAN_STATE_RESET)) {
+        return CAN_RECOVER_NONE;
+    }
+
+    can_recovery_t *recovery = can_recovery_identify(can_handle);
+    uint32_t tick = HAL_GetTick();
+    uint8_t restart = 0;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    uint8_t bus_off = (can_handle->Instance->ESR & CAN_ESR_BOFF) != 0;
+
+    switch (recovery->state) {
+        case CAN_RECOVER_NONE: {
+            if (bus_off) {
+                can_recovery_enter(can_handle, recovery);
+            } else if (tick - recovery->recovered_tick >=
+                       CAN_BUS_OFF_BACKOFF_MAX) {
+                recovery->attempt = 0;
+            }
+        } break;
+
+        case CAN_RECOVER_WAIT: {
+            if ((int32_t)(tick - recovery->deadline) >= 0) {
+                recovery->state = CAN_RECOVER_BUSY;
+                restart = 1;
+            }
+        } break;
+
+        default: {
+            if (!bus_off) {
+                can_recovery_done(can_handle, recovery);
+            }
+        } break;
+    }
+
+    __set_PRIMASK(primask);
+
+    if (restart) {
+        /* Enter and leave initialization mode to start the recovery
+         * sequence. The mailboxes and filters are kept. */
+        if ((HAL_CAN_Stop(can_handle) != HAL_OK) ||
+            (HAL_CAN_Start(can_handle) != HAL_OK)) {
+            primask = __get_PRIMASK();
+            __disable_irq();
+            can_recovery_enter(can_handle, recovery);
+            __set_PRIMASK(primask);
+        }
+    }
+
+    return recovery->state;
+#else  /* CAN_RECOVERY_ENABLE */
+    UNUSED(can_selected);
+    return CAN_RECOVER_NONE;
+#endif /* CAN_RECOVERY_ENABLE */
+}
+
+/**
+ * @brief Get the bus statistics: error counters, error state, frame and bit
+ *        rates and bus load.
+ *
+ * @param can_selected Specific which CAN.
+ * @param[out] stats The statistics.
+ * @return Get status.
+ *  @retval - 0: Success.
+ *  @retval - 1: Statistics is not enabled (`CAN_STATS_ENABLE`).
+ *  @retval - 3: Parameter invalid.
+ *  @retval - 4: This CAN is not initialized.
+ * @note The received frames are counted when read by receive ring or
+ *       dispatch in interrupt, the transmitted frames are counted in
+ *       transmit interrupt. The state transitions are counted in `SCE`
+ *       interrupt, or when this function is called. The bits do not include
+ *       the stuff bits, so the bus load is a little lower than the real.
+ */
+uint8_t can_bus_get_stats(can_selected_t can_selected,
+                          can_bus_stats_t *stats) {
+    if (stats == NULL) {
+        return 3;
+    }
+
+#if CAN1_STATS_ENABLE
+    CAN_HandleTypeDef *can_handle = can_get_handle(can_selected);
+    if (can_handle == NULL) {
+        return 3;
+    }
+
+    if (HAL_CAN_GetState(can_handle) == HAL_CAN_STATE_RESET) {
+        return 4;
+    }
+
+    can_stats_t *can_stats = can_stats_identify(can_handle);
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    can_stats_roll(can_stats);
+    can_stats_sample(can_stats, can_handle->Instance->ESR);
+    *stats = can_stats->stats;
+    __set_PRIMASK(primask);
+
+    return 0;
+#else  /* CAN1_STATS_ENABLE */
+    UNUSED(can_selected);
+    return 1;
+#endif /* CAN1_STATS_ENABLE */
+}
+
+#if CAN_ISOTP_ENABLE
+
+/**
+ * @brief Build a frame of ISO-TP channel.
+ *
+ * @param link The channel.
+ * @param[out] frame The frame.
+ * @param pci Protocol control information bytes.
+ * @param pci_len Length of `pci`.
+ * @param payload The payload.
+ * @param count Length of `payload`, `pci_len + count` must not exceed 8.
+ */
+static void can_isotp_build(const can_isotp_t *link, can_frame_t *frame,
+                            const uint8_t *pci, uint32_t pci_len,
+                            const uint8_t *payload, uint32_t count) {
+    frame->id = link->config.tx_id;
+    frame->ide = link->config.ide;
+    frame->rtr = CAN_RTR_DATA;
+    frame->dlc = pci_len + count;
+
+    memcpy(&frame->data[0], pci, pci_len);
+    if (count != 0) {
+        memcpy(&frame->data[pci_len], payload, count);
+    }
+
+#if CAN_ISOTP_PADDING
+    memset(&frame->data[frame->dlc], CAN_ISOTP_PAD_BYTE, 8 - frame->dlc);
+    frame->dlc = 8;
+#endif /* CAN_ISOTP_PADDING */
+}
+
+/**
+ * @brief Get the ID word of frames sent by ISO-TP channel.
+ *
+ * @param link The channel.
+ * @return The ID word, see `CAN_ID_WORD_xxx()`.
+ */
+static inline uint32_t can_isotp_id_word(const can_isotp_t *link) {
+    return (link->config.ide == CAN_ID_STD)
+               ? CAN_ID_WORD_STD(link->config.tx_id)
+               : CAN_ID_WORD_EXT(link->config.tx_id);
+}
+
+/**
+ * @brief Send a flow control frame.
+ *
+ * @param link The channel.
+ * @param flow_status `CAN_ISOTP_FS_xxx`.
+ */
+static void can_isotp_send_fc(const can_isotp_t *link, uint8_t flow_status) {
+    uint8_t pci[3] = {CAN_ISOTP_PCI_FC | flow_status, link->config.block_size,
+                      link->config.st_min};
+    can_frame_t frame;
+
+    can_isotp_build(link, &frame, pci, sizeof(pci), NULL, 0);
+    can_send_frame(link->config.can_selected, can_isotp_id_word(link), &frame);
+}
+
+/**
+ * @brief Convert STmin of flow control to ms.
+ *
+ * @param st_min STmin byte.
+ * @return The minimum separation time. Unit: ms. The 100-900 us values are
+ *         rounded up to 1 ms.
+ */
+static inline uint8_t can_isotp_st_min_ms(uint8_t st_min) {
+    if (st_min <= 0x7F) {
+        return st_min;
+    }
+
+    if ((st_min >= 0xF1) && (st_min <= 0xF9)) {
+        return 1;
+    }
+
+    /* Reserved value, use the maximum. */
+    return 0x7F;
+}
+
+/**
+ * @brief Load the consecutive frames into the free mailboxes or the transmit
+ *        queue, until the block or message is finished, there is no room, or
+ *        it must wait for STmin.
+ *
+ * @param link The channel.
+ * @return Return 1 if the last frame is loaded.
+ * @note Called with interrupt disabled.
+ */
+static uint8_t can_isotp_pump(can_isotp_t *link) {
+    uint32_t id_word = can_isotp_id_word(link);
+    can_frame_t frame;
+
+    while (link->tx_state == CAN_ISOTP_SENDING) {
+        uint32_t tick = HAL_GetTick();
+        if ((link->tx_st_min != 0) &&
+            (tick - link->tx_tick <= link->tx_st_min)) {
+            break;
+        }
+
+        uint8_t pci = CAN_ISOTP_PCI_CF | link->tx_sn;
+        uint32_t count = link->tx_len - link->tx_pos;
+        if (count > 7) {
+            count = 7;
+        }
+
+        can_isotp_build(link, &frame, &pci, 1, link->tx_data + link->tx_pos,
+                        count);
+        if (can_tp_write(link->config.can_selected, id_word, &frame) != 0) {
+            /* No room, continue in transmit interrupt. */
+            break;
+        }
+
+        link->tx_pos += count;
+        link->tx_sn = (link->tx_sn + 1) & 0x0F;
+        link->tx_tick = tick;
+
+        if (link->tx_pos == link->tx_len) {
+            link->tx_state = CAN_ISOTP_IDLE;
+            return 1;
+        }
+
+        if ((link->tx_bs != 0) && (--link->tx_bs_left == 0)) {
+            link->tx_state = CAN_ISOTP_WAIT_FC;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Handle the flow control frame from receiver.
+ *
+ * @param channel The channel number.
+ * @param link The channel.
+ * @param frame The flow control frame.
+ */
+static void can_isotp_on_fc(uint8_t channel, can_isotp_t *link,
+                            const can_frame_t *frame) {
+    uint8_t result = CAN_ISOTP_OK;
+    uint8_t done = 0;
+
+    if (frame->dlc < 3) {
+        return;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (link->tx_state != CAN_ISOTP_WAIT_FC) {
+        __set_PRIMASK(primask);
+        return;
+    }
+
+    switch (frame->data[0] & 0x0F) {
+        case CAN_ISOTP_FS_CTS: {
+            link->tx_bs = frame->data[1];
+            link->tx_bs_left = link->tx_bs;
+            link->tx_st_min = can_isotp_st_min_ms(frame->data[2]);
+            /* The first frame of block is sent immediately. */
+            link->tx_tick = HAL_GetTick() - link->tx_st_min - 1;
+            link->tx_state = CAN_ISOTP_SENDING;
+            done = can_isotp_pump(link);
+        } break;
+
+        case CAN_ISOTP_FS_WAIT: {
+            link->tx_tick = HAL_GetTick();
+        } break;
+
+        case CAN_ISOTP_FS_OVFLW: {
+            link->tx_state = CAN_ISOTP_IDLE;
+            result = CAN_ISOTP_OVERFLOW_ERR;
+            done = 1;
+        } break;
+
+        default: {
+            link->tx_state = CAN_ISOTP_IDLE;
+            result = CAN_ISOTP_FRAME_ERR;
+            done = 1;
+        } break;
+    }
+
+    __set_PRIMASK(primask);
+
+    if (done && (link->config.tx_handler != NULL)) {
+        link->config.tx_handler(channel, result, link->tx_pos);
+    }
+}
+
+/**
+ * @brief Handle the single frame and first frame from sender.
+ *
+ * @param channel The channel number.
+ * @param link The channel.
+ * @param frame The frame.
+ */
+static void can_isotp_on_start(uint8_t channel, can_isotp_t *link,
+                               const can_frame_t *frame) {
+    const uint8_t *data = frame->data;
+    const uint8_t *payload;
+    uint32_t len, count;
+
+    if ((data[0] & 0xF0) == CAN_ISOTP_PCI_SF) {
+        len = data[0] & 0x0F;
+        if ((len == 0) || (len > 7) || (len + 1 > frame->dlc)) {
+            return;
+        }
+        payload = &data[1];
+        count = len;
+    } else {
+        if (frame->dlc < 8) {
+            return;
+        }
+        len = ((uint32_t)(data[0] & 0x0F) << 8) | data[1];
+        if (len == 0) {
+            /* Escape sequence, 32-bit length. */
+            len = ((uint32_t)data[2] << 24) | ((uint32_t)data[3] << 16) |
+                  ((uint32_t)data[4] << 8) | data[5];
+            if (len <= CAN_ISOTP_FF_DL_MAX) {
+                return;
+            }
+            payload = &data[6];
+            count = 2;
+        } else {
+            if (len < 8) {
+                return;
+            }
+            payload = &data[2];
+            count = 6;
+        }
+    }
+
+    can_isotp_handler_t handler = link->config.rx_handler;
+
+    /* A new single frame or first frame terminates the reception. */
+    if (link->rx_state == CAN_ISOTP_RECEIVING) {
+        link->rx_state = CAN_ISOTP_IDLE;
+        if (handler != NULL) {
+            handler(channel, CAN_ISOTP_FRAME_ERR, link->rx_pos);
+        }
+    }
+
+    if (len > link->config.rx_size) {
+        if ((data[0] & 0xF0) == CAN_ISOTP_PCI_FF) {
+            can_isotp_send_fc(link, CAN_ISOTP_FS_OVFLW);
+        }
+        if (handler != NULL) {
+            handler(channel, CAN_ISOTP_OVERFLOW_ERR, len);
+        }
+        return;
+    }
+
+    memcpy(link->config.rx_buf, payload, count);
+
+    if ((data[0] & 0xF0) == CAN_ISOTP_PCI_SF) {
+        if (handler != NULL) {
+            handler(channel, CAN_ISOTP_OK, len);
+        }
+        return;
+    }
+
+    link->rx_len = len;
+    link->rx_pos = count;
+    link->rx_sn = 1;
+    link->rx_bs_left = link->config.block_size;
+    link->rx_tick = HAL_GetTick();
+    link->rx_state = CAN_ISOTP_RECEIVING;
+
+    can_isotp_send_fc(link, CAN_ISOTP_FS_CTS);
+}
+
+/**
+ * @brief Handle the consecutive frame from sender, copy the payload into
+ *        the receive buffer directly.
+ *
+ * @param channel The channel number.
+ * @param link The channel.
+ * @param frame The frame.
+ */
+static void can_isotp_on_cf(uint8_t channel, can_isotp_t *link,
+                            const can_frame_t *frame) {
+    can_isotp_handler_t handler = link->config.rx_handler;
+
+    if (link->rx_state != CAN_ISOTP_RECEIVING) {
+        return;
+    }
+
+    uint32_t count = link->rx_len - link->rx_pos;
+    if (count > 7) {
+        count = 7;
+    }
+
+    if (((frame->data[0] & 0x0F) != link->rx_sn) ||
+        (count + 1 > frame->dlc)) {
+        link->rx_state = CAN_ISOTP_IDLE;
+        if (handler != NULL) {
+            handler(channel, CAN_ISOTP_FRAME_ERR, link->rx_pos);
+        }
+        return;
+    }
+
+    memcpy(link->config.rx_buf + link->rx_pos, &frame->data[1], count);
+    link->rx_pos += count;
+    link->rx_sn = (link->rx_sn + 1) & 0x0F;
+    link->rx_tick = HAL_GetTick();
+
+    if (link->rx_pos == link->rx_len) {
+        link->rx_state = CAN_ISOTP_IDLE;
+        if (handler != NULL) {
+            handler(channel, CAN_ISOTP_OK, link->rx_len);
+        }
+        return;
+    }
+
+    if ((link->config.block_size != 0) && (--link->rx_bs_left == 0)) {
+        link->rx_bs_left = link->config.block_size;
+        can_isotp_send_fc(link, CAN_ISOTP_FS_CTS);
+    }
+}
+
+/**
+ * @brief Pass the received frame to the ISO-TP channel.
+ *
+ * @param can_selected Specific which CAN.
+ * @param frame The frame received.
+ * @return Return 0 if the frame belongs to an ISO-TP channel.
+ * @note Called in receive interrupt.
+ */
+static uint8_t can_isotp_rx_frame(can_selected_t can_selected,
+                                  const can_frame_t *frame) {
+    if ((frame->rtr != CAN_RTR_DATA) || (frame->dlc == 0)) {
+        return 1;
+    }
+
+    for (uint8_t channel = 0; channel < CAN_ISOTP_CHANNELS; ++channel) {
+        can_isotp_t *link = &can_isotp[channel];
+
+        if ((link->opened == 0) ||
+            (link->config.can_selected != can_selected) ||
+            (link->config.rx_id != frame->id) ||
+            (link->config.ide != frame->ide)) {
+            continue;
+        }
+
+        switch (frame->data[0] & 0xF0) {
+            case CAN_ISOTP_PCI_SF:
+            case CAN_ISOTP_PCI_FF: {
+                can_isotp_on_start(channel, link, frame);
+            } break;
+
+            case CAN_ISOTP_PCI_CF: {
+                can_isotp_on_cf(channel, link, frame);
+            } break;
+
+            case CAN_ISOTP_PCI_FC: {
+                can_isotp_on_fc(channel, link, frame);
+            } break;
+
+            default:
+                break;
+        }
+
+        return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Continue the transmission of ISO-TP channels, so the consecutive
+ *        frames are sent back-to-back.
+ *
+ * @param can_selected Specific which CAN.
+ * @note Called in transmit interrupt, after the transmit queue is drained.
+ */
+static void can_isotp_tx_irq(can_selected_t can_selected) {
+    for (uint8_t channel = 0; channel < CAN_ISOTP_CHANNELS; ++channel) {
+        can_isotp_t *link = &can_isotp[channel];
+
+        if ((link->opened == 0) ||
+            (link->config.can_selected != can_selected) ||
+            (link->tx_state != CAN_ISOTP_SENDING)) {
+            continue;
+        }
+
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+        uint8_t done = can_isotp_pump(link);
+        __set_PRIMASK(primask);
+
+        if (done && (link->config.tx_handler != NULL)) {
+            link->config.tx_handler(channel, CAN_ISOTP_OK, link->tx_len);
+        }
+    }
+}
+
+#endif /* CAN_ISOTP_ENABLE */
+
+/**
+ * @brief Open an ISO-TP (ISO 15765-2) channel, normal addressing.
+ *
+ * @param channel The channel number, 0 to `CAN_ISOTP_CHANNELS - 1`.
+ * @param config The configuration, copied into channel.
+ * @return Open status.
+ *  @retval - 0: Success.
+ *  @retval - 1: ISO-TP is not enabled (`CAN_ISOTP_ENABLE`).
+ *  @retval - 3: Parameter invalid, or the transmit interrupt of this CAN is
+ *               not enabled.
+ * @note The frames are handled in receive and transmit interrupt, the
+ *       handlers are called in interrupt.
+ */
+uint8_t can_isotp_open(uint8_t channel, const can_isotp_config_t *config) {
+#if CAN_ISOTP_ENABLE
+    if ((channel >= CAN_ISOTP_CHANNELS) || (config == NULL) ||
+        ((config->rx_buf == NULL) && (config->rx_size != 0))) {
+        return 3;
+    }
+
+    /* The consecutive frames are sent in transmit interrupt. */
+    switch (config->can_selected) {
+#if CAN1_ENABLE && CAN1_ENABLE_TX_IT
+        case can1_selected:
+            break;
+#endif /* CAN1_ENABLE && CAN1_ENABLE_TX_IT */
+
+#if CAN2_ENABLE && CAN2_ENABLE_TX_IT
+        case can2_selected:
+            break;
+#endif /* CAN2_ENABLE && CAN2_ENABLE_TX_IT */
+
+        default:
+            return 3;
+    }
+
+    can_isotp_t *link = &can_isotp[channel];
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    memset(link, 0, sizeof(can_isotp_t));
+    link->config = *config;
+    link->opened = 1;
+    __set_PRIMASK(primask);
+
+    return 0;
+#else  /* CAN_ISOTP_ENABLE */
+    UNUSED(channel);
+    UNUSED(config);
+    return 1;
+#endif /* CAN_ISOTP_ENABLE */
+}
+
+/**
+ * @brief Close an ISO-TP channel, the transfers are aborted without
+ *        calling the handlers.
+ *
+ * @param channel The channel number.
+ */
+void can_isotp_close(uint8_t channel) {
+#if CAN_ISOTP_ENABLE
+    if (channel >= CAN_ISOTP_CHANNELS) {
+        return;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    can_isotp[channel].opened = 0;
+    can_isotp[channel].tx_state = CAN_ISOTP_IDLE;
+    can_isotp[channel].rx_state = CAN_ISOTP_IDLE;
+    __set_PRIMASK(primask);
+#else  /* CAN_ISOTP_ENABLE */
+    UNUSED(channel);
+#endif /* CAN_ISOTP_ENABLE */
+}
+
+/**
+ * @brief Send a message by ISO-TP channel.
+ *
+ * @param channel The channel number.
+ * @param data The message, it's not copied and must be kept until the
+ *             `tx_handler` is called.
+ * @param len Length of message, more than 4095 bytes uses the 32-bit first
+ *            frame.
+ * @return Send status.
+ *  @retval - 0: Success, `tx_handler` will be called once with the result.
+ *  @retval - 1: Send error, or ISO-TP is not enabled.
+ *  @retval - 2: Channel is busy, or timeout.
+ *  @retval - 3: Parameter invalid.
+ *  @retval - 4: This CAN is not initialized.
+ */
+uint8_t can_isotp_send(uint8_t channel, const uint8_t *data, uint32_t len) {
+#if CAN_ISOTP_ENABLE
+    if ((channel >= CAN_ISOTP_CHANNELS) || (data == NULL) || (len == 0)) {
+        return 3;
+    }
+
+    can_isotp_t *link = &can_isotp[channel];
+    if (link->opened == 0) {
+        return 3;
+    }
+
+    can_frame_t frame;
+    uint8_t pci[6];
+    uint32_t pci_len;
+    uint8_t res;
+
+    if (len <= 7) {
+        pci[0] = CAN_ISOTP_PCI_SF | len;
+        can_isotp_build(link, &frame, pci, 1, data, len);
+
+        if (link->tx_state != CAN_ISOTP_IDLE) {
+            return 2;
+        }
+        res = can_send_frame(link->config.can_selected,
+                             can_isotp_id_word(link), &frame);
+        if (res != 0) {
+            return res;
+        }
+
+        if (link->config.tx_handler != NULL) {
+            link->config.tx_handler(channel, CAN_ISOTP_OK, len);
+        }
+        return 0;
+    }
+
+    if (len <= CAN_ISOTP_FF_DL_MAX) {
+        pci[0] = CAN_ISOTP_PCI_FF | (len >> 8);
+        pci[1] = len & 0xFF;
+        pci_len = 2;
+    } else {
+        pci[0] = CAN_ISOTP_PCI_FF;
+        pci[1] = 0;
+        pci[2] = len >> 24;
+        pci[3] = (len >> 16) & 0xFF;
+        pci[4] = (len >> 8) & 0xFF;
+        pci[5] = len & 0xFF;
+        pci_len = 6;
+    }
+    can_isotp_build(link, &frame, pci, pci_len, data, 8 - pci_len);
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (link->tx_state != CAN_ISOTP_IDLE) {
+        __set_PRIMASK(primask);
+        return 2;
+    }
+
+    link->tx_data = data;
+    link->tx_len = len;
+    link->tx_pos = 8 - pci_len;
+    link->tx_sn = 1;
+    link->tx_tick = HAL_GetTick();
+    /* Wait for FC before the first frame is sent, it may come very soon. */
+    link->tx_state = CAN_ISOTP_WAIT_FC;
+
+    __set_PRIMASK(primask);
+
+    res = can_send_frame(link->config.can_selected, can_isotp_id_word(link),
+                         &frame);
+    if (res != 0) {
+        link->tx_state = CAN_ISOTP_IDLE;
+    }
+
+    return res;
+#else  /* CAN_ISOTP_ENABLE */
+    UNUSED(channel);
+    UNUSED(data);
+    UNUSED(len);
+    return 1;
+#endif /* CAN_ISOTP_ENABLE */
+}
+
+/**
+ * @brief Check the timeout (N_Bs, N_Cr) of ISO-TP channels, and send the
+ *        consecutive frames when STmin is not 0.
+ *
+ * @note Call it periodically, at least every 1 ms if the receiver requests
+ *       STmin.
+ */
+void can_isotp_poll(void) {
+#if CAN_ISOTP_ENABLE
+    for (uint8_t channel = 0; channel < CAN_ISOTP_CHANNELS; ++channel) {
+        can_isotp_t *link = &can_isotp[channel];
+        uint8_t tx_result = 0xFF;
+        uint8_t rx_timeout = 0;
+
+        if (link->opened == 0) {
+            continue;
+        }
+
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+
+        uint32_t tick = HAL_GetTick();
+
+        if ((link->tx_state == CAN_ISOTP_WAIT_FC) &&
+            (tick - link->tx_tick > CAN_ISOTP_TIMEOUT)) {
+            link->tx_state = CAN_ISOTP_IDLE;
+            tx_result = CAN_ISOTP_TIMEOUT_ERR;
+        } else if (link->tx_state == CAN_ISOTP_SENDING) {
+            if (can_isotp_pump(link)) {
+                tx_result = CAN_ISOTP_OK;
+            }
+        }
+
+        if ((link->rx_state == CAN_ISOTP_RECEIVING) &&
+            (tick - link->rx_tick > CAN_ISOTP_TIMEOUT)) {
+            link->rx_state = CAN_ISOTP_IDLE;
+            rx_timeout = 1;
+        }
+
+        __set_PRIMASK(primask);
+
+        if ((tx_result != 0xFF) && (link->config.tx_handler != NULL)) {
+            link->config.tx_handler(channel, tx_result, link->tx_pos);
+        }
+
+        if (rx_timeout && (link->config.rx_handler != NULL)) {
+            link->config.rx_handler(channel, CAN_ISOTP_TIMEOUT_ERR,
+                                    link->rx_pos);
+        }
+    }
+#endif /* CAN_ISOTP_ENABLE */
+}
+
+#if CAN_GATEWAY_ENABLE
+
+/**
+ * @brief Forward the received frame by the routing table.
+ *
+ * @param can_selected The CAN received the frame.
+ * @param frame The frame received.
+ * @return Return 0 if the frame is forwarded and not for local.
+ * @note Called in receive interrupt. The frame is written into the mailbox
+ *       or transmit queue of destination directly, it never waits.
+ */
+static uint8_t can_gateway_rx_frame(can_selected_t can_selected,
+                                    const can_frame_t *frame) {
+    uint32_t count = can_gateway.count;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        const can_gateway_route_t *route = &can_gateway.route[i];
+
+        if ((route->src != can_selected) || (route->ide != frame->ide) ||
+            ((frame->id & route->mask) != route->id)) {
+            continue;
+        }
+
+        can_frame_t out = *frame;
+        out.id = (frame->id & ~route->rewrite_mask) |
+                 (route->new_id & route->rewrite_mask);
+
+        if (can_send_nowait(route->dest, &out) == 0) {
+            ++can_gateway.stats[i].forwarded;
+        } else {
+            ++can_gateway.stats[i].dropped;
+        }
+
+        /* The first matched route only. */
+        return route->local ? 1 : 0;
+    }
+
+    return 1;
+}
+
+#endif /* CAN_GATEWAY_ENABLE */
+
+/**
+ * @brief Set the routing table of gateway, and clear the counters.
+ *
+ * @param routes The routes, copied into gateway. The first matched route is
+ *               used.
+ * @param count Number of routes, 0 to stop the gateway.
+ * @return Init status.
+ *  @retval - 0: Success.
+ *  @retval - 1: Gateway is not enabled (`CAN_GATEWAY_ENABLE`).
+ *  @retval - 3: Parameter invalid, or too many routes
+ *               (`CAN_GATEWAY_ROUTES`).
+ * @note The frames are forwarded in receive interrupt, so the receive
+ *       interrupt of source CAN must be enabled. The forwarded frames are not
+ *       passed to ISO-TP, dispatch or receive ring, unless `local` is set.
+ * @note bxCAN has no hardware route between CAN1 and CAN2, every forwarded
+ *       frame costs one receive interrupt. It is written into a free mailbox
+ *       of destination directly, the transmit queue is only used when all
+ *       three mailboxes are pending.
+ */
+uint8_t can_gateway_init(const can_gateway_route_t *routes, uint32_t count) {
+#if CAN_GATEWAY_ENABLE
+    if ((count > CAN_GATEWAY_ROUTES) || ((routes == NULL) && (count != 0))) {
+        return 3;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (count != 0) {
+        memcpy(can_gateway.route, routes, count * sizeof(can_gateway_route_t));
+    }
+    memset(can_gateway.stats, 0, sizeof(can_gateway.stats));
+    can_gateway.count = count;
+
+    __set_PRIMASK(primask);
+
+    return 0;
+#else  /* CAN_GATEWAY_ENABLE */
+    UNUSED(routes);
+    UNUSED(count);
+    return 1;
+#endif /* CAN_GATEWAY_ENABLE */
+}
+
+/**
+ * @brief Get the counters of gateway route.
+ *
+ * @param route The index of route in table.
+ * @param[out] stats The counters.
+ * @return Get status.
+ *  @retval - 0: Success.
+ *  @retval - 1: Gateway is not enabled (`CAN_GATEWAY_ENABLE`).
+ *  @retval - 3: Parameter invalid.
+ */
+uint8_t can_gateway_get_stats(uint32_t route, can_gateway_stats_t *stats) {
+#if CAN_GATEWAY_ENABLE
+    if ((route >= can_gateway.count) || (stats == NULL)) {
+        return 3;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *stats = can_gateway.stats[route];
+    __set_PRIMASK(primask);
+
+    return 0;
+#else  /* CAN_GATEWAY_ENABLE */
+    UNUSED(route);
+    UNUSED(stats);
+    return 1;
+#endif /* CAN_GATEWAY_ENABLE */
+}
+
+#if CAN_SCHED_ENABLE
+
+/**
+ * @brief Greatest common divisor.
+ *
+ * @param a The first number.
+ * @param b The second number.
+ * @return The greatest common divisor.
+ */
+static uint32_t can_sched_gcd(uint32_t a, uint32_t b) {
+    while (b != 0) {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+
+    return a;
+}
+
+/**
+ * @brief Choose the phase of entry to spread the mailbox load.
+ *
+ * @param index The index of entry, the entries with fixed phase and the
+ *              entries before it are placed.
+ * @param count Number of entries.
+ * @return The phase in ticks.
+ * @note Two entries with period `p1`, `p2` and phase `o1`, `o2` are sent in
+ *       the same tick sometimes if `o1 == o2 (mod gcd(p1, p2))`. Choose the
+ *       phase collides with the fewest placed entries, O(n * period).
+ */
+static uint32_t can_sched_auto_offset(uint32_t index, uint32_t count) {
+    const can_sched_slot_t *slot = &can_sched.slot[index];
+    uint32_t best = 0;
+    uint32_t best_cost = UINT32_MAX;
+
+    for (uint32_t offset = 0; offset < slot->period; ++offset) {
+        uint32_t cost = 0;
+
+        for (uint32_t i = 0; i < count; ++i) {
+            const can_sched_slot_t *placed = &can_sched.slot[i];
+            if ((i == index) || (placed->offset == CAN_SCHED_OFFSET_AUTO)) {
+                continue;
+            }
+
+            uint32_t g = can_sched_gcd(slot->period, placed->period);
+            if ((offset % g) == (placed->offset % g)) {
+                ++cost;
+            }
+        }
+
+        if (cost < best_cost) {
+            best = offset;
+            best_cost = cost;
+            if (cost == 0) {
+                break;
+            }
+        }
+    }
+
+    return best;
+}
+
+/**
+ * @brief Produce the payload and send the cyclic message.
+ *
+ * @param index The index of entry.
+ * @param slot The entry.
+ * @note Called in `can_sched_tick()`. The period is measured by DWT cycle
+ *       counter, which wraps after `2^32 / HCLK` seconds (59 s at 72 MHz).
+ */
+static void can_sched_send(uint32_t index, can_sched_slot_t *slot) {
+    const can_sched_entry_t *entry = &slot->entry;
+    can_sched_stats_t *stats = &slot->stats;
+    can_frame_t frame = {.id = entry->id,
+                         .ide = entry->ide,
+                         .rtr = CAN_RTR_DATA,
+                         .dlc = entry->dlc};
+
+    if (entry->fill != NULL) {
+        entry->fill(index, &frame);
+    } else if (entry->dlc != 0) {
+        memcpy(frame.data, entry->data, entry->dlc);
+    }
+
+    uint32_t cycles = DWT->CYCCNT;
+    if (can_send_nowait(entry->can_selected, &frame) != 0) {
+        ++stats->missed;
+        return;
+    }
+
+    if (stats->sent++ == 0) {
+        slot->last_cycles = cycles;
+        return;
+    }
+
+    uint32_t period = (cycles - slot->last_cycles) / can_sched.cycles_per_us;
+    /* The period is rounded down to multiple of tick. Unit: us. */
+    uint32_t nominal = slot->period * CAN_SCHED_TICK * 1000;
+    uint32_t jitter = (period > nominal) ? (period - nominal)
+                                         : (nominal - period);
+    slot->last_cycles = cycles;
+
+    stats->last_period = period;
+    if (period < stats->min_period) {
+        stats->min_period = period;
+    }
+    if (period > stats->max_period) {
+        stats->max_period = period;
+    }
+    if (jitter > stats->max_jitter) {
+        stats->max_jitter = jitter;
+    }
+}
+
+#endif /* CAN_SCHED_ENABLE */
+
+/**
+ * @brief Set the schedule table of cyclic scheduler, and clear the
+ *        statistics.
  *
- * @param can_selected Specific which CAN to send message.
- * @param can_ide Specific standard ID or Extend ID.
- * @param id Specific message id.
- * @param len Specific message length.
- * @param msg Specific message content.
- * @return Send status.
+ * @param entries The entries, copied into scheduler.
+ * @param count Number of entries, 0 to stop the scheduler.
+ * @return Init status.
  *  @retval - 0: Success.
- *  @retval - 1: Send error.
- *  @retval - 2: Timeout.
+ *  @retval - 1: Scheduler is not enabled (`CAN_SCHED_ENABLE`).
+ *  @retval - 3: Parameter invalid, or too many entries (`CAN_SCHED_SIZE`).
+ * @note The period is rounded down to multiple of `CAN_SCHED_TICK`. The
+ *       entries with `CAN_SCHED_OFFSET_AUTO` are placed in order to avoid
+ *       sending with the other entries in the same tick, so the mailboxes
+ *       are not loaded by burst. Don't call it in ISR, choosing the phases
+ *       takes O(n^2 * period).
+ */
+uint8_t can_sched_init(const can_sched_entry_t *entries, uint32_t count) {
+#if CAN_SCHED_ENABLE
+    if ((count > CAN_SCHED_SIZE) || ((entries == NULL) && (count != 0))) {
+        return 3;
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+        const can_sched_entry_t *entry = &entries[i];
+        if ((entry->period < CAN_SCHED_TICK) || (entry->dlc > 8) ||
+            ((entry->fill == NULL) && (entry->data == NULL) &&
+             (entry->dlc != 0))) {
+            return 3;
+        }
+    }
+
+    /* Stop the tick before changing the table, it's not touched by
+     * `can_sched_tick()` while the count is 0. */
+    can_sched.count = 0;
+    __DMB();
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    can_sched.cycles_per_us = HAL_RCC_GetHCLKFreq() / 1000000;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        can_sched_slot_t *slot = &can_sched.slot[i];
+        slot->entry = entries[i];
+        slot->period = entries[i].period / CAN_SCHED_TICK;
+        slot->offset = entries[i].offset;
+        if (slot->offset != CAN_SCHED_OFFSET_AUTO) {
+            slot->offset = (slot->offset / CAN_SCHED_TICK) % slot->period;
+        }
+
+        memset(&slot->stats, 0, sizeof(slot->stats));
+        slot->stats.min_period = UINT32_MAX;
+    }
+
+    /* The fixed phases are set, place the others in order. */
+    for (uint32_t i = 0; i < count; ++i) {
+        can_sched_slot_t *slot = &can_sched.slot[i];
+        if (slot->offset == CAN_SCHED_OFFSET_AUTO) {
+            slot->offset = can_sched_auto_offset(i, count);
+        }
+        slot->next = can_sched.tick + 1 + slot->offset;
+    }
+
+    __DMB();
+    can_sched.count = count;
+
+    return 0;
+#else  /* CAN_SCHED_ENABLE */
+    UNUSED(entries);
+    UNUSED(count);
+    return 1;
+#endif /* CAN_SCHED_ENABLE */
+}
+
+/**
+ * @brief Tick of cyclic scheduler, send the due messages.
+ *
+ * @note Call it every `CAN_SCHED_TICK` ms from a timer interrupt with
+ *       priority not lower than the CAN transmit interrupt, the jitter
+ *       depends on it. The payloads are produced just before sending, and
+ *       it never waits for a free mailbox. If the tick is late for more
+ *       than one period, the missed cycles are skipped rather than sent in
+ *       a burst.
+ */
+void can_sched_tick(void) {
+#if CAN_SCHED_ENABLE
+    uint32_t count = can_sched.count;
+    if (count == 0) {
+        return;
+    }
+
+    uint32_t tick = ++can_sched.tick;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        can_sched_slot_t *slot = &can_sched.slot[i];
+        uint32_t late = tick - slot->next;
+
+        if ((int32_t)late < 0) {
+            continue;
+        }
+
+        /* Keep the phase. */
+        slot->next += (late / slot->period + 1) * slot->period;
+        can_sched_send(i, slot);
+    }
+#endif /* CAN_SCHED_ENABLE */
+}
+
+/**
+ * @brief Get the achieved period and jitter of cyclic message.
+ *
+ * @param index The index of entry in schedule table.
+ * @param[out] stats The statistics.
+ * @return Get status.
+ *  @retval - 0: Success.
+ *  @retval - 1: Scheduler is not enabled (`CAN_SCHED_ENABLE`).
+ *  @retval - 3: Parameter invalid.
+ * @note `min_period` is `UINT32_MAX` until two frames are sent.
+ */
+uint8_t can_sched_get_stats(uint32_t index, can_sched_stats_t *stats) {
+#if CAN_SCHED_ENABLE
+    if ((index >= can_sched.count) || (stats == NULL)) {
+        return 3;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *stats = can_sched.slot[index].stats;
+    __set_PRIMASK(primask);
+
+    return 0;
+#else  /* CAN_SCHED_ENABLE */
+    UNUSED(index);
+    UNUSED(stats);
+    return 1;
+#endif /* CAN_SCHED_ENABLE */
+}
+
+/**
+ * @brief Get the position of least significant bit of signal in payload
+ *        word.
+ *
+ * @param signal The signal.
+ * @return The position, negative if the signal is out of payload.
+ */
+static inline int32_t can_signal_lsb(const can_signal_t *signal) {
+    if (signal->order == CAN_SIGNAL_MOTOROLA) {
+        return CAN_SIGNAL_MOTOROLA_LSB(signal->start, signal->length);
+    }
+
+    return signal->start;
+}
+
+/**
+ * @brief Get the payload of frame as 64-bit word.
+ *
+ * @param frame The frame, the bytes after `dlc` are read too.
+ * @param order `CAN_SIGNAL_INTEL`: `data[0]` is the lowest byte.
+ *              `CAN_SIGNAL_MOTOROLA`: `data[0]` is the highest byte.
+ * @return The payload word. Get the signals by `CAN_SIGNAL_GET()` with
+ *         `CAN_SIGNAL_INTEL_LSB()` or `CAN_SIGNAL_MOTOROLA_LSB()`.
+ */
+uint64_t can_payload_get(const can_frame_t *frame, uint8_t order) {
+    uint32_t word[2];
+    memcpy(word, frame->data, sizeof(word));
+
+    if (order == CAN_SIGNAL_MOTOROLA) {
+        return ((uint64_t)__REV(word[0]) << 32) | __REV(word[1]);
+    }
+
+    return ((uint64_t)word[1] << 32) | word[0];
+}
+
+/**
+ * @brief Set the payload of frame by 64-bit word.
+ *
+ * @param frame The frame, all 8 bytes are written, `dlc` is not changed.
+ * @param order `CAN_SIGNAL_INTEL` or `CAN_SIGNAL_MOTOROLA`, same as
+ *              `can_payload_get()`.
+ * @param payload The payload word.
+ */
+void can_payload_set(can_frame_t *frame, uint8_t order, uint64_t payload) {
+    uint32_t word[2];
+
+    if (order == CAN_SIGNAL_MOTOROLA) {
+        word[0] = __REV((uint32_t)(payload >> 32));
+        word[1] = __REV((uint32_t)payload);
+    } else {
+        word[0] = (uint32_t)payload;
+        word[1] = (uint32_t)(payload >> 32);
+    }
+
+    memcpy(frame->data, word, sizeof(word));
+}
+
+/**
+ * @brief Unpack the signals of frame to physical value.
+ *
+ * @param signals The signals of message.
+ * @param count Number of signals.
+ * @param frame The frame received.
+ * @param[out] values The physical values, `raw * scale + offset`.
+ * @return Unpack status.
+ *  @retval - 0: Success.
+ *  @retval - 3: Parameter invalid, or the signal is out of payload.
+ * @note The payload is loaded once for all signals. For the hot messages,
+ *       `CAN_SIGNAL_GET()` with constant position is faster.
+ */
+uint8_t can_signal_unpack(const can_signal_t *signals, uint32_t count,
+                          const can_frame_t *frame, float *values) {
+    if ((signals == NULL) || (frame == NULL) || (values == NULL)) {
+        return 3;
+    }
+
+    uint64_t payload[2] = {can_payload_get(frame, CAN_SIGNAL_INTEL),
+                           can_payload_get(frame, CAN_SIGNAL_MOTOROLA)};
+
+    for (uint32_t i = 0; i < count; ++i) {
+        const can_signal_t *signal = &signals[i];
+        int32_t lsb = can_signal_lsb(signal);
+
+        if ((signal->length == 0) || (lsb < 0) ||
+            (lsb + signal->length > 64)) {
+            return 3;
+        }
+
+        uint64_t word = payload[signal->order == CAN_SIGNAL_MOTOROLA];
+        if (signal->is_signed) {
+            values[i] = (float)CAN_SIGNAL_GET_SIGNED(word, lsb,
+                                                     signal->length) *
+                            signal->scale +
+                        signal->offset;
+        } else {
+            values[i] = (float)CAN_SIGNAL_GET(word, lsb, signal->length) *
+                            signal->scale +
+                        signal->offset;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Pack the physical values into the signals of frame.
+ *
+ * @param signals The signals of message.
+ * @param count Number of signals.
+ * @param values The physical values, rounded to the nearest raw value and
+ *               saturated to the range of signal.
+ * @param frame The frame to send, the bits not in signals are kept.
+ * @return Pack status.
+ *  @retval - 0: Success.
+ *  @retval - 3: Parameter invalid, or the signal is out of payload.
+ */
+uint8_t can_signal_pack(const can_signal_t *signals, uint32_t count,
+                        const float *values, can_frame_t *frame) {
+    if ((signals == NULL) || (frame == NULL) || (values == NULL)) {
+        return 3;
+    }
+
+    /* Load the payload word again only when the byte order changes. */
+    uint8_t order = CAN_SIGNAL_INTEL;
+    uint64_t payload = can_payload_get(frame, order);
+
+    for (uint32_t i = 0; i < count; ++i) {
+        const can_signal_t *signal = &signals[i];
+        int32_t lsb = can_signal_lsb(signal);
+
+        if ((signal->length == 0) || (lsb < 0) ||
+            (lsb + signal->length > 64) || (signal->scale == 0.0f)) {
+            return 3;
+        }
+
+        if (signal->order != order) {
+            can_payload_set(frame, order, payload);
+            order = signal->order;
+            payload = can_payload_get(frame, order);
+        }
+
+        /* From 2^23 the float is an integer, adding 0.5 would round up the
+         * odd values. */
+        float raw = (values[i] - signal->offset) / signal->scale;
+        if ((raw > -8388608.0f) && (raw < 8388608.0f)) {
+            raw += (raw < 0.0f) ? -0.5f : 0.5f;
+        }
+
+        uint64_t mask = CAN_SIGNAL_MASK(signal->length);
+        uint64_t value;
+        if (signal->is_signed) {
+            int64_t max = (int64_t)(mask >> 1);
+            if (raw >= (float)max) {
+                value = (uint64_t)max;
+            } else if (raw <= (float)(-max - 1)) {
+                value = (uint64_t)(-max - 1);
+            } else {
+                value = (uint64_t)(int64_t)raw;
+            }
+        } else {
+            if (raw >= (float)mask) {
+                value = mask;
+            } else if (raw <= 0.0f) {
+                value = 0;
+            } else {
+                value = (uint64_t)raw;
+            }
+        }
+
+        CAN_SIGNAL_SET(payload, lsb, signal->length, value);
+    }
+
+    can_payload_set(frame, order, payload);
+
+    return 0;
+}
+
+#if CAN_CHANGE_ENABLE
+
+/**
+ * @brief Identify the change filter of CAN.
+ *
+ * @param can_selected Specific which CAN.
+ * @return The change filter. Return NULL if the CAN is not enabled.
+ */
+static inline can_change_t *can_change_identify(can_selected_t can_selected) {
+    switch (can_selected) {
+
+#if CAN1_ENABLE
+        case can1_selected:
+            return &can1_change;
+#endif /* CAN1_ENABLE */
+
+#if CAN2_ENABLE
+        case can2_selected:
+            return &can2_change;
+#endif /* CAN2_ENABLE */
+
+        default:
+            return NULL;
+    }
+}
+
+/**
+ * @brief Get the lookup key of ID.
+ *
+ * @param id The ID.
+ * @param ide `CAN_ID_STD` or `CAN_ID_EXT`.
+ * @return The key, extended IDs are after all standard IDs.
+ */
+static inline uint32_t can_change_key(uint32_t id, uint8_t ide) {
+    return (ide == CAN_ID_STD) ? id : (id | 0x80000000U);
+}
+
+/**
+ * @brief Drop the frame if the payload is the same as last delivered one,
+ *        and the timeout is not reached.
+ *
+ * @param can_selected The CAN received the frame.
+ * @param frame The frame received.
+ * @return Return 0 if the frame is dropped.
+ * @note Called in receive interrupt. The IDs not in table and the remote
+ *       frames are always delivered.
+ */
+static uint8_t can_change_rx_frame(can_selected_t can_selected,
+                                   const can_frame_t *frame) {
+    can_change_t *change = can_change_identify(can_selected);
+    if ((change == NULL) || (change->ready == 0) ||
+        (frame->rtr != CAN_RTR_DATA)) {
+        return 1;
+    }
+
+    uint32_t key = can_change_key(frame->id, frame->ide);
+    uint32_t low = 0;
+    uint32_t high = change->count;
+    while (low < high) {
+        uint32_t mid = (low + high) / 2;
+        if (change->slot[mid].key < key) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    if ((low >= change->count) || (change->slot[low].key != key)) {
+        return 1;
+    }
+
+    can_change_slot_t *slot = &change->slot[low];
+    uint32_t tick = HAL_GetTick();
+
+    if ((slot->dlc == frame->dlc) &&
+        (memcmp(slot->data, frame->data, frame->dlc) == 0) &&
+        ((slot->timeout == 0) || (tick - slot->tick < slot->timeout))) {
+        ++change->stats.suppressed;
+        return 0;
+    }
+
+    slot->dlc = frame->dlc;
+    memcpy(slot->data, frame->data, sizeof(slot->data));
+    slot->tick = tick;
+    ++change->stats.passed;
+
+    return 1;
+}
+
+#endif /* CAN_CHANGE_ENABLE */
+
+/**
+ * @brief Set the IDs of change filter, the frames of these IDs are
+ *        delivered only when the payload changes or the timeout is reached.
+ *
+ * @param can_selected Specific which CAN.
+ * @param entries The IDs and timeouts.
+ * @param count Number of `entries`, not greater than `CAN_CHANGE_SIZE`. 0 to
+ *              stop the filter.
+ * @return Init status.
+ *  @retval - 0: Success.
+ *  @retval - 1: Change filter is not enabled (`CAN_CHANGE_ENABLE`).
+ *  @retval - 3: Parameter invalid, or the same ID is repeated.
+ * @note The filter works in receive interrupt after gateway and ISO-TP, the
+ *       dropped frames are not passed to dispatch or receive ring. The first
+ *       frame of each ID is always delivered.
+ */
+uint8_t can_change_init(can_selected_t can_selected,
+                        const can_change_entry_t *entries, uint32_t count) {
+#if CAN_CHANGE_ENABLE
+    can_change_t *change = can_change_identify(can_selected);
+    if ((change == NULL) || (count > CAN_CHANGE_SIZE) ||
+        ((count != 0) && (entries == NULL))) {
+        return 3;
+    }
+
+    change->ready = 0;
+    __DMB();
+
+    change->count = 0;
+    memset(&change->stats, 0, sizeof(change->stats));
+
+    for (uint32_t i = 0; i < count; ++i) {
+        const can_change_entry_t *entry = &entries[i];
+        uint32_t max = (entry->ide == CAN_ID_STD) ? 0x7FFU : 0x1FFFFFFFU;
+        if (entry->id > max) {
+            change->count = 0;
+            return 3;
+        }
+
+        /* Insertion sort, keep `key` in ascending order. */
+        uint32_t key = can_change_key(entry->id, entry->ide);
+        uint32_t j = change->count;
+        while ((j != 0) && (change->slot[j - 1].key >= key)) {
+            if (change->slot[j - 1].key == key) {
+                change->count = 0;
+                return 3;
+            }
+            change->slot[j] = change->slot[j - 1];
+            --j;
+        }
+
+        can_change_slot_t *slot = &change->slot[j];
+        slot->key = key;
+        slot->timeout = entry->timeout;
+        /* Never matches a received frame, the first one is delivered. */
+        slot->dlc = 0xFF;
+        ++change->count;
+    }
+
+    __DMB();
+    change->ready = 1;
+
+    return 0;
+#else  /* CAN_CHANGE_ENABLE */
+    UNUSED(can_selected);
+    UNUSED(entries);
+    UNUSED(count);
+    return 1;
+#endif /* CAN_CHANGE_ENABLE */
+}
+
+/**
+ * @brief Get the counters of change filter.
+ *
+ * @param can_selected Specific which CAN.
+ * @param[out] stats The counters.
+ * @return Get status.
+ *  @retval - 0: Success.
+ *  @retval - 1: Change filter is not enabled (`CAN_CHANGE_ENABLE`).
+ *  @retval - 3: Parameter invalid.
+ */
+uint8_t can_change_get_stats(can_selected_t can_selected,
+                             can_change_stats_t *stats) {
+#if CAN_CHANGE_ENABLE
+    can_change_t *change = can_change_identify(can_selected);
+    if ((change == NULL) || (stats == NULL)) {
+        return 3;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *stats = change->stats;
+    __set_PRIMASK(primask);
+
+    return 0;
+#else  /* CAN_CHANGE_ENABLE */
+    UNUSED(can_selected);
+    UNUSED(stats);
+    return 1;
+#endif /* CAN_CHANGE_ENABLE */
+}
+
+#if CAN_RESPOND_ENABLE
+
+/**
+ * @brief Identify the remote frame responder of CAN.
+ *
+ * @param can_selected Specific which CAN.
+ * @return The responder. Return NULL if the CAN is not enabled.
+ */
+static inline can_respond_t *can_respond_identify(can_selected_t can_selected) {
+    switch (can_selected) {
+
+#if CAN1_ENABLE
+        case can1_selected:
+            return &can1_respond;
+#endif /* CAN1_ENABLE */
+
+#if CAN2_ENABLE
+        case can2_selected:
+            return &can2_respond;
+#endif /* CAN2_ENABLE */
+
+        default:
+            return NULL;
+    }
+}
+
+/**
+ * @brief Answer the remote frame with the current payload of its ID.
+ *
+ * @param can_selected The CAN received the frame.
+ * @param frame The frame received.
+ * @return Return 0 if the remote frame is answered or dropped.
+ * @note Called in receive interrupt. The data frames and the IDs not in
+ *       table are passed on.
+ */
+static uint8_t can_respond_rx_frame(can_selected_t can_selected,
+                                    const can_frame_t *frame) {
+    can_respond_t *respond = can_respond_identify(can_selected);
+    if ((respond == NULL) || (respond->ready == 0) ||
+        (frame->rtr != CAN_RTR_REMOTE)) {
+        return 1;
+    }
+
+    uint32_t key = can_frame_id_word(frame) & ~CAN_ID_WORD_RTR;
+    uint32_t low = 0;
+    uint32_t high = respond->count;
+    while (low < high) {
+        uint32_t mid = (low + high) / 2;
+        if (respond->slot[mid].key < key) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    if ((low >= respond->count) || (respond->slot[low].key != key)) {
+        return 1;
+    }
+
+    const can_respond_slot_t *slot = &respond->slot[low];
+    can_frame_t answer = {.id = frame->id,
+                          .ide = frame->ide,
+                          .rtr = CAN_RTR_DATA,
+                          .dlc = slot->dlc};
+    if (slot->dlc != 0) {
+        memcpy(answer.data, slot->data, slot->dlc);
+    }
+
+    if (can_send_nowait(can_selected, &answer) == 0) {
+        ++respond->stats.answered;
+    } else {
+        ++respond->stats.dropped;
+    }
+
+    return 0;
+}
+
+#endif /* CAN_RESPOND_ENABLE */
+
+/**
+ * @brief Set the IDs of remote frame responder, the remote frames of these
+ *        IDs are answered in receive interrupt.
+ *
+ * @param can_selected Specific which CAN.
+ * @param entries The IDs and payloads.
+ * @param count Number of `entries`, not greater than `CAN_RESPOND_SIZE`. 0
+ *              to stop the responder.
+ * @return Init status.
+ *  @retval - 0: Success.
+ *  @retval - 1: Responder is not enabled (`CAN_RESPOND_ENABLE`).
+ *  @retval - 3: Parameter invalid, or the same ID is repeated.
+ * @note The payload is read in receive interrupt when the remote frame
+ *       arrives. Update it with interrupt disabled if a torn payload is not
+ *       acceptable. The answered remote frames are not passed to gateway,
+ *       dispatch or receive ring. The answer is sent at once, or queued in
+ *       software transmit queue if it is enabled.
+ */
+uint8_t can_respond_init(can_selected_t can_selected,
+                         const can_respond_entry_t *entries, uint32_t count) {
+#if CAN_RESPOND_ENABLE
+    can_respond_t *respond = can_respond_identify(can_selected);
+    if ((respond == NULL) || (count > CAN_RESPOND_SIZE) ||
+        ((count != 0) && (entries == NULL))) {
+        return 3;
+    }
+
+    respond->ready = 0;
+    __DMB();
+
+    respond->count = 0;
+    memset(&respond->stats, 0, sizeof(respond->stats));
+
+    for (uint32_t i = 0; i < count; ++i) {
+        const can_respond_entry_t *entry = &entries[i];
+        uint32_t max = (entry->ide == CAN_ID_STD) ? 0x7FFU : 0x1FFFFFFFU;
+        if ((entry->id > max) || (entry->dlc > 8) ||
+            ((entry->dlc != 0) && (entry->data == NULL))) {
+            respond->count = 0;
+            return 3;
+        }
+
+        /* Insertion sort, keep `key` in ascending order. */
+        uint32_t key = (entry->ide == CAN_ID_STD) ? CAN_ID_WORD_STD(entry->id)
+                                                  : CAN_ID_WORD_EXT(entry->id);
+        uint32_t j = respond->count;
+        while ((j != 0) && (respond->slot[j - 1].key >= key)) {
+            if (respond->slot[j - 1].key == key) {
+                respond->count = 0;
+                return 3;
+            }
+            respond->slot[j] = respond->slot[j - 1];
+            --j;
+        }
+
+        can_respond_slot_t *slot = &respond->slot[j];
+        slot->key = key;
+        slot->dlc = entry->dlc;
+        slot->data = entry->data;
+        ++respond->count;
+    }
+
+    __DMB();
+    respond->ready = 1;
+
+    return 0;
+#else  /* CAN_RESPOND_ENABLE */
+    UNUSED(can_selected);
+    UNUSED(entries);
+    UNUSED(count);
+    return 1;
+#endif /* CAN_RESPOND_ENABLE */
+}
+
+/**
+ * @brief Get the counters of remote frame responder.
+ *
+ * @param can_selected Specific which CAN.
+ * @param[out] stats The counters.
+ * @return Get status.
+ *  @retval - 0: Success.
+ *  @retval - 1: Responder is not enabled (`CAN_RESPOND_ENABLE`).
  *  @retval - 3: Parameter invalid.
- *  @retval - 4: This CAN is not initialized.
  */
-uint8_t can_send_message(can_selected_t can_selected, uint32_t can_ide,
-                         uint32_t id, uint8_t len, const uint8_t *msg) {
-    CAN_HandleTypeDef *can_handle = can_get_handle(can_selected);
-    if (can_handle == NULL) {
+uint8_t can_respond_get_stats(can_selected_t can_selected,
+                              can_respond_stats_t *stats) {
+#if CAN_RESPOND_ENABLE
+    can_respond_t *respond = can_respond_identify(can_selected);
+    if ((respond == NULL) || (stats == NULL)) {
         return 3;
     }
 
-    if (len > 8) {
-        return 3;
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *stats = respond->stats;
+    __set_PRIMASK(primask);
+
+    return 0;
+#else  /* CAN_RESPOND_ENABLE */
+    UNUSED(can_selected);
+    UNUSED(stats);
+    return 1;
+#endif /* CAN_RESPOND_ENABLE */
+}
+
+#if CAN_J1939_ENABLE
+
+/**
+ * @brief Get the 29-bit ID of J1939 message.
+ *
+ * @param priority Priority, 0-7.
+ * @param pgn Parameter group number.
+ * @param da Destination address, only used by PDU1 format (PF < 240).
+ * @param sa Source address.
+ * @return The extended ID.
+ */
+static inline uint32_t can_j1939_id(uint8_t priority, uint32_t pgn,
+                                    uint8_t da, uint8_t sa) {
+    uint32_t id = ((uint32_t)(priority & 0x07U) << 26) |
+                  ((pgn & 0x3FFFFU) << 8) | sa;
+
+    if (((pgn >> 8) & 0xFFU) < 240) {
+        /* PDU1, PS field is the destination address. */
+        id = (id & ~0xFF00U) | ((uint32_t)da << 8);
     }
 
-    if (HAL_CAN_GetState(can_handle) == HAL_CAN_STATE_RESET) {
-        return 4;
+    return id;
+}
+
+/**
+ * @brief Send a single frame message of J1939 node.
+ *
+ * @param priority Priority, 0-7.
+ * @param pgn Parameter group number.
+ * @param da Destination address.
+ * @param sa Source address.
+ * @param data The data.
+ * @param len Length of `data`, 0-8.
+ * @return Send status, same as `can_send_message()`.
+ */
+static uint8_t can_j1939_send_frame(uint8_t priority, uint32_t pgn,
+                                    uint8_t da, uint8_t sa,
+                                    const uint8_t *data, uint32_t len) {
+    can_frame_t frame = {.id = can_j1939_id(priority, pgn, da, sa),
+                         .ide = CAN_ID_EXT,
+                         .rtr = CAN_RTR_DATA,
+                         .dlc = len};
+
+    memcpy(frame.data, data, len);
+
+    return can_send_frame(can_j1939.config.can_selected,
+                          CAN_ID_WORD_EXT(frame.id), &frame);
+}
+
+/**
+ * @brief Send a TP.CM message.
+ *
+ * @param da Destination address.
+ * @param control Control byte, `CAN_J1939_CM_xxx`.
+ * @param arg Byte 1-4 of message, little endian.
+ * @param pgn PGN of the transferred message.
+ */
+static void can_j1939_send_cm(uint8_t da, uint8_t control, uint32_t arg,
+                              uint32_t pgn) {
+    uint8_t data[8] = {control,
+                       arg & 0xFFU,
+                       (arg >> 8) & 0xFFU,
+                       (arg >> 16) & 0xFFU,
+                       arg >> 24,
+                       pgn & 0xFFU,
+                       (pgn >> 8) & 0xFFU,
+                       (pgn >> 16) & 0xFFU};
+
+    can_j1939_send_frame(7, CAN_J1939_PGN_TP_CM, da, can_j1939.address, data,
+                         sizeof(data));
+}
+
+/**
+ * @brief Send the address claimed message, or cannot claim address if the
+ *        address is lost.
+ */
+static void can_j1939_send_claim(void) {
+    uint8_t name[8];
+    for (uint32_t i = 0; i < 8; ++i) {
+        name[i] = (uint8_t)(can_j1939.config.name >> (8 * i));
     }
 
-    uint16_t wait_time = 0;
-    uint32_t tx_mail_box = CAN_TX_MAILBOX0;
+    uint8_t sa = (can_j1939.claim == CAN_J1939_LOST) ? CAN_J1939_NULL_ADDR
+                                                     : can_j1939.address;
+    can_j1939_send_frame(6, CAN_J1939_PGN_CLAIM, CAN_J1939_GLOBAL, sa, name,
+                         sizeof(name));
+}
 
-    CAN_TxHeaderTypeDef tx_header = {0};
-    tx_header.IDE = can_ide;
-    tx_header.RTR = CAN_RTR_DATA;
-    tx_header.DLC = len;
-    if (can_ide == CAN_ID_STD) {
-        tx_header.StdId = id;
+/**
+ * @brief Choose another address after the address claim is lost.
+ *
+ * @return The address in 128-247 not claimed by other nodes, or
+ *         `CAN_J1939_NULL_ADDR` if none or the NAME is not arbitrary address
+ *         capable.
+ */
+static uint8_t can_j1939_next_address(void) {
+    /* Arbitrary address capable, bit 63 of NAME. */
+    if ((can_j1939.config.name >> 63) == 0) {
+        return CAN_J1939_NULL_ADDR;
+    }
+
+    /* Search from the address after the current one, wrap in 128-247. */
+    for (uint32_t i = 1; i <= 120; ++i) {
+        uint8_t address = 128 + (can_j1939.address + 112 + i) % 120;
+        if ((address != can_j1939.address) &&
+            ((can_j1939.used[address / 32] & (1U << (address % 32))) == 0)) {
+            return address;
+        }
+    }
+
+    return CAN_J1939_NULL_ADDR;
+}
+
+/**
+ * @brief Handle the address claimed message of other node.
+ *
+ * @param sa Source address.
+ * @param data NAME of other node.
+ */
+static void can_j1939_on_claim(uint8_t sa, const uint8_t *data) {
+    uint64_t name = 0;
+    for (uint32_t i = 0; i < 8; ++i) {
+        name |= (uint64_t)data[i] << (8 * i);
+    }
+
+    if (sa >= CAN_J1939_NULL_ADDR) {
+        return;
+    }
+
+    if ((sa != can_j1939.address) || (can_j1939.claim == CAN_J1939_LOST)) {
+        can_j1939.used[sa / 32] |= 1U << (sa % 32);
+        return;
+    }
+
+    if (name > can_j1939.config.name) {
+        /* Lower NAME wins, claim it again. */
+        can_j1939_send_claim();
+        return;
+    }
+
+    if (name == can_j1939.config.name) {
+        return;
+    }
+
+    can_j1939.used[sa / 32] |= 1U << (sa % 32);
+
+    uint8_t address = can_j1939_next_address();
+    if (address == CAN_J1939_NULL_ADDR) {
+        can_j1939.claim = CAN_J1939_LOST;
     } else {
-        tx_header.ExtId = id;
+        can_j1939.address = address;
+        can_j1939.claim = CAN_J1939_CLAIMING;
+        can_j1939.claim_tick = HAL_GetTick();
     }
 
-    while (HAL_CAN_GetTxMailboxesFreeLevel(can_handle) == 0) {
-        /* Wait to all mailbox is empty. */
-        ++wait_time;
-        if (wait_time > CAN_SEND_TIMEOUT) {
-            return 2;
+    can_j1939_send_claim();
+}
+
+/**
+ * @brief Call the handler of PGN.
+ *
+ * @param pgn Parameter group number.
+ * @param sa Source address.
+ * @param da Destination address.
+ * @param data The message.
+ * @param len Length of message.
+ */
+static void can_j1939_deliver(uint32_t pgn, uint8_t sa, uint8_t da,
+                              const uint8_t *data, uint32_t len) {
+    can_j1939_handler_t handler = can_j1939.config.default_handler;
+    uint32_t low = 0;
+    uint32_t high = can_j1939.pgn_count;
+
+    while (low < high) {
+        uint32_t mid = (low + high) / 2;
+        if (can_j1939.pgn[mid] < pgn) {
+            low = mid + 1;
+        } else {
+            high = mid;
         }
     }
 
-    if (HAL_CAN_AddTxMessage(can_handle, &tx_header, msg, &tx_mail_box) !=
-        HAL_OK) {
+    if ((low < can_j1939.pgn_count) && (can_j1939.pgn[low] == pgn)) {
+        handler = can_j1939.handler[low];
+    }
+
+    if (handler != NULL) {
+        handler(pgn, sa, da, data, len);
+    }
+}
+
+/**
+ * @brief Find the receive session.
+ *
+ * @param sa Address of sender.
+ * @param bam 1: BAM session, 0: connection mode session.
+ * @param create Return a free session if not found.
+ * @return The session, or NULL.
+ */
+static can_j1939_session_t *can_j1939_rx_session(uint8_t sa, uint8_t bam,
+                                                 uint8_t create) {
+    can_j1939_session_t *free_session = NULL;
+
+    for (uint32_t i = 0; i < CAN_J1939_RX_SESSIONS; ++i) {
+        can_j1939_session_t *session = &can_j1939.rx[i];
+
+        if (session->state == CAN_J1939_TP_IDLE) {
+            if (free_session == NULL) {
+                free_session = session;
+            }
+            continue;
+        }
+
+        if ((session->peer == sa) &&
+            ((session->state == CAN_J1939_TP_BAM) == (bam != 0))) {
+            return session;
+        }
+    }
+
+    return create ? free_session : NULL;
+}
+
+/**
+ * @brief Send the CTS of next window, as many packets as the sender allows.
+ *
+ * @param session The receive session.
+ */
+static void can_j1939_send_cts(can_j1939_session_t *session) {
+    uint32_t count = session->packets - session->next + 1;
+    if ((session->window_max != 0) && (count > session->window_max)) {
+        count = session->window_max;
+    }
+
+    session->window_end = session->next + count - 1;
+    session->tick = HAL_GetTick();
+    session->timeout = CAN_J1939_T2;
+
+    can_j1939_send_cm(session->peer, CAN_J1939_CM_CTS,
+                      0xFFFF0000U | ((uint32_t)session->next << 8) | count,
+                      session->pgn);
+}
+
+/**
+ * @brief Build the TP.DT frame of transmit session.
+ *
+ * @param session The transmit session.
+ * @param[out] frame The frame, ID is not changed.
+ */
+static void can_j1939_build_dt(const can_j1939_session_t *session,
+                               can_frame_t *frame) {
+    uint32_t pos = (uint32_t)(session->next - 1) * 7;
+    uint32_t count = session->len - pos;
+    if (count > 7) {
+        count = 7;
+    }
+
+    frame->data[0] = session->next;
+    memcpy(&frame->data[1], session->tx_data + pos, count);
+    memset(&frame->data[1 + count], 0xFF, 7 - count);
+}
+
+/**
+ * @brief Load the data packets of CTS window into the free mailboxes or the
+ *        transmit queue.
+ *
+ * @note Called with interrupt disabled.
+ */
+static void can_j1939_pump(void) {
+    can_j1939_session_t *tx = &can_j1939.tx;
+    can_frame_t frame = {.id = can_j1939_id(tx->priority, CAN_J1939_PGN_TP_DT,
+                                            tx->peer, can_j1939.address),
+                         .ide = CAN_ID_EXT,
+                         .rtr = CAN_RTR_DATA,
+                         .dlc = 8};
+    uint32_t id_word = CAN_ID_WORD_EXT(frame.id);
+
+    while (tx->state == CAN_J1939_TP_SENDING) {
+        can_j1939_build_dt(tx, &frame);
+        if (can_tp_write(can_j1939.config.can_selected, id_word, &frame) !=
+            0) {
+            /* No room, continue in transmit interrupt. */
+            break;
+        }
+
+        tx->tick = HAL_GetTick();
+        if (tx->next == tx->window_end) {
+            tx->state = (tx->next == tx->packets) ? CAN_J1939_TP_WAIT_END
+                                                  : CAN_J1939_TP_WAIT_CTS;
+            tx->timeout = CAN_J1939_T3;
+        }
+        ++tx->next;
+    }
+}
+
+/**
+ * @brief Handle the TP.CM message.
+ *
+ * @param sa Source address.
+ * @param da Destination address.
+ * @param data The message.
+ */
+static void can_j1939_on_cm(uint8_t sa, uint8_t da, const uint8_t *data) {
+    can_j1939_session_t *tx = &can_j1939.tx;
+    can_j1939_session_t *session;
+    uint32_t pgn = data[5] | ((uint32_t)data[6] << 8) |
+                   ((uint32_t)data[7] << 16);
+    uint32_t len = data[1] | ((uint32_t)data[2] << 8);
+    uint8_t result = 0xFF;
+
+    switch (data[0]) {
+        case CAN_J1939_CM_RTS:
+        case CAN_J1939_CM_BAM: {
+            uint8_t bam = (data[0] == CAN_J1939_CM_BAM);
+            if (bam != (da == CAN_J1939_GLOBAL)) {
+                return;
+            }
+
+            /* A new RTS or BAM from the same node restarts the session. */
+            session = can_j1939_rx_session(sa, bam, 1);
+            if ((session == NULL) || (len < 9) || (len > CAN_J1939_RX_SIZE) ||
+                (data[3] != (len + 6) / 7)) {
+                if (session != NULL) {
+                    session->state = CAN_J1939_TP_IDLE;
+                }
+                if (!bam) {
+                    can_j1939_send_cm(sa, CAN_J1939_CM_ABORT,
+                                      0xFFFFFF00U | CAN_J1939_ABORT_RESOURCE,
+                                      pgn);
+                }
+                return;
+            }
+
+            session->peer = sa;
+            session->pgn = pgn;
+            session->len = len;
+            session->packets = data[3];
+            session->next = 1;
+            session->tick = HAL_GetTick();
+            session->timeout = CAN_J1939_T1;
+
+            if (bam) {
+                session->state = CAN_J1939_TP_BAM;
+                return;
+            }
+
+            session->window_max = data[4];
+            session->state = CAN_J1939_TP_CMDT;
+            can_j1939_send_cts(session);
+        } break;
+
+        case CAN_J1939_CM_CTS: {
+            uint32_t primask = __get_PRIMASK();
+            __disable_irq();
+
+            if ((tx->state != CAN_J1939_TP_WAIT_CTS) || (tx->peer != sa) ||
+                (tx->pgn != pgn)) {
+                __set_PRIMASK(primask);
+                return;
+            }
+
+            uint32_t count = data[1];
+            uint32_t next = data[2];
+            tx->tick = HAL_GetTick();
+
+            if (count == 0) {
+                /* Hold the connection. */
+                tx->timeout = CAN_J1939_T4;
+            } else if ((next != 0) && (next <= tx->packets)) {
+                uint32_t end = next + count - 1;
+                tx->next = next;
+                tx->window_end = (end > tx->packets) ? tx->packets : end;
+                tx->state = CAN_J1939_TP_SENDING;
+                can_j1939_pump();
+            }
+
+            __set_PRIMASK(primask);
+        } break;
+
+        case CAN_J1939_CM_EOMA: {
+            if ((tx->state == CAN_J1939_TP_WAIT_END) && (tx->peer == sa) &&
+                (tx->pgn == pgn)) {
+                tx->state = CAN_J1939_TP_IDLE;
+                result = CAN_J1939_OK;
+            }
+        } break;
+
+        case CAN_J1939_CM_ABORT: {
+            if ((tx->state >= CAN_J1939_TP_WAIT_CTS) && (tx->peer == sa) &&
+                (tx->pgn == pgn)) {
+                tx->state = CAN_J1939_TP_IDLE;
+                result = CAN_J1939_ABORT_ERR;
+            }
+
+            session = can_j1939_rx_session(sa, 0, 0);
+            if ((session != NULL) && (session->pgn == pgn)) {
+                session->state = CAN_J1939_TP_IDLE;
+            }
+        } break;
+
+        default:
+            break;
+    }
+
+    if ((result != 0xFF) && (can_j1939.config.tx_handler != NULL)) {
+        can_j1939.config.tx_handler(pgn, result);
+    }
+}
+
+/**
+ * @brief Handle the TP.DT message, copy the data into the session buffer.
+ *
+ * @param sa Source address.
+ * @param da Destination address.
+ * @param data The message.
+ */
+static void can_j1939_on_dt(uint8_t sa, uint8_t da, const uint8_t *data) {
+    can_j1939_session_t *session =
+        can_j1939_rx_session(sa, da == CAN_J1939_GLOBAL, 0);
+    if (session == NULL) {
+        return;
+    }
+
+    uint8_t cmdt = (session->state == CAN_J1939_TP_CMDT);
+
+    if (data[0] != session->next) {
+        session->state = CAN_J1939_TP_IDLE;
+        if (cmdt) {
+            can_j1939_send_cm(sa, CAN_J1939_CM_ABORT,
+                              0xFFFFFF00U | CAN_J1939_ABORT_SEQUENCE,
+                              session->pgn);
+        }
+        return;
+    }
+
+    uint8_t *buf = can_j1939.rx_buf[session - can_j1939.rx];
+    uint32_t pos = (uint32_t)(session->next - 1) * 7;
+    uint32_t count = session->len - pos;
+    if (count > 7) {
+        count = 7;
+    }
+
+    memcpy(buf + pos, &data[1], count);
+    session->tick = HAL_GetTick();
+    session->timeout = CAN_J1939_T1;
+
+    if (session->next == session->packets) {
+        session->state = CAN_J1939_TP_IDLE;
+        if (cmdt) {
+            can_j1939_send_cm(sa, CAN_J1939_CM_EOMA,
+                              0xFF000000U |
+                                  ((uint32_t)session->packets << 16) |
+                                  session->len,
+                              session->pgn);
+        }
+        can_j1939_deliver(session->pgn, sa, da, buf, session->len);
+        return;
+    }
+
+    if (cmdt && (session->next == session->window_end)) {
+        ++session->next;
+        can_j1939_send_cts(session);
+        return;
+    }
+
+    ++session->next;
+}
+
+/**
+ * @brief Pass the received frame to J1939 node.
+ *
+ * @param can_selected The CAN received the frame.
+ * @param frame The frame received.
+ * @return Return 0 if the frame is handled by J1939 node.
+ * @note Called in receive interrupt. The PDU1 frames to other nodes are not
+ *       handled.
+ */
+static uint8_t can_j1939_rx_frame(can_selected_t can_selected,
+                                  const can_frame_t *frame) {
+    if ((can_j1939.ready == 0) ||
+        (can_j1939.config.can_selected != can_selected) ||
+        (frame->ide != CAN_ID_EXT) || (frame->rtr != CAN_RTR_DATA)) {
         return 1;
     }
+
+    const uint8_t *data = frame->data;
+    uint32_t pgn = (frame->id >> 8) & 0x3FFFFU;
+    uint8_t sa = frame->id & 0xFFU;
+    uint8_t da = CAN_J1939_GLOBAL;
+
+    if (((pgn >> 8) & 0xFFU) < 240) {
+        da = pgn & 0xFFU;
+        pgn &= 0x3FF00U;
+        if ((da != CAN_J1939_GLOBAL) &&
+            ((can_j1939.claim == CAN_J1939_LOST) ||
+             (da != can_j1939.address))) {
+            return 1;
+        }
+    }
+
+    switch (pgn) {
+        case CAN_J1939_PGN_CLAIM: {
+            if (frame->dlc == 8) {
+                can_j1939_on_claim(sa, data);
+            }
+        } break;
+
+        case CAN_J1939_PGN_REQUEST: {
+            if ((frame->dlc >= 3) &&
+                ((data[0] | ((uint32_t)data[1] << 8) |
+                  ((uint32_t)data[2] << 16)) == CAN_J1939_PGN_CLAIM)) {
+                can_j1939_send_claim();
+            } else {
+                can_j1939_deliver(pgn, sa, da, data, frame->dlc);
+            }
+        } break;
+
+        case CAN_J1939_PGN_TP_CM: {
+            if (frame->dlc == 8) {
+                can_j1939_on_cm(sa, da, data);
+            }
+        } break;
+
+        case CAN_J1939_PGN_TP_DT: {
+            if (frame->dlc == 8) {
+                can_j1939_on_dt(sa, da, data);
+            }
+        } break;
+
+        default: {
+            can_j1939_deliver(pgn, sa, da, data, frame->dlc);
+        } break;
+    }
+
     return 0;
 }
 
 /**
- * @brief CAN send remote message.
+ * @brief Continue the connection mode transmission, so the data packets of
+ *        CTS window are sent back-to-back.
  *
- * @param can_selected Specific which CAN to send message.
- * @param can_ide Specific standard ID or Extend ID.
- * @param id Specific message id.
- * @param len Specific message length.
- * @param msg Specific message content.
- * @return Send status.
- *  @retval - 0: Success.
- *  @retval - 1: Send error.
- *  @retval - 2: Timeout.
- *  @retval - 3: Parameter invalid.
+ * @param can_selected Specific which CAN.
+ * @note Called in transmit interrupt, after the transmit queue is drained.
+ */
+static void can_j1939_tx_irq(can_selected_t can_selected) {
+    if ((can_j1939.ready == 0) ||
+        (can_j1939.config.can_selected != can_selected) ||
+        (can_j1939.tx.state != CAN_J1939_TP_SENDING)) {
+        return;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    can_j1939_pump();
+    __set_PRIMASK(primask);
+}
+
+#endif /* CAN_J1939_ENABLE */
+
+/**
+ * @brief Init the J1939 node and claim the address.
+ *
+ * @param config The configuration, copied into node.
+ * @return Init status.
+ *  @retval - 0: Success, the address is claimed after 250 ms if no other
+ *               node contends.
+ *  @retval - 1: J1939 is not enabled (`CAN_J1939_ENABLE`), or send error.
+ *  @retval - 2: Timeout of sending address claim.
+ *  @retval - 3: Parameter invalid, too many PGNs (`CAN_J1939_PGNS`), or the
+ *               transmit interrupt of this CAN is not enabled.
  *  @retval - 4: This CAN is not initialized.
+ * @note The frames are handled in receive and transmit interrupt, the
+ *       handlers are called in interrupt. The extended frames must reach
+ *       the receive interrupt, see `can_filter_alloc()`. If the address is
+ *       taken by a node with lower NAME, another address in 128-247 is
+ *       claimed when bit 63 of NAME (arbitrary address capable) is set.
  */
-uint8_t can_send_remote(can_selected_t can_selected, uint32_t can_ide,
-                        uint32_t id, uint8_t len, const uint8_t *msg) {
-    CAN_HandleTypeDef *can_handle = can_get_handle(can_selected);
-    if (can_handle == NULL) {
+uint8_t can_j1939_init(const can_j1939_config_t *config) {
+#if CAN_J1939_ENABLE
+    if ((config == NULL) || (config->address >= CAN_J1939_NULL_ADDR) ||
+        (config->pgn_count > CAN_J1939_PGNS) ||
+        ((config->pgns == NULL) && (config->pgn_count != 0))) {
         return 3;
     }
 
-    if (len > 8) {
+    /* The data packets are sent in transmit interrupt. */
+    switch (config->can_selected) {
+#if CAN1_ENABLE && CAN1_ENABLE_TX_IT
+        case can1_selected:
+            break;
+#endif /* CAN1_ENABLE && CAN1_ENABLE_TX_IT */
+
+#if CAN2_ENABLE && CAN2_ENABLE_TX_IT
+        case can2_selected:
+            break;
+#endif /* CAN2_ENABLE && CAN2_ENABLE_TX_IT */
+
+        default:
+            return 3;
+    }
+
+    can_j1939.ready = 0;
+    __DMB();
+
+    memset(&can_j1939, 0, sizeof(can_j1939));
+    can_j1939.config = *config;
+    can_j1939.config.pgns = NULL;
+
+    for (uint32_t i = 0; i < config->pgn_count; ++i) {
+        const can_j1939_pgn_t *entry = &config->pgns[i];
+        if ((entry->handler == NULL) || (entry->pgn > 0x3FFFFU)) {
+            return 3;
+        }
+
+        /* Insertion sort, keep `pgn` in ascending order. */
+        uint32_t j = can_j1939.pgn_count;
+        while ((j != 0) && (can_j1939.pgn[j - 1] >= entry->pgn)) {
+            if (can_j1939.pgn[j - 1] == entry->pgn) {
+                return 3;
+            }
+            can_j1939.pgn[j] = can_j1939.pgn[j - 1];
+            can_j1939.handler[j] = can_j1939.handler[j - 1];
+            --j;
+        }
+        can_j1939.pgn[j] = entry->pgn;
+        can_j1939.handler[j] = entry->handler;
+        ++can_j1939.pgn_count;
+    }
+
+    can_j1939.address = config->address;
+    can_j1939.claim = CAN_J1939_CLAIMING;
+    can_j1939.claim_tick = HAL_GetTick();
+
+    __DMB();
+    can_j1939.ready = 1;
+
+    can_j1939_send_claim();
+
+    return 0;
+#else  /* CAN_J1939_ENABLE */
+    UNUSED(config);
+    return 1;
+#endif /* CAN_J1939_ENABLE */
+}
+
+/**
+ * @brief Send a J1939 message, use the transport protocol if it's longer
+ *        than 8 bytes.
+ *
+ * @param pgn Parameter group number.
+ * @param priority Priority, 0-7.
+ * @param da Destination address, `CAN_J1939_GLOBAL` for broadcast. The PDU2
+ *           format (PF >= 240) is always broadcast.
+ * @param data The message, it's not copied and must be kept until the
+ *             `tx_handler` is called if it's longer than 8 bytes.
+ * @param len Length of message, 1785 bytes at most.
+ * @return Send status.
+ *  @retval - 0: Success. For the messages longer than 8 bytes, `tx_handler`
+ *               will be called once with the result.
+ *  @retval - 1: Send error, J1939 is not enabled, or no address.
+ *  @retval - 2: Address claim is in progress, transport session is busy,
+ *               or timeout.
+ *  @retval - 3: Parameter invalid.
+ *  @retval - 4: J1939 or this CAN is not initialized.
+ * @note Broadcast uses BAM, the data packets are sent every 50 ms by
+ *       `can_j1939_poll()`. Destination specific uses RTS/CTS, the data
+ *       packets of each CTS window are sent back-to-back in transmit
+ *       interrupt.
+ */
+uint8_t can_j1939_send(uint32_t pgn, uint8_t priority, uint8_t da,
+                       const uint8_t *data, uint32_t len) {
+#if CAN_J1939_ENABLE
+    if ((data == NULL) || (len == 0) || (len > CAN_J1939_TP_MAX) ||
+        (pgn > 0x3FFFFU) || (priority > 7)) {
         return 3;
     }
 
-    if (HAL_CAN_GetState(can_handle) == HAL_CAN_STATE_RESET) {
+    if (can_j1939.ready == 0) {
         return 4;
     }
 
-    uint16_t wait_time = 0;
-    uint32_t tx_mail_box = CAN_TX_MAILBOX0;
+    if (can_j1939.claim == CAN_J1939_LOST) {
+        return 1;
+    }
 
-    CAN_TxHeaderTypeDef tx_header = {0};
-    tx_header.IDE = can_ide;
-    tx_header.RTR = CAN_RTR_REMOTE;
-    tx_header.DLC = len;
-    if (can_ide == CAN_ID_STD) {
-        tx_header.StdId = id;
+    if (can_j1939.claim == CAN_J1939_CLAIMING) {
+        return 2;
+    }
+
+    if (((pgn >> 8) & 0xFFU) >= 240) {
+        da = CAN_J1939_GLOBAL;
     } else {
-        tx_header.ExtId = id;
+        pgn &= 0x3FF00U;
     }
 
-    while (HAL_CAN_GetTxMailboxesFreeLevel(can_handle) == 0) {
-        /* Wait to all mailbox is empty. */
-        ++wait_time;
-        if (wait_time > CAN_SEND_TIMEOUT) {
-            return 2;
+    if (len <= 8) {
+        return can_j1939_send_frame(priority, pgn, da, can_j1939.address, data,
+                                    len);
+    }
+
+    can_j1939_session_t *tx = &can_j1939.tx;
+    uint8_t packets = (len + 6) / 7;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (tx->state != CAN_J1939_TP_IDLE) {
+        __set_PRIMASK(primask);
+        return 2;
+    }
+
+    tx->peer = da;
+    tx->priority = priority;
+    tx->pgn = pgn;
+    tx->len = len;
+    tx->packets = packets;
+    tx->next = 1;
+    tx->tx_data = data;
+    tx->tick = HAL_GetTick();
+    tx->timeout = CAN_J1939_T3;
+    /* Wait for CTS before RTS is sent, it may come very soon. */
+    tx->state = (da == CAN_J1939_GLOBAL) ? CAN_J1939_TP_BAM
+                                         : CAN_J1939_TP_WAIT_CTS;
+
+    __set_PRIMASK(primask);
+
+    uint8_t cm[8] = {(da == CAN_J1939_GLOBAL) ? CAN_J1939_CM_BAM
+                                              : CAN_J1939_CM_RTS,
+                     len & 0xFFU,
+                     len >> 8,
+                     packets,
+                     0xFF,
+                     pgn & 0xFFU,
+                     (pgn >> 8) & 0xFFU,
+                     (pgn >> 16) & 0xFFU};
+    uint8_t res = can_j1939_send_frame(priority, CAN_J1939_PGN_TP_CM, da,
+                                       can_j1939.address, cm, sizeof(cm));
+    if (res != 0) {
+        tx->state = CAN_J1939_TP_IDLE;
+    }
+
+    return res;
+#else  /* CAN_J1939_ENABLE */
+    UNUSED(pgn);
+    UNUSED(priority);
+    UNUSED(da);
+    UNUSED(data);
+    UNUSED(len);
+    return 1;
+#endif /* CAN_J1939_ENABLE */
+}
+
+/**
+ * @brief Run the timers of J1939 node: address claim, BAM data packets and
+ *        the timeouts of transport sessions.
+ *
+ * @note Call it periodically, every 10 ms or faster.
+ */
+void can_j1939_poll(void) {
+#if CAN_J1939_ENABLE
+    if (can_j1939.ready == 0) {
+        return;
+    }
+
+    can_j1939_session_t *tx = &can_j1939.tx;
+    uint8_t result = 0xFF;
+    uint8_t abort_peer = CAN_J1939_NULL_ADDR;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    uint32_t tick = HAL_GetTick();
+
+    if ((can_j1939.claim == CAN_J1939_CLAIMING) &&
+        (tick - can_j1939.claim_tick >= CAN_J1939_CLAIM_WAIT)) {
+        can_j1939.claim = CAN_J1939_CLAIMED;
+    }
+
+    if ((tx->state == CAN_J1939_TP_BAM) &&
+        (tick - tx->tick >= CAN_J1939_BAM_GAP)) {
+        can_frame_t frame = {.id = can_j1939_id(tx->priority,
+                                                CAN_J1939_PGN_TP_DT,
+                                                CAN_J1939_GLOBAL,
+                                                can_j1939.address),
+                             .ide = CAN_ID_EXT,
+                             .rtr = CAN_RTR_DATA,
+                             .dlc = 8};
+
+        can_j1939_build_dt(tx, &frame);
+        if (can_tp_write(can_j1939.config.can_selected,
+                         CAN_ID_WORD_EXT(frame.id), &frame) == 0) {
+            tx->tick = tick;
+            if (tx->next++ == tx->packets) {
+                tx->state = CAN_J1939_TP_IDLE;
+                result = CAN_J1939_OK;
+            }
         }
+    } else if ((tx->state >= CAN_J1939_TP_WAIT_CTS) &&
+               (tx->state != CAN_J1939_TP_SENDING) &&
+               (tick - tx->tick > tx->timeout)) {
+        tx->state = CAN_J1939_TP_IDLE;
+        result = CAN_J1939_TIMEOUT_ERR;
+        abort_peer = tx->peer;
     }
 
-    if (HAL_CAN_AddTxMessage(can_handle, &tx_header, msg, &tx_mail_box) !=
-        HAL_OK) {
-        return 1;
+    __set_PRIMASK(primask);
+
+    if (abort_peer != CAN_J1939_NULL_ADDR) {
+        can_j1939_send_cm(abort_peer, CAN_J1939_CM_ABORT,
+                          0xFFFFFF00U | CAN_J1939_ABORT_TIMEOUT, tx->pgn);
     }
 
-    return 0;
+    if ((result != 0xFF) && (can_j1939.config.tx_handler != NULL)) {
+        can_j1939.config.tx_handler(tx->pgn, result);
+    }
+
+    for (uint32_t i = 0; i < CAN_J1939_RX_SESSIONS; ++i) {
+        can_j1939_session_t *session = &can_j1939.rx[i];
+        uint8_t cmdt = 0;
+
+        primask = __get_PRIMASK();
+        __disable_irq();
+
+        if ((session->state == CAN_J1939_TP_IDLE) ||
+            (tick - session->tick <= session->timeout)) {
+            __set_PRIMASK(primask);
+            continue;
+        }
+
+        cmdt = (session->state == CAN_J1939_TP_CMDT);
+        session->state = CAN_J1939_TP_IDLE;
+
+        __set_PRIMASK(primask);
+
+        if (cmdt) {
+            can_j1939_send_cm(session->peer, CAN_J1939_CM_ABORT,
+                              0xFFFFFF00U | CAN_J1939_ABORT_TIMEOUT,
+                              session->pgn);
+        }
+    }
+#endif /* CAN_J1939_ENABLE */
+}
+
+/**
+ * @brief Get the address of J1939 node.
+ *
+ * @return The claimed address. `CAN_J1939_NULL_ADDR` if the address claim
+ *         is in progress or lost, or J1939 is not enabled.
+ */
+uint8_t can_j1939_get_address(void) {
+#if CAN_J1939_ENABLE
+    if ((can_j1939.ready == 0) || (can_j1939.claim != CAN_J1939_CLAIMED)) {
+        return CAN_J1939_NULL_ADDR;
+    }
+
+    return can_j1939.address;
+#else  /* CAN_J1939_ENABLE */
+    return CAN_J1939_NULL_ADDR;
+#endif /* CAN_J1939_ENABLE */
 }
 
 /**
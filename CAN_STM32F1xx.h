@@ -38,6 +38,66 @@ extern "C" {
 /* Wait for can tx mailbox empty times. */
 #define CAN_SEND_TIMEOUT        1000
 
+/* ID word for `can_send_word()`, same layout as `TIxR` register. */
+#define CAN_ID_WORD_STD(id)     ((uint32_t)(id) << CAN_TI0R_STID_Pos)
+#define CAN_ID_WORD_EXT(id)     (((uint32_t)(id) << CAN_TI0R_EXID_Pos) |       \
+                                 CAN_TI0R_IDE)
+#define CAN_ID_WORD_RTR         CAN_TI0R_RTR
+
+/* Let `can_filter_alloc()` choose the FIFO to balance the load. */
+#define CAN_FILTER_FIFO_AUTO    2U
+
+/* Error state of CAN, see `can_bus_stats_t`. */
+#define CAN_BUS_ACTIVE          0
+#define CAN_BUS_WARNING         1
+#define CAN_BUS_PASSIVE         2
+#define CAN_BUS_OFF             3
+
+/* State of software bus-off recovery, see `can_recovery_poll()`. */
+#define CAN_RECOVER_NONE        0
+#define CAN_RECOVER_WAIT        1
+#define CAN_RECOVER_BUSY        2
+
+/* Result of ISO-TP transfer, see `can_isotp_handler_t`. */
+#define CAN_ISOTP_OK            0
+#define CAN_ISOTP_TIMEOUT_ERR   1
+#define CAN_ISOTP_OVERFLOW_ERR  2
+#define CAN_ISOTP_FRAME_ERR     3
+
+/* Let `can_sched_init()` choose the phase to spread the mailbox load. */
+#define CAN_SCHED_OFFSET_AUTO   0xFFFFFFFFU
+
+/* Address of J1939 node. */
+#define CAN_J1939_GLOBAL        255
+#define CAN_J1939_NULL_ADDR     254
+
+/* Result of J1939 transport, see `can_j1939_tx_handler_t`. */
+#define CAN_J1939_OK            0
+#define CAN_J1939_TIMEOUT_ERR   1
+#define CAN_J1939_ABORT_ERR     2
+
+/* Byte order of signal, see `can_signal_t`. */
+#define CAN_SIGNAL_INTEL        0
+#define CAN_SIGNAL_MOTOROLA     1
+
+/* Signal access on the payload word of `can_payload_get()`. With constant
+ * position they are folded to one shift and mask. */
+#define CAN_SIGNAL_MASK(len)                                                   \
+    (((len) >= 64) ? UINT64_MAX : ((1ULL << (len)) - 1))
+/* LSB position of signal in Intel word, `start` is the DBC start bit. */
+#define CAN_SIGNAL_INTEL_LSB(start, len) ((int32_t)(start))
+/* LSB position of signal in Motorola word, `start` is the DBC start bit
+ * (MSB of signal). */
+#define CAN_SIGNAL_MOTOROLA_LSB(start, len)                                    \
+    ((int32_t)(56 - ((start) & 0x38) + ((start) & 0x07)) - (int32_t)(len) + 1)
+#define CAN_SIGNAL_GET(word, lsb, len)                                         \
+    (((uint64_t)(word) >> (lsb)) & CAN_SIGNAL_MASK(len))
+#define CAN_SIGNAL_GET_SIGNED(word, lsb, len)                                  \
+    ((int64_t)((uint64_t)(word) << (64 - (lsb) - (len))) >> (64 - (len)))
+#define CAN_SIGNAL_SET(word, lsb, len, raw)                                    \
+    ((word) = ((word) & ~(CAN_SIGNAL_MASK(len) << (lsb))) |                    \
+              (((uint64_t)(raw) & CAN_SIGNAL_MASK(len)) << (lsb)))
+
 /**
  * @}
  */
@@ -56,6 +116,300 @@ typedef enum {
     can2_selected        /*!< Select CAN2 */
 } can_selected_t;
 
+/**
+ * @brief CAN frame.
+ */
+typedef struct {
+    uint32_t id;         /*!< Standard ID or Extend ID.                     */
+    uint8_t ide;         /*!< `CAN_ID_STD` or `CAN_ID_EXT`.                 */
+    uint8_t rtr;         /*!< `CAN_RTR_DATA` or `CAN_RTR_REMOTE`.           */
+    uint8_t dlc;         /*!< Data length.                                  */
+    uint8_t fmi;         /*!< Filter match index, only for received frame.  */
+    uint8_t data[8];     /*!< Data.                                         */
+    uint32_t timestamp;  /*!< Time stamp of received frame at SOF, valid when
+                              Time Triggered Communication Mode is enabled.
+                              Extended to 32 bits. Unit: bit time.          */
+} can_frame_t;
+
+/**
+ * @brief CAN bit timing, calculated by `can_bit_timing_calc()`.
+ */
+typedef struct {
+    uint16_t prescale;       /*!< Prescale of base frequency, 1-1024.       */
+    uint8_t tseg1;           /*!< Time segment 1, 1-16 tq.                  */
+    uint8_t tseg2;           /*!< Time segment 2, 2-8 tq.                   */
+    uint8_t tsjw;            /*!< Synchronization jump width, 1-4 tq.       */
+    uint16_t sample_point;   /*!< Sample point. Unit: 0.1%.                 */
+    int32_t error;           /*!< Bit rate error. Unit: ppm.                */
+    uint32_t osc_tolerance;  /*!< Oscillator tolerance. Unit: ppm.          */
+} can_bit_timing_t;
+
+/**
+ * @brief The ID or ID range wanted, used by `can_filter_alloc()`.
+ */
+typedef struct {
+    uint32_t id;         /*!< The ID, or the first ID of range.             */
+    uint32_t last;       /*!< The last ID of range, same as `id` for single
+                              ID.                                           */
+    uint8_t ide;         /*!< `CAN_ID_STD` or `CAN_ID_EXT`.                 */
+    uint8_t remote;      /*!< Also accept remote frame: 0: No, 1: Yes.      */
+    uint8_t fifo;        /*!< `CAN_FILTER_FIFO0`, `CAN_FILTER_FIFO1` or
+                              `CAN_FILTER_FIFO_AUTO`.                       */
+} can_filter_id_t;
+
+/**
+ * @brief Handler of received frame.
+ */
+typedef void (*can_rx_handler_t)(can_selected_t can_selected,
+                                 const can_frame_t *frame);
+
+/**
+ * @brief ID and handler, used by `can_dispatch_init()`.
+ */
+typedef struct {
+    uint32_t id;                /*!< Standard ID or Extend ID.              */
+    uint8_t ide;                /*!< `CAN_ID_STD` or `CAN_ID_EXT`.          */
+    can_rx_handler_t handler;   /*!< Handler of this ID.                    */
+} can_dispatch_entry_t;
+
+/**
+ * @brief Handler of ISO-TP transfer, called in interrupt.
+ *
+ * @param channel The channel number.
+ * @param result `CAN_ISOTP_xxx`.
+ * @param len Length of message, or bytes transferred if failed.
+ */
+typedef void (*can_isotp_handler_t)(uint8_t channel, uint8_t result,
+                                    uint32_t len);
+
+/**
+ * @brief Configuration of ISO-TP channel, used by `can_isotp_open()`.
+ */
+typedef struct {
+    can_selected_t can_selected;     /*!< Which CAN.                        */
+    uint32_t tx_id;                  /*!< ID of frames sent.                */
+    uint32_t rx_id;                  /*!< ID of frames received.            */
+    uint8_t ide;                     /*!< `CAN_ID_STD` or `CAN_ID_EXT`.     */
+    uint8_t block_size;              /*!< Block size sent in flow control, 0
+                                          means no more flow control.       */
+    uint8_t st_min;                  /*!< STmin sent in flow control, 0-127
+                                          ms, or 0xF1-0xF9 for 100-900 us.  */
+    uint8_t *rx_buf;                 /*!< Receive buffer, the message is
+                                          assembled into it directly.       */
+    uint32_t rx_size;                /*!< Size of `rx_buf`.                 */
+    can_isotp_handler_t rx_handler;  /*!< Called when message received.     */
+    can_isotp_handler_t tx_handler;  /*!< Called when message sent.         */
+} can_isotp_config_t;
+
+/**
+ * @brief Route of gateway, used by `can_gateway_init()`.
+ */
+typedef struct {
+    can_selected_t src;          /*!< The CAN receives the frame.           */
+    can_selected_t dest;         /*!< The CAN forwards the frame to.        */
+    uint32_t id;                 /*!< Match if `(frame ID & mask) == id`.   */
+    uint32_t mask;               /*!< Mask of ID, all 1 for single ID.      */
+    uint8_t ide;                 /*!< `CAN_ID_STD` or `CAN_ID_EXT`.         */
+    uint8_t local;               /*!< Also handle the frame locally: 0: No,
+                                      1: Yes.                               */
+    uint32_t new_id;             /*!< ID rewrite, the bits in
+                                      `rewrite_mask` are replaced.          */
+    uint32_t rewrite_mask;       /*!< Mask of ID rewrite, 0 keeps the ID.   */
+} can_gateway_route_t;
+
+/**
+ * @brief Counters of gateway route.
+ */
+typedef struct {
+    uint32_t forwarded;  /*!< Frames forwarded.                             */
+    uint32_t dropped;    /*!< Frames dropped, the destination mailboxes or
+                              transmit queue is full, or not initialized.   */
+} can_gateway_stats_t;
+
+/**
+ * @brief Produce the payload of cyclic message, called just before sending.
+ *
+ * @param index The index of entry in schedule table.
+ * @param frame The frame, ID and `dlc` are set. Write `data`, may change
+ *              `dlc`.
+ * @note Called in `can_sched_tick()`, keep it short.
+ */
+typedef void (*can_sched_fill_t)(uint32_t index, can_frame_t *frame);
+
+/**
+ * @brief Entry of cyclic scheduler, used by `can_sched_init()`.
+ */
+typedef struct {
+    can_selected_t can_selected; /*!< The CAN to send.                      */
+    uint32_t id;                 /*!< ID of message.                        */
+    uint8_t ide;                 /*!< `CAN_ID_STD` or `CAN_ID_EXT`.         */
+    uint8_t dlc;                 /*!< Length of message, 0-8.               */
+    uint32_t period;             /*!< Period, Unit: ms.                     */
+    uint32_t offset;             /*!< Phase, Unit: ms. Or
+                                      `CAN_SCHED_OFFSET_AUTO`.              */
+    const uint8_t *data;         /*!< Shared buffer, copied just before
+                                      sending. Unused if `fill` is set.     */
+    can_sched_fill_t fill;       /*!< Payload callback, or NULL.            */
+} can_sched_entry_t;
+
+/**
+ * @brief Achieved period and jitter of cyclic message. Unit: us.
+ */
+typedef struct {
+    uint32_t sent;        /*!< Frames sent.                                  */
+    uint32_t missed;      /*!< Frames dropped, the mailboxes or transmit
+                               queue is full, or not initialized.            */
+    uint32_t last_period; /*!< Period between the last two frames.           */
+    uint32_t min_period;  /*!< The minimum period.                           */
+    uint32_t max_period;  /*!< The maximum period.                           */
+    uint32_t max_jitter;  /*!< The maximum deviation from nominal period.    */
+} can_sched_stats_t;
+
+/**
+ * @brief Signal of message, same as the signal in DBC file.
+ */
+typedef struct {
+    uint8_t start;       /*!< Start bit in DBC, the LSB for Intel, the MSB
+                              for Motorola.                                 */
+    uint8_t length;      /*!< Length of signal, 1-64 bits.                  */
+    uint8_t order;       /*!< `CAN_SIGNAL_INTEL` or `CAN_SIGNAL_MOTOROLA`.  */
+    uint8_t is_signed;   /*!< Two's complement: 0: No, 1: Yes.              */
+    float scale;         /*!< Physical value = raw * scale + offset.        */
+    float offset;        /*!< Offset of physical value.                     */
+} can_signal_t;
+
+/**
+ * @brief ID of change filter, used by `can_change_init()`.
+ */
+typedef struct {
+    uint32_t id;         /*!< Standard ID or Extend ID.                     */
+    uint8_t ide;         /*!< `CAN_ID_STD` or `CAN_ID_EXT`.                 */
+    uint32_t timeout;    /*!< Deliver the unchanged payload again after it,
+                              0 means never. Unit: ms.                      */
+} can_change_entry_t;
+
+/**
+ * @brief Counters of change filter.
+ */
+typedef struct {
+    uint32_t passed;     /*!< Frames delivered, new or changed payload.     */
+    uint32_t suppressed; /*!< Frames dropped, same payload.                 */
+} can_change_stats_t;
+
+/**
+ * @brief ID of remote frame responder, used by `can_respond_init()`.
+ */
+typedef struct {
+    uint32_t id;         /*!< Standard ID or Extend ID.                     */
+    uint8_t ide;         /*!< `CAN_ID_STD` or `CAN_ID_EXT`.                 */
+    uint8_t dlc;         /*!< Length of answered payload, 0-8.              */
+    const uint8_t *data; /*!< Current payload, read when the remote frame
+                              is received. Not copied.                      */
+} can_respond_entry_t;
+
+/**
+ * @brief Counters of remote frame responder.
+ */
+typedef struct {
+    uint32_t answered;   /*!< Remote frames answered.                       */
+    uint32_t dropped;    /*!< Answers dropped, no free mailbox.             */
+} can_respond_stats_t;
+
+/**
+ * @brief Handler of J1939 message, called in interrupt.
+ *
+ * @param pgn Parameter group number, PS field is cleared for PDU1 format.
+ * @param sa Source address.
+ * @param da Destination address, `CAN_J1939_GLOBAL` for broadcast.
+ * @param data The message, valid until the handler returns.
+ * @param len Length of message.
+ */
+typedef void (*can_j1939_handler_t)(uint32_t pgn, uint8_t sa, uint8_t da,
+                                    const uint8_t *data, uint32_t len);
+
+/**
+ * @brief Handler of J1939 transport sent, called in interrupt or
+ *        `can_j1939_poll()`.
+ *
+ * @param pgn Parameter group number.
+ * @param result `CAN_J1939_xxx`.
+ */
+typedef void (*can_j1939_tx_handler_t)(uint32_t pgn, uint8_t result);
+
+/**
+ * @brief Handler of PGN, used by `can_j1939_config_t`.
+ */
+typedef struct {
+    uint32_t pgn;                /*!< Parameter group number.               */
+    can_j1939_handler_t handler; /*!< Handler of this PGN.                  */
+} can_j1939_pgn_t;
+
+/**
+ * @brief Configuration of J1939 node, used by `can_j1939_init()`.
+ */
+typedef struct {
+    can_selected_t can_selected;     /*!< Which CAN.                        */
+    uint64_t name;                   /*!< NAME, bit 63 is arbitrary address
+                                          capable.                          */
+    uint8_t address;                 /*!< Preferred address, 0-253.         */
+    const can_j1939_pgn_t *pgns;     /*!< Handlers of PGN, copied.          */
+    uint32_t pgn_count;              /*!< Number of `pgns`.                 */
+    can_j1939_handler_t default_handler; /*!< Called for the other PGNs, can
+                                              be NULL.                      */
+    can_j1939_tx_handler_t tx_handler; /*!< Called when transport message
+                                            sent, can be NULL.              */
+} can_j1939_config_t;
+
+/**
+ * @brief Statistics of CAN software transmit queue.
+ */
+typedef struct {
+    uint16_t depth;      /*!< Frames in queue now.                          */
+    uint16_t max_depth;  /*!< The maximum frames in queue.                  */
+    uint32_t queued;     /*!< Frames pushed into queue.                     */
+    uint32_t sent;       /*!< Frames transmitted successfully.              */
+    uint32_t dropped;    /*!< Frames dropped because the queue is full, or
+                              transmit error.                               */
+    uint32_t aborted;    /*!< Frames aborted by higher priority frame and
+                              queued again.                                 */
+} can_tx_queue_stats_t;
+
+/**
+ * @brief Transmit latency statistics of CAN, from the frame pushed into
+ *        software transmit queue to the SOF on bus. Unit: bit time.
+ */
+typedef struct {
+    uint32_t count;         /*!< Frames measured.                           */
+    uint32_t last;          /*!< Latency of the last frame.                 */
+    uint32_t min;           /*!< The minimum latency.                       */
+    uint32_t max;           /*!< The maximum latency.                       */
+    uint64_t total;         /*!< Sum of latency, average is `total / count`. */
+    uint32_t tx_timestamp;  /*!< Time stamp of the last transmitted frame.  */
+} can_latency_stats_t;
+
+/**
+ * @brief Bus statistics of CAN, read by `can_bus_get_stats()`.
+ */
+typedef struct {
+    uint8_t tec;             /*!< Transmit error counter.                   */
+    uint8_t rec;             /*!< Receive error counter.                    */
+    uint8_t lec;             /*!< Last error code, see `CAN_ESR_LEC`.       */
+    uint8_t state;           /*!< Error state, `CAN_BUS_xxx`.               */
+    uint32_t rx_frames;      /*!< Total received frames.                    */
+    uint32_t tx_frames;      /*!< Total transmitted frames.                 */
+    uint32_t rx_fps;         /*!< Received frames per second.               */
+    uint32_t tx_fps;         /*!< Transmitted frames per second.            */
+    uint32_t rx_bps;         /*!< Received bits per second.                 */
+    uint32_t tx_bps;         /*!< Transmitted bits per second.              */
+    uint16_t bus_load;       /*!< Bus load. Unit: 0.1%.                     */
+    uint32_t warning_count;  /*!< Times of entering error warning.          */
+    uint32_t passive_count;  /*!< Times of entering error passive.          */
+    uint32_t bus_off_count;  /*!< Times of entering bus-off.                */
+    uint32_t error_count[7]; /*!< Errors by last error code, index 1-6:
+                                  stuff, form, acknowledgment, bit recessive,
+                                  bit dominant, CRC.                        */
+} can_bus_stats_t;
+
 /**
  * @}
  */
@@ -109,11 +463,70 @@ uint8_t can_rate_calc(uint32_t baud_rate, uint32_t prop_delay,
                       uint32_t base_freq, uint32_t *prescale, uint32_t *tsjw,
                       uint32_t *tseg1, uint32_t *tseg2);
 
+uint8_t can_bit_timing_calc(uint32_t baud_rate, uint32_t prop_delay,
+                            uint32_t base_freq, uint16_t sample_point,
+                            can_bit_timing_t *timing);
 CAN_HandleTypeDef *can_get_handle(can_selected_t can_selected);
+uint8_t can_filter_alloc(const can_filter_id_t *can1_ids, uint32_t can1_count,
+                         const can_filter_id_t *can2_ids, uint32_t can2_count);
+uint8_t can_filter_add(can_selected_t can_selected, const can_filter_id_t *id);
+uint8_t can_filter_remove(can_selected_t can_selected,
+                          const can_filter_id_t *id);
+uint8_t can_filter_replace(can_selected_t can_selected,
+                           const can_filter_id_t *ids, uint32_t count);
 uint8_t can_send_message(can_selected_t can_selected, uint32_t can_ide,
                          uint32_t id, uint8_t len, const uint8_t *msg);
 uint8_t can_send_remote(can_selected_t can_selected, uint32_t can_ide,
                         uint32_t id, uint8_t len, const uint8_t *msg);
+uint8_t can_send_word(can_selected_t can_selected, uint32_t id_word,
+                      uint8_t len, const uint8_t *msg);
+uint32_t can_send_batch(can_selected_t can_selected, const can_frame_t *frames,
+                        uint32_t count);
+uint8_t can_tx_queue_get_stats(can_selected_t can_selected,
+                               can_tx_queue_stats_t *stats);
+uint32_t can_receive_batch(can_selected_t can_selected, can_frame_t *frames,
+                           uint32_t max);
+uint32_t can_rx_ring_get_dropped(can_selected_t can_selected);
+uint8_t can_dispatch_init(can_selected_t can_selected,
+                          const can_dispatch_entry_t *entries, uint32_t count,
+                          can_rx_handler_t default_handler);
+uint8_t can_dispatch(can_selected_t can_selected, const can_frame_t *frame);
+uint64_t can_timestamp_now(can_selected_t can_selected);
+uint32_t can_rx_latency(can_selected_t can_selected,
+                        const can_frame_t *frame);
+uint8_t can_latency_get_stats(can_selected_t can_selected,
+                              can_latency_stats_t *stats);
+uint8_t can_bus_get_stats(can_selected_t can_selected,
+                          can_bus_stats_t *stats);
+uint8_t can_recovery_poll(can_selected_t can_selected);
+uint8_t can_isotp_open(uint8_t channel, const can_isotp_config_t *config);
+void can_isotp_close(uint8_t channel);
+uint8_t can_isotp_send(uint8_t channel, const uint8_t *data, uint32_t len);
+void can_isotp_poll(void);
+uint8_t can_gateway_init(const can_gateway_route_t *routes, uint32_t count);
+uint8_t can_gateway_get_stats(uint32_t route, can_gateway_stats_t *stats);
+uint8_t can_sched_init(const can_sched_entry_t *entries, uint32_t count);
+void can_sched_tick(void);
+uint8_t can_sched_get_stats(uint32_t index, can_sched_stats_t *stats);
+uint64_t can_payload_get(const can_frame_t *frame, uint8_t order);
+void can_payload_set(can_frame_t *frame, uint8_t order, uint64_t payload);
+uint8_t can_signal_unpack(const can_signal_t *signals, uint32_t count,
+                          const can_frame_t *frame, float *values);
+uint8_t can_signal_pack(const can_signal_t *signals, uint32_t count,
+                        const float *values, can_frame_t *frame);
+uint8_t can_change_init(can_selected_t can_selected,
+                        const can_change_entry_t *entries, uint32_t count);
+uint8_t can_change_get_stats(can_selected_t can_selected,
+                             can_change_stats_t *stats);
+uint8_t can_respond_init(can_selected_t can_selected,
+                         const can_respond_entry_t *entries, uint32_t count);
+uint8_t can_respond_get_stats(can_selected_t can_selected,
+                              can_respond_stats_t *stats);
+uint8_t can_j1939_init(const can_j1939_config_t *config);
+uint8_t can_j1939_send(uint32_t pgn, uint8_t priority, uint8_t da,
+                       const uint8_t *data, uint32_t len);
+void can_j1939_poll(void);
+uint8_t can_j1939_get_address(void);
 /**
  * @}
  */
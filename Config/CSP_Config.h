@@ -133,6 +133,18 @@
 #define USART1_TX_DMA_BUF_SIZE    256
 //   </e>
 
+//   <e> Synchronous mode
+//   <i> Output the clock on CK pin (PA8).
+//   <i> Using `usart1_sync_init()` instead of `usart1_init()`, the DMA Rx
+//   <i> and DMA Tx above are reused by synchronous mode.
+#define USART1_SYNC_ENABLE        0
+//   </e>
+
+#if USART1_SYNC_ENABLE
+#define USART1_CK_PORT A
+#define USART1_CK_PIN  GPIO_PIN_8
+#endif /* USART1_SYNC_ENABLE */
+
 #endif /* USART1_ENABLE */
 
 // </e>
@@ -258,6 +270,23 @@
 #define USART2_TX_DMA_BUF_SIZE    256
 //   </e>
 
+//   <e> Synchronous mode
+//   <i> Output the clock on CK pin (PA4, PD7 according to IO Remap).
+//   <i> Using `usart2_sync_init()` instead of `usart2_init()`, the DMA Rx
+//   <i> and DMA Tx above are reused by synchronous mode.
+#define USART2_SYNC_ENABLE        0
+//   </e>
+
+#if USART2_SYNC_ENABLE
+#if (USART2_IO_REMAP == 0)
+#define USART2_CK_PORT A
+#define USART2_CK_PIN  GPIO_PIN_4
+#elif (USART2_IO_REMAP == 1)
+#define USART2_CK_PORT D
+#define USART2_CK_PIN  GPIO_PIN_7
+#endif
+#endif /* USART2_SYNC_ENABLE */
+
 #endif /* USART2_ENABLE */
 
 // </e>
@@ -402,6 +431,26 @@
 #define USART3_TX_DMA_BUF_SIZE    256
 //   </e>
 
+//   <e> Synchronous mode
+//   <i> Output the clock on CK pin (PB12, PC12, PD10 according to IO Remap).
+//   <i> Using `usart3_sync_init()` instead of `usart3_init()`, the DMA Rx
+//   <i> and DMA Tx above are reused by synchronous mode.
+#define USART3_SYNC_ENABLE        0
+//   </e>
+
+#if USART3_SYNC_ENABLE
+#if (USART3_IO_REMAP == 0)
+#define USART3_CK_PORT B
+#define USART3_CK_PIN  GPIO_PIN_12
+#elif (USART3_IO_REMAP == 1)
+#define USART3_CK_PORT C
+#define USART3_CK_PIN  GPIO_PIN_12
+#elif (USART3_IO_REMAP == 2)
+#define USART3_CK_PORT D
+#define USART3_CK_PIN  GPIO_PIN_10
+#endif
+#endif /* USART3_SYNC_ENABLE */
+
 #endif /* USART3_ENABLE */
 
 // </e>
@@ -1056,6 +1105,11 @@
 #error "Invalid CAN1 IO Remap Configuration! "
 #endif
 
+//   <q> Time Triggered Communication Mode
+//   <i> Capture the time stamp of each frame at SOF, the time stamp of
+//   <i> received frame is extended to 32 bits. Unit: CAN bit time.
+#define CAN1_TTCM            0
+
 //   <e> Enable CAN Transmit Interrupt
 #define CAN1_ENABLE_TX_IT    0
 //     <o> CAN Transmit Interrupt Priority <0-15>
@@ -1064,6 +1118,17 @@
 //     <o> CAN Transmit Interrupt SubPriority <0-15>
 //     <i> The Interrupt SubPriority of CAN Transmit
 #define CAN1_TX_IT_SUB       3
+//     <o> Software Transmit Queue Size <0-255>
+//     <i> Queue the frames when all mailboxes are busy, and load them into
+//     <i> mailboxes in transmit interrupt. 0: Disable the queue.
+//     <i> Frames are sent in order of CAN ID (arbitration priority).
+//     <i> Non-zero: `can_send_message()` returns once the frame is queued,
+//     <i> and returns 2 if the queue is full, instead of waiting a mailbox.
+#define CAN1_TX_QUEUE_SIZE   0
+//     <q> Abort Lower Priority Mailbox
+//     <i> Abort the lowest priority pending mailbox and queue it again when
+//     <i> a higher priority frame is waiting for a mailbox.
+#define CAN1_TX_PREEMPT      1
 //   </e>
 
 //   <e> Enable CAN Receive FIFO0 Interrupt
@@ -1074,6 +1139,11 @@
 //     <o> CAN Receive FIFO0 Interrupt SubPriority <0-15>
 //     <i> The Interrupt SubPriority of CAN Receive FIFO0
 #define CAN1_RX0_IT_SUB      3
+//     <o> Software Receive Ring Size <0-255>
+//     <i> Read the frames from FIFO0 into ring buffer in interrupt, and get
+//     <i> them by `can_receive_batch()`. 0: Disable, use HAL callback.
+//     <i> Non-zero: `HAL_CAN_RxFifo0MsgPendingCallback()` is not called.
+#define CAN1_RX0_RING_SIZE   0
 //   </e>
 
 //   <e> Enable CAN Receive FIFO1 Interrupt
@@ -1084,6 +1154,11 @@
 //     <o> CAN Receive FIFO1 Interrupt SubPriority <0-15>
 //     <i> The Interrupt SubPriority of CAN Receive FIFO1
 #define CAN1_RX1_IT_SUB      3
+//     <o> Software Receive Ring Size <0-255>
+//     <i> Read the frames from FIFO1 into ring buffer in interrupt, and get
+//     <i> them by `can_receive_batch()`. 0: Disable, use HAL callback.
+//     <i> Non-zero: `HAL_CAN_RxFifo1MsgPendingCallback()` is not called.
+#define CAN1_RX1_RING_SIZE   0
 //   </e>
 
 //   <e> Enable CAN Stauts Change or Error (SCE) Interrupt
@@ -1126,6 +1201,11 @@
 #error "Invalid CAN2 IO Remap Configuration! "
 #endif
 
+//   <q> Time Triggered Communication Mode
+//   <i> Capture the time stamp of each frame at SOF, the time stamp of
+//   <i> received frame is extended to 32 bits. Unit: CAN bit time.
+#define CAN2_TTCM            0
+
 //   <e> Enable CAN Transmit Interrupt
 #define CAN2_ENABLE_TX_IT    0
 //     <o> CAN Transmit Interrupt Priority <0-15>
@@ -1134,6 +1214,17 @@
 //     <o> CAN Transmit Interrupt SubPriority <0-15>
 //     <i> The Interrupt SubPriority of CAN Transmit
 #define CAN2_TX_IT_SUB       3
+//     <o> Software Transmit Queue Size <0-255>
+//     <i> Queue the frames when all mailboxes are busy, and load them into
+//     <i> mailboxes in transmit interrupt. 0: Disable the queue.
+//     <i> Frames are sent in order of CAN ID (arbitration priority).
+//     <i> Non-zero: `can_send_message()` returns once the frame is queued,
+//     <i> and returns 2 if the queue is full, instead of waiting a mailbox.
+#define CAN2_TX_QUEUE_SIZE   0
+//     <q> Abort Lower Priority Mailbox
+//     <i> Abort the lowest priority pending mailbox and queue it again when
+//     <i> a higher priority frame is waiting for a mailbox.
+#define CAN2_TX_PREEMPT      1
 //   </e>
 
 //   <e> Enable CAN Receive FIFO0 Interrupt
@@ -1144,6 +1235,11 @@
 //     <o> CAN Receive FIFO0 Interrupt SubPriority <0-15>
 //     <i> The Interrupt SubPriority of CAN Receive FIFO0
 #define CAN2_RX0_IT_SUB      3
+//     <o> Software Receive Ring Size <0-255>
+//     <i> Read the frames from FIFO0 into ring buffer in interrupt, and get
+//     <i> them by `can_receive_batch()`. 0: Disable, use HAL callback.
+//     <i> Non-zero: `HAL_CAN_RxFifo0MsgPendingCallback()` is not called.
+#define CAN2_RX0_RING_SIZE   0
 //   </e>
 
 //   <e> Enable CAN Receive FIFO1 Interrupt
@@ -1154,6 +1250,11 @@
 //     <o> CAN Receive FIFO1 Interrupt SubPriority <0-15>
 //     <i> The Interrupt SubPriority of CAN Receive FIFO1
 #define CAN2_RX1_IT_SUB      3
+//     <o> Software Receive Ring Size <0-255>
+//     <i> Read the frames from FIFO1 into ring buffer in interrupt, and get
+//     <i> them by `can_receive_batch()`. 0: Disable, use HAL callback.
+//     <i> Non-zero: `HAL_CAN_RxFifo1MsgPendingCallback()` is not called.
+#define CAN2_RX1_RING_SIZE   0
 //   </e>
 
 //   <e> Enable CAN Stauts Change or Error (SCE) Interrupt
@@ -1170,6 +1271,130 @@
 
 // </e>
 
+// <h> CAN Common Options
+//   <o> Sample Point (0.1%) <500-950>
+//   <i> The target sample point of bit timing, 875 means 87.5%.
+#define CAN_SAMPLE_POINT        875
+//   <o> Maximum Bit Rate Error (ppm) <0-20000>
+//   <i> The maximum error between the bit rate and the required.
+#define CAN_RATE_TOLERANCE      1000
+//   <o> Minimum Oscillator Tolerance (ppm) <0-15800>
+//   <i> The bit timing must tolerate this clock deviation between nodes.
+#define CAN_OSC_TOLERANCE       1000
+//   <o> Maximum Filter IDs of Each CAN <1-112>
+//   <i> The IDs of `can_filter_alloc()` are kept, so they can be changed
+//   <i> at runtime by `can_filter_add()` and `can_filter_remove()`.
+#define CAN_FILTER_IDS          32
+
+//   <q> Register-Level Fast Path
+//   <i> Send and receive frames by accessing the mailbox registers directly,
+//   <i> instead of `HAL_CAN_AddTxMessage()` and `HAL_CAN_GetRxMessage()`.
+//   <i> The HAL state and error code of the handle are not updated by the
+//   <i> frames sent and received this way.
+#define CAN_FAST_PATH           0
+
+//   <q> Bus Statistics
+//   <i> Count frames, bits and bus load, sample error counters and error
+//   <i> state, see `can_bus_get_stats()`. Enable SCE interrupt to count the
+//   <i> errors and state transitions.
+//   <i> Transmitted frames are counted in transmit interrupt. Received
+//   <i> frames are counted only when they are read in receive interrupt
+//   <i> (receive ring, dispatch in interrupt, ISO-TP, gateway etc.), not the
+//   <i> frames left to HAL callback.
+//   <i> The counting adds a short critical section to every transmit and
+//   <i> receive interrupt.
+#define CAN_STATS_ENABLE        0
+
+//   <o> Bus-Off Recovery
+//   <i> Hardware: Recover automatically after 128 x 11 recessive bits.
+//   <i> Software: Recover in `can_recovery_poll()` after the backoff time,
+//   <i> which doubles on each failure. The queued frames are kept.
+//   <i> Disabled: The CAN stays bus-off until it is initialized again.
+//   <0=>Disabled <1=>Hardware <2=>Software
+#define CAN_BUS_OFF_RECOVERY    0
+//   <o> Minimum Backoff Time (ms) <1-60000>
+#define CAN_BUS_OFF_BACKOFF_MIN 10
+//   <o> Maximum Backoff Time (ms) <1-60000>
+#define CAN_BUS_OFF_BACKOFF_MAX 1000
+
+//   <e> Receive Dispatch
+//   <i> Call the handler of each ID, set by `can_dispatch_init()`.
+//   <i> Standard IDs use 2 KB direct-indexed table for each CAN.
+#define CAN_DISPATCH_ENABLE     0
+//     <o> Maximum Handlers of Each CAN <1-255>
+#define CAN_DISPATCH_SIZE       32
+//     <q> Dispatch in Receive Interrupt
+//     <i> Call the handlers in receive interrupt. The frames without handler
+//     <i> go to the receive ring, they are dropped if the ring is disabled.
+#define CAN_DISPATCH_IN_ISR     1
+//   </e>
+
+//   <e> ISO-TP (ISO 15765-2)
+//   <i> Transport layer with normal addressing, see `can_isotp_open()`. The
+//   <i> frames are handled in receive and transmit interrupt, the frames of
+//   <i> FIFO without receive ring are dropped if they are not ISO-TP.
+#define CAN_ISOTP_ENABLE        0
+//     <o> Number of Channels <1-32>
+#define CAN_ISOTP_CHANNELS      4
+//     <o> Timeout (ms) <1-60000>
+//     <i> Waiting for flow control (N_Bs) or consecutive frame (N_Cr).
+#define CAN_ISOTP_TIMEOUT       1000
+//     <q> Pad Frames to 8 Bytes
+#define CAN_ISOTP_PADDING       1
+//     <o> Padding Byte <0x00-0xFF>
+#define CAN_ISOTP_PAD_BYTE      0xCC
+//   </e>
+
+//   <e> Gateway
+//   <i> Forward the received frames to the other CAN in receive interrupt
+//   <i> by the routing table, see `can_gateway_init()`.
+#define CAN_GATEWAY_ENABLE      0
+//     <o> Maximum Routes <1-255>
+#define CAN_GATEWAY_ROUTES      16
+//   </e>
+
+//   <e> Cyclic Scheduler
+//   <i> Send the periodic messages by schedule table, see `can_sched_init()`.
+//   <i> Call `can_sched_tick()` from a timer interrupt every tick.
+#define CAN_SCHED_ENABLE        0
+//     <o> Maximum Entries <1-255>
+#define CAN_SCHED_SIZE          32
+//     <o> Tick Period (ms) <1-1000>
+#define CAN_SCHED_TICK          1
+//   </e>
+
+//   <e> Change Filter
+//   <i> Deliver the frames of listed IDs only when the payload changes or
+//   <i> after timeout, see `can_change_init()`. It works on the frames read
+//   <i> in receive interrupt, by receive ring or dispatch in interrupt.
+#define CAN_CHANGE_ENABLE       0
+//     <o> Maximum IDs of Each CAN <1-255>
+#define CAN_CHANGE_SIZE         32
+//   </e>
+
+//   <e> Remote Frame Responder
+//   <i> Answer the remote frames of listed IDs in receive interrupt with the
+//   <i> current payload, see `can_respond_init()`.
+#define CAN_RESPOND_ENABLE      0
+//     <o> Maximum IDs of Each CAN <1-255>
+#define CAN_RESPOND_SIZE        16
+//   </e>
+
+//   <e> J1939
+//   <i> SAE J1939 node with address claim and transport protocol (BAM and
+//   <i> RTS/CTS), see `can_j1939_init()`. The frames are handled in receive
+//   <i> and transmit interrupt, call `can_j1939_poll()` every 10 ms.
+#define CAN_J1939_ENABLE        0
+//     <o> Maximum PGN Handlers <1-255>
+#define CAN_J1939_PGNS          16
+//     <o> Receive Sessions <1-16>
+//     <i> Transport messages received at the same time.
+#define CAN_J1939_RX_SESSIONS   2
+//     <o> Maximum Receive Message Length <9-1785>
+#define CAN_J1939_RX_SIZE       256
+//   </e>
+// </h>
+
 // <e> ETH (Ethernet Interface)
 #define ETH_ENABLE           0
 
@@ -1355,6 +1580,27 @@
 
 // </e>
 
+// <e> Static DMA Buffer
+// <i> Place all DMA buffers of CSP in static arrays instead of `CSP_MALLOC`.
+// <i> The buffer size is fixed by configuration and can't be resized.
+#define CSP_DMA_BUF_STATIC         0
+
+#if CSP_DMA_BUF_STATIC
+
+//   <o> Alignment of DMA buffer [byte] <4=>4 <8=>8 <16=>16 <32=>32
+#define CSP_DMA_BUF_ALIGN          4
+
+//   <e> Place DMA buffer in dedicated linker section
+#define CSP_DMA_BUF_SECTION_ENABLE 0
+//     <s> Linker section name
+//     <i> The section must be defined in the linker script.
+#define CSP_DMA_BUF_SECTION        ".dma_buf"
+//   </e>
+
+#endif /* CSP_DMA_BUF_STATIC */
+
+// </e>
+
 // <<< end of configuration section >>>
 
 #ifdef __cplusplus
@@ -1391,6 +1637,16 @@ extern "C" {
 #define CSP_REALLOC(p, x)           realloc(p, x)
 #include <stdlib.h>
 
+/* Attribute of the static DMA buffers. */
+#if CSP_DMA_BUF_STATIC && CSP_DMA_BUF_SECTION_ENABLE
+#define CSP_DMA_BUF_ATTR                                                       \
+    __attribute__((aligned(CSP_DMA_BUF_ALIGN), section(CSP_DMA_BUF_SECTION)))
+#elif CSP_DMA_BUF_STATIC
+#define CSP_DMA_BUF_ATTR __attribute__((aligned(CSP_DMA_BUF_ALIGN)))
+#else /* CSP_DMA_BUF_STATIC && CSP_DMA_BUF_SECTION_ENABLE */
+#define CSP_DMA_BUF_ATTR
+#endif /* CSP_DMA_BUF_STATIC && CSP_DMA_BUF_SECTION_ENABLE */
+
 /* Devices Family header files.  */
 #include "stm32f1xx_hal.h"
 
@@ -20,7 +20,12 @@
  */
 
 /* The buf of `uart_pirntf` and `uart_scanf`. */
-static char uart_buffer[256];
+static char uart_buffer[256] CSP_DMA_BUF_ATTR;
+
+/* Auto baud detection of `u(s)artx_init()`, it needs the RX pin. */
+#define UART_AUTOBAUD_ENABLE                                                   \
+    (USART1_RX_ENABLE || USART2_RX_ENABLE || USART3_RX_ENABLE ||               \
+     UART4_RX_ENABLE || UART5_RX_ENABLE)
 
 /**
  * @brief Send buf of UART.
@@ -45,6 +50,19 @@ typedef struct {
     uint32_t fifo_size;   /*!< Size of `rx_fifo_buf`.        */
 } uart_rx_fifo_t;
 
+#if USART1_SYNC_ENABLE || USART2_SYNC_ENABLE || USART3_SYNC_ENABLE
+/**
+ * @brief Staging buffers of USART synchronous mode, the DMA buffers of
+ *        asynchronous mode.
+ */
+typedef struct {
+    uart_tx_buf_t *tx_buf;   /*!< Send buf, `NULL` without Tx DMA.    */
+    uart_rx_fifo_t *rx_fifo; /*!< Receive buf, `NULL` without Rx DMA. */
+    uint8_t *rx_data;        /*!< The buf of caller, the received data
+                                  is copied to it when done.          */
+} usart_sync_buf_t;
+#endif /* USART1_SYNC_ENABLE || USART2_SYNC_ENABLE || USART3_SYNC_ENABLE */
+
 /**
  * @}
  */
@@ -58,6 +76,25 @@ static void uart_dmarx_halfdone_callback(UART_HandleTypeDef *huart);
 static void uart_dmarx_done_callback(UART_HandleTypeDef *huart);
 void uart_dmarx_idle_callback(UART_HandleTypeDef *huart);
 
+#if USART1_RX_DMA || USART2_RX_DMA || USART3_RX_DMA || UART4_RX_DMA
+static uint8_t uart_rx_fifo_alloc(uart_rx_fifo_t *uart_rx_fifo);
+static void uart_rx_fifo_free(uart_rx_fifo_t *uart_rx_fifo);
+#endif /* USART1_RX_DMA || USART2_RX_DMA || USART3_RX_DMA || UART4_RX_DMA */
+
+#if USART1_TX_DMA || USART2_TX_DMA || USART3_TX_DMA || UART4_TX_DMA
+static uint8_t uart_tx_buf_alloc(uart_tx_buf_t *uart_tx_buf);
+static void uart_tx_buf_free(uart_tx_buf_t *uart_tx_buf);
+#endif /* USART1_TX_DMA || USART2_TX_DMA || USART3_TX_DMA || UART4_TX_DMA */
+
+#if USART1_SYNC_ENABLE || USART2_SYNC_ENABLE || USART3_SYNC_ENABLE
+static void usart_sync_done_callback(USART_HandleTypeDef *husart);
+#endif /* USART1_SYNC_ENABLE || USART2_SYNC_ENABLE || USART3_SYNC_ENABLE */
+
+#if UART_AUTOBAUD_ENABLE
+static uint32_t uart_autobaud_measure(GPIO_TypeDef *port, uint32_t pin);
+static void uart_autobaud_apply(UART_HandleTypeDef *huart, uint32_t bit_cycles);
+#endif /* UART_AUTOBAUD_ENABLE */
+
 /**
  * @}
  */
@@ -74,6 +111,15 @@ UART_HandleTypeDef usart1_handle = {.Instance = USART1,
                                              .StopBits = UART_STOPBITS_1,
                                              .Parity = UART_PARITY_NONE}};
 
+#if USART1_SYNC_ENABLE
+USART_HandleTypeDef usart1_sync_handle = {
+    .Instance = USART1,
+    .Init = {.WordLength = USART_WORDLENGTH_8B,
+             .StopBits = USART_STOPBITS_1,
+             .Parity = USART_PARITY_NONE,
+             .CLKLastBit = USART_LASTBIT_ENABLE}};
+#endif /* USART1_SYNC_ENABLE */
+
 #if USART1_RX_DMA
 
 static DMA_HandleTypeDef usart1_dmarx_handle = {
@@ -86,8 +132,18 @@ static DMA_HandleTypeDef usart1_dmarx_handle = {
              .PeriphInc = DMA_PINC_DISABLE,
              .Priority = USART1_RX_DMA_PRIORITY}};
 
+#if CSP_DMA_BUF_STATIC
+static uint8_t usart1_recv_buf[USART1_RX_DMA_BUF_SIZE] CSP_DMA_BUF_ATTR;
+static uint8_t usart1_rx_fifo_buf[USART1_RX_DMA_FIFO_SIZE] CSP_DMA_BUF_ATTR;
+
+static uart_rx_fifo_t usart1_rx_fifo = {.rx_fifo_buf = usart1_rx_fifo_buf,
+                                        .recv_buf = usart1_recv_buf,
+                                        .buf_size = USART1_RX_DMA_BUF_SIZE,
+                                        .fifo_size = USART1_RX_DMA_FIFO_SIZE};
+#else /* CSP_DMA_BUF_STATIC */
 static uart_rx_fifo_t usart1_rx_fifo = {.buf_size = USART1_RX_DMA_BUF_SIZE,
                                         .fifo_size = USART1_RX_DMA_FIFO_SIZE};
+#endif /* CSP_DMA_BUF_STATIC */
 
 #endif /* USART1_RX_DMA */
 
@@ -103,14 +159,36 @@ static DMA_HandleTypeDef usart1_dmatx_handle = {
              .PeriphInc = DMA_PINC_DISABLE,
              .Priority = USART1_TX_DMA_PRIORITY}};
 
+#if CSP_DMA_BUF_STATIC
+static uint8_t usart1_send_buf[USART1_TX_DMA_BUF_SIZE] CSP_DMA_BUF_ATTR;
+
+static uart_tx_buf_t usart1_tx_buf = {.send_buf = usart1_send_buf,
+                                      .buf_size = USART1_TX_DMA_BUF_SIZE};
+#else /* CSP_DMA_BUF_STATIC */
 static uart_tx_buf_t usart1_tx_buf = {.buf_size = USART1_TX_DMA_BUF_SIZE};
+#endif /* CSP_DMA_BUF_STATIC */
+
+#endif /* USART1_TX_DMA */
 
+#if USART1_SYNC_ENABLE
+static usart_sync_buf_t usart1_sync_buf = {
+    .rx_data = NULL,
+#if USART1_TX_DMA
+    .tx_buf = &usart1_tx_buf,
 #endif /* USART1_TX_DMA */
+#if USART1_RX_DMA
+    .rx_fifo = &usart1_rx_fifo,
+#endif /* USART1_RX_DMA */
+};
+#endif /* USART1_SYNC_ENABLE */
 
 /**
  * @brief USART1 initialization
  *
- * @param baud_rate Baud rate.
+ * @param baud_rate Baud rate. `UART_AUTO_BAUD`: Detect the baud rate by the
+ *                  sync byte 0x55 sent by host. It blocks until a 0x55
+ *                  arrives or `UART_AUTO_BAUD_TIMEOUT`, the interrupts
+ *                  are disabled only while waiting for one edge.
  * @return USART1 init status.
  *  @retval - 0: `UART_INIT_OK`:       Success.
  *  @retval - 1: `UART_INIT_FAIL`:     UART init failed.
@@ -118,12 +196,20 @@ static uart_tx_buf_t usart1_tx_buf = {.buf_size = USART1_TX_DMA_BUF_SIZE};
  *  @retval - 3: `UART_INIT_MEM_FAIL`: UART buffer memory init failed (It will
  *                                    dynamic allocate memory when using DMA).
  *  @retval - 4: `UART_INITED`:        This uart is inited.
+ *  @retval - 5: `UART_INIT_BAUD_FAIL`: Auto baud detection timeout or failed.
  */
 uint8_t usart1_init(uint32_t baud_rate) {
     if (HAL_UART_GetState(&usart1_handle) != HAL_UART_STATE_RESET) {
         return UART_INITED;
     }
 
+#if USART1_SYNC_ENABLE
+    if (HAL_USART_GetState(&usart1_sync_handle) != HAL_USART_STATE_RESET) {
+        /* This USART is running in synchronous mode. */
+        return UART_INITED;
+    }
+#endif /* USART1_SYNC_ENABLE */
+
     GPIO_InitTypeDef gpio_init_struct = {.Pull = GPIO_PULLUP,
                                          .Speed = GPIO_SPEED_FREQ_HIGH};
     usart1_handle.Init.BaudRate = baud_rate;
@@ -165,32 +251,36 @@ uint8_t usart1_init(uint32_t baud_rate) {
     HAL_GPIO_Init(CSP_GPIO_PORT(USART1_RTS_PORT), &gpio_init_struct);
 #endif /* USART1_RTS_ENABLE */
 
+#if USART1_RX_ENABLE
+    uint32_t bit_cycles = 0;
+    if (baud_rate == UART_AUTO_BAUD) {
+        bit_cycles = uart_autobaud_measure(CSP_GPIO_PORT(USART1_RX_PORT),
+                                           USART1_RX_PIN);
+        if (bit_cycles == 0) {
+            return UART_INIT_BAUD_FAIL;
+        }
+        usart1_handle.Init.BaudRate = HAL_RCC_GetHCLKFreq() / bit_cycles;
+    }
+#else  /* USART1_RX_ENABLE */
+    if (baud_rate == UART_AUTO_BAUD) {
+        /* Auto baud detection need RX. */
+        return UART_INIT_BAUD_FAIL;
+    }
+#endif /* USART1_RX_ENABLE */
+
     __HAL_RCC_USART1_CLK_ENABLE();
 
     HAL_NVIC_EnableIRQ(USART1_IRQn);
     HAL_NVIC_SetPriority(USART1_IRQn, USART1_IT_PRIORITY, USART1_IT_SUB);
 
 #if USART1_RX_DMA
-    usart1_rx_fifo.head_ptr = 0;
-
-    usart1_rx_fifo.recv_buf = CSP_MALLOC(usart1_rx_fifo.buf_size);
-    if (usart1_rx_fifo.recv_buf == NULL) {
-        return UART_INIT_MEM_FAIL;
-    }
-
-    usart1_rx_fifo.rx_fifo_buf = CSP_MALLOC(usart1_rx_fifo.fifo_size);
-    if (usart1_rx_fifo.rx_fifo_buf == NULL) {
-        return UART_INIT_MEM_FAIL;
-    }
-
-    usart1_rx_fifo.rx_fifo = ring_fifo_init(
-        usart1_rx_fifo.rx_fifo_buf, usart1_rx_fifo.fifo_size, RF_TYPE_STREAM);
-    if (usart1_rx_fifo.rx_fifo == NULL) {
+    if (uart_rx_fifo_alloc(&usart1_rx_fifo) != 0) {
         return UART_INIT_MEM_FAIL;
     }
 
     CSP_DMA_CLK_ENABLE(USART1_RX_DMA_NUMBER);
     if (HAL_DMA_Init(&usart1_dmarx_handle) != HAL_OK) {
+        uart_rx_fifo_free(&usart1_rx_fifo);
         return UART_INIT_DMA_FAIL;
     }
 
@@ -205,13 +295,17 @@ uint8_t usart1_init(uint32_t baud_rate) {
 #endif /* USART1_RX_DMA */
 
 #if USART1_TX_DMA
-    usart1_tx_buf.send_buf = CSP_MALLOC(usart1_tx_buf.buf_size);
-    if (usart1_tx_buf.send_buf == NULL) {
+    if (uart_tx_buf_alloc(&usart1_tx_buf) != 0) {
+#if USART1_RX_DMA
+        /* Release the rx fifo which is allocated before. */
+        uart_rx_fifo_free(&usart1_rx_fifo);
+#endif /* USART1_RX_DMA */
         return UART_INIT_MEM_FAIL;
     }
 
     CSP_DMA_CLK_ENABLE(USART1_TX_DMA_NUMBER);
     if (HAL_DMA_Init(&usart1_dmatx_handle) != HAL_OK) {
+        uart_tx_buf_free(&usart1_tx_buf);
         return UART_INIT_DMA_FAIL;
     }
 
@@ -228,6 +322,12 @@ uint8_t usart1_init(uint32_t baud_rate) {
         return UART_INIT_FAIL;
     }
 
+#if USART1_RX_ENABLE
+    if (bit_cycles != 0) {
+        uart_autobaud_apply(&usart1_handle, bit_cycles);
+    }
+#endif /* USART1_RX_ENABLE */
+
 #if USART1_RX_DMA
     __HAL_UART_ENABLE_IT(&usart1_handle, UART_IT_IDLE);
     __HAL_UART_CLEAR_IDLEFLAG(&usart1_handle);
@@ -250,6 +350,13 @@ uint8_t usart1_init(uint32_t baud_rate) {
  *
  */
 void USART1_IRQHandler(void) {
+#if USART1_SYNC_ENABLE
+    if (usart1_sync_handle.State != HAL_USART_STATE_RESET) {
+        HAL_USART_IRQHandler(&usart1_sync_handle);
+        return;
+    }
+#endif /* USART1_SYNC_ENABLE */
+
     if (__HAL_UART_GET_FLAG(&usart1_handle, UART_FLAG_IDLE)) {
         __HAL_UART_CLEAR_IDLEFLAG(&usart1_handle);
         uart_dmarx_idle_callback(&usart1_handle);
@@ -317,10 +424,11 @@ uint8_t usart1_deinit(void) {
 
 #if USART1_RX_DMA
 
-    HAL_DMA_Abort(&usart1_dmarx_handle);
-    CSP_FREE(usart1_rx_fifo.recv_buf);
-    CSP_FREE(usart1_rx_fifo.rx_fifo_buf);
-    ring_fifo_destroy(usart1_rx_fifo.rx_fifo);
+    /* `HAL_UART_DeInit()` keeps the interrupts and DMA request of the
+     * reception, they would abort the transfers of synchronous mode. */
+    __HAL_UART_DISABLE_IT(&usart1_handle, UART_IT_IDLE);
+    HAL_UART_DMAStop(&usart1_handle);
+    uart_rx_fifo_free(&usart1_rx_fifo);
 
     if (HAL_DMA_DeInit(&usart1_dmarx_handle) != HAL_OK) {
         return UART_DEINIT_DMA_FAIL;
@@ -339,7 +447,7 @@ uint8_t usart1_deinit(void) {
 
 #if USART1_TX_DMA
     HAL_DMA_Abort(&usart1_dmatx_handle);
-    CSP_FREE(usart1_tx_buf.send_buf);
+    uart_tx_buf_free(&usart1_tx_buf);
 
     if (HAL_DMA_DeInit(&usart1_dmatx_handle) != HAL_OK) {
         return UART_DEINIT_DMA_FAIL;
@@ -358,6 +466,214 @@ uint8_t usart1_deinit(void) {
     return UART_DEINIT_OK;
 }
 
+#if USART1_SYNC_ENABLE
+
+/**
+ * @brief USART1 synchronous mode initialization.
+ *
+ * @param baud_rate Baud rate, also the frequency of CK. Max: fPCLK/16.
+ * @param clk_polarity Steady state of CK: `USART_POLARITY_LOW` or
+ *                     `USART_POLARITY_HIGH`.
+ * @param clk_phase Data capture edge of CK: `USART_PHASE_1EDGE` or
+ *                  `USART_PHASE_2EDGE`.
+ * @return USART1 init status.
+ *  @retval - 0: `UART_INIT_OK`:       Success.
+ *  @retval - 1: `UART_INIT_FAIL`:     USART init failed.
+ *  @retval - 2: `UART_INIT_DMA_FAIL`: USART DMA init failed.
+ *  @retval - 3: `UART_INIT_MEM_FAIL`: USART buffer alloc failed.
+ *  @retval - 4: `UART_INITED`:        This usart is inited (Asynchronous or
+ *                                    synchronous mode).
+ * @note The DMA Rx channel is set to normal mode during synchronous mode.
+ *       The DMA buffers of asynchronous mode are allocated to stage the
+ *       transfers.
+ */
+uint8_t usart1_sync_init(uint32_t baud_rate, uint32_t clk_polarity,
+                         uint32_t clk_phase) {
+    if ((HAL_UART_GetState(&usart1_handle) != HAL_UART_STATE_RESET) ||
+        (HAL_USART_GetState(&usart1_sync_handle) != HAL_USART_STATE_RESET)) {
+        return UART_INITED;
+    }
+
+    GPIO_InitTypeDef gpio_init_struct = {.Pull = GPIO_PULLUP,
+                                         .Speed = GPIO_SPEED_FREQ_HIGH};
+    usart1_sync_handle.Init.BaudRate = baud_rate;
+    usart1_sync_handle.Init.CLKPolarity = clk_polarity;
+    usart1_sync_handle.Init.CLKPhase = clk_phase;
+    usart1_sync_handle.Init.Mode = USART_MODE_TX;
+
+    USART1_AFIO_REMAP();
+
+    CSP_GPIO_CLK_ENABLE(USART1_TX_PORT);
+    gpio_init_struct.Pin = USART1_TX_PIN;
+    gpio_init_struct.Mode = GPIO_MODE_AF_PP;
+    HAL_GPIO_Init(CSP_GPIO_PORT(USART1_TX_PORT), &gpio_init_struct);
+
+    CSP_GPIO_CLK_ENABLE(USART1_CK_PORT);
+    gpio_init_struct.Pin = USART1_CK_PIN;
+    gpio_init_struct.Mode = GPIO_MODE_AF_PP;
+    HAL_GPIO_Init(CSP_GPIO_PORT(USART1_CK_PORT), &gpio_init_struct);
+
+#if USART1_RX_ENABLE
+    usart1_sync_handle.Init.Mode = USART_MODE_TX_RX;
+
+    CSP_GPIO_CLK_ENABLE(USART1_RX_PORT);
+    gpio_init_struct.Pin = USART1_RX_PIN;
+    gpio_init_struct.Mode = GPIO_MODE_AF_INPUT;
+    HAL_GPIO_Init(CSP_GPIO_PORT(USART1_RX_PORT), &gpio_init_struct);
+#endif /* USART1_RX_ENABLE */
+
+    __HAL_RCC_USART1_CLK_ENABLE();
+
+    HAL_NVIC_EnableIRQ(USART1_IRQn);
+    HAL_NVIC_SetPriority(USART1_IRQn, USART1_IT_PRIORITY, USART1_IT_SUB);
+
+#if USART1_RX_DMA
+    if (uart_rx_fifo_alloc(&usart1_rx_fifo) != 0) {
+        return UART_INIT_MEM_FAIL;
+    }
+
+    /* One bulk transfer per request, no circular receive. */
+    usart1_dmarx_handle.Init.Mode = DMA_NORMAL;
+
+    CSP_DMA_CLK_ENABLE(USART1_RX_DMA_NUMBER);
+    if (HAL_DMA_Init(&usart1_dmarx_handle) != HAL_OK) {
+        usart1_dmarx_handle.Init.Mode = DMA_CIRCULAR;
+        uart_rx_fifo_free(&usart1_rx_fifo);
+        return UART_INIT_DMA_FAIL;
+    }
+
+    __HAL_LINKDMA(&usart1_sync_handle, hdmarx, usart1_dmarx_handle);
+
+    HAL_NVIC_SetPriority(
+        CSP_DMA_CHANNEL_IRQn(USART1_RX_DMA_NUMBER, USART1_RX_DMA_CHANNEL),
+        USART1_RX_DMA_IT_PRIORITY, USART1_RX_DMA_IT_SUB);
+    HAL_NVIC_EnableIRQ(
+        CSP_DMA_CHANNEL_IRQn(USART1_RX_DMA_NUMBER, USART1_RX_DMA_CHANNEL));
+#endif /* USART1_RX_DMA */
+
+#if USART1_TX_DMA
+    if (uart_tx_buf_alloc(&usart1_tx_buf) != 0) {
+#if USART1_RX_DMA
+        /* Restore the circular receive of asynchronous mode. */
+        uart_rx_fifo_free(&usart1_rx_fifo);
+        usart1_dmarx_handle.Init.Mode = DMA_CIRCULAR;
+        usart1_sync_handle.hdmarx = NULL;
+#endif /* USART1_RX_DMA */
+        return UART_INIT_MEM_FAIL;
+    }
+
+    CSP_DMA_CLK_ENABLE(USART1_TX_DMA_NUMBER);
+    if (HAL_DMA_Init(&usart1_dmatx_handle) != HAL_OK) {
+        uart_tx_buf_free(&usart1_tx_buf);
+#if USART1_RX_DMA
+        /* Restore the circular receive of asynchronous mode. */
+        uart_rx_fifo_free(&usart1_rx_fifo);
+        usart1_dmarx_handle.Init.Mode = DMA_CIRCULAR;
+        usart1_sync_handle.hdmarx = NULL;
+#endif /* USART1_RX_DMA */
+        return UART_INIT_DMA_FAIL;
+    }
+
+    __HAL_LINKDMA(&usart1_sync_handle, hdmatx, usart1_dmatx_handle);
+
+    HAL_NVIC_SetPriority(
+        CSP_DMA_CHANNEL_IRQn(USART1_TX_DMA_NUMBER, USART1_TX_DMA_CHANNEL),
+        USART1_TX_DMA_IT_PRIORITY, USART1_TX_DMA_IT_SUB);
+    HAL_NVIC_EnableIRQ(
+        CSP_DMA_CHANNEL_IRQn(USART1_TX_DMA_NUMBER, USART1_TX_DMA_CHANNEL));
+#endif /* USART1_TX_DMA */
+
+    if (HAL_USART_Init(&usart1_sync_handle) != HAL_OK) {
+#if USART1_TX_DMA
+        uart_tx_buf_free(&usart1_tx_buf);
+#endif /* USART1_TX_DMA */
+#if USART1_RX_DMA
+        /* Restore the circular receive of asynchronous mode. */
+        uart_rx_fifo_free(&usart1_rx_fifo);
+        usart1_dmarx_handle.Init.Mode = DMA_CIRCULAR;
+        usart1_sync_handle.hdmarx = NULL;
+#endif /* USART1_RX_DMA */
+        return UART_INIT_FAIL;
+    }
+
+#if USART1_RX_DMA && USE_HAL_USART_REGISTER_CALLBACKS
+    HAL_USART_RegisterCallback(&usart1_sync_handle,
+                               HAL_USART_TX_RX_COMPLETE_CB_ID,
+                               usart_sync_done_callback);
+#endif /* USART1_RX_DMA && USE_HAL_USART_REGISTER_CALLBACKS */
+
+    return UART_INIT_OK;
+}
+
+/**
+ * @brief USART1 synchronous mode deinitialization.
+ *
+ * @return UART deinit status.
+ *  @retval - 0: `UART_DEINIT_OK`:       Success.
+ *  @retval - 1: `UART_DEINIT_FAIL`:     USART deinit failed.
+ *  @retval - 2: `UART_DEINIT_DMA_FAIL`: USART DMA deinit failed.
+ *  @retval - 3: `UART_NO_INIT`:         USART is not init.
+ */
+uint8_t usart1_sync_deinit(void) {
+    if (HAL_USART_GetState(&usart1_sync_handle) == HAL_USART_STATE_RESET) {
+        return UART_NO_INIT;
+    }
+
+    __HAL_RCC_USART1_CLK_DISABLE();
+
+    HAL_GPIO_DeInit(CSP_GPIO_PORT(USART1_TX_PORT), USART1_TX_PIN);
+    HAL_GPIO_DeInit(CSP_GPIO_PORT(USART1_CK_PORT), USART1_CK_PIN);
+
+#if USART1_RX_ENABLE
+    HAL_GPIO_DeInit(CSP_GPIO_PORT(USART1_RX_PORT), USART1_RX_PIN);
+#endif /* USART1_RX_ENABLE */
+    HAL_NVIC_DisableIRQ(USART1_IRQn);
+
+#if USART1_RX_DMA
+    HAL_DMA_Abort(&usart1_dmarx_handle);
+    uart_rx_fifo_free(&usart1_rx_fifo);
+
+    if (HAL_DMA_DeInit(&usart1_dmarx_handle) != HAL_OK) {
+        return UART_DEINIT_DMA_FAIL;
+    }
+
+    HAL_NVIC_DisableIRQ(
+        CSP_DMA_CHANNEL_IRQn(USART1_RX_DMA_NUMBER, USART1_RX_DMA_CHANNEL));
+
+#if USE_HAL_USART_REGISTER_CALLBACKS
+    HAL_USART_UnRegisterCallback(&usart1_sync_handle,
+                                 HAL_USART_TX_RX_COMPLETE_CB_ID);
+#endif /* USE_HAL_USART_REGISTER_CALLBACKS */
+
+    /* Restore the circular receive of asynchronous mode. */
+    usart1_dmarx_handle.Init.Mode = DMA_CIRCULAR;
+    usart1_sync_handle.hdmarx = NULL;
+    usart1_sync_buf.rx_data = NULL;
+#endif /* USART1_RX_DMA */
+
+#if USART1_TX_DMA
+    HAL_DMA_Abort(&usart1_dmatx_handle);
+    uart_tx_buf_free(&usart1_tx_buf);
+
+    if (HAL_DMA_DeInit(&usart1_dmatx_handle) != HAL_OK) {
+        return UART_DEINIT_DMA_FAIL;
+    }
+
+    HAL_NVIC_DisableIRQ(
+        CSP_DMA_CHANNEL_IRQn(USART1_TX_DMA_NUMBER, USART1_TX_DMA_CHANNEL));
+
+    usart1_sync_handle.hdmatx = NULL;
+#endif /* USART1_TX_DMA */
+
+    if (HAL_USART_DeInit(&usart1_sync_handle) != HAL_OK) {
+        return UART_DEINIT_FAIL;
+    }
+
+    return UART_DEINIT_OK;
+}
+
+#endif /* USART1_SYNC_ENABLE */
+
 #endif /* USART1_ENABLE */
 
 /**
@@ -376,6 +692,15 @@ UART_HandleTypeDef usart2_handle = {.Instance = USART2,
                                              .StopBits = UART_STOPBITS_1,
                                              .Parity = UART_PARITY_NONE}};
 
+#if USART2_SYNC_ENABLE
+USART_HandleTypeDef usart2_sync_handle = {
+    .Instance = USART2,
+    .Init = {.WordLength = USART_WORDLENGTH_8B,
+             .StopBits = USART_STOPBITS_1,
+             .Parity = USART_PARITY_NONE,
+             .CLKLastBit = USART_LASTBIT_ENABLE}};
+#endif /* USART2_SYNC_ENABLE */
+
 #if USART2_RX_DMA
 
 static DMA_HandleTypeDef usart2_dmarx_handle = {
@@ -388,8 +713,18 @@ static DMA_HandleTypeDef usart2_dmarx_handle = {
              .PeriphInc = DMA_PINC_DISABLE,
              .Priority = USART2_RX_DMA_PRIORITY}};
 
+#if CSP_DMA_BUF_STATIC
+static uint8_t usart2_recv_buf[USART2_RX_DMA_BUF_SIZE] CSP_DMA_BUF_ATTR;
+static uint8_t usart2_rx_fifo_buf[USART2_RX_DMA_FIFO_SIZE] CSP_DMA_BUF_ATTR;
+
+static uart_rx_fifo_t usart2_rx_fifo = {.rx_fifo_buf = usart2_rx_fifo_buf,
+                                        .recv_buf = usart2_recv_buf,
+                                        .buf_size = USART2_RX_DMA_BUF_SIZE,
+                                        .fifo_size = USART2_RX_DMA_FIFO_SIZE};
+#else /* CSP_DMA_BUF_STATIC */
 static uart_rx_fifo_t usart2_rx_fifo = {.buf_size = USART2_RX_DMA_BUF_SIZE,
                                         .fifo_size = USART2_RX_DMA_FIFO_SIZE};
+#endif /* CSP_DMA_BUF_STATIC */
 
 #endif /* USART2_RX_DMA */
 
@@ -405,14 +740,36 @@ static DMA_HandleTypeDef usart2_dmatx_handle = {
              .PeriphInc = DMA_PINC_DISABLE,
              .Priority = USART2_TX_DMA_PRIORITY}};
 
+#if CSP_DMA_BUF_STATIC
+static uint8_t usart2_send_buf[USART2_TX_DMA_BUF_SIZE] CSP_DMA_BUF_ATTR;
+
+static uart_tx_buf_t usart2_tx_buf = {.send_buf = usart2_send_buf,
+                                      .buf_size = USART2_TX_DMA_BUF_SIZE};
+#else /* CSP_DMA_BUF_STATIC */
 static uart_tx_buf_t usart2_tx_buf = {.buf_size = USART2_TX_DMA_BUF_SIZE};
+#endif /* CSP_DMA_BUF_STATIC */
 
 #endif /* USART2_TX_DMA */
 
+#if USART2_SYNC_ENABLE
+static usart_sync_buf_t usart2_sync_buf = {
+    .rx_data = NULL,
+#if USART2_TX_DMA
+    .tx_buf = &usart2_tx_buf,
+#endif /* USART2_TX_DMA */
+#if USART2_RX_DMA
+    .rx_fifo = &usart2_rx_fifo,
+#endif /* USART2_RX_DMA */
+};
+#endif /* USART2_SYNC_ENABLE */
+
 /**
  * @brief USART2 initialization
  *
- * @param baud_rate Baud rate.
+ * @param baud_rate Baud rate. `UART_AUTO_BAUD`: Detect the baud rate by the
+ *                  sync byte 0x55 sent by host. It blocks until a 0x55
+ *                  arrives or `UART_AUTO_BAUD_TIMEOUT`, the interrupts
+ *                  are disabled only while waiting for one edge.
  * @return USART2 init status.
  *  @retval - 0: `UART_INIT_OK`:       Success.
  *  @retval - 1: `UART_INIT_FAIL`:     UART init failed.
@@ -420,12 +777,20 @@ static uart_tx_buf_t usart2_tx_buf = {.buf_size = USART2_TX_DMA_BUF_SIZE};
  *  @retval - 3: `UART_INIT_MEM_FAIL`: UART buffer memory init failed (It will
  *                                    dynamic allocate memory when using DMA).
  *  @retval - 4: `UART_INITED`:        This uart is inited.
+ *  @retval - 5: `UART_INIT_BAUD_FAIL`: Auto baud detection timeout or failed.
  */
 uint8_t usart2_init(uint32_t baud_rate) {
     if (HAL_UART_GetState(&usart2_handle) != HAL_UART_STATE_RESET) {
         return UART_INITED;
     }
 
+#if USART2_SYNC_ENABLE
+    if (HAL_USART_GetState(&usart2_sync_handle) != HAL_USART_STATE_RESET) {
+        /* This USART is running in synchronous mode. */
+        return UART_INITED;
+    }
+#endif /* USART2_SYNC_ENABLE */
+
     GPIO_InitTypeDef gpio_init_struct = {.Pull = GPIO_PULLUP,
                                          .Speed = GPIO_SPEED_FREQ_HIGH};
     usart2_handle.Init.BaudRate = baud_rate;
@@ -467,32 +832,36 @@ uint8_t usart2_init(uint32_t baud_rate) {
     HAL_GPIO_Init(CSP_GPIO_PORT(USART2_RTS_PORT), &gpio_init_struct);
 #endif /* USART2_RTS_ENABLE */
 
+#if USART2_RX_ENABLE
+    uint32_t bit_cycles = 0;
+    if (baud_rate == UART_AUTO_BAUD) {
+        bit_cycles = uart_autobaud_measure(CSP_GPIO_PORT(USART2_RX_PORT),
+                                           USART2_RX_PIN);
+        if (bit_cycles == 0) {
+            return UART_INIT_BAUD_FAIL;
+        }
+        usart2_handle.Init.BaudRate = HAL_RCC_GetHCLKFreq() / bit_cycles;
+    }
+#else  /* USART2_RX_ENABLE */
+    if (baud_rate == UART_AUTO_BAUD) {
+        /* Auto baud detection need RX. */
+        return UART_INIT_BAUD_FAIL;
+    }
+#endif /* USART2_RX_ENABLE */
+
     __HAL_RCC_USART2_CLK_ENABLE();
 
     HAL_NVIC_EnableIRQ(USART2_IRQn);
     HAL_NVIC_SetPriority(USART2_IRQn, USART2_IT_PRIORITY, USART2_IT_SUB);
 
 #if USART2_RX_DMA
-    usart2_rx_fifo.head_ptr = 0;
-
-    usart2_rx_fifo.recv_buf = CSP_MALLOC(usart2_rx_fifo.buf_size);
-    if (usart2_rx_fifo.recv_buf == NULL) {
-        return UART_INIT_MEM_FAIL;
-    }
-
-    usart2_rx_fifo.rx_fifo_buf = CSP_MALLOC(usart2_rx_fifo.fifo_size);
-    if (usart2_rx_fifo.rx_fifo_buf == NULL) {
-        return UART_INIT_MEM_FAIL;
-    }
-
-    usart2_rx_fifo.rx_fifo = ring_fifo_init(
-        usart2_rx_fifo.rx_fifo_buf, usart2_rx_fifo.fifo_size, RF_TYPE_STREAM);
-    if (usart2_rx_fifo.rx_fifo == NULL) {
+    if (uart_rx_fifo_alloc(&usart2_rx_fifo) != 0) {
         return UART_INIT_MEM_FAIL;
     }
 
     CSP_DMA_CLK_ENABLE(USART2_RX_DMA_NUMBER);
     if (HAL_DMA_Init(&usart2_dmarx_handle) != HAL_OK) {
+        uart_rx_fifo_free(&usart2_rx_fifo);
         return UART_INIT_DMA_FAIL;
     }
 
@@ -507,13 +876,17 @@ uint8_t usart2_init(uint32_t baud_rate) {
 #endif /* USART2_RX_DMA */
 
 #if USART2_TX_DMA
-    usart2_tx_buf.send_buf = CSP_MALLOC(usart2_tx_buf.buf_size);
-    if (usart2_tx_buf.send_buf == NULL) {
+    if (uart_tx_buf_alloc(&usart2_tx_buf) != 0) {
+#if USART2_RX_DMA
+        /* Release the rx fifo which is allocated before. */
+        uart_rx_fifo_free(&usart2_rx_fifo);
+#endif /* USART2_RX_DMA */
         return UART_INIT_MEM_FAIL;
     }
 
     CSP_DMA_CLK_ENABLE(USART2_TX_DMA_NUMBER);
     if (HAL_DMA_Init(&usart2_dmatx_handle) != HAL_OK) {
+        uart_tx_buf_free(&usart2_tx_buf);
         return UART_INIT_DMA_FAIL;
     }
 
@@ -530,6 +903,12 @@ uint8_t usart2_init(uint32_t baud_rate) {
         return UART_INIT_FAIL;
     }
 
+#if USART2_RX_ENABLE
+    if (bit_cycles != 0) {
+        uart_autobaud_apply(&usart2_handle, bit_cycles);
+    }
+#endif /* USART2_RX_ENABLE */
+
 #if USART2_RX_DMA
     __HAL_UART_ENABLE_IT(&usart2_handle, UART_IT_IDLE);
     __HAL_UART_CLEAR_IDLEFLAG(&usart2_handle);
@@ -552,6 +931,13 @@ uint8_t usart2_init(uint32_t baud_rate) {
  *
  */
 void USART2_IRQHandler(void) {
+#if USART2_SYNC_ENABLE
+    if (usart2_sync_handle.State != HAL_USART_STATE_RESET) {
+        HAL_USART_IRQHandler(&usart2_sync_handle);
+        return;
+    }
+#endif /* USART2_SYNC_ENABLE */
+
     if (__HAL_UART_GET_FLAG(&usart2_handle, UART_FLAG_IDLE)) {
         __HAL_UART_CLEAR_IDLEFLAG(&usart2_handle);
         uart_dmarx_idle_callback(&usart2_handle);
@@ -594,7 +980,7 @@ void USART2_TX_DMA_IRQHandler(void) {
  *  @retval - 3: `UART_NO_INIT`:         UART is not init.
  */
 uint8_t usart2_deinit(void) {
-    if (HAL_UART_GetState(&usart2_handle) == HAL_UART_STATE_READY) {
+    if (HAL_UART_GetState(&usart2_handle) == HAL_UART_STATE_RESET) {
         return UART_NO_INIT;
     }
 
@@ -619,10 +1005,11 @@ uint8_t usart2_deinit(void) {
 
 #if USART2_RX_DMA
 
-    HAL_DMA_Abort(&usart2_dmarx_handle);
-    CSP_FREE(usart2_rx_fifo.recv_buf);
-    CSP_FREE(usart2_rx_fifo.rx_fifo_buf);
-    ring_fifo_destroy(usart2_rx_fifo.rx_fifo);
+    /* `HAL_UART_DeInit()` keeps the interrupts and DMA request of the
+     * reception, they would abort the transfers of synchronous mode. */
+    __HAL_UART_DISABLE_IT(&usart2_handle, UART_IT_IDLE);
+    HAL_UART_DMAStop(&usart2_handle);
+    uart_rx_fifo_free(&usart2_rx_fifo);
 
     if (HAL_DMA_DeInit(&usart2_dmarx_handle) != HAL_OK) {
         return UART_DEINIT_DMA_FAIL;
@@ -641,7 +1028,7 @@ uint8_t usart2_deinit(void) {
 
 #if USART2_TX_DMA
     HAL_DMA_Abort(&usart2_dmatx_handle);
-    CSP_FREE(usart2_tx_buf.send_buf);
+    uart_tx_buf_free(&usart2_tx_buf);
 
     if (HAL_DMA_DeInit(&usart2_dmatx_handle) != HAL_OK) {
         return UART_DEINIT_DMA_FAIL;
@@ -660,40 +1047,267 @@ uint8_t usart2_deinit(void) {
     return UART_DEINIT_OK;
 }
 
-#endif /* USART2_ENABLE */
+#if USART2_SYNC_ENABLE
 
 /**
- * @}
- */
+ * @brief USART2 synchronous mode initialization.
+ *
+ * @param baud_rate Baud rate, also the frequency of CK. Max: fPCLK/16.
+ * @param clk_polarity Steady state of CK: `USART_POLARITY_LOW` or
+ *                     `USART_POLARITY_HIGH`.
+ * @param clk_phase Data capture edge of CK: `USART_PHASE_1EDGE` or
+ *                  `USART_PHASE_2EDGE`.
+ * @return USART2 init status.
+ *  @retval - 0: `UART_INIT_OK`:       Success.
+ *  @retval - 1: `UART_INIT_FAIL`:     USART init failed.
+ *  @retval - 2: `UART_INIT_DMA_FAIL`: USART DMA init failed.
+ *  @retval - 3: `UART_INIT_MEM_FAIL`: USART buffer alloc failed.
+ *  @retval - 4: `UART_INITED`:        This usart is inited (Asynchronous or
+ *                                    synchronous mode).
+ * @note The DMA Rx channel is set to normal mode during synchronous mode.
+ *       The DMA buffers of asynchronous mode are allocated to stage the
+ *       transfers.
+ */
+uint8_t usart2_sync_init(uint32_t baud_rate, uint32_t clk_polarity,
+                         uint32_t clk_phase) {
+    if ((HAL_UART_GetState(&usart2_handle) != HAL_UART_STATE_RESET) ||
+        (HAL_USART_GetState(&usart2_sync_handle) != HAL_USART_STATE_RESET)) {
+        return UART_INITED;
+    }
 
-/*****************************************************************************
- * @defgroup USART3 Functions
- * @{
- */
+    GPIO_InitTypeDef gpio_init_struct = {.Pull = GPIO_PULLUP,
+                                         .Speed = GPIO_SPEED_FREQ_HIGH};
+    usart2_sync_handle.Init.BaudRate = baud_rate;
+    usart2_sync_handle.Init.CLKPolarity = clk_polarity;
+    usart2_sync_handle.Init.CLKPhase = clk_phase;
+    usart2_sync_handle.Init.Mode = USART_MODE_TX;
 
-#if USART3_ENABLE
+    USART2_AFIO_REMAP();
 
-UART_HandleTypeDef usart3_handle = {.Instance = USART3,
-                                    .Init = {.WordLength = UART_WORDLENGTH_8B,
-                                             .StopBits = UART_STOPBITS_1,
-                                             .Parity = UART_PARITY_NONE}};
+    CSP_GPIO_CLK_ENABLE(USART2_TX_PORT);
+    gpio_init_struct.Pin = USART2_TX_PIN;
+    gpio_init_struct.Mode = GPIO_MODE_AF_PP;
+    HAL_GPIO_Init(CSP_GPIO_PORT(USART2_TX_PORT), &gpio_init_struct);
 
-#if USART3_RX_DMA
+    CSP_GPIO_CLK_ENABLE(USART2_CK_PORT);
+    gpio_init_struct.Pin = USART2_CK_PIN;
+    gpio_init_struct.Mode = GPIO_MODE_AF_PP;
+    HAL_GPIO_Init(CSP_GPIO_PORT(USART2_CK_PORT), &gpio_init_struct);
 
-static DMA_HandleTypeDef usart3_dmarx_handle = {
-    .Instance = CSP_DMA_CHANNEL(USART3_RX_DMA_NUMBER, USART3_RX_DMA_CHANNEL),
-    .Init = {.Direction = DMA_PERIPH_TO_MEMORY,
-             .MemDataAlignment = DMA_MDATAALIGN_BYTE,
-             .MemInc = DMA_MINC_ENABLE,
-             .Mode = DMA_CIRCULAR,
-             .PeriphDataAlignment = DMA_PDATAALIGN_BYTE,
-             .PeriphInc = DMA_PINC_DISABLE,
-             .Priority = USART3_RX_DMA_PRIORITY}};
+#if USART2_RX_ENABLE
+    usart2_sync_handle.Init.Mode = USART_MODE_TX_RX;
 
-static uart_rx_fifo_t usart3_rx_fifo = {.buf_size = USART3_RX_DMA_BUF_SIZE,
-                                        .fifo_size = USART3_RX_DMA_FIFO_SIZE};
+    CSP_GPIO_CLK_ENABLE(USART2_RX_PORT);
+    gpio_init_struct.Pin = USART2_RX_PIN;
+    gpio_init_struct.Mode = GPIO_MODE_AF_INPUT;
+    HAL_GPIO_Init(CSP_GPIO_PORT(USART2_RX_PORT), &gpio_init_struct);
+#endif /* USART2_RX_ENABLE */
 
-#endif /* USART3_RX_DMA */
+    __HAL_RCC_USART2_CLK_ENABLE();
+
+    HAL_NVIC_EnableIRQ(USART2_IRQn);
+    HAL_NVIC_SetPriority(USART2_IRQn, USART2_IT_PRIORITY, USART2_IT_SUB);
+
+#if USART2_RX_DMA
+    if (uart_rx_fifo_alloc(&usart2_rx_fifo) != 0) {
+        return UART_INIT_MEM_FAIL;
+    }
+
+    /* One bulk transfer per request, no circular receive. */
+    usart2_dmarx_handle.Init.Mode = DMA_NORMAL;
+
+    CSP_DMA_CLK_ENABLE(USART2_RX_DMA_NUMBER);
+    if (HAL_DMA_Init(&usart2_dmarx_handle) != HAL_OK) {
+        usart2_dmarx_handle.Init.Mode = DMA_CIRCULAR;
+        uart_rx_fifo_free(&usart2_rx_fifo);
+        return UART_INIT_DMA_FAIL;
+    }
+
+    __HAL_LINKDMA(&usart2_sync_handle, hdmarx, usart2_dmarx_handle);
+
+    HAL_NVIC_SetPriority(
+        CSP_DMA_CHANNEL_IRQn(USART2_RX_DMA_NUMBER, USART2_RX_DMA_CHANNEL),
+        USART2_RX_DMA_IT_PRIORITY, USART2_RX_DMA_IT_SUB);
+    HAL_NVIC_EnableIRQ(
+        CSP_DMA_CHANNEL_IRQn(USART2_RX_DMA_NUMBER, USART2_RX_DMA_CHANNEL));
+#endif /* USART2_RX_DMA */
+
+#if USART2_TX_DMA
+    if (uart_tx_buf_alloc(&usart2_tx_buf) != 0) {
+#if USART2_RX_DMA
+        /* Restore the circular receive of asynchronous mode. */
+        uart_rx_fifo_free(&usart2_rx_fifo);
+        usart2_dmarx_handle.Init.Mode = DMA_CIRCULAR;
+        usart2_sync_handle.hdmarx = NULL;
+#endif /* USART2_RX_DMA */
+        return UART_INIT_MEM_FAIL;
+    }
+
+    CSP_DMA_CLK_ENABLE(USART2_TX_DMA_NUMBER);
+    if (HAL_DMA_Init(&usart2_dmatx_handle) != HAL_OK) {
+        uart_tx_buf_free(&usart2_tx_buf);
+#if USART2_RX_DMA
+        /* Restore the circular receive of asynchronous mode. */
+        uart_rx_fifo_free(&usart2_rx_fifo);
+        usart2_dmarx_handle.Init.Mode = DMA_CIRCULAR;
+        usart2_sync_handle.hdmarx = NULL;
+#endif /* USART2_RX_DMA */
+        return UART_INIT_DMA_FAIL;
+    }
+
+    __HAL_LINKDMA(&usart2_sync_handle, hdmatx, usart2_dmatx_handle);
+
+    HAL_NVIC_SetPriority(
+        CSP_DMA_CHANNEL_IRQn(USART2_TX_DMA_NUMBER, USART2_TX_DMA_CHANNEL),
+        USART2_TX_DMA_IT_PRIORITY, USART2_TX_DMA_IT_SUB);
+    HAL_NVIC_EnableIRQ(
+        CSP_DMA_CHANNEL_IRQn(USART2_TX_DMA_NUMBER, USART2_TX_DMA_CHANNEL));
+#endif /* USART2_TX_DMA */
+
+    if (HAL_USART_Init(&usart2_sync_handle) != HAL_OK) {
+#if USART2_TX_DMA
+        uart_tx_buf_free(&usart2_tx_buf);
+#endif /* USART2_TX_DMA */
+#if USART2_RX_DMA
+        /* Restore the circular receive of asynchronous mode. */
+        uart_rx_fifo_free(&usart2_rx_fifo);
+        usart2_dmarx_handle.Init.Mode = DMA_CIRCULAR;
+        usart2_sync_handle.hdmarx = NULL;
+#endif /* USART2_RX_DMA */
+        return UART_INIT_FAIL;
+    }
+
+#if USART2_RX_DMA && USE_HAL_USART_REGISTER_CALLBACKS
+    HAL_USART_RegisterCallback(&usart2_sync_handle,
+                               HAL_USART_TX_RX_COMPLETE_CB_ID,
+                               usart_sync_done_callback);
+#endif /* USART2_RX_DMA && USE_HAL_USART_REGISTER_CALLBACKS */
+
+    return UART_INIT_OK;
+}
+
+/**
+ * @brief USART2 synchronous mode deinitialization.
+ *
+ * @return UART deinit status.
+ *  @retval - 0: `UART_DEINIT_OK`:       Success.
+ *  @retval - 1: `UART_DEINIT_FAIL`:     USART deinit failed.
+ *  @retval - 2: `UART_DEINIT_DMA_FAIL`: USART DMA deinit failed.
+ *  @retval - 3: `UART_NO_INIT`:         USART is not init.
+ */
+uint8_t usart2_sync_deinit(void) {
+    if (HAL_USART_GetState(&usart2_sync_handle) == HAL_USART_STATE_RESET) {
+        return UART_NO_INIT;
+    }
+
+    __HAL_RCC_USART2_CLK_DISABLE();
+
+    HAL_GPIO_DeInit(CSP_GPIO_PORT(USART2_TX_PORT), USART2_TX_PIN);
+    HAL_GPIO_DeInit(CSP_GPIO_PORT(USART2_CK_PORT), USART2_CK_PIN);
+
+#if USART2_RX_ENABLE
+    HAL_GPIO_DeInit(CSP_GPIO_PORT(USART2_RX_PORT), USART2_RX_PIN);
+#endif /* USART2_RX_ENABLE */
+    HAL_NVIC_DisableIRQ(USART2_IRQn);
+
+#if USART2_RX_DMA
+    HAL_DMA_Abort(&usart2_dmarx_handle);
+    uart_rx_fifo_free(&usart2_rx_fifo);
+
+    if (HAL_DMA_DeInit(&usart2_dmarx_handle) != HAL_OK) {
+        return UART_DEINIT_DMA_FAIL;
+    }
+
+    HAL_NVIC_DisableIRQ(
+        CSP_DMA_CHANNEL_IRQn(USART2_RX_DMA_NUMBER, USART2_RX_DMA_CHANNEL));
+
+#if USE_HAL_USART_REGISTER_CALLBACKS
+    HAL_USART_UnRegisterCallback(&usart2_sync_handle,
+                                 HAL_USART_TX_RX_COMPLETE_CB_ID);
+#endif /* USE_HAL_USART_REGISTER_CALLBACKS */
+
+    /* Restore the circular receive of asynchronous mode. */
+    usart2_dmarx_handle.Init.Mode = DMA_CIRCULAR;
+    usart2_sync_handle.hdmarx = NULL;
+    usart2_sync_buf.rx_data = NULL;
+#endif /* USART2_RX_DMA */
+
+#if USART2_TX_DMA
+    HAL_DMA_Abort(&usart2_dmatx_handle);
+    uart_tx_buf_free(&usart2_tx_buf);
+
+    if (HAL_DMA_DeInit(&usart2_dmatx_handle) != HAL_OK) {
+        return UART_DEINIT_DMA_FAIL;
+    }
+
+    HAL_NVIC_DisableIRQ(
+        CSP_DMA_CHANNEL_IRQn(USART2_TX_DMA_NUMBER, USART2_TX_DMA_CHANNEL));
+
+    usart2_sync_handle.hdmatx = NULL;
+#endif /* USART2_TX_DMA */
+
+    if (HAL_USART_DeInit(&usart2_sync_handle) != HAL_OK) {
+        return UART_DEINIT_FAIL;
+    }
+
+    return UART_DEINIT_OK;
+}
+
+#endif /* USART2_SYNC_ENABLE */
+
+#endif /* USART2_ENABLE */
+
+/**
+ * @}
+ */
+
+/*****************************************************************************
+ * @defgroup USART3 Functions
+ * @{
+ */
+
+#if USART3_ENABLE
+
+UART_HandleTypeDef usart3_handle = {.Instance = USART3,
+                                    .Init = {.WordLength = UART_WORDLENGTH_8B,
+                                             .StopBits = UART_STOPBITS_1,
+                                             .Parity = UART_PARITY_NONE}};
+
+#if USART3_SYNC_ENABLE
+USART_HandleTypeDef usart3_sync_handle = {
+    .Instance = USART3,
+    .Init = {.WordLength = USART_WORDLENGTH_8B,
+             .StopBits = USART_STOPBITS_1,
+             .Parity = USART_PARITY_NONE,
+             .CLKLastBit = USART_LASTBIT_ENABLE}};
+#endif /* USART3_SYNC_ENABLE */
+
+#if USART3_RX_DMA
+
+static DMA_HandleTypeDef usart3_dmarx_handle = {
+    .Instance = CSP_DMA_CHANNEL(USART3_RX_DMA_NUMBER, USART3_RX_DMA_CHANNEL),
+    .Init = {.Direction = DMA_PERIPH_TO_MEMORY,
+             .MemDataAlignment = DMA_MDATAALIGN_BYTE,
+             .MemInc = DMA_MINC_ENABLE,
+             .Mode = DMA_CIRCULAR,
+             .PeriphDataAlignment = DMA_PDATAALIGN_BYTE,
+             .PeriphInc = DMA_PINC_DISABLE,
+             .Priority = USART3_RX_DMA_PRIORITY}};
+
+#if CSP_DMA_BUF_STATIC
+static uint8_t usart3_recv_buf[USART3_RX_DMA_BUF_SIZE] CSP_DMA_BUF_ATTR;
+static uint8_t usart3_rx_fifo_buf[USART3_RX_DMA_FIFO_SIZE] CSP_DMA_BUF_ATTR;
+
+static uart_rx_fifo_t usart3_rx_fifo = {.rx_fifo_buf = usart3_rx_fifo_buf,
+                                        .recv_buf = usart3_recv_buf,
+                                        .buf_size = USART3_RX_DMA_BUF_SIZE,
+                                        .fifo_size = USART3_RX_DMA_FIFO_SIZE};
+#else /* CSP_DMA_BUF_STATIC */
+static uart_rx_fifo_t usart3_rx_fifo = {.buf_size = USART3_RX_DMA_BUF_SIZE,
+                                        .fifo_size = USART3_RX_DMA_FIFO_SIZE};
+#endif /* CSP_DMA_BUF_STATIC */
+
+#endif /* USART3_RX_DMA */
 
 #if USART3_TX_DMA
 
@@ -707,14 +1321,36 @@ static DMA_HandleTypeDef usart3_dmatx_handle = {
              .PeriphInc = DMA_PINC_DISABLE,
              .Priority = USART3_TX_DMA_PRIORITY}};
 
+#if CSP_DMA_BUF_STATIC
+static uint8_t usart3_send_buf[USART3_TX_DMA_BUF_SIZE] CSP_DMA_BUF_ATTR;
+
+static uart_tx_buf_t usart3_tx_buf = {.send_buf = usart3_send_buf,
+                                      .buf_size = USART3_TX_DMA_BUF_SIZE};
+#else /* CSP_DMA_BUF_STATIC */
 static uart_tx_buf_t usart3_tx_buf = {.buf_size = USART3_TX_DMA_BUF_SIZE};
+#endif /* CSP_DMA_BUF_STATIC */
 
 #endif /* USART3_TX_DMA */
 
+#if USART3_SYNC_ENABLE
+static usart_sync_buf_t usart3_sync_buf = {
+    .rx_data = NULL,
+#if USART3_TX_DMA
+    .tx_buf = &usart3_tx_buf,
+#endif /* USART3_TX_DMA */
+#if USART3_RX_DMA
+    .rx_fifo = &usart3_rx_fifo,
+#endif /* USART3_RX_DMA */
+};
+#endif /* USART3_SYNC_ENABLE */
+
 /**
  * @brief USART3 initialization
  *
- * @param baud_rate Baud rate.
+ * @param baud_rate Baud rate. `UART_AUTO_BAUD`: Detect the baud rate by the
+ *                  sync byte 0x55 sent by host. It blocks until a 0x55
+ *                  arrives or `UART_AUTO_BAUD_TIMEOUT`, the interrupts
+ *                  are disabled only while waiting for one edge.
  * @return USART3 init status.
  *  @retval - 0: `UART_INIT_OK`:       Success.
  *  @retval - 1: `UART_INIT_FAIL`:     UART init failed.
@@ -722,12 +1358,20 @@ static uart_tx_buf_t usart3_tx_buf = {.buf_size = USART3_TX_DMA_BUF_SIZE};
  *  @retval - 3: `UART_INIT_MEM_FAIL`: UART buffer memory init failed (It will
  *                                    dynamic allocate memory when using DMA).
  *  @retval - 4: `UART_INITED`:        This uart is inited.
+ *  @retval - 5: `UART_INIT_BAUD_FAIL`: Auto baud detection timeout or failed.
  */
 uint8_t usart3_init(uint32_t baud_rate) {
     if (HAL_UART_GetState(&usart3_handle) != HAL_UART_STATE_RESET) {
         return UART_INITED;
     }
 
+#if USART3_SYNC_ENABLE
+    if (HAL_USART_GetState(&usart3_sync_handle) != HAL_USART_STATE_RESET) {
+        /* This USART is running in synchronous mode. */
+        return UART_INITED;
+    }
+#endif /* USART3_SYNC_ENABLE */
+
     GPIO_InitTypeDef gpio_init_struct = {
         .Pull = GPIO_PULLUP,
         .Speed = GPIO_SPEED_FREQ_HIGH,
@@ -771,32 +1415,36 @@ uint8_t usart3_init(uint32_t baud_rate) {
     HAL_GPIO_Init(CSP_GPIO_PORT(USART3_RTS_PORT), &gpio_init_struct);
 #endif /* USART3_RTS_ENABLE */
 
+#if USART3_RX_ENABLE
+    uint32_t bit_cycles = 0;
+    if (baud_rate == UART_AUTO_BAUD) {
+        bit_cycles = uart_autobaud_measure(CSP_GPIO_PORT(USART3_RX_PORT),
+                                           USART3_RX_PIN);
+        if (bit_cycles == 0) {
+            return UART_INIT_BAUD_FAIL;
+        }
+        usart3_handle.Init.BaudRate = HAL_RCC_GetHCLKFreq() / bit_cycles;
+    }
+#else  /* USART3_RX_ENABLE */
+    if (baud_rate == UART_AUTO_BAUD) {
+        /* Auto baud detection need RX. */
+        return UART_INIT_BAUD_FAIL;
+    }
+#endif /* USART3_RX_ENABLE */
+
     __HAL_RCC_USART3_CLK_ENABLE();
 
     HAL_NVIC_EnableIRQ(USART3_IRQn);
     HAL_NVIC_SetPriority(USART3_IRQn, USART3_IT_PRIORITY, USART3_IT_SUB);
 
 #if USART3_RX_DMA
-    usart3_rx_fifo.head_ptr = 0;
-
-    usart3_rx_fifo.recv_buf = CSP_MALLOC(usart3_rx_fifo.buf_size);
-    if (usart3_rx_fifo.recv_buf == NULL) {
-        return UART_INIT_MEM_FAIL;
-    }
-
-    usart3_rx_fifo.rx_fifo_buf = CSP_MALLOC(usart3_rx_fifo.fifo_size);
-    if (usart3_rx_fifo.rx_fifo_buf == NULL) {
-        return UART_INIT_MEM_FAIL;
-    }
-
-    usart3_rx_fifo.rx_fifo = ring_fifo_init(
-        usart3_rx_fifo.rx_fifo_buf, usart3_rx_fifo.fifo_size, RF_TYPE_STREAM);
-    if (usart3_rx_fifo.rx_fifo == NULL) {
+    if (uart_rx_fifo_alloc(&usart3_rx_fifo) != 0) {
         return UART_INIT_MEM_FAIL;
     }
 
     CSP_DMA_CLK_ENABLE(USART3_RX_DMA_NUMBER);
     if (HAL_DMA_Init(&usart3_dmarx_handle) != HAL_OK) {
+        uart_rx_fifo_free(&usart3_rx_fifo);
         return UART_INIT_DMA_FAIL;
     }
 
@@ -810,13 +1458,17 @@ uint8_t usart3_init(uint32_t baud_rate) {
 #endif /* USART3_RX_DMA */
 
 #if USART3_TX_DMA
-    usart3_tx_buf.send_buf = CSP_MALLOC(usart3_tx_buf.buf_size);
-    if (usart3_tx_buf.send_buf == NULL) {
+    if (uart_tx_buf_alloc(&usart3_tx_buf) != 0) {
+#if USART3_RX_DMA
+        /* Release the rx fifo which is allocated before. */
+        uart_rx_fifo_free(&usart3_rx_fifo);
+#endif /* USART3_RX_DMA */
         return UART_INIT_MEM_FAIL;
     }
 
     CSP_DMA_CLK_ENABLE(USART3_TX_DMA_NUMBER);
     if (HAL_DMA_Init(&usart3_dmatx_handle) != HAL_OK) {
+        uart_tx_buf_free(&usart3_tx_buf);
         return UART_INIT_DMA_FAIL;
     }
 
@@ -833,6 +1485,12 @@ uint8_t usart3_init(uint32_t baud_rate) {
         return UART_INIT_FAIL;
     }
 
+#if USART3_RX_ENABLE
+    if (bit_cycles != 0) {
+        uart_autobaud_apply(&usart3_handle, bit_cycles);
+    }
+#endif /* USART3_RX_ENABLE */
+
 #if USART3_RX_DMA
     __HAL_UART_ENABLE_IT(&usart3_handle, UART_IT_IDLE);
     __HAL_UART_CLEAR_IDLEFLAG(&usart3_handle);
@@ -855,6 +1513,13 @@ uint8_t usart3_init(uint32_t baud_rate) {
  *
  */
 void USART3_IRQHandler(void) {
+#if USART3_SYNC_ENABLE
+    if (usart3_sync_handle.State != HAL_USART_STATE_RESET) {
+        HAL_USART_IRQHandler(&usart3_sync_handle);
+        return;
+    }
+#endif /* USART3_SYNC_ENABLE */
+
     if (__HAL_UART_GET_FLAG(&usart3_handle, UART_FLAG_IDLE)) {
         __HAL_UART_CLEAR_IDLEFLAG(&usart3_handle);
         uart_dmarx_idle_callback(&usart3_handle);
@@ -875,57 +1540,261 @@ void USART3_RX_DMA_IRQHandler(void) {
 
 #endif /* USART3_RX_DMA */
 
-#if USART3_TX_DMA
+#if USART3_TX_DMA
+
+/**
+ * @brief USART3 Rx DMA ISR
+ *
+ */
+void USART3_TX_DMA_IRQHandler(void) {
+    HAL_DMA_IRQHandler(&usart3_dmatx_handle);
+}
+
+#endif /* USART3_TX_DMA */
+
+/**
+ * @brief USART3 deinitialization.
+ *
+ * @return UART deinit status.
+ *  @retval - 0: `UART_DEINIT_OK`:       Success.
+ *  @retval - 1: `UART_DEINIT_FAIL`:     UART deinit failed.
+ *  @retval - 2: `UART_DEINIT_DMA_FAIL`: UART DMA deinit failed.
+ *  @retval - 3: `UART_NO_INIT`:         UART is not init.
+ */
+uint8_t usart3_deinit(void) {
+    if (HAL_UART_GetState(&usart3_handle) == HAL_UART_STATE_RESET) {
+        return UART_NO_INIT;
+    }
+
+    __HAL_RCC_USART3_CLK_DISABLE();
+
+#if USART3_TX_ENABLE
+    HAL_GPIO_DeInit(CSP_GPIO_PORT(USART3_TX_PORT), USART3_TX_PIN);
+#endif /* USART3_TX_ENABLE */
+
+#if USART3_RX_ENABLE
+    HAL_GPIO_DeInit(CSP_GPIO_PORT(USART3_RX_PORT), USART3_RX_PIN);
+#endif /* USART3_RX_ENABLE */
+
+#if USART3_CTS_ENABLE
+    HAL_GPIO_DeInit(CSP_GPIO_PORT(USART3_CTS_PORT), USART3_CTS_PIN);
+#endif /* USART3_USART3_CTS */
+
+#if USART3_RTS_ENABLE
+    HAL_GPIO_DeInit(CSP_GPIO_PORT(USART3_RTS_PORT), USART3_RTS_PIN);
+#endif /* USART3_RTS_ENABLE */
+    HAL_NVIC_DisableIRQ(USART3_IRQn);
+
+#if USART3_RX_DMA
+
+    /* `HAL_UART_DeInit()` keeps the interrupts and DMA request of the
+     * reception, they would abort the transfers of synchronous mode. */
+    __HAL_UART_DISABLE_IT(&usart3_handle, UART_IT_IDLE);
+    HAL_UART_DMAStop(&usart3_handle);
+    uart_rx_fifo_free(&usart3_rx_fifo);
+
+    if (HAL_DMA_DeInit(&usart3_dmarx_handle) != HAL_OK) {
+        return UART_DEINIT_DMA_FAIL;
+    }
+
+    HAL_NVIC_DisableIRQ(
+        CSP_DMA_CHANNEL_IRQn(USART3_RX_DMA_NUMBER, USART3_RX_DMA_CHANNEL));
+
+#if USE_HAL_UART_REGISTER_CALLBACKS
+    HAL_UART_UnRegisterCallback(&usart3_handle, HAL_UART_RX_HALFCOMPLETE_CB_ID);
+    HAL_UART_UnRegisterCallback(&usart3_handle, HAL_UART_RX_COMPLETE_CB_ID);
+#endif /* USE_HAL_UART_REGISTER_CALLBACKS */
+    usart3_handle.hdmarx = NULL;
+
+#endif /* USART3_RX_DMA */
+
+#if USART3_TX_DMA
+    HAL_DMA_Abort(&usart3_dmatx_handle);
+    uart_tx_buf_free(&usart3_tx_buf);
+
+    if (HAL_DMA_DeInit(&usart3_dmatx_handle) != HAL_OK) {
+        return UART_DEINIT_DMA_FAIL;
+    }
+
+    HAL_NVIC_DisableIRQ(
+        CSP_DMA_CHANNEL_IRQn(USART3_TX_DMA_NUMBER, USART3_TX_DMA_CHANNEL));
+
+    usart3_handle.hdmatx = NULL;
+#endif /* USART3_TX_DMA */
+
+    if (HAL_UART_DeInit(&usart3_handle) != HAL_OK) {
+        return UART_DEINIT_FAIL;
+    }
+
+    return UART_DEINIT_OK;
+}
+
+#if USART3_SYNC_ENABLE
+
+/**
+ * @brief USART3 synchronous mode initialization.
+ *
+ * @param baud_rate Baud rate, also the frequency of CK. Max: fPCLK/16.
+ * @param clk_polarity Steady state of CK: `USART_POLARITY_LOW` or
+ *                     `USART_POLARITY_HIGH`.
+ * @param clk_phase Data capture edge of CK: `USART_PHASE_1EDGE` or
+ *                  `USART_PHASE_2EDGE`.
+ * @return USART3 init status.
+ *  @retval - 0: `UART_INIT_OK`:       Success.
+ *  @retval - 1: `UART_INIT_FAIL`:     USART init failed.
+ *  @retval - 2: `UART_INIT_DMA_FAIL`: USART DMA init failed.
+ *  @retval - 3: `UART_INIT_MEM_FAIL`: USART buffer alloc failed.
+ *  @retval - 4: `UART_INITED`:        This usart is inited (Asynchronous or
+ *                                    synchronous mode).
+ * @note The DMA Rx channel is set to normal mode during synchronous mode.
+ *       The DMA buffers of asynchronous mode are allocated to stage the
+ *       transfers.
+ */
+uint8_t usart3_sync_init(uint32_t baud_rate, uint32_t clk_polarity,
+                         uint32_t clk_phase) {
+    if ((HAL_UART_GetState(&usart3_handle) != HAL_UART_STATE_RESET) ||
+        (HAL_USART_GetState(&usart3_sync_handle) != HAL_USART_STATE_RESET)) {
+        return UART_INITED;
+    }
+
+    GPIO_InitTypeDef gpio_init_struct = {.Pull = GPIO_PULLUP,
+                                         .Speed = GPIO_SPEED_FREQ_HIGH};
+    usart3_sync_handle.Init.BaudRate = baud_rate;
+    usart3_sync_handle.Init.CLKPolarity = clk_polarity;
+    usart3_sync_handle.Init.CLKPhase = clk_phase;
+    usart3_sync_handle.Init.Mode = USART_MODE_TX;
+
+    USART3_AFIO_REMAP();
+
+    CSP_GPIO_CLK_ENABLE(USART3_TX_PORT);
+    gpio_init_struct.Pin = USART3_TX_PIN;
+    gpio_init_struct.Mode = GPIO_MODE_AF_PP;
+    HAL_GPIO_Init(CSP_GPIO_PORT(USART3_TX_PORT), &gpio_init_struct);
+
+    CSP_GPIO_CLK_ENABLE(USART3_CK_PORT);
+    gpio_init_struct.Pin = USART3_CK_PIN;
+    gpio_init_struct.Mode = GPIO_MODE_AF_PP;
+    HAL_GPIO_Init(CSP_GPIO_PORT(USART3_CK_PORT), &gpio_init_struct);
+
+#if USART3_RX_ENABLE
+    usart3_sync_handle.Init.Mode = USART_MODE_TX_RX;
+
+    CSP_GPIO_CLK_ENABLE(USART3_RX_PORT);
+    gpio_init_struct.Pin = USART3_RX_PIN;
+    gpio_init_struct.Mode = GPIO_MODE_AF_INPUT;
+    HAL_GPIO_Init(CSP_GPIO_PORT(USART3_RX_PORT), &gpio_init_struct);
+#endif /* USART3_RX_ENABLE */
+
+    __HAL_RCC_USART3_CLK_ENABLE();
+
+    HAL_NVIC_EnableIRQ(USART3_IRQn);
+    HAL_NVIC_SetPriority(USART3_IRQn, USART3_IT_PRIORITY, USART3_IT_SUB);
+
+#if USART3_RX_DMA
+    if (uart_rx_fifo_alloc(&usart3_rx_fifo) != 0) {
+        return UART_INIT_MEM_FAIL;
+    }
+
+    /* One bulk transfer per request, no circular receive. */
+    usart3_dmarx_handle.Init.Mode = DMA_NORMAL;
+
+    CSP_DMA_CLK_ENABLE(USART3_RX_DMA_NUMBER);
+    if (HAL_DMA_Init(&usart3_dmarx_handle) != HAL_OK) {
+        usart3_dmarx_handle.Init.Mode = DMA_CIRCULAR;
+        uart_rx_fifo_free(&usart3_rx_fifo);
+        return UART_INIT_DMA_FAIL;
+    }
+
+    __HAL_LINKDMA(&usart3_sync_handle, hdmarx, usart3_dmarx_handle);
+
+    HAL_NVIC_SetPriority(
+        CSP_DMA_CHANNEL_IRQn(USART3_RX_DMA_NUMBER, USART3_RX_DMA_CHANNEL),
+        USART3_RX_DMA_IT_PRIORITY, USART3_RX_DMA_IT_SUB);
+    HAL_NVIC_EnableIRQ(
+        CSP_DMA_CHANNEL_IRQn(USART3_RX_DMA_NUMBER, USART3_RX_DMA_CHANNEL));
+#endif /* USART3_RX_DMA */
+
+#if USART3_TX_DMA
+    if (uart_tx_buf_alloc(&usart3_tx_buf) != 0) {
+#if USART3_RX_DMA
+        /* Restore the circular receive of asynchronous mode. */
+        uart_rx_fifo_free(&usart3_rx_fifo);
+        usart3_dmarx_handle.Init.Mode = DMA_CIRCULAR;
+        usart3_sync_handle.hdmarx = NULL;
+#endif /* USART3_RX_DMA */
+        return UART_INIT_MEM_FAIL;
+    }
+
+    CSP_DMA_CLK_ENABLE(USART3_TX_DMA_NUMBER);
+    if (HAL_DMA_Init(&usart3_dmatx_handle) != HAL_OK) {
+        uart_tx_buf_free(&usart3_tx_buf);
+#if USART3_RX_DMA
+        /* Restore the circular receive of asynchronous mode. */
+        uart_rx_fifo_free(&usart3_rx_fifo);
+        usart3_dmarx_handle.Init.Mode = DMA_CIRCULAR;
+        usart3_sync_handle.hdmarx = NULL;
+#endif /* USART3_RX_DMA */
+        return UART_INIT_DMA_FAIL;
+    }
+
+    __HAL_LINKDMA(&usart3_sync_handle, hdmatx, usart3_dmatx_handle);
+
+    HAL_NVIC_SetPriority(
+        CSP_DMA_CHANNEL_IRQn(USART3_TX_DMA_NUMBER, USART3_TX_DMA_CHANNEL),
+        USART3_TX_DMA_IT_PRIORITY, USART3_TX_DMA_IT_SUB);
+    HAL_NVIC_EnableIRQ(
+        CSP_DMA_CHANNEL_IRQn(USART3_TX_DMA_NUMBER, USART3_TX_DMA_CHANNEL));
+#endif /* USART3_TX_DMA */
+
+    if (HAL_USART_Init(&usart3_sync_handle) != HAL_OK) {
+#if USART3_TX_DMA
+        uart_tx_buf_free(&usart3_tx_buf);
+#endif /* USART3_TX_DMA */
+#if USART3_RX_DMA
+        /* Restore the circular receive of asynchronous mode. */
+        uart_rx_fifo_free(&usart3_rx_fifo);
+        usart3_dmarx_handle.Init.Mode = DMA_CIRCULAR;
+        usart3_sync_handle.hdmarx = NULL;
+#endif /* USART3_RX_DMA */
+        return UART_INIT_FAIL;
+    }
+
+#if USART3_RX_DMA && USE_HAL_USART_REGISTER_CALLBACKS
+    HAL_USART_RegisterCallback(&usart3_sync_handle,
+                               HAL_USART_TX_RX_COMPLETE_CB_ID,
+                               usart_sync_done_callback);
+#endif /* USART3_RX_DMA && USE_HAL_USART_REGISTER_CALLBACKS */
 
-/**
- * @brief USART3 Rx DMA ISR
- *
- */
-void USART3_TX_DMA_IRQHandler(void) {
-    HAL_DMA_IRQHandler(&usart3_dmatx_handle);
+    return UART_INIT_OK;
 }
 
-#endif /* USART3_TX_DMA */
-
 /**
- * @brief USART3 deinitialization.
+ * @brief USART3 synchronous mode deinitialization.
  *
  * @return UART deinit status.
  *  @retval - 0: `UART_DEINIT_OK`:       Success.
- *  @retval - 1: `UART_DEINIT_FAIL`:     UART deinit failed.
- *  @retval - 2: `UART_DEINIT_DMA_FAIL`: UART DMA deinit failed.
- *  @retval - 3: `UART_NO_INIT`:         UART is not init.
+ *  @retval - 1: `UART_DEINIT_FAIL`:     USART deinit failed.
+ *  @retval - 2: `UART_DEINIT_DMA_FAIL`: USART DMA deinit failed.
+ *  @retval - 3: `UART_NO_INIT`:         USART is not init.
  */
-uint8_t usart3_deinit(void) {
-    if (HAL_UART_GetState(&usart3_handle) == HAL_UART_STATE_READY) {
+uint8_t usart3_sync_deinit(void) {
+    if (HAL_USART_GetState(&usart3_sync_handle) == HAL_USART_STATE_RESET) {
         return UART_NO_INIT;
     }
 
     __HAL_RCC_USART3_CLK_DISABLE();
 
-#if USART3_TX_ENABLE
     HAL_GPIO_DeInit(CSP_GPIO_PORT(USART3_TX_PORT), USART3_TX_PIN);
-#endif /* USART3_TX_ENABLE */
+    HAL_GPIO_DeInit(CSP_GPIO_PORT(USART3_CK_PORT), USART3_CK_PIN);
 
 #if USART3_RX_ENABLE
     HAL_GPIO_DeInit(CSP_GPIO_PORT(USART3_RX_PORT), USART3_RX_PIN);
 #endif /* USART3_RX_ENABLE */
-
-#if USART3_CTS_ENABLE
-    HAL_GPIO_DeInit(CSP_GPIO_PORT(USART3_CTS_PORT), USART3_CTS_PIN);
-#endif /* USART3_USART3_CTS */
-
-#if USART3_RTS_ENABLE
-    HAL_GPIO_DeInit(CSP_GPIO_PORT(USART3_RTS_PORT), USART3_RTS_PIN);
-#endif /* USART3_RTS_ENABLE */
     HAL_NVIC_DisableIRQ(USART3_IRQn);
 
 #if USART3_RX_DMA
-
     HAL_DMA_Abort(&usart3_dmarx_handle);
-    CSP_FREE(usart3_rx_fifo.recv_buf);
-    CSP_FREE(usart3_rx_fifo.rx_fifo_buf);
-    ring_fifo_destroy(usart3_rx_fifo.rx_fifo);
+    uart_rx_fifo_free(&usart3_rx_fifo);
 
     if (HAL_DMA_DeInit(&usart3_dmarx_handle) != HAL_OK) {
         return UART_DEINIT_DMA_FAIL;
@@ -934,17 +1803,20 @@ uint8_t usart3_deinit(void) {
     HAL_NVIC_DisableIRQ(
         CSP_DMA_CHANNEL_IRQn(USART3_RX_DMA_NUMBER, USART3_RX_DMA_CHANNEL));
 
-#if USE_HAL_UART_REGISTER_CALLBACKS
-    HAL_UART_UnRegisterCallback(&usart3_handle, HAL_UART_RX_HALFCOMPLETE_CB_ID);
-    HAL_UART_UnRegisterCallback(&usart3_handle, HAL_UART_RX_COMPLETE_CB_ID);
-#endif /* USE_HAL_UART_REGISTER_CALLBACKS */
-    usart3_handle.hdmarx = NULL;
+#if USE_HAL_USART_REGISTER_CALLBACKS
+    HAL_USART_UnRegisterCallback(&usart3_sync_handle,
+                                 HAL_USART_TX_RX_COMPLETE_CB_ID);
+#endif /* USE_HAL_USART_REGISTER_CALLBACKS */
 
+    /* Restore the circular receive of asynchronous mode. */
+    usart3_dmarx_handle.Init.Mode = DMA_CIRCULAR;
+    usart3_sync_handle.hdmarx = NULL;
+    usart3_sync_buf.rx_data = NULL;
 #endif /* USART3_RX_DMA */
 
 #if USART3_TX_DMA
     HAL_DMA_Abort(&usart3_dmatx_handle);
-    CSP_FREE(usart3_tx_buf.send_buf);
+    uart_tx_buf_free(&usart3_tx_buf);
 
     if (HAL_DMA_DeInit(&usart3_dmatx_handle) != HAL_OK) {
         return UART_DEINIT_DMA_FAIL;
@@ -953,16 +1825,18 @@ uint8_t usart3_deinit(void) {
     HAL_NVIC_DisableIRQ(
         CSP_DMA_CHANNEL_IRQn(USART3_TX_DMA_NUMBER, USART3_TX_DMA_CHANNEL));
 
-    usart3_handle.hdmatx = NULL;
+    usart3_sync_handle.hdmatx = NULL;
 #endif /* USART3_TX_DMA */
 
-    if (HAL_UART_DeInit(&usart3_handle) != HAL_OK) {
+    if (HAL_USART_DeInit(&usart3_sync_handle) != HAL_OK) {
         return UART_DEINIT_FAIL;
     }
 
     return UART_DEINIT_OK;
 }
 
+#endif /* USART3_SYNC_ENABLE */
+
 #endif /* USART3_ENABLE */
 
 /**
@@ -993,8 +1867,18 @@ static DMA_HandleTypeDef uart4_dmarx_handle = {
              .PeriphInc = DMA_PINC_DISABLE,
              .Priority = UART4_RX_DMA_PRIORITY}};
 
+#if CSP_DMA_BUF_STATIC
+static uint8_t uart4_recv_buf[UART4_RX_DMA_BUF_SIZE] CSP_DMA_BUF_ATTR;
+static uint8_t uart4_rx_fifo_buf[UART4_RX_DMA_FIFO_SIZE] CSP_DMA_BUF_ATTR;
+
+static uart_rx_fifo_t uart4_rx_fifo = {.rx_fifo_buf = uart4_rx_fifo_buf,
+                                       .recv_buf = uart4_recv_buf,
+                                       .buf_size = UART4_RX_DMA_BUF_SIZE,
+                                       .fifo_size = UART4_RX_DMA_FIFO_SIZE};
+#else /* CSP_DMA_BUF_STATIC */
 static uart_rx_fifo_t uart4_rx_fifo = {.buf_size = UART4_RX_DMA_BUF_SIZE,
                                        .fifo_size = UART4_RX_DMA_FIFO_SIZE};
+#endif /* CSP_DMA_BUF_STATIC */
 
 #endif /* UART4_RX_DMA */
 
@@ -1010,14 +1894,24 @@ static DMA_HandleTypeDef uart4_dmatx_handle = {
              .PeriphInc = DMA_PINC_DISABLE,
              .Priority = UART4_TX_DMA_PRIORITY}};
 
+#if CSP_DMA_BUF_STATIC
+static uint8_t uart4_send_buf[UART4_TX_DMA_BUF_SIZE] CSP_DMA_BUF_ATTR;
+
+static uart_tx_buf_t uart4_tx_buf = {.send_buf = uart4_send_buf,
+                                     .buf_size = UART4_TX_DMA_BUF_SIZE};
+#else /* CSP_DMA_BUF_STATIC */
 static uart_tx_buf_t uart4_tx_buf = {.buf_size = UART4_TX_DMA_BUF_SIZE};
+#endif /* CSP_DMA_BUF_STATIC */
 
 #endif /* UART4_TX_DMA */
 
 /**
  * @brief UART4 initialization
  *
- * @param baud_rate Baud rate.
+ * @param baud_rate Baud rate. `UART_AUTO_BAUD`: Detect the baud rate by the
+ *                  sync byte 0x55 sent by host. It blocks until a 0x55
+ *                  arrives or `UART_AUTO_BAUD_TIMEOUT`, the interrupts
+ *                  are disabled only while waiting for one edge.
  * @return UART4 init status.
  *  @retval - 0: `UART_INIT_OK`:       Success.
  *  @retval - 1: `UART_INIT_FAIL`:     UART init failed.
@@ -1025,6 +1919,7 @@ static uart_tx_buf_t uart4_tx_buf = {.buf_size = UART4_TX_DMA_BUF_SIZE};
  *  @retval - 3: `UART_INIT_MEM_FAIL`: UART buffer memory init failed (It will
  *                                    dynamic allocate memory when using DMA).
  *  @retval - 4: `UART_INITED`:        This uart is inited.
+ *  @retval - 5: `UART_INIT_BAUD_FAIL`: Auto baud detection timeout or failed.
  */
 uint8_t uart4_init(uint32_t baud_rate) {
     if (HAL_UART_GetState(&uart4_handle) != HAL_UART_STATE_RESET) {
@@ -1052,32 +1947,36 @@ uint8_t uart4_init(uint32_t baud_rate) {
     HAL_GPIO_Init(CSP_GPIO_PORT(UART4_RX_PORT), &gpio_init_struct);
 #endif /* UART4_RX_ENABLE */
 
+#if UART4_RX_ENABLE
+    uint32_t bit_cycles = 0;
+    if (baud_rate == UART_AUTO_BAUD) {
+        bit_cycles = uart_autobaud_measure(CSP_GPIO_PORT(UART4_RX_PORT),
+                                           UART4_RX_PIN);
+        if (bit_cycles == 0) {
+            return UART_INIT_BAUD_FAIL;
+        }
+        uart4_handle.Init.BaudRate = HAL_RCC_GetHCLKFreq() / bit_cycles;
+    }
+#else  /* UART4_RX_ENABLE */
+    if (baud_rate == UART_AUTO_BAUD) {
+        /* Auto baud detection need RX. */
+        return UART_INIT_BAUD_FAIL;
+    }
+#endif /* UART4_RX_ENABLE */
+
     __HAL_RCC_UART4_CLK_ENABLE();
 
     HAL_NVIC_EnableIRQ(UART4_IRQn);
     HAL_NVIC_SetPriority(UART4_IRQn, UART4_IT_PRIORITY, UART4_IT_SUB);
 
 #if UART4_RX_DMA
-    uart4_rx_fifo.head_ptr = 0;
-
-    uart4_rx_fifo.recv_buf = CSP_MALLOC(uart4_rx_fifo.buf_size);
-    if (uart4_rx_fifo.recv_buf == NULL) {
-        return UART_INIT_MEM_FAIL;
-    }
-
-    uart4_rx_fifo.rx_fifo_buf = CSP_MALLOC(uart4_rx_fifo.fifo_size);
-    if (uart4_rx_fifo.rx_fifo_buf == NULL) {
-        return UART_INIT_MEM_FAIL;
-    }
-
-    uart4_rx_fifo.rx_fifo = ring_fifo_init(
-        uart4_rx_fifo.rx_fifo_buf, uart4_rx_fifo.fifo_size, RF_TYPE_STREAM);
-    if (uart4_rx_fifo.rx_fifo == NULL) {
+    if (uart_rx_fifo_alloc(&uart4_rx_fifo) != 0) {
         return UART_INIT_MEM_FAIL;
     }
 
     CSP_DMA_CLK_ENABLE(UART4_RX_DMA_NUMBER);
     if (HAL_DMA_Init(&uart4_dmarx_handle) != HAL_OK) {
+        uart_rx_fifo_free(&uart4_rx_fifo);
         return UART_INIT_DMA_FAIL;
     }
 
@@ -1092,13 +1991,17 @@ uint8_t uart4_init(uint32_t baud_rate) {
 #endif /* UART4_RX_DMA */
 
 #if UART4_TX_DMA
-    uart4_tx_buf.send_buf = CSP_MALLOC(uart4_tx_buf.buf_size);
-    if (uart4_tx_buf.send_buf == NULL) {
+    if (uart_tx_buf_alloc(&uart4_tx_buf) != 0) {
+#if UART4_RX_DMA
+        /* Release the rx fifo which is allocated before. */
+        uart_rx_fifo_free(&uart4_rx_fifo);
+#endif /* UART4_RX_DMA */
         return UART_INIT_MEM_FAIL;
     }
 
     CSP_DMA_CLK_ENABLE(UART4_TX_DMA_NUMBER);
     if (HAL_DMA_Init(&uart4_dmatx_handle) != HAL_OK) {
+        uart_tx_buf_free(&uart4_tx_buf);
         return UART_INIT_DMA_FAIL;
     }
 
@@ -1115,6 +2018,12 @@ uint8_t uart4_init(uint32_t baud_rate) {
         return UART_INIT_FAIL;
     }
 
+#if UART4_RX_ENABLE
+    if (bit_cycles != 0) {
+        uart_autobaud_apply(&uart4_handle, bit_cycles);
+    }
+#endif /* UART4_RX_ENABLE */
+
 #if UART4_RX_DMA
     __HAL_UART_ENABLE_IT(&uart4_handle, UART_IT_IDLE);
     __HAL_UART_CLEAR_IDLEFLAG(&uart4_handle);
@@ -1179,7 +2088,7 @@ void UART4_TX_DMA_IRQHandler(void) {
  *  @retval - 3: `UART_NO_INIT`:         UART is not init.
  */
 uint8_t uart4_deinit(void) {
-    if (HAL_UART_GetState(&uart4_handle) == HAL_UART_STATE_READY) {
+    if (HAL_UART_GetState(&uart4_handle) == HAL_UART_STATE_RESET) {
         return UART_NO_INIT;
     }
 
@@ -1196,9 +2105,7 @@ uint8_t uart4_deinit(void) {
 #if UART4_RX_DMA
 
     HAL_DMA_Abort(&uart4_dmarx_handle);
-    CSP_FREE(uart4_rx_fifo.recv_buf);
-    CSP_FREE(uart4_rx_fifo.rx_fifo_buf);
-    ring_fifo_destroy(uart4_rx_fifo.rx_fifo);
+    uart_rx_fifo_free(&uart4_rx_fifo);
 
     if (HAL_DMA_DeInit(&uart4_dmarx_handle) != HAL_OK) {
         return UART_DEINIT_DMA_FAIL;
@@ -1217,7 +2124,7 @@ uint8_t uart4_deinit(void) {
 
 #if UART4_TX_DMA
     HAL_DMA_Abort(&uart4_dmatx_handle);
-    CSP_FREE(uart4_tx_buf.send_buf);
+    uart_tx_buf_free(&uart4_tx_buf);
 
     if (HAL_DMA_DeInit(&uart4_dmatx_handle) != HAL_OK) {
         return UART_DEINIT_DMA_FAIL;
@@ -1257,11 +2164,15 @@ UART_HandleTypeDef uart5_handle = {.Instance = UART5,
 /**
  * @brief UART5 initialization
  *
- * @param baud_rate Baud rate.
+ * @param baud_rate Baud rate. `UART_AUTO_BAUD`: Detect the baud rate by the
+ *                  sync byte 0x55 sent by host. It blocks until a 0x55
+ *                  arrives or `UART_AUTO_BAUD_TIMEOUT`, the interrupts
+ *                  are disabled only while waiting for one edge.
  * @return UART5 init status.
  *  @retval - 0: `UART_INIT_OK`:       Success.
  *  @retval - 1: `UART_INIT_FAIL`:     UART init failed.
  *  @retval - 4: `UART_INITED`:        This uart is inited.
+ *  @retval - 5: `UART_INIT_BAUD_FAIL`: Auto baud detection timeout or failed.
  */
 uint8_t uart5_init(uint32_t baud_rate) {
     if (HAL_UART_GetState(&uart5_handle) != HAL_UART_STATE_RESET) {
@@ -1289,6 +2200,23 @@ uint8_t uart5_init(uint32_t baud_rate) {
     HAL_GPIO_Init(CSP_GPIO_PORT(UART5_RX_PORT), &gpio_init_struct);
 #endif /* UART5_RX_ENABLE */
 
+#if UART5_RX_ENABLE
+    uint32_t bit_cycles = 0;
+    if (baud_rate == UART_AUTO_BAUD) {
+        bit_cycles = uart_autobaud_measure(CSP_GPIO_PORT(UART5_RX_PORT),
+                                           UART5_RX_PIN);
+        if (bit_cycles == 0) {
+            return UART_INIT_BAUD_FAIL;
+        }
+        uart5_handle.Init.BaudRate = HAL_RCC_GetHCLKFreq() / bit_cycles;
+    }
+#else  /* UART5_RX_ENABLE */
+    if (baud_rate == UART_AUTO_BAUD) {
+        /* Auto baud detection need RX. */
+        return UART_INIT_BAUD_FAIL;
+    }
+#endif /* UART5_RX_ENABLE */
+
     __HAL_RCC_UART5_CLK_ENABLE();
 
     HAL_NVIC_EnableIRQ(UART5_IRQn);
@@ -1298,6 +2226,12 @@ uint8_t uart5_init(uint32_t baud_rate) {
         return UART_INIT_FAIL;
     }
 
+#if UART5_RX_ENABLE
+    if (bit_cycles != 0) {
+        uart_autobaud_apply(&uart5_handle, bit_cycles);
+    }
+#endif /* UART5_RX_ENABLE */
+
     return UART_INIT_OK;
 }
 
@@ -1410,14 +2344,17 @@ int uart_scanf(UART_HandleTypeDef *huart, const char *__format, ...) {
         return 0;
     }
 
+    /* Keep the last byte for the terminator. */
     if (huart->hdmarx != NULL) {
         while (str_len == 0) {
-            str_len = uart_dmarx_read(huart, uart_buffer, sizeof(uart_buffer));
+            str_len =
+                uart_dmarx_read(huart, uart_buffer, sizeof(uart_buffer) - 1);
         }
     } else {
         HAL_UARTEx_ReceiveToIdle(huart, (uint8_t *)uart_buffer,
-                                 sizeof(uart_buffer), &str_len, 0xFFFF);
+                                 sizeof(uart_buffer) - 1, &str_len, 0xFFFF);
     }
+    uart_buffer[str_len] = '\0';
 
     va_start(ap, __format);
     res = vsscanf((char *)uart_buffer, __format, ap);
@@ -1426,6 +2363,395 @@ int uart_scanf(UART_HandleTypeDef *huart, const char *__format, ...) {
     return res;
 }
 
+/**
+ * @}
+ */
+
+/*****************************************************************************
+ * @defgroup Public USART synchronous mode functions.
+ * @{
+ */
+
+#if USART1_SYNC_ENABLE || USART2_SYNC_ENABLE || USART3_SYNC_ENABLE
+
+/**
+ * @brief Identify the staging buffers of USART synchronous mode by handle.
+ *
+ * @param husart The handle of USART.
+ * @return The point of staging buffers.
+ */
+static inline usart_sync_buf_t *
+usart_sync_identify(USART_HandleTypeDef *husart) {
+    switch ((uintptr_t)(husart->Instance)) {
+
+#if USART1_SYNC_ENABLE
+        case USART1_BASE: {
+            return &usart1_sync_buf;
+        }
+#endif /* USART1_SYNC_ENABLE */
+
+#if USART2_SYNC_ENABLE
+        case USART2_BASE: {
+            return &usart2_sync_buf;
+        }
+#endif /* USART2_SYNC_ENABLE */
+
+#if USART3_SYNC_ENABLE
+        case USART3_BASE: {
+            return &usart3_sync_buf;
+        }
+#endif /* USART3_SYNC_ENABLE */
+
+        default: {
+        } break;
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Full-duplex bulk transfer of USART synchronous mode.
+ *
+ * @param husart The handle of USART.
+ * @param tx_data The data to send.
+ * @param[out] rx_data The buf to receive data, can be `NULL` if the received
+ *                     data is not needed.
+ * @param len The length of transfer. Max: the DMA buffer size of the
+ *            direction(s) in use.
+ * @return Transfer status.
+ *  @retval - 0: Success.
+ *  @retval - 1: Transfer error.
+ *  @retval - 2: The USART is busy or not initialized.
+ *  @retval - 3: Parameter invalid.
+ * @note If DMA is enabled for the direction(s) in use, `tx_data` is copied
+ *       to the send buf and this function returns immediately after the
+ *       transfer is started. The received data is copied to `rx_data` when
+ *       the transfer is done, `HAL_USART_GetState()` returns
+ *       `HAL_USART_STATE_READY` then. Otherwise it will block until the
+ *       transfer is done.
+ */
+uint8_t usart_sync_transfer(USART_HandleTypeDef *husart, const uint8_t *tx_data,
+                            uint8_t *rx_data, uint16_t len) {
+    if ((husart == NULL) || (tx_data == NULL) || (len == 0)) {
+        return 3;
+    }
+
+    usart_sync_buf_t *sync_buf = usart_sync_identify(husart);
+    if (sync_buf == NULL) {
+        return 3;
+    }
+
+    if (husart->State != HAL_USART_STATE_READY) {
+        return 2;
+    }
+
+    uart_tx_buf_t *tx_buf = sync_buf->tx_buf;
+    uart_rx_fifo_t *rx_fifo = sync_buf->rx_fifo;
+    HAL_StatusTypeDef res;
+
+    if (rx_data == NULL) {
+        if (tx_buf != NULL) {
+            if (len > tx_buf->buf_size) {
+                return 3;
+            }
+
+            memcpy(tx_buf->send_buf, tx_data, len);
+            res = HAL_USART_Transmit_DMA(husart, tx_buf->send_buf, len);
+        } else {
+            res = HAL_USART_Transmit(husart, tx_data, len, USART_SYNC_TIMEOUT);
+        }
+    } else {
+        if ((tx_buf != NULL) && (rx_fifo != NULL)) {
+            if ((len > tx_buf->buf_size) || (len > rx_fifo->buf_size)) {
+                return 3;
+            }
+
+            memcpy(tx_buf->send_buf, tx_data, len);
+            sync_buf->rx_data = rx_data;
+            res = HAL_USART_TransmitReceive_DMA(husart, tx_buf->send_buf,
+                                                rx_fifo->recv_buf, len);
+            if (res != HAL_OK) {
+                sync_buf->rx_data = NULL;
+            }
+        } else {
+            res = HAL_USART_TransmitReceive(husart, tx_data, rx_data, len,
+                                            USART_SYNC_TIMEOUT);
+        }
+    }
+
+    return (res == HAL_OK) ? 0 : 1;
+}
+
+/**
+ * @brief Copy the received data of USART synchronous mode to the buf of
+ *        caller.
+ *
+ * @param husart The handle of USART.
+ */
+static void usart_sync_done_callback(USART_HandleTypeDef *husart) {
+    usart_sync_buf_t *sync_buf = usart_sync_identify(husart);
+
+    if ((sync_buf == NULL) || (sync_buf->rx_data == NULL)) {
+        return;
+    }
+
+    memcpy(sync_buf->rx_data, sync_buf->rx_fifo->recv_buf,
+           husart->RxXferSize);
+    sync_buf->rx_data = NULL;
+}
+
+#if USE_HAL_USART_REGISTER_CALLBACKS == 0
+
+/**
+ * @brief USART Tx and Rx transfer completed callbacks.
+ *
+ * @param husart The handle of USART.
+ */
+void HAL_USART_TxRxCpltCallback(USART_HandleTypeDef *husart) {
+    usart_sync_done_callback(husart);
+}
+
+#endif /* USE_HAL_USART_REGISTER_CALLBACKS == 0 */
+
+#endif /* USART1_SYNC_ENABLE || USART2_SYNC_ENABLE || USART3_SYNC_ENABLE */
+
+/**
+ * @}
+ */
+
+/*****************************************************************************
+ * @defgroup Private UART auto baud functions.
+ * @{
+ */
+
+#if UART_AUTOBAUD_ENABLE
+
+/**
+ * @brief Measure the bit time by the sync byte 0x55.
+ *
+ * @param port The GPIO port of RX pin.
+ * @param pin The RX pin.
+ * @return The bit time. Unit: HCLK cycles. Return 0 if timeout.
+ * @note The 0x55 frame is `0 1010 1010 1` on the line (Start bit, LSB first
+ *       and stop bit), 9 edges with 1 bit time between each other. The edges
+ *       are timestamped by DWT cycle counter. The interrupts are disabled only
+ *       while waiting for one edge (Max 1 bit time at `UART_AUTO_BAUD_MIN`
+ *       for the first one, then 1.5 measured bit time), and are served
+ *       between two edges. A frame with uneven edges, or an edge missed while
+ *       serving the interrupts, is dropped, then wait for the next one.
+ */
+static uint32_t uart_autobaud_measure(GPIO_TypeDef *port, uint32_t pin) {
+    uint32_t edge[9];
+    uint32_t hclk = HAL_RCC_GetHCLKFreq();
+    uint32_t timeout = UART_AUTO_BAUD_TIMEOUT * (hclk / 1000U);
+    uint32_t max_bit = hclk / UART_AUTO_BAUD_MIN;
+    uint32_t start, primask, bit_cycles, interval, limit;
+    uint32_t last_level, level;
+    uint8_t i, valid;
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    start = DWT->CYCCNT;
+    last_level = port->IDR & pin;
+
+    while (DWT->CYCCNT - start < timeout) {
+        level = port->IDR & pin;
+        if ((last_level == 0) || (level != 0)) {
+            /* Wait for the falling edge of start bit. */
+            last_level = level;
+            continue;
+        }
+
+        edge[0] = DWT->CYCCNT;
+        limit = max_bit;
+        valid = 1;
+        primask = __get_PRIMASK();
+
+        for (i = 1; (i < 9) && valid; ++i) {
+            __disable_irq();
+
+            /* Odd edges are rising, even edges are falling. The line is
+             * already at the next level if the edge came while the interrupts
+             * were served. */
+            if (((port->IDR & pin) == 0) != ((i & 1) != 0)) {
+                valid = 0;
+            }
+
+            while (valid && (((port->IDR & pin) == 0) == ((i & 1) != 0))) {
+                if (DWT->CYCCNT - edge[i - 1] > limit) {
+                    valid = 0;
+                }
+            }
+            edge[i] = DWT->CYCCNT;
+
+            __set_PRIMASK(primask);
+
+            if (i == 1) {
+                /* Wait for the next edges 1.5 bit time at most. */
+                limit = (edge[1] - edge[0]) + (edge[1] - edge[0]) / 2;
+            }
+        }
+
+        if (valid) {
+            bit_cycles = (edge[8] - edge[0]) / 8;
+
+            for (i = 1; i < 9; ++i) {
+                /* Each edge interval must be in 0.5 ~ 1.5 bit time. */
+                interval = edge[i] - edge[i - 1];
+                if ((interval < bit_cycles / 2) ||
+                    (interval > bit_cycles + bit_cycles / 2)) {
+                    valid = 0;
+                    break;
+                }
+            }
+
+            if (valid && (bit_cycles != 0)) {
+                return bit_cycles;
+            }
+        }
+
+        last_level = port->IDR & pin;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Program the measured bit time into BRR directly.
+ *
+ * @param huart The handle of UART.
+ * @param bit_cycles The bit time. Unit: HCLK cycles.
+ * @note `HAL_UART_Init()` calculates BRR from the rounded baud rate, this
+ *       keeps the fraction of measured divider.
+ */
+static void uart_autobaud_apply(UART_HandleTypeDef *huart,
+                                uint32_t bit_cycles) {
+    uint32_t pclk = (huart->Instance == USART1) ? HAL_RCC_GetPCLK2Freq()
+                                                : HAL_RCC_GetPCLK1Freq();
+    uint32_t hclk = HAL_RCC_GetHCLKFreq();
+
+    /* Oversampling by 16: BRR = USARTDIV * 16 = fPCLK / baud rate. */
+    uint32_t brr =
+        (uint32_t)(((uint64_t)bit_cycles * pclk + (hclk >> 1)) / hclk);
+
+    __HAL_UART_DISABLE(huart);
+    huart->Instance->BRR = brr;
+    __HAL_UART_ENABLE(huart);
+}
+
+#endif /* UART_AUTOBAUD_ENABLE */
+
+/**
+ * @}
+ */
+
+/*****************************************************************************
+ * @defgroup Private UART DMA buffer functions.
+ * @{
+ */
+
+#if USART1_RX_DMA || USART2_RX_DMA || USART3_RX_DMA || UART4_RX_DMA
+
+/**
+ * @brief Allocate the receive buf and fifo of UART.
+ *
+ * @param uart_rx_fifo The receive fifo of UART.
+ * @return Allocate status.
+ *  @retval - 0: Success.
+ *  @retval - 1: No free memory, all allocated memory is released.
+ * @note When `CSP_DMA_BUF_STATIC` is enabled, the static storage is used.
+ */
+static uint8_t uart_rx_fifo_alloc(uart_rx_fifo_t *uart_rx_fifo) {
+    uart_rx_fifo->head_ptr = 0;
+
+#if !CSP_DMA_BUF_STATIC
+    uart_rx_fifo->recv_buf = CSP_MALLOC(uart_rx_fifo->buf_size);
+    uart_rx_fifo->rx_fifo_buf = CSP_MALLOC(uart_rx_fifo->fifo_size);
+    if ((uart_rx_fifo->recv_buf == NULL) ||
+        (uart_rx_fifo->rx_fifo_buf == NULL)) {
+        CSP_FREE(uart_rx_fifo->recv_buf);
+        CSP_FREE(uart_rx_fifo->rx_fifo_buf);
+        uart_rx_fifo->recv_buf = NULL;
+        uart_rx_fifo->rx_fifo_buf = NULL;
+        return 1;
+    }
+#endif /* !CSP_DMA_BUF_STATIC */
+
+    uart_rx_fifo->rx_fifo = ring_fifo_init(
+        uart_rx_fifo->rx_fifo_buf, uart_rx_fifo->fifo_size, RF_TYPE_STREAM);
+    if (uart_rx_fifo->rx_fifo == NULL) {
+#if !CSP_DMA_BUF_STATIC
+        CSP_FREE(uart_rx_fifo->recv_buf);
+        CSP_FREE(uart_rx_fifo->rx_fifo_buf);
+        uart_rx_fifo->recv_buf = NULL;
+        uart_rx_fifo->rx_fifo_buf = NULL;
+#endif /* !CSP_DMA_BUF_STATIC */
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Release the receive buf and fifo of UART.
+ *
+ * @param uart_rx_fifo The receive fifo of UART.
+ */
+static void uart_rx_fifo_free(uart_rx_fifo_t *uart_rx_fifo) {
+#if !CSP_DMA_BUF_STATIC
+    CSP_FREE(uart_rx_fifo->recv_buf);
+    CSP_FREE(uart_rx_fifo->rx_fifo_buf);
+    uart_rx_fifo->recv_buf = NULL;
+    uart_rx_fifo->rx_fifo_buf = NULL;
+#endif /* !CSP_DMA_BUF_STATIC */
+
+    ring_fifo_destroy(uart_rx_fifo->rx_fifo);
+    uart_rx_fifo->rx_fifo = NULL;
+}
+
+#endif /* USART1_RX_DMA || USART2_RX_DMA || USART3_RX_DMA || UART4_RX_DMA */
+
+#if USART1_TX_DMA || USART2_TX_DMA || USART3_TX_DMA || UART4_TX_DMA
+
+/**
+ * @brief Allocate the send buf of UART.
+ *
+ * @param uart_tx_buf The send buf of UART.
+ * @return Allocate status.
+ *  @retval - 0: Success.
+ *  @retval - 1: No free memory.
+ * @note When `CSP_DMA_BUF_STATIC` is enabled, the static storage is used.
+ */
+static uint8_t uart_tx_buf_alloc(uart_tx_buf_t *uart_tx_buf) {
+    uart_tx_buf->head_ptr = 0;
+
+#if !CSP_DMA_BUF_STATIC
+    uart_tx_buf->send_buf = CSP_MALLOC(uart_tx_buf->buf_size);
+    if (uart_tx_buf->send_buf == NULL) {
+        return 1;
+    }
+#endif /* !CSP_DMA_BUF_STATIC */
+
+    return 0;
+}
+
+/**
+ * @brief Release the send buf of UART.
+ *
+ * @param uart_tx_buf The send buf of UART.
+ */
+static void uart_tx_buf_free(uart_tx_buf_t *uart_tx_buf) {
+#if !CSP_DMA_BUF_STATIC
+    CSP_FREE(uart_tx_buf->send_buf);
+    uart_tx_buf->send_buf = NULL;
+#else  /* !CSP_DMA_BUF_STATIC */
+    UNUSED(uart_tx_buf);
+#endif /* !CSP_DMA_BUF_STATIC */
+}
+
+#endif /* USART1_TX_DMA || USART2_TX_DMA || USART3_TX_DMA || UART4_TX_DMA */
+
 /**
  * @}
  */
@@ -1474,6 +2800,31 @@ static inline uart_rx_fifo_t *uart_rx_identify(UART_HandleTypeDef *huart) {
     return NULL;
 }
 
+/**
+ * @brief Push the data received by DMA into the receive fifo.
+ *
+ * @param huart The handle of UART.
+ * @param uart_rx_fifo The receive fifo of UART.
+ * @param tail_ptr The position in DMA buf which has been written.
+ * @note If the DMA has wrapped but the full callback is not handled yet,
+ *       `tail_ptr` is smaller than the last position, nothing is pushed and
+ *       the full callback will push the data up to the end of buf.
+ */
+static inline void uart_dmarx_push(UART_HandleTypeDef *huart,
+                                   uart_rx_fifo_t *uart_rx_fifo,
+                                   uint32_t tail_ptr) {
+    uint32_t offset = (uart_rx_fifo->head_ptr) % (uint32_t)(huart->RxXferSize);
+
+    if (tail_ptr <= offset) {
+        return;
+    }
+
+    uint32_t copy = tail_ptr - offset;
+    uart_rx_fifo->head_ptr += copy;
+
+    ring_fifo_write(uart_rx_fifo->rx_fifo, huart->pRxBuffPtr + offset, copy);
+}
+
 /**
  * @brief UART received idle callback.
  *
@@ -1486,7 +2837,6 @@ void uart_dmarx_idle_callback(UART_HandleTypeDef *huart) {
     }
 
     uint32_t tail_ptr;
-    uint32_t copy, offset;
 
     /**
      * +~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+
@@ -1500,11 +2850,7 @@ void uart_dmarx_idle_callback(UART_HandleTypeDef *huart) {
     /* Received */
     tail_ptr = huart->RxXferSize - __HAL_DMA_GET_COUNTER(huart->hdmarx);
 
-    offset = (uart_rx_fifo->head_ptr) % (uint32_t)(huart->RxXferSize);
-    copy = tail_ptr - offset;
-    uart_rx_fifo->head_ptr += copy;
-
-    ring_fifo_write(uart_rx_fifo->rx_fifo, huart->pRxBuffPtr + offset, copy);
+    uart_dmarx_push(huart, uart_rx_fifo, tail_ptr);
 }
 
 /**
@@ -1519,7 +2865,6 @@ void uart_dmarx_halfdone_callback(UART_HandleTypeDef *huart) {
     }
 
     uint32_t tail_ptr;
-    uint32_t offset, copy;
 
     /**
      * +~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+
@@ -1531,13 +2876,15 @@ void uart_dmarx_halfdone_callback(UART_HandleTypeDef *huart) {
      * +~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+
      */
 
-    tail_ptr = (huart->RxXferSize >> 1) + (huart->RxXferSize & 1);
+    /* The half and the full of one byte buf are the same byte, it is pushed
+     * by the full callback. */
+    if (huart->RxXferSize < 2) {
+        return;
+    }
 
-    offset = (uart_rx_fifo->head_ptr) % (uint32_t)(huart->RxXferSize);
-    copy = tail_ptr - offset;
-    uart_rx_fifo->head_ptr += copy;
+    tail_ptr = (huart->RxXferSize >> 1) + (huart->RxXferSize & 1);
 
-    ring_fifo_write(uart_rx_fifo->rx_fifo, huart->pRxBuffPtr + offset, copy);
+    uart_dmarx_push(huart, uart_rx_fifo, tail_ptr);
 }
 
 /**
@@ -1552,7 +2899,6 @@ void uart_dmarx_done_callback(UART_HandleTypeDef *huart) {
     }
 
     uint32_t tail_ptr;
-    uint32_t offset, copy;
 
     /**
      * +~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~+
@@ -1566,11 +2912,7 @@ void uart_dmarx_done_callback(UART_HandleTypeDef *huart) {
 
     tail_ptr = huart->RxXferSize;
 
-    offset = (uart_rx_fifo->head_ptr) % (uint32_t)(huart->RxXferSize);
-    copy = tail_ptr - offset;
-    uart_rx_fifo->head_ptr += copy;
-
-    ring_fifo_write(uart_rx_fifo->rx_fifo, huart->pRxBuffPtr + offset, copy);
+    uart_dmarx_push(huart, uart_rx_fifo, tail_ptr);
 
     if (huart->hdmarx->Init.Mode != DMA_CIRCULAR) {
         /* Reopen the DMA receive. */
@@ -1607,21 +2949,28 @@ uint32_t uart_dmarx_read(UART_HandleTypeDef *huart, void *buf,
  * @brief Resize the receive buf and fifo of UART.
  *
  * @param huart The handle of UART
- * @param buf_size New buf size
- * @param fifo_size New fifo size
+ * @param buf_size New buf size (1-65535).
+ * @param fifo_size New fifo size (Must be power of 2).
  * @return Resize message:
  *  @retval - 0: Succeess
  *  @retval - 1: This uart not enable DMA Rx.
- *  @retval - 2: This UART is enabled.
- *  @retval - 3: Parameter Error, size can't be 0.
- * @warning Must be disabled the UART before resize!
- *          You should call `u(s)artx_deinit()` before call this function,
- *          than call `u(s)artx_init()` to using new size.
- *          It may allocated fail when reinitialize uart.
+ *  @retval - 2: No free memory to allocate.
+ *  @retval - 3: Parameter Error, size can't be 0 and fifo size must be power
+ *               of 2.
+ * @note If the UART is uninitialized, just adjust the size which will be used
+ *       by next `u(s)artx_init()`.
+ *       If the UART is receiving, the new storage is allocated first, the DMA
+ *       is retargeted to the start of new buf (A new full boundary) and
+ *       restarted at once, then the data received in old buf is flushed. The
+ *       unread data in the fifo is migrated into the new fifo with the
+ *       interrupts enabled, the old fifo is still used until the last chunk.
+ *       Unread data which exceed the new fifo size will be dropped.
+ *       Always return 2 when `CSP_DMA_BUF_STATIC` is enabled.
  */
 uint8_t uart_dmarx_resize_fifo(UART_HandleTypeDef *huart, uint32_t buf_size,
                                uint32_t fifo_size) {
-    if ((buf_size == 0) || (fifo_size == 0)) {
+    if ((buf_size == 0) || (buf_size > UINT16_MAX) || (fifo_size == 0) ||
+        ((fifo_size & (fifo_size - 1)) != 0)) {
         return 3;
     }
 
@@ -1630,13 +2979,112 @@ uint8_t uart_dmarx_resize_fifo(UART_HandleTypeDef *huart, uint32_t buf_size,
         return 1;
     }
 
-    if (huart->hdmatx != NULL) {
+#if CSP_DMA_BUF_STATIC
+    /* The size is fixed by configuration. */
+    return 2;
+#else  /* CSP_DMA_BUF_STATIC */
+    /* The UART is uninitialized, just adjust the size. */
+    if (huart->hdmarx == NULL) {
+        uart_rx_fifo->buf_size = buf_size;
+        uart_rx_fifo->fifo_size = fifo_size;
+        return 0;
+    }
+
+    uint8_t *new_recv_buf = CSP_MALLOC(buf_size);
+    uint8_t *new_fifo_buf = CSP_MALLOC(fifo_size);
+    ring_fifo_t *new_fifo = NULL;
+
+    if ((new_recv_buf != NULL) && (new_fifo_buf != NULL)) {
+        new_fifo = ring_fifo_init(new_fifo_buf, fifo_size, RF_TYPE_STREAM);
+    }
+
+    if (new_fifo == NULL) {
+        CSP_FREE(new_recv_buf);
+        CSP_FREE(new_fifo_buf);
         return 2;
     }
 
+    uint8_t *old_recv_buf = uart_rx_fifo->recv_buf;
+    uint8_t *old_fifo_buf = uart_rx_fifo->rx_fifo_buf;
+    ring_fifo_t *old_fifo = uart_rx_fifo->rx_fifo;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    /* Stop the DMA only for retargeting, a few bus cycles. The byte received
+     * in this window will be held by the data register of UART. */
+    __HAL_DMA_DISABLE(huart->hdmarx);
+
+    uint32_t remain = __HAL_DMA_GET_COUNTER(huart->hdmarx);
+    uint32_t wrapped = __HAL_DMA_GET_FLAG(
+        huart->hdmarx, __HAL_DMA_GET_TC_FLAG_INDEX(huart->hdmarx));
+
+    /* Clear the half/full flags of old buf, prevent calling the callbacks with
+     * the new buf. */
+    __HAL_DMA_CLEAR_FLAG(huart->hdmarx,
+                         __HAL_DMA_GET_GI_FLAG_INDEX(huart->hdmarx) |
+                             __HAL_DMA_GET_HT_FLAG_INDEX(huart->hdmarx) |
+                             __HAL_DMA_GET_TC_FLAG_INDEX(huart->hdmarx));
+
+    /* Retarget the DMA to the start of new buf and restart it before the old
+     * buf is flushed, so the UART will not overrun. */
+    huart->hdmarx->Instance->CMAR = (uint32_t)(uintptr_t)new_recv_buf;
+    __HAL_DMA_SET_COUNTER(huart->hdmarx, buf_size);
+    __HAL_DMA_ENABLE(huart->hdmarx);
+
+    /* Flush the received data of old buf into old fifo by the saved counter.
+     * If the full callback is pending, push the data up to the end first. */
+    if (wrapped) {
+        uart_dmarx_push(huart, uart_rx_fifo, huart->RxXferSize);
+    }
+    uart_dmarx_push(huart, uart_rx_fifo, huart->RxXferSize - remain);
+
+    huart->pRxBuffPtr = new_recv_buf;
+    huart->RxXferSize = (uint16_t)buf_size;
+    uart_rx_fifo->head_ptr = 0;
+    uart_rx_fifo->recv_buf = new_recv_buf;
     uart_rx_fifo->buf_size = buf_size;
+
+    __set_PRIMASK(primask);
+
+    /* Migrate the unread data. The half/full callbacks of new buf keep
+     * pushing into the old fifo, so the order is kept. Only the last chunk
+     * and the swap of fifo are done with the interrupts disabled. */
+    uint8_t migrate_buf[32];
+    uint32_t migrate_len;
+    for (;;) {
+        do {
+            migrate_len =
+                ring_fifo_read(old_fifo, migrate_buf, sizeof(migrate_buf));
+            ring_fifo_write(new_fifo, migrate_buf, migrate_len);
+        } while (migrate_len != 0);
+
+        __disable_irq();
+
+        migrate_len =
+            ring_fifo_read(old_fifo, migrate_buf, sizeof(migrate_buf));
+        ring_fifo_write(new_fifo, migrate_buf, migrate_len);
+
+        if (migrate_len < sizeof(migrate_buf)) {
+            break;
+        }
+
+        /* The callbacks pushed a lot in the meantime, serve them first. */
+        __set_PRIMASK(primask);
+    }
+
+    uart_rx_fifo->rx_fifo = new_fifo;
+    uart_rx_fifo->rx_fifo_buf = new_fifo_buf;
     uart_rx_fifo->fifo_size = fifo_size;
+
+    __set_PRIMASK(primask);
+
+    CSP_FREE(old_recv_buf);
+    CSP_FREE(old_fifo_buf);
+    ring_fifo_destroy(old_fifo);
+
     return 0;
+#endif /* CSP_DMA_BUF_STATIC */
 }
 
 /**
@@ -1736,6 +3184,12 @@ uint32_t uart_dmatx_write(UART_HandleTypeDef *huart, const void *data,
         return 0;
     }
 
+    /* The buf of last send may be still in transfer, wait for end. */
+    if ((send_tx_buf->head_ptr == 0) && (huart->hdmatx != NULL)) {
+        while (__HAL_UART_GET_FLAG(huart, UART_FLAG_TC) == RESET)
+            ;
+    }
+
     /* Get the remain length of buffer. */
     uint32_t buf_remain = send_tx_buf->buf_size - send_tx_buf->head_ptr;
 
@@ -1795,6 +3249,7 @@ uint32_t uart_dmatx_send(UART_HandleTypeDef *huart) {
  *  @retval - 2: No free memory to allocate.
  *  @retval - 3: This uart is busy now.
  *  @retval - 4: Parameter error, size can't be 0.
+ * @note Always return 2 when `CSP_DMA_BUF_STATIC` is enabled.
  */
 uint8_t uart_dmatx_resize_buf(UART_HandleTypeDef *huart, uint32_t size) {
     if (size == 0) {
@@ -1812,6 +3267,10 @@ uint8_t uart_dmatx_resize_buf(UART_HandleTypeDef *huart, uint32_t size) {
         return 3;
     }
 
+#if CSP_DMA_BUF_STATIC
+    /* The size is fixed by configuration. */
+    return 2;
+#else  /* CSP_DMA_BUF_STATIC */
     /* The UART is uninitialized, just adjust the size. */
     if (huart->hdmatx == NULL) {
         send_tx_buf->buf_size = size;
@@ -1828,6 +3287,7 @@ uint8_t uart_dmatx_resize_buf(UART_HandleTypeDef *huart, uint32_t size) {
     send_tx_buf->buf_size = size;
 
     return 0;
+#endif /* CSP_DMA_BUF_STATIC */
 }
 
 /**
@@ -1893,6 +3353,16 @@ void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart) {
     }
 
     if (NULL != huart->hdmarx) {
+        /* The DMA is aborted and restarts at the start of buf, push the data
+         * received in this round first. */
+        uart_rx_fifo_t *uart_rx_fifo = uart_rx_identify(huart);
+        if (uart_rx_fifo != NULL) {
+            uart_dmarx_push(huart, uart_rx_fifo,
+                            huart->RxXferSize -
+                                __HAL_DMA_GET_COUNTER(huart->hdmarx));
+            uart_rx_fifo->head_ptr = 0;
+        }
+
         while (
             HAL_UART_Receive_DMA(huart, huart->pRxBuffPtr, huart->RxXferSize)) {
             __HAL_UNLOCK(huart);
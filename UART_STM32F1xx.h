@@ -29,12 +29,23 @@ extern "C" {
 #define UART_INIT_DMA_FAIL   2
 #define UART_INIT_MEM_FAIL   3
 #define UART_INITED          4
+#define UART_INIT_BAUD_FAIL  5
 
 #define UART_DEINIT_OK       0
 #define UART_DEINIT_FAIL     1
 #define UART_DEINIT_DMA_FAIL 2
 #define UART_NO_INIT         3
 
+/* Timeout of blocking transfer in USART synchronous mode. Unit: ms. */
+#define USART_SYNC_TIMEOUT   1000
+
+/* Pass to `u(s)artx_init()` to detect the baud rate by sync byte 0x55. */
+#define UART_AUTO_BAUD         0
+/* Timeout of waiting for the sync byte. Unit: ms. */
+#define UART_AUTO_BAUD_TIMEOUT 5000
+/* The minimum baud rate can be detected. */
+#define UART_AUTO_BAUD_MIN     300
+
 /**
  * @}
  */
@@ -60,6 +71,16 @@ uint8_t usart1_deinit(void);
       CSP_DMA_CHANNEL_IRQ(USART1_TX_DMA_NUMBER, USART1_TX_DMA_CHANNEL)
 #  endif /* USART1_TX_DMA */
 
+#  if USART1_SYNC_ENABLE
+#    if !USART1_TX_ENABLE
+#      error "You must enable USART1 TX before you can use synchronous mode. "
+#    endif /* !USART1_TX_ENABLE */
+extern USART_HandleTypeDef usart1_sync_handle;
+uint8_t usart1_sync_init(uint32_t baud_rate, uint32_t clk_polarity,
+                         uint32_t clk_phase);
+uint8_t usart1_sync_deinit(void);
+#  endif /* USART1_SYNC_ENABLE */
+
 #endif /* USART1_ENABLE */
 
 /**
@@ -87,6 +108,16 @@ uint8_t usart2_deinit(void);
       CSP_DMA_CHANNEL_IRQ(USART2_TX_DMA_NUMBER, USART2_TX_DMA_CHANNEL)
 #  endif /* USART2_TX_DMA */
 
+#  if USART2_SYNC_ENABLE
+#    if !USART2_TX_ENABLE
+#      error "You must enable USART2 TX before you can use synchronous mode. "
+#    endif /* !USART2_TX_ENABLE */
+extern USART_HandleTypeDef usart2_sync_handle;
+uint8_t usart2_sync_init(uint32_t baud_rate, uint32_t clk_polarity,
+                         uint32_t clk_phase);
+uint8_t usart2_sync_deinit(void);
+#  endif /* USART2_SYNC_ENABLE */
+
 #endif /* USART2_ENABLE */
 
 /**
@@ -114,6 +145,16 @@ uint8_t usart3_deinit(void);
       CSP_DMA_CHANNEL_IRQ(USART3_TX_DMA_NUMBER, USART3_TX_DMA_CHANNEL)
 #  endif /* USART3_TX_DMA */
 
+#  if USART3_SYNC_ENABLE
+#    if !USART3_TX_ENABLE
+#      error "You must enable USART3 TX before you can use synchronous mode. "
+#    endif /* !USART3_TX_ENABLE */
+extern USART_HandleTypeDef usart3_sync_handle;
+uint8_t usart3_sync_init(uint32_t baud_rate, uint32_t clk_polarity,
+                         uint32_t clk_phase);
+uint8_t usart3_sync_deinit(void);
+#  endif /* USART3_SYNC_ENABLE */
+
 #endif /* USART3_ENABLE */
 
 /**
@@ -184,6 +225,11 @@ uint32_t uart_dmatx_send(UART_HandleTypeDef *huart);
 uint8_t uart_dmatx_resize_buf(UART_HandleTypeDef *huart, uint32_t size);
 uint32_t uart_damtx_get_buf_szie(UART_HandleTypeDef *huart);
 
+#if USART1_SYNC_ENABLE || USART2_SYNC_ENABLE || USART3_SYNC_ENABLE
+uint8_t usart_sync_transfer(USART_HandleTypeDef *husart, const uint8_t *tx_data,
+                            uint8_t *rx_data, uint16_t len);
+#endif /* USART1_SYNC_ENABLE || USART2_SYNC_ENABLE || USART3_SYNC_ENABLE */
+
 /**
  * @}
  */
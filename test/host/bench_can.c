@@ -0,0 +1,204 @@
+/**
+ * @file    bench_can.c
+ * @author  Deadline039
+ * @brief   Frames per second of CAN_STM32F1xx.c on the simulated bxCAN.
+ * @version 3.3.3
+ * @date    2024-10-22
+ * @note    Transmit flood: CAN1 sends as fast as the mailboxes (or the
+ *          transmit queue) take the frames. Receive flood: a virtual node
+ *          sends back-to-back, the frames are read from the receive rings.
+ *
+ *          "cpu" is the modeled CPU load, it counts the HAL calls, the
+ *          interrupt entry and exit and the register accesses of mailboxes
+ *          and FIFOs (see `SIM_COST_xxx`), not the other code of driver.
+ *          "cycles/frame" is the CPU cycles charged per frame, compare the
+ *          variants to see the fast path against HAL. "host" is the wall
+ *          time of host per frame, it includes the simulator.
+ */
+
+#include <CSP_Config.h>
+
+#include "sim.h"
+
+#include <stdio.h>
+#include <time.h>
+
+/* Frames of each run. */
+#define BENCH_FRAMES    20000
+/* Idle between two polls of main loop. Unit: bit. */
+#define BENCH_POLL_BITS 16
+/* Give up the run after the bus time of this per frame. Unit: bit. */
+#define BENCH_LIMIT_BITS 256
+
+/**
+ * @brief Result of a run.
+ */
+typedef struct {
+    uint32_t frames;     /*!< Frames on bus.                                */
+    uint32_t lost;       /*!< Frames lost, FIFO overrun, ring full or not
+                              sent in time.                                 */
+    uint64_t cycles;     /*!< Simulated time.                               */
+    uint64_t busy;       /*!< CPU cycles charged.                           */
+    uint64_t bus_busy;   /*!< Cycles the bus is not idle.                   */
+    double host_ns;      /*!< Wall time of host.                            */
+} bench_result_t;
+
+/**
+ * @brief Get the wall time of host.
+ *
+ * @return Time. Unit: ns.
+ */
+static double bench_host_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/**
+ * @brief Reset the simulator and initialize CAN1, a virtual node
+ *        acknowledges on bus 0.
+ *
+ * @param baud_rate Baud rate. Unit: Kbps.
+ * @return The virtual node.
+ */
+static int bench_start(uint32_t baud_rate) {
+    can1_deinit();
+
+    sim_reset();
+    sim_can_bus_set_rate(0, baud_rate * 1000);
+    if (can1_init(baud_rate, 0) != CAN_INIT_OK) {
+        printf("can1_init failed\n");
+    }
+
+    return sim_can_node_add(0);
+}
+
+/**
+ * @brief Print a result.
+ *
+ * @param name Name of run.
+ * @param baud_rate Baud rate. Unit: Kbps.
+ * @param result The result.
+ */
+static void bench_print(const char *name, uint32_t baud_rate,
+                        const bench_result_t *result) {
+    double seconds = (double)result->cycles / SIM_HCLK_FREQ;
+
+    printf("%-8s %5u kbps: %7.0f fps, bus %5.1f%%, cpu %5.1f%%, "
+           "%4.0f cycles/frame, %5u lost, host %6.0f ns/frame\n",
+           name, (unsigned)baud_rate, result->frames / seconds,
+           100.0 * (double)result->bus_busy / (double)result->cycles,
+           100.0 * (double)result->busy / (double)result->cycles,
+           (double)result->busy / result->frames, (unsigned)result->lost,
+           result->host_ns / result->frames);
+}
+
+/**
+ * @brief CAN1 sends 8-byte frames back-to-back.
+ *
+ * @param baud_rate Baud rate. Unit: Kbps.
+ * @param[out] result The result.
+ */
+static void bench_tx(uint32_t baud_rate, bench_result_t *result) {
+    int node = bench_start(baud_rate);
+    uint64_t poll = (uint64_t)sim_can_bus_bit_cycles(0) * BENCH_POLL_BITS;
+    uint64_t limit = (uint64_t)sim_can_bus_bit_cycles(0) * BENCH_LIMIT_BITS *
+                     BENCH_FRAMES;
+    uint64_t start = sim_now();
+    uint64_t busy = sim_busy_cycles();
+    double host = bench_host_ns();
+    can_frame_t frames[4];
+    uint32_t sent = 0;
+
+    for (uint32_t i = 0; i < 4; ++i) {
+        frames[i] = (can_frame_t){.ide = CAN_ID_STD, .dlc = 8};
+    }
+
+    while ((sim_can_node_received(node) < BENCH_FRAMES) &&
+           (sim_now() - start < limit)) {
+        uint32_t count = BENCH_FRAMES - sent;
+        count = (count > 4) ? 4 : count;
+
+        for (uint32_t i = 0; i < count; ++i) {
+            frames[i].id = 0x100 + ((sent + i) & 0xFF);
+            frames[i].data[0] = (uint8_t)(sent + i);
+        }
+
+        uint32_t n = (count != 0) ? can_send_batch(can1_selected, frames, count)
+                                  : 0;
+        sent += n;
+        if (n < count || count == 0) {
+            sim_run(poll);
+        }
+    }
+
+    result->frames = sim_can_node_received(node);
+    result->lost = BENCH_FRAMES - result->frames;
+    result->cycles = sim_now() - start;
+    result->busy = sim_busy_cycles() - busy;
+    result->bus_busy = sim_can_bus_get_stats(0)->busy;
+    result->host_ns = bench_host_ns() - host;
+}
+
+/**
+ * @brief A virtual node sends 8-byte frames back-to-back, CAN1 receives.
+ *
+ * @param baud_rate Baud rate. Unit: Kbps.
+ * @param[out] result The result.
+ */
+static void bench_rx(uint32_t baud_rate, bench_result_t *result) {
+    int node = bench_start(baud_rate);
+    uint64_t poll = (uint64_t)sim_can_bus_bit_cycles(0) * BENCH_POLL_BITS;
+    uint64_t start = sim_now();
+    uint64_t busy = sim_busy_cycles();
+    double host = bench_host_ns();
+    uint32_t queued = 0;
+    uint32_t received = 0;
+    can_frame_t frames[16];
+
+    while (sim_can_bus_get_stats(0)->frames < BENCH_FRAMES) {
+        while ((queued < BENCH_FRAMES) &&
+               (sim_can_node_pending(node) < SIM_CAN_NODE_QUEUE)) {
+            sim_can_frame_t frame = {.id = 0x100 + (queued & 0xFF),
+                                     .ide = CAN_ID_STD,
+                                     .dlc = 8,
+                                     .data = {(uint8_t)queued}};
+            sim_can_node_send(node, &frame);
+            ++queued;
+        }
+
+        sim_run(poll);
+        received += can_receive_batch(can1_selected, frames, 16);
+    }
+
+    /* The frames in FIFO and ring. */
+    sim_run(poll * 4);
+    uint32_t n;
+    while ((n = can_receive_batch(can1_selected, frames, 16)) != 0) {
+        received += n;
+    }
+
+    result->frames = BENCH_FRAMES;
+    result->lost = BENCH_FRAMES - received;
+    result->cycles = sim_now() - start;
+    result->busy = sim_busy_cycles() - busy;
+    result->bus_busy = sim_can_bus_get_stats(0)->busy;
+    result->host_ns = bench_host_ns() - host;
+}
+
+int main(void) {
+    static const uint32_t rates[] = {1000, 500};
+    bench_result_t result;
+
+    printf("CAN_FAST_PATH %d, CAN1_TX_QUEUE_SIZE %d, CAN1_RX0_RING_SIZE %d\n",
+           CAN_FAST_PATH, CAN1_TX_QUEUE_SIZE, CAN1_RX0_RING_SIZE);
+
+    for (uint32_t i = 0; i < sizeof(rates) / sizeof(rates[0]); ++i) {
+        bench_tx(rates[i], &result);
+        bench_print("tx flood", rates[i], &result);
+        bench_rx(rates[i], &result);
+        bench_print("rx flood", rates[i], &result);
+    }
+
+    return 0;
+}
@@ -0,0 +1,242 @@
+/**
+ * @file    bench_signal.c
+ * @author  Deadline039
+ * @brief   Time of signal pack and unpack of CAN_STM32F1xx.c, generic and
+ *          generated by dbc2c.sh from test_signal.dbc.
+ * @version 3.3.3
+ * @date    2024-10-22
+ * @note    "walker" follows the DBC definition bit by bit, "generic" is
+ *          `can_signal_unpack()` and `can_signal_pack()` with the signal
+ *          table, "generated" is the accessors of message with constant
+ *          positions. The time is the wall time of host per frame.
+ */
+
+#include <CSP_Config.h>
+
+#include "sim.h"
+#include "test_signal.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/* Frames of each run. */
+#define BENCH_FRAMES 1000000
+/* Random frames, reused in turn. */
+#define BENCH_POOL   256
+
+/* State of `bench_random()`. */
+static uint32_t bench_seed;
+
+/* The frames and values of all runs. */
+static can_frame_t bench_frames[BENCH_POOL];
+static float bench_values[BENCH_POOL][8];
+
+/* Keeps the results from being optimized out. */
+static volatile float bench_sink;
+
+/**
+ * @brief Get a pseudo random number.
+ *
+ * @return The number.
+ */
+static uint32_t bench_random(void) {
+    bench_seed ^= bench_seed << 13;
+    bench_seed ^= bench_seed >> 17;
+    bench_seed ^= bench_seed << 5;
+    return bench_seed;
+}
+
+/**
+ * @brief Get the wall time of host.
+ *
+ * @return Time. Unit: ns.
+ */
+static double bench_host_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/**
+ * @brief Unpack the signals bit by bit.
+ *
+ * @param signals The signals of message.
+ * @param count Number of signals.
+ * @param frame The frame received.
+ * @param[out] values The physical values.
+ */
+static void bench_walker_unpack(const can_signal_t *signals, uint32_t count,
+                                const can_frame_t *frame, float *values) {
+    for (uint32_t s = 0; s < count; ++s) {
+        const can_signal_t *signal = &signals[s];
+        uint32_t pos = signal->start;
+        uint64_t raw = 0;
+
+        for (uint32_t i = 0; i < signal->length; ++i) {
+            uint64_t bit = (frame->data[pos / 8] >> (pos % 8)) & 1U;
+            if (signal->order == CAN_SIGNAL_MOTOROLA) {
+                raw = (raw << 1) | bit;
+                pos = ((pos % 8) == 0) ? pos + 15 : pos - 1;
+            } else {
+                raw |= bit << i;
+                ++pos;
+            }
+        }
+
+        if (signal->is_signed && (signal->length < 64) &&
+            ((raw >> (signal->length - 1)) & 1U)) {
+            raw |= ~CAN_SIGNAL_MASK(signal->length);
+        }
+        values[s] = (signal->is_signed ? (float)(int64_t)raw : (float)raw) *
+                        signal->scale +
+                    signal->offset;
+    }
+}
+
+/**
+ * @brief Pack the signals bit by bit, rounded and saturated as
+ *        `can_signal_pack()`.
+ *
+ * @param signals The signals of message.
+ * @param count Number of signals.
+ * @param values The physical values.
+ * @param frame The frame to send.
+ */
+static void bench_walker_pack(const can_signal_t *signals, uint32_t count,
+                              const float *values, can_frame_t *frame) {
+    for (uint32_t s = 0; s < count; ++s) {
+        const can_signal_t *signal = &signals[s];
+        uint64_t raw = dbc_raw(values[s], signal->scale, signal->offset,
+                               signal->length, signal->is_signed);
+        uint32_t pos = signal->start;
+
+        for (uint32_t i = 0; i < signal->length; ++i) {
+            uint32_t n = (signal->order == CAN_SIGNAL_MOTOROLA)
+                             ? signal->length - 1 - i
+                             : i;
+            uint8_t bit = (uint8_t)(1U << (pos % 8));
+
+            if ((raw >> n) & 1U) {
+                frame->data[pos / 8] |= bit;
+            } else {
+                frame->data[pos / 8] &= (uint8_t)~bit;
+            }
+            if (signal->order == CAN_SIGNAL_MOTOROLA) {
+                pos = ((pos % 8) == 0) ? pos + 15 : pos - 1;
+            } else {
+                ++pos;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Fill the pool with random frames and the values of them.
+ *
+ * @param signals The signals of message.
+ * @param count Number of signals.
+ */
+static void bench_start(const can_signal_t *signals, uint32_t count) {
+    bench_seed = 0x2545F491U;
+
+    for (uint32_t i = 0; i < BENCH_POOL; ++i) {
+        memset(&bench_frames[i], 0, sizeof(can_frame_t));
+        bench_frames[i].dlc = 8;
+        for (uint32_t b = 0; b < 8; ++b) {
+            bench_frames[i].data[b] = (uint8_t)bench_random();
+        }
+        can_signal_unpack(signals, count, &bench_frames[i], bench_values[i]);
+    }
+}
+
+/**
+ * @brief Print the time of a run.
+ *
+ * @param message Name of message.
+ * @param name Name of run.
+ * @param host_ns Wall time of host.
+ */
+static void bench_print(const char *message, const char *name,
+                        double host_ns) {
+    printf("%-6s %-16s %7.1f ns/frame\n", message, name,
+           host_ns / BENCH_FRAMES);
+}
+
+/**
+ * @brief Time the unpack and pack of a message in the three ways.
+ *
+ * @param message Name of message.
+ * @param signals The signals of message.
+ * @param count Number of signals.
+ * @param pack The generated pack.
+ * @param unpack The generated unpack.
+ */
+static void bench_message(const char *message, const can_signal_t *signals,
+                          uint32_t count,
+                          void (*pack)(const float *, can_frame_t *),
+                          void (*unpack)(const can_frame_t *, float *)) {
+    float values[8];
+    double host;
+
+    bench_start(signals, count);
+
+    host = bench_host_ns();
+    for (uint32_t i = 0; i < BENCH_FRAMES; ++i) {
+        bench_walker_unpack(signals, count, &bench_frames[i % BENCH_POOL],
+                            values);
+        bench_sink = values[0];
+    }
+    bench_print(message, "walker unpack", bench_host_ns() - host);
+
+    host = bench_host_ns();
+    for (uint32_t i = 0; i < BENCH_FRAMES; ++i) {
+        can_signal_unpack(signals, count, &bench_frames[i % BENCH_POOL],
+                          values);
+        bench_sink = values[0];
+    }
+    bench_print(message, "generic unpack", bench_host_ns() - host);
+
+    host = bench_host_ns();
+    for (uint32_t i = 0; i < BENCH_FRAMES; ++i) {
+        unpack(&bench_frames[i % BENCH_POOL], values);
+        bench_sink = values[0];
+    }
+    bench_print(message, "generated unpack", bench_host_ns() - host);
+
+    host = bench_host_ns();
+    for (uint32_t i = 0; i < BENCH_FRAMES; ++i) {
+        can_frame_t *frame = &bench_frames[i % BENCH_POOL];
+        bench_walker_pack(signals, count, bench_values[i % BENCH_POOL],
+                          frame);
+        bench_sink = frame->data[0];
+    }
+    bench_print(message, "walker pack", bench_host_ns() - host);
+
+    host = bench_host_ns();
+    for (uint32_t i = 0; i < BENCH_FRAMES; ++i) {
+        can_frame_t *frame = &bench_frames[i % BENCH_POOL];
+        can_signal_pack(signals, count, bench_values[i % BENCH_POOL], frame);
+        bench_sink = frame->data[0];
+    }
+    bench_print(message, "generic pack", bench_host_ns() - host);
+
+    host = bench_host_ns();
+    for (uint32_t i = 0; i < BENCH_FRAMES; ++i) {
+        can_frame_t *frame = &bench_frames[i % BENCH_POOL];
+        pack(bench_values[i % BENCH_POOL], frame);
+        bench_sink = frame->data[0];
+    }
+    bench_print(message, "generated pack", bench_host_ns() - host);
+}
+
+int main(void) {
+    bench_message("ENGINE", dbc_engine_signals, DBC_ENGINE_SIGNALS,
+                  dbc_engine_pack, dbc_engine_unpack);
+    bench_message("MIXED", dbc_mixed_signals, DBC_MIXED_SIGNALS,
+                  dbc_mixed_pack, dbc_mixed_unpack);
+    bench_message("BODY", dbc_body_signals, DBC_BODY_SIGNALS, dbc_body_pack,
+                  dbc_body_unpack);
+
+    return 0;
+}
@@ -0,0 +1,242 @@
+/**
+ * @file    bench_uart.c
+ * @author  Deadline039
+ * @brief   Bytes per cycle of UART_STM32F1xx.c on the simulated USART and
+ *          DMA.
+ * @version 3.3.3
+ * @date    2024-10-22
+ * @note    Receive: the peer sends bursts of random length and gap, the main
+ *          loop reads the receive fifo of USART1 every millisecond.
+ *          Transmit: every millisecond, if the last transfer has ended, the
+ *          main loop fills the transmit buf with chunks of random length and
+ *          sends it.
+ *
+ *          "cpu" is the modeled CPU load, it counts the HAL calls, the
+ *          interrupt entry and exit and the fifo copies (see `SIM_COST_xxx`),
+ *          not the code of driver. "B/cycle" is the bytes moved per CPU cycle
+ *          charged. "host" is the wall time of host per byte, it includes the
+ *          simulator.
+ */
+
+#include <CSP_Config.h>
+
+#include "sim.h"
+
+#include <stdio.h>
+#include <time.h>
+
+/* Bytes of each run. */
+#define BENCH_BYTES      200000
+/* Period of main loop. Unit: cycle. */
+#define BENCH_POLL       (SIM_HCLK_FREQ / 1000)
+/* Bytes read from the receive fifo each call. */
+#define BENCH_READ_CHUNK 64
+/* Longest burst of peer. */
+#define BENCH_BURST      256
+/* Longest gap between two bursts. Unit: bit. */
+#define BENCH_GAP_BITS   40
+/* Give up the run after the line time of this per byte. Unit: frame. */
+#define BENCH_LIMIT      4
+
+/**
+ * @brief Result of a run.
+ */
+typedef struct {
+    uint32_t bytes;      /*!< Bytes moved.                                  */
+    uint32_t lost;       /*!< Bytes lost, overrun, fifo full or not sent in
+                              time.                                         */
+    uint64_t cycles;     /*!< Simulated time.                               */
+    uint64_t busy;       /*!< CPU cycles charged.                           */
+    uint64_t line_busy;  /*!< Cycles the line is not idle.                  */
+    double host_ns;      /*!< Wall time of host.                            */
+} bench_result_t;
+
+/* State of `bench_random()`. */
+static uint32_t bench_seed;
+
+/**
+ * @brief Get a pseudo random number, the sequence restarts in
+ *        `bench_start()`.
+ *
+ * @return The number.
+ */
+static uint32_t bench_random(void) {
+    bench_seed ^= bench_seed << 13;
+    bench_seed ^= bench_seed >> 17;
+    bench_seed ^= bench_seed << 5;
+    return bench_seed;
+}
+
+/**
+ * @brief Get the wall time of host.
+ *
+ * @return Time. Unit: ns.
+ */
+static double bench_host_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/**
+ * @brief Reset the simulator and initialize USART1.
+ *
+ * @param baud_rate Baud rate.
+ */
+static void bench_start(uint32_t baud_rate) {
+    usart1_deinit();
+
+    sim_reset();
+    bench_seed = 0x2545F491U;
+    if (usart1_init(baud_rate) != UART_INIT_OK) {
+        printf("usart1_init failed\n");
+    }
+}
+
+/**
+ * @brief Print a result.
+ *
+ * @param name Name of run.
+ * @param baud_rate Baud rate.
+ * @param result The result.
+ */
+static void bench_print(const char *name, uint32_t baud_rate,
+                        const bench_result_t *result) {
+    double seconds = (double)result->cycles / SIM_HCLK_FREQ;
+
+    printf("%-3s %7u bps: %7.0f B/s, line %5.1f%%, cpu %5.1f%%, "
+           "%6.4f B/cycle, %6.1f cycles/B, %6u lost, host %5.0f ns/B\n",
+           name, (unsigned)baud_rate, result->bytes / seconds,
+           100.0 * (double)result->line_busy / (double)result->cycles,
+           100.0 * (double)result->busy / (double)result->cycles,
+           (double)result->bytes / (double)result->busy,
+           (double)result->busy / (double)result->bytes,
+           (unsigned)result->lost, result->host_ns / result->bytes);
+}
+
+/**
+ * @brief The peer sends bursts, USART1 receives.
+ *
+ * @param baud_rate Baud rate.
+ * @param[out] result The result.
+ */
+static void bench_rx(uint32_t baud_rate, bench_result_t *result) {
+    bench_start(baud_rate);
+
+    uint64_t start = sim_now();
+    uint64_t busy = sim_busy_cycles();
+    double host = bench_host_ns();
+    uint8_t burst[BENCH_BURST];
+    uint8_t buf[BENCH_READ_CHUNK];
+    uint32_t queued = 0;
+    uint32_t received = 0;
+    uint32_t n;
+
+    while ((queued < BENCH_BYTES) || (sim_uart_peer_pending(0) != 0)) {
+        while ((queued < BENCH_BYTES) &&
+               (sim_uart_peer_pending(0) + BENCH_BURST <=
+                SIM_UART_PEER_QUEUE)) {
+            uint32_t len = 1 + bench_random() % BENCH_BURST;
+            len = (len > BENCH_BYTES - queued) ? BENCH_BYTES - queued : len;
+
+            for (uint32_t i = 0; i < len; ++i) {
+                burst[i] = (uint8_t)(queued + i);
+            }
+            sim_uart_peer_idle(0, bench_random() % (BENCH_GAP_BITS + 1));
+            queued += sim_uart_peer_send(0, burst, len);
+        }
+
+        sim_run(BENCH_POLL);
+        while ((n = uart_dmarx_read(&usart1_handle, buf, sizeof(buf))) != 0) {
+            received += n;
+        }
+    }
+
+    /* The bytes in buf and fifo, IDLE pushes the last ones. */
+    sim_run(BENCH_POLL);
+    while ((n = uart_dmarx_read(&usart1_handle, buf, sizeof(buf))) != 0) {
+        received += n;
+    }
+
+    result->bytes = received;
+    result->lost = BENCH_BYTES - received;
+    result->cycles = sim_now() - start;
+    result->busy = sim_busy_cycles() - busy;
+    result->line_busy = sim_uart_get_stats(0)->rx_busy;
+    result->host_ns = bench_host_ns() - host;
+}
+
+/**
+ * @brief USART1 sends chunks through the transmit buf, the peer receives.
+ *
+ * @param baud_rate Baud rate.
+ * @param[out] result The result.
+ */
+static void bench_tx(uint32_t baud_rate, bench_result_t *result) {
+    bench_start(baud_rate);
+
+    uint64_t limit = (uint64_t)sim_uart_frame_cycles(0) * BENCH_LIMIT *
+                     BENCH_BYTES;
+    uint64_t start = sim_now();
+    uint64_t busy = sim_busy_cycles();
+    double host = bench_host_ns();
+    uint8_t chunk[BENCH_READ_CHUNK];
+    uint8_t buf[BENCH_READ_CHUNK];
+    uint32_t written = 0;
+
+    while ((sim_uart_peer_received(0) < BENCH_BYTES) &&
+           (sim_now() - start < limit)) {
+        /* Fill the buf and send it once the last transfer has ended,
+         * otherwise the main loop does other work. */
+        if ((written < BENCH_BYTES) &&
+            (__HAL_UART_GET_FLAG(&usart1_handle, UART_FLAG_TC) != RESET)) {
+            uint32_t len, n;
+
+            do {
+                len = 1 + bench_random() % BENCH_READ_CHUNK;
+                len = (len > BENCH_BYTES - written) ? BENCH_BYTES - written
+                                                    : len;
+                for (uint32_t i = 0; i < len; ++i) {
+                    chunk[i] = (uint8_t)(written + i);
+                }
+                n = uart_dmatx_write(&usart1_handle, chunk, len);
+                written += n;
+            } while ((n == len) && (written < BENCH_BYTES));
+
+            uart_dmatx_send(&usart1_handle);
+        }
+
+        sim_run(BENCH_POLL);
+
+        /* Keep the log of peer from overflow. */
+        while (sim_uart_peer_recv(0, buf, sizeof(buf)) != 0) {
+        }
+    }
+
+    result->bytes = sim_uart_peer_received(0);
+    result->lost = BENCH_BYTES - result->bytes;
+    result->cycles = sim_now() - start;
+    result->busy = sim_busy_cycles() - busy;
+    result->line_busy =
+        (uint64_t)sim_uart_get_stats(0)->tx_bytes * sim_uart_frame_cycles(0);
+    result->host_ns = bench_host_ns() - host;
+}
+
+int main(void) {
+    static const uint32_t rates[] = {115200, 921600, 4500000};
+    bench_result_t result;
+
+    printf("USART1_RX_DMA_BUF_SIZE %d, USART1_RX_DMA_FIFO_SIZE %d, "
+           "USART1_TX_DMA_BUF_SIZE %d, CSP_DMA_BUF_STATIC %d\n",
+           USART1_RX_DMA_BUF_SIZE, USART1_RX_DMA_FIFO_SIZE,
+           USART1_TX_DMA_BUF_SIZE, CSP_DMA_BUF_STATIC);
+
+    for (uint32_t i = 0; i < sizeof(rates) / sizeof(rates[0]); ++i) {
+        bench_rx(rates[i], &result);
+        bench_print("rx", rates[i], &result);
+        bench_tx(rates[i], &result);
+        bench_print("tx", rates[i], &result);
+    }
+
+    return 0;
+}
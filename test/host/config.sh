@@ -0,0 +1,32 @@
+#!/bin/sh
+#
+# Generate a variant of CSP_Config.h for the host build.
+#
+# Usage: config.sh <CSP_Config.h> <output> [NAME=VALUE]...
+#
+# Every NAME must be defined in CSP_Config.h, the value of the first
+# definition is replaced.
+
+set -e
+
+src=$1
+dst=$2
+shift 2
+
+tmp=$dst.tmp
+cp "$src" "$tmp"
+
+for pair in "$@"; do
+    name=${pair%%=*}
+    value=${pair#*=}
+
+    if ! grep -q "^#define $name[[:space:]]" "$tmp"; then
+        echo "config.sh: $name is not defined in $src" >&2
+        rm -f "$tmp"
+        exit 1
+    fi
+
+    sed -i "0,/^#define $name[[:space:]].*/s//#define $name $value/" "$tmp"
+done
+
+mv "$tmp" "$dst"
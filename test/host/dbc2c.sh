@@ -0,0 +1,303 @@
+#!/bin/sh
+#
+# Generate the signal tables and accessors of CAN_STM32F1xx.h from a DBC
+# file.
+#
+# Usage: dbc2c.sh <input.dbc> <output.h> [prefix]
+#
+# Subset of DBC: the `BO_` and `SG_` lines, the other lines are ignored.
+# Multiplexed signals are not supported. For each message it generates:
+#
+#   <PREFIX>_<MSG>_ID, _IDE, _DLC, _SIGNALS      ID, ID type, length, count
+#   <PREFIX>_<MSG>_<SIG>_GET(word)               raw value from payload word
+#   <PREFIX>_<MSG>_<SIG>_SET(word, raw)          raw value into payload word
+#   <prefix>_<msg>_signals[]                     for can_signal_unpack/pack()
+#   <prefix>_<msg>_unpack(frame, values)         physical values of frame
+#   <prefix>_<msg>_pack(values, frame)           physical values into frame
+#
+# The word is `can_payload_get()` of the byte order of signal, the positions
+# are constant, so each signal is one shift and mask.
+
+set -e
+
+if [ $# -lt 2 ]; then
+    echo "usage: dbc2c.sh <input.dbc> <output.h> [prefix]" >&2
+    exit 1
+fi
+
+src=$1
+dst=$2
+prefix=${3:-dbc}
+tmp=$dst.tmp
+
+awk -v prefix="$prefix" -v src="$src" '
+function fail(msg) {
+    printf("dbc2c.sh: %s:%d: %s\n", src, FNR, msg) > "/dev/stderr"
+    failed = 1
+    exit 1
+}
+
+# Float literal of C.
+function float_c(text) {
+    if (text !~ /[.eE]/) {
+        text = text ".0"
+    }
+    return text "f"
+}
+
+# LSB of signal in the payload word, same as CAN_SIGNAL_xxx_LSB().
+function lsb_of(start, len, motorola) {
+    if (!motorola) {
+        return start
+    }
+    return 56 - (start - start % 8) + start % 8 - len + 1
+}
+
+/^[ \t]*BO_[ \t]/ {
+    line = $0
+    sub(/^[ \t]*BO_[ \t]+/, "", line)
+    if (split(line, f, /[ \t:]+/) < 3) {
+        fail("bad message")
+    }
+
+    ++msgs
+    id = f[1] + 0
+    msg_ext[msgs] = (id >= 2147483648)
+    msg_id[msgs] = msg_ext[msgs] ? id - 2147483648 : id
+    msg_name[msgs] = f[2]
+    msg_dlc[msgs] = f[3]
+    msg_sigs[msgs] = 0
+    next
+}
+
+/^[ \t]*SG_[ \t]/ {
+    if (msgs == 0) {
+        fail("signal out of message")
+    }
+
+    line = $0
+    sub(/^[ \t]*SG_[ \t]+/, "", line)
+    name = line
+    sub(/[ \t].*/, "", name)
+    sub(/^[^ \t]+[ \t]*/, "", line)
+    if (line !~ /^:/) {
+        fail("multiplexed signal " name " is not supported")
+    }
+    sub(/^:[ \t]*/, "", line)
+
+    # start|len@order sign (scale,offset) [min|max] "unit" receivers
+    if (!match(line, /^[0-9]+\|[0-9]+@[01][+-]/)) {
+        fail("bad signal " name)
+    }
+    layout = substr(line, 1, RLENGTH)
+    rest = substr(line, RLENGTH + 1)
+    split(layout, g, /[|@]/)
+    start = g[1] + 0
+    len = g[2] + 0
+    motorola = (substr(g[3], 1, 1) == "0")
+    signed = (substr(g[3], 2, 1) == "-")
+
+    if (!match(rest, /\([^,]+,[^)]+\)/)) {
+        fail("bad factor of signal " name)
+    }
+    factor = substr(rest, RSTART + 1, RLENGTH - 2)
+    split(factor, h, ",")
+
+    lsb = lsb_of(start, len, motorola)
+    if ((len < 1) || (len > 64) || (start > 63) || (lsb < 0) ||
+        (lsb + len > 64)) {
+        fail("signal " name " is out of payload")
+    }
+
+    n = ++msg_sigs[msgs]
+    sig_name[msgs, n] = name
+    sig_start[msgs, n] = start
+    sig_len[msgs, n] = len
+    sig_lsb[msgs, n] = lsb
+    sig_motorola[msgs, n] = motorola
+    sig_signed[msgs, n] = signed
+    sig_scale[msgs, n] = float_c(h[1])
+    sig_offset[msgs, n] = float_c(h[2])
+    sig_text[msgs, n] = layout " (" h[1] "," h[2] ")"
+    next
+}
+
+END {
+    if (failed) {
+        exit 1
+    }
+
+    up = toupper(prefix)
+    get_intel = "can_payload_get(frame, CAN_SIGNAL_INTEL)"
+    get_moto = "can_payload_get(frame, CAN_SIGNAL_MOTOROLA)"
+    stars = "****************************************************************"
+    stars = stars "*************"
+    guard = "__" up "_SIGNALS_H"
+
+    print "/**"
+    print " * @file    " out
+    print " * @brief   Signals of " src ", generated by dbc2c.sh, do not edit."
+    print " */"
+    print ""
+    print "#ifndef " guard
+    print "#define " guard
+    print ""
+    print "#include <CSP_Config.h>"
+    print ""
+    print "/**"
+    print " * @brief Raw value of physical value, rounded to the nearest and"
+    print " *        saturated, same as `can_signal_pack()`."
+    print " */"
+    print "static inline uint64_t " prefix "_raw(float value, float scale,"
+    print "        float offset, uint8_t length, uint8_t is_signed) {"
+    print "    float raw = (value - offset) / scale;"
+    print "    if ((raw > -8388608.0f) && (raw < 8388608.0f)) {"
+    print "        raw += (raw < 0.0f) ? -0.5f : 0.5f;"
+    print "    }"
+    print ""
+    print "    uint64_t mask = CAN_SIGNAL_MASK(length);"
+    print "    if (is_signed) {"
+    print "        int64_t max = (int64_t)(mask >> 1);"
+    print "        if (raw >= (float)max) {"
+    print "            return (uint64_t)max;"
+    print "        }"
+    print "        if (raw <= (float)(-max - 1)) {"
+    print "            return (uint64_t)(-max - 1);"
+    print "        }"
+    print "        return (uint64_t)(int64_t)raw;"
+    print "    }"
+    print ""
+    print "    if (raw >= (float)mask) {"
+    print "        return mask;"
+    print "    }"
+    print "    return (raw <= 0.0f) ? 0 : (uint64_t)raw;"
+    print "}"
+
+    for (m = 1; m <= msgs; ++m) {
+        M = up "_" toupper(msg_name[m])
+        lm = prefix "_" tolower(msg_name[m])
+        count = msg_sigs[m]
+        intel = 0
+        moto = 0
+
+        print ""
+        printf("/%s\n", stars)
+        printf(" * @defgroup %s, ID 0x%X, %d bytes.\n", msg_name[m], msg_id[m],
+               msg_dlc[m])
+        print " * @{"
+        print " */"
+        print ""
+        printf("#define %s_ID      0x%XU\n", M, msg_id[m])
+        printf("#define %s_IDE     %s\n", M,
+               msg_ext[m] ? "CAN_ID_EXT" : "CAN_ID_STD")
+        printf("#define %s_DLC     %d\n", M, msg_dlc[m])
+        printf("#define %s_SIGNALS %d\n", M, count)
+
+        for (i = 1; i <= count; ++i) {
+            S = M "_" toupper(sig_name[m, i])
+            get = sig_signed[m, i] ? "CAN_SIGNAL_GET_SIGNED" : "CAN_SIGNAL_GET"
+            if (sig_motorola[m, i]) {
+                moto = 1
+            } else {
+                intel = 1
+            }
+
+            print ""
+            printf("/* %s: %s */\n", sig_name[m, i], sig_text[m, i])
+            order = sig_motorola[m, i] ? "CAN_SIGNAL_MOTOROLA" : \
+                                         "CAN_SIGNAL_INTEL"
+            printf("#define %s_ORDER  %s\n", S, order)
+            printf("#define %s_SCALE  %s\n", S, sig_scale[m, i])
+            printf("#define %s_OFFSET %s\n", S, sig_offset[m, i])
+            printf("#define %s_GET(word) %s(word, %d, %d)\n", S, get,
+                   sig_lsb[m, i], sig_len[m, i])
+            printf("#define %s_SET(word, raw) \\\n", S)
+            printf("    CAN_SIGNAL_SET(word, %d, %d, raw)\n", sig_lsb[m, i],
+                   sig_len[m, i])
+        }
+
+        print ""
+        printf("static const can_signal_t %s_signals[%s_SIGNALS] = {\n", lm, M)
+        for (i = 1; i <= count; ++i) {
+            S = M "_" toupper(sig_name[m, i])
+            printf("    {%d, %d, %s_ORDER, %d,\n", sig_start[m, i],
+                   sig_len[m, i], S, sig_signed[m, i])
+            printf("     %s_SCALE, %s_OFFSET},\n", S, S)
+        }
+        print "};"
+
+        print ""
+        print "/**"
+        printf(" * @brief Unpack the signals of %s, same as\n", msg_name[m])
+        print " *        `can_signal_unpack()`."
+        print " *"
+        print " * @param frame The frame received."
+        printf(" * @param[out] values The physical values, `%s_SIGNALS`.\n", M)
+        print " */"
+        printf("static inline void %s_unpack(const can_frame_t *frame,\n", lm)
+        print "        float *values) {"
+        if (intel) {
+            printf("    uint64_t intel = %s;\n", get_intel)
+        }
+        if (moto) {
+            printf("    uint64_t motorola = %s;\n", get_moto)
+        }
+        print ""
+        for (i = 1; i <= count; ++i) {
+            S = M "_" toupper(sig_name[m, i])
+            word = sig_motorola[m, i] ? "motorola" : "intel"
+            printf("    values[%d] = (float)%s_GET(%s) *\n", i - 1, S, word)
+            printf("                    %s_SCALE +\n", S)
+            printf("                %s_OFFSET;\n", S)
+        }
+        print "}"
+
+        print ""
+        print "/**"
+        printf(" * @brief Pack the signals of %s, same as\n", msg_name[m])
+        print " *        `can_signal_pack()`."
+        print " *"
+        printf(" * @param values The physical values, `%s_SIGNALS`.\n", M)
+        print " * @param frame The frame to send, the bits not in signals are"
+        print " *              kept."
+        print " */"
+        printf("static inline void %s_pack(const float *values,\n", lm)
+        print "        can_frame_t *frame) {"
+        for (pass = 0; pass < 2; ++pass) {
+            if ((pass == 0) ? !intel : !moto) {
+                continue
+            }
+            if ((pass == 1) && intel) {
+                print ""
+            }
+            order = pass ? "CAN_SIGNAL_MOTOROLA" : "CAN_SIGNAL_INTEL"
+            word = pass ? "motorola" : "intel"
+            printf("    uint64_t %s = %s;\n", word,
+                   pass ? get_moto : get_intel)
+            for (i = 1; i <= count; ++i) {
+                if (sig_motorola[m, i] != pass) {
+                    continue
+                }
+                S = M "_" toupper(sig_name[m, i])
+                printf("    %s_SET(%s, %s_raw(values[%d],\n", S, word, prefix,
+                       i - 1)
+                printf("        %s_SCALE,\n", S)
+                printf("        %s_OFFSET, %d, %d));\n", S, sig_len[m, i],
+                       sig_signed[m, i])
+            }
+            printf("    can_payload_set(frame, %s, %s);\n", order, word)
+        }
+        print "}"
+
+        print ""
+        print "/**"
+        print " * @}"
+        print " */"
+    }
+
+    print ""
+    print "#endif /* " guard " */"
+}
+' out="$(basename "$dst")" "$src" > "$tmp"
+
+mv "$tmp" "$dst"
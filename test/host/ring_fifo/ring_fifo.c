@@ -0,0 +1,113 @@
+/**
+ * @file    ring_fifo.c
+ * @author  Deadline039
+ * @brief   Stand-in of the ring_fifo library for the host build.
+ * @version 3.3.3
+ * @date    2024-10-22
+ * @note    One writer and one reader. A call does its copy at once, then the
+ *          simulator syncs and the time of copy passes, so the registers
+ *          written before the call are seen before the time goes on.
+ */
+
+#include "ring_fifo.h"
+
+#include "sim.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief The fifo, `in` and `out` count the bytes since init.
+ */
+struct ring_fifo {
+    uint8_t *buf;  /*!< Storage.                                            */
+    uint32_t size; /*!< Size of storage, power of 2.                        */
+    uint32_t in;   /*!< Bytes written.                                      */
+    uint32_t out;  /*!< Bytes read.                                         */
+};
+
+/**
+ * @brief Charge the CPU for a call.
+ *
+ * @param len Bytes copied.
+ */
+static void ring_fifo_charge(uint32_t len) {
+    sim_sync();
+    sim_charge(SIM_COST_FIFO_CALL + (len + 3) / 4 * SIM_COST_FIFO_WORD);
+}
+
+/**
+ * @brief Create a fifo on the storage.
+ *
+ * @param buf The storage.
+ * @param size Size of storage, power of 2.
+ * @param type Must be `RF_TYPE_STREAM`.
+ * @return The fifo, NULL if the parameters are wrong or no memory.
+ */
+ring_fifo_t *ring_fifo_init(void *buf, size_t size, rf_type_t type) {
+    if ((buf == NULL) || (size == 0) || (size > UINT32_MAX) ||
+        ((size & (size - 1)) != 0) || (type != RF_TYPE_STREAM)) {
+        return NULL;
+    }
+
+    ring_fifo_t *rf = malloc(sizeof(ring_fifo_t));
+    if (rf == NULL) {
+        return NULL;
+    }
+
+    *rf = (ring_fifo_t){.buf = buf, .size = (uint32_t)size};
+    return rf;
+}
+
+/**
+ * @brief Destroy the fifo, the storage is not freed.
+ *
+ * @param rf The fifo, NULL is ignored.
+ */
+void ring_fifo_destroy(ring_fifo_t *rf) {
+    free(rf);
+}
+
+/**
+ * @brief Write the bytes.
+ *
+ * @param rf The fifo.
+ * @param buf The data.
+ * @param len Length of data.
+ * @return The bytes written, the rest is dropped if the fifo is full.
+ */
+uint32_t ring_fifo_write(ring_fifo_t *rf, const void *buf, uint32_t len) {
+    uint32_t space = rf->size - (rf->in - rf->out);
+    uint32_t count = (len < space) ? len : space;
+    uint32_t pos = rf->in & (rf->size - 1);
+    uint32_t first = (count < rf->size - pos) ? count : (rf->size - pos);
+
+    memcpy(rf->buf + pos, buf, first);
+    memcpy(rf->buf, (const uint8_t *)buf + first, count - first);
+    rf->in += count;
+
+    ring_fifo_charge(count);
+    return count;
+}
+
+/**
+ * @brief Read the bytes.
+ *
+ * @param rf The fifo.
+ * @param[out] buf The buf.
+ * @param len Size of buf.
+ * @return The bytes read.
+ */
+uint32_t ring_fifo_read(ring_fifo_t *rf, void *buf, uint32_t len) {
+    uint32_t used = rf->in - rf->out;
+    uint32_t count = (len < used) ? len : used;
+    uint32_t pos = rf->out & (rf->size - 1);
+    uint32_t first = (count < rf->size - pos) ? count : (rf->size - pos);
+
+    memcpy(buf, rf->buf + pos, first);
+    memcpy((uint8_t *)buf + first, rf->buf, count - first);
+    rf->out += count;
+
+    ring_fifo_charge(count);
+    return count;
+}
@@ -0,0 +1,41 @@
+/**
+ * @file    ring_fifo.h
+ * @author  Deadline039
+ * @brief   Stand-in of the ring_fifo library for the host build.
+ * @version 3.3.3
+ * @date    2024-10-22
+ * @note    Only the stream type used by UART_STM32F1xx.c: the size must be
+ *          power of 2, a write stores what fits and drops the rest. Each call
+ *          charges the CPU for the copy, see `SIM_COST_FIFO_xxx`.
+ */
+
+#ifndef __RING_FIFO_H
+#define __RING_FIFO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+typedef struct ring_fifo ring_fifo_t;
+
+/**
+ * @brief Type of fifo.
+ */
+typedef enum {
+    RF_TYPE_FRAME = 0U, /*!< Frames with length, not supported.             */
+    RF_TYPE_STREAM      /*!< Bytes.                                         */
+} rf_type_t;
+
+ring_fifo_t *ring_fifo_init(void *buf, size_t size, rf_type_t type);
+void ring_fifo_destroy(ring_fifo_t *rf);
+uint32_t ring_fifo_write(ring_fifo_t *rf, const void *buf, uint32_t len);
+uint32_t ring_fifo_read(ring_fifo_t *rf, void *buf, uint32_t len);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __RING_FIFO_H */
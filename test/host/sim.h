@@ -0,0 +1,220 @@
+/**
+ * @file    sim.h
+ * @author  Deadline039
+ * @brief   Simulator of the STM32F1xx peripherals for the host build.
+ * @version 3.3.3
+ * @date    2024-10-22
+ * @note    Time is counted in CPU cycles of `SIM_HCLK_FREQ`. It advances only
+ *          when the CPU is charged (every HAL call, interrupt entry and exit)
+ *          or idles in `sim_run()`, so the results are deterministic. The
+ *          register accesses of the CAN transmit and receive paths are
+ *          charged too, by the counts of the F1 HAL or the fast path of CSP.
+ *
+ *          The registers are plain memory. The models apply the writes of
+ *          the CSP (`TXRQ`, `RFOM`, `CNDTR` etc.) at the sync points: every
+ *          HAL call, `__HAL_UART_GET_FLAG()`, `DWT`, the calls of
+ *          `ring_fifo`, `__set_PRIMASK()`, `__enable_irq()`, `__DMB()` and
+ *          the exit of interrupt. The pending interrupts are taken at the
+ *          same points if `PRIMASK` is clear and the priority is higher than
+ *          the running one, so the interrupt lines are level-sensitive as on
+ *          the chip.
+ */
+
+#ifndef __SIM_H
+#define __SIM_H
+
+#include "stm32f1xx_hal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*****************************************************************************
+ * @defgroup Core of simulator.
+ * @{
+ */
+
+#define SIM_HCLK_FREQ           72000000U
+#define SIM_PCLK1_FREQ          36000000U
+#define SIM_PCLK2_FREQ          72000000U
+
+/* CPU cycles charged, rough numbers of Cortex-M3 at 72 MHz with 2 flash
+ * wait states. */
+#define SIM_COST_HAL_CALL       30  /*!< A HAL function.                   */
+#define SIM_COST_TICK           8   /*!< `HAL_GetTick()`.                  */
+#define SIM_COST_IRQ_ENTRY      12  /*!< Exception entry, stacking.        */
+#define SIM_COST_IRQ_EXIT       10  /*!< Exception return, unstacking.     */
+#define SIM_COST_REG_POLL       4   /*!< `__HAL_UART_GET_FLAG()`, `DWT`.   */
+#define SIM_COST_REG_ACCESS     2   /*!< A load or store of APB1 register,
+                                         charged where a model counts
+                                         them.                             */
+#define SIM_COST_FIFO_CALL      20  /*!< A call of `ring_fifo`.            */
+#define SIM_COST_FIFO_WORD      1   /*!< Every 4 bytes copied by
+                                         `ring_fifo`.                      */
+
+/**
+ * @brief A model of peripheral.
+ */
+typedef struct sim_model {
+    const char *name;            /*!< Name of model.                        */
+    void (*reset)(void);         /*!< Reset to power-on state.              */
+    void (*sync)(void);          /*!< Apply the register writes of CSP.     */
+    uint64_t (*next_event)(void); /*!< Time of the next event, or
+                                       `SIM_NEVER`.                         */
+    void (*event)(uint64_t now); /*!< Process the events due at `now`.      */
+    struct sim_model *next;      /*!< Linked by `sim_model_register()`.     */
+} sim_model_t;
+
+#define SIM_NEVER               UINT64_MAX
+
+void sim_model_register(sim_model_t *model);
+void sim_irq_register(IRQn_Type irqn, void (*handler)(void),
+                      uint8_t (*line)(void *ctx), void *ctx);
+
+void sim_reset(void);
+void sim_sync(void);
+void sim_charge(uint32_t cycles);
+void sim_charge_later(uint32_t cycles);
+void sim_run(uint64_t cycles);
+uint8_t sim_run_until(uint8_t (*done)(void), uint64_t timeout);
+
+uint64_t sim_now(void);
+uint64_t sim_busy_cycles(void);
+uint32_t sim_irq_count(IRQn_Type irqn);
+uint8_t sim_irq_enabled(IRQn_Type irqn);
+
+/**
+ * @}
+ */
+
+/*****************************************************************************
+ * @defgroup bxCAN and virtual bus.
+ * @{
+ */
+
+#define SIM_CAN_BUSES           2   /*!< Independent buses.                 */
+#define SIM_CAN_NODES           8   /*!< Virtual nodes on all buses.        */
+#define SIM_CAN_NODE_QUEUE      256 /*!< Transmit queue of virtual node.    */
+#define SIM_CAN_NODE_LOG        4096 /*!< Receive log of virtual node.      */
+
+/* Register accesses to send or read a frame, charged by
+ * `SIM_COST_REG_ACCESS` each. */
+#define SIM_CAN_HAL_TX_REGS     7   /*!< `HAL_CAN_AddTxMessage()`: `TSR`,
+                                         `TIR`, `TDTR`, `TDHR`, `TDLR` and
+                                         `TXRQ` read-modify-write.          */
+#define SIM_CAN_HAL_RX_REGS     17  /*!< `HAL_CAN_GetRxMessage()`: `RFR`,
+                                         `RIR` and `RDTR` 3 times each, the
+                                         data byte by byte, `RFOM`
+                                         read-modify-write.                 */
+#define SIM_CAN_FAST_TX_REGS    5   /*!< Fast path: `TSR`, `TDTR`, `TDLR`,
+                                         `TDHR` and `TIR`.                  */
+#define SIM_CAN_FAST_RX_REGS    6   /*!< Fast path: `RFR`, `RIR`, `RDTR`,
+                                         `RDLR`, `RDHR` and `RFOM`.         */
+
+/**
+ * @brief Frame on the virtual bus.
+ */
+typedef struct {
+    uint32_t id;         /*!< Standard ID or Extend ID.                     */
+    uint8_t ide;         /*!< `CAN_ID_STD` or `CAN_ID_EXT`.                 */
+    uint8_t rtr;         /*!< `CAN_RTR_DATA` or `CAN_RTR_REMOTE`.           */
+    uint8_t dlc;         /*!< Data length.                                  */
+    uint8_t data[8];     /*!< Data.                                         */
+    uint64_t time;       /*!< End of frame, set when received.              */
+} sim_can_frame_t;
+
+/**
+ * @brief Counters of bus.
+ */
+typedef struct {
+    uint32_t frames;     /*!< Frames transmitted successfully.              */
+    uint32_t errors;     /*!< Error frames.                                 */
+    uint32_t arbitrations; /*!< Arbitrations with more than one node.       */
+    uint64_t bits;       /*!< Bits on bus, include stuff bits and
+                              interframe space.                             */
+    uint64_t busy;       /*!< Cycles the bus is not idle.                   */
+} sim_can_bus_stats_t;
+
+/**
+ * @brief Counters of bxCAN controller.
+ */
+typedef struct {
+    uint32_t tx_frames;  /*!< Frames transmitted successfully.              */
+    uint32_t rx_frames;  /*!< Frames put into FIFO.                         */
+    uint32_t rx_filtered; /*!< Frames rejected by filters.                  */
+    uint32_t rx_overrun; /*!< Frames lost by FIFO overrun.                  */
+    uint32_t lost_arbitration; /*!< Arbitrations lost.                      */
+    uint32_t busy_writes; /*!< Writes to a pending mailbox, ignored.        */
+} sim_can_ctrl_stats_t;
+
+void sim_can_attach(uint32_t ctrl, uint32_t bus);
+void sim_can_bus_set_rate(uint32_t bus, uint32_t bit_rate);
+uint32_t sim_can_bus_bit_cycles(uint32_t bus);
+void sim_can_bus_inject_errors(uint32_t bus, uint32_t count);
+const sim_can_bus_stats_t *sim_can_bus_get_stats(uint32_t bus);
+const sim_can_ctrl_stats_t *sim_can_ctrl_get_stats(uint32_t ctrl);
+uint32_t sim_can_ctrl_bit_rate(uint32_t ctrl);
+uint32_t sim_can_frame_bits(const sim_can_frame_t *frame);
+uint8_t sim_can_filter_match(uint32_t ctrl, const sim_can_frame_t *frame,
+                             uint32_t *fifo, uint32_t *fmi);
+
+int sim_can_node_add(uint32_t bus);
+void sim_can_node_set_ack(int node, uint8_t ack);
+void sim_can_node_set_hook(int node,
+                           void (*hook)(int node,
+                                        const sim_can_frame_t *frame));
+uint8_t sim_can_node_send(int node, const sim_can_frame_t *frame);
+uint32_t sim_can_node_pending(int node);
+uint32_t sim_can_node_received(int node);
+uint8_t sim_can_node_recv(int node, sim_can_frame_t *frame);
+
+/**
+ * @}
+ */
+
+/*****************************************************************************
+ * @defgroup USART, DMA and the peer on the other end of line.
+ * @{
+ */
+
+#define SIM_UART_NUM            5    /*!< USART1, USART2, USART3, UART4 and
+                                          UART5, index 0 ~ 4.               */
+#define SIM_UART_PEER_QUEUE     8192 /*!< Transmit queue of peer.           */
+#define SIM_UART_PEER_LOG       8192 /*!< Receive log of peer.              */
+
+/**
+ * @brief Counters of USART.
+ */
+typedef struct {
+    uint32_t rx_bytes;   /*!< Bytes put into `DR`.                          */
+    uint32_t rx_errors;  /*!< Bytes received with PE, FE or NE.             */
+    uint32_t rx_overrun; /*!< Bytes lost by overrun.                        */
+    uint32_t rx_dropped; /*!< Bytes on line while the receiver is off.      */
+    uint32_t rx_dma;     /*!< Bytes read by DMA.                            */
+    uint32_t idle;       /*!< Times of IDLE flag set.                       */
+    uint32_t tx_bytes;   /*!< Bytes shifted out.                            */
+    uint32_t tx_dma;     /*!< Bytes written by DMA.                         */
+    uint64_t rx_busy;    /*!< Cycles the receive line is not idle.          */
+} sim_uart_stats_t;
+
+uint32_t sim_uart_bit_cycles(uint32_t uart);
+uint32_t sim_uart_frame_cycles(uint32_t uart);
+void sim_uart_set_peer_rate(uint32_t uart, uint32_t baud_rate);
+void sim_uart_set_rx_pin(uint32_t uart, GPIO_TypeDef *port, uint16_t pin);
+uint32_t sim_uart_peer_send(uint32_t uart, const void *data, uint32_t len);
+void sim_uart_peer_idle(uint32_t uart, uint32_t bits);
+void sim_uart_inject_error(uint32_t uart, uint32_t flags);
+uint32_t sim_uart_peer_pending(uint32_t uart);
+uint32_t sim_uart_peer_received(uint32_t uart);
+uint32_t sim_uart_peer_recv(uint32_t uart, void *buf, uint32_t len);
+const sim_uart_stats_t *sim_uart_get_stats(uint32_t uart);
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __SIM_H */
@@ -0,0 +1,2115 @@
+/**
+ * @file    sim_can.c
+ * @author  Deadline039
+ * @brief   Model of two bxCAN controllers and the virtual buses.
+ * @version 3.3.3
+ * @date    2024-10-22
+ * @note    Modeled: transmit mailboxes with identifier or request order
+ *          priority, abort, 3-deep receive FIFOs with overrun and lock mode,
+ *          28 filter banks shared by `CAN2SB`, filter match index, bitwise
+ *          arbitration with other controllers and virtual nodes, frame time
+ *          with stuff bits, acknowledgment, error counters, error states,
+ *          bus-off and recovery, loop back mode and the time stamp of time
+ *          triggered mode.
+ *          Simplified: silent mode only stops transmission, a controller at
+ *          the wrong bit rate neither receives nor acknowledges, and its own
+ *          frames are error frames. Sleep and wake-up are not modeled.
+ */
+
+#include "sim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*****************************************************************************
+ * @defgroup Private macros and types of bxCAN model.
+ * @{
+ */
+
+#define SIM_CAN_CTRLS           2
+#define SIM_CAN_FIFO_DEPTH      3
+#define SIM_CAN_FILTER_BANKS    28
+
+/* Bits of frame after CRC: CRC delimiter, ACK slot, ACK delimiter and
+ * EOF. */
+#define SIM_CAN_TAIL_BITS       10
+/* Interframe space. */
+#define SIM_CAN_IFS_BITS        3
+/* Error flag and error delimiter. */
+#define SIM_CAN_ERROR_BITS      14
+/* Bus-off recovery, 128 occurrences of 11 recessive bits. */
+#define SIM_CAN_RECOVERY_BITS   (128 * 11)
+/* Bit rate tolerance of controller to bus. Unit: 0.1%. */
+#define SIM_CAN_RATE_TOLERANCE  5
+
+/* Last error code. */
+#define SIM_CAN_LEC_NONE        0
+#define SIM_CAN_LEC_STUFF       1
+#define SIM_CAN_LEC_FORM        2
+#define SIM_CAN_LEC_ACK         3
+#define SIM_CAN_LEC_RECESSIVE   4
+#define SIM_CAN_LEC_CRC         6
+
+/* Reset value of registers. */
+#define SIM_CAN_MCR_RESET       0x00010002U
+#define SIM_CAN_MSR_RESET       0x00000C02U
+#define SIM_CAN_BTR_RESET       0x01230000U
+#define SIM_CAN_FMR_RESET       0x2A1C0E01U
+
+/**
+ * @brief State of transmit mailbox.
+ */
+typedef enum {
+    SIM_CAN_MAILBOX_EMPTY = 0U,
+    SIM_CAN_MAILBOX_PENDING,
+    SIM_CAN_MAILBOX_ON_BUS
+} sim_can_mailbox_state_t;
+
+/**
+ * @brief Transmit mailbox, the content is latched when `TXRQ` is set.
+ */
+typedef struct {
+    uint32_t tir;                /*!< Latched `TIR`, `TXRQ` is set.         */
+    uint32_t tdtr;               /*!< Latched `TDTR`.                       */
+    uint32_t tdlr;               /*!< Latched `TDLR`.                       */
+    uint32_t tdhr;               /*!< Latched `TDHR`.                       */
+    uint8_t state;               /*!< `sim_can_mailbox_state_t`.            */
+    uint8_t abort;               /*!< Abort requested on bus.               */
+    uint32_t order;              /*!< Request order, for `TXFP`.            */
+    uint64_t ready;              /*!< Time of request.                      */
+} sim_can_mailbox_t;
+
+/**
+ * @brief Receive FIFO entry, same layout as the output mailbox.
+ */
+typedef struct {
+    uint32_t rir;
+    uint32_t rdtr;
+    uint32_t rdlr;
+    uint32_t rdhr;
+} sim_can_rx_entry_t;
+
+/**
+ * @brief bxCAN controller. The registers with side effect have a shadow,
+ *        the difference to the shadow is the write of CSP.
+ */
+typedef struct {
+    CAN_TypeDef *regs;           /*!< Registers.                            */
+    uint32_t bus;                /*!< The bus attached.                     */
+    uint32_t msr;                /*!< Shadow of `MSR`.                      */
+    uint32_t tsr;                /*!< Shadow of `TSR`.                      */
+    uint32_t rfr[2];             /*!< Shadow of `RF0R` and `RF1R`.          */
+    uint32_t esr;                /*!< Shadow of `ESR`.                      */
+    uint32_t mcr;                /*!< `MCR` seen at last sync.              */
+    sim_can_mailbox_t mailbox[3];
+    sim_can_rx_entry_t fifo[2][SIM_CAN_FIFO_DEPTH];
+    uint8_t fifo_count[2];
+    uint32_t tec;                /*!< Transmit error counter, > 255 is
+                                      bus-off.                              */
+    uint32_t rec;                /*!< Receive error counter.                */
+    uint32_t order;              /*!< Counter of request order.             */
+    uint64_t recover_at;         /*!< End of bus-off recovery.              */
+    sim_can_ctrl_stats_t stats;
+} sim_can_ctrl_t;
+
+/**
+ * @brief Virtual node, always error active.
+ */
+typedef struct {
+    uint8_t used;
+    uint8_t ack;                 /*!< Acknowledge the frames.               */
+    uint32_t bus;
+    sim_can_frame_t queue[SIM_CAN_NODE_QUEUE];
+    uint64_t ready[SIM_CAN_NODE_QUEUE];
+    uint32_t queue_head;
+    uint32_t queue_count;
+    sim_can_frame_t log[SIM_CAN_NODE_LOG];
+    uint32_t log_head;
+    uint32_t log_count;
+    uint32_t received;           /*!< Frames received since reset.          */
+    void (*hook)(int node, const sim_can_frame_t *frame);
+} sim_can_node_t;
+
+/**
+ * @brief Transmitter of frame on bus.
+ */
+typedef struct {
+    int ctrl;                    /*!< Controller, or -1.                    */
+    int node;                    /*!< Virtual node, or -1.                  */
+    uint32_t mailbox;            /*!< Mailbox of controller.                */
+    uint8_t garbled;             /*!< Controller at wrong bit rate.         */
+} sim_can_sender_t;
+
+/**
+ * @brief Virtual bus.
+ */
+typedef struct {
+    uint32_t bit_rate;           /*!< Bit rate. Unit: bps.                  */
+    uint32_t bit_cycles;         /*!< CPU cycles per bit.                   */
+    uint64_t idle_at;            /*!< Bus is idle from this time.           */
+    uint8_t busy;                /*!< A frame is on bus.                    */
+    uint64_t sof;                /*!< Start of frame on bus.                */
+    uint64_t end;                /*!< End of frame on bus.                  */
+    uint32_t bits;               /*!< Bits of frame on bus, to CRC.         */
+    uint8_t acked;               /*!< Frame will be acknowledged.           */
+    uint8_t error;               /*!< Frame will be destroyed.              */
+    sim_can_frame_t frame;       /*!< Frame on bus.                         */
+    sim_can_sender_t sender;     /*!< Transmitter of frame on bus.          */
+    uint32_t inject;             /*!< Frames to destroy.                    */
+    sim_can_bus_stats_t stats;
+} sim_can_bus_t;
+
+/**
+ * @}
+ */
+
+/*****************************************************************************
+ * @defgroup Private variables of bxCAN model.
+ * @{
+ */
+
+CAN_TypeDef sim_can_regs[SIM_CAN_CTRLS];
+
+static sim_can_ctrl_t sim_can_ctrl[SIM_CAN_CTRLS];
+static sim_can_bus_t sim_can_bus[SIM_CAN_BUSES];
+static sim_can_node_t sim_can_node[SIM_CAN_NODES];
+
+/* `HAL_CAN_AddTxMessage()` is loading a mailbox, it charges the register
+ * accesses by itself. */
+static uint8_t sim_can_hal_loading;
+
+/* Handlers of CSP, NULL if the interrupt is not enabled in CSP_Config.h. */
+extern void CAN1_TX_IRQHandler(void) __attribute__((weak));
+extern void CAN1_RX0_IRQHandler(void) __attribute__((weak));
+extern void CAN1_RX1_IRQHandler(void) __attribute__((weak));
+extern void CAN1_SCE_IRQHandler(void) __attribute__((weak));
+extern void CAN2_TX_IRQHandler(void) __attribute__((weak));
+extern void CAN2_RX0_IRQHandler(void) __attribute__((weak));
+extern void CAN2_RX1_IRQHandler(void) __attribute__((weak));
+extern void CAN2_SCE_IRQHandler(void) __attribute__((weak));
+
+/**
+ * @}
+ */
+
+/*****************************************************************************
+ * @defgroup Frame and filters.
+ * @{
+ */
+
+/**
+ * @brief Get the ID word of frame, same layout as `TIR` and `RIR`.
+ *
+ * @param frame The frame.
+ * @return The ID word, `TXRQ` is clear.
+ */
+static uint32_t sim_can_id_word(const sim_can_frame_t *frame) {
+    uint32_t word = (frame->ide == CAN_ID_STD)
+                        ? (frame->id << CAN_TI0R_STID_Pos)
+                        : ((frame->id << CAN_TI0R_EXID_Pos) | CAN_TI0R_IDE);
+
+    return word | (frame->rtr ? CAN_TI0R_RTR : 0);
+}
+
+/**
+ * @brief Get the frame from mailbox registers.
+ *
+ * @param tir ID word.
+ * @param tdtr Length word.
+ * @param tdlr Data low word.
+ * @param tdhr Data high word.
+ * @param[out] frame The frame.
+ */
+static void sim_can_frame_from_regs(uint32_t tir, uint32_t tdtr, uint32_t tdlr,
+                                    uint32_t tdhr, sim_can_frame_t *frame) {
+    frame->ide = (tir & CAN_TI0R_IDE) ? CAN_ID_EXT : CAN_ID_STD;
+    frame->rtr = (tir & CAN_TI0R_RTR) ? CAN_RTR_REMOTE : CAN_RTR_DATA;
+    frame->id = (frame->ide == CAN_ID_STD) ? (tir >> CAN_TI0R_STID_Pos)
+                                           : (tir >> CAN_TI0R_EXID_Pos);
+    frame->dlc = tdtr & CAN_TDT0R_DLC;
+    memcpy(&frame->data[0], &tdlr, 4);
+    memcpy(&frame->data[4], &tdhr, 4);
+}
+
+/**
+ * @brief Get the arbitration field in order of bits on bus, the smaller one
+ *        wins.
+ *
+ * @param frame The frame.
+ * @return Arbitration key.
+ */
+static uint32_t sim_can_arbitration_key(const sim_can_frame_t *frame) {
+    uint32_t rtr = frame->rtr ? 1U : 0;
+
+    if (frame->ide == CAN_ID_STD) {
+        /* STID[10:0] RTR IDE(0) */
+        return (frame->id << 21) | (rtr << 20);
+    }
+
+    /* STID[10:0] SRR(1) IDE(1) EXID[17:0] RTR */
+    return ((frame->id >> 18) << 21) | (1U << 20) | (1U << 19) |
+           ((frame->id & 0x3FFFFU) << 1) | rtr;
+}
+
+/**
+ * @brief Append bits to the stuffed stream, count the stuff bits and
+ *        update CRC.
+ *
+ * @param value The bits, MSB first.
+ * @param count Number of bits.
+ * @param crc CRC-15, NULL when appending the CRC.
+ * @param run Length of current run of same level.
+ * @param last The current level.
+ * @return Number of bits on bus, include the stuff bits.
+ */
+static uint32_t sim_can_stuff(uint32_t value, uint32_t count, uint16_t *crc,
+                              uint32_t *run, uint32_t *last) {
+    uint32_t bits = 0;
+
+    for (uint32_t i = count; i-- > 0;) {
+        uint32_t bit = (value >> i) & 0x01U;
+
+        if (crc != NULL) {
+            uint32_t next = bit ^ ((*crc >> 14) & 0x01U);
+            *crc = (uint16_t)((*crc << 1) & 0x7FFFU);
+            if (next) {
+                *crc ^= 0x4599U;
+            }
+        }
+
+        if (*run == 5) {
+            /* Stuff bit of opposite level. */
+            ++bits;
+            *last ^= 0x01U;
+            *run = 1;
+        }
+
+        if (bit == *last) {
+            ++*run;
+        } else {
+            *last = bit;
+            *run = 1;
+        }
+        ++bits;
+    }
+
+    return bits;
+}
+
+/**
+ * @brief Get bits of frame from SOF to the end of CRC, include the stuff
+ *        bits.
+ *
+ * @param frame The frame.
+ * @return Bits.
+ */
+static uint32_t sim_can_frame_head_bits(const sim_can_frame_t *frame) {
+    uint16_t crc = 0;
+    uint32_t run = 0;
+    uint32_t last = 2;
+    uint32_t rtr = frame->rtr ? 1U : 0;
+    uint32_t dlc = frame->dlc & 0x0FU;
+    uint32_t len = (rtr || (dlc == 0)) ? 0 : ((dlc > 8) ? 8 : dlc);
+    uint32_t bits = 0;
+
+    /* SOF */
+    bits += sim_can_stuff(0, 1, &crc, &run, &last);
+
+    if (frame->ide == CAN_ID_STD) {
+        bits += sim_can_stuff(frame->id & 0x7FFU, 11, &crc, &run, &last);
+        /* RTR, IDE, r0 */
+        bits += sim_can_stuff(rtr << 2, 3, &crc, &run, &last);
+    } else {
+        bits += sim_can_stuff((frame->id >> 18) & 0x7FFU, 11, &crc, &run,
+                              &last);
+        /* SRR, IDE */
+        bits += sim_can_stuff(0x03U, 2, &crc, &run, &last);
+        bits += sim_can_stuff(frame->id & 0x3FFFFU, 18, &crc, &run, &last);
+        /* RTR, r1, r0 */
+        bits += sim_can_stuff(rtr << 2, 3, &crc, &run, &last);
+    }
+
+    bits += sim_can_stuff(dlc, 4, &crc, &run, &last);
+
+    for (uint32_t i = 0; i < len; ++i) {
+        bits += sim_can_stuff(frame->data[i], 8, &crc, &run, &last);
+    }
+
+    bits += sim_can_stuff(crc, 15, NULL, &run, &last);
+
+    return bits;
+}
+
+/**
+ * @brief Get bits of frame on bus, include stuff bits, EOF and interframe
+ *        space.
+ *
+ * @param frame The frame.
+ * @return Bits.
+ */
+uint32_t sim_can_frame_bits(const sim_can_frame_t *frame) {
+    return sim_can_frame_head_bits(frame) + SIM_CAN_TAIL_BITS +
+           SIM_CAN_IFS_BITS;
+}
+
+/**
+ * @brief Match the frame with the filter banks of controller.
+ *
+ * @param ctrl 0: CAN1, 1: CAN2.
+ * @param frame The frame.
+ * @param[out] fifo The FIFO assigned, can be NULL.
+ * @param[out] fmi The filter match index, can be NULL.
+ * @return Return 1 if accepted.
+ * @note The filter registers are in CAN1. Priority of filters: 32-bit
+ *       scale, then list mode, then the lower bank.
+ */
+uint8_t sim_can_filter_match(uint32_t ctrl, const sim_can_frame_t *frame,
+                             uint32_t *fifo, uint32_t *fmi) {
+    const CAN_TypeDef *regs = &sim_can_regs[0];
+    uint32_t slave_start = (regs->FMR & CAN_FMR_CAN2SB) >> CAN_FMR_CAN2SB_Pos;
+    uint32_t first = (ctrl == 0) ? 0 : slave_start;
+    uint32_t last = (ctrl == 0) ? slave_start : SIM_CAN_FILTER_BANKS;
+    uint32_t word = sim_can_id_word(frame);
+    uint32_t exid = (frame->ide == CAN_ID_STD) ? 0 : (frame->id & 0x3FFFFU);
+    uint32_t stid = (frame->ide == CAN_ID_STD) ? frame->id : (frame->id >> 18);
+    /* 16-bit layout: STID[10:0] RTR IDE EXID[17:15] */
+    uint32_t half = (stid << 5) | ((word & CAN_TI0R_RTR) << 3) |
+                    ((word & CAN_TI0R_IDE) << 1) | (exid >> 15);
+    uint32_t number[2] = {0, 0};
+    uint32_t best_rank = 4;
+    uint32_t best_fifo = 0;
+    uint32_t best_fmi = 0;
+
+    if (regs->FMR & CAN_FMR_FINIT) {
+        /* Reception is stopped in filter init mode. */
+        return 0;
+    }
+
+    if (last > SIM_CAN_FILTER_BANKS) {
+        last = SIM_CAN_FILTER_BANKS;
+    }
+
+    for (uint32_t bank = first; bank < last; ++bank) {
+        uint32_t bit = 1U << bank;
+        uint8_t scale32 = (regs->FS1R & bit) != 0;
+        uint8_t list = (regs->FM1R & bit) != 0;
+        uint32_t bank_fifo = (regs->FFA1R & bit) ? 1 : 0;
+        uint32_t slots = scale32 ? (list ? 2 : 1) : (list ? 4 : 2);
+        uint32_t base = number[bank_fifo];
+        uint32_t fr1 = regs->sFilterRegister[bank].FR1;
+        uint32_t fr2 = regs->sFilterRegister[bank].FR2;
+        uint32_t rank = (scale32 ? 0 : 2) + (list ? 0 : 1);
+
+        /* Inactive filters are numbered too. */
+        number[bank_fifo] += slots;
+
+        if (((regs->FA1R & bit) == 0) || (rank >= best_rank)) {
+            continue;
+        }
+
+        for (uint32_t j = 0; j < slots; ++j) {
+            uint8_t hit;
+
+            if (scale32 && list) {
+                hit = (((j == 0) ? fr1 : fr2) & ~0x01U) == word;
+            } else if (scale32) {
+                hit = ((word ^ fr1) & fr2 & ~0x01U) == 0;
+            } else if (list) {
+                uint32_t reg = (j < 2) ? fr1 : fr2;
+                hit = ((j & 0x01U) ? (reg >> 16) : (reg & 0xFFFFU)) == half;
+            } else {
+                uint32_t reg = (j == 0) ? fr1 : fr2;
+                hit = ((half ^ reg) & (reg >> 16) & 0xFFFFU) == 0;
+            }
+
+            if (hit) {
+                best_rank = rank;
+                best_fifo = bank_fifo;
+                best_fmi = base + j;
+                break;
+            }
+        }
+    }
+
+    if (best_rank == 4) {
+        return 0;
+    }
+
+    if (fifo != NULL) {
+        *fifo = best_fifo;
+    }
+    if (fmi != NULL) {
+        *fmi = best_fmi;
+    }
+
+    return 1;
+}
+
+/**
+ * @}
+ */
+
+/*****************************************************************************
+ * @defgroup Controller.
+ * @{
+ */
+
+/**
+ * @brief Get the bit rate of controller from `BTR`.
+ *
+ * @param ctrl 0: CAN1, 1: CAN2.
+ * @return Bit rate. Unit: bps.
+ */
+uint32_t sim_can_ctrl_bit_rate(uint32_t ctrl) {
+    uint32_t btr = sim_can_regs[ctrl].BTR;
+    uint32_t prescale = ((btr & CAN_BTR_BRP) >> CAN_BTR_BRP_Pos) + 1;
+    uint32_t tq = 3 + ((btr & CAN_BTR_TS1) >> CAN_BTR_TS1_Pos) +
+                  ((btr & CAN_BTR_TS2) >> CAN_BTR_TS2_Pos);
+
+    return SIM_PCLK1_FREQ / (prescale * tq);
+}
+
+/**
+ * @brief Whether the controller takes part in the bus.
+ *
+ * @param can The controller.
+ * @return Return 1 if it is in normal mode and not bus-off.
+ */
+static uint8_t sim_can_ctrl_online(const sim_can_ctrl_t *can) {
+    return ((can->regs->MCR & (CAN_MCR_INRQ | CAN_MCR_SLEEP)) == 0) &&
+           ((can->esr & CAN_ESR_BOFF) == 0);
+}
+
+/**
+ * @brief Whether the bit rate of controller is same as bus.
+ *
+ * @param ctrl 0: CAN1, 1: CAN2.
+ * @return Return 1 if the bit rate matches.
+ */
+static uint8_t sim_can_ctrl_rate_ok(uint32_t ctrl) {
+    const sim_can_bus_t *bus = &sim_can_bus[sim_can_ctrl[ctrl].bus];
+    uint64_t rate = sim_can_ctrl_bit_rate(ctrl);
+    uint64_t diff =
+        (rate > bus->bit_rate) ? rate - bus->bit_rate : bus->bit_rate - rate;
+
+    return diff * 1000 <= (uint64_t)bus->bit_rate * SIM_CAN_RATE_TOLERANCE;
+}
+
+/**
+ * @brief Write the shadow registers back, after the writes of CSP are
+ *        applied.
+ *
+ * @param can The controller.
+ */
+static void sim_can_ctrl_publish(sim_can_ctrl_t *can) {
+    CAN_TypeDef *regs = can->regs;
+    uint32_t tsr = can->tsr & ~(CAN_TSR_CODE | CAN_TSR_TME | CAN_TSR_LOW0 |
+                                CAN_TSR_LOW1 | CAN_TSR_LOW2 | CAN_TSR_ABRQ0 |
+                                CAN_TSR_ABRQ1 | CAN_TSR_ABRQ2);
+    uint32_t code = 4;
+    uint32_t pending = 0;
+    uint32_t lowest = 0;
+
+    for (uint32_t i = 0; i < 3; ++i) {
+        const sim_can_mailbox_t *mailbox = &can->mailbox[i];
+
+        if (mailbox->state == SIM_CAN_MAILBOX_EMPTY) {
+            tsr |= CAN_TSR_TME0 << i;
+            code = (code == 4) ? i : code;
+            continue;
+        }
+
+        if (mailbox->abort) {
+            tsr |= CAN_TSR_ABRQ0 << (8 * i);
+        }
+
+        /* The lowest priority: larger ID, or the later request. */
+        if ((pending == 0) ||
+            ((regs->MCR & CAN_MCR_TXFP)
+                 ? (mailbox->order > can->mailbox[lowest].order)
+                 : ((mailbox->tir >> 1) > (can->mailbox[lowest].tir >> 1)))) {
+            lowest = i;
+        }
+        ++pending;
+    }
+
+    if (code == 4) {
+        code = lowest;
+    }
+    if (pending > 1) {
+        tsr |= CAN_TSR_LOW0 << lowest;
+    }
+
+    can->tsr = tsr | (code << CAN_TSR_CODE_Pos);
+    regs->TSR = can->tsr;
+
+    for (uint32_t f = 0; f < 2; ++f) {
+        can->rfr[f] = (can->rfr[f] & (CAN_RF0R_FULL0 | CAN_RF0R_FOVR0)) |
+                      can->fifo_count[f];
+        if (f == 0) {
+            regs->RF0R = can->rfr[0];
+        } else {
+            regs->RF1R = can->rfr[1];
+        }
+
+        if (can->fifo_count[f] != 0) {
+            const sim_can_rx_entry_t *entry = &can->fifo[f][0];
+            regs->sFIFOMailBox[f].RIR = entry->rir;
+            regs->sFIFOMailBox[f].RDTR = entry->rdtr;
+            regs->sFIFOMailBox[f].RDLR = entry->rdlr;
+            regs->sFIFOMailBox[f].RDHR = entry->rdhr;
+        }
+    }
+
+    uint32_t tec = (can->tec > 255) ? 255 : can->tec;
+    can->esr = (can->esr & (CAN_ESR_EWGF | CAN_ESR_EPVF | CAN_ESR_BOFF |
+                            CAN_ESR_LEC)) |
+               (tec << CAN_ESR_TEC_Pos) | (can->rec << CAN_ESR_REC_Pos);
+    regs->ESR = can->esr;
+
+    can->msr = (can->msr & ~(CAN_MSR_INAK | CAN_MSR_SLAK)) |
+               ((regs->MCR & CAN_MCR_INRQ) ? CAN_MSR_INAK : 0) |
+               (((regs->MCR & (CAN_MCR_INRQ | CAN_MCR_SLEEP)) ==
+                 CAN_MCR_SLEEP)
+                    ? CAN_MSR_SLAK
+                    : 0);
+    regs->MSR = can->msr;
+}
+
+/**
+ * @brief Update the error state from the error counters, set `ERRI` if
+ *        the interrupt of the changed flag is enabled.
+ *
+ * @param can The controller.
+ * @param lec Last error code, `SIM_CAN_LEC_NONE` after success.
+ */
+static void sim_can_ctrl_error(sim_can_ctrl_t *can, uint32_t lec) {
+    uint32_t ier = can->regs->IER;
+    uint32_t old = can->esr;
+    uint32_t flags = 0;
+
+    if (can->rec > 127) {
+        /* REC stops counting in error passive. */
+        can->rec = 128;
+    }
+
+    if ((can->tec >= 96) || (can->rec >= 96)) {
+        flags |= CAN_ESR_EWGF;
+    }
+    if ((can->tec > 127) || (can->rec > 127)) {
+        flags |= CAN_ESR_EPVF;
+    }
+    if (can->tec > 255) {
+        flags |= CAN_ESR_BOFF;
+    }
+
+    can->esr = (old & ~(CAN_ESR_EWGF | CAN_ESR_EPVF | CAN_ESR_BOFF |
+                        CAN_ESR_LEC)) |
+               flags | (lec << CAN_ESR_LEC_Pos);
+
+    uint32_t raised = flags & ~old;
+    if (((raised & CAN_ESR_EWGF) && (ier & CAN_IER_EWGIE)) ||
+        ((raised & CAN_ESR_EPVF) && (ier & CAN_IER_EPVIE)) ||
+        ((raised & CAN_ESR_BOFF) && (ier & CAN_IER_BOFIE)) ||
+        ((lec != SIM_CAN_LEC_NONE) && (ier & CAN_IER_LECIE))) {
+        can->msr |= CAN_MSR_ERRI;
+    }
+
+    if ((raised & CAN_ESR_BOFF) && (can->regs->MCR & CAN_MCR_ABOM)) {
+        uint64_t bit_cycles = sim_can_bus[can->bus].bit_cycles;
+        can->recover_at = sim_now() + SIM_CAN_RECOVERY_BITS * bit_cycles;
+    }
+}
+
+/**
+ * @brief Complete the request of mailbox.
+ *
+ * @param can The controller.
+ * @param index Index of mailbox.
+ * @param flags `TXOK0`, `ALST0` or `TERR0`, 0 for abort.
+ */
+static void sim_can_mailbox_done(sim_can_ctrl_t *can, uint32_t index,
+                                 uint32_t flags) {
+    sim_can_mailbox_t *mailbox = &can->mailbox[index];
+    uint32_t shift = 8 * index;
+
+    mailbox->state = SIM_CAN_MAILBOX_EMPTY;
+    mailbox->abort = 0;
+    mailbox->tir &= ~CAN_TI0R_TXRQ;
+    can->regs->sTxMailBox[index].TIR = mailbox->tir;
+    can->regs->sTxMailBox[index].TDTR = mailbox->tdtr;
+
+    can->tsr &= ~((CAN_TSR_TXOK0 | CAN_TSR_ALST0 | CAN_TSR_TERR0) << shift);
+    can->tsr |= (CAN_TSR_RQCP0 | flags) << shift;
+}
+
+/**
+ * @brief Request to abort a mailbox.
+ *
+ * @param can The controller.
+ * @param index Index of mailbox.
+ */
+static void sim_can_mailbox_abort(sim_can_ctrl_t *can, uint32_t index) {
+    sim_can_mailbox_t *mailbox = &can->mailbox[index];
+
+    if (mailbox->state == SIM_CAN_MAILBOX_PENDING) {
+        sim_can_mailbox_done(can, index, 0);
+    } else if (mailbox->state == SIM_CAN_MAILBOX_ON_BUS) {
+        /* Aborted only if the transmission fails. */
+        mailbox->abort = 1;
+    }
+}
+
+/**
+ * @brief Release the output mailbox of FIFO.
+ *
+ * @param can The controller.
+ * @param fifo 0 or 1.
+ */
+static void sim_can_fifo_release(sim_can_ctrl_t *can, uint32_t fifo) {
+    if (can->fifo_count[fifo] == 0) {
+        return;
+    }
+
+    memmove(&can->fifo[fifo][0], &can->fifo[fifo][1],
+            sizeof(sim_can_rx_entry_t) * (SIM_CAN_FIFO_DEPTH - 1));
+    --can->fifo_count[fifo];
+    can->rfr[fifo] &= ~CAN_RF0R_FULL0;
+}
+
+/**
+ * @brief Put a frame into FIFO of controller if the filters accept it.
+ *
+ * @param ctrl 0: CAN1, 1: CAN2.
+ * @param frame The frame.
+ * @param sof Time of SOF.
+ */
+static void sim_can_ctrl_receive(uint32_t ctrl, const sim_can_frame_t *frame,
+                                 uint64_t sof) {
+    sim_can_ctrl_t *can = &sim_can_ctrl[ctrl];
+    uint32_t fifo, fmi;
+
+    if (sim_can_filter_match(ctrl, frame, &fifo, &fmi) == 0) {
+        ++can->stats.rx_filtered;
+        return;
+    }
+
+    uint32_t time = 0;
+    if (can->regs->MCR & CAN_MCR_TTCM) {
+        time = (uint32_t)(sof / sim_can_bus[can->bus].bit_cycles) & 0xFFFFU;
+    }
+
+    sim_can_rx_entry_t entry;
+    entry.rir = sim_can_id_word(frame);
+    entry.rdtr = (frame->dlc & CAN_RDT0R_DLC) | (fmi << CAN_RDT0R_FMI_Pos) |
+                 (time << CAN_RDT0R_TIME_Pos);
+    memcpy(&entry.rdlr, &frame->data[0], 4);
+    memcpy(&entry.rdhr, &frame->data[4], 4);
+
+    if (can->fifo_count[fifo] == SIM_CAN_FIFO_DEPTH) {
+        can->rfr[fifo] |= CAN_RF0R_FOVR0;
+        ++can->stats.rx_overrun;
+        if (can->regs->MCR & CAN_MCR_RFLM) {
+            /* Locked, the new frame is discarded. */
+            return;
+        }
+        /* The last frame is overwritten. */
+        can->fifo[fifo][SIM_CAN_FIFO_DEPTH - 1] = entry;
+        return;
+    }
+
+    can->fifo[fifo][can->fifo_count[fifo]++] = entry;
+    if (can->fifo_count[fifo] == SIM_CAN_FIFO_DEPTH) {
+        can->rfr[fifo] |= CAN_RF0R_FULL0;
+    }
+    ++can->stats.rx_frames;
+}
+
+/**
+ * @brief Reset a controller to the reset value of registers.
+ *
+ * @param ctrl 0: CAN1, 1: CAN2.
+ */
+static void sim_can_ctrl_reset(uint32_t ctrl) {
+    sim_can_ctrl_t *can = &sim_can_ctrl[ctrl];
+    CAN_TypeDef *regs = &sim_can_regs[ctrl];
+    uint32_t bus = can->bus;
+
+    memset(can, 0, sizeof(sim_can_ctrl_t));
+    can->regs = regs;
+    can->bus = bus;
+    can->recover_at = SIM_NEVER;
+
+    /* The filters of CAN1 are kept, they are only reset with CAN1. */
+    regs->MCR = SIM_CAN_MCR_RESET;
+    regs->IER = 0;
+    regs->BTR = SIM_CAN_BTR_RESET;
+    memset((void *)regs->sTxMailBox, 0, sizeof(regs->sTxMailBox));
+    memset((void *)regs->sFIFOMailBox, 0, sizeof(regs->sFIFOMailBox));
+    can->msr = SIM_CAN_MSR_RESET;
+    can->mcr = regs->MCR;
+
+    sim_can_ctrl_publish(can);
+}
+
+/**
+ * @brief Apply the writes of CSP to the registers with side effect.
+ *
+ * @param can The controller.
+ */
+static void sim_can_ctrl_sync(sim_can_ctrl_t *can) {
+    CAN_TypeDef *regs = can->regs;
+
+    if (regs->MCR & CAN_MCR_RESET) {
+        sim_can_ctrl_reset((uint32_t)(can - sim_can_ctrl));
+        return;
+    }
+
+    /* Leaving init mode in bus-off starts the recovery sequence. */
+    if ((can->mcr & CAN_MCR_INRQ) && !(regs->MCR & CAN_MCR_INRQ) &&
+        (can->esr & CAN_ESR_BOFF) && (can->recover_at == SIM_NEVER)) {
+        can->recover_at = sim_now() + SIM_CAN_RECOVERY_BITS *
+                                          sim_can_bus[can->bus].bit_cycles;
+    }
+    can->mcr = regs->MCR;
+
+    uint32_t msr = regs->MSR;
+    if (msr != can->msr) {
+        can->msr &= ~(msr & (CAN_MSR_ERRI | CAN_MSR_WKUI | CAN_MSR_SLAKI));
+    }
+
+    uint32_t tsr = regs->TSR;
+    if (tsr != can->tsr) {
+        for (uint32_t i = 0; i < 3; ++i) {
+            uint32_t shift = 8 * i;
+            if (tsr & (CAN_TSR_RQCP0 << shift)) {
+                can->tsr &= ~((CAN_TSR_RQCP0 | CAN_TSR_TXOK0 | CAN_TSR_ALST0 |
+                               CAN_TSR_TERR0)
+                              << shift);
+            }
+            if (tsr & (CAN_TSR_ABRQ0 << shift)) {
+                sim_can_mailbox_abort(can, i);
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < 3; ++i) {
+        sim_can_mailbox_t *mailbox = &can->mailbox[i];
+        CAN_TxMailBox_TypeDef *tx = &regs->sTxMailBox[i];
+
+        if (mailbox->state == SIM_CAN_MAILBOX_EMPTY) {
+            if ((tx->TIR & CAN_TI0R_TXRQ) == 0) {
+                continue;
+            }
+
+            mailbox->tir = tx->TIR;
+            mailbox->tdtr = tx->TDTR;
+            mailbox->tdlr = tx->TDLR;
+            mailbox->tdhr = tx->TDHR;
+            mailbox->state = SIM_CAN_MAILBOX_PENDING;
+            mailbox->order = ++can->order;
+            mailbox->ready = sim_now();
+            if (!sim_can_hal_loading) {
+                /* Loaded by the fast path of CSP. */
+                sim_charge_later(SIM_CAN_FAST_TX_REGS * SIM_COST_REG_ACCESS);
+            }
+            /* `TXRQ` clears the completed flags. */
+            can->tsr &= ~((CAN_TSR_RQCP0 | CAN_TSR_TXOK0 | CAN_TSR_ALST0 |
+                           CAN_TSR_TERR0)
+                          << (8 * i));
+            continue;
+        }
+
+        /* A pending mailbox is write protected. */
+        if ((tx->TIR != mailbox->tir) || (tx->TDTR != mailbox->tdtr) ||
+            (tx->TDLR != mailbox->tdlr) || (tx->TDHR != mailbox->tdhr)) {
+            ++can->stats.busy_writes;
+            tx->TIR = mailbox->tir;
+            tx->TDTR = mailbox->tdtr;
+            tx->TDLR = mailbox->tdlr;
+            tx->TDHR = mailbox->tdhr;
+        }
+    }
+
+    for (uint32_t f = 0; f < 2; ++f) {
+        uint32_t rfr = (f == 0) ? regs->RF0R : regs->RF1R;
+        if (rfr == can->rfr[f]) {
+            continue;
+        }
+
+        can->rfr[f] &= ~(rfr & (CAN_RF0R_FULL0 | CAN_RF0R_FOVR0));
+        if (rfr & CAN_RF0R_RFOM0) {
+            /* Read and released by the fast path of CSP. */
+            sim_can_fifo_release(can, f);
+            sim_charge_later(SIM_CAN_FAST_RX_REGS * SIM_COST_REG_ACCESS);
+        }
+    }
+
+    uint32_t esr = regs->ESR;
+    if ((esr & CAN_ESR_LEC) != (can->esr & CAN_ESR_LEC)) {
+        can->esr = (can->esr & ~CAN_ESR_LEC) | (esr & CAN_ESR_LEC);
+    }
+
+    sim_can_ctrl_publish(can);
+}
+
+/**
+ * @brief Interrupt lines of controller.
+ *
+ * @param ctx `sim_can_ctrl_t` with the line number in low 2 bits of index,
+ *            see `sim_can_irq_ctx`.
+ * @return Return 1 if the line is active.
+ */
+static uint8_t sim_can_irq_line(void *ctx) {
+    uintptr_t key = (uintptr_t)ctx;
+    const sim_can_ctrl_t *can = &sim_can_ctrl[key >> 2];
+    uint32_t ier = can->regs->IER;
+
+    switch (key & 0x03U) {
+        case 0:
+            return (ier & CAN_IER_TMEIE) &&
+                   (can->tsr &
+                    (CAN_TSR_RQCP0 | CAN_TSR_RQCP1 | CAN_TSR_RQCP2));
+
+        case 1:
+        case 2: {
+            uint32_t f = (key & 0x03U) - 1;
+            uint32_t shift = 3 * f;
+            return ((ier & (CAN_IER_FMPIE0 << shift)) &&
+                    (can->fifo_count[f] != 0)) ||
+                   ((ier & (CAN_IER_FFIE0 << shift)) &&
+                    (can->rfr[f] & CAN_RF0R_FULL0)) ||
+                   ((ier & (CAN_IER_FOVIE0 << shift)) &&
+                    (can->rfr[f] & CAN_RF0R_FOVR0));
+        }
+
+        default:
+            return ((ier & CAN_IER_ERRIE) && (can->msr & CAN_MSR_ERRI)) ||
+                   ((ier & CAN_IER_WKUIE) && (can->msr & CAN_MSR_WKUI)) ||
+                   ((ier & CAN_IER_SLKIE) && (can->msr & CAN_MSR_SLAKI));
+    }
+}
+
+/**
+ * @brief Get the controller of HAL handle.
+ *
+ * @param hcan The handle.
+ * @return The controller.
+ */
+static sim_can_ctrl_t *sim_can_identify(const CAN_HandleTypeDef *hcan) {
+    return &sim_can_ctrl[hcan->Instance - sim_can_regs];
+}
+
+/**
+ * @}
+ */
+
+/*****************************************************************************
+ * @defgroup Bus.
+ * @{
+ */
+
+/**
+ * @brief Find the frames waiting for the bus.
+ *
+ * @param bus_index Index of bus.
+ * @param now Current time.
+ * @param[out] sender The winner of arbitration, can be NULL.
+ * @param[out] frame Frame of winner, can be NULL.
+ * @return Earliest time a frame is ready, `SIM_NEVER` if none.
+ * @note Only the frames ready before `now` take part in arbitration.
+ */
+static uint64_t sim_can_bus_arbitrate(uint32_t bus_index, uint64_t now,
+                                      sim_can_sender_t *sender,
+                                      sim_can_frame_t *frame) {
+    uint64_t ready = SIM_NEVER;
+    /* The keys are 32 bits, a wider sentinel never equals one. */
+    uint64_t best_key = UINT64_MAX;
+    uint32_t contenders = 0;
+    sim_can_sender_t best = {.ctrl = -1, .node = -1};
+    sim_can_frame_t best_frame = {0};
+
+    for (uint32_t c = 0; c < SIM_CAN_CTRLS; ++c) {
+        sim_can_ctrl_t *can = &sim_can_ctrl[c];
+        if ((can->bus != bus_index) || !sim_can_ctrl_online(can) ||
+            (can->regs->BTR & CAN_BTR_SILM)) {
+            continue;
+        }
+
+        /* Priority inside the controller. */
+        int chosen = -1;
+        for (uint32_t i = 0; i < 3; ++i) {
+            const sim_can_mailbox_t *mailbox = &can->mailbox[i];
+            if (mailbox->state != SIM_CAN_MAILBOX_PENDING) {
+                continue;
+            }
+
+            ready = (mailbox->ready < ready) ? mailbox->ready : ready;
+            if (mailbox->ready > now) {
+                continue;
+            }
+
+            if ((chosen < 0) ||
+                ((can->regs->MCR & CAN_MCR_TXFP)
+                     ? (mailbox->order < can->mailbox[chosen].order)
+                     : ((mailbox->tir >> 1) <
+                        (can->mailbox[chosen].tir >> 1)))) {
+                chosen = (int)i;
+            }
+        }
+
+        if (chosen < 0) {
+            continue;
+        }
+
+        const sim_can_mailbox_t *mailbox = &can->mailbox[chosen];
+        sim_can_frame_t candidate;
+        sim_can_frame_from_regs(mailbox->tir, mailbox->tdtr, mailbox->tdlr,
+                                mailbox->tdhr, &candidate);
+
+        ++contenders;
+        if (best.garbled) {
+            continue;
+        }
+
+        if (!sim_can_ctrl_rate_ok(c)) {
+            /* It destroys the bus at once. */
+            best = (sim_can_sender_t){.ctrl = (int)c,
+                                      .node = -1,
+                                      .mailbox = (uint32_t)chosen,
+                                      .garbled = 1};
+            best_frame = candidate;
+            continue;
+        }
+
+        uint64_t key = sim_can_arbitration_key(&candidate);
+        if (key < best_key) {
+            if (best.ctrl >= 0) {
+                ++sim_can_ctrl[best.ctrl].stats.lost_arbitration;
+            }
+            best_key = key;
+            best = (sim_can_sender_t){.ctrl = (int)c,
+                                      .node = -1,
+                                      .mailbox = (uint32_t)chosen};
+            best_frame = candidate;
+        } else {
+            ++can->stats.lost_arbitration;
+        }
+    }
+
+    for (uint32_t n = 0; n < SIM_CAN_NODES; ++n) {
+        sim_can_node_t *node = &sim_can_node[n];
+        if (!node->used || (node->bus != bus_index) ||
+            (node->queue_count == 0)) {
+            continue;
+        }
+
+        uint64_t node_ready = node->ready[node->queue_head];
+        ready = (node_ready < ready) ? node_ready : ready;
+        if (node_ready > now) {
+            continue;
+        }
+
+        const sim_can_frame_t *candidate = &node->queue[node->queue_head];
+        uint64_t key = sim_can_arbitration_key(candidate);
+        ++contenders;
+        if (!best.garbled && (key < best_key)) {
+            if (best.ctrl >= 0) {
+                ++sim_can_ctrl[best.ctrl].stats.lost_arbitration;
+            }
+            best_key = key;
+            best = (sim_can_sender_t){.ctrl = -1, .node = (int)n};
+            best_frame = *candidate;
+        }
+    }
+
+    if (sender != NULL) {
+        *sender = best;
+        if ((contenders > 1) && ((best.ctrl >= 0) || (best.node >= 0))) {
+            ++sim_can_bus[bus_index].stats.arbitrations;
+        }
+    }
+    if (frame != NULL) {
+        *frame = best_frame;
+    }
+
+    return ready;
+}
+
+/**
+ * @brief Whether a frame on bus will be acknowledged.
+ *
+ * @param bus_index Index of bus.
+ * @param sender The transmitter.
+ * @return Return 1 if another node acknowledges it.
+ */
+static uint8_t sim_can_bus_acked(uint32_t bus_index,
+                                 const sim_can_sender_t *sender) {
+    if ((sender->ctrl >= 0) &&
+        (sim_can_regs[sender->ctrl].BTR & CAN_BTR_LBKM)) {
+        /* Loop back mode ignores the acknowledgment. */
+        return 1;
+    }
+
+    for (uint32_t c = 0; c < SIM_CAN_CTRLS; ++c) {
+        const sim_can_ctrl_t *can = &sim_can_ctrl[c];
+        if (((int)c != sender->ctrl) && (can->bus == bus_index) &&
+            sim_can_ctrl_online(can) && sim_can_ctrl_rate_ok(c) &&
+            !(can->regs->BTR & (CAN_BTR_SILM | CAN_BTR_LBKM))) {
+            return 1;
+        }
+    }
+
+    for (uint32_t n = 0; n < SIM_CAN_NODES; ++n) {
+        const sim_can_node_t *node = &sim_can_node[n];
+        if (node->used && node->ack && ((int)n != sender->node) &&
+            (node->bus == bus_index)) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Start a frame on bus, the winner of arbitration.
+ *
+ * @param bus_index Index of bus.
+ * @param now Current time.
+ */
+static void sim_can_bus_start(uint32_t bus_index, uint64_t now) {
+    sim_can_bus_t *bus = &sim_can_bus[bus_index];
+    sim_can_sender_t sender;
+    sim_can_frame_t frame;
+
+    sim_can_bus_arbitrate(bus_index, now, &sender, &frame);
+    if ((sender.ctrl < 0) && (sender.node < 0)) {
+        return;
+    }
+
+    bus->busy = 1;
+    bus->sof = now;
+    bus->sender = sender;
+    bus->frame = frame;
+
+    if (sender.garbled) {
+        bus->bits = SIM_CAN_ERROR_BITS;
+        bus->error = 1;
+        bus->acked = 0;
+        bus->end = now + (uint64_t)(SIM_CAN_ERROR_BITS) * bus->bit_cycles;
+    } else {
+        bus->bits = sim_can_frame_head_bits(&frame);
+        bus->acked = sim_can_bus_acked(bus_index, &sender);
+        bus->error = 0;
+        if (bus->inject != 0) {
+            --bus->inject;
+            bus->error = 1;
+        }
+
+        uint32_t bits = bus->bits + ((bus->error || !bus->acked)
+                                         ? (2 + SIM_CAN_ERROR_BITS)
+                                         : SIM_CAN_TAIL_BITS);
+        bus->end = now + (uint64_t)bits * bus->bit_cycles;
+    }
+
+    if (sender.ctrl >= 0) {
+        sim_can_ctrl_t *can = &sim_can_ctrl[sender.ctrl];
+        sim_can_mailbox_t *mailbox = &can->mailbox[sender.mailbox];
+        mailbox->state = SIM_CAN_MAILBOX_ON_BUS;
+
+        if (can->regs->MCR & CAN_MCR_TTCM) {
+            /* Time stamp at SOF. */
+            uint32_t time = (uint32_t)(now / bus->bit_cycles) & 0xFFFFU;
+            mailbox->tdtr = (mailbox->tdtr & ~CAN_TDT0R_TIME) |
+                            (time << CAN_TDT0R_TIME_Pos);
+            can->regs->sTxMailBox[sender.mailbox].TDTR = mailbox->tdtr;
+        }
+    }
+}
+
+/**
+ * @brief Finish the frame on bus: deliver it, or handle the error.
+ *
+ * @param bus_index Index of bus.
+ */
+static void sim_can_bus_finish(uint32_t bus_index) {
+    sim_can_bus_t *bus = &sim_can_bus[bus_index];
+    sim_can_sender_t *sender = &bus->sender;
+    uint8_t ok = bus->acked && !bus->error;
+    uint32_t bits = (uint32_t)((bus->end - bus->sof) / bus->bit_cycles) +
+                    SIM_CAN_IFS_BITS;
+
+    bus->busy = 0;
+    bus->idle_at = bus->end + (uint64_t)SIM_CAN_IFS_BITS * bus->bit_cycles;
+    bus->stats.bits += bits;
+    bus->stats.busy += (uint64_t)bits * bus->bit_cycles;
+
+    if (sender->ctrl >= 0) {
+        sim_can_ctrl_t *can = &sim_can_ctrl[sender->ctrl];
+        sim_can_mailbox_t *mailbox = &can->mailbox[sender->mailbox];
+        uint8_t passive = can->tec > 127;
+
+        if (ok) {
+            can->tec -= (can->tec > 0) ? 1 : 0;
+            ++can->stats.tx_frames;
+            sim_can_mailbox_done(can, sender->mailbox, CAN_TSR_TXOK0);
+            sim_can_ctrl_error(can, SIM_CAN_LEC_NONE);
+        } else {
+            if (bus->error) {
+                can->tec += 8;
+                sim_can_ctrl_error(can, sender->garbled
+                                            ? SIM_CAN_LEC_FORM
+                                            : SIM_CAN_LEC_RECESSIVE);
+            } else {
+                /* An error passive transmitter keeps the counter on
+                 * acknowledgment error. */
+                can->tec += passive ? 0 : 8;
+                sim_can_ctrl_error(can, SIM_CAN_LEC_ACK);
+            }
+
+            if ((can->regs->MCR & CAN_MCR_NART) || mailbox->abort) {
+                sim_can_mailbox_done(can, sender->mailbox,
+                                     mailbox->abort ? 0 : CAN_TSR_TERR0);
+            } else {
+                mailbox->state = SIM_CAN_MAILBOX_PENDING;
+            }
+        }
+
+        sim_can_ctrl_publish(can);
+    }
+
+    if (!ok) {
+        ++bus->stats.errors;
+
+        if (bus->error) {
+            for (uint32_t c = 0; c < SIM_CAN_CTRLS; ++c) {
+                sim_can_ctrl_t *can = &sim_can_ctrl[c];
+                if (((int)c == sender->ctrl) || (can->bus != bus_index) ||
+                    !sim_can_ctrl_online(can)) {
+                    continue;
+                }
+                ++can->rec;
+                sim_can_ctrl_error(can, sender->garbled ? SIM_CAN_LEC_STUFF
+                                                        : SIM_CAN_LEC_CRC);
+                sim_can_ctrl_publish(can);
+            }
+        }
+        return;
+    }
+
+    ++bus->stats.frames;
+    bus->frame.time = bus->end;
+
+    if (sender->node >= 0) {
+        sim_can_node_t *node = &sim_can_node[sender->node];
+        node->queue_head = (node->queue_head + 1) % SIM_CAN_NODE_QUEUE;
+        --node->queue_count;
+    }
+
+    for (uint32_t c = 0; c < SIM_CAN_CTRLS; ++c) {
+        sim_can_ctrl_t *can = &sim_can_ctrl[c];
+        uint8_t self = ((int)c == sender->ctrl);
+        uint8_t loop_back = (can->regs->BTR & CAN_BTR_LBKM) != 0;
+
+        if ((can->bus != bus_index) || !sim_can_ctrl_online(can) ||
+            (self != loop_back)) {
+            continue;
+        }
+
+        if (!sim_can_ctrl_rate_ok(c)) {
+            /* It sees errors on every frame. */
+            ++can->rec;
+            sim_can_ctrl_error(can, SIM_CAN_LEC_STUFF);
+            sim_can_ctrl_publish(can);
+            continue;
+        }
+
+        if (can->rec > 127) {
+            can->rec = 120;
+        } else if (can->rec > 0) {
+            --can->rec;
+        }
+        sim_can_ctrl_receive(c, &bus->frame, bus->sof);
+        sim_can_ctrl_error(can, SIM_CAN_LEC_NONE);
+        sim_can_ctrl_publish(can);
+    }
+
+    for (uint32_t n = 0; n < SIM_CAN_NODES; ++n) {
+        sim_can_node_t *node = &sim_can_node[n];
+        if (!node->used || (node->bus != bus_index) ||
+            ((int)n == sender->node)) {
+            continue;
+        }
+
+        if (node->log_count == SIM_CAN_NODE_LOG) {
+            /* The oldest frame is dropped. */
+            node->log_head = (node->log_head + 1) % SIM_CAN_NODE_LOG;
+            --node->log_count;
+        }
+        node->log[(node->log_head + node->log_count) % SIM_CAN_NODE_LOG] =
+            bus->frame;
+        ++node->log_count;
+        ++node->received;
+
+        if (node->hook != NULL) {
+            node->hook((int)n, &bus->frame);
+        }
+    }
+}
+
+/**
+ * @}
+ */
+
+/*****************************************************************************
+ * @defgroup Model interface.
+ * @{
+ */
+
+/**
+ * @brief Reset controllers, buses and nodes.
+ *
+ */
+static void sim_can_reset(void) {
+    memset(sim_can_regs, 0, sizeof(sim_can_regs));
+    memset(sim_can_bus, 0, sizeof(sim_can_bus));
+    memset(sim_can_node, 0, sizeof(sim_can_node));
+
+    for (uint32_t b = 0; b < SIM_CAN_BUSES; ++b) {
+        sim_can_bus_set_rate(b, 500000);
+    }
+
+    for (uint32_t c = 0; c < SIM_CAN_CTRLS; ++c) {
+        sim_can_ctrl[c].bus = c % SIM_CAN_BUSES;
+        sim_can_ctrl_reset(c);
+    }
+
+    sim_can_regs[0].FMR = SIM_CAN_FMR_RESET;
+}
+
+/**
+ * @brief Apply the register writes of CSP.
+ *
+ */
+static void sim_can_sync(void) {
+    for (uint32_t c = 0; c < SIM_CAN_CTRLS; ++c) {
+        sim_can_ctrl_sync(&sim_can_ctrl[c]);
+    }
+}
+
+/**
+ * @brief Get the time of next event: end of frame, start of frame or end
+ *        of bus-off recovery.
+ *
+ * @return Time of next event.
+ */
+static uint64_t sim_can_next_event(void) {
+    uint64_t next = SIM_NEVER;
+
+    for (uint32_t b = 0; b < SIM_CAN_BUSES; ++b) {
+        sim_can_bus_t *bus = &sim_can_bus[b];
+        uint64_t time;
+
+        if (bus->busy) {
+            time = bus->end;
+        } else {
+            time = sim_can_bus_arbitrate(b, SIM_NEVER, NULL, NULL);
+            if ((time != SIM_NEVER) && (time < bus->idle_at)) {
+                time = bus->idle_at;
+            }
+        }
+
+        next = (time < next) ? time : next;
+    }
+
+    for (uint32_t c = 0; c < SIM_CAN_CTRLS; ++c) {
+        uint64_t time = sim_can_ctrl[c].recover_at;
+        next = (time < next) ? time : next;
+    }
+
+    return next;
+}
+
+/**
+ * @brief Process the events due.
+ *
+ * @param now Current time.
+ */
+static void sim_can_event(uint64_t now) {
+    for (uint32_t c = 0; c < SIM_CAN_CTRLS; ++c) {
+        sim_can_ctrl_t *can = &sim_can_ctrl[c];
+        if (can->recover_at > now) {
+            continue;
+        }
+
+        can->recover_at = SIM_NEVER;
+        can->tec = 0;
+        can->rec = 0;
+        can->esr &= ~(CAN_ESR_EWGF | CAN_ESR_EPVF | CAN_ESR_BOFF);
+        sim_can_ctrl_publish(can);
+    }
+
+    for (uint32_t b = 0; b < SIM_CAN_BUSES; ++b) {
+        sim_can_bus_t *bus = &sim_can_bus[b];
+
+        if (bus->busy && (bus->end <= now)) {
+            sim_can_bus_finish(b);
+        }
+
+        if (!bus->busy && (bus->idle_at <= now)) {
+            sim_can_bus_start(b, now);
+        }
+    }
+}
+
+static sim_model_t sim_can_model = {
+    .name = "bxCAN",
+    .reset = sim_can_reset,
+    .sync = sim_can_sync,
+    .next_event = sim_can_next_event,
+    .event = sim_can_event,
+};
+
+/**
+ * @brief Register the model and the interrupt sources.
+ *
+ */
+__attribute__((constructor)) static void sim_can_register(void) {
+    static const struct {
+        IRQn_Type irqn;
+        void (*handler)(void);
+    } vectors[SIM_CAN_CTRLS][4] = {
+        {{CAN1_TX_IRQn, CAN1_TX_IRQHandler},
+         {CAN1_RX0_IRQn, CAN1_RX0_IRQHandler},
+         {CAN1_RX1_IRQn, CAN1_RX1_IRQHandler},
+         {CAN1_SCE_IRQn, CAN1_SCE_IRQHandler}},
+        {{CAN2_TX_IRQn, CAN2_TX_IRQHandler},
+         {CAN2_RX0_IRQn, CAN2_RX0_IRQHandler},
+         {CAN2_RX1_IRQn, CAN2_RX1_IRQHandler},
+         {CAN2_SCE_IRQn, CAN2_SCE_IRQHandler}},
+    };
+
+    sim_model_register(&sim_can_model);
+
+    for (uintptr_t c = 0; c < SIM_CAN_CTRLS; ++c) {
+        for (uintptr_t line = 0; line < 4; ++line) {
+            sim_irq_register(vectors[c][line].irqn, vectors[c][line].handler,
+                             sim_can_irq_line, (void *)((c << 2) | line));
+        }
+    }
+
+    sim_can_reset();
+}
+
+/**
+ * @}
+ */
+
+/*****************************************************************************
+ * @defgroup Control of buses and nodes.
+ * @{
+ */
+
+/**
+ * @brief Attach a controller to a bus. By default CAN1 is on bus 0, CAN2
+ *        is on bus 1.
+ *
+ * @param ctrl 0: CAN1, 1: CAN2.
+ * @param bus Index of bus.
+ */
+void sim_can_attach(uint32_t ctrl, uint32_t bus) {
+    sim_can_ctrl[ctrl].bus = bus;
+}
+
+/**
+ * @brief Set the bit rate of bus, 500 kbps after reset.
+ *
+ * @param bus Index of bus.
+ * @param bit_rate Bit rate. Unit: bps.
+ */
+void sim_can_bus_set_rate(uint32_t bus, uint32_t bit_rate) {
+    sim_can_bus[bus].bit_rate = bit_rate;
+    sim_can_bus[bus].bit_cycles = (SIM_HCLK_FREQ + bit_rate / 2) / bit_rate;
+}
+
+/**
+ * @brief Get the CPU cycles of one bit on bus.
+ *
+ * @param bus Index of bus.
+ * @return Cycles.
+ */
+uint32_t sim_can_bus_bit_cycles(uint32_t bus) {
+    return sim_can_bus[bus].bit_cycles;
+}
+
+/**
+ * @brief Destroy the next frames on bus by error frame, the transmitters
+ *        retry.
+ *
+ * @param bus Index of bus.
+ * @param count Number of frames.
+ */
+void sim_can_bus_inject_errors(uint32_t bus, uint32_t count) {
+    sim_can_bus[bus].inject += count;
+}
+
+/**
+ * @brief Get the counters of bus.
+ *
+ * @param bus Index of bus.
+ * @return The counters.
+ */
+const sim_can_bus_stats_t *sim_can_bus_get_stats(uint32_t bus) {
+    return &sim_can_bus[bus].stats;
+}
+
+/**
+ * @brief Get the counters of controller.
+ *
+ * @param ctrl 0: CAN1, 1: CAN2.
+ * @return The counters.
+ */
+const sim_can_ctrl_stats_t *sim_can_ctrl_get_stats(uint32_t ctrl) {
+    return &sim_can_ctrl[ctrl].stats;
+}
+
+/**
+ * @brief Add a virtual node, it acknowledges the frames by default.
+ *
+ * @param bus Index of bus.
+ * @return Index of node, -1 if no free node.
+ */
+int sim_can_node_add(uint32_t bus) {
+    for (int n = 0; n < SIM_CAN_NODES; ++n) {
+        if (sim_can_node[n].used == 0) {
+            memset(&sim_can_node[n], 0, sizeof(sim_can_node_t));
+            sim_can_node[n].used = 1;
+            sim_can_node[n].ack = 1;
+            sim_can_node[n].bus = bus;
+            return n;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Enable or disable the acknowledgment of node.
+ *
+ * @param node Index of node.
+ * @param ack 0: Never acknowledge, 1: Acknowledge.
+ */
+void sim_can_node_set_ack(int node, uint8_t ack) {
+    sim_can_node[node].ack = ack;
+}
+
+/**
+ * @brief Set the hook called for every frame received by node.
+ *
+ * @param node Index of node.
+ * @param hook The hook, NULL to remove.
+ * @note The hook is called at the end of frame, it can send frames.
+ */
+void sim_can_node_set_hook(int node,
+                           void (*hook)(int node,
+                                        const sim_can_frame_t *frame)) {
+    sim_can_node[node].hook = hook;
+}
+
+/**
+ * @brief Queue a frame to send, frames of one node are sent in order.
+ *
+ * @param node Index of node.
+ * @param frame The frame.
+ * @return Return 0 if queued, 2 if the queue is full.
+ */
+uint8_t sim_can_node_send(int node, const sim_can_frame_t *frame) {
+    sim_can_node_t *vnode = &sim_can_node[node];
+
+    if (vnode->queue_count == SIM_CAN_NODE_QUEUE) {
+        return 2;
+    }
+
+    uint32_t tail = (vnode->queue_head + vnode->queue_count) %
+                    SIM_CAN_NODE_QUEUE;
+    vnode->queue[tail] = *frame;
+    vnode->ready[tail] = sim_now();
+    ++vnode->queue_count;
+
+    return 0;
+}
+
+/**
+ * @brief Get the frames waiting to send.
+ *
+ * @param node Index of node.
+ * @return Number of frames.
+ */
+uint32_t sim_can_node_pending(int node) {
+    return sim_can_node[node].queue_count;
+}
+
+/**
+ * @brief Get the frames received since the node is added.
+ *
+ * @param node Index of node.
+ * @return Number of frames.
+ */
+uint32_t sim_can_node_received(int node) {
+    return sim_can_node[node].received;
+}
+
+/**
+ * @brief Get the oldest frame in the receive log of node.
+ *
+ * @param node Index of node.
+ * @param[out] frame The frame.
+ * @return Return 1 if a frame is got, 0 if the log is empty.
+ */
+uint8_t sim_can_node_recv(int node, sim_can_frame_t *frame) {
+    sim_can_node_t *vnode = &sim_can_node[node];
+
+    if (vnode->log_count == 0) {
+        return 0;
+    }
+
+    *frame = vnode->log[vnode->log_head];
+    vnode->log_head = (vnode->log_head + 1) % SIM_CAN_NODE_LOG;
+    --vnode->log_count;
+
+    return 1;
+}
+
+/**
+ * @}
+ */
+
+/*****************************************************************************
+ * @defgroup HAL of bxCAN.
+ * @{
+ */
+
+/**
+ * @brief Charge a HAL call and apply the pending writes.
+ *
+ */
+static void sim_can_hal_enter(void) {
+    sim_charge(SIM_COST_HAL_CALL);
+    sim_sync();
+}
+
+HAL_StatusTypeDef HAL_CAN_Init(CAN_HandleTypeDef *hcan) {
+    if (hcan == NULL) {
+        return HAL_ERROR;
+    }
+
+    sim_can_hal_enter();
+
+    if (hcan->State == HAL_CAN_STATE_RESET) {
+        HAL_CAN_MspInit(hcan);
+    }
+
+    CAN_TypeDef *regs = hcan->Instance;
+    const CAN_InitTypeDef *init = &hcan->Init;
+
+    regs->MCR = (regs->MCR & ~CAN_MCR_SLEEP) | CAN_MCR_INRQ;
+    sim_sync();
+
+    uint32_t mcr = CAN_MCR_INRQ;
+    mcr |= (init->TimeTriggeredMode == ENABLE) ? CAN_MCR_TTCM : 0;
+    mcr |= (init->AutoBusOff == ENABLE) ? CAN_MCR_ABOM : 0;
+    mcr |= (init->AutoWakeUp == ENABLE) ? CAN_MCR_AWUM : 0;
+    mcr |= (init->AutoRetransmission == ENABLE) ? 0 : CAN_MCR_NART;
+    mcr |= (init->ReceiveFifoLocked == ENABLE) ? CAN_MCR_RFLM : 0;
+    mcr |= (init->TransmitFifoPriority == ENABLE) ? CAN_MCR_TXFP : 0;
+    regs->MCR = mcr | (regs->MCR & CAN_MCR_DBF);
+
+    regs->BTR = init->Mode | init->SyncJumpWidth | init->TimeSeg1 |
+                init->TimeSeg2 | (init->Prescaler - 1U);
+
+    hcan->ErrorCode = HAL_CAN_ERROR_NONE;
+    hcan->State = HAL_CAN_STATE_READY;
+    sim_sync();
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CAN_DeInit(CAN_HandleTypeDef *hcan) {
+    if (hcan == NULL) {
+        return HAL_ERROR;
+    }
+
+    HAL_CAN_Stop(hcan);
+    HAL_CAN_MspDeInit(hcan);
+
+    hcan->Instance->MCR |= CAN_MCR_RESET;
+    sim_sync();
+
+    hcan->ErrorCode = HAL_CAN_ERROR_NONE;
+    hcan->State = HAL_CAN_STATE_RESET;
+
+    return HAL_OK;
+}
+
+__attribute__((weak)) void HAL_CAN_MspInit(CAN_HandleTypeDef *hcan) {
+    UNUSED(hcan);
+}
+
+__attribute__((weak)) void HAL_CAN_MspDeInit(CAN_HandleTypeDef *hcan) {
+    UNUSED(hcan);
+}
+
+HAL_StatusTypeDef HAL_CAN_ConfigFilter(CAN_HandleTypeDef *hcan,
+                                       const CAN_FilterTypeDef *filter) {
+    sim_can_hal_enter();
+
+    if ((hcan->State != HAL_CAN_STATE_READY) &&
+        (hcan->State != HAL_CAN_STATE_LISTENING)) {
+        hcan->ErrorCode |= HAL_CAN_ERROR_NOT_INITIALIZED;
+        return HAL_ERROR;
+    }
+
+    /* The filter banks are in CAN1. */
+    CAN_TypeDef *regs = CAN1;
+    uint32_t bit = 1U << (filter->FilterBank & 0x1FU);
+    CAN_FilterRegister_TypeDef *bank =
+        &regs->sFilterRegister[filter->FilterBank & 0x1FU];
+
+    regs->FMR |= CAN_FMR_FINIT;
+    regs->FMR = (regs->FMR & ~CAN_FMR_CAN2SB) |
+                (filter->SlaveStartFilterBank << CAN_FMR_CAN2SB_Pos);
+    regs->FA1R &= ~bit;
+
+    if (filter->FilterScale == CAN_FILTERSCALE_16BIT) {
+        regs->FS1R &= ~bit;
+        bank->FR1 = ((filter->FilterMaskIdLow & 0xFFFFU) << 16) |
+                    (filter->FilterIdLow & 0xFFFFU);
+        bank->FR2 = ((filter->FilterMaskIdHigh & 0xFFFFU) << 16) |
+                    (filter->FilterIdHigh & 0xFFFFU);
+    } else {
+        regs->FS1R |= bit;
+        bank->FR1 = ((filter->FilterIdHigh & 0xFFFFU) << 16) |
+                    (filter->FilterIdLow & 0xFFFFU);
+        bank->FR2 = ((filter->FilterMaskIdHigh & 0xFFFFU) << 16) |
+                    (filter->FilterMaskIdLow & 0xFFFFU);
+    }
+
+    if (filter->FilterMode == CAN_FILTERMODE_IDMASK) {
+        regs->FM1R &= ~bit;
+    } else {
+        regs->FM1R |= bit;
+    }
+
+    if (filter->FilterFIFOAssignment == CAN_FILTER_FIFO0) {
+        regs->FFA1R &= ~bit;
+    } else {
+        regs->FFA1R |= bit;
+    }
+
+    if (filter->FilterActivation == CAN_FILTER_ENABLE) {
+        regs->FA1R |= bit;
+    }
+
+    regs->FMR &= ~CAN_FMR_FINIT;
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CAN_Start(CAN_HandleTypeDef *hcan) {
+    sim_can_hal_enter();
+
+    if (hcan->State != HAL_CAN_STATE_READY) {
+        hcan->ErrorCode |= HAL_CAN_ERROR_NOT_READY;
+        return HAL_ERROR;
+    }
+
+    hcan->State = HAL_CAN_STATE_LISTENING;
+    hcan->Instance->MCR &= ~CAN_MCR_INRQ;
+    hcan->ErrorCode = HAL_CAN_ERROR_NONE;
+    sim_sync();
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CAN_Stop(CAN_HandleTypeDef *hcan) {
+    sim_can_hal_enter();
+
+    if (hcan->State != HAL_CAN_STATE_LISTENING) {
+        hcan->ErrorCode |= HAL_CAN_ERROR_NOT_STARTED;
+        return HAL_ERROR;
+    }
+
+    hcan->Instance->MCR |= CAN_MCR_INRQ;
+    hcan->Instance->MCR &= ~CAN_MCR_SLEEP;
+    hcan->State = HAL_CAN_STATE_READY;
+    sim_sync();
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CAN_AddTxMessage(CAN_HandleTypeDef *hcan,
+                                       const CAN_TxHeaderTypeDef *header,
+                                       const uint8_t data[],
+                                       uint32_t *mailbox) {
+    sim_can_hal_enter();
+
+    if ((hcan->State != HAL_CAN_STATE_READY) &&
+        (hcan->State != HAL_CAN_STATE_LISTENING)) {
+        hcan->ErrorCode |= HAL_CAN_ERROR_NOT_INITIALIZED;
+        return HAL_ERROR;
+    }
+
+    CAN_TypeDef *regs = hcan->Instance;
+    uint32_t tsr = regs->TSR;
+
+    if ((tsr & CAN_TSR_TME) == 0) {
+        hcan->ErrorCode |= HAL_CAN_ERROR_PARAM;
+        return HAL_ERROR;
+    }
+
+    uint32_t index = (tsr & CAN_TSR_CODE) >> CAN_TSR_CODE_Pos;
+    CAN_TxMailBox_TypeDef *tx = &regs->sTxMailBox[index];
+
+    *mailbox = 1U << index;
+    sim_charge(SIM_CAN_HAL_TX_REGS * SIM_COST_REG_ACCESS);
+
+    if (header->IDE == CAN_ID_STD) {
+        tx->TIR = (header->StdId << CAN_TI0R_STID_Pos) | header->RTR;
+    } else {
+        tx->TIR = (header->ExtId << CAN_TI0R_EXID_Pos) | header->IDE |
+                  header->RTR;
+    }
+    tx->TDTR = header->DLC;
+    if (header->TransmitGlobalTime == ENABLE) {
+        tx->TDTR |= CAN_TDT0R_TGT;
+    }
+    tx->TDHR = ((uint32_t)data[7] << 24) | ((uint32_t)data[6] << 16) |
+               ((uint32_t)data[5] << 8) | (uint32_t)data[4];
+    tx->TDLR = ((uint32_t)data[3] << 24) | ((uint32_t)data[2] << 16) |
+               ((uint32_t)data[1] << 8) | (uint32_t)data[0];
+    tx->TIR |= CAN_TI0R_TXRQ;
+    sim_can_hal_loading = 1;
+    sim_sync();
+    sim_can_hal_loading = 0;
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CAN_AbortTxRequest(CAN_HandleTypeDef *hcan,
+                                         uint32_t mailboxes) {
+    sim_can_hal_enter();
+
+    if ((hcan->State != HAL_CAN_STATE_READY) &&
+        (hcan->State != HAL_CAN_STATE_LISTENING)) {
+        hcan->ErrorCode |= HAL_CAN_ERROR_NOT_INITIALIZED;
+        return HAL_ERROR;
+    }
+
+    sim_can_ctrl_t *can = sim_can_identify(hcan);
+    for (uint32_t i = 0; i < 3; ++i) {
+        if (mailboxes & (1U << i)) {
+            sim_can_mailbox_abort(can, i);
+        }
+    }
+    sim_can_ctrl_publish(can);
+    sim_sync();
+
+    return HAL_OK;
+}
+
+uint32_t HAL_CAN_GetTxMailboxesFreeLevel(const CAN_HandleTypeDef *hcan) {
+    sim_can_hal_enter();
+
+    if ((hcan->State != HAL_CAN_STATE_READY) &&
+        (hcan->State != HAL_CAN_STATE_LISTENING)) {
+        return 0;
+    }
+
+    uint32_t tsr = hcan->Instance->TSR;
+    return ((tsr & CAN_TSR_TME0) != 0) + ((tsr & CAN_TSR_TME1) != 0) +
+           ((tsr & CAN_TSR_TME2) != 0);
+}
+
+uint32_t HAL_CAN_IsTxMessagePending(const CAN_HandleTypeDef *hcan,
+                                    uint32_t mailboxes) {
+    sim_can_hal_enter();
+
+    uint32_t tme = (mailboxes & 0x07U) << CAN_TSR_TME_Pos;
+    return (hcan->Instance->TSR & tme) != tme;
+}
+
+uint32_t HAL_CAN_GetTxTimestamp(const CAN_HandleTypeDef *hcan,
+                                uint32_t mailbox) {
+    sim_can_hal_enter();
+
+    uint32_t index = (mailbox == CAN_TX_MAILBOX0)   ? 0
+                     : (mailbox == CAN_TX_MAILBOX1) ? 1
+                                                    : 2;
+    return (hcan->Instance->sTxMailBox[index].TDTR & CAN_TDT0R_TIME) >>
+           CAN_TDT0R_TIME_Pos;
+}
+
+HAL_StatusTypeDef HAL_CAN_GetRxMessage(CAN_HandleTypeDef *hcan,
+                                       uint32_t fifo,
+                                       CAN_RxHeaderTypeDef *header,
+                                       uint8_t data[]) {
+    sim_can_hal_enter();
+
+    if ((hcan->State != HAL_CAN_STATE_READY) &&
+        (hcan->State != HAL_CAN_STATE_LISTENING)) {
+        hcan->ErrorCode |= HAL_CAN_ERROR_NOT_INITIALIZED;
+        return HAL_ERROR;
+    }
+
+    sim_can_ctrl_t *can = sim_can_identify(hcan);
+    if (can->fifo_count[fifo] == 0) {
+        hcan->ErrorCode |= HAL_CAN_ERROR_PARAM;
+        return HAL_ERROR;
+    }
+
+    sim_charge(SIM_CAN_HAL_RX_REGS * SIM_COST_REG_ACCESS);
+
+    const CAN_FIFOMailBox_TypeDef *rx = &hcan->Instance->sFIFOMailBox[fifo];
+    uint32_t rir = rx->RIR;
+    uint32_t rdtr = rx->RDTR;
+    uint32_t rdlr = rx->RDLR;
+    uint32_t rdhr = rx->RDHR;
+
+    header->IDE = rir & CAN_RI0R_IDE;
+    header->StdId = rir >> CAN_RI0R_STID_Pos;
+    header->ExtId = rir >> CAN_RI0R_EXID_Pos;
+    header->RTR = rir & CAN_RI0R_RTR;
+    header->DLC = rdtr & CAN_RDT0R_DLC;
+    header->FilterMatchIndex = (rdtr & CAN_RDT0R_FMI) >> CAN_RDT0R_FMI_Pos;
+    header->Timestamp = (rdtr & CAN_RDT0R_TIME) >> CAN_RDT0R_TIME_Pos;
+    memcpy(&data[0], &rdlr, 4);
+    memcpy(&data[4], &rdhr, 4);
+
+    sim_can_fifo_release(can, fifo);
+    sim_can_ctrl_publish(can);
+    sim_sync();
+
+    return HAL_OK;
+}
+
+uint32_t HAL_CAN_GetRxFifoFillLevel(const CAN_HandleTypeDef *hcan,
+                                    uint32_t fifo) {
+    sim_can_hal_enter();
+
+    return sim_can_identify(hcan)->fifo_count[fifo];
+}
+
+HAL_StatusTypeDef HAL_CAN_ActivateNotification(CAN_HandleTypeDef *hcan,
+                                               uint32_t its) {
+    sim_can_hal_enter();
+
+    if ((hcan->State != HAL_CAN_STATE_READY) &&
+        (hcan->State != HAL_CAN_STATE_LISTENING)) {
+        hcan->ErrorCode |= HAL_CAN_ERROR_NOT_INITIALIZED;
+        return HAL_ERROR;
+    }
+
+    hcan->Instance->IER |= its;
+    sim_sync();
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CAN_DeactivateNotification(CAN_HandleTypeDef *hcan,
+                                                 uint32_t its) {
+    sim_can_hal_enter();
+
+    if ((hcan->State != HAL_CAN_STATE_READY) &&
+        (hcan->State != HAL_CAN_STATE_LISTENING)) {
+        hcan->ErrorCode |= HAL_CAN_ERROR_NOT_INITIALIZED;
+        return HAL_ERROR;
+    }
+
+    hcan->Instance->IER &= ~its;
+
+    return HAL_OK;
+}
+
+/**
+ * @brief Same flow as the HAL: transmit mailboxes, FIFOs, then errors.
+ *
+ * @param hcan The handle.
+ */
+void HAL_CAN_IRQHandler(CAN_HandleTypeDef *hcan) {
+    static void (*const complete[3])(CAN_HandleTypeDef *) = {
+        HAL_CAN_TxMailbox0CompleteCallback, HAL_CAN_TxMailbox1CompleteCallback,
+        HAL_CAN_TxMailbox2CompleteCallback};
+    static void (*const aborted[3])(CAN_HandleTypeDef *) = {
+        HAL_CAN_TxMailbox0AbortCallback, HAL_CAN_TxMailbox1AbortCallback,
+        HAL_CAN_TxMailbox2AbortCallback};
+
+    sim_can_hal_enter();
+
+    sim_can_ctrl_t *can = sim_can_identify(hcan);
+    uint32_t ier = hcan->Instance->IER;
+    uint32_t error = HAL_CAN_ERROR_NONE;
+
+    if (ier & CAN_IT_TX_MAILBOX_EMPTY) {
+        for (uint32_t i = 0; i < 3; ++i) {
+            uint32_t shift = 8 * i;
+            uint32_t tsr = can->tsr;
+
+            if ((tsr & (CAN_TSR_RQCP0 << shift)) == 0) {
+                continue;
+            }
+
+            can->tsr &= ~((CAN_TSR_RQCP0 | CAN_TSR_TXOK0 | CAN_TSR_ALST0 |
+                           CAN_TSR_TERR0)
+                          << shift);
+            sim_can_ctrl_publish(can);
+
+            if (tsr & (CAN_TSR_TXOK0 << shift)) {
+                complete[i](hcan);
+            } else if (tsr & (CAN_TSR_ALST0 << shift)) {
+                error |= HAL_CAN_ERROR_TX_ALST0 << (2 * i);
+            } else if (tsr & (CAN_TSR_TERR0 << shift)) {
+                error |= HAL_CAN_ERROR_TX_TERR0 << (2 * i);
+            } else {
+                aborted[i](hcan);
+            }
+        }
+    }
+
+    for (uint32_t f = 0; f < 2; ++f) {
+        uint32_t shift = 3 * f;
+
+        if ((ier & (CAN_IT_RX_FIFO0_OVERRUN << shift)) &&
+            (can->rfr[f] & CAN_RF0R_FOVR0)) {
+            error |= HAL_CAN_ERROR_RX_FOV0 << f;
+            can->rfr[f] &= ~CAN_RF0R_FOVR0;
+            sim_can_ctrl_publish(can);
+        }
+
+        if ((ier & (CAN_IT_RX_FIFO0_FULL << shift)) &&
+            (can->rfr[f] & CAN_RF0R_FULL0)) {
+            can->rfr[f] &= ~CAN_RF0R_FULL0;
+            sim_can_ctrl_publish(can);
+            if (f == 0) {
+                HAL_CAN_RxFifo0FullCallback(hcan);
+            } else {
+                HAL_CAN_RxFifo1FullCallback(hcan);
+            }
+        }
+
+        if ((ier & (CAN_IT_RX_FIFO0_MSG_PENDING << shift)) &&
+            (can->fifo_count[f] != 0)) {
+            if (f == 0) {
+                HAL_CAN_RxFifo0MsgPendingCallback(hcan);
+            } else {
+                HAL_CAN_RxFifo1MsgPendingCallback(hcan);
+            }
+        }
+    }
+
+    if ((ier & CAN_IT_ERROR) && (can->msr & CAN_MSR_ERRI)) {
+        uint32_t esr = can->esr;
+
+        if ((ier & CAN_IT_ERROR_WARNING) && (esr & CAN_ESR_EWGF)) {
+            error |= HAL_CAN_ERROR_EWG;
+        }
+        if ((ier & CAN_IT_ERROR_PASSIVE) && (esr & CAN_ESR_EPVF)) {
+            error |= HAL_CAN_ERROR_EPV;
+        }
+        if ((ier & CAN_IT_BUSOFF) && (esr & CAN_ESR_BOFF)) {
+            error |= HAL_CAN_ERROR_BOF;
+        }
+        if ((ier & CAN_IT_LAST_ERROR_CODE) && (esr & CAN_ESR_LEC)) {
+            static const uint32_t lec_error[8] = {
+                0,
+                HAL_CAN_ERROR_STF,
+                HAL_CAN_ERROR_FOR,
+                HAL_CAN_ERROR_ACK,
+                HAL_CAN_ERROR_BR,
+                HAL_CAN_ERROR_BD,
+                HAL_CAN_ERROR_CRC,
+                0};
+            error |= lec_error[(esr & CAN_ESR_LEC) >> CAN_ESR_LEC_Pos];
+            can->esr &= ~CAN_ESR_LEC;
+        }
+
+        can->msr &= ~CAN_MSR_ERRI;
+        sim_can_ctrl_publish(can);
+    }
+
+    if (error != HAL_CAN_ERROR_NONE) {
+        hcan->ErrorCode |= error;
+        HAL_CAN_ErrorCallback(hcan);
+    }
+}
+
+HAL_CAN_StateTypeDef HAL_CAN_GetState(const CAN_HandleTypeDef *hcan) {
+    return hcan->State;
+}
+
+uint32_t HAL_CAN_GetError(const CAN_HandleTypeDef *hcan) {
+    return hcan->ErrorCode;
+}
+
+HAL_StatusTypeDef HAL_CAN_ResetError(CAN_HandleTypeDef *hcan) {
+    hcan->ErrorCode = HAL_CAN_ERROR_NONE;
+    return HAL_OK;
+}
+
+__attribute__((weak)) void
+HAL_CAN_TxMailbox0CompleteCallback(CAN_HandleTypeDef *hcan) {
+    UNUSED(hcan);
+}
+
+__attribute__((weak)) void
+HAL_CAN_TxMailbox1CompleteCallback(CAN_HandleTypeDef *hcan) {
+    UNUSED(hcan);
+}
+
+__attribute__((weak)) void
+HAL_CAN_TxMailbox2CompleteCallback(CAN_HandleTypeDef *hcan) {
+    UNUSED(hcan);
+}
+
+__attribute__((weak)) void
+HAL_CAN_TxMailbox0AbortCallback(CAN_HandleTypeDef *hcan) {
+    UNUSED(hcan);
+}
+
+__attribute__((weak)) void
+HAL_CAN_TxMailbox1AbortCallback(CAN_HandleTypeDef *hcan) {
+    UNUSED(hcan);
+}
+
+__attribute__((weak)) void
+HAL_CAN_TxMailbox2AbortCallback(CAN_HandleTypeDef *hcan) {
+    UNUSED(hcan);
+}
+
+__attribute__((weak)) void
+HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *hcan) {
+    UNUSED(hcan);
+}
+
+__attribute__((weak)) void
+HAL_CAN_RxFifo0FullCallback(CAN_HandleTypeDef *hcan) {
+    UNUSED(hcan);
+}
+
+__attribute__((weak)) void
+HAL_CAN_RxFifo1MsgPendingCallback(CAN_HandleTypeDef *hcan) {
+    UNUSED(hcan);
+}
+
+__attribute__((weak)) void
+HAL_CAN_RxFifo1FullCallback(CAN_HandleTypeDef *hcan) {
+    UNUSED(hcan);
+}
+
+__attribute__((weak)) void HAL_CAN_ErrorCallback(CAN_HandleTypeDef *hcan) {
+    UNUSED(hcan);
+}
+
+/**
+ * @}
+ */
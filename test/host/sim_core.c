@@ -0,0 +1,502 @@
+/**
+ * @file    sim_core.c
+ * @author  Deadline039
+ * @brief   Core of simulator: clock, NVIC, PRIMASK and the intrinsics.
+ * @version 3.3.3
+ * @date    2024-10-22
+ */
+
+#include "sim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*****************************************************************************
+ * @defgroup Private variables of core.
+ * @{
+ */
+
+/* Interrupt sources of all models. */
+#define SIM_IRQ_SOURCES 32
+
+/* Taking the same interrupt so many times in a row means the line is never
+ * cleared by the handler. */
+#define SIM_IRQ_STORM   10000
+
+/* Priority of thread mode, lower than any interrupt. */
+#define SIM_THREAD_PRIO 0x100U
+
+DWT_Type sim_dwt;
+CoreDebug_Type sim_core_debug;
+GPIO_TypeDef sim_gpio[5];
+
+/**
+ * @brief Interrupt source.
+ */
+typedef struct {
+    IRQn_Type irqn;              /*!< Interrupt number.                     */
+    void (*handler)(void);       /*!< Handler, NULL if CSP doesn't define.  */
+    uint8_t (*line)(void *ctx);  /*!< Level of interrupt line.              */
+    void *ctx;                   /*!< Context of `line`.                    */
+} sim_irq_source_t;
+
+static sim_model_t *sim_models;
+static sim_irq_source_t sim_irq_sources[SIM_IRQ_SOURCES];
+static uint32_t sim_irq_source_count;
+
+static struct {
+    uint64_t now;                /*!< Current time. Unit: cycle.            */
+    uint64_t busy;               /*!< Cycles charged to CPU.                */
+    uint32_t later;              /*!< Cycles to charge at end of sync.      */
+    uint32_t primask;            /*!< PRIMASK of CPU.                       */
+    uint32_t running_prio;       /*!< Priority of running handler.          */
+    uint8_t advancing;           /*!< `sim_advance()` is running.           */
+    uint8_t enabled[SIM_IRQ_NUM];   /*!< NVIC enable.                       */
+    uint8_t preempt[SIM_IRQ_NUM];   /*!< NVIC preempt priority.             */
+    uint8_t sub[SIM_IRQ_NUM];       /*!< NVIC sub priority.                 */
+    uint32_t count[SIM_IRQ_NUM];    /*!< Times of handler called.           */
+} sim_core;
+
+/**
+ * @}
+ */
+
+/*****************************************************************************
+ * @defgroup Registration.
+ * @{
+ */
+
+/**
+ * @brief Register a model of peripheral, called by the constructor of model.
+ *
+ * @param model The model, must be static.
+ */
+void sim_model_register(sim_model_t *model) {
+    model->next = sim_models;
+    sim_models = model;
+}
+
+/**
+ * @brief Register an interrupt source, called by the constructor of model.
+ *
+ * @param irqn Interrupt number.
+ * @param handler The handler, weak reference of CSP handler, can be NULL.
+ * @param line Return 1 if the interrupt line is active.
+ * @param ctx Context of `line`.
+ */
+void sim_irq_register(IRQn_Type irqn, void (*handler)(void),
+                      uint8_t (*line)(void *ctx), void *ctx) {
+    if ((sim_irq_source_count == SIM_IRQ_SOURCES) || (irqn < 0) ||
+        (irqn >= SIM_IRQ_NUM)) {
+        fprintf(stderr, "sim: can not register IRQ %d\n", (int)irqn);
+        abort();
+    }
+
+    sim_irq_sources[sim_irq_source_count++] =
+        (sim_irq_source_t){irqn, handler, line, ctx};
+}
+
+/**
+ * @}
+ */
+
+/*****************************************************************************
+ * @defgroup Clock and interrupts.
+ * @{
+ */
+
+/**
+ * @brief Update the cycle counter of DWT.
+ *
+ */
+static void sim_dwt_update(void) {
+    if (sim_dwt.CTRL & DWT_CTRL_CYCCNTENA_Msk) {
+        sim_dwt.CYCCNT = (uint32_t)sim_core.now;
+    }
+}
+
+/**
+ * @brief Call the handlers of active interrupt lines, by priority. A
+ *        handler is only called if PRIMASK is clear and it preempts the
+ *        running one.
+ *
+ */
+static void sim_irq_dispatch(void) {
+    uint32_t storm = 0;
+
+    while (sim_core.primask == 0) {
+        const sim_irq_source_t *best = NULL;
+        uint32_t best_prio = sim_core.running_prio;
+
+        for (uint32_t i = 0; i < sim_irq_source_count; ++i) {
+            const sim_irq_source_t *source = &sim_irq_sources[i];
+            IRQn_Type irqn = source->irqn;
+
+            if ((source->handler == NULL) || (sim_core.enabled[irqn] == 0) ||
+                (source->line(source->ctx) == 0)) {
+                continue;
+            }
+
+            /* Preempt priority first, the sub priority and the number only
+             * decide the order of pending ones. */
+            uint32_t prio = ((uint32_t)sim_core.preempt[irqn] << 16) |
+                            ((uint32_t)sim_core.sub[irqn] << 8) |
+                            (uint32_t)irqn;
+            if ((sim_core.preempt[irqn] < (sim_core.running_prio >> 16)) &&
+                ((best == NULL) || (prio < best_prio))) {
+                best = source;
+                best_prio = prio;
+            }
+        }
+
+        if (best == NULL) {
+            return;
+        }
+
+        if (++storm > SIM_IRQ_STORM) {
+            fprintf(stderr, "sim: IRQ %d is never cleared\n", (int)best->irqn);
+            abort();
+        }
+
+        uint32_t running_prio = sim_core.running_prio;
+        sim_core.running_prio = best_prio;
+        ++sim_core.count[best->irqn];
+
+        sim_charge(SIM_COST_IRQ_ENTRY);
+        best->handler();
+        sim_sync();
+        sim_charge(SIM_COST_IRQ_EXIT);
+
+        sim_core.running_prio = running_prio;
+    }
+}
+
+/**
+ * @brief Advance the time, process the events of models in order of time.
+ *
+ * @param target The time to advance to.
+ * @note The handlers called here also charge the CPU, the nested calls only
+ *       move the time, their events are processed by the outer loop.
+ */
+static void sim_advance(uint64_t target) {
+    if (sim_core.advancing) {
+        if (target > sim_core.now) {
+            sim_core.now = target;
+        }
+        sim_dwt_update();
+        return;
+    }
+
+    sim_core.advancing = 1;
+
+    while (1) {
+        sim_model_t *first = NULL;
+        uint64_t first_time = SIM_NEVER;
+
+        for (sim_model_t *model = sim_models; model != NULL;
+             model = model->next) {
+            uint64_t time = model->next_event();
+            if (time < first_time) {
+                first = model;
+                first_time = time;
+            }
+        }
+
+        if ((first == NULL) || (first_time > target)) {
+            break;
+        }
+
+        if (first_time > sim_core.now) {
+            sim_core.now = first_time;
+        }
+        sim_dwt_update();
+
+        first->event(sim_core.now);
+        sim_sync();
+    }
+
+    if (target > sim_core.now) {
+        sim_core.now = target;
+    }
+    sim_dwt_update();
+
+    sim_core.advancing = 0;
+}
+
+/**
+ * @brief Reset the clock, NVIC and all models.
+ *
+ */
+void sim_reset(void) {
+    memset(&sim_core, 0, sizeof(sim_core));
+    sim_core.running_prio = SIM_THREAD_PRIO << 16;
+
+    memset(&sim_dwt, 0, sizeof(sim_dwt));
+    memset(&sim_core_debug, 0, sizeof(sim_core_debug));
+    memset(sim_gpio, 0, sizeof(sim_gpio));
+
+    for (sim_model_t *model = sim_models; model != NULL; model = model->next) {
+        model->reset();
+    }
+}
+
+/**
+ * @brief Apply the register writes of CSP, then take the pending
+ *        interrupts.
+ *
+ */
+void sim_sync(void) {
+    for (sim_model_t *model = sim_models; model != NULL; model = model->next) {
+        model->sync();
+    }
+
+    if (sim_core.later != 0) {
+        uint32_t cycles = sim_core.later;
+        sim_core.later = 0;
+        sim_charge(cycles);
+    }
+
+    sim_dwt_update();
+    sim_irq_dispatch();
+}
+
+/**
+ * @brief Charge the CPU, the time goes on.
+ *
+ * @param cycles CPU cycles.
+ */
+void sim_charge(uint32_t cycles) {
+    sim_core.busy += cycles;
+    sim_advance(sim_core.now + cycles);
+}
+
+/**
+ * @brief Charge the CPU at the end of current sync point, for the work a
+ *        model finds in its `sync`, where the time can not go on.
+ *
+ * @param cycles CPU cycles.
+ */
+void sim_charge_later(uint32_t cycles) {
+    sim_core.later += cycles;
+}
+
+/**
+ * @brief Let the CPU idle, the peripherals and interrupts go on.
+ *
+ * @param cycles Idle time. Unit: cycle.
+ */
+void sim_run(uint64_t cycles) {
+    sim_sync();
+    sim_advance(sim_core.now + cycles);
+}
+
+/**
+ * @brief Idle until the condition is true.
+ *
+ * @param done The condition, checked after each event.
+ * @param timeout Timeout. Unit: cycle.
+ * @return Return 1 if `done()` returns true before timeout.
+ */
+uint8_t sim_run_until(uint8_t (*done)(void), uint64_t timeout) {
+    uint64_t deadline = sim_core.now + timeout;
+
+    sim_sync();
+
+    while (done() == 0) {
+        uint64_t next = SIM_NEVER;
+        for (sim_model_t *model = sim_models; model != NULL;
+             model = model->next) {
+            uint64_t time = model->next_event();
+            next = (time < next) ? time : next;
+        }
+
+        if (next > deadline) {
+            sim_advance(deadline);
+            return done();
+        }
+
+        sim_advance((next > sim_core.now) ? next : sim_core.now);
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Get the current time.
+ *
+ * @return Time. Unit: cycle.
+ */
+uint64_t sim_now(void) {
+    return sim_core.now;
+}
+
+/**
+ * @brief Get the cycles charged to CPU since reset.
+ *
+ * @return CPU cycles.
+ */
+uint64_t sim_busy_cycles(void) {
+    return sim_core.busy;
+}
+
+/**
+ * @brief Get the times a handler is called since reset.
+ *
+ * @param irqn Interrupt number.
+ * @return Times.
+ */
+uint32_t sim_irq_count(IRQn_Type irqn) {
+    return sim_core.count[irqn];
+}
+
+/**
+ * @brief Whether the interrupt is enabled in NVIC.
+ *
+ * @param irqn Interrupt number.
+ * @return Return 1 if enabled.
+ */
+uint8_t sim_irq_enabled(IRQn_Type irqn) {
+    return sim_core.enabled[irqn];
+}
+
+/**
+ * @}
+ */
+
+/*****************************************************************************
+ * @defgroup Intrinsics and HAL of core.
+ * @{
+ */
+
+uint32_t __get_PRIMASK(void) {
+    return sim_core.primask;
+}
+
+void __set_PRIMASK(uint32_t primask) {
+    sim_core.primask = primask & 0x01U;
+    sim_sync();
+}
+
+void __disable_irq(void) {
+    sim_core.primask = 1;
+}
+
+void __enable_irq(void) {
+    sim_core.primask = 0;
+    sim_sync();
+}
+
+void __DMB(void) {
+    sim_sync();
+}
+
+void __DSB(void) {
+    sim_sync();
+}
+
+void __ISB(void) {
+    sim_sync();
+}
+
+/**
+ * @brief Access the DWT, the `DWT` macro. The CPU is charged, so a loop
+ *        polling `CYCCNT` lets the time go on.
+ *
+ * @return The registers of DWT.
+ */
+DWT_Type *sim_dwt_access(void) {
+    sim_charge(SIM_COST_REG_POLL);
+    sim_sync();
+
+    return &sim_dwt;
+}
+
+uint32_t __REV(uint32_t value) {
+    return __builtin_bswap32(value);
+}
+
+uint32_t __RBIT(uint32_t value) {
+    uint32_t result = 0;
+
+    for (uint32_t i = 0; i < 32; ++i) {
+        result = (result << 1) | ((value >> i) & 0x01U);
+    }
+
+    return result;
+}
+
+uint8_t __CLZ(uint32_t value) {
+    return (value == 0) ? 32 : (uint8_t)__builtin_clz(value);
+}
+
+void HAL_NVIC_SetPriority(IRQn_Type irqn, uint32_t preempt_priority,
+                          uint32_t sub_priority) {
+    sim_core.preempt[irqn] = (uint8_t)preempt_priority;
+    sim_core.sub[irqn] = (uint8_t)sub_priority;
+}
+
+void HAL_NVIC_EnableIRQ(IRQn_Type irqn) {
+    sim_core.enabled[irqn] = 1;
+    sim_sync();
+}
+
+void HAL_NVIC_DisableIRQ(IRQn_Type irqn) {
+    sim_core.enabled[irqn] = 0;
+}
+
+uint32_t HAL_GetTick(void) {
+    sim_charge(SIM_COST_TICK);
+    return (uint32_t)(sim_core.now / (SIM_HCLK_FREQ / 1000));
+}
+
+void HAL_Delay(uint32_t delay) {
+    uint64_t end = sim_core.now + (uint64_t)delay * (SIM_HCLK_FREQ / 1000);
+
+    while (sim_core.now < end) {
+        sim_charge(SIM_COST_TICK);
+        sim_sync();
+    }
+}
+
+uint32_t HAL_RCC_GetSysClockFreq(void) {
+    return SIM_HCLK_FREQ;
+}
+
+uint32_t HAL_RCC_GetHCLKFreq(void) {
+    return SIM_HCLK_FREQ;
+}
+
+uint32_t HAL_RCC_GetPCLK1Freq(void) {
+    return SIM_PCLK1_FREQ;
+}
+
+uint32_t HAL_RCC_GetPCLK2Freq(void) {
+    return SIM_PCLK2_FREQ;
+}
+
+void HAL_GPIO_Init(GPIO_TypeDef *port, GPIO_InitTypeDef *init) {
+    UNUSED(port);
+    UNUSED(init);
+}
+
+void HAL_GPIO_DeInit(GPIO_TypeDef *port, uint32_t pin) {
+    UNUSED(port);
+    UNUSED(pin);
+}
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *port, uint16_t pin) {
+    return (port->IDR & pin) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *port, uint16_t pin, GPIO_PinState state) {
+    if (state == GPIO_PIN_SET) {
+        port->ODR |= pin;
+    } else {
+        port->ODR &= ~(uint32_t)pin;
+    }
+}
+
+/**
+ * @}
+ */
@@ -0,0 +1,2359 @@
+/**
+ * @file    sim_uart.c
+ * @author  Deadline039
+ * @brief   Model of the USARTs, the DMA channels and the peers on line.
+ * @version 3.3.3
+ * @date    2024-10-22
+ * @note    Modeled: frame time by `BRR` and the frame format, one byte of
+ *          data register and the shift register with `RXNE`, `TXE` and
+ *          `TC`, overrun, IDLE after one idle frame, the "read SR then DR"
+ *          clear sequence, the interrupt lines of RM0008, the DMA requests
+ *          of USART1 ~ UART4 (USART1 RX on DMA1 channel 5 etc.), the
+ *          counter, half transfer, transfer complete and circular mode of
+ *          DMA channels.
+ *          The peer sends the bytes queued by test at the rate of USART or
+ *          at its own rate, with idle gaps between them. A byte can carry
+ *          PE, FE or NE, or be lost by overrun. The bits of peer drive the
+ *          level of RX pin set by `sim_uart_set_rx_pin()` (`IDR`), for the
+ *          auto baud detection. A byte that starts before the receiver is
+ *          enabled is not received.
+ *          In synchronous mode (`CLKEN`) the peer is a shift register
+ *          clocked by CK: each byte sent shifts its next queued byte (0xFF
+ *          if none) into the USART at the same time.
+ *          Simplified: a byte at the wrong rate is received with FE and the
+ *          right data, DMA moves a byte at once, the transfer error of DMA,
+ *          hardware flow control, LIN, IrDA and smartcard are not modeled.
+ *          The edges of CK and the polarity and phase are not modeled, the
+ *          synchronous receive has no error.
+ *          `CMAR` only holds 32 bits of address, so `malloc()` is wrapped by
+ *          the linker (See Makefile) to allocate in the 32-bit address
+ *          space. For static storage the upper bits are taken from the
+ *          address given to HAL.
+ */
+
+#include "sim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#ifdef __SANITIZE_ADDRESS__
+#include <sanitizer/asan_interface.h>
+#else /* __SANITIZE_ADDRESS__ */
+#define ASAN_POISON_MEMORY_REGION(addr, size)   ((void)(addr), (void)(size))
+#define ASAN_UNPOISON_MEMORY_REGION(addr, size) ((void)(addr), (void)(size))
+#endif /* __SANITIZE_ADDRESS__ */
+
+/*****************************************************************************
+ * @defgroup Private macros and types of USART and DMA model.
+ * @{
+ */
+
+#define SIM_DMA_CHANNELS        12
+
+/* The USARTs are from `PERIPH_BASE` up to USART1 on APB2. */
+#define SIM_UART_MAP_SIZE       0x14000U
+
+/* Heap of the allocations, in the 32-bit address space like SRAM. The
+ * blocks are never reused. */
+#define SIM_HEAP_BASE           0x20000000UL
+#define SIM_HEAP_SIZE           0x4000000UL
+/* Poisoned bytes around a block, the first ones hold the size. */
+#define SIM_HEAP_REDZONE        16U
+
+/* Rate tolerance of receiver to peer. Unit: 0.1%. */
+#define SIM_UART_RATE_TOLERANCE 30
+/* Rate of peer if the USART is not configured. */
+#define SIM_UART_DEFAULT_RATE   115200U
+
+/* Reset value of `SR`. */
+#define SIM_USART_SR_RESET      (USART_SR_TXE | USART_SR_TC)
+/* Bits of `SR` cleared by writing 0. */
+#define SIM_USART_SR_RC_W0                                                     \
+    (USART_SR_TC | USART_SR_RXNE | USART_SR_LBD | USART_SR_CTS)
+/* Bits of `SR` cleared by the "read SR then DR" sequence. */
+#define SIM_USART_SR_SEQUENCE                                                  \
+    (USART_SR_PE | USART_SR_FE | USART_SR_NE | USART_SR_ORE | USART_SR_IDLE)
+/* Errors a byte from peer can carry. */
+#define SIM_USART_SR_ERRORS                                                    \
+    (USART_SR_PE | USART_SR_FE | USART_SR_NE | USART_SR_ORE)
+
+/**
+ * @brief Byte queued by peer.
+ */
+typedef struct {
+    uint8_t data;                /*!< Data.                                 */
+    uint8_t error;               /*!< PE, FE, NE or ORE of `SR`.            */
+    uint32_t gap;                /*!< Idle bits before the byte.            */
+} sim_uart_byte_t;
+
+/**
+ * @brief USART and the peer on the other end of line. `SR` has a shadow,
+ *        the difference to the shadow is the write of CSP.
+ */
+typedef struct {
+    USART_TypeDef *regs;         /*!< Registers.                            */
+    uint32_t pclk;               /*!< Clock of `BRR`.                       */
+    int rx_dma;                  /*!< DMA channel of RX request, or -1.     */
+    int tx_dma;                  /*!< DMA channel of TX request, or -1.     */
+    uint32_t sr;                 /*!< Shadow of `SR`.                       */
+    uint8_t rdr;                 /*!< Received data.                        */
+    uint8_t tdr;                 /*!< Data to transmit.                     */
+    uint8_t tdr_full;            /*!< `tdr` is waiting for shift register.  */
+    uint8_t shift;               /*!< Byte in the shift register.           */
+    uint64_t tx_end;             /*!< End of byte in shift register, or
+                                      `SIM_NEVER`.                          */
+    uint64_t rx_start;           /*!< Start of byte on receive line.        */
+    uint64_t rx_end;             /*!< End of byte on receive line, or
+                                      `SIM_NEVER`.                          */
+    uint32_t rx_bit;             /*!< Bit time of byte on receive line.     */
+    uint64_t rx_since;           /*!< The receiver is enabled since, or
+                                      `SIM_NEVER`.                          */
+    GPIO_TypeDef *rx_port;       /*!< Port of RX pin, or NULL.              */
+    uint16_t rx_pin;             /*!< RX pin.                               */
+    uint64_t rx_free;            /*!< End of last byte on receive line.     */
+    uint64_t idle_at;            /*!< Time of IDLE flag, or `SIM_NEVER`.    */
+    uint32_t peer_rate;          /*!< Rate of peer, 0: same as USART.       */
+    uint32_t gap;                /*!< Idle bits before next byte queued.    */
+    uint32_t inject;             /*!< Errors of next byte queued.           */
+    sim_uart_byte_t queue[SIM_UART_PEER_QUEUE];
+    uint32_t queue_head;
+    uint32_t queue_count;
+    uint8_t log[SIM_UART_PEER_LOG];
+    uint32_t log_head;
+    uint32_t log_count;
+    uint32_t received;           /*!< Bytes received by peer since reset.   */
+    sim_uart_stats_t stats;
+} sim_uart_t;
+
+/**
+ * @brief DMA channel. `CNDTR` and `ISR` have a shadow, `CCR` and `CMAR`
+ *        are compared to the values seen at last sync.
+ */
+typedef struct {
+    DMA_Channel_TypeDef *regs;   /*!< Registers of channel.                 */
+    DMA_TypeDef *dma;            /*!< The controller.                       */
+    uint32_t shift;              /*!< Position of flags in `ISR`.           */
+    uint32_t ccr;                /*!< `CCR` seen at last sync.              */
+    uint32_t cmar;               /*!< `CMAR` seen at last sync.             */
+    uint8_t *mem;                /*!< Memory address.                       */
+    uint32_t cndtr;              /*!< Shadow of `CNDTR`.                    */
+    uint32_t reload;             /*!< Programmed count.                     */
+    uint32_t pos;                /*!< Transfers since the programmed count
+                                      is loaded.                            */
+    uint32_t flags;              /*!< GIF, TCIF, HTIF and TEIF in bit 0 ~ 3.
+                                      */
+} sim_dma_ch_t;
+
+/**
+ * @}
+ */
+
+/*****************************************************************************
+ * @defgroup Private variables of USART and DMA model.
+ * @{
+ */
+
+DMA_TypeDef sim_dma_regs[2];
+DMA_Channel_TypeDef sim_dma_channel_regs[SIM_DMA_CHANNELS];
+
+static sim_uart_t sim_uart[SIM_UART_NUM];
+static sim_dma_ch_t sim_dma_ch[SIM_DMA_CHANNELS];
+
+/* Next free byte of heap, 0 before the heap is mapped. */
+static uintptr_t sim_heap_top;
+
+/* Handlers of CSP, NULL if the UART or DMA is not enabled in
+ * CSP_Config.h. */
+extern void USART1_IRQHandler(void) __attribute__((weak));
+extern void USART2_IRQHandler(void) __attribute__((weak));
+extern void USART3_IRQHandler(void) __attribute__((weak));
+extern void UART4_IRQHandler(void) __attribute__((weak));
+extern void UART5_IRQHandler(void) __attribute__((weak));
+extern void DMA1_Channel1_IRQHandler(void) __attribute__((weak));
+extern void DMA1_Channel2_IRQHandler(void) __attribute__((weak));
+extern void DMA1_Channel3_IRQHandler(void) __attribute__((weak));
+extern void DMA1_Channel4_IRQHandler(void) __attribute__((weak));
+extern void DMA1_Channel5_IRQHandler(void) __attribute__((weak));
+extern void DMA1_Channel6_IRQHandler(void) __attribute__((weak));
+extern void DMA1_Channel7_IRQHandler(void) __attribute__((weak));
+extern void DMA2_Channel1_IRQHandler(void) __attribute__((weak));
+extern void DMA2_Channel2_IRQHandler(void) __attribute__((weak));
+extern void DMA2_Channel3_IRQHandler(void) __attribute__((weak));
+extern void DMA2_Channel4_IRQHandler(void) __attribute__((weak));
+extern void DMA2_Channel5_IRQHandler(void) __attribute__((weak));
+
+/**
+ * @brief USARTs and their DMA requests, RM0008 table 78 and 79.
+ */
+static const struct {
+    uintptr_t base;
+    IRQn_Type irqn;
+    void (*handler)(void);
+    uint32_t pclk;
+    int rx_dma;
+    int tx_dma;
+} sim_uart_desc[SIM_UART_NUM] = {
+    {USART1_BASE, USART1_IRQn, USART1_IRQHandler, SIM_PCLK2_FREQ, 4, 3},
+    {USART2_BASE, USART2_IRQn, USART2_IRQHandler, SIM_PCLK1_FREQ, 5, 6},
+    {USART3_BASE, USART3_IRQn, USART3_IRQHandler, SIM_PCLK1_FREQ, 2, 1},
+    {UART4_BASE, UART4_IRQn, UART4_IRQHandler, SIM_PCLK1_FREQ, 9, 11},
+    {UART5_BASE, UART5_IRQn, UART5_IRQHandler, SIM_PCLK1_FREQ, -1, -1},
+};
+
+/**
+ * @}
+ */
+
+/*****************************************************************************
+ * @defgroup Heap in the 32-bit address space, the linker wraps `malloc()`,
+ *           `free()` and `realloc()` of all objects into these.
+ * @{
+ */
+
+void __real_free(void *ptr);
+
+/**
+ * @brief Map the heap at first use.
+ *
+ */
+static void sim_heap_map(void) {
+    void *map = mmap((void *)SIM_HEAP_BASE, SIM_HEAP_SIZE,
+                     PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE |
+                         MAP_FIXED_NOREPLACE,
+                     -1, 0);
+    if (map != (void *)SIM_HEAP_BASE) {
+        fprintf(stderr, "sim: can not map the heap at 0x%08lx\n",
+                (unsigned long)SIM_HEAP_BASE);
+        abort();
+    }
+
+    sim_heap_top = SIM_HEAP_BASE;
+}
+
+/**
+ * @brief Whether the pointer is in the heap.
+ *
+ * @param ptr The pointer.
+ * @return Return 1 if in the heap.
+ */
+static uint8_t sim_heap_owns(const void *ptr) {
+    return ((uintptr_t)ptr >= SIM_HEAP_BASE) &&
+           ((uintptr_t)ptr < SIM_HEAP_BASE + SIM_HEAP_SIZE);
+}
+
+/**
+ * @brief Get the size of a block, it is kept in the redzone before.
+ *
+ * @param ptr The block.
+ * @return Size of block.
+ */
+__attribute__((no_sanitize_address)) static size_t
+sim_heap_block_size(const void *ptr) {
+    return *(const size_t *)((const uint8_t *)ptr - SIM_HEAP_REDZONE);
+}
+
+void *__wrap_malloc(size_t size) {
+    if (sim_heap_top == 0) {
+        sim_heap_map();
+    }
+
+    size_t span = SIM_HEAP_REDZONE + ((size + 15) & ~(size_t)15) +
+                  SIM_HEAP_REDZONE;
+    if (span > SIM_HEAP_BASE + SIM_HEAP_SIZE - sim_heap_top) {
+        return NULL;
+    }
+
+    uint8_t *block = (uint8_t *)sim_heap_top;
+    sim_heap_top += span;
+
+    *(size_t *)block = size;
+    ASAN_POISON_MEMORY_REGION(block, span);
+    ASAN_UNPOISON_MEMORY_REGION(block + SIM_HEAP_REDZONE, size);
+
+    return block + SIM_HEAP_REDZONE;
+}
+
+void __wrap_free(void *ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+
+    if (!sim_heap_owns(ptr)) {
+        __real_free(ptr);
+        return;
+    }
+
+    /* Never reused, an access after free is caught by sanitizer. */
+    ASAN_POISON_MEMORY_REGION(ptr, sim_heap_block_size(ptr));
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    if (ptr == NULL) {
+        return __wrap_malloc(size);
+    }
+
+    if (size == 0) {
+        __wrap_free(ptr);
+        return NULL;
+    }
+
+    uint8_t *new_ptr = __wrap_malloc(size);
+    if (new_ptr != NULL) {
+        size_t old_size = sim_heap_block_size(ptr);
+        memcpy(new_ptr, ptr, (old_size < size) ? old_size : size);
+        __wrap_free(ptr);
+    }
+
+    return new_ptr;
+}
+
+/**
+ * @}
+ */
+
+/*****************************************************************************
+ * @defgroup DMA channel.
+ * @{
+ */
+
+/**
+ * @brief Get the pointer of a 32-bit memory address.
+ *
+ * @param ch The channel.
+ * @param cmar The address.
+ * @return The pointer in the heap, or with the upper bits of the last memory
+ *         address for static storage.
+ */
+static uint8_t *sim_dma_resolve(const sim_dma_ch_t *ch, uint32_t cmar) {
+    if (sim_heap_owns((const void *)(uintptr_t)cmar)) {
+        return (uint8_t *)(uintptr_t)cmar;
+    }
+
+    return (uint8_t *)(((uintptr_t)ch->mem & ~(uintptr_t)UINT32_MAX) | cmar);
+}
+
+/**
+ * @brief Write the shadows to the registers.
+ *
+ * @param ch The channel.
+ */
+static void sim_dma_publish(sim_dma_ch_t *ch) {
+    uint32_t mask = 0x0FU << ch->shift;
+
+    ch->regs->CNDTR = ch->cndtr;
+    ch->dma->ISR = (ch->dma->ISR & ~mask) | (ch->flags << ch->shift);
+}
+
+/**
+ * @brief Apply the writes of `CCR`, `CNDTR` and `CMAR`.
+ *
+ * @param ch The channel.
+ * @note Writing `CNDTR` or `CMAR` or enabling the channel loads the
+ *       programmed count, the next transfer is at the start of memory.
+ *       The writes between two sync points are seen together, as
+ *       "disable, program and enable" of CSP.
+ */
+static void sim_dma_ch_sync(sim_dma_ch_t *ch) {
+    DMA_Channel_TypeDef *regs = ch->regs;
+    uint8_t load = 0;
+
+    if (regs->CMAR != ch->cmar) {
+        ch->cmar = regs->CMAR;
+        ch->mem = sim_dma_resolve(ch, ch->cmar);
+        load = 1;
+    }
+
+    if ((regs->CNDTR & 0xFFFFU) != ch->cndtr) {
+        ch->reload = regs->CNDTR & 0xFFFFU;
+        load = 1;
+    }
+
+    if ((regs->CCR & DMA_CCR_EN) && !(ch->ccr & DMA_CCR_EN)) {
+        load = 1;
+    }
+
+    if (load) {
+        ch->cndtr = ch->reload;
+        ch->pos = 0;
+    }
+
+    ch->ccr = regs->CCR;
+    sim_dma_publish(ch);
+}
+
+/**
+ * @brief Serve a request of peripheral.
+ *
+ * @param ch The channel.
+ * @param dir 0: Peripheral to memory, `DMA_CCR_DIR`: Memory to peripheral.
+ * @param[in,out] data The data of peripheral.
+ * @return Return 1 if the byte is moved, 0 if the channel is not running.
+ */
+static uint8_t sim_dma_transfer(sim_dma_ch_t *ch, uint32_t dir,
+                                uint8_t *data) {
+    if (!(ch->ccr & DMA_CCR_EN) || ((ch->ccr & DMA_CCR_DIR) != dir) ||
+        (ch->cndtr == 0)) {
+        return 0;
+    }
+
+    uint8_t *mem = ch->mem + ((ch->ccr & DMA_CCR_MINC) ? ch->pos : 0);
+    if (dir == DMA_CCR_DIR) {
+        *data = *mem;
+    } else {
+        *mem = *data;
+    }
+
+    ++ch->pos;
+    --ch->cndtr;
+    ch->flags |= DMA_FLAG_GL1;
+
+    /* Half of an odd count is rounded up. */
+    if (ch->reload - ch->cndtr == (ch->reload + 1) / 2) {
+        ch->flags |= DMA_FLAG_HT1;
+    }
+
+    if (ch->cndtr == 0) {
+        ch->flags |= DMA_FLAG_TC1;
+        if (ch->ccr & DMA_CCR_CIRC) {
+            ch->cndtr = ch->reload;
+            ch->pos = 0;
+        }
+    }
+
+    sim_dma_publish(ch);
+    return 1;
+}
+
+/**
+ * @brief Get the level of interrupt line of channel.
+ *
+ * @param ctx Index of channel.
+ * @return Return 1 if active.
+ */
+static uint8_t sim_dma_irq_line(void *ctx) {
+    const sim_dma_ch_t *ch = &sim_dma_ch[(uintptr_t)ctx];
+    uint32_t ccr = ch->regs->CCR;
+
+    return ((ch->flags & DMA_FLAG_TC1) && (ccr & DMA_CCR_TCIE)) ||
+           ((ch->flags & DMA_FLAG_HT1) && (ccr & DMA_CCR_HTIE)) ||
+           ((ch->flags & DMA_FLAG_TE1) && (ccr & DMA_CCR_TEIE));
+}
+
+/**
+ * @brief Get the channel of HAL handle.
+ *
+ * @param hdma The handle.
+ * @return The channel.
+ */
+static sim_dma_ch_t *sim_dma_identify(const DMA_HandleTypeDef *hdma) {
+    uintptr_t index = (uintptr_t)(hdma->Instance - sim_dma_channel_regs);
+
+    if (index >= SIM_DMA_CHANNELS) {
+        fprintf(stderr, "sim: unknown DMA channel %p\n",
+                (void *)hdma->Instance);
+        abort();
+    }
+
+    return &sim_dma_ch[index];
+}
+
+/**
+ * @}
+ */
+
+/*****************************************************************************
+ * @defgroup USART.
+ * @{
+ */
+
+/**
+ * @brief Get the USART of registers.
+ *
+ * @param regs The registers.
+ * @return The USART.
+ */
+static sim_uart_t *sim_uart_identify(const USART_TypeDef *regs) {
+    for (uint32_t i = 0; i < SIM_UART_NUM; ++i) {
+        if (sim_uart[i].regs == regs) {
+            return &sim_uart[i];
+        }
+    }
+
+    fprintf(stderr, "sim: unknown USART %p\n", (const void *)regs);
+    abort();
+}
+
+/**
+ * @brief Get the bits of a frame: start bit, data bits (Include parity) and
+ *        stop bits. 0.5 and 1.5 stop bits are counted as 1 and 2.
+ *
+ * @param u The USART.
+ * @return Bits.
+ */
+static uint32_t sim_uart_frame_bits(const sim_uart_t *u) {
+    uint32_t stop = (u->regs->CR2 & USART_CR2_STOP) >> USART_CR2_STOP_Pos;
+
+    return 1 + ((u->regs->CR1 & USART_CR1_M) ? 9 : 8) + ((stop >= 2) ? 2 : 1);
+}
+
+/**
+ * @brief Get the CPU cycles of one bit sent by peer.
+ *
+ * @param index Index of USART.
+ * @return Cycles.
+ */
+static uint32_t sim_uart_peer_bit_cycles(uint32_t index) {
+    uint32_t rate = sim_uart[index].peer_rate;
+
+    if (rate == 0) {
+        uint32_t cycles = sim_uart_bit_cycles(index);
+        if (cycles != 0) {
+            return cycles;
+        }
+        rate = SIM_UART_DEFAULT_RATE;
+    }
+
+    return (SIM_HCLK_FREQ + rate / 2) / rate;
+}
+
+/**
+ * @brief Write the shadow to the registers.
+ *
+ * @param u The USART.
+ */
+static void sim_uart_publish(sim_uart_t *u) {
+    u->regs->SR = u->sr;
+    u->regs->DR = u->rdr;
+}
+
+/**
+ * @brief Apply the writes of `SR`, the bits of `SIM_USART_SR_RC_W0` are
+ *        cleared by writing 0.
+ *
+ * @param u The USART.
+ */
+static void sim_uart_apply_sr(sim_uart_t *u) {
+    uint32_t sr = u->regs->SR;
+
+    if (sr != u->sr) {
+        u->sr &= ~(~sr & SIM_USART_SR_RC_W0);
+        u->regs->SR = u->sr;
+    }
+}
+
+/**
+ * @brief Follow the enable of receiver.
+ *
+ * @param u The USART.
+ * @param now Current time.
+ */
+static void sim_uart_track_rx(sim_uart_t *u, uint64_t now) {
+    if ((u->regs->CR1 & (USART_CR1_UE | USART_CR1_RE)) !=
+        (USART_CR1_UE | USART_CR1_RE)) {
+        u->rx_since = SIM_NEVER;
+    } else if (u->rx_since == SIM_NEVER) {
+        u->rx_since = now;
+    }
+}
+
+/**
+ * @brief Drive the RX pin by the bit of peer on line: idle and stop bits
+ *        high, start bit low, data bits LSB first.
+ *
+ * @param u The USART.
+ * @param now Current time.
+ */
+static void sim_uart_drive_pin(sim_uart_t *u, uint64_t now) {
+    uint8_t level = 1;
+
+    if (u->rx_port == NULL) {
+        return;
+    }
+
+    if ((u->rx_end != SIM_NEVER) && (now >= u->rx_start) &&
+        (now < u->rx_end)) {
+        uint64_t bit = (now - u->rx_start) / u->rx_bit;
+
+        if (bit == 0) {
+            level = 0;
+        } else if (bit <= 8) {
+            level = (u->queue[u->queue_head].data >> (bit - 1)) & 0x01U;
+        }
+    }
+
+    if (level) {
+        u->rx_port->IDR |= u->rx_pin;
+    } else {
+        u->rx_port->IDR &= ~(uint32_t)u->rx_pin;
+    }
+}
+
+/**
+ * @brief DMA reads the received byte if requested.
+ *
+ * @param u The USART.
+ */
+static void sim_uart_rx_dma(sim_uart_t *u) {
+    if (!(u->sr & USART_SR_RXNE) || !(u->regs->CR3 & USART_CR3_DMAR) ||
+        (u->rx_dma < 0)) {
+        return;
+    }
+
+    if (sim_dma_transfer(&sim_dma_ch[u->rx_dma], 0, &u->rdr)) {
+        u->sr &= ~USART_SR_RXNE;
+        ++u->stats.rx_dma;
+    }
+}
+
+/**
+ * @brief Write the data register.
+ *
+ * @param u The USART.
+ * @param data The data.
+ * @param now Current time.
+ */
+static void sim_uart_tx_write(sim_uart_t *u, uint8_t data, uint64_t now) {
+    if ((u->regs->CR1 & (USART_CR1_UE | USART_CR1_TE)) !=
+        (USART_CR1_UE | USART_CR1_TE)) {
+        return;
+    }
+
+    u->sr &= ~USART_SR_TC;
+
+    if (u->tx_end == SIM_NEVER) {
+        u->shift = data;
+        u->tx_end = now + (uint64_t)sim_uart_frame_bits(u) *
+                              sim_uart_bit_cycles((uint32_t)(u - sim_uart));
+        u->sr |= USART_SR_TXE;
+    } else {
+        u->tdr = data;
+        u->tdr_full = 1;
+        u->sr &= ~USART_SR_TXE;
+    }
+}
+
+/**
+ * @brief DMA writes the data register while it is empty.
+ *
+ * @param u The USART.
+ * @param now Current time.
+ */
+static void sim_uart_tx_dma(sim_uart_t *u, uint64_t now) {
+    uint8_t data;
+
+    if (!(u->regs->CR3 & USART_CR3_DMAT) || (u->tx_dma < 0) ||
+        ((u->regs->CR1 & (USART_CR1_UE | USART_CR1_TE)) !=
+         (USART_CR1_UE | USART_CR1_TE))) {
+        return;
+    }
+
+    while ((u->sr & USART_SR_TXE) &&
+           sim_dma_transfer(&sim_dma_ch[u->tx_dma], DMA_CCR_DIR, &data)) {
+        ++u->stats.tx_dma;
+        sim_uart_tx_write(u, data, now);
+    }
+}
+
+/**
+ * @brief Schedule the next byte of peer.
+ *
+ * @param index Index of USART.
+ * @param from The line is free from this time.
+ * @note The IDLE flag is cancelled if the byte starts before it. In
+ *       synchronous mode the bytes are clocked by the USART, see
+ *       `sim_uart_sync_rx()`.
+ */
+static void sim_uart_rx_schedule(uint32_t index, uint64_t from) {
+    sim_uart_t *u = &sim_uart[index];
+
+    if ((u->queue_count == 0) || (u->regs->CR2 & USART_CR2_CLKEN)) {
+        u->rx_end = SIM_NEVER;
+        return;
+    }
+
+    uint32_t bit = sim_uart_peer_bit_cycles(index);
+    uint64_t start = from + (uint64_t)u->queue[u->queue_head].gap * bit;
+
+    if (start < u->idle_at) {
+        u->idle_at = SIM_NEVER;
+    }
+
+    u->rx_start = start;
+    u->rx_bit = bit;
+    u->rx_end = start + (uint64_t)sim_uart_frame_bits(u) * bit;
+}
+
+/**
+ * @brief A byte from peer is at the end of stop bit.
+ *
+ * @param index Index of USART.
+ * @param now Current time.
+ */
+static void sim_uart_rx_done(uint32_t index, uint64_t now) {
+    sim_uart_t *u = &sim_uart[index];
+    sim_uart_byte_t byte = u->queue[u->queue_head];
+    uint32_t frame = sim_uart_frame_bits(u) * sim_uart_peer_bit_cycles(index);
+
+    u->queue_head = (u->queue_head + 1) % SIM_UART_PEER_QUEUE;
+    --u->queue_count;
+    u->rx_free = now;
+    u->stats.rx_busy += frame;
+
+    sim_uart_track_rx(u, now);
+    if ((u->rx_since == SIM_NEVER) || (u->rx_since > u->rx_start)) {
+        /* The receiver is off, or missed the start bit. */
+        ++u->stats.rx_dropped;
+        sim_uart_rx_schedule(index, now);
+        return;
+    }
+
+    uint32_t error = byte.error;
+    uint32_t bit = sim_uart_bit_cycles(index);
+    uint32_t peer_bit = sim_uart_peer_bit_cycles(index);
+    uint32_t diff = (bit > peer_bit) ? (bit - peer_bit) : (peer_bit - bit);
+    if ((uint64_t)diff * 1000 > (uint64_t)bit * SIM_UART_RATE_TOLERANCE) {
+        error |= USART_SR_FE;
+    }
+
+    if ((u->sr & USART_SR_RXNE) || (error & USART_SR_ORE)) {
+        /* The data register is not read, the new byte is lost. */
+        u->sr |= USART_SR_ORE;
+        ++u->stats.rx_overrun;
+    } else {
+        u->rdr = byte.data;
+        u->sr |= USART_SR_RXNE | (error & SIM_USART_SR_ERRORS);
+        ++u->stats.rx_bytes;
+        if (error & SIM_USART_SR_ERRORS) {
+            ++u->stats.rx_errors;
+        }
+    }
+
+    /* IDLE is set after a whole idle frame. */
+    u->idle_at = now + (uint64_t)sim_uart_frame_bits(u) * bit;
+
+    sim_uart_rx_dma(u);
+    sim_uart_rx_schedule(index, now);
+    sim_uart_publish(u);
+}
+
+/**
+ * @brief The peer shifts out its next byte while the USART sends one in
+ *        synchronous mode, 0xFF if nothing is queued.
+ *
+ * @param u The USART.
+ * @param now Current time.
+ */
+static void sim_uart_sync_rx(sim_uart_t *u, uint64_t now) {
+    uint8_t data = 0xFF;
+
+    if (u->queue_count != 0) {
+        data = u->queue[u->queue_head].data;
+        u->queue_head = (u->queue_head + 1) % SIM_UART_PEER_QUEUE;
+        --u->queue_count;
+    }
+
+    sim_uart_track_rx(u, now);
+    if (u->rx_since == SIM_NEVER) {
+        ++u->stats.rx_dropped;
+        return;
+    }
+
+    if (u->sr & USART_SR_RXNE) {
+        u->sr |= USART_SR_ORE;
+        ++u->stats.rx_overrun;
+    } else {
+        u->rdr = data;
+        u->sr |= USART_SR_RXNE;
+        ++u->stats.rx_bytes;
+    }
+
+    sim_uart_rx_dma(u);
+}
+
+/**
+ * @brief The byte in shift register is sent.
+ *
+ * @param index Index of USART.
+ * @param now Current time.
+ */
+static void sim_uart_tx_done(uint32_t index, uint64_t now) {
+    sim_uart_t *u = &sim_uart[index];
+
+    ++u->stats.tx_bytes;
+    ++u->received;
+    if (u->log_count < SIM_UART_PEER_LOG) {
+        u->log[(u->log_head + u->log_count) % SIM_UART_PEER_LOG] = u->shift;
+        ++u->log_count;
+    }
+
+    if (u->regs->CR2 & USART_CR2_CLKEN) {
+        sim_uart_sync_rx(u, now);
+    }
+
+    u->tx_end = SIM_NEVER;
+    if (u->tdr_full) {
+        u->tdr_full = 0;
+        sim_uart_tx_write(u, u->tdr, now);
+    } else {
+        u->sr |= USART_SR_TC;
+    }
+
+    sim_uart_tx_dma(u, now);
+    sim_uart_publish(u);
+}
+
+/**
+ * @brief Get the level of interrupt line of USART.
+ *
+ * @param ctx Index of USART.
+ * @return Return 1 if active.
+ */
+static uint8_t sim_uart_irq_line(void *ctx) {
+    const sim_uart_t *u = &sim_uart[(uintptr_t)ctx];
+    uint32_t sr = u->sr;
+    uint32_t cr1 = u->regs->CR1;
+    uint32_t cr3 = u->regs->CR3;
+
+    return ((sr & USART_SR_PE) && (cr1 & USART_CR1_PEIE)) ||
+           ((sr & USART_SR_TXE) && (cr1 & USART_CR1_TXEIE)) ||
+           ((sr & USART_SR_TC) && (cr1 & USART_CR1_TCIE)) ||
+           ((sr & (USART_SR_RXNE | USART_SR_ORE)) &&
+            (cr1 & USART_CR1_RXNEIE)) ||
+           ((sr & USART_SR_IDLE) && (cr1 & USART_CR1_IDLEIE)) ||
+           ((sr & (USART_SR_FE | USART_SR_NE | USART_SR_ORE)) &&
+            (cr3 & USART_CR3_EIE) && (cr3 & USART_CR3_DMAR));
+}
+
+/**
+ * @brief Read `SR`, called by `__HAL_UART_GET_FLAG()`. The CPU is charged,
+ *        so a polling loop lets the time go on.
+ *
+ * @param usart The registers of USART.
+ * @return Value of `SR`.
+ */
+uint32_t sim_usart_read_sr(USART_TypeDef *usart) {
+    sim_uart_t *u = sim_uart_identify(usart);
+
+    sim_sync();
+    sim_charge(SIM_COST_REG_POLL);
+
+    return u->sr;
+}
+
+/**
+ * @brief Read `SR` then `DR`, called by the `__HAL_UART_CLEAR_xxFLAG()`
+ *        macros. The error flags and IDLE are cleared, the received byte is
+ *        taken by CPU.
+ *
+ * @param usart The registers of USART.
+ */
+void sim_usart_read_sr_dr(USART_TypeDef *usart) {
+    sim_uart_t *u = sim_uart_identify(usart);
+
+    sim_uart_apply_sr(u);
+    u->sr &= ~(SIM_USART_SR_SEQUENCE | USART_SR_RXNE);
+    sim_uart_publish(u);
+}
+
+/**
+ * @}
+ */
+
+/*****************************************************************************
+ * @defgroup Model interface.
+ * @{
+ */
+
+/**
+ * @brief Reset the USARTs, DMA channels and peers.
+ *
+ */
+static void sim_uart_reset(void) {
+    memset(sim_dma_regs, 0, sizeof(sim_dma_regs));
+    memset(sim_dma_channel_regs, 0, sizeof(sim_dma_channel_regs));
+    memset(sim_dma_ch, 0, sizeof(sim_dma_ch));
+    memset(sim_uart, 0, sizeof(sim_uart));
+
+    for (uint32_t c = 0; c < SIM_DMA_CHANNELS; ++c) {
+        sim_dma_ch[c].regs = &sim_dma_channel_regs[c];
+        sim_dma_ch[c].dma = &sim_dma_regs[(c < 7) ? 0 : 1];
+        sim_dma_ch[c].shift = ((c < 7) ? c : (c - 7)) * 4;
+    }
+
+    for (uint32_t i = 0; i < SIM_UART_NUM; ++i) {
+        sim_uart_t *u = &sim_uart[i];
+
+        u->regs = (USART_TypeDef *)sim_uart_desc[i].base;
+        u->pclk = sim_uart_desc[i].pclk;
+        u->rx_dma = sim_uart_desc[i].rx_dma;
+        u->tx_dma = sim_uart_desc[i].tx_dma;
+        u->sr = SIM_USART_SR_RESET;
+        u->tx_end = SIM_NEVER;
+        u->rx_end = SIM_NEVER;
+        u->rx_since = SIM_NEVER;
+        u->idle_at = SIM_NEVER;
+
+        memset(u->regs, 0, sizeof(USART_TypeDef));
+        sim_uart_publish(u);
+    }
+}
+
+/**
+ * @brief Apply the register writes of CSP, serve the DMA requests.
+ *
+ */
+static void sim_uart_sync(void) {
+    for (uint32_t d = 0; d < 2; ++d) {
+        uint32_t ifcr = sim_dma_regs[d].IFCR;
+        sim_dma_regs[d].IFCR = 0;
+
+        for (uint32_t c = 0; (c < SIM_DMA_CHANNELS) && (ifcr != 0); ++c) {
+            sim_dma_ch_t *ch = &sim_dma_ch[c];
+            if (ch->dma != &sim_dma_regs[d]) {
+                continue;
+            }
+
+            uint32_t clear = (ifcr >> ch->shift) & 0x0FU;
+            ch->flags &= (clear & DMA_FLAG_GL1) ? 0 : ~clear;
+        }
+    }
+
+    for (uint32_t c = 0; c < SIM_DMA_CHANNELS; ++c) {
+        sim_dma_ch_sync(&sim_dma_ch[c]);
+    }
+
+    for (uint32_t i = 0; i < SIM_UART_NUM; ++i) {
+        sim_uart_t *u = &sim_uart[i];
+
+        sim_uart_apply_sr(u);
+        sim_uart_track_rx(u, sim_now());
+        sim_uart_rx_dma(u);
+        sim_uart_tx_dma(u, sim_now());
+        sim_uart_drive_pin(u, sim_now());
+        sim_uart_publish(u);
+    }
+}
+
+/**
+ * @brief Get the time of next event: end of byte on line, IDLE or end of
+ *        byte sent.
+ *
+ * @return Time of next event.
+ */
+static uint64_t sim_uart_next_event(void) {
+    uint64_t next = SIM_NEVER;
+
+    for (uint32_t i = 0; i < SIM_UART_NUM; ++i) {
+        const sim_uart_t *u = &sim_uart[i];
+
+        next = (u->rx_end < next) ? u->rx_end : next;
+        next = (u->idle_at < next) ? u->idle_at : next;
+        next = (u->tx_end < next) ? u->tx_end : next;
+    }
+
+    return next;
+}
+
+/**
+ * @brief Process the events due.
+ *
+ * @param now Current time.
+ */
+static void sim_uart_event(uint64_t now) {
+    for (uint32_t i = 0; i < SIM_UART_NUM; ++i) {
+        sim_uart_t *u = &sim_uart[i];
+
+        if (u->idle_at <= now) {
+            u->idle_at = SIM_NEVER;
+            u->sr |= USART_SR_IDLE;
+            ++u->stats.idle;
+            sim_uart_publish(u);
+        }
+
+        if (u->rx_end <= now) {
+            sim_uart_rx_done(i, now);
+        }
+
+        if (u->tx_end <= now) {
+            sim_uart_tx_done(i, now);
+        }
+
+        sim_uart_drive_pin(u, now);
+    }
+}
+
+static sim_model_t sim_uart_model = {
+    .name = "USART",
+    .reset = sim_uart_reset,
+    .sync = sim_uart_sync,
+    .next_event = sim_uart_next_event,
+    .event = sim_uart_event,
+};
+
+/**
+ * @brief Map the memory of USART registers, register the model and the
+ *        interrupt sources.
+ *
+ */
+__attribute__((constructor)) static void sim_uart_register(void) {
+    static const struct {
+        IRQn_Type irqn;
+        void (*handler)(void);
+    } dma_vectors[SIM_DMA_CHANNELS] = {
+        {DMA1_Channel1_IRQn, DMA1_Channel1_IRQHandler},
+        {DMA1_Channel2_IRQn, DMA1_Channel2_IRQHandler},
+        {DMA1_Channel3_IRQn, DMA1_Channel3_IRQHandler},
+        {DMA1_Channel4_IRQn, DMA1_Channel4_IRQHandler},
+        {DMA1_Channel5_IRQn, DMA1_Channel5_IRQHandler},
+        {DMA1_Channel6_IRQn, DMA1_Channel6_IRQHandler},
+        {DMA1_Channel7_IRQn, DMA1_Channel7_IRQHandler},
+        {DMA2_Channel1_IRQn, DMA2_Channel1_IRQHandler},
+        {DMA2_Channel2_IRQn, DMA2_Channel2_IRQHandler},
+        {DMA2_Channel3_IRQn, DMA2_Channel3_IRQHandler},
+        {DMA2_Channel4_IRQn, DMA2_Channel4_IRQHandler},
+        {DMA2_Channel5_IRQn, DMA2_Channel5_IRQHandler},
+    };
+
+    void *map = mmap((void *)PERIPH_BASE, SIM_UART_MAP_SIZE,
+                     PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if (map != (void *)PERIPH_BASE) {
+        fprintf(stderr, "sim: can not map the USARTs at 0x%08lx\n",
+                (unsigned long)PERIPH_BASE);
+        abort();
+    }
+
+    sim_model_register(&sim_uart_model);
+
+    for (uintptr_t i = 0; i < SIM_UART_NUM; ++i) {
+        sim_irq_register(sim_uart_desc[i].irqn, sim_uart_desc[i].handler,
+                         sim_uart_irq_line, (void *)i);
+    }
+
+    for (uintptr_t c = 0; c < SIM_DMA_CHANNELS; ++c) {
+        sim_irq_register(dma_vectors[c].irqn, dma_vectors[c].handler,
+                         sim_dma_irq_line, (void *)c);
+    }
+
+    sim_uart_reset();
+}
+
+/**
+ * @}
+ */
+
+/*****************************************************************************
+ * @defgroup Control of USARTs and peers.
+ * @{
+ */
+
+/**
+ * @brief Get the CPU cycles of one bit of USART, by `BRR`.
+ *
+ * @param uart Index of USART, 0 ~ 4: USART1 ~ UART5.
+ * @return Cycles, 0 if `BRR` is not set.
+ */
+uint32_t sim_uart_bit_cycles(uint32_t uart) {
+    const sim_uart_t *u = &sim_uart[uart];
+    uint64_t brr = u->regs->BRR & 0xFFFFU;
+
+    return (uint32_t)(brr * SIM_HCLK_FREQ / u->pclk);
+}
+
+/**
+ * @brief Get the CPU cycles of one frame of USART.
+ *
+ * @param uart Index of USART.
+ * @return Cycles, 0 if `BRR` is not set.
+ */
+uint32_t sim_uart_frame_cycles(uint32_t uart) {
+    return sim_uart_frame_bits(&sim_uart[uart]) * sim_uart_bit_cycles(uart);
+}
+
+/**
+ * @brief Set the rate of peer, it is the same as USART after reset.
+ *
+ * @param uart Index of USART.
+ * @param baud_rate Baud rate, 0: the same as USART.
+ * @note The USART receives the bytes with FE if the rates differ by more
+ *       than 3%.
+ */
+void sim_uart_set_peer_rate(uint32_t uart, uint32_t baud_rate) {
+    sim_uart[uart].peer_rate = baud_rate;
+}
+
+/**
+ * @brief Set the RX pin driven by the peer, none after reset.
+ *
+ * @param uart Index of USART.
+ * @param port The GPIO port, NULL: none.
+ * @param pin The pin.
+ * @note The pin depends on the remap of AFIO, it is not taken from the
+ *       registers.
+ */
+void sim_uart_set_rx_pin(uint32_t uart, GPIO_TypeDef *port, uint16_t pin) {
+    sim_uart_t *u = &sim_uart[uart];
+
+    u->rx_port = port;
+    u->rx_pin = pin;
+    sim_uart_drive_pin(u, sim_now());
+}
+
+/**
+ * @brief Queue the bytes for peer to send back-to-back.
+ *
+ * @param uart Index of USART.
+ * @param data The data.
+ * @param len Length of data.
+ * @return The bytes queued, less than `len` if the queue is full.
+ */
+uint32_t sim_uart_peer_send(uint32_t uart, const void *data, uint32_t len) {
+    sim_uart_t *u = &sim_uart[uart];
+    const uint8_t *bytes = data;
+    uint32_t count = 0;
+
+    while ((count < len) && (u->queue_count < SIM_UART_PEER_QUEUE)) {
+        uint32_t tail = (u->queue_head + u->queue_count) % SIM_UART_PEER_QUEUE;
+
+        u->queue[tail] = (sim_uart_byte_t){bytes[count], (uint8_t)u->inject,
+                                           u->gap};
+        u->inject = 0;
+        u->gap = 0;
+        ++u->queue_count;
+        ++count;
+    }
+
+    if ((count != 0) && (u->rx_end == SIM_NEVER)) {
+        uint64_t now = sim_now();
+        sim_uart_rx_schedule(uart, (u->rx_free > now) ? u->rx_free : now);
+        sim_uart_drive_pin(u, now);
+    }
+
+    return count;
+}
+
+/**
+ * @brief Keep the line idle before the next byte queued.
+ *
+ * @param uart Index of USART.
+ * @param bits Idle time. Unit: bit of peer.
+ */
+void sim_uart_peer_idle(uint32_t uart, uint32_t bits) {
+    sim_uart[uart].gap += bits;
+}
+
+/**
+ * @brief Mark the next byte queued with errors.
+ *
+ * @param uart Index of USART.
+ * @param flags `USART_SR_PE`, `USART_SR_FE` or `USART_SR_NE`: the byte is
+ *              received with the flag. `USART_SR_ORE`: the byte is lost by
+ *              overrun.
+ */
+void sim_uart_inject_error(uint32_t uart, uint32_t flags) {
+    sim_uart[uart].inject |= flags & SIM_USART_SR_ERRORS;
+}
+
+/**
+ * @brief Get the bytes waiting to send by peer, include the one on line.
+ *
+ * @param uart Index of USART.
+ * @return Number of bytes.
+ */
+uint32_t sim_uart_peer_pending(uint32_t uart) {
+    return sim_uart[uart].queue_count;
+}
+
+/**
+ * @brief Get the bytes received by peer since reset.
+ *
+ * @param uart Index of USART.
+ * @return Number of bytes.
+ */
+uint32_t sim_uart_peer_received(uint32_t uart) {
+    return sim_uart[uart].received;
+}
+
+/**
+ * @brief Get the oldest bytes in the receive log of peer. The log keeps the
+ *        first `SIM_UART_PEER_LOG` bytes not got yet.
+ *
+ * @param uart Index of USART.
+ * @param[out] buf The buf.
+ * @param len Size of buf.
+ * @return The bytes got.
+ */
+uint32_t sim_uart_peer_recv(uint32_t uart, void *buf, uint32_t len) {
+    sim_uart_t *u = &sim_uart[uart];
+    uint8_t *bytes = buf;
+    uint32_t count = 0;
+
+    while ((count < len) && (u->log_count != 0)) {
+        bytes[count++] = u->log[u->log_head];
+        u->log_head = (u->log_head + 1) % SIM_UART_PEER_LOG;
+        --u->log_count;
+    }
+
+    return count;
+}
+
+/**
+ * @brief Get the counters of USART.
+ *
+ * @param uart Index of USART.
+ * @return The counters.
+ */
+const sim_uart_stats_t *sim_uart_get_stats(uint32_t uart) {
+    return &sim_uart[uart].stats;
+}
+
+/**
+ * @}
+ */
+
+/*****************************************************************************
+ * @defgroup HAL of DMA.
+ * @{
+ */
+
+/**
+ * @brief Charge a HAL call and apply the pending writes.
+ *
+ */
+static void sim_uart_hal_enter(void) {
+    sim_charge(SIM_COST_HAL_CALL);
+    sim_sync();
+}
+
+/**
+ * @brief Start a transfer with interrupts, `HAL_DMA_Start_IT()` of the
+ *        host, the memory address is a pointer.
+ *
+ * @param hdma The handle.
+ * @param periph Address of peripheral.
+ * @param mem Address of memory.
+ * @param len Count of transfers.
+ * @return HAL status.
+ */
+static HAL_StatusTypeDef sim_dma_start_it(DMA_HandleTypeDef *hdma,
+                                          uint32_t periph, uint8_t *mem,
+                                          uint32_t len) {
+    __HAL_LOCK(hdma);
+
+    if (hdma->State != HAL_DMA_STATE_READY) {
+        __HAL_UNLOCK(hdma);
+        return HAL_BUSY;
+    }
+
+    hdma->State = HAL_DMA_STATE_BUSY;
+    hdma->ErrorCode = HAL_DMA_ERROR_NONE;
+
+    __HAL_DMA_DISABLE(hdma);
+    hdma->DmaBaseAddress->IFCR = DMA_FLAG_GL1 << hdma->ChannelIndex;
+    hdma->Instance->CNDTR = len;
+    hdma->Instance->CPAR = periph;
+    hdma->Instance->CMAR = (uint32_t)(uintptr_t)mem;
+    sim_dma_identify(hdma)->mem = mem;
+
+    if (hdma->XferHalfCpltCallback != NULL) {
+        __HAL_DMA_ENABLE_IT(hdma, DMA_IT_TC | DMA_IT_HT | DMA_IT_TE);
+    } else {
+        __HAL_DMA_DISABLE_IT(hdma, DMA_IT_HT);
+        __HAL_DMA_ENABLE_IT(hdma, DMA_IT_TC | DMA_IT_TE);
+    }
+
+    __HAL_DMA_ENABLE(hdma);
+    sim_uart_sync();
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef *hdma) {
+    if (hdma == NULL) {
+        return HAL_ERROR;
+    }
+
+    sim_uart_hal_enter();
+
+    uint32_t index = (uint32_t)(sim_dma_identify(hdma) - sim_dma_ch);
+    hdma->DmaBaseAddress = (index < 7) ? DMA1 : DMA2;
+    hdma->ChannelIndex = ((index < 7) ? index : (index - 7)) * 4;
+
+    hdma->Instance->CCR = hdma->Init.Direction | hdma->Init.PeriphInc |
+                          hdma->Init.MemInc | hdma->Init.PeriphDataAlignment |
+                          hdma->Init.MemDataAlignment | hdma->Init.Mode |
+                          hdma->Init.Priority;
+
+    hdma->ErrorCode = HAL_DMA_ERROR_NONE;
+    hdma->State = HAL_DMA_STATE_READY;
+    hdma->Lock = HAL_UNLOCKED;
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DMA_DeInit(DMA_HandleTypeDef *hdma) {
+    if (hdma == NULL) {
+        return HAL_ERROR;
+    }
+
+    sim_uart_hal_enter();
+
+    hdma->Instance->CCR = 0;
+    hdma->Instance->CNDTR = 0;
+    hdma->Instance->CPAR = 0;
+    hdma->Instance->CMAR = 0;
+    hdma->DmaBaseAddress->IFCR = DMA_FLAG_GL1 << hdma->ChannelIndex;
+
+    hdma->XferCpltCallback = NULL;
+    hdma->XferHalfCpltCallback = NULL;
+    hdma->XferErrorCallback = NULL;
+    hdma->XferAbortCallback = NULL;
+    hdma->ErrorCode = HAL_DMA_ERROR_NONE;
+    hdma->State = HAL_DMA_STATE_RESET;
+    __HAL_UNLOCK(hdma);
+
+    sim_uart_sync();
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DMA_Abort(DMA_HandleTypeDef *hdma) {
+    if (hdma->State != HAL_DMA_STATE_BUSY) {
+        hdma->ErrorCode = HAL_DMA_ERROR_NO_XFER;
+        __HAL_UNLOCK(hdma);
+        return HAL_ERROR;
+    }
+
+    sim_uart_hal_enter();
+
+    __HAL_DMA_DISABLE_IT(hdma, DMA_IT_TC | DMA_IT_HT | DMA_IT_TE);
+    __HAL_DMA_DISABLE(hdma);
+    hdma->DmaBaseAddress->IFCR = DMA_FLAG_GL1 << hdma->ChannelIndex;
+
+    hdma->State = HAL_DMA_STATE_READY;
+    __HAL_UNLOCK(hdma);
+
+    sim_uart_sync();
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DMA_Abort_IT(DMA_HandleTypeDef *hdma) {
+    if (hdma->State != HAL_DMA_STATE_BUSY) {
+        hdma->ErrorCode = HAL_DMA_ERROR_NO_XFER;
+        return HAL_ERROR;
+    }
+
+    sim_uart_hal_enter();
+
+    __HAL_DMA_DISABLE_IT(hdma, DMA_IT_TC | DMA_IT_HT | DMA_IT_TE);
+    __HAL_DMA_DISABLE(hdma);
+    hdma->DmaBaseAddress->IFCR = DMA_FLAG_GL1 << hdma->ChannelIndex;
+    sim_uart_sync();
+
+    hdma->State = HAL_DMA_STATE_READY;
+    __HAL_UNLOCK(hdma);
+
+    if (hdma->XferAbortCallback != NULL) {
+        hdma->XferAbortCallback(hdma);
+    }
+
+    return HAL_OK;
+}
+
+void HAL_DMA_IRQHandler(DMA_HandleTypeDef *hdma) {
+    sim_uart_hal_enter();
+
+    uint32_t flags = hdma->DmaBaseAddress->ISR;
+    uint32_t its = hdma->Instance->CCR;
+
+    if ((flags & __HAL_DMA_GET_HT_FLAG_INDEX(hdma)) && (its & DMA_IT_HT)) {
+        if (!(its & DMA_CCR_CIRC)) {
+            __HAL_DMA_DISABLE_IT(hdma, DMA_IT_HT);
+        }
+
+        __HAL_DMA_CLEAR_FLAG(hdma, __HAL_DMA_GET_HT_FLAG_INDEX(hdma));
+        sim_uart_sync();
+
+        if (hdma->XferHalfCpltCallback != NULL) {
+            hdma->XferHalfCpltCallback(hdma);
+        }
+    } else if ((flags & __HAL_DMA_GET_TC_FLAG_INDEX(hdma)) &&
+               (its & DMA_IT_TC)) {
+        if (!(its & DMA_CCR_CIRC)) {
+            __HAL_DMA_DISABLE_IT(hdma, DMA_IT_TE | DMA_IT_TC);
+            hdma->State = HAL_DMA_STATE_READY;
+        }
+
+        __HAL_DMA_CLEAR_FLAG(hdma, __HAL_DMA_GET_TC_FLAG_INDEX(hdma));
+        sim_uart_sync();
+        __HAL_UNLOCK(hdma);
+
+        if (hdma->XferCpltCallback != NULL) {
+            hdma->XferCpltCallback(hdma);
+        }
+    }
+}
+
+HAL_DMA_StateTypeDef HAL_DMA_GetState(const DMA_HandleTypeDef *hdma) {
+    return hdma->State;
+}
+
+uint32_t HAL_DMA_GetError(const DMA_HandleTypeDef *hdma) {
+    return hdma->ErrorCode;
+}
+
+/**
+ * @}
+ */
+
+/*****************************************************************************
+ * @defgroup HAL of UART.
+ * @{
+ */
+
+/**
+ * @brief Stop the reception, `UART_EndRxTransfer()` of HAL.
+ *
+ * @param huart The handle.
+ */
+static void sim_uart_end_rx(UART_HandleTypeDef *huart) {
+    huart->Instance->CR1 &= ~(USART_CR1_RXNEIE | USART_CR1_PEIE);
+    huart->Instance->CR3 &= ~USART_CR3_EIE;
+
+    if (huart->ReceptionType == HAL_UART_RECEPTION_TOIDLE) {
+        huart->Instance->CR1 &= ~USART_CR1_IDLEIE;
+    }
+
+    huart->RxState = HAL_UART_STATE_READY;
+    huart->ReceptionType = HAL_UART_RECEPTION_STANDARD;
+}
+
+/**
+ * @brief Read `DR` by CPU.
+ *
+ * @param huart The handle.
+ * @return The received byte.
+ */
+static uint8_t sim_uart_read_dr(UART_HandleTypeDef *huart) {
+    sim_uart_t *u = sim_uart_identify(huart->Instance);
+
+    sim_uart_apply_sr(u);
+    u->sr &= ~USART_SR_RXNE;
+    sim_uart_publish(u);
+
+    return u->rdr;
+}
+
+/**
+ * @brief Wait for a flag of `SR`, `UART_WaitOnFlagUntilTimeout()` of HAL.
+ *
+ * @param huart The handle.
+ * @param flag The flag.
+ * @param tickstart Tick of start.
+ * @param timeout Timeout. Unit: ms.
+ * @return HAL status.
+ */
+static HAL_StatusTypeDef sim_uart_wait_flag(UART_HandleTypeDef *huart,
+                                            uint32_t flag, uint32_t tickstart,
+                                            uint32_t timeout) {
+    while (!__HAL_UART_GET_FLAG(huart, flag)) {
+        if ((timeout != HAL_MAX_DELAY) &&
+            ((timeout == 0) || (HAL_GetTick() - tickstart > timeout))) {
+            return HAL_TIMEOUT;
+        }
+    }
+
+    return HAL_OK;
+}
+
+/**
+ * @brief Receive a byte in interrupt mode, `UART_Receive_IT()` of HAL.
+ *
+ * @param huart The handle.
+ */
+static void sim_uart_receive_it(UART_HandleTypeDef *huart) {
+    if (huart->RxState != HAL_UART_STATE_BUSY_RX) {
+        return;
+    }
+
+    *huart->pRxBuffPtr++ = sim_uart_read_dr(huart);
+
+    if (--huart->RxXferCount == 0) {
+        huart->Instance->CR1 &= ~(USART_CR1_RXNEIE | USART_CR1_PEIE);
+        huart->Instance->CR3 &= ~USART_CR3_EIE;
+        huart->RxState = HAL_UART_STATE_READY;
+        HAL_UART_RxCpltCallback(huart);
+    }
+}
+
+/**
+ * @brief DMA transfer complete of reception.
+ *
+ * @param hdma The handle of DMA.
+ */
+static void sim_uart_dma_rx_cplt(DMA_HandleTypeDef *hdma) {
+    UART_HandleTypeDef *huart = hdma->Parent;
+
+    if (!(hdma->Instance->CCR & DMA_CCR_CIRC)) {
+        huart->RxXferCount = 0;
+        huart->Instance->CR1 &= ~USART_CR1_PEIE;
+        huart->Instance->CR3 &= ~(USART_CR3_EIE | USART_CR3_DMAR);
+        huart->RxState = HAL_UART_STATE_READY;
+    }
+
+    HAL_UART_RxCpltCallback(huart);
+}
+
+/**
+ * @brief DMA half transfer of reception.
+ *
+ * @param hdma The handle of DMA.
+ */
+static void sim_uart_dma_rx_half(DMA_HandleTypeDef *hdma) {
+    HAL_UART_RxHalfCpltCallback(hdma->Parent);
+}
+
+/**
+ * @brief DMA transfer complete of transmission, wait for `TC` of USART.
+ *
+ * @param hdma The handle of DMA.
+ */
+static void sim_uart_dma_tx_cplt(DMA_HandleTypeDef *hdma) {
+    UART_HandleTypeDef *huart = hdma->Parent;
+
+    if (!(hdma->Instance->CCR & DMA_CCR_CIRC)) {
+        huart->TxXferCount = 0;
+        huart->Instance->CR3 &= ~USART_CR3_DMAT;
+        huart->Instance->CR1 |= USART_CR1_TCIE;
+    } else {
+        HAL_UART_TxCpltCallback(huart);
+    }
+}
+
+/**
+ * @brief DMA half transfer of transmission.
+ *
+ * @param hdma The handle of DMA.
+ */
+static void sim_uart_dma_tx_half(DMA_HandleTypeDef *hdma) {
+    HAL_UART_TxHalfCpltCallback(hdma->Parent);
+}
+
+/**
+ * @brief DMA is aborted by an error of reception.
+ *
+ * @param hdma The handle of DMA.
+ */
+static void sim_uart_dma_abort_on_error(DMA_HandleTypeDef *hdma) {
+    UART_HandleTypeDef *huart = hdma->Parent;
+
+    huart->RxXferCount = 0;
+    huart->TxXferCount = 0;
+    HAL_UART_ErrorCallback(huart);
+}
+
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef *huart) {
+    if ((huart == NULL) || (huart->Init.BaudRate == 0)) {
+        return HAL_ERROR;
+    }
+
+    sim_uart_hal_enter();
+
+    if (huart->gState == HAL_UART_STATE_RESET) {
+        huart->Lock = HAL_UNLOCKED;
+        HAL_UART_MspInit(huart);
+    }
+
+    huart->gState = HAL_UART_STATE_BUSY;
+    __HAL_UART_DISABLE(huart);
+
+    USART_TypeDef *regs = huart->Instance;
+    uint32_t pclk = (regs == USART1) ? HAL_RCC_GetPCLK2Freq()
+                                     : HAL_RCC_GetPCLK1Freq();
+
+    regs->CR2 = (regs->CR2 & ~(USART_CR2_STOP | USART_CR2_LINEN |
+                               USART_CR2_CLKEN)) |
+                huart->Init.StopBits;
+    regs->CR1 = (regs->CR1 & ~(USART_CR1_M | USART_CR1_PCE | USART_CR1_PS |
+                               USART_CR1_TE | USART_CR1_RE)) |
+                huart->Init.WordLength | huart->Init.Parity | huart->Init.Mode;
+    regs->CR3 = (regs->CR3 & ~(USART_CR3_RTSE | USART_CR3_CTSE |
+                               USART_CR3_SCEN | USART_CR3_HDSEL |
+                               USART_CR3_IREN)) |
+                huart->Init.HwFlowCtl;
+    /* Oversampling by 16, BRR is the rounded fPCLK / baud rate. */
+    regs->BRR = (pclk + huart->Init.BaudRate / 2) / huart->Init.BaudRate;
+
+    __HAL_UART_ENABLE(huart);
+
+    huart->ErrorCode = HAL_UART_ERROR_NONE;
+    huart->gState = HAL_UART_STATE_READY;
+    huart->RxState = HAL_UART_STATE_READY;
+    huart->ReceptionType = HAL_UART_RECEPTION_STANDARD;
+
+    sim_uart_sync();
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_DeInit(UART_HandleTypeDef *huart) {
+    if (huart == NULL) {
+        return HAL_ERROR;
+    }
+
+    sim_uart_hal_enter();
+
+    huart->gState = HAL_UART_STATE_BUSY;
+    __HAL_UART_DISABLE(huart);
+    HAL_UART_MspDeInit(huart);
+
+    huart->ErrorCode = HAL_UART_ERROR_NONE;
+    huart->gState = HAL_UART_STATE_RESET;
+    huart->RxState = HAL_UART_STATE_RESET;
+    huart->ReceptionType = HAL_UART_RECEPTION_STANDARD;
+    __HAL_UNLOCK(huart);
+
+    sim_uart_sync();
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef *huart,
+                                    const uint8_t *data, uint16_t size,
+                                    uint32_t timeout) {
+    if (huart->gState != HAL_UART_STATE_READY) {
+        return HAL_BUSY;
+    }
+
+    if ((data == NULL) || (size == 0)) {
+        return HAL_ERROR;
+    }
+
+    sim_uart_hal_enter();
+
+    huart->ErrorCode = HAL_UART_ERROR_NONE;
+    huart->gState = HAL_UART_STATE_BUSY_TX;
+    huart->TxXferSize = size;
+    huart->TxXferCount = size;
+
+    sim_uart_t *u = sim_uart_identify(huart->Instance);
+    uint32_t tickstart = HAL_GetTick();
+
+    while (huart->TxXferCount > 0) {
+        if (sim_uart_wait_flag(huart, UART_FLAG_TXE, tickstart, timeout) !=
+            HAL_OK) {
+            huart->gState = HAL_UART_STATE_READY;
+            return HAL_TIMEOUT;
+        }
+
+        sim_uart_apply_sr(u);
+        sim_uart_tx_write(u, *data++, sim_now());
+        sim_uart_publish(u);
+        --huart->TxXferCount;
+    }
+
+    if (sim_uart_wait_flag(huart, UART_FLAG_TC, tickstart, timeout) !=
+        HAL_OK) {
+        huart->gState = HAL_UART_STATE_READY;
+        return HAL_TIMEOUT;
+    }
+
+    huart->gState = HAL_UART_STATE_READY;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef *huart,
+                                        const uint8_t *data, uint16_t size) {
+    if (huart->gState != HAL_UART_STATE_READY) {
+        return HAL_BUSY;
+    }
+
+    if ((data == NULL) || (size == 0)) {
+        return HAL_ERROR;
+    }
+
+    sim_uart_hal_enter();
+
+    huart->pTxBuffPtr = data;
+    huart->TxXferSize = size;
+    huart->TxXferCount = size;
+    huart->ErrorCode = HAL_UART_ERROR_NONE;
+    huart->gState = HAL_UART_STATE_BUSY_TX;
+
+    huart->hdmatx->XferCpltCallback = sim_uart_dma_tx_cplt;
+    huart->hdmatx->XferHalfCpltCallback = sim_uart_dma_tx_half;
+    huart->hdmatx->XferErrorCallback = NULL;
+    huart->hdmatx->XferAbortCallback = NULL;
+
+    sim_dma_start_it(huart->hdmatx, (uint32_t)(uintptr_t)&huart->Instance->DR,
+                     (uint8_t *)data, size);
+
+    __HAL_UART_CLEAR_FLAG(huart, UART_FLAG_TC);
+    huart->Instance->CR3 |= USART_CR3_DMAT;
+
+    sim_uart_sync();
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Receive_IT(UART_HandleTypeDef *huart,
+                                      uint8_t *data, uint16_t size) {
+    if (huart->RxState != HAL_UART_STATE_READY) {
+        return HAL_BUSY;
+    }
+
+    if ((data == NULL) || (size == 0)) {
+        return HAL_ERROR;
+    }
+
+    sim_uart_hal_enter();
+
+    huart->ReceptionType = HAL_UART_RECEPTION_STANDARD;
+    huart->pRxBuffPtr = data;
+    huart->RxXferSize = size;
+    huart->RxXferCount = size;
+    huart->ErrorCode = HAL_UART_ERROR_NONE;
+    huart->RxState = HAL_UART_STATE_BUSY_RX;
+
+    if (huart->Init.Parity != UART_PARITY_NONE) {
+        huart->Instance->CR1 |= USART_CR1_PEIE;
+    }
+    huart->Instance->CR3 |= USART_CR3_EIE;
+    huart->Instance->CR1 |= USART_CR1_RXNEIE;
+
+    sim_uart_sync();
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Receive_DMA(UART_HandleTypeDef *huart,
+                                       uint8_t *data, uint16_t size) {
+    if (huart->RxState != HAL_UART_STATE_READY) {
+        return HAL_BUSY;
+    }
+
+    if ((data == NULL) || (size == 0)) {
+        return HAL_ERROR;
+    }
+
+    sim_uart_hal_enter();
+
+    huart->ReceptionType = HAL_UART_RECEPTION_STANDARD;
+    huart->pRxBuffPtr = data;
+    huart->RxXferSize = size;
+    huart->ErrorCode = HAL_UART_ERROR_NONE;
+    huart->RxState = HAL_UART_STATE_BUSY_RX;
+
+    huart->hdmarx->XferCpltCallback = sim_uart_dma_rx_cplt;
+    huart->hdmarx->XferHalfCpltCallback = sim_uart_dma_rx_half;
+    huart->hdmarx->XferErrorCallback = NULL;
+    huart->hdmarx->XferAbortCallback = NULL;
+
+    sim_dma_start_it(huart->hdmarx, (uint32_t)(uintptr_t)&huart->Instance->DR,
+                     data, size);
+
+    __HAL_UART_CLEAR_OREFLAG(huart);
+
+    if (huart->Init.Parity != UART_PARITY_NONE) {
+        huart->Instance->CR1 |= USART_CR1_PEIE;
+    }
+    huart->Instance->CR3 |= USART_CR3_EIE | USART_CR3_DMAR;
+
+    sim_uart_sync();
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UARTEx_ReceiveToIdle(UART_HandleTypeDef *huart,
+                                           uint8_t *data, uint16_t size,
+                                           uint16_t *rx_len,
+                                           uint32_t timeout) {
+    if (huart->RxState != HAL_UART_STATE_READY) {
+        return HAL_BUSY;
+    }
+
+    if ((data == NULL) || (size == 0)) {
+        return HAL_ERROR;
+    }
+
+    sim_uart_hal_enter();
+
+    huart->ErrorCode = HAL_UART_ERROR_NONE;
+    huart->RxState = HAL_UART_STATE_BUSY_RX;
+    huart->ReceptionType = HAL_UART_RECEPTION_TOIDLE;
+    huart->RxXferSize = size;
+    huart->RxXferCount = size;
+
+    uint32_t tickstart = HAL_GetTick();
+    *rx_len = 0;
+
+    while (huart->RxXferCount > 0) {
+        uint32_t sr = sim_usart_read_sr(huart->Instance);
+
+        if (sr & USART_SR_IDLE) {
+            __HAL_UART_CLEAR_IDLEFLAG(huart);
+            if (*rx_len > 0) {
+                huart->RxState = HAL_UART_STATE_READY;
+                return HAL_OK;
+            }
+        }
+
+        if (sr & USART_SR_RXNE) {
+            *data++ = sim_uart_read_dr(huart);
+            ++*rx_len;
+            --huart->RxXferCount;
+        }
+
+        if ((timeout != HAL_MAX_DELAY) &&
+            ((timeout == 0) || (HAL_GetTick() - tickstart > timeout))) {
+            huart->RxState = HAL_UART_STATE_READY;
+            return HAL_TIMEOUT;
+        }
+    }
+
+    *rx_len = huart->RxXferSize - huart->RxXferCount;
+    huart->RxState = HAL_UART_STATE_READY;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_DMAStop(UART_HandleTypeDef *huart) {
+    sim_uart_hal_enter();
+
+    if ((huart->gState == HAL_UART_STATE_BUSY_TX) &&
+        (huart->Instance->CR3 & USART_CR3_DMAT)) {
+        huart->Instance->CR3 &= ~USART_CR3_DMAT;
+        if (huart->hdmatx != NULL) {
+            HAL_DMA_Abort(huart->hdmatx);
+        }
+        huart->Instance->CR1 &= ~(USART_CR1_TXEIE | USART_CR1_TCIE);
+        huart->gState = HAL_UART_STATE_READY;
+    }
+
+    if ((huart->RxState == HAL_UART_STATE_BUSY_RX) &&
+        (huart->Instance->CR3 & USART_CR3_DMAR)) {
+        huart->Instance->CR3 &= ~USART_CR3_DMAR;
+        if (huart->hdmarx != NULL) {
+            HAL_DMA_Abort(huart->hdmarx);
+        }
+        sim_uart_end_rx(huart);
+    }
+
+    sim_uart_sync();
+    return HAL_OK;
+}
+
+void HAL_UART_IRQHandler(UART_HandleTypeDef *huart) {
+    sim_uart_hal_enter();
+
+    uint32_t isrflags = huart->Instance->SR;
+    uint32_t cr1its = huart->Instance->CR1;
+    uint32_t cr3its = huart->Instance->CR3;
+    uint32_t errorflags = isrflags & SIM_USART_SR_ERRORS;
+
+    if (errorflags == 0) {
+        if ((isrflags & USART_SR_RXNE) && (cr1its & USART_CR1_RXNEIE)) {
+            sim_uart_receive_it(huart);
+            return;
+        }
+    } else if ((cr3its & USART_CR3_EIE) ||
+               (cr1its & (USART_CR1_RXNEIE | USART_CR1_PEIE))) {
+        if ((isrflags & USART_SR_PE) && (cr1its & USART_CR1_PEIE)) {
+            huart->ErrorCode |= HAL_UART_ERROR_PE;
+        }
+        if ((isrflags & USART_SR_NE) && (cr3its & USART_CR3_EIE)) {
+            huart->ErrorCode |= HAL_UART_ERROR_NE;
+        }
+        if ((isrflags & USART_SR_FE) && (cr3its & USART_CR3_EIE)) {
+            huart->ErrorCode |= HAL_UART_ERROR_FE;
+        }
+        if ((isrflags & USART_SR_ORE) &&
+            ((cr1its & USART_CR1_RXNEIE) || (cr3its & USART_CR3_EIE))) {
+            huart->ErrorCode |= HAL_UART_ERROR_ORE;
+        }
+
+        if (huart->ErrorCode != HAL_UART_ERROR_NONE) {
+            if ((isrflags & USART_SR_RXNE) && (cr1its & USART_CR1_RXNEIE)) {
+                sim_uart_receive_it(huart);
+            }
+
+            uint32_t dmarequest = huart->Instance->CR3 & USART_CR3_DMAR;
+            if ((huart->ErrorCode & HAL_UART_ERROR_ORE) || dmarequest) {
+                /* Blocking error: the reception is stopped. */
+                sim_uart_end_rx(huart);
+
+                if ((huart->Instance->CR3 & USART_CR3_DMAR) &&
+                    (huart->hdmarx != NULL)) {
+                    huart->Instance->CR3 &= ~USART_CR3_DMAR;
+                    huart->hdmarx->XferAbortCallback =
+                        sim_uart_dma_abort_on_error;
+                    if (HAL_DMA_Abort_IT(huart->hdmarx) != HAL_OK) {
+                        huart->hdmarx->XferAbortCallback(huart->hdmarx);
+                    }
+                } else {
+                    huart->Instance->CR3 &= ~USART_CR3_DMAR;
+                    HAL_UART_ErrorCallback(huart);
+                }
+            } else {
+                /* Non blocking error: the reception goes on. */
+                HAL_UART_ErrorCallback(huart);
+                huart->ErrorCode = HAL_UART_ERROR_NONE;
+            }
+        }
+        return;
+    }
+
+    if ((isrflags & USART_SR_TC) && (cr1its & USART_CR1_TCIE)) {
+        huart->Instance->CR1 &= ~USART_CR1_TCIE;
+        huart->gState = HAL_UART_STATE_READY;
+        HAL_UART_TxCpltCallback(huart);
+    }
+}
+
+HAL_UART_StateTypeDef HAL_UART_GetState(const UART_HandleTypeDef *huart) {
+    return (HAL_UART_StateTypeDef)(huart->gState | huart->RxState);
+}
+
+uint32_t HAL_UART_GetError(const UART_HandleTypeDef *huart) {
+    return huart->ErrorCode;
+}
+
+__attribute__((weak)) void HAL_UART_MspInit(UART_HandleTypeDef *huart) {
+    UNUSED(huart);
+}
+
+__attribute__((weak)) void HAL_UART_MspDeInit(UART_HandleTypeDef *huart) {
+    UNUSED(huart);
+}
+
+__attribute__((weak)) void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart) {
+    UNUSED(huart);
+}
+
+__attribute__((weak)) void
+HAL_UART_TxHalfCpltCallback(UART_HandleTypeDef *huart) {
+    UNUSED(huart);
+}
+
+__attribute__((weak)) void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart) {
+    UNUSED(huart);
+}
+
+__attribute__((weak)) void
+HAL_UART_RxHalfCpltCallback(UART_HandleTypeDef *huart) {
+    UNUSED(huart);
+}
+
+__attribute__((weak)) void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart) {
+    UNUSED(huart);
+}
+
+/**
+ * @}
+ */
+
+/*****************************************************************************
+ * @defgroup HAL of USART synchronous mode.
+ * @{
+ */
+
+/**
+ * @brief Wait for a flag of `SR`, `USART_WaitOnFlagUntilTimeout()` of HAL.
+ *
+ * @param husart The handle.
+ * @param flag The flag.
+ * @param tickstart Tick of start.
+ * @param timeout Timeout. Unit: ms.
+ * @return HAL status.
+ */
+static HAL_StatusTypeDef sim_usart_wait_flag(USART_HandleTypeDef *husart,
+                                             uint32_t flag, uint32_t tickstart,
+                                             uint32_t timeout) {
+    while ((sim_usart_read_sr(husart->Instance) & flag) != flag) {
+        if ((timeout != HAL_MAX_DELAY) &&
+            ((timeout == 0) || (HAL_GetTick() - tickstart > timeout))) {
+            return HAL_TIMEOUT;
+        }
+    }
+
+    return HAL_OK;
+}
+
+/**
+ * @brief Write `DR` by CPU.
+ *
+ * @param husart The handle.
+ * @param data The data.
+ */
+static void sim_usart_write_dr(USART_HandleTypeDef *husart, uint8_t data) {
+    sim_uart_t *u = sim_uart_identify(husart->Instance);
+
+    sim_uart_apply_sr(u);
+    sim_uart_tx_write(u, data, sim_now());
+    sim_uart_publish(u);
+}
+
+/**
+ * @brief Read `DR` by CPU.
+ *
+ * @param husart The handle.
+ * @return The received byte.
+ */
+static uint8_t sim_usart_read_dr(USART_HandleTypeDef *husart) {
+    sim_uart_t *u = sim_uart_identify(husart->Instance);
+
+    sim_uart_apply_sr(u);
+    u->sr &= ~USART_SR_RXNE;
+    sim_uart_publish(u);
+
+    return u->rdr;
+}
+
+/**
+ * @brief DMA transfer complete of transmission. Transmit only waits for
+ *        `TC` of USART, transmit and receive ends by the reception.
+ *
+ * @param hdma The handle of DMA.
+ */
+static void sim_usart_dma_tx_cplt(DMA_HandleTypeDef *hdma) {
+    USART_HandleTypeDef *husart = hdma->Parent;
+
+    husart->TxXferCount = 0;
+    if (husart->State == HAL_USART_STATE_BUSY_TX) {
+        husart->Instance->CR3 &= ~USART_CR3_DMAT;
+        husart->Instance->CR1 |= USART_CR1_TCIE;
+    }
+}
+
+/**
+ * @brief DMA transfer complete of reception, the last byte is received at
+ *        the end of its transmission.
+ *
+ * @param hdma The handle of DMA.
+ */
+static void sim_usart_dma_rx_cplt(DMA_HandleTypeDef *hdma) {
+    USART_HandleTypeDef *husart = hdma->Parent;
+
+    husart->RxXferCount = 0;
+    husart->Instance->CR1 &= ~USART_CR1_PEIE;
+    husart->Instance->CR3 &= ~(USART_CR3_EIE | USART_CR3_DMAR |
+                               USART_CR3_DMAT);
+    husart->State = HAL_USART_STATE_READY;
+    HAL_USART_TxRxCpltCallback(husart);
+}
+
+HAL_StatusTypeDef HAL_USART_Init(USART_HandleTypeDef *husart) {
+    if ((husart == NULL) || (husart->Init.BaudRate == 0)) {
+        return HAL_ERROR;
+    }
+
+    sim_uart_hal_enter();
+
+    if (husart->State == HAL_USART_STATE_RESET) {
+        husart->Lock = HAL_UNLOCKED;
+        HAL_USART_MspInit(husart);
+    }
+
+    husart->State = HAL_USART_STATE_BUSY;
+    husart->Instance->CR1 &= ~USART_CR1_UE;
+
+    USART_TypeDef *regs = husart->Instance;
+    uint32_t pclk = (regs == USART1) ? HAL_RCC_GetPCLK2Freq()
+                                     : HAL_RCC_GetPCLK1Freq();
+
+    regs->CR2 = (regs->CR2 & ~(USART_CR2_CPOL | USART_CR2_CPHA |
+                               USART_CR2_LBCL | USART_CR2_STOP |
+                               USART_CR2_LINEN)) |
+                USART_CR2_CLKEN | husart->Init.CLKPolarity |
+                husart->Init.CLKPhase | husart->Init.CLKLastBit |
+                husart->Init.StopBits;
+    regs->CR1 = (regs->CR1 & ~(USART_CR1_M | USART_CR1_PCE | USART_CR1_PS |
+                               USART_CR1_TE | USART_CR1_RE)) |
+                husart->Init.WordLength | husart->Init.Parity |
+                husart->Init.Mode;
+    regs->CR3 &= ~(USART_CR3_RTSE | USART_CR3_CTSE | USART_CR3_SCEN |
+                   USART_CR3_HDSEL | USART_CR3_IREN);
+    /* Same divider as asynchronous mode, CK runs at the baud rate. */
+    regs->BRR = (pclk + husart->Init.BaudRate / 2) / husart->Init.BaudRate;
+
+    husart->Instance->CR1 |= USART_CR1_UE;
+
+    husart->ErrorCode = HAL_USART_ERROR_NONE;
+    husart->State = HAL_USART_STATE_READY;
+
+    sim_uart_sync();
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_USART_DeInit(USART_HandleTypeDef *husart) {
+    if (husart == NULL) {
+        return HAL_ERROR;
+    }
+
+    sim_uart_hal_enter();
+
+    husart->State = HAL_USART_STATE_BUSY;
+    husart->Instance->CR1 &= ~USART_CR1_UE;
+    HAL_USART_MspDeInit(husart);
+
+    husart->ErrorCode = HAL_USART_ERROR_NONE;
+    husart->State = HAL_USART_STATE_RESET;
+    __HAL_UNLOCK(husart);
+
+    sim_uart_sync();
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_USART_Transmit(USART_HandleTypeDef *husart,
+                                     const uint8_t *data, uint16_t size,
+                                     uint32_t timeout) {
+    if (husart->State != HAL_USART_STATE_READY) {
+        return HAL_BUSY;
+    }
+
+    if ((data == NULL) || (size == 0)) {
+        return HAL_ERROR;
+    }
+
+    sim_uart_hal_enter();
+
+    husart->ErrorCode = HAL_USART_ERROR_NONE;
+    husart->State = HAL_USART_STATE_BUSY_TX;
+    husart->TxXferSize = size;
+    husart->TxXferCount = size;
+
+    uint32_t tickstart = HAL_GetTick();
+
+    while (husart->TxXferCount > 0) {
+        if (sim_usart_wait_flag(husart, USART_SR_TXE, tickstart, timeout) !=
+            HAL_OK) {
+            husart->State = HAL_USART_STATE_READY;
+            return HAL_TIMEOUT;
+        }
+
+        sim_usart_write_dr(husart, *data++);
+        --husart->TxXferCount;
+    }
+
+    if (sim_usart_wait_flag(husart, USART_SR_TC, tickstart, timeout) !=
+        HAL_OK) {
+        husart->State = HAL_USART_STATE_READY;
+        return HAL_TIMEOUT;
+    }
+
+    /* The bytes clocked in are not read. */
+    sim_usart_read_sr_dr(husart->Instance);
+
+    husart->State = HAL_USART_STATE_READY;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_USART_TransmitReceive(USART_HandleTypeDef *husart,
+                                            const uint8_t *tx_data,
+                                            uint8_t *rx_data, uint16_t size,
+                                            uint32_t timeout) {
+    if (husart->State != HAL_USART_STATE_READY) {
+        return HAL_BUSY;
+    }
+
+    if ((tx_data == NULL) || (rx_data == NULL) || (size == 0)) {
+        return HAL_ERROR;
+    }
+
+    sim_uart_hal_enter();
+
+    husart->ErrorCode = HAL_USART_ERROR_NONE;
+    husart->State = HAL_USART_STATE_BUSY_TX_RX;
+    husart->TxXferSize = size;
+    husart->TxXferCount = size;
+    husart->RxXferSize = size;
+    husart->RxXferCount = size;
+
+    uint32_t tickstart = HAL_GetTick();
+
+    while (husart->TxXferCount > 0) {
+        if (sim_usart_wait_flag(husart, USART_SR_TXE, tickstart, timeout) !=
+            HAL_OK) {
+            husart->State = HAL_USART_STATE_READY;
+            return HAL_TIMEOUT;
+        }
+
+        sim_usart_write_dr(husart, *tx_data++);
+        --husart->TxXferCount;
+
+        if (sim_usart_wait_flag(husart, USART_SR_RXNE, tickstart, timeout) !=
+            HAL_OK) {
+            husart->State = HAL_USART_STATE_READY;
+            return HAL_TIMEOUT;
+        }
+
+        *rx_data++ = sim_usart_read_dr(husart);
+        --husart->RxXferCount;
+    }
+
+    husart->State = HAL_USART_STATE_READY;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_USART_Transmit_DMA(USART_HandleTypeDef *husart,
+                                         const uint8_t *data, uint16_t size) {
+    if (husart->State != HAL_USART_STATE_READY) {
+        return HAL_BUSY;
+    }
+
+    if ((data == NULL) || (size == 0)) {
+        return HAL_ERROR;
+    }
+
+    sim_uart_hal_enter();
+
+    husart->pTxBuffPtr = data;
+    husart->TxXferSize = size;
+    husart->TxXferCount = size;
+    husart->ErrorCode = HAL_USART_ERROR_NONE;
+    husart->State = HAL_USART_STATE_BUSY_TX;
+
+    husart->hdmatx->XferCpltCallback = sim_usart_dma_tx_cplt;
+    husart->hdmatx->XferHalfCpltCallback = NULL;
+    husart->hdmatx->XferErrorCallback = NULL;
+    husart->hdmatx->XferAbortCallback = NULL;
+
+    sim_dma_start_it(husart->hdmatx,
+                     (uint32_t)(uintptr_t)&husart->Instance->DR,
+                     (uint8_t *)data, size);
+
+    husart->Instance->SR = ~(uint32_t)USART_SR_TC;
+    husart->Instance->CR3 |= USART_CR3_DMAT;
+
+    sim_uart_sync();
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_USART_TransmitReceive_DMA(USART_HandleTypeDef *husart,
+                                                const uint8_t *tx_data,
+                                                uint8_t *rx_data,
+                                                uint16_t size) {
+    if (husart->State != HAL_USART_STATE_READY) {
+        return HAL_BUSY;
+    }
+
+    if ((tx_data == NULL) || (rx_data == NULL) || (size == 0)) {
+        return HAL_ERROR;
+    }
+
+    sim_uart_hal_enter();
+
+    husart->pTxBuffPtr = tx_data;
+    husart->TxXferSize = size;
+    husart->TxXferCount = size;
+    husart->pRxBuffPtr = rx_data;
+    husart->RxXferSize = size;
+    husart->RxXferCount = size;
+    husart->ErrorCode = HAL_USART_ERROR_NONE;
+    husart->State = HAL_USART_STATE_BUSY_TX_RX;
+
+    husart->hdmarx->XferCpltCallback = sim_usart_dma_rx_cplt;
+    husart->hdmarx->XferHalfCpltCallback = NULL;
+    husart->hdmarx->XferErrorCallback = NULL;
+    husart->hdmarx->XferAbortCallback = NULL;
+    husart->hdmatx->XferCpltCallback = sim_usart_dma_tx_cplt;
+    husart->hdmatx->XferHalfCpltCallback = NULL;
+    husart->hdmatx->XferErrorCallback = NULL;
+    husart->hdmatx->XferAbortCallback = NULL;
+
+    sim_dma_start_it(husart->hdmarx,
+                     (uint32_t)(uintptr_t)&husart->Instance->DR, rx_data,
+                     size);
+    sim_dma_start_it(husart->hdmatx,
+                     (uint32_t)(uintptr_t)&husart->Instance->DR,
+                     (uint8_t *)tx_data, size);
+
+    /* The stale bytes and overrun of last transmission. */
+    sim_usart_read_sr_dr(husart->Instance);
+
+    if (husart->Init.Parity != USART_PARITY_NONE) {
+        husart->Instance->CR1 |= USART_CR1_PEIE;
+    }
+    husart->Instance->CR3 |= USART_CR3_EIE | USART_CR3_DMAR;
+    husart->Instance->CR3 |= USART_CR3_DMAT;
+
+    sim_uart_sync();
+    return HAL_OK;
+}
+
+void HAL_USART_IRQHandler(USART_HandleTypeDef *husart) {
+    sim_uart_hal_enter();
+
+    uint32_t isrflags = husart->Instance->SR;
+    uint32_t cr1its = husart->Instance->CR1;
+    uint32_t cr3its = husart->Instance->CR3;
+    uint32_t errorflags = isrflags & SIM_USART_SR_ERRORS;
+
+    if ((errorflags != 0) && (cr3its & USART_CR3_EIE)) {
+        if (isrflags & USART_SR_PE) {
+            husart->ErrorCode |= HAL_USART_ERROR_PE;
+        }
+        if (isrflags & USART_SR_NE) {
+            husart->ErrorCode |= HAL_USART_ERROR_NE;
+        }
+        if (isrflags & USART_SR_FE) {
+            husart->ErrorCode |= HAL_USART_ERROR_FE;
+        }
+        if (isrflags & USART_SR_ORE) {
+            husart->ErrorCode |= HAL_USART_ERROR_ORE;
+        }
+
+        /* The transfer is stopped. */
+        sim_usart_read_sr_dr(husart->Instance);
+        husart->Instance->CR1 &= ~USART_CR1_PEIE;
+        husart->Instance->CR3 &= ~(USART_CR3_EIE | USART_CR3_DMAR |
+                                   USART_CR3_DMAT);
+        if (husart->hdmarx != NULL) {
+            HAL_DMA_Abort(husart->hdmarx);
+        }
+        if (husart->hdmatx != NULL) {
+            HAL_DMA_Abort(husart->hdmatx);
+        }
+
+        husart->State = HAL_USART_STATE_READY;
+        HAL_USART_ErrorCallback(husart);
+        return;
+    }
+
+    if ((isrflags & USART_SR_TC) && (cr1its & USART_CR1_TCIE)) {
+        husart->Instance->CR1 &= ~USART_CR1_TCIE;
+        husart->State = HAL_USART_STATE_READY;
+        HAL_USART_TxCpltCallback(husart);
+    }
+}
+
+HAL_USART_StateTypeDef HAL_USART_GetState(const USART_HandleTypeDef *husart) {
+    return husart->State;
+}
+
+uint32_t HAL_USART_GetError(const USART_HandleTypeDef *husart) {
+    return husart->ErrorCode;
+}
+
+__attribute__((weak)) void HAL_USART_MspInit(USART_HandleTypeDef *husart) {
+    UNUSED(husart);
+}
+
+__attribute__((weak)) void HAL_USART_MspDeInit(USART_HandleTypeDef *husart) {
+    UNUSED(husart);
+}
+
+__attribute__((weak)) void
+HAL_USART_TxCpltCallback(USART_HandleTypeDef *husart) {
+    UNUSED(husart);
+}
+
+__attribute__((weak)) void
+HAL_USART_TxRxCpltCallback(USART_HandleTypeDef *husart) {
+    UNUSED(husart);
+}
+
+__attribute__((weak)) void
+HAL_USART_ErrorCallback(USART_HandleTypeDef *husart) {
+    UNUSED(husart);
+}
+
+/**
+ * @}
+ */
@@ -0,0 +1,1079 @@
+/**
+ * @file    stm32f1xx_hal.h
+ * @author  Deadline039
+ * @brief   Stand-in of the STM32F1xx HAL for the host build.
+ * @version 3.3.3
+ * @date    2024-10-22
+ * @note    Only the part used by the CSP is declared. The registers and bit
+ *          definitions follow RM0008 and the CMSIS device header of
+ *          STM32F107, the peripherals are variables of the simulator, see
+ *          `sim.h`. The HAL functions are implemented by the models.
+ *
+ *          The USARTs are at their addresses of RM0008 (The simulator maps
+ *          that memory), since the CSP identifies them by `USARTx_BASE`.
+ *          `__HAL_UART_GET_FLAG()` and the `__HAL_UART_CLEAR_xxFLAG()`
+ *          macros call the simulator, so a polling loop lets the time go on
+ *          and the "read SR then DR" sequence is seen by the model. So does
+ *          `DWT`, a loop polling `CYCCNT` and the level of a pin (`IDR`) sees
+ *          both go on.
+ */
+
+#ifndef __STM32F1xx_HAL_H
+#define __STM32F1xx_HAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* clang-format off */
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*****************************************************************************
+ * @defgroup Core and CMSIS.
+ * @{
+ */
+
+#define __IO                volatile
+#define __STATIC_INLINE     static inline
+#define __ALIGNED(x)        __attribute__((aligned(x)))
+#define UNUSED(x)           ((void)(x))
+
+typedef enum {
+    RESET = 0U,
+    SET = !RESET
+} FlagStatus, ITStatus;
+
+typedef enum {
+    DISABLE = 0U,
+    ENABLE = !DISABLE
+} FunctionalState;
+
+typedef enum {
+    HAL_OK = 0x00U,
+    HAL_ERROR = 0x01U,
+    HAL_BUSY = 0x02U,
+    HAL_TIMEOUT = 0x03U
+} HAL_StatusTypeDef;
+
+typedef enum {
+    HAL_UNLOCKED = 0x00U,
+    HAL_LOCKED = 0x01U
+} HAL_LockTypeDef;
+
+#define HAL_MAX_DELAY       0xFFFFFFFFU
+
+#define __HAL_LOCK(h)                                                          \
+    do {                                                                       \
+        if ((h)->Lock == HAL_LOCKED) {                                         \
+            return HAL_BUSY;                                                   \
+        }                                                                      \
+        (h)->Lock = HAL_LOCKED;                                                \
+    } while (0)
+#define __HAL_UNLOCK(h)     ((h)->Lock = HAL_UNLOCKED)
+
+#define __HAL_LINKDMA(h, field, dma)                                           \
+    do {                                                                       \
+        (h)->field = &(dma);                                                   \
+        (dma).Parent = (h);                                                    \
+    } while (0)
+
+typedef int32_t IRQn_Type;
+
+#define DMA1_Channel1_IRQn      11
+#define DMA1_Channel2_IRQn      12
+#define DMA1_Channel3_IRQn      13
+#define DMA1_Channel4_IRQn      14
+#define DMA1_Channel5_IRQn      15
+#define DMA1_Channel6_IRQn      16
+#define DMA1_Channel7_IRQn      17
+#define CAN1_TX_IRQn            19
+#define CAN1_RX0_IRQn           20
+#define CAN1_RX1_IRQn           21
+#define CAN1_SCE_IRQn           22
+#define USART1_IRQn             37
+#define USART2_IRQn             38
+#define USART3_IRQn             39
+#define UART4_IRQn              52
+#define UART5_IRQn              53
+#define DMA2_Channel1_IRQn      56
+#define DMA2_Channel2_IRQn      57
+#define DMA2_Channel3_IRQn      58
+#define DMA2_Channel4_IRQn      59
+#define DMA2_Channel5_IRQn      60
+#define CAN2_TX_IRQn            63
+#define CAN2_RX0_IRQn           64
+#define CAN2_RX1_IRQn           65
+#define CAN2_SCE_IRQn           66
+#define SIM_IRQ_NUM             68
+
+/* The intrinsics are functions of simulator, they are the points where the
+ * register writes are applied and the pending interrupts are taken. */
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t primask);
+void __disable_irq(void);
+void __enable_irq(void);
+void __DMB(void);
+void __DSB(void);
+void __ISB(void);
+uint32_t __REV(uint32_t value);
+uint32_t __RBIT(uint32_t value);
+uint8_t __CLZ(uint32_t value);
+
+typedef struct {
+    __IO uint32_t CTRL;
+    __IO uint32_t CYCCNT;
+} DWT_Type;
+
+typedef struct {
+    __IO uint32_t DHCSR;
+    __IO uint32_t DCRSR;
+    __IO uint32_t DCRDR;
+    __IO uint32_t DEMCR;
+} CoreDebug_Type;
+
+extern DWT_Type sim_dwt;
+extern CoreDebug_Type sim_core_debug;
+
+/* Reads `CYCCNT` with the time of now, see the note of file. */
+DWT_Type *sim_dwt_access(void);
+
+#define DWT                         (sim_dwt_access())
+#define CoreDebug                   (&sim_core_debug)
+#define DWT_CTRL_CYCCNTENA_Msk      (1UL << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk  (1UL << 24)
+
+void HAL_NVIC_SetPriority(IRQn_Type irqn, uint32_t preempt_priority,
+                          uint32_t sub_priority);
+void HAL_NVIC_EnableIRQ(IRQn_Type irqn);
+void HAL_NVIC_DisableIRQ(IRQn_Type irqn);
+
+uint32_t HAL_GetTick(void);
+void HAL_Delay(uint32_t delay);
+uint32_t HAL_RCC_GetSysClockFreq(void);
+uint32_t HAL_RCC_GetHCLKFreq(void);
+uint32_t HAL_RCC_GetPCLK1Freq(void);
+uint32_t HAL_RCC_GetPCLK2Freq(void);
+
+/**
+ * @}
+ */
+
+/*****************************************************************************
+ * @defgroup RCC, AFIO and GPIO.
+ * @{
+ */
+
+typedef struct {
+    __IO uint32_t CRL;
+    __IO uint32_t CRH;
+    __IO uint32_t IDR;
+    __IO uint32_t ODR;
+    __IO uint32_t BSRR;
+    __IO uint32_t BRR;
+    __IO uint32_t LCKR;
+} GPIO_TypeDef;
+
+extern GPIO_TypeDef sim_gpio[5];
+
+#define GPIOA                   (&sim_gpio[0])
+#define GPIOB                   (&sim_gpio[1])
+#define GPIOC                   (&sim_gpio[2])
+#define GPIOD                   (&sim_gpio[3])
+#define GPIOE                   (&sim_gpio[4])
+
+typedef struct {
+    uint32_t Pin;
+    uint32_t Mode;
+    uint32_t Pull;
+    uint32_t Speed;
+} GPIO_InitTypeDef;
+
+typedef enum {
+    GPIO_PIN_RESET = 0U,
+    GPIO_PIN_SET
+} GPIO_PinState;
+
+#define GPIO_PIN_0              ((uint16_t)0x0001)
+#define GPIO_PIN_1              ((uint16_t)0x0002)
+#define GPIO_PIN_2              ((uint16_t)0x0004)
+#define GPIO_PIN_3              ((uint16_t)0x0008)
+#define GPIO_PIN_4              ((uint16_t)0x0010)
+#define GPIO_PIN_5              ((uint16_t)0x0020)
+#define GPIO_PIN_6              ((uint16_t)0x0040)
+#define GPIO_PIN_7              ((uint16_t)0x0080)
+#define GPIO_PIN_8              ((uint16_t)0x0100)
+#define GPIO_PIN_9              ((uint16_t)0x0200)
+#define GPIO_PIN_10             ((uint16_t)0x0400)
+#define GPIO_PIN_11             ((uint16_t)0x0800)
+#define GPIO_PIN_12             ((uint16_t)0x1000)
+#define GPIO_PIN_13             ((uint16_t)0x2000)
+#define GPIO_PIN_14             ((uint16_t)0x4000)
+#define GPIO_PIN_15             ((uint16_t)0x8000)
+
+#define GPIO_MODE_INPUT         0x00000000U
+#define GPIO_MODE_OUTPUT_PP     0x00000001U
+#define GPIO_MODE_OUTPUT_OD     0x00000011U
+#define GPIO_MODE_AF_PP         0x00000002U
+#define GPIO_MODE_AF_OD         0x00000012U
+#define GPIO_MODE_AF_INPUT      GPIO_MODE_INPUT
+#define GPIO_MODE_IT_RISING     0x10110000U
+#define GPIO_MODE_IT_FALLING    0x10210000U
+
+#define GPIO_NOPULL             0x00000000U
+#define GPIO_PULLUP             0x00000001U
+#define GPIO_PULLDOWN           0x00000002U
+
+#define GPIO_SPEED_FREQ_LOW     0x00000002U
+#define GPIO_SPEED_FREQ_MEDIUM  0x00000001U
+#define GPIO_SPEED_FREQ_HIGH    0x00000003U
+
+void HAL_GPIO_Init(GPIO_TypeDef *port, GPIO_InitTypeDef *init);
+void HAL_GPIO_DeInit(GPIO_TypeDef *port, uint32_t pin);
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *port, uint16_t pin);
+void HAL_GPIO_WritePin(GPIO_TypeDef *port, uint16_t pin, GPIO_PinState state);
+
+/* Clocks and remaps have no effect in simulator. */
+#define __HAL_RCC_GPIOA_CLK_ENABLE()        ((void)0)
+#define __HAL_RCC_GPIOB_CLK_ENABLE()        ((void)0)
+#define __HAL_RCC_GPIOC_CLK_ENABLE()        ((void)0)
+#define __HAL_RCC_GPIOD_CLK_ENABLE()        ((void)0)
+#define __HAL_RCC_GPIOE_CLK_ENABLE()        ((void)0)
+#define __HAL_RCC_CAN1_CLK_ENABLE()         ((void)0)
+#define __HAL_RCC_CAN1_CLK_DISABLE()        ((void)0)
+#define __HAL_RCC_CAN2_CLK_ENABLE()         ((void)0)
+#define __HAL_RCC_CAN2_CLK_DISABLE()        ((void)0)
+#define __HAL_AFIO_REMAP_CAN1_1()           ((void)0)
+#define __HAL_AFIO_REMAP_CAN1_2()           ((void)0)
+#define __HAL_AFIO_REMAP_CAN1_3()           ((void)0)
+#define __HAL_AFIO_REMAP_CAN2_ENABLE()      ((void)0)
+#define __HAL_AFIO_REMAP_CAN2_DISABLE()     ((void)0)
+#define __HAL_RCC_DMA1_CLK_ENABLE()         ((void)0)
+#define __HAL_RCC_DMA2_CLK_ENABLE()         ((void)0)
+#define __HAL_RCC_USART1_CLK_ENABLE()       ((void)0)
+#define __HAL_RCC_USART1_CLK_DISABLE()      ((void)0)
+#define __HAL_RCC_USART2_CLK_ENABLE()       ((void)0)
+#define __HAL_RCC_USART2_CLK_DISABLE()      ((void)0)
+#define __HAL_RCC_USART3_CLK_ENABLE()       ((void)0)
+#define __HAL_RCC_USART3_CLK_DISABLE()      ((void)0)
+#define __HAL_RCC_UART4_CLK_ENABLE()        ((void)0)
+#define __HAL_RCC_UART4_CLK_DISABLE()       ((void)0)
+#define __HAL_RCC_UART5_CLK_ENABLE()        ((void)0)
+#define __HAL_RCC_UART5_CLK_DISABLE()       ((void)0)
+#define __HAL_AFIO_REMAP_USART1_ENABLE()    ((void)0)
+#define __HAL_AFIO_REMAP_USART1_DISABLE()   ((void)0)
+#define __HAL_AFIO_REMAP_USART2_ENABLE()    ((void)0)
+#define __HAL_AFIO_REMAP_USART2_DISABLE()   ((void)0)
+#define __HAL_AFIO_REMAP_USART3_ENABLE()    ((void)0)
+#define __HAL_AFIO_REMAP_USART3_PARTIAL()   ((void)0)
+#define __HAL_AFIO_REMAP_USART3_DISABLE()   ((void)0)
+
+/**
+ * @}
+ */
+
+/*****************************************************************************
+ * @defgroup DMA.
+ * @{
+ */
+
+typedef struct {
+    __IO uint32_t CCR;
+    __IO uint32_t CNDTR;
+    __IO uint32_t CPAR;
+    __IO uint32_t CMAR;
+} DMA_Channel_TypeDef;
+
+typedef struct {
+    __IO uint32_t ISR;
+    __IO uint32_t IFCR;
+} DMA_TypeDef;
+
+extern DMA_TypeDef sim_dma_regs[2];
+extern DMA_Channel_TypeDef sim_dma_channel_regs[12];
+
+#define DMA1                    (&sim_dma_regs[0])
+#define DMA2                    (&sim_dma_regs[1])
+#define DMA1_Channel1           (&sim_dma_channel_regs[0])
+#define DMA1_Channel2           (&sim_dma_channel_regs[1])
+#define DMA1_Channel3           (&sim_dma_channel_regs[2])
+#define DMA1_Channel4           (&sim_dma_channel_regs[3])
+#define DMA1_Channel5           (&sim_dma_channel_regs[4])
+#define DMA1_Channel6           (&sim_dma_channel_regs[5])
+#define DMA1_Channel7           (&sim_dma_channel_regs[6])
+#define DMA2_Channel1           (&sim_dma_channel_regs[7])
+#define DMA2_Channel2           (&sim_dma_channel_regs[8])
+#define DMA2_Channel3           (&sim_dma_channel_regs[9])
+#define DMA2_Channel4           (&sim_dma_channel_regs[10])
+#define DMA2_Channel5           (&sim_dma_channel_regs[11])
+
+#define DMA_CCR_EN              (1UL << 0)
+#define DMA_CCR_TCIE            (1UL << 1)
+#define DMA_CCR_HTIE            (1UL << 2)
+#define DMA_CCR_TEIE            (1UL << 3)
+#define DMA_CCR_DIR             (1UL << 4)
+#define DMA_CCR_CIRC            (1UL << 5)
+#define DMA_CCR_PINC            (1UL << 6)
+#define DMA_CCR_MINC            (1UL << 7)
+#define DMA_CCR_PSIZE           (3UL << 8)
+#define DMA_CCR_MSIZE           (3UL << 10)
+#define DMA_CCR_PL              (3UL << 12)
+#define DMA_CCR_MEM2MEM         (1UL << 14)
+
+/* Flags of channel 1, the others are shifted by `ChannelIndex`. */
+#define DMA_FLAG_GL1            0x00000001U
+#define DMA_FLAG_TC1            0x00000002U
+#define DMA_FLAG_HT1            0x00000004U
+#define DMA_FLAG_TE1            0x00000008U
+
+#define DMA_PERIPH_TO_MEMORY    0x00000000U
+#define DMA_MEMORY_TO_PERIPH    DMA_CCR_DIR
+#define DMA_MEMORY_TO_MEMORY    DMA_CCR_MEM2MEM
+#define DMA_PINC_ENABLE         DMA_CCR_PINC
+#define DMA_PINC_DISABLE        0x00000000U
+#define DMA_MINC_ENABLE         DMA_CCR_MINC
+#define DMA_MINC_DISABLE        0x00000000U
+#define DMA_PDATAALIGN_BYTE     0x00000000U
+#define DMA_PDATAALIGN_HALFWORD (1UL << 8)
+#define DMA_PDATAALIGN_WORD     (2UL << 8)
+#define DMA_MDATAALIGN_BYTE     0x00000000U
+#define DMA_MDATAALIGN_HALFWORD (1UL << 10)
+#define DMA_MDATAALIGN_WORD     (2UL << 10)
+#define DMA_NORMAL              0x00000000U
+#define DMA_CIRCULAR            DMA_CCR_CIRC
+#define DMA_PRIORITY_LOW        0x00000000U
+#define DMA_PRIORITY_MEDIUM     (1UL << 12)
+#define DMA_PRIORITY_HIGH       (2UL << 12)
+#define DMA_PRIORITY_VERY_HIGH  (3UL << 12)
+
+#define DMA_IT_TC               DMA_CCR_TCIE
+#define DMA_IT_HT               DMA_CCR_HTIE
+#define DMA_IT_TE               DMA_CCR_TEIE
+
+#define HAL_DMA_ERROR_NONE      0x00000000U
+#define HAL_DMA_ERROR_TE        0x00000001U
+#define HAL_DMA_ERROR_NO_XFER   0x00000004U
+
+typedef enum {
+    HAL_DMA_STATE_RESET = 0x00U,
+    HAL_DMA_STATE_READY = 0x01U,
+    HAL_DMA_STATE_BUSY = 0x02U,
+    HAL_DMA_STATE_TIMEOUT = 0x03U
+} HAL_DMA_StateTypeDef;
+
+typedef struct {
+    uint32_t Direction;
+    uint32_t PeriphInc;
+    uint32_t MemInc;
+    uint32_t PeriphDataAlignment;
+    uint32_t MemDataAlignment;
+    uint32_t Mode;
+    uint32_t Priority;
+} DMA_InitTypeDef;
+
+typedef struct __DMA_HandleTypeDef {
+    DMA_Channel_TypeDef *Instance;
+    DMA_InitTypeDef Init;
+    HAL_LockTypeDef Lock;
+    __IO HAL_DMA_StateTypeDef State;
+    void *Parent;
+    void (*XferCpltCallback)(struct __DMA_HandleTypeDef *hdma);
+    void (*XferHalfCpltCallback)(struct __DMA_HandleTypeDef *hdma);
+    void (*XferErrorCallback)(struct __DMA_HandleTypeDef *hdma);
+    void (*XferAbortCallback)(struct __DMA_HandleTypeDef *hdma);
+    __IO uint32_t ErrorCode;
+    DMA_TypeDef *DmaBaseAddress;
+    uint32_t ChannelIndex;
+} DMA_HandleTypeDef;
+
+#define __HAL_DMA_ENABLE(h)     ((h)->Instance->CCR |= DMA_CCR_EN)
+#define __HAL_DMA_DISABLE(h)    ((h)->Instance->CCR &= ~DMA_CCR_EN)
+#define __HAL_DMA_ENABLE_IT(h, it)  ((h)->Instance->CCR |= (it))
+#define __HAL_DMA_DISABLE_IT(h, it) ((h)->Instance->CCR &= ~(it))
+#define __HAL_DMA_GET_COUNTER(h)    ((h)->Instance->CNDTR)
+#define __HAL_DMA_SET_COUNTER(h, c) ((h)->Instance->CNDTR = (uint16_t)(c))
+#define __HAL_DMA_GET_GI_FLAG_INDEX(h)  (DMA_FLAG_GL1 << (h)->ChannelIndex)
+#define __HAL_DMA_GET_TC_FLAG_INDEX(h)  (DMA_FLAG_TC1 << (h)->ChannelIndex)
+#define __HAL_DMA_GET_HT_FLAG_INDEX(h)  (DMA_FLAG_HT1 << (h)->ChannelIndex)
+#define __HAL_DMA_GET_TE_FLAG_INDEX(h)  (DMA_FLAG_TE1 << (h)->ChannelIndex)
+#define __HAL_DMA_GET_FLAG(h, f)    ((h)->DmaBaseAddress->ISR & (f))
+#define __HAL_DMA_CLEAR_FLAG(h, f)  ((h)->DmaBaseAddress->IFCR = (f))
+
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef *hdma);
+HAL_StatusTypeDef HAL_DMA_DeInit(DMA_HandleTypeDef *hdma);
+HAL_StatusTypeDef HAL_DMA_Abort(DMA_HandleTypeDef *hdma);
+HAL_StatusTypeDef HAL_DMA_Abort_IT(DMA_HandleTypeDef *hdma);
+void HAL_DMA_IRQHandler(DMA_HandleTypeDef *hdma);
+HAL_DMA_StateTypeDef HAL_DMA_GetState(const DMA_HandleTypeDef *hdma);
+uint32_t HAL_DMA_GetError(const DMA_HandleTypeDef *hdma);
+
+/**
+ * @}
+ */
+
+/*****************************************************************************
+ * @defgroup USART.
+ * @{
+ */
+
+typedef struct {
+    __IO uint32_t SR;
+    __IO uint32_t DR;
+    __IO uint32_t BRR;
+    __IO uint32_t CR1;
+    __IO uint32_t CR2;
+    __IO uint32_t CR3;
+    __IO uint32_t GTPR;
+} USART_TypeDef;
+
+#define PERIPH_BASE             0x40000000UL
+#define APB1PERIPH_BASE         PERIPH_BASE
+#define APB2PERIPH_BASE         (PERIPH_BASE + 0x00010000UL)
+#define USART2_BASE             (APB1PERIPH_BASE + 0x00004400UL)
+#define USART3_BASE             (APB1PERIPH_BASE + 0x00004800UL)
+#define UART4_BASE              (APB1PERIPH_BASE + 0x00004C00UL)
+#define UART5_BASE              (APB1PERIPH_BASE + 0x00005000UL)
+#define USART1_BASE             (APB2PERIPH_BASE + 0x00003800UL)
+
+#define USART1                  ((USART_TypeDef *)USART1_BASE)
+#define USART2                  ((USART_TypeDef *)USART2_BASE)
+#define USART3                  ((USART_TypeDef *)USART3_BASE)
+#define UART4                   ((USART_TypeDef *)UART4_BASE)
+#define UART5                   ((USART_TypeDef *)UART5_BASE)
+
+#define USART_SR_PE             (1UL << 0)
+#define USART_SR_FE             (1UL << 1)
+#define USART_SR_NE             (1UL << 2)
+#define USART_SR_ORE            (1UL << 3)
+#define USART_SR_IDLE           (1UL << 4)
+#define USART_SR_RXNE           (1UL << 5)
+#define USART_SR_TC             (1UL << 6)
+#define USART_SR_TXE            (1UL << 7)
+#define USART_SR_LBD            (1UL << 8)
+#define USART_SR_CTS            (1UL << 9)
+
+#define USART_CR1_SBK           (1UL << 0)
+#define USART_CR1_RWU           (1UL << 1)
+#define USART_CR1_RE            (1UL << 2)
+#define USART_CR1_TE            (1UL << 3)
+#define USART_CR1_IDLEIE        (1UL << 4)
+#define USART_CR1_RXNEIE        (1UL << 5)
+#define USART_CR1_TCIE          (1UL << 6)
+#define USART_CR1_TXEIE         (1UL << 7)
+#define USART_CR1_PEIE          (1UL << 8)
+#define USART_CR1_PS            (1UL << 9)
+#define USART_CR1_PCE           (1UL << 10)
+#define USART_CR1_WAKE          (1UL << 11)
+#define USART_CR1_M             (1UL << 12)
+#define USART_CR1_UE            (1UL << 13)
+
+#define USART_CR2_LBCL          (1UL << 8)
+#define USART_CR2_CPHA          (1UL << 9)
+#define USART_CR2_CPOL          (1UL << 10)
+#define USART_CR2_CLKEN         (1UL << 11)
+#define USART_CR2_STOP_Pos      12U
+#define USART_CR2_STOP          (3UL << USART_CR2_STOP_Pos)
+#define USART_CR2_LINEN         (1UL << 14)
+
+#define USART_CR3_EIE           (1UL << 0)
+#define USART_CR3_IREN          (1UL << 1)
+#define USART_CR3_HDSEL         (1UL << 3)
+#define USART_CR3_SCEN          (1UL << 5)
+#define USART_CR3_DMAR          (1UL << 6)
+#define USART_CR3_DMAT          (1UL << 7)
+#define USART_CR3_RTSE          (1UL << 8)
+#define USART_CR3_CTSE          (1UL << 9)
+
+#define USE_HAL_UART_REGISTER_CALLBACKS 0U
+#define USE_HAL_USART_REGISTER_CALLBACKS 0U
+
+#define UART_WORDLENGTH_8B      0x00000000U
+#define UART_WORDLENGTH_9B      USART_CR1_M
+#define UART_STOPBITS_1         0x00000000U
+#define UART_STOPBITS_2         (2UL << USART_CR2_STOP_Pos)
+#define UART_PARITY_NONE        0x00000000U
+#define UART_PARITY_EVEN        USART_CR1_PCE
+#define UART_PARITY_ODD         (USART_CR1_PCE | USART_CR1_PS)
+#define UART_MODE_RX            USART_CR1_RE
+#define UART_MODE_TX            USART_CR1_TE
+#define UART_MODE_TX_RX         (USART_CR1_TE | USART_CR1_RE)
+#define UART_HWCONTROL_NONE     0x00000000U
+#define UART_HWCONTROL_RTS      USART_CR3_RTSE
+#define UART_HWCONTROL_CTS      USART_CR3_CTSE
+#define UART_HWCONTROL_RTS_CTS  (USART_CR3_RTSE | USART_CR3_CTSE)
+#define UART_OVERSAMPLING_16    0x00000000U
+
+#define UART_FLAG_PE            USART_SR_PE
+#define UART_FLAG_FE            USART_SR_FE
+#define UART_FLAG_NE            USART_SR_NE
+#define UART_FLAG_ORE           USART_SR_ORE
+#define UART_FLAG_IDLE          USART_SR_IDLE
+#define UART_FLAG_RXNE          USART_SR_RXNE
+#define UART_FLAG_TC            USART_SR_TC
+#define UART_FLAG_TXE           USART_SR_TXE
+
+/* Interrupts: register index in the bits 28 ~ 31, bit of CR in the low
+ * 16 bits. */
+#define UART_IT_MASK            0x0000FFFFU
+#define UART_IT_PE              ((1UL << 28) | USART_CR1_PEIE)
+#define UART_IT_TXE             ((1UL << 28) | USART_CR1_TXEIE)
+#define UART_IT_TC              ((1UL << 28) | USART_CR1_TCIE)
+#define UART_IT_RXNE            ((1UL << 28) | USART_CR1_RXNEIE)
+#define UART_IT_IDLE            ((1UL << 28) | USART_CR1_IDLEIE)
+#define UART_IT_ERR             ((3UL << 28) | USART_CR3_EIE)
+
+#define HAL_UART_ERROR_NONE     0x00000000U
+#define HAL_UART_ERROR_PE       0x00000001U
+#define HAL_UART_ERROR_NE       0x00000002U
+#define HAL_UART_ERROR_FE       0x00000004U
+#define HAL_UART_ERROR_ORE      0x00000008U
+#define HAL_UART_ERROR_DMA      0x00000010U
+
+#define HAL_UART_RECEPTION_STANDARD 0x00000000U
+#define HAL_UART_RECEPTION_TOIDLE   0x00000001U
+
+typedef enum {
+    HAL_UART_STATE_RESET = 0x00U,
+    HAL_UART_STATE_READY = 0x20U,
+    HAL_UART_STATE_BUSY = 0x24U,
+    HAL_UART_STATE_BUSY_TX = 0x21U,
+    HAL_UART_STATE_BUSY_RX = 0x22U,
+    HAL_UART_STATE_BUSY_TX_RX = 0x23U,
+    HAL_UART_STATE_TIMEOUT = 0xA0U,
+    HAL_UART_STATE_ERROR = 0xE0U
+} HAL_UART_StateTypeDef;
+
+typedef struct {
+    uint32_t BaudRate;
+    uint32_t WordLength;
+    uint32_t StopBits;
+    uint32_t Parity;
+    uint32_t Mode;
+    uint32_t HwFlowCtl;
+    uint32_t OverSampling;
+} UART_InitTypeDef;
+
+typedef struct __UART_HandleTypeDef {
+    USART_TypeDef *Instance;
+    UART_InitTypeDef Init;
+    const uint8_t *pTxBuffPtr;
+    uint16_t TxXferSize;
+    __IO uint16_t TxXferCount;
+    uint8_t *pRxBuffPtr;
+    uint16_t RxXferSize;
+    __IO uint16_t RxXferCount;
+    __IO uint32_t ReceptionType;
+    DMA_HandleTypeDef *hdmatx;
+    DMA_HandleTypeDef *hdmarx;
+    HAL_LockTypeDef Lock;
+    __IO HAL_UART_StateTypeDef gState;
+    __IO HAL_UART_StateTypeDef RxState;
+    __IO uint32_t ErrorCode;
+} UART_HandleTypeDef;
+
+/* Register accesses with side effect, see the note of file. */
+uint32_t sim_usart_read_sr(USART_TypeDef *usart);
+void sim_usart_read_sr_dr(USART_TypeDef *usart);
+
+#define __HAL_UART_GET_FLAG(h, f)                                              \
+    ((sim_usart_read_sr((h)->Instance) & (f)) == (f))
+#define __HAL_UART_CLEAR_FLAG(h, f) ((h)->Instance->SR = ~(uint32_t)(f))
+#define __HAL_UART_CLEAR_PEFLAG(h)  sim_usart_read_sr_dr((h)->Instance)
+#define __HAL_UART_CLEAR_FEFLAG(h)  __HAL_UART_CLEAR_PEFLAG(h)
+#define __HAL_UART_CLEAR_NEFLAG(h)  __HAL_UART_CLEAR_PEFLAG(h)
+#define __HAL_UART_CLEAR_OREFLAG(h) __HAL_UART_CLEAR_PEFLAG(h)
+#define __HAL_UART_CLEAR_IDLEFLAG(h) __HAL_UART_CLEAR_PEFLAG(h)
+#define __HAL_UART_ENABLE(h)    ((h)->Instance->CR1 |= USART_CR1_UE)
+#define __HAL_UART_DISABLE(h)   ((h)->Instance->CR1 &= ~USART_CR1_UE)
+
+#define __HAL_UART_ENABLE_IT(h, it)                                            \
+    ((((it) >> 28U) == 1U)   ? ((h)->Instance->CR1 |= ((it) & UART_IT_MASK))   \
+     : (((it) >> 28U) == 2U) ? ((h)->Instance->CR2 |= ((it) & UART_IT_MASK))   \
+                             : ((h)->Instance->CR3 |= ((it) & UART_IT_MASK)))
+#define __HAL_UART_DISABLE_IT(h, it)                                           \
+    ((((it) >> 28U) == 1U)   ? ((h)->Instance->CR1 &= ~((it) & UART_IT_MASK))  \
+     : (((it) >> 28U) == 2U) ? ((h)->Instance->CR2 &= ~((it) & UART_IT_MASK))  \
+                             : ((h)->Instance->CR3 &= ~((it) & UART_IT_MASK)))
+
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef *huart);
+HAL_StatusTypeDef HAL_UART_DeInit(UART_HandleTypeDef *huart);
+void HAL_UART_MspInit(UART_HandleTypeDef *huart);
+void HAL_UART_MspDeInit(UART_HandleTypeDef *huart);
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef *huart,
+                                    const uint8_t *data, uint16_t size,
+                                    uint32_t timeout);
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef *huart,
+                                        const uint8_t *data, uint16_t size);
+HAL_StatusTypeDef HAL_UART_Receive_IT(UART_HandleTypeDef *huart,
+                                      uint8_t *data, uint16_t size);
+HAL_StatusTypeDef HAL_UART_Receive_DMA(UART_HandleTypeDef *huart,
+                                       uint8_t *data, uint16_t size);
+HAL_StatusTypeDef HAL_UARTEx_ReceiveToIdle(UART_HandleTypeDef *huart,
+                                           uint8_t *data, uint16_t size,
+                                           uint16_t *rx_len,
+                                           uint32_t timeout);
+HAL_StatusTypeDef HAL_UART_DMAStop(UART_HandleTypeDef *huart);
+void HAL_UART_IRQHandler(UART_HandleTypeDef *huart);
+HAL_UART_StateTypeDef HAL_UART_GetState(const UART_HandleTypeDef *huart);
+uint32_t HAL_UART_GetError(const UART_HandleTypeDef *huart);
+
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart);
+void HAL_UART_TxHalfCpltCallback(UART_HandleTypeDef *huart);
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart);
+void HAL_UART_RxHalfCpltCallback(UART_HandleTypeDef *huart);
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart);
+
+/* Synchronous mode, the CK pin clocks the data of TX and RX. */
+#define USART_WORDLENGTH_8B     0x00000000U
+#define USART_WORDLENGTH_9B     USART_CR1_M
+#define USART_STOPBITS_1        0x00000000U
+#define USART_STOPBITS_2        (2UL << USART_CR2_STOP_Pos)
+#define USART_PARITY_NONE       0x00000000U
+#define USART_PARITY_EVEN       USART_CR1_PCE
+#define USART_PARITY_ODD        (USART_CR1_PCE | USART_CR1_PS)
+#define USART_MODE_RX           USART_CR1_RE
+#define USART_MODE_TX           USART_CR1_TE
+#define USART_MODE_TX_RX        (USART_CR1_TE | USART_CR1_RE)
+#define USART_POLARITY_LOW      0x00000000U
+#define USART_POLARITY_HIGH     USART_CR2_CPOL
+#define USART_PHASE_1EDGE       0x00000000U
+#define USART_PHASE_2EDGE       USART_CR2_CPHA
+#define USART_LASTBIT_DISABLE   0x00000000U
+#define USART_LASTBIT_ENABLE    USART_CR2_LBCL
+
+#define HAL_USART_ERROR_NONE    0x00000000U
+#define HAL_USART_ERROR_PE      0x00000001U
+#define HAL_USART_ERROR_NE      0x00000002U
+#define HAL_USART_ERROR_FE      0x00000004U
+#define HAL_USART_ERROR_ORE     0x00000008U
+#define HAL_USART_ERROR_DMA     0x00000010U
+
+typedef enum {
+    HAL_USART_STATE_RESET = 0x00U,
+    HAL_USART_STATE_READY = 0x01U,
+    HAL_USART_STATE_BUSY = 0x02U,
+    HAL_USART_STATE_BUSY_TX = 0x12U,
+    HAL_USART_STATE_BUSY_RX = 0x22U,
+    HAL_USART_STATE_BUSY_TX_RX = 0x32U,
+    HAL_USART_STATE_TIMEOUT = 0x03U,
+    HAL_USART_STATE_ERROR = 0x04U
+} HAL_USART_StateTypeDef;
+
+typedef struct {
+    uint32_t BaudRate;
+    uint32_t WordLength;
+    uint32_t StopBits;
+    uint32_t Parity;
+    uint32_t Mode;
+    uint32_t CLKPolarity;
+    uint32_t CLKPhase;
+    uint32_t CLKLastBit;
+} USART_InitTypeDef;
+
+typedef struct __USART_HandleTypeDef {
+    USART_TypeDef *Instance;
+    USART_InitTypeDef Init;
+    const uint8_t *pTxBuffPtr;
+    uint16_t TxXferSize;
+    __IO uint16_t TxXferCount;
+    uint8_t *pRxBuffPtr;
+    uint16_t RxXferSize;
+    __IO uint16_t RxXferCount;
+    DMA_HandleTypeDef *hdmatx;
+    DMA_HandleTypeDef *hdmarx;
+    HAL_LockTypeDef Lock;
+    __IO HAL_USART_StateTypeDef State;
+    __IO uint32_t ErrorCode;
+} USART_HandleTypeDef;
+
+HAL_StatusTypeDef HAL_USART_Init(USART_HandleTypeDef *husart);
+HAL_StatusTypeDef HAL_USART_DeInit(USART_HandleTypeDef *husart);
+void HAL_USART_MspInit(USART_HandleTypeDef *husart);
+void HAL_USART_MspDeInit(USART_HandleTypeDef *husart);
+HAL_StatusTypeDef HAL_USART_Transmit(USART_HandleTypeDef *husart,
+                                     const uint8_t *data, uint16_t size,
+                                     uint32_t timeout);
+HAL_StatusTypeDef HAL_USART_TransmitReceive(USART_HandleTypeDef *husart,
+                                            const uint8_t *tx_data,
+                                            uint8_t *rx_data, uint16_t size,
+                                            uint32_t timeout);
+HAL_StatusTypeDef HAL_USART_Transmit_DMA(USART_HandleTypeDef *husart,
+                                         const uint8_t *data, uint16_t size);
+HAL_StatusTypeDef HAL_USART_TransmitReceive_DMA(USART_HandleTypeDef *husart,
+                                                const uint8_t *tx_data,
+                                                uint8_t *rx_data,
+                                                uint16_t size);
+void HAL_USART_IRQHandler(USART_HandleTypeDef *husart);
+HAL_USART_StateTypeDef HAL_USART_GetState(const USART_HandleTypeDef *husart);
+uint32_t HAL_USART_GetError(const USART_HandleTypeDef *husart);
+
+void HAL_USART_TxCpltCallback(USART_HandleTypeDef *husart);
+void HAL_USART_TxRxCpltCallback(USART_HandleTypeDef *husart);
+void HAL_USART_ErrorCallback(USART_HandleTypeDef *husart);
+
+/**
+ * @}
+ */
+
+/*****************************************************************************
+ * @defgroup bxCAN.
+ * @{
+ */
+
+typedef struct {
+    __IO uint32_t TIR;
+    __IO uint32_t TDTR;
+    __IO uint32_t TDLR;
+    __IO uint32_t TDHR;
+} CAN_TxMailBox_TypeDef;
+
+typedef struct {
+    __IO uint32_t RIR;
+    __IO uint32_t RDTR;
+    __IO uint32_t RDLR;
+    __IO uint32_t RDHR;
+} CAN_FIFOMailBox_TypeDef;
+
+typedef struct {
+    __IO uint32_t FR1;
+    __IO uint32_t FR2;
+} CAN_FilterRegister_TypeDef;
+
+typedef struct {
+    __IO uint32_t MCR;
+    __IO uint32_t MSR;
+    __IO uint32_t TSR;
+    __IO uint32_t RF0R;
+    __IO uint32_t RF1R;
+    __IO uint32_t IER;
+    __IO uint32_t ESR;
+    __IO uint32_t BTR;
+    uint32_t RESERVED0[88];
+    CAN_TxMailBox_TypeDef sTxMailBox[3];
+    CAN_FIFOMailBox_TypeDef sFIFOMailBox[2];
+    uint32_t RESERVED1[12];
+    __IO uint32_t FMR;
+    __IO uint32_t FM1R;
+    uint32_t RESERVED2;
+    __IO uint32_t FS1R;
+    uint32_t RESERVED3;
+    __IO uint32_t FFA1R;
+    uint32_t RESERVED4;
+    __IO uint32_t FA1R;
+    uint32_t RESERVED5[8];
+    CAN_FilterRegister_TypeDef sFilterRegister[28];
+} CAN_TypeDef;
+
+extern CAN_TypeDef sim_can_regs[2];
+
+#define CAN1                    (&sim_can_regs[0])
+#define CAN2                    (&sim_can_regs[1])
+
+#define CAN_MCR_INRQ            (1UL << 0)
+#define CAN_MCR_SLEEP           (1UL << 1)
+#define CAN_MCR_TXFP            (1UL << 2)
+#define CAN_MCR_RFLM            (1UL << 3)
+#define CAN_MCR_NART            (1UL << 4)
+#define CAN_MCR_AWUM            (1UL << 5)
+#define CAN_MCR_ABOM            (1UL << 6)
+#define CAN_MCR_TTCM            (1UL << 7)
+#define CAN_MCR_RESET           (1UL << 15)
+#define CAN_MCR_DBF             (1UL << 16)
+
+#define CAN_MSR_INAK            (1UL << 0)
+#define CAN_MSR_SLAK            (1UL << 1)
+#define CAN_MSR_ERRI            (1UL << 2)
+#define CAN_MSR_WKUI            (1UL << 3)
+#define CAN_MSR_SLAKI           (1UL << 4)
+#define CAN_MSR_TXM             (1UL << 8)
+#define CAN_MSR_RXM             (1UL << 9)
+
+#define CAN_TSR_RQCP0           (1UL << 0)
+#define CAN_TSR_TXOK0           (1UL << 1)
+#define CAN_TSR_ALST0           (1UL << 2)
+#define CAN_TSR_TERR0           (1UL << 3)
+#define CAN_TSR_ABRQ0           (1UL << 7)
+#define CAN_TSR_RQCP1           (1UL << 8)
+#define CAN_TSR_TXOK1           (1UL << 9)
+#define CAN_TSR_ALST1           (1UL << 10)
+#define CAN_TSR_TERR1           (1UL << 11)
+#define CAN_TSR_ABRQ1           (1UL << 15)
+#define CAN_TSR_RQCP2           (1UL << 16)
+#define CAN_TSR_TXOK2           (1UL << 17)
+#define CAN_TSR_ALST2           (1UL << 18)
+#define CAN_TSR_TERR2           (1UL << 19)
+#define CAN_TSR_ABRQ2           (1UL << 23)
+#define CAN_TSR_CODE_Pos        24U
+#define CAN_TSR_CODE            (3UL << CAN_TSR_CODE_Pos)
+#define CAN_TSR_TME_Pos         26U
+#define CAN_TSR_TME             (7UL << CAN_TSR_TME_Pos)
+#define CAN_TSR_TME0            (1UL << 26)
+#define CAN_TSR_TME1            (1UL << 27)
+#define CAN_TSR_TME2            (1UL << 28)
+#define CAN_TSR_LOW0            (1UL << 29)
+#define CAN_TSR_LOW1            (1UL << 30)
+#define CAN_TSR_LOW2            (1UL << 31)
+
+#define CAN_RF0R_FMP0           (3UL << 0)
+#define CAN_RF0R_FULL0          (1UL << 3)
+#define CAN_RF0R_FOVR0          (1UL << 4)
+#define CAN_RF0R_RFOM0          (1UL << 5)
+#define CAN_RF1R_FMP1           (3UL << 0)
+#define CAN_RF1R_FULL1          (1UL << 3)
+#define CAN_RF1R_FOVR1          (1UL << 4)
+#define CAN_RF1R_RFOM1          (1UL << 5)
+
+#define CAN_IER_TMEIE           (1UL << 0)
+#define CAN_IER_FMPIE0          (1UL << 1)
+#define CAN_IER_FFIE0           (1UL << 2)
+#define CAN_IER_FOVIE0          (1UL << 3)
+#define CAN_IER_FMPIE1          (1UL << 4)
+#define CAN_IER_FFIE1           (1UL << 5)
+#define CAN_IER_FOVIE1          (1UL << 6)
+#define CAN_IER_EWGIE           (1UL << 8)
+#define CAN_IER_EPVIE           (1UL << 9)
+#define CAN_IER_BOFIE           (1UL << 10)
+#define CAN_IER_LECIE           (1UL << 11)
+#define CAN_IER_ERRIE           (1UL << 15)
+#define CAN_IER_WKUIE           (1UL << 16)
+#define CAN_IER_SLKIE           (1UL << 17)
+
+#define CAN_ESR_EWGF            (1UL << 0)
+#define CAN_ESR_EPVF            (1UL << 1)
+#define CAN_ESR_BOFF            (1UL << 2)
+#define CAN_ESR_LEC_Pos         4U
+#define CAN_ESR_LEC             (7UL << CAN_ESR_LEC_Pos)
+#define CAN_ESR_TEC_Pos         16U
+#define CAN_ESR_TEC             (0xFFUL << CAN_ESR_TEC_Pos)
+#define CAN_ESR_REC_Pos         24U
+#define CAN_ESR_REC             (0xFFUL << CAN_ESR_REC_Pos)
+
+#define CAN_BTR_BRP_Pos         0U
+#define CAN_BTR_BRP             (0x3FFUL << CAN_BTR_BRP_Pos)
+#define CAN_BTR_TS1_Pos         16U
+#define CAN_BTR_TS1             (0xFUL << CAN_BTR_TS1_Pos)
+#define CAN_BTR_TS2_Pos         20U
+#define CAN_BTR_TS2             (7UL << CAN_BTR_TS2_Pos)
+#define CAN_BTR_SJW_Pos         24U
+#define CAN_BTR_SJW             (3UL << CAN_BTR_SJW_Pos)
+#define CAN_BTR_LBKM            (1UL << 30)
+#define CAN_BTR_SILM            (1UL << 31)
+
+#define CAN_TI0R_TXRQ           (1UL << 0)
+#define CAN_TI0R_RTR            (1UL << 1)
+#define CAN_TI0R_IDE            (1UL << 2)
+#define CAN_TI0R_EXID_Pos       3U
+#define CAN_TI0R_EXID           (0x3FFFFUL << CAN_TI0R_EXID_Pos)
+#define CAN_TI0R_STID_Pos       21U
+#define CAN_TI0R_STID           (0x7FFUL << CAN_TI0R_STID_Pos)
+#define CAN_TDT0R_DLC_Pos       0U
+#define CAN_TDT0R_DLC           (0xFUL << CAN_TDT0R_DLC_Pos)
+#define CAN_TDT0R_TGT           (1UL << 8)
+#define CAN_TDT0R_TIME_Pos      16U
+#define CAN_TDT0R_TIME          (0xFFFFUL << CAN_TDT0R_TIME_Pos)
+
+#define CAN_RI0R_RTR            (1UL << 1)
+#define CAN_RI0R_IDE            (1UL << 2)
+#define CAN_RI0R_EXID_Pos       3U
+#define CAN_RI0R_EXID           (0x3FFFFUL << CAN_RI0R_EXID_Pos)
+#define CAN_RI0R_STID_Pos       21U
+#define CAN_RI0R_STID           (0x7FFUL << CAN_RI0R_STID_Pos)
+#define CAN_RDT0R_DLC_Pos       0U
+#define CAN_RDT0R_DLC           (0xFUL << CAN_RDT0R_DLC_Pos)
+#define CAN_RDT0R_FMI_Pos       8U
+#define CAN_RDT0R_FMI           (0xFFUL << CAN_RDT0R_FMI_Pos)
+#define CAN_RDT0R_TIME_Pos      16U
+#define CAN_RDT0R_TIME          (0xFFFFUL << CAN_RDT0R_TIME_Pos)
+
+#define CAN_FMR_FINIT           (1UL << 0)
+#define CAN_FMR_CAN2SB_Pos      8U
+#define CAN_FMR_CAN2SB          (0x3FUL << CAN_FMR_CAN2SB_Pos)
+
+#define CAN_MODE_NORMAL             0x00000000U
+#define CAN_MODE_LOOPBACK           CAN_BTR_LBKM
+#define CAN_MODE_SILENT             CAN_BTR_SILM
+#define CAN_MODE_SILENT_LOOPBACK    (CAN_BTR_LBKM | CAN_BTR_SILM)
+
+#define CAN_SJW_1TQ             0x00000000U
+#define CAN_SJW_2TQ             (1UL << CAN_BTR_SJW_Pos)
+#define CAN_SJW_3TQ             (2UL << CAN_BTR_SJW_Pos)
+#define CAN_SJW_4TQ             (3UL << CAN_BTR_SJW_Pos)
+
+#define CAN_FILTERMODE_IDMASK   0x00000000U
+#define CAN_FILTERMODE_IDLIST   0x00000001U
+#define CAN_FILTERSCALE_16BIT   0x00000000U
+#define CAN_FILTERSCALE_32BIT   0x00000001U
+#define CAN_FILTER_DISABLE      0x00000000U
+#define CAN_FILTER_ENABLE       0x00000001U
+#define CAN_FILTER_FIFO0        0x00000000U
+#define CAN_FILTER_FIFO1        0x00000001U
+
+#define CAN_RX_FIFO0            0x00000000U
+#define CAN_RX_FIFO1            0x00000001U
+#define CAN_ID_STD              0x00000000U
+#define CAN_ID_EXT              0x00000004U
+#define CAN_RTR_DATA            0x00000000U
+#define CAN_RTR_REMOTE          0x00000002U
+#define CAN_TX_MAILBOX0         0x00000001U
+#define CAN_TX_MAILBOX1         0x00000002U
+#define CAN_TX_MAILBOX2         0x00000004U
+
+#define CAN_IT_TX_MAILBOX_EMPTY     CAN_IER_TMEIE
+#define CAN_IT_RX_FIFO0_MSG_PENDING CAN_IER_FMPIE0
+#define CAN_IT_RX_FIFO0_FULL        CAN_IER_FFIE0
+#define CAN_IT_RX_FIFO0_OVERRUN     CAN_IER_FOVIE0
+#define CAN_IT_RX_FIFO1_MSG_PENDING CAN_IER_FMPIE1
+#define CAN_IT_RX_FIFO1_FULL        CAN_IER_FFIE1
+#define CAN_IT_RX_FIFO1_OVERRUN     CAN_IER_FOVIE1
+#define CAN_IT_WAKEUP               CAN_IER_WKUIE
+#define CAN_IT_SLEEP_ACK            CAN_IER_SLKIE
+#define CAN_IT_ERROR_WARNING        CAN_IER_EWGIE
+#define CAN_IT_ERROR_PASSIVE        CAN_IER_EPVIE
+#define CAN_IT_BUSOFF               CAN_IER_BOFIE
+#define CAN_IT_LAST_ERROR_CODE      CAN_IER_LECIE
+#define CAN_IT_ERROR                CAN_IER_ERRIE
+
+#define HAL_CAN_ERROR_NONE          0x00000000U
+#define HAL_CAN_ERROR_EWG           0x00000001U
+#define HAL_CAN_ERROR_EPV           0x00000002U
+#define HAL_CAN_ERROR_BOF           0x00000004U
+#define HAL_CAN_ERROR_STF           0x00000008U
+#define HAL_CAN_ERROR_FOR           0x00000010U
+#define HAL_CAN_ERROR_ACK           0x00000020U
+#define HAL_CAN_ERROR_BR            0x00000040U
+#define HAL_CAN_ERROR_BD            0x00000080U
+#define HAL_CAN_ERROR_CRC           0x00000100U
+#define HAL_CAN_ERROR_RX_FOV0       0x00000200U
+#define HAL_CAN_ERROR_RX_FOV1       0x00000400U
+#define HAL_CAN_ERROR_TX_ALST0      0x00000800U
+#define HAL_CAN_ERROR_TX_TERR0      0x00001000U
+#define HAL_CAN_ERROR_TX_ALST1      0x00002000U
+#define HAL_CAN_ERROR_TX_TERR1      0x00004000U
+#define HAL_CAN_ERROR_TX_ALST2      0x00008000U
+#define HAL_CAN_ERROR_TX_TERR2      0x00010000U
+#define HAL_CAN_ERROR_TIMEOUT       0x00020000U
+#define HAL_CAN_ERROR_NOT_INITIALIZED 0x00040000U
+#define HAL_CAN_ERROR_NOT_READY     0x00080000U
+#define HAL_CAN_ERROR_NOT_STARTED   0x00100000U
+#define HAL_CAN_ERROR_PARAM         0x00200000U
+
+typedef enum {
+    HAL_CAN_STATE_RESET = 0x00U,
+    HAL_CAN_STATE_READY = 0x01U,
+    HAL_CAN_STATE_LISTENING = 0x02U,
+    HAL_CAN_STATE_SLEEP_PENDING = 0x03U,
+    HAL_CAN_STATE_SLEEP_ACTIVE = 0x04U,
+    HAL_CAN_STATE_ERROR = 0x05U
+} HAL_CAN_StateTypeDef;
+
+typedef struct {
+    uint32_t Prescaler;
+    uint32_t Mode;
+    uint32_t SyncJumpWidth;
+    uint32_t TimeSeg1;
+    uint32_t TimeSeg2;
+    FunctionalState TimeTriggeredMode;
+    FunctionalState AutoBusOff;
+    FunctionalState AutoWakeUp;
+    FunctionalState AutoRetransmission;
+    FunctionalState ReceiveFifoLocked;
+    FunctionalState TransmitFifoPriority;
+} CAN_InitTypeDef;
+
+typedef struct {
+    uint32_t FilterIdHigh;
+    uint32_t FilterIdLow;
+    uint32_t FilterMaskIdHigh;
+    uint32_t FilterMaskIdLow;
+    uint32_t FilterFIFOAssignment;
+    uint32_t FilterBank;
+    uint32_t FilterMode;
+    uint32_t FilterScale;
+    uint32_t FilterActivation;
+    uint32_t SlaveStartFilterBank;
+} CAN_FilterTypeDef;
+
+typedef struct {
+    uint32_t StdId;
+    uint32_t ExtId;
+    uint32_t IDE;
+    uint32_t RTR;
+    uint32_t DLC;
+    FunctionalState TransmitGlobalTime;
+} CAN_TxHeaderTypeDef;
+
+typedef struct {
+    uint32_t StdId;
+    uint32_t ExtId;
+    uint32_t IDE;
+    uint32_t RTR;
+    uint32_t DLC;
+    uint32_t Timestamp;
+    uint32_t FilterMatchIndex;
+} CAN_RxHeaderTypeDef;
+
+typedef struct __CAN_HandleTypeDef {
+    CAN_TypeDef *Instance;
+    CAN_InitTypeDef Init;
+    __IO HAL_CAN_StateTypeDef State;
+    __IO uint32_t ErrorCode;
+} CAN_HandleTypeDef;
+
+HAL_StatusTypeDef HAL_CAN_Init(CAN_HandleTypeDef *hcan);
+HAL_StatusTypeDef HAL_CAN_DeInit(CAN_HandleTypeDef *hcan);
+void HAL_CAN_MspInit(CAN_HandleTypeDef *hcan);
+void HAL_CAN_MspDeInit(CAN_HandleTypeDef *hcan);
+HAL_StatusTypeDef HAL_CAN_ConfigFilter(CAN_HandleTypeDef *hcan,
+                                       const CAN_FilterTypeDef *filter);
+HAL_StatusTypeDef HAL_CAN_Start(CAN_HandleTypeDef *hcan);
+HAL_StatusTypeDef HAL_CAN_Stop(CAN_HandleTypeDef *hcan);
+HAL_StatusTypeDef HAL_CAN_AddTxMessage(CAN_HandleTypeDef *hcan,
+                                       const CAN_TxHeaderTypeDef *header,
+                                       const uint8_t data[],
+                                       uint32_t *mailbox);
+HAL_StatusTypeDef HAL_CAN_AbortTxRequest(CAN_HandleTypeDef *hcan,
+                                         uint32_t mailboxes);
+uint32_t HAL_CAN_GetTxMailboxesFreeLevel(const CAN_HandleTypeDef *hcan);
+uint32_t HAL_CAN_IsTxMessagePending(const CAN_HandleTypeDef *hcan,
+                                    uint32_t mailboxes);
+uint32_t HAL_CAN_GetTxTimestamp(const CAN_HandleTypeDef *hcan,
+                                uint32_t mailbox);
+HAL_StatusTypeDef HAL_CAN_GetRxMessage(CAN_HandleTypeDef *hcan,
+                                       uint32_t fifo,
+                                       CAN_RxHeaderTypeDef *header,
+                                       uint8_t data[]);
+uint32_t HAL_CAN_GetRxFifoFillLevel(const CAN_HandleTypeDef *hcan,
+                                    uint32_t fifo);
+HAL_StatusTypeDef HAL_CAN_ActivateNotification(CAN_HandleTypeDef *hcan,
+                                               uint32_t its);
+HAL_StatusTypeDef HAL_CAN_DeactivateNotification(CAN_HandleTypeDef *hcan,
+                                                 uint32_t its);
+void HAL_CAN_IRQHandler(CAN_HandleTypeDef *hcan);
+HAL_CAN_StateTypeDef HAL_CAN_GetState(const CAN_HandleTypeDef *hcan);
+uint32_t HAL_CAN_GetError(const CAN_HandleTypeDef *hcan);
+HAL_StatusTypeDef HAL_CAN_ResetError(CAN_HandleTypeDef *hcan);
+
+void HAL_CAN_TxMailbox0CompleteCallback(CAN_HandleTypeDef *hcan);
+void HAL_CAN_TxMailbox1CompleteCallback(CAN_HandleTypeDef *hcan);
+void HAL_CAN_TxMailbox2CompleteCallback(CAN_HandleTypeDef *hcan);
+void HAL_CAN_TxMailbox0AbortCallback(CAN_HandleTypeDef *hcan);
+void HAL_CAN_TxMailbox1AbortCallback(CAN_HandleTypeDef *hcan);
+void HAL_CAN_TxMailbox2AbortCallback(CAN_HandleTypeDef *hcan);
+void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *hcan);
+void HAL_CAN_RxFifo0FullCallback(CAN_HandleTypeDef *hcan);
+void HAL_CAN_RxFifo1MsgPendingCallback(CAN_HandleTypeDef *hcan);
+void HAL_CAN_RxFifo1FullCallback(CAN_HandleTypeDef *hcan);
+void HAL_CAN_ErrorCallback(CAN_HandleTypeDef *hcan);
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+/* clang-format on */
+
+#endif /* __STM32F1xx_HAL_H */
@@ -0,0 +1,81 @@
+/**
+ * @file    test.h
+ * @author  Deadline039
+ * @brief   Minimal test runner of the host build.
+ * @version 3.3.3
+ * @date    2024-10-22
+ */
+
+#ifndef __TEST_H
+#define __TEST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Failures of current test. */
+extern unsigned int test_failures;
+
+/**
+ * @brief Check a condition, the test goes on if it fails.
+ */
+#define CHECK(cond)                                                            \
+    do {                                                                       \
+        if (!(cond)) {                                                         \
+            printf("    %s:%d: CHECK(%s) failed\n", __FILE__, __LINE__,        \
+                   #cond);                                                     \
+            ++test_failures;                                                   \
+        }                                                                      \
+    } while (0)
+
+/**
+ * @brief Check two integers are equal, print both if not.
+ */
+#define CHECK_EQ(a, b)                                                         \
+    do {                                                                       \
+        long long check_a = (long long)(a);                                    \
+        long long check_b = (long long)(b);                                    \
+        if (check_a != check_b) {                                              \
+            printf("    %s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n",       \
+                   __FILE__, __LINE__, #a, #b, check_a, check_b);              \
+            ++test_failures;                                                   \
+        }                                                                      \
+    } while (0)
+
+/**
+ * @brief A test case.
+ */
+typedef struct {
+    const char *name;
+    void (*run)(void);
+} test_case_t;
+
+#define TEST_CASE(fn) {#fn, fn}
+
+/**
+ * @brief Run the test cases, print the result of each one.
+ *
+ * @param suite Name of suite.
+ * @param cases The test cases.
+ * @param count Number of `cases`.
+ * @return Exit code: 0 if all passed, 1 if any failed.
+ */
+static inline int test_run(const char *suite, const test_case_t *cases,
+                           unsigned int count) {
+    unsigned int failed = 0;
+
+    /* Show the progress when piped. */
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    for (unsigned int i = 0; i < count; ++i) {
+        test_failures = 0;
+        cases[i].run();
+        printf("[%s] %s: %s\n", suite, cases[i].name,
+               (test_failures == 0) ? "ok" : "FAIL");
+        failed += (test_failures != 0);
+    }
+
+    printf("[%s] %u/%u passed\n", suite, count - failed, count);
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#endif /* __TEST_H */
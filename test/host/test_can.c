@@ -0,0 +1,2432 @@
+/**
+ * @file    test_can.c
+ * @author  Deadline039
+ * @brief   Tests of CAN_STM32F1xx.c on the simulated bxCAN.
+ * @version 3.3.3
+ * @date    2024-10-22
+ * @note    CAN1 and CAN2 are initialized by `canx_init()` before every test,
+ *          the other nodes on bus are the virtual nodes of simulator.
+ */
+
+#include <CSP_Config.h>
+
+#include "sim.h"
+#include "test.h"
+
+#include <string.h>
+
+unsigned int test_failures;
+
+/*****************************************************************************
+ * @defgroup Helpers.
+ * @{
+ */
+
+/* Slice of simulation between two reads of the receive rings. Unit: bit. */
+#define TEST_SLICE_BITS 32
+/* Bits to wait after the last frame is sent. */
+#define TEST_TAIL_BITS  200
+/* Frames logged of each CAN. */
+#define TEST_LOG_SIZE   4096
+
+/**
+ * @brief Frames received by CAN1 and CAN2, read from the receive rings.
+ */
+static struct {
+    can_frame_t frames[TEST_LOG_SIZE];
+    uint32_t count;
+} test_rx[2];
+
+/**
+ * @brief Read the receive rings of both CAN into `test_rx`.
+ *
+ */
+static void test_drain(void) {
+    for (uint32_t c = 0; c < 2; ++c) {
+        uint32_t space = TEST_LOG_SIZE - test_rx[c].count;
+        test_rx[c].count += can_receive_batch(
+            (can_selected_t)c, &test_rx[c].frames[test_rx[c].count], space);
+    }
+}
+
+/**
+ * @brief Run the simulation and read the receive rings in slices.
+ *
+ * @param bits Time to run. Unit: bit on bus 0.
+ */
+static void test_run_bits(uint32_t bits) {
+    uint64_t slice = (uint64_t)sim_can_bus_bit_cycles(0) * TEST_SLICE_BITS;
+
+    for (uint32_t i = 0; i < bits; i += TEST_SLICE_BITS) {
+        sim_run(slice);
+        test_drain();
+    }
+}
+
+/**
+ * @brief Whether all nodes and mailboxes are idle.
+ *
+ * @return Return 1 if no frame is waiting.
+ */
+static uint8_t test_tx_idle(void) {
+    for (int n = 0; n < SIM_CAN_NODES; ++n) {
+        if (sim_can_node_pending(n) != 0) {
+            return 0;
+        }
+    }
+
+    return ((CAN1->TSR & CAN_TSR_TME) == CAN_TSR_TME) &&
+           ((CAN2->TSR & CAN_TSR_TME) == CAN_TSR_TME);
+}
+
+/**
+ * @brief Run until all frames are sent, then wait the tail.
+ *
+ * @param timeout Maximum time. Unit: bit on bus 0.
+ * @return Return 1 if all frames are sent.
+ */
+static uint8_t test_settle(uint32_t timeout) {
+    for (uint32_t waited = 0; waited < timeout; waited += TEST_SLICE_BITS) {
+        if (test_tx_idle()) {
+            test_run_bits(TEST_TAIL_BITS);
+            return 1;
+        }
+        test_run_bits(TEST_SLICE_BITS);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Make a frame of virtual node, the data depends on the ID.
+ *
+ * @param id The ID.
+ * @param ide `CAN_ID_STD` or `CAN_ID_EXT`.
+ * @param rtr `CAN_RTR_DATA` or `CAN_RTR_REMOTE`.
+ * @param dlc Data length.
+ * @return The frame.
+ */
+static sim_can_frame_t test_frame(uint32_t id, uint8_t ide, uint8_t rtr,
+                                  uint8_t dlc) {
+    sim_can_frame_t frame = {.id = id, .ide = ide, .rtr = rtr, .dlc = dlc};
+
+    for (uint32_t i = 0; i < 8; ++i) {
+        frame.data[i] = (uint8_t)(id * 7 + i * 31);
+    }
+
+    return frame;
+}
+
+/**
+ * @brief Whether the frame is wanted by the IDs, same rule as
+ *        `can_filter_alloc()`.
+ *
+ * @param ids The IDs.
+ * @param count Number of `ids`. 0: Accept all.
+ * @param frame The frame.
+ * @return Return 1 if wanted.
+ */
+static uint8_t test_wanted(const can_filter_id_t *ids, uint32_t count,
+                           const sim_can_frame_t *frame) {
+    if (count == 0) {
+        return 1;
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+        if ((ids[i].ide == frame->ide) && (frame->id >= ids[i].id) &&
+            (frame->id <= ids[i].last) &&
+            ((frame->rtr == CAN_RTR_DATA) || ids[i].remote)) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Reset the simulator, initialize CAN1 and CAN2.
+ *
+ * @param baud_rate Baud rate of both buses. Unit: Kbps.
+ * @param shared 0: CAN1 on bus 0, CAN2 on bus 1. 1: Both on bus 0.
+ */
+static void test_start(uint32_t baud_rate, uint8_t shared) {
+    can2_deinit();
+    can1_deinit();
+
+    sim_reset();
+    sim_can_bus_set_rate(0, baud_rate * 1000);
+    sim_can_bus_set_rate(1, baud_rate * 1000);
+    sim_can_attach(1, shared ? 0 : 1);
+    memset(test_rx, 0, sizeof(test_rx));
+
+    CHECK_EQ(can1_init(baud_rate, 0), CAN_INIT_OK);
+    CHECK_EQ(can2_init(baud_rate, 0), CAN_INIT_OK);
+
+    /* The tables of protocols are kept over `canx_init()`, they return 1 if
+     * not enabled. */
+    for (uint32_t c = 0; c < 2; ++c) {
+        can_dispatch_init((can_selected_t)c, NULL, 0, NULL);
+        can_change_init((can_selected_t)c, NULL, 0);
+        can_respond_init((can_selected_t)c, NULL, 0);
+    }
+    for (uint8_t channel = 0; channel < CAN_ISOTP_CHANNELS; ++channel) {
+        can_isotp_close(channel);
+    }
+    can_gateway_init(NULL, 0);
+    can_sched_init(NULL, 0);
+}
+
+/**
+ * @brief Run the simulation by ms, read the receive rings and run the
+ *        periodic functions of protocols like a main loop.
+ *
+ * @param ms Time to run. Unit: ms.
+ */
+static void test_run_ms(uint32_t ms) {
+    for (uint32_t i = 0; i < ms; ++i) {
+        sim_run(SIM_HCLK_FREQ / 1000);
+        test_drain();
+        if (HAL_GetTick() % CAN_SCHED_TICK == 0) {
+            can_sched_tick();
+        }
+        can_isotp_poll();
+        can_j1939_poll();
+    }
+}
+
+/**
+ * @brief Send frames from a virtual node one by one, check which CAN
+ *        receives them.
+ *
+ * @param node The virtual node.
+ * @param frames The frames.
+ * @param count Number of `frames`.
+ * @param ids The IDs of CAN1 and CAN2.
+ * @param id_count Number of IDs of CAN1 and CAN2.
+ * @return Number of frames received wrong.
+ */
+static uint32_t test_sweep(int node, const sim_can_frame_t *frames,
+                           uint32_t count, const can_filter_id_t *ids[2],
+                           const uint32_t id_count[2]) {
+    uint32_t wrong = 0;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t before[2] = {test_rx[0].count, test_rx[1].count};
+
+        sim_can_node_send(node, &frames[i]);
+        test_settle(1000);
+
+        for (uint32_t c = 0; c < 2; ++c) {
+            uint32_t got = test_rx[c].count - before[c];
+            uint8_t want = test_wanted(ids[c], id_count[c], &frames[i]);
+            const can_frame_t *rx = &test_rx[c].frames[before[c]];
+
+            if ((got != want) ||
+                (got && ((rx->id != frames[i].id) ||
+                         (rx->ide != frames[i].ide) ||
+                         (rx->rtr != frames[i].rtr)))) {
+                if (wrong < 8) {
+                    printf("    CAN%u: frame 0x%X ide %u rtr %u: got %u, "
+                           "want %u\n",
+                           (unsigned)c + 1, (unsigned)frames[i].id,
+                           frames[i].ide, frames[i].rtr, (unsigned)got,
+                           want);
+                }
+                ++wrong;
+            }
+        }
+    }
+
+    return wrong;
+}
+
+/**
+ * @}
+ */
+
+/*****************************************************************************
+ * @defgroup Bit timing.
+ * @{
+ */
+
+/**
+ * @brief The common bit rates at 36 MHz are exact, sample point 87.5%.
+ *
+ */
+static void test_rate_table(void) {
+    static const uint32_t rates[] = {1000000, 800000, 500000, 250000, 125000,
+                                     100000,  50000,  20000,  10000};
+
+    for (uint32_t i = 0; i < sizeof(rates) / sizeof(rates[0]); ++i) {
+        uint32_t prescale, tsjw, tseg1, tseg2;
+
+        CHECK_EQ(can_rate_calc(rates[i], 0, SIM_PCLK1_FREQ, &prescale, &tsjw,
+                               &tseg1, &tseg2),
+                 0);
+
+        uint32_t tq = 1 + tseg1 + tseg2;
+        CHECK_EQ((uint64_t)prescale * tq * rates[i], SIM_PCLK1_FREQ);
+        CHECK((1 + tseg1) * 1000 / tq >= 850);
+        CHECK((1 + tseg1) * 1000 / tq <= 900);
+        CHECK((tsjw >= 1) && (tsjw <= 4) && (tsjw <= tseg2));
+    }
+}
+
+/**
+ * @brief The bit rates not in table are searched, the results are valid.
+ *
+ */
+static void test_rate_search(void) {
+    static const uint32_t rates[] = {83333, 33333, 47619, 666666, 400000};
+    static const uint32_t delays[] = {0, 100, 300};
+
+    for (uint32_t i = 0; i < sizeof(rates) / sizeof(rates[0]); ++i) {
+        for (uint32_t j = 0; j < sizeof(delays) / sizeof(delays[0]); ++j) {
+            uint32_t prescale, tsjw, tseg1, tseg2;
+
+            if (can_rate_calc(rates[i], delays[j], SIM_PCLK1_FREQ, &prescale,
+                              &tsjw, &tseg1, &tseg2) != 0) {
+                /* Only the long delay at high bit rate may fail. */
+                CHECK((rates[i] > 500000) && (delays[j] != 0));
+                continue;
+            }
+
+            uint32_t tq = 1 + tseg1 + tseg2;
+            uint64_t actual = SIM_PCLK1_FREQ / ((uint64_t)prescale * tq);
+            uint64_t diff =
+                (actual > rates[i]) ? actual - rates[i] : rates[i] - actual;
+
+            CHECK(diff * 1000000 <= (uint64_t)rates[i] * CAN_RATE_TOLERANCE);
+            CHECK((tq >= 8) && (tq <= 25));
+            CHECK((tseg1 >= 1) && (tseg1 <= 16));
+            CHECK((tseg2 >= 2) && (tseg2 <= 8));
+            CHECK((tsjw >= 1) && (tsjw <= 4) && (tsjw <= tseg2));
+            CHECK((prescale >= 1) && (prescale <= 1024));
+            /* The propagation delay fits in time segment 1. */
+            CHECK((uint64_t)delays[j] * 2 * SIM_PCLK1_FREQ / 1000000000 <=
+                  (uint64_t)prescale * tseg1);
+        }
+    }
+}
+
+/**
+ * @brief The invalid and unsatisfiable bit rates are rejected.
+ *
+ */
+static void test_rate_invalid(void) {
+    uint32_t prescale, tsjw, tseg1, tseg2;
+
+    CHECK_EQ(can_rate_calc(0, 0, SIM_PCLK1_FREQ, &prescale, &tsjw, &tseg1,
+                           &tseg2),
+             1);
+    CHECK_EQ(can_rate_calc(1000001, 0, SIM_PCLK1_FREQ, &prescale, &tsjw,
+                           &tseg1, &tseg2),
+             1);
+    /* The delay is longer than a bit. */
+    CHECK_EQ(can_rate_calc(1000000, 2000, SIM_PCLK1_FREQ, &prescale, &tsjw,
+                           &tseg1, &tseg2),
+             1);
+    /* Less than 8 time quanta per bit. */
+    CHECK_EQ(can_rate_calc(1000000, 0, 4000000, &prescale, &tsjw, &tseg1,
+                           &tseg2),
+             1);
+
+    can2_deinit();
+    can1_deinit();
+    sim_reset();
+    CHECK_EQ(can1_init(1000, 2000), CAN_INIT_RATE_ERR);
+}
+
+/**
+ * @brief `canx_init()` sets the bit rate of bus, the frames go through.
+ *
+ */
+static void test_rate_on_bus(void) {
+    static const uint32_t rates[] = {1000, 500, 250, 125};
+
+    for (uint32_t i = 0; i < sizeof(rates) / sizeof(rates[0]); ++i) {
+        test_start(rates[i], 1);
+        CHECK_EQ(sim_can_ctrl_bit_rate(0), rates[i] * 1000);
+        CHECK_EQ(sim_can_ctrl_bit_rate(1), rates[i] * 1000);
+
+        int node = sim_can_node_add(0);
+        uint8_t data[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+        CHECK_EQ(can_send_message(can1_selected, CAN_ID_STD, 0x123, 8, data),
+                 0);
+        CHECK(test_settle(1000));
+
+        sim_can_frame_t frame;
+        CHECK(sim_can_node_recv(node, &frame));
+        CHECK_EQ(frame.id, 0x123);
+        CHECK_EQ(test_rx[1].count, 1);
+        CHECK_EQ(sim_can_bus_get_stats(0)->errors, 0);
+    }
+}
+
+/**
+ * @brief A CAN at the wrong bit rate destroys its frames and receives
+ *        nothing.
+ *
+ */
+static void test_rate_mismatch(void) {
+    test_start(500, 0);
+    can1_deinit();
+    CHECK_EQ(can1_init(250, 0), CAN_INIT_OK);
+
+    int node = sim_can_node_add(0);
+    sim_can_frame_t frame = test_frame(0x55, CAN_ID_STD, CAN_RTR_DATA, 8);
+    sim_can_node_send(node, &frame);
+    can_send_message(can1_selected, CAN_ID_STD, 0x66, 0, NULL);
+    test_run_bits(2000);
+
+    CHECK_EQ(test_rx[0].count, 0);
+    CHECK_EQ(sim_can_node_received(node), 0);
+    CHECK(sim_can_bus_get_stats(0)->errors > 0);
+
+    can_bus_stats_t stats;
+    CHECK_EQ(can_bus_get_stats(can1_selected, &stats), 0);
+    CHECK(stats.tec > 0);
+}
+
+/**
+ * @}
+ */
+
+/*****************************************************************************
+ * @defgroup Filters.
+ * @{
+ */
+
+/**
+ * @brief Both CAN accept all frames after init.
+ *
+ */
+static void test_filter_default(void) {
+    test_start(500, 1);
+
+    int node = sim_can_node_add(0);
+    static const sim_can_frame_t frames[] = {
+        {.id = 0x000, .ide = CAN_ID_STD},
+        {.id = 0x7FF, .ide = CAN_ID_STD, .dlc = 8},
+        {.id = 0x1FFFFFFF, .ide = CAN_ID_EXT, .dlc = 4},
+        {.id = 0x100, .ide = CAN_ID_STD, .rtr = CAN_RTR_REMOTE},
+    };
+    const can_filter_id_t *ids[2] = {NULL, NULL};
+    const uint32_t count[2] = {0, 0};
+
+    CHECK_EQ(test_sweep(node, frames, sizeof(frames) / sizeof(frames[0]), ids,
+                        count),
+             0);
+
+    uint32_t can2sb = (CAN1->FMR & CAN_FMR_CAN2SB) >> CAN_FMR_CAN2SB_Pos;
+    CHECK((can2sb >= 1) && (can2sb <= 27));
+}
+
+/**
+ * @brief Every standard ID and the ext IDs around the wanted ones.
+ *
+ */
+static void test_filter_sweep(void) {
+    static const can_filter_id_t can1_ids[] = {
+        {.id = 0x100, .last = 0x100, .ide = CAN_ID_STD, .fifo = 0},
+        {.id = 0x203, .last = 0x21C, .ide = CAN_ID_STD, .fifo = 1},
+        {.id = 0x7F0, .last = 0x7F0, .ide = CAN_ID_STD, .remote = 1,
+         .fifo = CAN_FILTER_FIFO_AUTO},
+        {.id = 0x1234567, .last = 0x1234567, .ide = CAN_ID_EXT,
+         .fifo = CAN_FILTER_FIFO_AUTO},
+        {.id = 0x18FF0000, .last = 0x18FF00FF, .ide = CAN_ID_EXT,
+         .remote = 1, .fifo = CAN_FILTER_FIFO_AUTO},
+    };
+    static const can_filter_id_t can2_ids[] = {
+        {.id = 0x300, .last = 0x30F, .ide = CAN_ID_STD,
+         .fifo = CAN_FILTER_FIFO_AUTO},
+        {.id = 0x1234567, .last = 0x1234568, .ide = CAN_ID_EXT,
+         .fifo = CAN_FILTER_FIFO_AUTO},
+    };
+    static sim_can_frame_t frames[0x800 + 64];
+    uint32_t count = 0;
+
+    test_start(1000, 1);
+    CHECK_EQ(can_filter_alloc(can1_ids, 5, can2_ids, 2), 0);
+
+    for (uint32_t id = 0; id < 0x800; ++id) {
+        frames[count++] = test_frame(id, CAN_ID_STD, CAN_RTR_DATA, 0);
+    }
+
+    static const uint32_t ext_ids[] = {
+        0x1234566, 0x1234567, 0x1234568, 0x1234569, 0x18FEFFFF, 0x18FF0000,
+        0x18FF0080, 0x18FF00FF, 0x18FF0100, 0x0000100, 0x1FFFFFFF};
+    for (uint32_t i = 0; i < sizeof(ext_ids) / sizeof(ext_ids[0]); ++i) {
+        frames[count++] = test_frame(ext_ids[i], CAN_ID_EXT, CAN_RTR_DATA, 1);
+        frames[count++] =
+            test_frame(ext_ids[i], CAN_ID_EXT, CAN_RTR_REMOTE, 0);
+    }
+
+    static const uint32_t remote_ids[] = {0x100, 0x203, 0x7F0, 0x305};
+    for (uint32_t i = 0; i < sizeof(remote_ids) / sizeof(remote_ids[0]);
+         ++i) {
+        frames[count++] =
+            test_frame(remote_ids[i], CAN_ID_STD, CAN_RTR_REMOTE, 0);
+    }
+
+    int node = sim_can_node_add(0);
+    const can_filter_id_t *ids[2] = {can1_ids, can2_ids};
+    const uint32_t id_count[2] = {5, 2};
+
+    CHECK_EQ(test_sweep(node, frames, count, ids, id_count), 0);
+    CHECK_EQ(sim_can_bus_get_stats(0)->errors, 0);
+}
+
+/**
+ * @brief The filters change at runtime, the CAN keeps running.
+ *
+ */
+static void test_filter_runtime(void) {
+    can_filter_id_t id100 = {.id = 0x100, .last = 0x100, .ide = CAN_ID_STD,
+                             .fifo = CAN_FILTER_FIFO_AUTO};
+    can_filter_id_t id101 = {.id = 0x101, .last = 0x101, .ide = CAN_ID_STD,
+                             .fifo = CAN_FILTER_FIFO_AUTO};
+    can_filter_id_t id555 = {.id = 0x555, .last = 0x555, .ide = CAN_ID_STD,
+                             .fifo = CAN_FILTER_FIFO_AUTO};
+    static const sim_can_frame_t frames[] = {
+        {.id = 0x100, .ide = CAN_ID_STD},
+        {.id = 0x101, .ide = CAN_ID_STD},
+        {.id = 0x555, .ide = CAN_ID_STD},
+        {.id = 0x000, .ide = CAN_ID_STD},
+    };
+    const uint32_t frame_count = sizeof(frames) / sizeof(frames[0]);
+    can_filter_id_t can1_ids[2];
+    const can_filter_id_t *ids[2] = {can1_ids, NULL};
+    uint32_t count[2] = {0, 0};
+
+    test_start(500, 1);
+    int node = sim_can_node_add(0);
+
+    CHECK_EQ(can_filter_alloc(&id100, 1, NULL, 0), 0);
+    can1_ids[0] = id100;
+    count[0] = 1;
+    CHECK_EQ(test_sweep(node, frames, frame_count, ids, count), 0);
+
+    CHECK_EQ(can_filter_add(can1_selected, &id101), 0);
+    can1_ids[1] = id101;
+    count[0] = 2;
+    CHECK_EQ(test_sweep(node, frames, frame_count, ids, count), 0);
+
+    CHECK_EQ(can_filter_remove(can1_selected, &id100), 0);
+    can1_ids[0] = id101;
+    count[0] = 1;
+    CHECK_EQ(test_sweep(node, frames, frame_count, ids, count), 0);
+
+    /* Removing the last ID accepts all. */
+    CHECK_EQ(can_filter_remove(can1_selected, &id101), 0);
+    count[0] = 0;
+    CHECK_EQ(test_sweep(node, frames, frame_count, ids, count), 0);
+
+    CHECK_EQ(can_filter_replace(can1_selected, &id555, 1), 0);
+    can1_ids[0] = id555;
+    count[0] = 1;
+    CHECK_EQ(test_sweep(node, frames, frame_count, ids, count), 0);
+
+    can_filter_id_t invalid = {.id = 0x200, .last = 0x100, .ide = CAN_ID_STD};
+    CHECK_EQ(can_filter_add(can1_selected, &invalid), 3);
+    CHECK_EQ(can_filter_remove(can1_selected, &id100), 3);
+}
+
+/**
+ * @brief The banks are limited, too many IDs are rejected.
+ *
+ */
+static void test_filter_limits(void) {
+    static can_filter_id_t many[CAN_FILTER_IDS + 1];
+
+    test_start(500, 1);
+
+    /* Extended single IDs are 2 per bank, not sequential, so never merged
+     * into a range. */
+    for (uint32_t i = 0; i < CAN_FILTER_IDS + 1; ++i) {
+        many[i] = (can_filter_id_t){.id = 0x10000000 + i * 3,
+                                    .last = 0x10000000 + i * 3,
+                                    .ide = CAN_ID_EXT,
+                                    .fifo = CAN_FILTER_FIFO_AUTO};
+    }
+
+    CHECK_EQ(can_filter_alloc(many, CAN_FILTER_IDS + 1, NULL, 0), 3);
+    CHECK_EQ(can_filter_alloc(many, CAN_FILTER_IDS, many, CAN_FILTER_IDS), 1);
+    CHECK_EQ(can_filter_alloc(many, CAN_FILTER_IDS, NULL, 0), 0);
+
+    can1_deinit();
+    can2_deinit();
+    CHECK_EQ(can_filter_alloc(many, 1, NULL, 0), 4);
+}
+
+/**
+ * @}
+ */
+
+/*****************************************************************************
+ * @defgroup Transmission.
+ * @{
+ */
+
+/**
+ * @brief Content of standard, extended and remote frames of all lengths.
+ *
+ */
+static void test_tx_content(void) {
+    test_start(500, 0);
+    int node = sim_can_node_add(0);
+
+    for (uint8_t len = 0; len <= 8; ++len) {
+        uint8_t data[8];
+        for (uint8_t i = 0; i < 8; ++i) {
+            data[i] = (uint8_t)(len * 16 + i);
+        }
+
+        CHECK_EQ(can_send_message(can1_selected, CAN_ID_STD, 0x100 + len, len,
+                                  data),
+                 0);
+        CHECK(test_settle(1000));
+        CHECK_EQ(can_send_message(can1_selected, CAN_ID_EXT, 0x1ABCDE00 + len,
+                                  len, data),
+                 0);
+        CHECK(test_settle(1000));
+        CHECK_EQ(can_send_remote(can1_selected, CAN_ID_STD, 0x200 + len, len,
+                                 data),
+                 0);
+        CHECK(test_settle(1000));
+        CHECK_EQ(can_send_word(can1_selected, CAN_ID_WORD_EXT(0x00FF00 + len),
+                               len, data),
+                 0);
+        CHECK(test_settle(1000));
+
+        static const struct {
+            uint32_t id;
+            uint8_t ide;
+            uint8_t rtr;
+        } expect[4] = {{0x100, CAN_ID_STD, CAN_RTR_DATA},
+                       {0x1ABCDE00, CAN_ID_EXT, CAN_RTR_DATA},
+                       {0x200, CAN_ID_STD, CAN_RTR_REMOTE},
+                       {0x00FF00, CAN_ID_EXT, CAN_RTR_DATA}};
+
+        for (uint32_t k = 0; k < 4; ++k) {
+            sim_can_frame_t frame;
+            CHECK(sim_can_node_recv(node, &frame));
+            CHECK_EQ(frame.id, expect[k].id + len);
+            CHECK_EQ(frame.ide, expect[k].ide);
+            CHECK_EQ(frame.rtr, expect[k].rtr);
+            CHECK_EQ(frame.dlc, len);
+            if (expect[k].rtr == CAN_RTR_DATA) {
+                CHECK(memcmp(frame.data, data, len) == 0);
+            }
+        }
+    }
+
+    CHECK_EQ(sim_can_ctrl_get_stats(0)->busy_writes, 0);
+}
+
+/**
+ * @brief The mailboxes go on bus by ID, and arbitrate with other nodes.
+ *
+ */
+static void test_tx_arbitration(void) {
+    test_start(500, 0);
+    int node = sim_can_node_add(0);
+    int monitor = sim_can_node_add(0);
+
+    /* Keep the bus busy while the mailboxes are loaded. */
+    sim_can_frame_t busy = test_frame(0x7FF, CAN_ID_STD, CAN_RTR_DATA, 8);
+    sim_can_node_send(node, &busy);
+    test_run_bits(4);
+
+    static const can_frame_t frames[] = {
+        {.id = 0x300, .ide = CAN_ID_STD, .dlc = 1},
+        {.id = 0x200, .ide = CAN_ID_STD, .dlc = 1},
+        {.id = 0x080, .ide = CAN_ID_EXT, .dlc = 1},
+    };
+    CHECK_EQ(can_send_batch(can1_selected, frames, 3), 3);
+
+    sim_can_frame_t node_frames[] = {
+        test_frame(0x250, CAN_ID_STD, CAN_RTR_DATA, 1),
+        test_frame(0x080 << 18, CAN_ID_EXT, CAN_RTR_DATA, 1),
+    };
+    sim_can_node_send(node, &node_frames[0]);
+    sim_can_node_send(node, &node_frames[1]);
+    CHECK(test_settle(2000));
+
+    /* Node frames keep their order, the extended frame with the same base
+     * ID loses to the standard one. */
+    static const uint32_t order[] = {0x7FF, 0x080, 0x200, 0x250,
+                                     0x080 << 18, 0x300};
+    for (uint32_t i = 0; i < sizeof(order) / sizeof(order[0]); ++i) {
+        sim_can_frame_t frame;
+        CHECK(sim_can_node_recv(monitor, &frame));
+        CHECK_EQ(frame.id, order[i]);
+    }
+
+    CHECK(sim_can_ctrl_get_stats(0)->lost_arbitration > 0);
+    CHECK(sim_can_bus_get_stats(0)->arbitrations > 0);
+}
+
+/**
+ * @brief `can_send_batch()` loads the free mailboxes, or the queue.
+ *
+ */
+static void test_tx_batch(void) {
+    static can_frame_t frames[8];
+
+    test_start(500, 0);
+    int node = sim_can_node_add(0);
+
+    for (uint32_t i = 0; i < 8; ++i) {
+        frames[i] = (can_frame_t){.id = 0x400 + i, .ide = CAN_ID_STD,
+                                  .dlc = 2, .data = {(uint8_t)i, 0xA5}};
+    }
+    frames[6].dlc = 9;
+
+    uint32_t sent = can_send_batch(can1_selected, frames, 8);
+#if CAN1_ENABLE_TX_IT && CAN1_TX_QUEUE_SIZE
+    /* The queue takes all, stops at the invalid frame. */
+    CHECK_EQ(sent, 6);
+#else  /* CAN1_ENABLE_TX_IT && CAN1_TX_QUEUE_SIZE */
+    CHECK_EQ(sent, 3);
+#endif /* CAN1_ENABLE_TX_IT && CAN1_TX_QUEUE_SIZE */
+
+    CHECK(test_settle(5000));
+    CHECK_EQ(sim_can_node_received(node), sent);
+
+    for (uint32_t i = 0; i < sent; ++i) {
+        sim_can_frame_t frame;
+        CHECK(sim_can_node_recv(node, &frame));
+        CHECK_EQ(frame.id, 0x400 + i);
+        CHECK_EQ(frame.data[0], i);
+    }
+
+    CHECK_EQ(can_send_batch(can1_selected, NULL, 1), 0);
+}
+
+/**
+ * @brief The frames of same ID keep the order through the transmit queue.
+ *
+ */
+static void test_tx_queue_order(void) {
+#if CAN1_ENABLE_TX_IT && CAN1_TX_QUEUE_SIZE
+    test_start(1000, 0);
+    int node = sim_can_node_add(0);
+    uint32_t pushed = 0;
+
+    while (pushed < 200) {
+        uint8_t data[2] = {(uint8_t)pushed, (uint8_t)(pushed >> 8)};
+        /* Higher priority frames are mixed in, they preempt the
+         * mailboxes. */
+        uint32_t id = (pushed % 5 == 4) ? 0x010 : 0x123;
+
+        if (can_send_message(can1_selected, CAN_ID_STD, id, 2, data) == 0) {
+            ++pushed;
+        } else {
+            test_run_bits(TEST_SLICE_BITS);
+        }
+    }
+    CHECK(test_settle(100000));
+    CHECK_EQ(sim_can_node_received(node), 200);
+
+    uint32_t last[2] = {0, 0};
+    uint8_t first[2] = {1, 1};
+    sim_can_frame_t frame;
+    while (sim_can_node_recv(node, &frame)) {
+        uint32_t k = (frame.id == 0x010);
+        uint32_t seq = frame.data[0] | ((uint32_t)frame.data[1] << 8);
+        CHECK(first[k] || (seq > last[k]));
+        first[k] = 0;
+        last[k] = seq;
+    }
+
+    can_tx_queue_stats_t stats;
+    CHECK_EQ(can_tx_queue_get_stats(can1_selected, &stats), 0);
+    CHECK_EQ(stats.sent, 200);
+    CHECK_EQ(stats.depth, 0);
+#else  /* CAN1_ENABLE_TX_IT && CAN1_TX_QUEUE_SIZE */
+    can_tx_queue_stats_t stats;
+    CHECK_EQ(can_tx_queue_get_stats(can1_selected, &stats), 1);
+#endif /* CAN1_ENABLE_TX_IT && CAN1_TX_QUEUE_SIZE */
+}
+
+/**
+ * @brief Batches keep all mailboxes busy, the mailboxes completed between
+ *        two checks of driver are still counted and not lost.
+ *
+ */
+static void test_tx_queue_flood(void) {
+#if CAN1_ENABLE_TX_IT && CAN1_TX_QUEUE_SIZE
+    test_start(1000, 0);
+    int node = sim_can_node_add(0);
+    can_frame_t frames[4];
+    uint32_t pushed = 0;
+
+    while (pushed < 2000) {
+        for (uint32_t i = 0; i < 4; ++i) {
+            /* The IDs repeat, the lower ones preempt the mailboxes. */
+            frames[i] = (can_frame_t){.id = 0x100 + ((pushed + i) & 0xFF),
+                                      .ide = CAN_ID_STD,
+                                      .dlc = 2,
+                                      .data = {(uint8_t)(pushed + i),
+                                               (uint8_t)((pushed + i) >> 8)}};
+        }
+
+        uint32_t n = can_send_batch(can1_selected, frames, 4);
+        pushed += n;
+        if (n < 4) {
+            sim_run((uint64_t)sim_can_bus_bit_cycles(0) * 16);
+        }
+    }
+    CHECK(test_settle(100000));
+    CHECK_EQ(sim_can_node_received(node), pushed);
+
+    can_tx_queue_stats_t stats;
+    CHECK_EQ(can_tx_queue_get_stats(can1_selected, &stats), 0);
+    CHECK_EQ(stats.sent, pushed);
+    CHECK_EQ(stats.dropped, 0);
+    CHECK_EQ(stats.depth, 0);
+#endif /* CAN1_ENABLE_TX_IT && CAN1_TX_QUEUE_SIZE */
+}
+
+/**
+ * @brief Parameter check and the CAN not initialized.
+ *
+ */
+static void test_tx_invalid(void) {
+    uint8_t data[9] = {0};
+
+    test_start(500, 0);
+
+    CHECK_EQ(can_send_message(can1_selected, CAN_ID_STD, 0x100, 9, data), 3);
+    CHECK_EQ(can_send_message(can1_selected, CAN_ID_STD, 0x100, 1, NULL), 3);
+    CHECK_EQ(can_send_remote(can1_selected, CAN_ID_STD, 0x100, 9, data), 3);
+    CHECK_EQ(can_send_message((can_selected_t)2, CAN_ID_STD, 0x100, 0, NULL),
+             3);
+
+    CHECK_EQ(can2_deinit(), CAN_DEINIT_OK);
+    CHECK_EQ(can_send_message(can2_selected, CAN_ID_STD, 0x100, 0, NULL), 4);
+    CHECK_EQ(can2_deinit(), CAN_NO_INIT);
+}
+
+/**
+ * @brief Without acknowledgment the mailboxes stay pending, the sender
+ *        times out, and the CAN turns error passive.
+ *
+ */
+static void test_tx_no_ack(void) {
+    test_start(500, 0);
+    int node = sim_can_node_add(0);
+    sim_can_node_set_ack(node, 0);
+
+    uint32_t accepted = 0;
+    uint8_t res = 0;
+    for (uint32_t i = 0; i < 64; ++i) {
+        res = can_send_message(can1_selected, CAN_ID_STD, 0x100 + i, 0, NULL);
+        if (res != 0) {
+            break;
+        }
+        ++accepted;
+    }
+
+    CHECK_EQ(res, 2);
+#if CAN1_ENABLE_TX_IT && CAN1_TX_QUEUE_SIZE
+    CHECK_EQ(accepted, 3 + CAN1_TX_QUEUE_SIZE);
+#else  /* CAN1_ENABLE_TX_IT && CAN1_TX_QUEUE_SIZE */
+    CHECK_EQ(accepted, 3);
+#endif /* CAN1_ENABLE_TX_IT && CAN1_TX_QUEUE_SIZE */
+
+    test_run_bits(10000);
+
+    can_bus_stats_t stats;
+    CHECK_EQ(can_bus_get_stats(can1_selected, &stats), 0);
+    /* LEC is cleared by the error interrupt, it is counted there. */
+    CHECK(stats.error_count[3] > 0);
+    CHECK_EQ(stats.state, CAN_BUS_PASSIVE);
+    CHECK_EQ(stats.tec, 128);
+    CHECK_EQ(sim_can_bus_get_stats(0)->frames, 0);
+
+    /* The frames go out once a node acknowledges. */
+    sim_can_node_set_ack(node, 1);
+    CHECK(test_settle(20000));
+    CHECK_EQ(sim_can_node_received(node), accepted);
+}
+
+/**
+ * @brief The destroyed frames are sent again.
+ *
+ */
+static void test_tx_retry(void) {
+    test_start(500, 0);
+    int node = sim_can_node_add(0);
+
+    sim_can_bus_inject_errors(0, 3);
+    CHECK_EQ(can_send_message(can1_selected, CAN_ID_STD, 0x321, 0, NULL), 0);
+    CHECK(test_settle(2000));
+
+    CHECK_EQ(sim_can_node_received(node), 1);
+    CHECK_EQ(sim_can_bus_get_stats(0)->errors, 3);
+
+    can_bus_stats_t stats;
+    CHECK_EQ(can_bus_get_stats(can1_selected, &stats), 0);
+    /* +8 for each error, -1 for success. */
+    CHECK_EQ(stats.tec, 23);
+    CHECK_EQ(stats.state, CAN_BUS_ACTIVE);
+}
+
+/**
+ * @}
+ */
+
+/*****************************************************************************
+ * @defgroup Bus-off recovery.
+ * @{
+ */
+
+/* Errors to turn a transmitter bus-off, TEC +8 for each. */
+#define TEST_BUS_OFF_ERRORS 32
+/* Bus-off recovery sequence, 128 occurrences of 11 recessive bits. */
+#define TEST_RECOVERY_BITS  (128 * 11)
+/* Bits of 1 ms at 500 Kbps. */
+#define TEST_MS_BITS        500
+
+/**
+ * @brief Send a frame of CAN1, destroy it until CAN1 turns bus-off.
+ *
+ * @return Return 1 if CAN1 is bus-off.
+ */
+static uint8_t test_bus_off(void) {
+    sim_can_bus_inject_errors(0, TEST_BUS_OFF_ERRORS);
+    CHECK_EQ(can_send_message(can1_selected, CAN_ID_STD, 0x123, 0, NULL), 0);
+
+    for (uint32_t waited = 0; waited < 10000; waited += TEST_SLICE_BITS) {
+        if (CAN1->ESR & CAN_ESR_BOFF) {
+            return 1;
+        }
+        test_run_bits(TEST_SLICE_BITS);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Without recovery the CAN stays bus-off.
+ *
+ */
+static void test_recovery_off(void) {
+#if CAN_BUS_OFF_RECOVERY == 0
+    test_start(500, 0);
+    int node = sim_can_node_add(0);
+
+    CHECK(test_bus_off());
+    CHECK_EQ(CAN1->MCR & CAN_MCR_ABOM, 0);
+
+    test_run_bits(4 * TEST_RECOVERY_BITS);
+    CHECK(CAN1->ESR & CAN_ESR_BOFF);
+    CHECK_EQ(sim_can_node_received(node), 0);
+    CHECK_EQ(can_recovery_poll(can1_selected), CAN_RECOVER_NONE);
+#endif /* CAN_BUS_OFF_RECOVERY == 0 */
+}
+
+/**
+ * @brief The hardware recovers after 128 x 11 recessive bits, the pending
+ *        frame is sent then.
+ *
+ */
+static void test_recovery_hardware(void) {
+#if CAN_BUS_OFF_RECOVERY == 1
+    test_start(500, 0);
+    int node = sim_can_node_add(0);
+
+    CHECK(test_bus_off());
+    CHECK(CAN1->MCR & CAN_MCR_ABOM);
+    CHECK_EQ(can_recovery_poll(can1_selected), CAN_RECOVER_NONE);
+
+    uint32_t waited = 0;
+    while ((CAN1->ESR & CAN_ESR_BOFF) && (waited < 2 * TEST_RECOVERY_BITS)) {
+        test_run_bits(TEST_SLICE_BITS);
+        waited += TEST_SLICE_BITS;
+    }
+    CHECK_EQ(CAN1->ESR & CAN_ESR_BOFF, 0);
+    CHECK(waited + TEST_SLICE_BITS >= TEST_RECOVERY_BITS);
+
+    CHECK(test_settle(2000));
+    CHECK_EQ(sim_can_node_received(node), 1);
+    CHECK_EQ((CAN1->ESR & CAN_ESR_TEC) >> CAN_ESR_TEC_Pos, 0);
+#endif /* CAN_BUS_OFF_RECOVERY == 1 */
+}
+
+/**
+ * @brief `can_recovery_poll()` waits for the backoff time, starts the
+ *        recovery and resumes the transmission. The frames sent while
+ *        bus-off are kept.
+ *
+ */
+static void test_recovery_software(void) {
+#if CAN_BUS_OFF_RECOVERY == 2
+    test_start(500, 0);
+    int node = sim_can_node_add(0);
+
+    CHECK(test_bus_off());
+    CHECK_EQ(CAN1->MCR & CAN_MCR_ABOM, 0);
+    uint32_t bus_off_tick = HAL_GetTick();
+    CHECK_EQ(can_recovery_poll(can1_selected), CAN_RECOVER_WAIT);
+
+    /* The other mailboxes, and the queue if enabled. */
+    for (uint32_t i = 0; i < 4; ++i) {
+        uint8_t data[1] = {(uint8_t)i};
+        can_send_message(can1_selected, CAN_ID_STD, 0x200 + i, 1, data);
+    }
+
+    uint8_t state = CAN_RECOVER_WAIT;
+    while ((state == CAN_RECOVER_WAIT) &&
+           (HAL_GetTick() - bus_off_tick < 4 * CAN_BUS_OFF_BACKOFF_MIN)) {
+        CHECK(CAN1->ESR & CAN_ESR_BOFF);
+        test_run_bits(TEST_MS_BITS);
+        state = can_recovery_poll(can1_selected);
+    }
+    CHECK_EQ(state, CAN_RECOVER_BUSY);
+    CHECK(HAL_GetTick() - bus_off_tick >= CAN_BUS_OFF_BACKOFF_MIN);
+    CHECK_EQ(sim_can_node_received(node), 0);
+
+    for (uint32_t i = 0; (i < 10) && (state == CAN_RECOVER_BUSY); ++i) {
+        test_run_bits(TEST_MS_BITS);
+        state = can_recovery_poll(can1_selected);
+    }
+    CHECK_EQ(state, CAN_RECOVER_NONE);
+    CHECK_EQ(CAN1->ESR & CAN_ESR_BOFF, 0);
+
+    CHECK(test_settle(5000));
+#if CAN1_ENABLE_TX_IT && CAN1_TX_QUEUE_SIZE
+    CHECK_EQ(sim_can_node_received(node), 5);
+#else  /* CAN1_ENABLE_TX_IT && CAN1_TX_QUEUE_SIZE */
+    /* The bus-off frame and the other two mailboxes. */
+    CHECK_EQ(sim_can_node_received(node), 3);
+#endif /* CAN1_ENABLE_TX_IT && CAN1_TX_QUEUE_SIZE */
+#endif /* CAN_BUS_OFF_RECOVERY == 2 */
+}
+
+/**
+ * @}
+ */
+
+/*****************************************************************************
+ * @defgroup Reception and statistics.
+ * @{
+ */
+
+/**
+ * @brief The frames of FIFO0 are read before FIFO1, each FIFO keeps the
+ *        order. A full ring drops the newest frames and counts them.
+ *
+ */
+static void test_rx_ring(void) {
+    static const can_filter_id_t ids[] = {
+        {.id = 0x100, .last = 0x100, .ide = CAN_ID_STD, .fifo = 0},
+        {.id = 0x200, .last = 0x200, .ide = CAN_ID_STD, .fifo = 1},
+    };
+    static can_frame_t frames[64];
+
+    test_start(500, 0);
+    CHECK_EQ(can_filter_alloc(ids, 2, NULL, 0), 0);
+    int node = sim_can_node_add(0);
+
+    for (uint32_t i = 0; i < 10; ++i) {
+        sim_can_frame_t frame =
+            test_frame((i & 1) ? 0x200 : 0x100, CAN_ID_STD, CAN_RTR_DATA, 1);
+        frame.data[0] = (uint8_t)i;
+        sim_can_node_send(node, &frame);
+    }
+    /* Not read until all are received. */
+    sim_run((uint64_t)sim_can_bus_bit_cycles(0) * 10 * 100);
+
+    CHECK_EQ(can_receive_batch(can1_selected, frames, 64), 10);
+    for (uint32_t i = 0; i < 10; ++i) {
+        /* 0, 2, 4, 6, 8 of FIFO0, then 1, 3, 5, 7, 9 of FIFO1. */
+        uint32_t seq = (i < 5) ? (i * 2) : ((i - 5) * 2 + 1);
+        CHECK_EQ(frames[i].id, (seq & 1) ? 0x200 : 0x100);
+        CHECK_EQ(frames[i].data[0], seq);
+    }
+    CHECK_EQ(can_receive_batch(can1_selected, frames, 64), 0);
+
+    /* Overflow of FIFO0 ring. */
+    uint32_t count = 2 * CAN1_RX0_RING_SIZE;
+    for (uint32_t i = 0; i < count; ++i) {
+        sim_can_frame_t frame = test_frame(0x100, CAN_ID_STD, CAN_RTR_DATA, 1);
+        frame.data[0] = (uint8_t)i;
+        sim_can_node_send(node, &frame);
+    }
+    sim_run((uint64_t)sim_can_bus_bit_cycles(0) * count * 100);
+
+    uint32_t got = 0;
+    uint32_t n;
+    /* Read in small batches. */
+    while ((n = can_receive_batch(can1_selected, &frames[got], 4)) != 0) {
+        CHECK(n <= 4);
+        got += n;
+    }
+    CHECK_EQ(got, CAN1_RX0_RING_SIZE);
+    CHECK_EQ(can_rx_ring_get_dropped(can1_selected), count - got);
+    for (uint32_t i = 0; i < got; ++i) {
+        CHECK_EQ(frames[i].data[0], i);
+    }
+    CHECK_EQ(sim_can_ctrl_get_stats(0)->rx_overrun, 0);
+
+    CHECK_EQ(can_receive_batch(can1_selected, NULL, 4), 0);
+}
+
+/**
+ * @brief The frames and bits are counted, the rates are updated every
+ *        window.
+ *
+ */
+static void test_stats_rates(void) {
+    test_start(500, 0);
+    uint32_t start = HAL_GetTick();
+    int node = sim_can_node_add(0);
+
+    for (uint32_t i = 0; i < 20; ++i) {
+        sim_can_frame_t frame = test_frame(0x300, CAN_ID_STD, CAN_RTR_DATA, 8);
+        sim_can_node_send(node, &frame);
+        CHECK_EQ(can_send_message(can1_selected, CAN_ID_EXT, 0x1000 + i, 4,
+                                  frame.data),
+                 0);
+        CHECK(test_settle(2000));
+    }
+
+    can_bus_stats_t stats;
+    CHECK_EQ(can_bus_get_stats(can1_selected, &stats), 0);
+    CHECK_EQ(stats.rx_frames, 20);
+    CHECK_EQ(stats.tx_frames, 20);
+    CHECK_EQ(stats.state, CAN_BUS_ACTIVE);
+    CHECK_EQ(stats.tec, 0);
+    CHECK_EQ(stats.rec, 0);
+    /* The window is not over yet. */
+    CHECK_EQ(stats.rx_fps, 0);
+
+    test_run_ms(1000 - (HAL_GetTick() - start));
+    CHECK_EQ(can_bus_get_stats(can1_selected, &stats), 0);
+
+    /* Standard 8 bytes: 111 bits, extended 4 bytes: 99 bits. */
+    uint32_t elapsed = HAL_GetTick() - start;
+    CHECK_EQ(stats.rx_fps, 20 * 1000 / elapsed);
+    CHECK_EQ(stats.tx_fps, 20 * 1000 / elapsed);
+    CHECK_EQ(stats.rx_bps, 20 * 111 * 1000 / elapsed);
+    CHECK_EQ(stats.tx_bps, 20 * 99 * 1000 / elapsed);
+    CHECK_EQ(stats.bus_load, (stats.rx_bps + stats.tx_bps) / 500);
+    CHECK(stats.bus_load > 0);
+
+    /* An idle window. */
+    test_run_ms(2000 - (HAL_GetTick() - start));
+    CHECK_EQ(can_bus_get_stats(can1_selected, &stats), 0);
+    CHECK_EQ(stats.rx_fps, 0);
+    CHECK_EQ(stats.bus_load, 0);
+    CHECK_EQ(stats.rx_frames, 20);
+
+    CHECK_EQ(can_bus_get_stats(can1_selected, NULL), 3);
+    can2_deinit();
+    CHECK_EQ(can_bus_get_stats(can2_selected, &stats), 4);
+}
+
+/**
+ * @}
+ */
+
+/*****************************************************************************
+ * @defgroup Dispatch and time stamp.
+ * @{
+ */
+
+#if CAN_DISPATCH_ENABLE && CAN_DISPATCH_IN_ISR
+
+/**
+ * @brief Frames passed to the handlers of dispatch.
+ */
+static struct {
+    uint32_t id[16];
+    uint8_t handler[16];
+    uint32_t count;
+} test_dispatched;
+
+/**
+ * @brief Log the frame and the handler.
+ *
+ * @param handler Number of handler.
+ * @param frame The frame.
+ */
+static void test_dispatch_log(uint8_t handler, const can_frame_t *frame) {
+    if (test_dispatched.count < 16) {
+        test_dispatched.id[test_dispatched.count] = frame->id;
+        test_dispatched.handler[test_dispatched.count] = handler;
+        ++test_dispatched.count;
+    }
+}
+
+static void test_dispatch_a(can_selected_t can_selected,
+                            const can_frame_t *frame) {
+    CHECK_EQ(can_selected, can1_selected);
+    test_dispatch_log(1, frame);
+}
+
+static void test_dispatch_b(can_selected_t can_selected,
+                            const can_frame_t *frame) {
+    CHECK_EQ(can_selected, can1_selected);
+    test_dispatch_log(2, frame);
+}
+
+static void test_dispatch_default(can_selected_t can_selected,
+                                  const can_frame_t *frame) {
+    UNUSED(can_selected);
+    test_dispatch_log(3, frame);
+}
+
+#endif /* CAN_DISPATCH_ENABLE && CAN_DISPATCH_IN_ISR */
+
+/**
+ * @brief The frames are passed to the handler of ID in receive interrupt,
+ *        found by filter match index (list mode) or by lookup (mask mode),
+ *        the others go to receive ring.
+ *
+ */
+static void test_dispatch(void) {
+#if CAN_DISPATCH_ENABLE && CAN_DISPATCH_IN_ISR
+    static const can_filter_id_t ids[] = {
+        {.id = 0x100, .last = 0x100, .ide = CAN_ID_STD},
+        {.id = 0x123, .last = 0x123, .ide = CAN_ID_STD},
+        {.id = 0x124, .last = 0x124, .ide = CAN_ID_STD},
+        {.id = 0x200, .last = 0x2FF, .ide = CAN_ID_STD},
+        {.id = 0x18FF0102, .last = 0x18FF0102, .ide = CAN_ID_EXT},
+    };
+    static const can_dispatch_entry_t entries[] = {
+        {.id = 0x18FF0102, .ide = CAN_ID_EXT, .handler = test_dispatch_b},
+        {.id = 0x100, .ide = CAN_ID_STD, .handler = test_dispatch_a},
+        {.id = 0x250, .ide = CAN_ID_STD, .handler = test_dispatch_b},
+        {.id = 0x123, .ide = CAN_ID_STD, .handler = test_dispatch_a},
+        {.id = 0x18FF0100, .ide = CAN_ID_EXT, .handler = test_dispatch_a},
+    };
+    static const uint32_t sent[] = {0x100, 0x123, 0x124, 0x250, 0x251,
+                                    0x18FF0102};
+    static const uint8_t want[] = {1, 1, 0, 2, 0, 2};
+
+    test_start(500, 0);
+    memset(&test_dispatched, 0, sizeof(test_dispatched));
+    CHECK_EQ(can_filter_alloc(ids, 5, NULL, 0), 0);
+    CHECK_EQ(can_dispatch_init(can1_selected, entries, 5, NULL), 0);
+    int node = sim_can_node_add(0);
+
+    for (uint32_t i = 0; i < 6; ++i) {
+        sim_can_frame_t frame =
+            test_frame(sent[i], (sent[i] > 0x7FF) ? CAN_ID_EXT : CAN_ID_STD,
+                       CAN_RTR_DATA, 8);
+        sim_can_node_send(node, &frame);
+    }
+    CHECK(test_settle(5000));
+
+    CHECK_EQ(test_dispatched.count, 4);
+    CHECK_EQ(test_rx[0].count, 2);
+    for (uint32_t i = 0, d = 0, r = 0; i < 6; ++i) {
+        if (want[i] == 0) {
+            CHECK_EQ(test_rx[0].frames[r++].id, sent[i]);
+        } else {
+            CHECK_EQ(test_dispatched.id[d], sent[i]);
+            CHECK_EQ(test_dispatched.handler[d++], want[i]);
+        }
+    }
+
+    /* The frames read from receive ring. */
+    CHECK_EQ(can_dispatch(can1_selected, &test_rx[0].frames[0]), 1);
+    CHECK_EQ(can_dispatch_init(can1_selected, entries, 5,
+                               test_dispatch_default),
+             0);
+    CHECK_EQ(can_dispatch(can1_selected, &test_rx[0].frames[0]), 0);
+    CHECK_EQ(can_dispatch(can1_selected, &test_rx[0].frames[1]), 0);
+    CHECK_EQ(test_dispatched.count, 6);
+    CHECK_EQ(test_dispatched.handler[4], 3);
+    CHECK_EQ(test_dispatched.id[5], 0x251);
+
+    /* Looked up without filter match index. */
+    can_frame_t frame = {.id = 0x18FF0100, .ide = CAN_ID_EXT, .fmi = 0};
+    CHECK_EQ(can_dispatch(can1_selected, &frame), 0);
+    CHECK_EQ(test_dispatched.handler[6], 1);
+    CHECK_EQ(can_dispatch(can1_selected, NULL), 1);
+
+    /* With the default handler, no frame goes to receive ring. */
+    sim_can_frame_t other = test_frame(0x124, CAN_ID_STD, CAN_RTR_DATA, 8);
+    sim_can_node_send(node, &other);
+    CHECK(test_settle(1000));
+    CHECK_EQ(test_rx[0].count, 2);
+    CHECK_EQ(test_dispatched.count, 8);
+    CHECK_EQ(test_dispatched.handler[7], 3);
+
+    /* Repeated ID, no handler, too many entries. */
+    static const can_dispatch_entry_t repeated[] = {
+        {.id = 0x18FF0102, .ide = CAN_ID_EXT, .handler = test_dispatch_b},
+        {.id = 0x18FF0102, .ide = CAN_ID_EXT, .handler = test_dispatch_a},
+        {.id = 0x7FF, .ide = CAN_ID_STD, .handler = NULL},
+        {.id = 0x800, .ide = CAN_ID_STD, .handler = test_dispatch_a},
+    };
+    CHECK_EQ(can_dispatch_init(can1_selected, repeated, 2, NULL), 3);
+    CHECK_EQ(can_dispatch_init(can1_selected, &repeated[2], 1, NULL), 3);
+    CHECK_EQ(can_dispatch_init(can1_selected, &repeated[3], 1, NULL), 3);
+    CHECK_EQ(can_dispatch_init(can1_selected, entries, CAN_DISPATCH_SIZE + 1,
+                               NULL),
+             3);
+
+    /* The failed table is not used. */
+    sim_can_node_send(node, &other);
+    CHECK(test_settle(1000));
+    CHECK_EQ(test_rx[0].count, 3);
+    CHECK_EQ(test_dispatched.count, 8);
+#else  /* CAN_DISPATCH_ENABLE && CAN_DISPATCH_IN_ISR */
+    CHECK_EQ(can_dispatch_init(can1_selected, NULL, 0, NULL),
+             CAN_DISPATCH_ENABLE ? 0 : 1);
+#endif /* CAN_DISPATCH_ENABLE && CAN_DISPATCH_IN_ISR */
+}
+
+/**
+ * @brief The 16-bit time stamps are extended over the wrap, the difference
+ *        is the time between two SOF on bus.
+ *
+ */
+static void test_time_stamp(void) {
+#if CAN1_TTCM
+    test_start(1000, 0);
+    uint32_t bit_cycles = sim_can_bus_bit_cycles(0);
+    int node = sim_can_node_add(0);
+    int observer = sim_can_node_add(0);
+    sim_can_frame_t frame = test_frame(0x100, CAN_ID_STD, CAN_RTR_DATA, 8);
+    sim_can_frame_t seen[2];
+
+    /* Over the period of 16-bit time stamp. */
+    sim_can_node_send(node, &frame);
+    test_run_ms(70);
+    sim_can_node_send(node, &frame);
+    CHECK(test_settle(1000));
+
+    CHECK_EQ(test_rx[0].count, 2);
+    CHECK(sim_can_node_recv(observer, &seen[0]));
+    CHECK(sim_can_node_recv(observer, &seen[1]));
+    if ((test_rx[0].count != 2) || (seen[1].time <= seen[0].time)) {
+        return;
+    }
+
+    uint32_t gap = (uint32_t)((seen[1].time - seen[0].time) / bit_cycles);
+    CHECK(gap > 65536);
+    CHECK_EQ(test_rx[0].frames[1].timestamp - test_rx[0].frames[0].timestamp,
+             gap);
+
+    /* From SOF to now, the time of now is estimated by ms. */
+    uint32_t frame_bits = sim_can_frame_bits(&frame);
+    uint32_t bits = (uint32_t)((sim_now() - seen[1].time) / bit_cycles);
+    uint32_t latency = can_rx_latency(can1_selected, &test_rx[0].frames[1]);
+    CHECK(latency + 1000 >= frame_bits + bits);
+    CHECK(latency <= frame_bits + bits + 1000);
+
+    uint64_t now = can_timestamp_now(can1_selected);
+    test_run_ms(10);
+    CHECK_EQ(can_timestamp_now(can1_selected) - now, 10 * 1000);
+    CHECK_EQ(can_timestamp_now(can2_selected) != 0, CAN2_TTCM != 0);
+#else  /* CAN1_TTCM */
+    can_frame_t frame = {.id = 0x100};
+    CHECK_EQ(can_timestamp_now(can1_selected), 0);
+    CHECK_EQ(can_rx_latency(can1_selected, &frame), 0);
+#endif /* CAN1_TTCM */
+}
+
+/**
+ * @brief A node floods the bus with higher priority, the transmit latency
+ *        of the queued frames is measured from push to SOF.
+ *
+ */
+static void test_latency(void) {
+#if CAN1_TTCM && CAN1_ENABLE_TX_IT && CAN1_TX_QUEUE_SIZE
+    test_start(500, 0);
+    int node = sim_can_node_add(0);
+    uint8_t data[8] = {0};
+    can_latency_stats_t stats;
+
+    CHECK_EQ(can_latency_get_stats(can1_selected, &stats), 0);
+    CHECK_EQ(stats.count, 0);
+
+    for (uint32_t i = 0; i < 10; ++i) {
+        sim_can_frame_t frame = test_frame(0x010, CAN_ID_STD, CAN_RTR_DATA, 8);
+        sim_can_node_send(node, &frame);
+    }
+    for (uint32_t i = 0; i < 10; ++i) {
+        CHECK_EQ(can_send_message(can1_selected, CAN_ID_STD, 0x400 + i, 8,
+                                  data),
+                 0);
+    }
+    CHECK(test_settle(20000));
+
+    CHECK_EQ(can_latency_get_stats(can1_selected, &stats), 0);
+    CHECK_EQ(stats.count, 10);
+    CHECK(stats.min <= stats.last);
+    CHECK(stats.last <= stats.max);
+    /* The last frame waits for the 10 frames of node and the 9 queued
+     * before it, about 2000 bits. */
+    CHECK(stats.max >= 19 * 100);
+    CHECK(stats.max <= 19 * 140 + 1000);
+    CHECK(stats.total >= (uint64_t)stats.min * 10);
+    CHECK(stats.total <= (uint64_t)stats.max * 10);
+    CHECK_EQ(stats.tx_timestamp != 0, 1);
+
+    /* Idle bus, sent at once. The time of push is estimated by ms, it
+     * must not be later than the SOF. */
+    for (uint32_t i = 0; i < 200; ++i) {
+        test_run_bits(37);
+        CHECK_EQ(can_send_message(can1_selected, CAN_ID_STD, 0x400, 8, data),
+                 0);
+        CHECK(test_settle(1000));
+        CHECK_EQ(can_latency_get_stats(can1_selected, &stats), 0);
+        CHECK(stats.last <= 1000);
+    }
+
+    CHECK_EQ(can_latency_get_stats(can1_selected, NULL), 3);
+#else  /* CAN1_TTCM && CAN1_ENABLE_TX_IT && CAN1_TX_QUEUE_SIZE */
+    can_latency_stats_t stats;
+    CHECK_EQ(can_latency_get_stats(can1_selected, &stats), 1);
+#endif /* CAN1_TTCM && CAN1_ENABLE_TX_IT && CAN1_TX_QUEUE_SIZE */
+}
+
+/**
+ * @}
+ */
+
+/*****************************************************************************
+ * @defgroup ISO-TP.
+ * @{
+ */
+
+#if CAN_ISOTP_ENABLE
+
+/**
+ * @brief Results passed to the handlers of ISO-TP channels.
+ */
+static struct {
+    uint8_t result;
+    uint32_t len;
+    uint32_t calls;
+} test_isotp_rx[2], test_isotp_tx[2];
+
+static void test_isotp_on_rx(uint8_t channel, uint8_t result, uint32_t len) {
+    test_isotp_rx[channel].result = result;
+    test_isotp_rx[channel].len = len;
+    ++test_isotp_rx[channel].calls;
+}
+
+static void test_isotp_on_tx(uint8_t channel, uint8_t result, uint32_t len) {
+    test_isotp_tx[channel].result = result;
+    test_isotp_tx[channel].len = len;
+    ++test_isotp_tx[channel].calls;
+}
+
+/**
+ * @brief Open channel 0 on CAN1 and channel 1 on CAN2, they talk to each
+ *        other on the shared bus.
+ *
+ * @param block_size Block size of both channels.
+ * @param st_min STmin of both channels.
+ * @param rx_bufs The receive buffers of channels.
+ * @param rx_size Size of each receive buffer.
+ */
+static void test_isotp_open(uint8_t block_size, uint8_t st_min,
+                            uint8_t rx_bufs[2][512], uint32_t rx_size) {
+    can_isotp_config_t config = {
+        .can_selected = can1_selected,
+        .tx_id = 0x7E0,
+        .rx_id = 0x7E8,
+        .ide = CAN_ID_STD,
+        .block_size = block_size,
+        .st_min = st_min,
+        .rx_buf = rx_bufs[0],
+        .rx_size = rx_size,
+        .rx_handler = test_isotp_on_rx,
+        .tx_handler = test_isotp_on_tx,
+    };
+
+    memset(test_isotp_rx, 0, sizeof(test_isotp_rx));
+    memset(test_isotp_tx, 0, sizeof(test_isotp_tx));
+    CHECK_EQ(can_isotp_open(0, &config), 0);
+
+    config.can_selected = can2_selected;
+    config.tx_id = 0x7E8;
+    config.rx_id = 0x7E0;
+    config.rx_buf = rx_bufs[1];
+    CHECK_EQ(can_isotp_open(1, &config), 0);
+}
+
+#endif /* CAN_ISOTP_ENABLE */
+
+/**
+ * @brief A long message is sent by first frame, flow control and blocks of
+ *        consecutive frames, and assembled by the receiver.
+ *
+ */
+static void test_isotp_transfer(void) {
+#if CAN_ISOTP_ENABLE
+    static uint8_t rx_bufs[2][512];
+    static uint8_t message[300];
+    sim_can_frame_t frame;
+
+    for (uint32_t i = 0; i < sizeof(message); ++i) {
+        message[i] = (uint8_t)(i * 13 + 5);
+    }
+
+    test_start(500, 1);
+    int observer = sim_can_node_add(0);
+    test_isotp_open(4, 0, rx_bufs, sizeof(rx_bufs[0]));
+
+    can_tx_queue_stats_t before, after;
+    uint8_t queue = can_tx_queue_get_stats(can1_selected, &before) == 0;
+
+    CHECK_EQ(can_isotp_send(0, message, sizeof(message)), 0);
+    CHECK_EQ(can_isotp_send(0, message, sizeof(message)), 2);
+    test_run_ms(50);
+
+    CHECK_EQ(test_isotp_tx[0].calls, 1);
+    CHECK_EQ(test_isotp_tx[0].result, CAN_ISOTP_OK);
+    CHECK_EQ(test_isotp_tx[0].len, sizeof(message));
+    CHECK_EQ(test_isotp_rx[1].calls, 1);
+    CHECK_EQ(test_isotp_rx[1].result, CAN_ISOTP_OK);
+    CHECK_EQ(test_isotp_rx[1].len, sizeof(message));
+    CHECK_EQ(memcmp(rx_bufs[1], message, sizeof(message)), 0);
+    /* Not passed to the receive rings. */
+    CHECK_EQ(test_rx[0].count + test_rx[1].count, 0);
+
+    /* FF, then 42 CF in blocks of 4, FC before each block. */
+    uint32_t cf = 0, fc = 0;
+    CHECK(sim_can_node_recv(observer, &frame));
+    CHECK_EQ(frame.id, 0x7E0);
+    CHECK_EQ(frame.data[0], 0x10 | (sizeof(message) >> 8));
+    CHECK_EQ(frame.data[1], sizeof(message) & 0xFF);
+    while (sim_can_node_recv(observer, &frame)) {
+        CHECK_EQ(frame.dlc, 8);
+        if (frame.id == 0x7E8) {
+            /* Before each block. */
+            CHECK_EQ(cf, fc * 4);
+            CHECK_EQ(frame.data[0], 0x30);
+            CHECK_EQ(frame.data[1], 4);
+            CHECK_EQ(frame.data[2], 0);
+            ++fc;
+        } else {
+            CHECK_EQ(frame.id, 0x7E0);
+            CHECK_EQ(frame.data[0], 0x20 | ((cf + 1) & 0x0F));
+            CHECK_EQ(frame.data[1], message[6 + cf * 7]);
+            ++cf;
+        }
+    }
+    CHECK_EQ(cf, 42);
+    CHECK_EQ(fc, 11);
+
+    if (queue) {
+        /* The consecutive frames go through the transmit queue. */
+        CHECK_EQ(can_tx_queue_get_stats(can1_selected, &after), 0);
+        CHECK(after.queued > before.queued);
+        CHECK_EQ(after.dropped, before.dropped);
+    }
+
+    /* Single frame, the other way. */
+    CHECK_EQ(can_isotp_send(1, message, 7), 0);
+    CHECK_EQ(test_isotp_tx[1].calls, 1);
+    test_run_ms(2);
+    CHECK_EQ(test_isotp_rx[0].calls, 1);
+    CHECK_EQ(test_isotp_rx[0].len, 7);
+    CHECK_EQ(memcmp(rx_bufs[0], message, 7), 0);
+
+    CHECK_EQ(can_isotp_send(0, NULL, 10), 3);
+    CHECK_EQ(can_isotp_send(CAN_ISOTP_CHANNELS, message, 10), 3);
+#else  /* CAN_ISOTP_ENABLE */
+    uint8_t data[8] = {0};
+    CHECK_EQ(can_isotp_open(0, NULL), 1);
+    CHECK_EQ(can_isotp_send(0, data, 8), 1);
+#endif /* CAN_ISOTP_ENABLE */
+}
+
+/**
+ * @brief The consecutive frames are separated by STmin, the message longer
+ *        than receive buffer is refused, the sender times out without flow
+ *        control.
+ *
+ */
+static void test_isotp_flow(void) {
+#if CAN_ISOTP_ENABLE
+    static uint8_t rx_bufs[2][512];
+    static uint8_t message[100];
+    sim_can_frame_t frame;
+
+    for (uint32_t i = 0; i < sizeof(message); ++i) {
+        message[i] = (uint8_t)(i * 3);
+    }
+
+    test_start(500, 1);
+    int observer = sim_can_node_add(0);
+    uint32_t bit_cycles = sim_can_bus_bit_cycles(0);
+    test_isotp_open(0, 5, rx_bufs, sizeof(rx_bufs[0]));
+
+    /* 14 CF, no more flow control. */
+    CHECK_EQ(can_isotp_send(0, message, sizeof(message)), 0);
+    test_run_ms(14 * 7);
+    CHECK_EQ(test_isotp_tx[0].calls, 1);
+    CHECK_EQ(test_isotp_rx[1].result, CAN_ISOTP_OK);
+    CHECK_EQ(memcmp(rx_bufs[1], message, sizeof(message)), 0);
+
+    uint64_t last = 0;
+    uint32_t cf = 0;
+    while (sim_can_node_recv(observer, &frame)) {
+        if ((frame.data[0] & 0xF0) == 0x20) {
+            if (cf != 0) {
+                CHECK((frame.time - last) / bit_cycles >= 5 * 500);
+            }
+            last = frame.time;
+            ++cf;
+        }
+    }
+    CHECK_EQ(cf, 14);
+    /* The last frame has 3 bytes, padded. */
+    CHECK_EQ(frame.dlc, CAN_ISOTP_PADDING ? 8 : 4);
+    CHECK_EQ(frame.data[3], message[99]);
+    if (CAN_ISOTP_PADDING) {
+        CHECK_EQ(frame.data[7], CAN_ISOTP_PAD_BYTE);
+    }
+
+    /* Overflow, 101 bytes do not fit into 100 bytes. */
+    test_isotp_open(0, 0, rx_bufs, sizeof(message));
+    static uint8_t longer[101];
+    CHECK_EQ(can_isotp_send(0, longer, sizeof(longer)), 0);
+    test_run_ms(5);
+    CHECK_EQ(test_isotp_tx[0].calls, 1);
+    CHECK_EQ(test_isotp_tx[0].result, CAN_ISOTP_OVERFLOW_ERR);
+    CHECK_EQ(test_isotp_rx[1].calls, 1);
+    CHECK_EQ(test_isotp_rx[1].result, CAN_ISOTP_OVERFLOW_ERR);
+    CHECK_EQ(test_isotp_rx[1].len, sizeof(longer));
+
+    /* No receiver. */
+    can_isotp_close(1);
+    CHECK_EQ(can_isotp_send(0, message, sizeof(message)), 0);
+    test_run_ms(CAN_ISOTP_TIMEOUT);
+    CHECK_EQ(test_isotp_tx[0].calls, 1);
+    test_run_ms(2);
+    CHECK_EQ(test_isotp_tx[0].calls, 2);
+    CHECK_EQ(test_isotp_tx[0].result, CAN_ISOTP_TIMEOUT_ERR);
+    CHECK_EQ(can_isotp_send(1, message, sizeof(message)), 3);
+
+    /* The sender stops, the receiver times out. */
+    test_isotp_open(0, 0, rx_bufs, sizeof(rx_bufs[0]));
+    int sender = sim_can_node_add(0);
+    frame = test_frame(0x7E0, CAN_ID_STD, CAN_RTR_DATA, 8);
+    frame.data[0] = 0x10;
+    frame.data[1] = 20;
+    sim_can_node_send(sender, &frame);
+    test_run_ms(CAN_ISOTP_TIMEOUT + 2);
+    CHECK_EQ(test_isotp_rx[1].calls, 1);
+    CHECK_EQ(test_isotp_rx[1].result, CAN_ISOTP_TIMEOUT_ERR);
+    CHECK_EQ(test_isotp_rx[1].len, 6);
+
+    /* Wrong sequence number. */
+    sim_can_node_send(sender, &frame);
+    frame.data[0] = 0x22;
+    sim_can_node_send(sender, &frame);
+    test_run_ms(2);
+    CHECK_EQ(test_isotp_rx[1].calls, 2);
+    CHECK_EQ(test_isotp_rx[1].result, CAN_ISOTP_FRAME_ERR);
+#endif /* CAN_ISOTP_ENABLE */
+}
+
+/**
+ * @}
+ */
+
+/*****************************************************************************
+ * @defgroup Gateway, scheduler, change filter and responder.
+ * @{
+ */
+
+/**
+ * @brief The frames are forwarded between the buses by the first matched
+ *        route, the ID is rewritten, `local` also keeps it.
+ *
+ */
+static void test_gateway(void) {
+#if CAN_GATEWAY_ENABLE
+    static const can_gateway_route_t routes[] = {
+        {.src = can1_selected, .dest = can2_selected, .id = 0x100,
+         .mask = 0x7F0, .ide = CAN_ID_STD, .new_id = 0x500,
+         .rewrite_mask = 0x7F0},
+        {.src = can2_selected, .dest = can1_selected, .id = 0x18FEF000,
+         .mask = 0x1FFFFF00, .ide = CAN_ID_EXT, .local = 1},
+        {.src = can1_selected, .dest = can2_selected, .id = 0x100,
+         .mask = 0x700, .ide = CAN_ID_STD},
+    };
+    sim_can_frame_t frame, got;
+
+    test_start(500, 0);
+    int node1 = sim_can_node_add(0);
+    int node2 = sim_can_node_add(1);
+    CHECK_EQ(can_gateway_init(routes, 3), 0);
+
+    /* Rewritten, not kept. */
+    frame = test_frame(0x103, CAN_ID_STD, CAN_RTR_DATA, 5);
+    sim_can_node_send(node1, &frame);
+    CHECK(test_settle(1000));
+    CHECK(sim_can_node_recv(node2, &got));
+    CHECK_EQ(got.id, 0x503);
+    CHECK_EQ(got.ide, CAN_ID_STD);
+    CHECK_EQ(got.dlc, 5);
+    CHECK_EQ(memcmp(got.data, frame.data, 5), 0);
+    CHECK_EQ(test_rx[0].count, 0);
+
+    /* The second route, ID kept. */
+    frame = test_frame(0x1A5, CAN_ID_STD, CAN_RTR_DATA, 8);
+    sim_can_node_send(node1, &frame);
+    CHECK(test_settle(1000));
+    CHECK(sim_can_node_recv(node2, &got));
+    CHECK_EQ(got.id, 0x1A5);
+
+    /* No route. */
+    frame = test_frame(0x200, CAN_ID_STD, CAN_RTR_DATA, 8);
+    sim_can_node_send(node1, &frame);
+    CHECK(test_settle(1000));
+    CHECK_EQ(sim_can_node_received(node2), 2);
+    CHECK_EQ(test_rx[0].count, 1);
+
+    /* Forwarded and kept. */
+    frame = test_frame(0x18FEF017, CAN_ID_EXT, CAN_RTR_DATA, 8);
+    sim_can_node_send(node2, &frame);
+    CHECK(test_settle(1000));
+    CHECK(sim_can_node_recv(node1, &got));
+    CHECK_EQ(got.id, 0x18FEF017);
+    CHECK_EQ(got.ide, CAN_ID_EXT);
+    CHECK_EQ(memcmp(got.data, frame.data, 8), 0);
+    CHECK_EQ(test_rx[1].count, 1);
+    CHECK_EQ(test_rx[1].frames[0].id, 0x18FEF017);
+
+    /* Back-to-back burst. */
+    for (uint32_t i = 0; i < 50; ++i) {
+        frame = test_frame(0x100 + (i & 0x0F), CAN_ID_STD, CAN_RTR_DATA, 8);
+        frame.data[0] = (uint8_t)i;
+        sim_can_node_send(node1, &frame);
+    }
+    CHECK(test_settle(20000));
+    CHECK_EQ(sim_can_node_received(node2), 52);
+    for (uint32_t i = 0; i < 50; ++i) {
+        CHECK(sim_can_node_recv(node2, &got));
+        CHECK_EQ(got.id, 0x500 + (i & 0x0F));
+        CHECK_EQ(got.data[0], i);
+    }
+
+    can_gateway_stats_t stats;
+    CHECK_EQ(can_gateway_get_stats(0, &stats), 0);
+    CHECK_EQ(stats.forwarded, 51);
+    CHECK_EQ(stats.dropped, 0);
+    CHECK_EQ(can_gateway_get_stats(1, &stats), 0);
+    CHECK_EQ(stats.forwarded, 1);
+    CHECK_EQ(can_gateway_get_stats(2, &stats), 0);
+    CHECK_EQ(stats.forwarded, 1);
+    CHECK_EQ(can_gateway_get_stats(3, &stats), 3);
+    CHECK_EQ(can_gateway_get_stats(0, NULL), 3);
+
+    /* Stopped. */
+    CHECK_EQ(can_gateway_init(routes, CAN_GATEWAY_ROUTES + 1), 3);
+    CHECK_EQ(can_gateway_init(NULL, 0), 0);
+    frame = test_frame(0x103, CAN_ID_STD, CAN_RTR_DATA, 8);
+    sim_can_node_send(node1, &frame);
+    CHECK(test_settle(1000));
+    CHECK_EQ(sim_can_node_received(node2), 52);
+    CHECK_EQ(test_rx[0].count, 2);
+#else  /* CAN_GATEWAY_ENABLE */
+    can_gateway_stats_t stats;
+    CHECK_EQ(can_gateway_init(NULL, 0), 1);
+    CHECK_EQ(can_gateway_get_stats(0, &stats), 1);
+#endif /* CAN_GATEWAY_ENABLE */
+}
+
+#if CAN_SCHED_ENABLE
+
+/* Times of `test_sched_fill()` called. */
+static uint32_t test_sched_filled;
+
+/**
+ * @brief Count the frames in payload.
+ *
+ * @param index The index of entry.
+ * @param frame The frame.
+ */
+static void test_sched_fill(uint32_t index, can_frame_t *frame) {
+    CHECK_EQ(index, 1);
+    frame->data[0] = (uint8_t)test_sched_filled++;
+    frame->dlc = 1;
+}
+
+#endif /* CAN_SCHED_ENABLE */
+
+/**
+ * @brief The cyclic messages are sent with the period rounded down to the
+ *        tick, the automatic phase keeps them out of the same tick.
+ *
+ */
+static void test_sched(void) {
+#if CAN_SCHED_ENABLE
+    static const uint8_t data[4] = {1, 2, 3, 4};
+    static const can_sched_entry_t entries[] = {
+        {.can_selected = can1_selected, .id = 0x300, .ide = CAN_ID_STD,
+         .dlc = 4, .period = 10, .offset = 0, .data = data},
+        {.can_selected = can1_selected, .id = 0x301, .ide = CAN_ID_STD,
+         .dlc = 8, .period = 15, .offset = CAN_SCHED_OFFSET_AUTO,
+         .fill = test_sched_fill},
+    };
+    /* Period in ticks. */
+    const uint32_t period[2] = {10 / CAN_SCHED_TICK, 15 / CAN_SCHED_TICK};
+
+    test_start(500, 0);
+    int node = sim_can_node_add(0);
+    test_sched_filled = 0;
+    CHECK_EQ(can_sched_init(entries, 2), 0);
+    test_run_ms(600);
+    CHECK_EQ(can_sched_init(NULL, 0), 0);
+    test_run_ms(50);
+
+    uint32_t count[2] = {0};
+    uint64_t last[2] = {0};
+    uint64_t tick_cycles = (uint64_t)SIM_HCLK_FREQ / 1000 * CAN_SCHED_TICK;
+    sim_can_frame_t frame;
+    while (sim_can_node_recv(node, &frame)) {
+        uint32_t i = frame.id - 0x300;
+        CHECK(i < 2);
+        if (i >= 2) {
+            break;
+        }
+        if (i == 0) {
+            CHECK_EQ(frame.dlc, 4);
+            CHECK_EQ(memcmp(frame.data, data, 4), 0);
+        } else {
+            CHECK_EQ(frame.dlc, 1);
+            CHECK_EQ(frame.data[0], (uint8_t)count[1]);
+        }
+        if (count[i] != 0) {
+            /* Sent in the tick of its phase, a 0x301 may wait for the
+             * 0x300 sent in the same tick. */
+            uint64_t nominal = period[i] * tick_cycles;
+            uint64_t wait = 140 * sim_can_bus_bit_cycles(0);
+            uint64_t gap = frame.time - last[i];
+            CHECK(gap + wait >= nominal);
+            CHECK(gap <= nominal + wait);
+        }
+        last[i] = frame.time;
+        ++count[i];
+    }
+    CHECK(count[0] >= 600 / (period[0] * CAN_SCHED_TICK) - 1);
+    CHECK(count[0] <= 600 / (period[0] * CAN_SCHED_TICK) + 1);
+    CHECK(count[1] >= 600 / (period[1] * CAN_SCHED_TICK) - 1);
+    CHECK(count[1] <= 600 / (period[1] * CAN_SCHED_TICK) + 1);
+    CHECK_EQ(count[1], test_sched_filled);
+
+    /* Stopped. */
+    can_sched_stats_t stats;
+    CHECK_EQ(can_sched_get_stats(0, &stats), 3);
+
+    /* The statistics against the rounded period. */
+    CHECK_EQ(can_sched_init(entries, 2), 0);
+    test_run_ms(300);
+
+    for (uint32_t i = 0; i < 2; ++i) {
+        uint32_t nominal = period[i] * CAN_SCHED_TICK * 1000;
+        CHECK_EQ(can_sched_get_stats(i, &stats), 0);
+        CHECK(stats.sent >= 300 / (period[i] * CAN_SCHED_TICK) - 1);
+        CHECK_EQ(stats.missed, 0);
+        CHECK(stats.min_period <= stats.last_period);
+        CHECK(stats.last_period <= stats.max_period);
+        CHECK(stats.min_period + 100 >= nominal);
+        CHECK(stats.max_period <= nominal + 100);
+        CHECK(stats.max_jitter < 100);
+    }
+    CHECK_EQ(can_sched_get_stats(2, &stats), 3);
+    CHECK_EQ(can_sched_get_stats(0, NULL), 3);
+
+    /* Period shorter than tick, no payload. */
+    can_sched_entry_t invalid = entries[0];
+    invalid.period = CAN_SCHED_TICK - 1;
+    CHECK_EQ(can_sched_init(&invalid, 1), 3);
+    invalid = entries[0];
+    invalid.data = NULL;
+    CHECK_EQ(can_sched_init(&invalid, 1), 3);
+    CHECK_EQ(can_sched_init(entries, CAN_SCHED_SIZE + 1), 3);
+#else  /* CAN_SCHED_ENABLE */
+    can_sched_stats_t stats;
+    CHECK_EQ(can_sched_init(NULL, 0), 1);
+    CHECK_EQ(can_sched_get_stats(0, &stats), 1);
+#endif /* CAN_SCHED_ENABLE */
+}
+
+/**
+ * @brief The frames with the same payload are dropped until the timeout,
+ *        the other IDs pass.
+ *
+ */
+static void test_change(void) {
+#if CAN_CHANGE_ENABLE
+    static const can_change_entry_t entries[] = {
+        {.id = 0x300, .ide = CAN_ID_STD, .timeout = 50},
+        {.id = 0x18FF0001, .ide = CAN_ID_EXT, .timeout = 0},
+    };
+    sim_can_frame_t std = test_frame(0x300, CAN_ID_STD, CAN_RTR_DATA, 8);
+    sim_can_frame_t ext = test_frame(0x18FF0001, CAN_ID_EXT, CAN_RTR_DATA, 8);
+    sim_can_frame_t other = test_frame(0x301, CAN_ID_STD, CAN_RTR_DATA, 8);
+
+    test_start(500, 0);
+    int node = sim_can_node_add(0);
+    CHECK_EQ(can_change_init(can1_selected, entries, 2), 0);
+
+    /* Every 10 ms for 100 ms. */
+    for (uint32_t i = 0; i < 10; ++i) {
+        std.data[0] = (i == 3) ? 0xAA : 0x00;
+        sim_can_node_send(node, &std);
+        sim_can_node_send(node, &ext);
+        sim_can_node_send(node, &other);
+        test_run_ms(10);
+    }
+
+    /* 0x300: first, changed (3), changed back (4), timeout (9). */
+    uint32_t count[3] = {0};
+    for (uint32_t i = 0; i < test_rx[0].count; ++i) {
+        const can_frame_t *frame = &test_rx[0].frames[i];
+        if (frame->id == 0x300) {
+            ++count[0];
+        } else if (frame->id == 0x18FF0001) {
+            ++count[1];
+        } else if (frame->id == 0x301) {
+            ++count[2];
+        }
+    }
+    CHECK_EQ(count[0], 4);
+    CHECK_EQ(count[1], 1);
+    CHECK_EQ(count[2], 10);
+
+    can_change_stats_t stats;
+    CHECK_EQ(can_change_get_stats(can1_selected, &stats), 0);
+    CHECK_EQ(stats.passed, 5);
+    CHECK_EQ(stats.suppressed, 15);
+
+    /* Length is a change too. */
+    ext.dlc = 7;
+    sim_can_node_send(node, &ext);
+    test_run_ms(2);
+    CHECK_EQ(test_rx[0].frames[test_rx[0].count - 1].id, 0x18FF0001);
+    CHECK_EQ(test_rx[0].frames[test_rx[0].count - 1].dlc, 7);
+
+    /* Repeated ID. */
+    static const can_change_entry_t repeated[] = {
+        {.id = 0x300, .ide = CAN_ID_STD, .timeout = 50},
+        {.id = 0x300, .ide = CAN_ID_STD, .timeout = 0},
+    };
+    CHECK_EQ(can_change_init(can1_selected, repeated, 2), 3);
+    CHECK_EQ(can_change_get_stats(can1_selected, NULL), 3);
+
+    /* Stopped. */
+    CHECK_EQ(can_change_init(can1_selected, NULL, 0), 0);
+    uint32_t before = test_rx[0].count;
+    sim_can_node_send(node, &ext);
+    test_run_ms(2);
+    CHECK_EQ(test_rx[0].count, before + 1);
+#else  /* CAN_CHANGE_ENABLE */
+    can_change_stats_t stats;
+    CHECK_EQ(can_change_init(can1_selected, NULL, 0), 1);
+    CHECK_EQ(can_change_get_stats(can1_selected, &stats), 1);
+#endif /* CAN_CHANGE_ENABLE */
+}
+
+/**
+ * @brief The remote frames of listed IDs are answered with the current
+ *        payload, the others go to receive ring.
+ *
+ */
+static void test_respond(void) {
+#if CAN_RESPOND_ENABLE
+    static uint8_t data[4] = {0x11, 0x22, 0x33, 0x44};
+    static const can_respond_entry_t entries[] = {
+        {.id = 0x321, .ide = CAN_ID_STD, .dlc = 4, .data = data},
+        {.id = 0x18DA00F1, .ide = CAN_ID_EXT, .dlc = 0, .data = NULL},
+    };
+    sim_can_frame_t frame, got;
+
+    test_start(500, 0);
+    int node = sim_can_node_add(0);
+    CHECK_EQ(can_respond_init(can1_selected, entries, 2), 0);
+
+    frame = test_frame(0x321, CAN_ID_STD, CAN_RTR_REMOTE, 4);
+    sim_can_node_send(node, &frame);
+    CHECK(test_settle(1000));
+    CHECK(sim_can_node_recv(node, &got));
+    CHECK_EQ(got.id, 0x321);
+    CHECK_EQ(got.rtr, CAN_RTR_DATA);
+    CHECK_EQ(got.dlc, 4);
+    CHECK_EQ(memcmp(got.data, data, 4), 0);
+
+    /* The payload is read when the remote frame arrives. */
+    data[0] = 0x55;
+    sim_can_node_send(node, &frame);
+    CHECK(test_settle(1000));
+    CHECK(sim_can_node_recv(node, &got));
+    CHECK_EQ(got.data[0], 0x55);
+
+    frame = test_frame(0x18DA00F1, CAN_ID_EXT, CAN_RTR_REMOTE, 0);
+    sim_can_node_send(node, &frame);
+    CHECK(test_settle(1000));
+    CHECK(sim_can_node_recv(node, &got));
+    CHECK_EQ(got.id, 0x18DA00F1);
+    CHECK_EQ(got.ide, CAN_ID_EXT);
+    CHECK_EQ(got.rtr, CAN_RTR_DATA);
+    CHECK_EQ(got.dlc, 0);
+    CHECK_EQ(test_rx[0].count, 0);
+
+    /* Not listed, or a data frame of listed ID. */
+    frame = test_frame(0x322, CAN_ID_STD, CAN_RTR_REMOTE, 4);
+    sim_can_node_send(node, &frame);
+    frame = test_frame(0x321, CAN_ID_STD, CAN_RTR_DATA, 4);
+    sim_can_node_send(node, &frame);
+    /* Standard and extended ID are different. */
+    frame = test_frame(0x321, CAN_ID_EXT, CAN_RTR_REMOTE, 4);
+    sim_can_node_send(node, &frame);
+    CHECK(test_settle(2000));
+    CHECK_EQ(sim_can_node_received(node), 3);
+    CHECK_EQ(test_rx[0].count, 3);
+    CHECK_EQ(test_rx[0].frames[0].id, 0x322);
+    CHECK_EQ(test_rx[0].frames[0].rtr, CAN_RTR_REMOTE);
+
+    can_respond_stats_t stats;
+    CHECK_EQ(can_respond_get_stats(can1_selected, &stats), 0);
+    CHECK_EQ(stats.answered, 3);
+    CHECK_EQ(stats.dropped, 0);
+    CHECK_EQ(can_respond_get_stats(can1_selected, NULL), 3);
+
+    static const can_respond_entry_t invalid[] = {
+        {.id = 0x321, .ide = CAN_ID_STD, .dlc = 4, .data = NULL},
+    };
+    CHECK_EQ(can_respond_init(can1_selected, invalid, 1), 3);
+#else  /* CAN_RESPOND_ENABLE */
+    can_respond_stats_t stats;
+    CHECK_EQ(can_respond_init(can1_selected, NULL, 0), 1);
+    CHECK_EQ(can_respond_get_stats(can1_selected, &stats), 1);
+#endif /* CAN_RESPOND_ENABLE */
+}
+
+/**
+ * @}
+ */
+
+/*****************************************************************************
+ * @defgroup J1939, the node can not be stopped, keep it the last.
+ * @{
+ */
+
+#if CAN_J1939_ENABLE
+
+/* NAME of node under test, arbitrary address capable. */
+#define TEST_J1939_NAME (0x8000000000001234ULL)
+/* Address of node under test and the virtual peer. */
+#define TEST_J1939_SELF 0x80
+#define TEST_J1939_PEER 0x90
+
+/**
+ * @brief Messages passed to the handlers of J1939 node.
+ */
+static struct {
+    uint32_t pgn;
+    uint8_t handler;
+    uint8_t sa;
+    uint8_t da;
+    uint8_t data[32];
+    uint32_t len;
+    uint32_t calls;
+} test_j1939_rx;
+
+/**
+ * @brief Results passed to the transmit handler.
+ */
+static struct {
+    uint32_t pgn;
+    uint8_t result;
+    uint32_t calls;
+} test_j1939_tx;
+
+/**
+ * @brief Data packets the virtual peer received by RTS/CTS.
+ */
+static struct {
+    uint8_t data[64];
+    uint32_t packets;
+    uint32_t windows;
+} test_j1939_peer;
+
+static void test_j1939_log(uint8_t handler, uint32_t pgn, uint8_t sa,
+                           uint8_t da, const uint8_t *data, uint32_t len) {
+    test_j1939_rx.handler = handler;
+    test_j1939_rx.pgn = pgn;
+    test_j1939_rx.sa = sa;
+    test_j1939_rx.da = da;
+    test_j1939_rx.len = len;
+    memcpy(test_j1939_rx.data, data,
+           (len > sizeof(test_j1939_rx.data)) ? sizeof(test_j1939_rx.data)
+                                              : len);
+    ++test_j1939_rx.calls;
+}
+
+static void test_j1939_on_a(uint32_t pgn, uint8_t sa, uint8_t da,
+                            const uint8_t *data, uint32_t len) {
+    test_j1939_log(1, pgn, sa, da, data, len);
+}
+
+static void test_j1939_on_b(uint32_t pgn, uint8_t sa, uint8_t da,
+                            const uint8_t *data, uint32_t len) {
+    test_j1939_log(2, pgn, sa, da, data, len);
+}
+
+static void test_j1939_on_default(uint32_t pgn, uint8_t sa, uint8_t da,
+                                  const uint8_t *data, uint32_t len) {
+    test_j1939_log(3, pgn, sa, da, data, len);
+}
+
+static void test_j1939_on_tx(uint32_t pgn, uint8_t result) {
+    test_j1939_tx.pgn = pgn;
+    test_j1939_tx.result = result;
+    ++test_j1939_tx.calls;
+}
+
+/**
+ * @brief Make a J1939 frame of virtual node.
+ *
+ * @param priority Priority.
+ * @param pf PDU format.
+ * @param ps PDU specific, destination address for PDU1.
+ * @param sa Source address.
+ * @param data The data, 8 bytes.
+ * @return The frame.
+ */
+static sim_can_frame_t test_j1939_frame(uint8_t priority, uint8_t pf,
+                                        uint8_t ps, uint8_t sa,
+                                        const uint8_t *data) {
+    sim_can_frame_t frame = {.id = ((uint32_t)priority << 26) |
+                                   ((uint32_t)pf << 16) |
+                                   ((uint32_t)ps << 8) | sa,
+                             .ide = CAN_ID_EXT,
+                             .rtr = CAN_RTR_DATA,
+                             .dlc = 8};
+    memcpy(frame.data, data, 8);
+    return frame;
+}
+
+/**
+ * @brief The virtual peer of RTS/CTS, send CTS of 2 packets for each window
+ *        and EOMA at the end.
+ *
+ * @param node The virtual node.
+ * @param frame The frame received by the node.
+ */
+static void test_j1939_peer_hook(int node, const sim_can_frame_t *frame) {
+    uint8_t pf = (frame->id >> 16) & 0xFF;
+    uint8_t ps = (frame->id >> 8) & 0xFF;
+    uint8_t sa = frame->id & 0xFF;
+
+    if ((ps != TEST_J1939_PEER) || (sa != TEST_J1939_SELF)) {
+        return;
+    }
+
+    static uint8_t packets;
+    static uint8_t len;
+    static uint8_t pgn[3];
+    uint8_t cts[8] = {17, 2, 1, 0xFF, 0xFF};
+
+    if ((pf == 0xEC) && (frame->data[0] == 16)) {
+        /* RTS. */
+        len = frame->data[1];
+        packets = frame->data[3];
+        memcpy(pgn, &frame->data[5], 3);
+    } else if ((pf == 0xEB) && (frame->data[0] <= packets)) {
+        uint8_t seq = frame->data[0];
+        memcpy(&test_j1939_peer.data[(seq - 1) * 7], &frame->data[1], 7);
+        ++test_j1939_peer.packets;
+
+        if (seq == packets) {
+            uint8_t eoma[8] = {19, len, 0, packets, 0xFF};
+            memcpy(&eoma[5], pgn, 3);
+            sim_can_frame_t out = test_j1939_frame(7, 0xEC, TEST_J1939_SELF,
+                                                   TEST_J1939_PEER, eoma);
+            sim_can_node_send(node, &out);
+            return;
+        }
+        if ((seq & 1) != 0) {
+            return;
+        }
+        cts[2] = seq + 1;
+    } else {
+        return;
+    }
+
+    memcpy(&cts[5], pgn, 3);
+    sim_can_frame_t out =
+        test_j1939_frame(7, 0xEC, TEST_J1939_SELF, TEST_J1939_PEER, cts);
+    sim_can_node_send(node, &out);
+    ++test_j1939_peer.windows;
+}
+
+/**
+ * @brief Drop the frames logged by virtual node.
+ *
+ * @param node The virtual node.
+ */
+static void test_j1939_flush(int node) {
+    sim_can_frame_t frame;
+    while (sim_can_node_recv(node, &frame)) {
+    }
+}
+
+#endif /* CAN_J1939_ENABLE */
+
+/**
+ * @brief Address claim, single frame and transport messages in both
+ *        directions, and the address contention.
+ *
+ */
+static void test_j1939(void) {
+#if CAN_J1939_ENABLE
+    static const can_j1939_pgn_t pgns[] = {
+        {.pgn = 0xFECA, .handler = test_j1939_on_b},
+        {.pgn = 0xFEF1, .handler = test_j1939_on_a},
+    };
+    can_j1939_config_t config = {
+        .can_selected = can1_selected,
+        .name = TEST_J1939_NAME,
+        .address = TEST_J1939_SELF,
+        .pgns = pgns,
+        .pgn_count = 2,
+        .default_handler = test_j1939_on_default,
+        .tx_handler = test_j1939_on_tx,
+    };
+    static uint8_t message[30];
+    uint8_t data[8] = {0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88};
+    sim_can_frame_t frame, got;
+
+    for (uint32_t i = 0; i < sizeof(message); ++i) {
+        message[i] = (uint8_t)(0xA0 + i);
+    }
+    memset(&test_j1939_rx, 0, sizeof(test_j1939_rx));
+    memset(&test_j1939_tx, 0, sizeof(test_j1939_tx));
+    memset(&test_j1939_peer, 0, sizeof(test_j1939_peer));
+
+    test_start(250, 0);
+    int node = sim_can_node_add(0);
+
+    /* Address claim. */
+    CHECK_EQ(can_j1939_send(0xFEF1, 6, CAN_J1939_GLOBAL, data, 8), 4);
+    CHECK_EQ(can_j1939_init(&config), 0);
+    test_run_ms(2);
+    CHECK(sim_can_node_recv(node, &got));
+    CHECK_EQ(got.id, 0x18EEFF80);
+    for (uint32_t i = 0; i < 8; ++i) {
+        CHECK_EQ(got.data[i], (uint8_t)(TEST_J1939_NAME >> (8 * i)));
+    }
+    CHECK_EQ(can_j1939_get_address(), CAN_J1939_NULL_ADDR);
+    CHECK_EQ(can_j1939_send(0xFEF1, 6, CAN_J1939_GLOBAL, data, 8), 2);
+    test_run_ms(250);
+    CHECK_EQ(can_j1939_get_address(), TEST_J1939_SELF);
+
+    /* Single frame by PGN handler, PDU1 to this node by default handler. */
+    frame = test_j1939_frame(6, 0xFE, 0xF1, TEST_J1939_PEER, data);
+    sim_can_node_send(node, &frame);
+    test_run_ms(2);
+    CHECK_EQ(test_j1939_rx.calls, 1);
+    CHECK_EQ(test_j1939_rx.handler, 1);
+    CHECK_EQ(test_j1939_rx.pgn, 0xFEF1);
+    CHECK_EQ(test_j1939_rx.sa, TEST_J1939_PEER);
+    CHECK_EQ(test_j1939_rx.da, CAN_J1939_GLOBAL);
+    CHECK_EQ(test_j1939_rx.len, 8);
+    CHECK_EQ(memcmp(test_j1939_rx.data, data, 8), 0);
+
+    frame = test_j1939_frame(6, 0xEF, TEST_J1939_SELF, TEST_J1939_PEER, data);
+    sim_can_node_send(node, &frame);
+    test_run_ms(2);
+    CHECK_EQ(test_j1939_rx.calls, 2);
+    CHECK_EQ(test_j1939_rx.handler, 3);
+    CHECK_EQ(test_j1939_rx.pgn, 0xEF00);
+    CHECK_EQ(test_j1939_rx.da, TEST_J1939_SELF);
+
+    /* PDU1 to another node, not handled. */
+    frame = test_j1939_frame(6, 0xEF, 0x81, TEST_J1939_PEER, data);
+    sim_can_node_send(node, &frame);
+    test_run_ms(2);
+    CHECK_EQ(test_j1939_rx.calls, 2);
+    CHECK_EQ(test_rx[0].count, 1);
+    CHECK_EQ(test_rx[0].frames[0].id, frame.id);
+
+    /* Request for address claimed. */
+    uint8_t request[8] = {0x00, 0xEE, 0x00};
+    frame = test_j1939_frame(6, 0xEA, TEST_J1939_SELF, TEST_J1939_PEER,
+                             request);
+    frame.dlc = 3;
+    sim_can_node_send(node, &frame);
+    test_run_ms(2);
+    CHECK(sim_can_node_recv(node, &got));
+    CHECK_EQ(got.id, 0x18EEFF80);
+
+    /* BAM receive, 20 bytes in 3 packets. */
+    uint8_t bam[8] = {32, 20, 0, 3, 0xFF, 0xCA, 0xFE, 0x00};
+    frame = test_j1939_frame(7, 0xEC, CAN_J1939_GLOBAL, TEST_J1939_PEER, bam);
+    sim_can_node_send(node, &frame);
+    for (uint8_t seq = 1; seq <= 3; ++seq) {
+        uint8_t dt[8] = {seq};
+        memcpy(&dt[1], &message[(seq - 1) * 7], 7);
+        frame =
+            test_j1939_frame(7, 0xEB, CAN_J1939_GLOBAL, TEST_J1939_PEER, dt);
+        sim_can_node_send(node, &frame);
+        test_run_ms(50);
+    }
+    CHECK_EQ(test_j1939_rx.calls, 3);
+    CHECK_EQ(test_j1939_rx.handler, 2);
+    CHECK_EQ(test_j1939_rx.pgn, 0xFECA);
+    CHECK_EQ(test_j1939_rx.len, 20);
+    CHECK_EQ(memcmp(test_j1939_rx.data, message, 20), 0);
+    /* Transport frames are not passed to the receive ring. */
+    CHECK_EQ(test_rx[0].count, 1);
+
+    /* RTS/CTS send, 30 bytes in 5 packets, windows of 2 packets. */
+    test_j1939_flush(node);
+    sim_can_node_set_hook(node, test_j1939_peer_hook);
+    CHECK_EQ(can_j1939_send(0xEF00, 6, TEST_J1939_PEER, message,
+                            sizeof(message)),
+             0);
+    CHECK_EQ(can_j1939_send(0xEF00, 6, TEST_J1939_PEER, message,
+                            sizeof(message)),
+             2);
+    test_run_ms(20);
+    sim_can_node_set_hook(node, NULL);
+    CHECK_EQ(test_j1939_tx.calls, 1);
+    CHECK_EQ(test_j1939_tx.result, CAN_J1939_OK);
+    CHECK_EQ(test_j1939_tx.pgn, 0xEF00);
+    CHECK_EQ(test_j1939_peer.packets, 5);
+    CHECK_EQ(test_j1939_peer.windows, 3);
+    CHECK_EQ(memcmp(test_j1939_peer.data, message, sizeof(message)), 0);
+    /* The padding of last packet. */
+    CHECK_EQ(test_j1939_peer.data[34], 0xFF);
+
+    /* BAM send, the data packets are spaced by 50 ms. */
+    test_j1939_flush(node);
+    CHECK_EQ(can_j1939_send(0xFEF2, 7, CAN_J1939_GLOBAL, message, 20), 0);
+    test_run_ms(200);
+    CHECK_EQ(test_j1939_tx.calls, 2);
+    CHECK_EQ(test_j1939_tx.result, CAN_J1939_OK);
+    CHECK_EQ(test_j1939_tx.pgn, 0xFEF2);
+    CHECK(sim_can_node_recv(node, &got));
+    CHECK_EQ(got.id, 0x1CECFF80);
+    CHECK_EQ(got.data[0], 32);
+    CHECK_EQ(got.data[1], 20);
+    CHECK_EQ(got.data[3], 3);
+    CHECK_EQ(got.data[5], 0xF2);
+    uint64_t last = got.time;
+    for (uint8_t seq = 1; seq <= 3; ++seq) {
+        CHECK(sim_can_node_recv(node, &got));
+        CHECK_EQ(got.id, 0x1CEBFF80);
+        CHECK_EQ(got.data[0], seq);
+        CHECK_EQ(got.data[1], message[(seq - 1) * 7]);
+        CHECK(got.time - last >= (uint64_t)SIM_HCLK_FREQ / 1000 * 49);
+        last = got.time;
+    }
+
+    /* No CTS, aborted after T3 (1250 ms). */
+    test_j1939_flush(node);
+    CHECK_EQ(can_j1939_send(0xEF00, 6, TEST_J1939_PEER, message,
+                            sizeof(message)),
+             0);
+    test_run_ms(1250);
+    CHECK_EQ(test_j1939_tx.calls, 2);
+    test_run_ms(2);
+    CHECK_EQ(test_j1939_tx.calls, 3);
+    CHECK_EQ(test_j1939_tx.result, CAN_J1939_TIMEOUT_ERR);
+    CHECK(sim_can_node_recv(node, &got));
+    CHECK_EQ(got.data[0], 16);
+    CHECK(sim_can_node_recv(node, &got));
+    CHECK_EQ(got.id, 0x1CEC9080);
+    CHECK_EQ(got.data[0], 255);
+
+    /* Contention with a higher NAME, the address is kept. */
+    test_j1939_flush(node);
+    uint8_t name[8] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+    frame = test_j1939_frame(6, 0xEE, CAN_J1939_GLOBAL, TEST_J1939_SELF, name);
+    sim_can_node_send(node, &frame);
+    test_run_ms(2);
+    CHECK(sim_can_node_recv(node, &got));
+    CHECK_EQ(got.id, 0x18EEFF80);
+    CHECK_EQ(can_j1939_get_address(), TEST_J1939_SELF);
+
+    /* Contention with a lower NAME, move to the next free address. */
+    memset(name, 0, sizeof(name));
+    name[0] = 0x01;
+    frame = test_j1939_frame(6, 0xEE, CAN_J1939_GLOBAL, TEST_J1939_SELF, name);
+    sim_can_node_send(node, &frame);
+    test_run_ms(2);
+    CHECK(sim_can_node_recv(node, &got));
+    CHECK_EQ(got.id, 0x18EEFF81);
+    CHECK_EQ(can_j1939_get_address(), CAN_J1939_NULL_ADDR);
+    test_run_ms(250);
+    CHECK_EQ(can_j1939_get_address(), 0x81);
+
+    /* Not arbitrary address capable, the address is lost. */
+    config.name = 0x1234;
+    CHECK_EQ(can_j1939_init(&config), 0);
+    test_run_ms(2);
+    name[0] = 0x00;
+    frame = test_j1939_frame(6, 0xEE, CAN_J1939_GLOBAL, TEST_J1939_SELF, name);
+    sim_can_node_send(node, &frame);
+    test_run_ms(252);
+    CHECK_EQ(can_j1939_get_address(), CAN_J1939_NULL_ADDR);
+    CHECK_EQ(can_j1939_send(0xFEF1, 6, CAN_J1939_GLOBAL, data, 8), 1);
+    test_j1939_flush(node);
+
+    /* Repeated PGN. */
+    static const can_j1939_pgn_t repeated[] = {
+        {.pgn = 0xFECA, .handler = test_j1939_on_b},
+        {.pgn = 0xFECA, .handler = test_j1939_on_a},
+    };
+    config.pgns = repeated;
+    CHECK_EQ(can_j1939_init(&config), 3);
+    CHECK_EQ(can_j1939_init(NULL), 3);
+#else  /* CAN_J1939_ENABLE */
+    uint8_t data[8] = {0};
+    CHECK_EQ(can_j1939_init(NULL), 1);
+    CHECK_EQ(can_j1939_send(0xFEF1, 6, CAN_J1939_GLOBAL, data, 8), 1);
+    CHECK_EQ(can_j1939_get_address(), CAN_J1939_NULL_ADDR);
+#endif /* CAN_J1939_ENABLE */
+}
+
+/**
+ * @}
+ */
+
+int main(void) {
+    static const test_case_t cases[] = {
+        TEST_CASE(test_rate_table),     TEST_CASE(test_rate_search),
+        TEST_CASE(test_rate_invalid),   TEST_CASE(test_rate_on_bus),
+        TEST_CASE(test_rate_mismatch),  TEST_CASE(test_filter_default),
+        TEST_CASE(test_filter_sweep),   TEST_CASE(test_filter_runtime),
+        TEST_CASE(test_filter_limits),  TEST_CASE(test_tx_content),
+        TEST_CASE(test_tx_arbitration), TEST_CASE(test_tx_batch),
+        TEST_CASE(test_tx_queue_order), TEST_CASE(test_tx_queue_flood),
+        TEST_CASE(test_tx_invalid),     TEST_CASE(test_tx_no_ack),
+        TEST_CASE(test_tx_retry),       TEST_CASE(test_recovery_off),
+        TEST_CASE(test_recovery_hardware),
+        TEST_CASE(test_recovery_software),
+        TEST_CASE(test_rx_ring),
+        TEST_CASE(test_stats_rates),
+        TEST_CASE(test_dispatch),
+        TEST_CASE(test_time_stamp),
+        TEST_CASE(test_latency),
+        TEST_CASE(test_isotp_transfer),
+        TEST_CASE(test_isotp_flow),
+        TEST_CASE(test_gateway),
+        TEST_CASE(test_sched),
+        TEST_CASE(test_change),
+        TEST_CASE(test_respond),
+        TEST_CASE(test_j1939),
+    };
+
+    return test_run("can", cases, sizeof(cases) / sizeof(cases[0]));
+}
@@ -0,0 +1,604 @@
+/**
+ * @file    test_signal.c
+ * @author  Deadline039
+ * @brief   Tests of the signal pack and unpack of CAN_STM32F1xx.c and of the
+ *          accessors generated by dbc2c.sh from test_signal.dbc.
+ * @version 3.3.3
+ * @date    2024-10-22
+ * @note    The reference is a bit walker that follows the DBC definition bit
+ *          by bit, the driver works on the 64-bit payload word.
+ */
+
+#include <CSP_Config.h>
+
+#include "sim.h"
+#include "test.h"
+#include "test_signal.h"
+
+#include <string.h>
+
+unsigned int test_failures;
+
+/*****************************************************************************
+ * @defgroup Helpers.
+ * @{
+ */
+
+/* Random signals of each length and byte order. */
+#define TEST_SIGNAL_RUNS  64
+/* Random frames of each message. */
+#define TEST_FRAME_RUNS   1000
+
+/* State of `test_random()`. */
+static uint32_t test_seed = 0x2545F491U;
+
+/**
+ * @brief Get a pseudo random number.
+ *
+ * @return The number.
+ */
+static uint32_t test_random(void) {
+    test_seed ^= test_seed << 13;
+    test_seed ^= test_seed >> 17;
+    test_seed ^= test_seed << 5;
+    return test_seed;
+}
+
+/**
+ * @brief Get a 64-bit pseudo random number.
+ *
+ * @return The number.
+ */
+static uint64_t test_random64(void) {
+    uint64_t high = test_random();
+    return (high << 32) | test_random();
+}
+
+/**
+ * @brief Fill the frame with random payload.
+ *
+ * @param[out] frame The frame.
+ */
+static void test_random_frame(can_frame_t *frame) {
+    memset(frame, 0, sizeof(can_frame_t));
+    frame->dlc = 8;
+    for (uint32_t i = 0; i < 8; ++i) {
+        frame->data[i] = (uint8_t)test_random();
+    }
+}
+
+/**
+ * @brief Next bit of signal in the DBC numbering, `byte * 8 + bit`.
+ *
+ * @param pos The bit now.
+ * @param motorola Byte order: 0: Intel, LSB first, upwards. 1: Motorola, MSB
+ *                 first, downwards in the byte, then the bit 7 of next byte.
+ * @return The next bit.
+ */
+static uint32_t test_ref_next(uint32_t pos, uint8_t motorola) {
+    if (!motorola) {
+        return pos + 1;
+    }
+
+    return ((pos % 8) == 0) ? pos + 15 : pos - 1;
+}
+
+/**
+ * @brief Check the signal is in the payload of 8 bytes, bit by bit.
+ *
+ * @param start Start bit in DBC.
+ * @param length Length of signal.
+ * @param motorola Byte order.
+ * @return 1: In payload, 0: Out of payload.
+ */
+static uint8_t test_ref_valid(uint32_t start, uint32_t length,
+                              uint8_t motorola) {
+    uint32_t pos = start;
+
+    for (uint32_t i = 0; i < length; ++i) {
+        if (pos > 63) {
+            return 0;
+        }
+        pos = test_ref_next(pos, motorola);
+    }
+
+    return (length != 0);
+}
+
+/**
+ * @brief Get the raw value of signal bit by bit.
+ *
+ * @param data The payload.
+ * @param start Start bit in DBC, the LSB for Intel, the MSB for Motorola.
+ * @param length Length of signal.
+ * @param motorola Byte order.
+ * @return The raw value, not extended.
+ */
+static uint64_t test_ref_get(const uint8_t *data, uint32_t start,
+                             uint32_t length, uint8_t motorola) {
+    uint64_t raw = 0;
+    uint32_t pos = start;
+
+    for (uint32_t i = 0; i < length; ++i) {
+        uint64_t bit = (data[pos / 8] >> (pos % 8)) & 1U;
+        if (motorola) {
+            raw = (raw << 1) | bit;
+        } else {
+            raw |= bit << i;
+        }
+        pos = test_ref_next(pos, motorola);
+    }
+
+    return raw;
+}
+
+/**
+ * @brief Set the raw value of signal bit by bit.
+ *
+ * @param data The payload.
+ * @param start Start bit in DBC.
+ * @param length Length of signal.
+ * @param motorola Byte order.
+ * @param raw The raw value, the bits above `length` are ignored.
+ */
+static void test_ref_set(uint8_t *data, uint32_t start, uint32_t length,
+                         uint8_t motorola, uint64_t raw) {
+    uint32_t pos = start;
+
+    for (uint32_t i = 0; i < length; ++i) {
+        uint32_t n = motorola ? length - 1 - i : i;
+        uint8_t bit = (uint8_t)(1U << (pos % 8));
+
+        if ((raw >> n) & 1U) {
+            data[pos / 8] |= bit;
+        } else {
+            data[pos / 8] &= (uint8_t)~bit;
+        }
+        pos = test_ref_next(pos, motorola);
+    }
+}
+
+/**
+ * @brief Sign extend the raw value.
+ *
+ * @param raw The raw value.
+ * @param length Length of signal.
+ * @return The signed value.
+ */
+static int64_t test_ref_signed(uint64_t raw, uint32_t length) {
+    if ((length < 64) && ((raw >> (length - 1)) & 1U)) {
+        raw |= ~CAN_SIGNAL_MASK(length);
+    }
+
+    return (int64_t)raw;
+}
+
+/**
+ * @brief Pack the physical values with the generic path and with the
+ *        generated path, check both frames are the same and unpack both.
+ *
+ * @param signals The signals of message.
+ * @param count Number of signals.
+ * @param pack The generated pack.
+ * @param unpack The generated unpack.
+ * @param values The physical values.
+ * @param frame The frame, the payload before pack.
+ * @return 1: The frames and values are the same, 0: Not.
+ */
+static uint8_t test_pack_both(const can_signal_t *signals, uint32_t count,
+                              void (*pack)(const float *, can_frame_t *),
+                              void (*unpack)(const can_frame_t *, float *),
+                              const float *values, const can_frame_t *frame) {
+    can_frame_t generic = *frame;
+    can_frame_t generated = *frame;
+    float generic_values[8];
+    float generated_values[8];
+    uint8_t same = 1;
+
+    CHECK_EQ(can_signal_pack(signals, count, values, &generic), 0);
+    pack(values, &generated);
+    if (memcmp(generic.data, generated.data, sizeof(generic.data)) != 0) {
+        same = 0;
+    }
+
+    CHECK_EQ(can_signal_unpack(signals, count, &generic, generic_values), 0);
+    unpack(&generated, generated_values);
+    if (memcmp(generic_values, generated_values, count * sizeof(float)) !=
+        0) {
+        same = 0;
+    }
+
+    return same;
+}
+
+/**
+ * @}
+ */
+
+/*****************************************************************************
+ * @defgroup Payload word and raw access.
+ * @{
+ */
+
+/**
+ * @brief `can_payload_get()` and `can_payload_set()` of both byte orders.
+ */
+static void test_payload_order(void) {
+    can_frame_t frame;
+
+    for (uint32_t run = 0; run < TEST_FRAME_RUNS; ++run) {
+        uint64_t intel = 0;
+        uint64_t motorola = 0;
+
+        test_random_frame(&frame);
+        for (uint32_t i = 0; i < 8; ++i) {
+            intel |= (uint64_t)frame.data[i] << (8 * i);
+            motorola |= (uint64_t)frame.data[i] << (8 * (7 - i));
+        }
+        CHECK_EQ(can_payload_get(&frame, CAN_SIGNAL_INTEL), intel);
+        CHECK_EQ(can_payload_get(&frame, CAN_SIGNAL_MOTOROLA), motorola);
+
+        can_frame_t copy = frame;
+        memset(copy.data, 0, sizeof(copy.data));
+        can_payload_set(&copy, CAN_SIGNAL_MOTOROLA, motorola);
+        CHECK(memcmp(copy.data, frame.data, sizeof(frame.data)) == 0);
+        memset(copy.data, 0, sizeof(copy.data));
+        can_payload_set(&copy, CAN_SIGNAL_INTEL, intel);
+        CHECK(memcmp(copy.data, frame.data, sizeof(frame.data)) == 0);
+    }
+}
+
+/**
+ * @brief The LSB and access macros against the bit walker, every length and
+ *        start bit of both byte orders.
+ */
+static void test_signal_raw(void) {
+    can_frame_t frame;
+
+    for (uint8_t motorola = 0; motorola < 2; ++motorola) {
+        uint8_t order = motorola ? CAN_SIGNAL_MOTOROLA : CAN_SIGNAL_INTEL;
+
+        for (uint32_t length = 1; length <= 64; ++length) {
+            for (uint32_t start = 0; start < 64; ++start) {
+                int32_t lsb = motorola
+                                  ? CAN_SIGNAL_MOTOROLA_LSB(start, length)
+                                  : CAN_SIGNAL_INTEL_LSB(start, length);
+                uint8_t valid = (lsb >= 0) && (lsb + (int32_t)length <= 64);
+
+                CHECK_EQ(valid, test_ref_valid(start, length, motorola));
+                if (!valid) {
+                    continue;
+                }
+
+                test_random_frame(&frame);
+                uint64_t word = can_payload_get(&frame, order);
+                uint64_t raw = test_ref_get(frame.data, start, length,
+                                            motorola);
+                CHECK_EQ(CAN_SIGNAL_GET(word, lsb, length), raw);
+                CHECK_EQ(CAN_SIGNAL_GET_SIGNED(word, lsb, length),
+                         test_ref_signed(raw, length));
+
+                raw = test_random64();
+                CAN_SIGNAL_SET(word, lsb, length, raw);
+                can_payload_set(&frame, order, word);
+                uint8_t expected[8];
+                memcpy(expected, frame.data, sizeof(expected));
+                test_ref_set(expected, start, length, motorola, raw);
+                CHECK(memcmp(frame.data, expected, sizeof(expected)) == 0);
+            }
+        }
+    }
+}
+
+/**
+ * @brief `can_signal_unpack()` and `can_signal_pack()` at raw level: random
+ *        signals of each length and byte order, integer scale so the values
+ *        up to 24 bits are exact in float.
+ */
+static void test_signal_generic(void) {
+    can_frame_t frame;
+    uint8_t expected[8];
+
+    for (uint8_t motorola = 0; motorola < 2; ++motorola) {
+        for (uint32_t length = 1; length <= 24; ++length) {
+            for (uint32_t run = 0; run < TEST_SIGNAL_RUNS; ++run) {
+                can_signal_t signal = {
+                    (uint8_t)(test_random() % 64), (uint8_t)length,
+                    motorola ? CAN_SIGNAL_MOTOROLA : CAN_SIGNAL_INTEL,
+                    (uint8_t)(test_random() % 2), 1.0f, 0.0f};
+                float value;
+
+                test_random_frame(&frame);
+                if (!test_ref_valid(signal.start, length, motorola)) {
+                    CHECK_EQ(can_signal_unpack(&signal, 1, &frame, &value),
+                             3);
+                    continue;
+                }
+
+                uint64_t raw = test_ref_get(frame.data, signal.start, length,
+                                            motorola);
+                CHECK_EQ(can_signal_unpack(&signal, 1, &frame, &value), 0);
+                if (signal.is_signed) {
+                    CHECK_EQ(value, test_ref_signed(raw, length));
+                } else {
+                    CHECK_EQ(value, raw);
+                }
+
+                /* Pack a new value, the other bits are kept. */
+                raw = test_random64() & CAN_SIGNAL_MASK(length);
+                value = signal.is_signed
+                            ? (float)test_ref_signed(raw, length)
+                            : (float)raw;
+                memcpy(expected, frame.data, sizeof(expected));
+                test_ref_set(expected, signal.start, length, motorola, raw);
+                CHECK_EQ(can_signal_pack(&signal, 1, &value, &frame), 0);
+                CHECK(memcmp(frame.data, expected, sizeof(expected)) == 0);
+            }
+        }
+    }
+}
+
+/**
+ * @}
+ */
+
+/*****************************************************************************
+ * @defgroup Generated accessors.
+ * @{
+ */
+
+/**
+ * @brief The generated accessors of ENGINE and MIXED against the generic
+ *        path and the bit walker, random raw values of each signal.
+ */
+static void test_dbc_round_trip(void) {
+    static const struct {
+        const can_signal_t *signals;
+        uint32_t count;
+        void (*pack)(const float *, can_frame_t *);
+        void (*unpack)(const can_frame_t *, float *);
+    } messages[] = {
+        {dbc_engine_signals, DBC_ENGINE_SIGNALS, dbc_engine_pack,
+         dbc_engine_unpack},
+        {dbc_mixed_signals, DBC_MIXED_SIGNALS, dbc_mixed_pack,
+         dbc_mixed_unpack},
+    };
+    can_frame_t frame;
+    uint8_t expected[8];
+    float values[8];
+    float unpacked[8];
+
+    for (uint32_t m = 0; m < sizeof(messages) / sizeof(messages[0]); ++m) {
+        const can_signal_t *signals = messages[m].signals;
+        uint32_t count = messages[m].count;
+
+        for (uint32_t run = 0; run < TEST_FRAME_RUNS; ++run) {
+            test_random_frame(&frame);
+            memcpy(expected, frame.data, sizeof(expected));
+
+            for (uint32_t i = 0; i < count; ++i) {
+                const can_signal_t *signal = &signals[i];
+                uint64_t raw = test_random64() &
+                               CAN_SIGNAL_MASK(signal->length);
+                float r = signal->is_signed
+                              ? (float)test_ref_signed(raw, signal->length)
+                              : (float)raw;
+
+                values[i] = r * signal->scale + signal->offset;
+                test_ref_set(expected, signal->start, signal->length,
+                             signal->order == CAN_SIGNAL_MOTOROLA, raw);
+            }
+
+            CHECK(test_pack_both(signals, count, messages[m].pack,
+                                 messages[m].unpack, values, &frame));
+
+            messages[m].pack(values, &frame);
+            CHECK(memcmp(frame.data, expected, sizeof(expected)) == 0);
+            messages[m].unpack(&frame, unpacked);
+            for (uint32_t i = 0; i < count; ++i) {
+                CHECK(unpacked[i] == values[i]);
+            }
+        }
+    }
+
+    /* The signals in DBC order, see test_signal.dbc. */
+    CHECK_EQ(DBC_ENGINE_ID, 0x100);
+    CHECK_EQ(DBC_ENGINE_IDE, CAN_ID_STD);
+    CHECK_EQ(DBC_BODY_ID, 0x18FF0101);
+    CHECK_EQ(DBC_BODY_IDE, CAN_ID_EXT);
+    CHECK_EQ(DBC_MIXED_DLC, 6);
+    CHECK_EQ(dbc_engine_signals[3].start, 39);
+    CHECK_EQ(dbc_engine_signals[3].order, CAN_SIGNAL_MOTOROLA);
+    CHECK_EQ(dbc_engine_signals[3].is_signed, 1);
+    CHECK(dbc_engine_signals[1].offset == -100.0f);
+}
+
+/**
+ * @brief Signals of 64 bits, Motorola unsigned and Intel signed. The values
+ *        have 24 significant bits, so they are exact in float.
+ */
+static void test_dbc_length_64(void) {
+    can_frame_t frame;
+    float value;
+
+    for (uint32_t run = 0; run < TEST_FRAME_RUNS; ++run) {
+        uint32_t shift = test_random() % 40;
+        uint64_t raw = (uint64_t)(test_random() & 0xFFFFFFU) << shift;
+
+        test_random_frame(&frame);
+        value = (float)raw;
+        CHECK(test_pack_both(dbc_body_signals, DBC_BODY_SIGNALS,
+                             dbc_body_pack, dbc_body_unpack, &value, &frame));
+        dbc_body_pack(&value, &frame);
+        CHECK_EQ(test_ref_get(frame.data, 7, 64, 1), raw);
+        CHECK_EQ(can_payload_get(&frame, CAN_SIGNAL_MOTOROLA), raw);
+
+        int64_t signed_raw = (run & 1) ? -(int64_t)raw : (int64_t)raw;
+        value = (float)signed_raw;
+        CHECK(test_pack_both(dbc_long_signals, DBC_LONG_SIGNALS,
+                             dbc_long_pack, dbc_long_unpack, &value, &frame));
+        dbc_long_pack(&value, &frame);
+        CHECK_EQ(test_ref_signed(test_ref_get(frame.data, 0, 64, 0), 64),
+                 signed_raw);
+        dbc_long_unpack(&frame, &value);
+        CHECK(value == (float)signed_raw);
+    }
+
+    /* The edges: the extremes saturate, the others are exact. */
+    static const struct {
+        float value;
+        uint64_t body;
+        uint64_t word;
+    } edges[] = {
+        {0.0f, 0, 0},
+        {-0.4f, 0, 0},
+        {-1.0f, 0, UINT64_MAX},
+        {1e30f, UINT64_MAX, INT64_MAX},
+        {-1e30f, 0, (uint64_t)INT64_MIN},
+        {9223372036854775808.0f, 0x8000000000000000ULL, INT64_MAX},
+        {-9223372036854775808.0f, 0, (uint64_t)INT64_MIN},
+        {18446744073709551616.0f, UINT64_MAX, INT64_MAX},
+    };
+
+    for (uint32_t i = 0; i < sizeof(edges) / sizeof(edges[0]); ++i) {
+        test_random_frame(&frame);
+        value = edges[i].value;
+        CHECK(test_pack_both(dbc_body_signals, DBC_BODY_SIGNALS,
+                             dbc_body_pack, dbc_body_unpack, &value, &frame));
+        dbc_body_pack(&value, &frame);
+        CHECK_EQ(test_ref_get(frame.data, 7, 64, 1), edges[i].body);
+
+        CHECK(test_pack_both(dbc_long_signals, DBC_LONG_SIGNALS,
+                             dbc_long_pack, dbc_long_unpack, &value, &frame));
+        dbc_long_pack(&value, &frame);
+        CHECK_EQ(test_ref_get(frame.data, 0, 64, 0), edges[i].word);
+    }
+}
+
+/**
+ * @}
+ */
+
+/*****************************************************************************
+ * @defgroup Rounding, saturation and invalid signals.
+ * @{
+ */
+
+/**
+ * @brief Values are rounded to the nearest raw value, half away from zero,
+ *        and saturated to the range of signal, lengths 1, 2, 8, 63 and 64.
+ */
+static void test_signal_saturation(void) {
+    static const uint8_t lengths[] = {1, 2, 8, 63, 64};
+    static const float huge[] = {1e30f, -1e30f};
+    can_frame_t frame;
+
+    for (uint8_t motorola = 0; motorola < 2; ++motorola) {
+        for (uint32_t l = 0; l < sizeof(lengths); ++l) {
+            for (uint8_t is_signed = 0; is_signed < 2; ++is_signed) {
+                uint8_t length = lengths[l];
+                can_signal_t signal = {
+                    motorola ? 7 : 0, length,
+                    motorola ? CAN_SIGNAL_MOTOROLA : CAN_SIGNAL_INTEL,
+                    is_signed, 1.0f, 0.0f};
+                uint64_t mask = CAN_SIGNAL_MASK(length);
+                uint64_t max = is_signed ? mask >> 1 : mask;
+                uint64_t min = is_signed ? (mask & ~(mask >> 1)) : 0;
+
+                for (uint32_t h = 0; h < 2; ++h) {
+                    float value = huge[h];
+                    test_random_frame(&frame);
+                    CHECK_EQ(can_signal_pack(&signal, 1, &value, &frame), 0);
+                    CHECK_EQ(test_ref_get(frame.data, signal.start, length,
+                                          motorola),
+                             (h == 0) ? max : min);
+                }
+            }
+        }
+    }
+
+    /* Half away from zero, scale and offset. */
+    static const struct {
+        float value;
+        int64_t raw;
+    } rounds[] = {
+        {2.5f, 1},   {3.4f, 1},   {6.2f, 3},  {4.0f, 2},
+        {-0.4f, -1}, {-0.6f, -1}, {0.9f, 0},  {-1.2f, -1},
+        {-2.0f, -2}, {255.0f, 127}, {-255.0f, -128},
+    };
+    can_signal_t signal = {8, 8, CAN_SIGNAL_INTEL, 1, 2.0f, 1.0f};
+
+    for (uint32_t i = 0; i < sizeof(rounds) / sizeof(rounds[0]); ++i) {
+        test_random_frame(&frame);
+        CHECK_EQ(can_signal_pack(&signal, 1, &rounds[i].value, &frame), 0);
+        CHECK_EQ(test_ref_signed(test_ref_get(frame.data, 8, 8, 0), 8),
+                 rounds[i].raw);
+    }
+
+    /* The generated pack rounds and saturates the same. */
+    float values[DBC_MIXED_SIGNALS];
+    for (uint32_t run = 0; run < TEST_FRAME_RUNS; ++run) {
+        for (uint32_t i = 0; i < DBC_MIXED_SIGNALS; ++i) {
+            values[i] = (float)(int32_t)test_random() /
+                        (float)(1U << (test_random() % 32));
+        }
+        test_random_frame(&frame);
+        CHECK(test_pack_both(dbc_mixed_signals, DBC_MIXED_SIGNALS,
+                             dbc_mixed_pack, dbc_mixed_unpack, values,
+                             &frame));
+    }
+}
+
+/**
+ * @brief Invalid signals and parameters are refused.
+ */
+static void test_signal_invalid(void) {
+    static const can_signal_t invalid[] = {
+        {0, 0, CAN_SIGNAL_INTEL, 0, 1.0f, 0.0f},
+        {60, 8, CAN_SIGNAL_INTEL, 0, 1.0f, 0.0f},
+        {1, 64, CAN_SIGNAL_INTEL, 1, 1.0f, 0.0f},
+        {56, 2, CAN_SIGNAL_MOTOROLA, 0, 1.0f, 0.0f},
+        {6, 64, CAN_SIGNAL_MOTOROLA, 0, 1.0f, 0.0f},
+    };
+    can_signal_t zero_scale = {0, 8, CAN_SIGNAL_INTEL, 0, 0.0f, 0.0f};
+    can_frame_t frame;
+    float values[2] = {1.0f, 1.0f};
+
+    test_random_frame(&frame);
+    for (uint32_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); ++i) {
+        CHECK_EQ(can_signal_unpack(&invalid[i], 1, &frame, values), 3);
+        CHECK_EQ(can_signal_pack(&invalid[i], 1, values, &frame), 3);
+    }
+
+    /* The scale is only needed to pack. */
+    CHECK_EQ(can_signal_pack(&zero_scale, 1, values, &frame), 3);
+    CHECK_EQ(can_signal_unpack(&zero_scale, 1, &frame, values), 0);
+    CHECK(values[0] == 0.0f);
+
+    CHECK_EQ(can_signal_unpack(NULL, 1, &frame, values), 3);
+    CHECK_EQ(can_signal_unpack(dbc_engine_signals, 1, NULL, values), 3);
+    CHECK_EQ(can_signal_unpack(dbc_engine_signals, 1, &frame, NULL), 3);
+    CHECK_EQ(can_signal_pack(NULL, 1, values, &frame), 3);
+    CHECK_EQ(can_signal_pack(dbc_engine_signals, 1, NULL, &frame), 3);
+    CHECK_EQ(can_signal_pack(dbc_engine_signals, 1, values, NULL), 3);
+
+    /* No signal, nothing is changed. */
+    can_frame_t copy = frame;
+    CHECK_EQ(can_signal_pack(dbc_engine_signals, 0, values, &frame), 0);
+    CHECK(memcmp(&copy, &frame, sizeof(frame)) == 0);
+}
+
+/**
+ * @}
+ */
+
+int main(void) {
+    static const test_case_t cases[] = {
+        TEST_CASE(test_payload_order),  TEST_CASE(test_signal_raw),
+        TEST_CASE(test_signal_generic), TEST_CASE(test_dbc_round_trip),
+        TEST_CASE(test_dbc_length_64),  TEST_CASE(test_signal_saturation),
+        TEST_CASE(test_signal_invalid),
+    };
+
+    return test_run("signal", cases, sizeof(cases) / sizeof(cases[0]));
+}
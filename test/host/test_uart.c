@@ -0,0 +1,962 @@
+/**
+ * @file    test_uart.c
+ * @author  Deadline039
+ * @brief   Tests of UART_STM32F1xx.c on the simulated USART and DMA.
+ * @version 3.3.3
+ * @date    2024-10-22
+ * @note    USART1 and USART2 are initialized by `usartx_init()` before every
+ *          test, the other end of each line is the peer of simulator.
+ *          USART1 always receives and transmits by DMA, USART2 does if the
+ *          variant enables it. The synchronous mode of USART1 is tested if
+ *          the variant enables it.
+ */
+
+#include <CSP_Config.h>
+
+#include "sim.h"
+#include "test.h"
+
+#include <string.h>
+
+unsigned int test_failures;
+
+/*****************************************************************************
+ * @defgroup Helpers.
+ * @{
+ */
+
+/* Baud rate of both UARTs. */
+#define TEST_BAUD         115200
+/* Slice of simulation between two reads of the receive fifo. Unit: frame. */
+#define TEST_SLICE_FRAMES 8
+/* Frames to wait after the last byte is sent. */
+#define TEST_TAIL_FRAMES  4
+/* Bytes logged of each UART. */
+#define TEST_LOG_SIZE     16384
+
+/**
+ * @brief Bytes received by USART1 and USART2, read from the receive fifo.
+ */
+static struct {
+    uint8_t data[TEST_LOG_SIZE];
+    uint32_t count;
+} test_rx[2];
+
+static UART_HandleTypeDef *const test_handle[2] = {&usart1_handle,
+                                                   &usart2_handle};
+
+/* State of `test_random()`. */
+static uint32_t test_seed;
+
+/**
+ * @brief Get a pseudo random number, the sequence restarts in `test_start()`.
+ *
+ * @return The number.
+ */
+static uint32_t test_random(void) {
+    test_seed ^= test_seed << 13;
+    test_seed ^= test_seed >> 17;
+    test_seed ^= test_seed << 5;
+    return test_seed;
+}
+
+/**
+ * @brief Fill the data to send, every byte depends on its position.
+ *
+ * @param[out] buf The buf.
+ * @param len Length of buf.
+ * @param salt Makes the data of each call different.
+ */
+static void test_pattern(uint8_t *buf, uint32_t len, uint32_t salt) {
+    for (uint32_t i = 0; i < len; ++i) {
+        buf[i] = (uint8_t)((i * 7) ^ (i >> 8) ^ salt);
+    }
+}
+
+/**
+ * @brief Read the receive fifo of both UARTs into `test_rx`, in chunks of
+ *        random size.
+ *
+ */
+static void test_drain(void) {
+    for (uint32_t u = 0; u < 2; ++u) {
+        uint32_t n;
+
+        do {
+            uint32_t space = TEST_LOG_SIZE - test_rx[u].count;
+            uint32_t chunk = 1 + test_random() % 61;
+            n = uart_dmarx_read(test_handle[u],
+                                &test_rx[u].data[test_rx[u].count],
+                                (chunk < space) ? chunk : space);
+            test_rx[u].count += n;
+        } while (n != 0);
+    }
+}
+
+/**
+ * @brief Run the simulation and read the receive fifo in slices.
+ *
+ * @param frames Time to run. Unit: frame of USART1.
+ */
+static void test_run_frames(uint32_t frames) {
+    uint64_t slice = (uint64_t)sim_uart_frame_cycles(0) * TEST_SLICE_FRAMES;
+
+    for (uint32_t i = 0; i < frames; i += TEST_SLICE_FRAMES) {
+        sim_run(slice);
+        test_drain();
+    }
+}
+
+/**
+ * @brief Run until the peers have sent all bytes, then wait the tail.
+ *
+ * @param timeout Maximum time. Unit: frame of USART1.
+ * @return Return 1 if all bytes are sent.
+ */
+static uint8_t test_settle(uint32_t timeout) {
+    for (uint32_t waited = 0; waited < timeout; waited += TEST_SLICE_FRAMES) {
+        if ((sim_uart_peer_pending(0) == 0) &&
+            (sim_uart_peer_pending(1) == 0)) {
+            test_run_frames(TEST_TAIL_FRAMES);
+            return 1;
+        }
+        test_run_frames(TEST_SLICE_FRAMES);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Get the bytes the DMA callbacks have pushed into the fifo, when a
+ *        stream of `received` bytes is in the receive buf and IDLE is not
+ *        detected yet.
+ *
+ * @param received Bytes received since the DMA is started.
+ * @param buf_size Size of receive buf.
+ * @return Bytes pushed.
+ */
+static uint32_t test_pushed(uint32_t received, uint32_t buf_size) {
+    uint32_t half = (buf_size + 1) / 2;
+    uint32_t rem = received % buf_size;
+
+    return received - rem + ((rem >= half) ? half : 0);
+}
+
+/**
+ * @brief Reset the simulator, initialize USART1 and USART2.
+ *
+ */
+static void test_start(void) {
+    usart2_deinit();
+    usart1_deinit();
+#if USART1_SYNC_ENABLE
+    usart1_sync_deinit();
+#endif /* USART1_SYNC_ENABLE */
+
+    sim_reset();
+    memset(test_rx, 0, sizeof(test_rx));
+    test_seed = 0x2545F491U;
+    sim_uart_set_rx_pin(0, CSP_GPIO_PORT(USART1_RX_PORT), USART1_RX_PIN);
+    sim_uart_set_rx_pin(1, CSP_GPIO_PORT(USART2_RX_PORT), USART2_RX_PIN);
+
+    CHECK_EQ(usart1_init(TEST_BAUD), UART_INIT_OK);
+    CHECK_EQ(usart2_init(TEST_BAUD), UART_INIT_OK);
+}
+
+/**
+ * @}
+ */
+
+/*****************************************************************************
+ * @defgroup Initialization.
+ * @{
+ */
+
+/**
+ * @brief `usartx_init()` sets the rate, enables the interrupts and starts
+ *        the reception.
+ *
+ */
+static void test_init_state(void) {
+    test_start();
+
+    CHECK_EQ(usart1_init(TEST_BAUD), UART_INITED);
+    /* fPCLK2 / 115200 = 625, fPCLK1 / 115200 = 312.5 rounded. */
+    CHECK_EQ(USART1->BRR, 625);
+    CHECK_EQ(USART2->BRR, 313);
+    CHECK_EQ(sim_uart_bit_cycles(0), 625);
+    CHECK_EQ(sim_uart_bit_cycles(1), 626);
+    CHECK_EQ(sim_uart_frame_cycles(0), 6250);
+
+    CHECK(sim_irq_enabled(USART1_IRQn));
+    CHECK(sim_irq_enabled(DMA1_Channel5_IRQn));
+    CHECK(sim_irq_enabled(DMA1_Channel4_IRQn));
+    CHECK_EQ(usart1_handle.RxState, HAL_UART_STATE_BUSY_RX);
+    CHECK_EQ(DMA1_Channel5->CNDTR, USART1_RX_DMA_BUF_SIZE);
+    CHECK(DMA1_Channel5->CCR & DMA_CCR_CIRC);
+    CHECK(USART1->CR1 & USART_CR1_IDLEIE);
+    CHECK(USART1->CR3 & USART_CR3_DMAR);
+
+    CHECK_EQ(uart_dmarx_get_buf_size(&usart1_handle), USART1_RX_DMA_BUF_SIZE);
+    CHECK_EQ(uart_dmarx_get_fifo_size(&usart1_handle),
+             USART1_RX_DMA_FIFO_SIZE);
+    CHECK_EQ(uart_damtx_get_buf_szie(&usart1_handle), USART1_TX_DMA_BUF_SIZE);
+
+    CHECK_EQ(usart1_deinit(), UART_DEINIT_OK);
+    CHECK_EQ(usart1_deinit(), UART_NO_INIT);
+    CHECK(!(USART1->CR1 & USART_CR1_UE));
+    CHECK_EQ(usart1_init(TEST_BAUD), UART_INIT_OK);
+}
+
+/**
+ * @}
+ */
+
+/*****************************************************************************
+ * @defgroup Reception by DMA.
+ * @{
+ */
+
+/**
+ * @brief A short message is delivered by IDLE, not before.
+ *
+ */
+static void test_rx_idle(void) {
+    test_start();
+    uint8_t data[10];
+    uint64_t frame = sim_uart_frame_cycles(0);
+
+    test_pattern(data, sizeof(data), 1);
+    CHECK_EQ(sim_uart_peer_send(0, data, sizeof(data)), sizeof(data));
+
+    sim_run(frame * sizeof(data) + frame / 2);
+    test_drain();
+    CHECK_EQ(test_rx[0].count,
+             test_pushed(sizeof(data), USART1_RX_DMA_BUF_SIZE));
+    CHECK_EQ(sim_uart_get_stats(0)->idle, 0);
+
+    sim_run(frame);
+    test_drain();
+    CHECK_EQ(test_rx[0].count, sizeof(data));
+    CHECK(memcmp(test_rx[0].data, data, sizeof(data)) == 0);
+    CHECK_EQ(sim_uart_get_stats(0)->idle, 1);
+    CHECK_EQ(sim_uart_get_stats(0)->rx_dma, sizeof(data));
+    CHECK(sim_irq_count(USART1_IRQn) >= 1);
+}
+
+/**
+ * @brief A back-to-back stream is delivered at every half and full of the
+ *        receive buf, through the wraps of circular DMA.
+ *
+ */
+static void test_rx_half_full(void) {
+    test_start();
+    static uint8_t data[3 * USART1_RX_DMA_BUF_SIZE + 5];
+    uint64_t frame = sim_uart_frame_cycles(0);
+    uint32_t wrong = 0;
+
+    test_pattern(data, sizeof(data), 2);
+    CHECK_EQ(sim_uart_peer_send(0, data, sizeof(data)), sizeof(data));
+
+    uint64_t start = sim_now();
+    for (uint32_t k = 1; k <= sizeof(data); ++k) {
+        /* Shortly after the end of byte k, before the next one. */
+        sim_run(start + k * frame + frame / 8 - sim_now());
+        test_drain();
+        wrong += (test_rx[0].count != test_pushed(k, USART1_RX_DMA_BUF_SIZE));
+    }
+    CHECK_EQ(wrong, 0);
+
+    test_run_frames(TEST_TAIL_FRAMES);
+    CHECK_EQ(test_rx[0].count, sizeof(data));
+    CHECK(memcmp(test_rx[0].data, data, sizeof(data)) == 0);
+    CHECK_EQ(sim_uart_get_stats(0)->idle, 1);
+}
+
+/**
+ * @brief Bursts of random length with random gaps are delivered in order.
+ *
+ */
+static void test_rx_bursts(void) {
+    test_start();
+    static uint8_t data[SIM_UART_PEER_QUEUE];
+    uint32_t len = 40 * USART1_RX_DMA_BUF_SIZE + 13;
+    len = (len > sizeof(data)) ? (uint32_t)sizeof(data) : len;
+
+    test_pattern(data, len, 3);
+    for (uint32_t sent = 0; sent < len;) {
+        uint32_t burst = 1 + test_random() % (2 * USART1_RX_DMA_BUF_SIZE);
+        burst = (burst > len - sent) ? (len - sent) : burst;
+
+        /* Up to 3 frames, a gap of one frame or more sets IDLE. */
+        sim_uart_peer_idle(0, test_random() % 30);
+        sent += sim_uart_peer_send(0, &data[sent], burst);
+    }
+
+    CHECK(test_settle(2 * len));
+    CHECK_EQ(test_rx[0].count, len);
+    CHECK(memcmp(test_rx[0].data, data, len) == 0);
+    CHECK_EQ(sim_uart_get_stats(0)->rx_overrun, 0);
+    CHECK(sim_uart_get_stats(0)->idle > 1);
+}
+
+/**
+ * @brief The fifo keeps the oldest data when it is full, the reception goes
+ *        on after it is read.
+ *
+ */
+static void test_rx_fifo_full(void) {
+    test_start();
+    static uint8_t data[USART1_RX_DMA_FIFO_SIZE + 2 * USART1_RX_DMA_BUF_SIZE];
+    uint8_t tail[10];
+
+    test_pattern(data, sizeof(data), 4);
+    test_pattern(tail, sizeof(tail), 5);
+    CHECK_EQ(sim_uart_peer_send(0, data, sizeof(data)), sizeof(data));
+    sim_run((uint64_t)sim_uart_frame_cycles(0) * (sizeof(data) + 2));
+
+    test_drain();
+    CHECK_EQ(test_rx[0].count, USART1_RX_DMA_FIFO_SIZE);
+    CHECK(memcmp(test_rx[0].data, data, USART1_RX_DMA_FIFO_SIZE) == 0);
+
+    test_rx[0].count = 0;
+    CHECK_EQ(sim_uart_peer_send(0, tail, sizeof(tail)), sizeof(tail));
+    CHECK(test_settle(100));
+    CHECK_EQ(test_rx[0].count, sizeof(tail));
+    CHECK(memcmp(test_rx[0].data, tail, sizeof(tail)) == 0);
+}
+
+/**
+ * @brief The receive buf and fifo are resized while a stream is received,
+ *        no byte is lost or reordered.
+ *
+ */
+static void test_rx_resize(void) {
+    test_start();
+
+    CHECK_EQ(uart_dmarx_resize_fifo(&usart1_handle, 0, 256), 3);
+    CHECK_EQ(uart_dmarx_resize_fifo(&usart1_handle, 70000, 256), 3);
+    CHECK_EQ(uart_dmarx_resize_fifo(&usart1_handle, 64, 100), 3);
+
+#if CSP_DMA_BUF_STATIC
+    CHECK_EQ(uart_dmarx_resize_fifo(&usart1_handle, 64, 256), 2);
+#else  /* CSP_DMA_BUF_STATIC */
+    static const uint32_t sizes[][2] = {
+        {33, 512}, {64, 1024}, {300, 4096}, {17, 512}, {1, 512},
+        {USART1_RX_DMA_BUF_SIZE, USART1_RX_DMA_FIFO_SIZE},
+    };
+    static uint8_t data[6000];
+    uint64_t frame = sim_uart_frame_cycles(0);
+
+    test_pattern(data, sizeof(data), 6);
+    CHECK_EQ(sim_uart_peer_send(0, data, sizeof(data)), sizeof(data));
+
+    for (uint32_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        test_run_frames(800);
+        /* At any time in a frame. */
+        sim_run(test_random() % frame);
+
+        CHECK_EQ(uart_dmarx_resize_fifo(&usart1_handle, sizes[i][0],
+                                        sizes[i][1]),
+                 0);
+        CHECK_EQ(uart_dmarx_get_buf_size(&usart1_handle), sizes[i][0]);
+        CHECK_EQ(uart_dmarx_get_fifo_size(&usart1_handle), sizes[i][1]);
+        CHECK_EQ(DMA1_Channel5->CNDTR, sizes[i][0]);
+    }
+
+    CHECK(test_settle(sizeof(data)));
+    CHECK_EQ(test_rx[0].count, sizeof(data));
+    CHECK(memcmp(test_rx[0].data, data, sizeof(data)) == 0);
+    CHECK_EQ(sim_uart_get_stats(0)->rx_overrun, 0);
+
+    /* Uninitialized: the sizes are used by the next init. */
+    CHECK_EQ(usart1_deinit(), UART_DEINIT_OK);
+    CHECK_EQ(uart_dmarx_resize_fifo(&usart1_handle, 48, 128), 0);
+    CHECK_EQ(usart1_init(TEST_BAUD), UART_INIT_OK);
+    CHECK_EQ(DMA1_Channel5->CNDTR, 48);
+    CHECK_EQ(uart_dmarx_get_fifo_size(&usart1_handle), 128);
+
+    CHECK_EQ(usart1_deinit(), UART_DEINIT_OK);
+    CHECK_EQ(uart_dmarx_resize_fifo(&usart1_handle, USART1_RX_DMA_BUF_SIZE,
+                                    USART1_RX_DMA_FIFO_SIZE),
+             0);
+#endif /* CSP_DMA_BUF_STATIC */
+}
+
+/**
+ * @brief Send a stream, the bytes at `at` carry `flags`.
+ *
+ * @param data The data.
+ * @param len Length of data.
+ * @param at Positions of the bytes with errors.
+ * @param flags Errors of each position.
+ * @param count Number of positions.
+ */
+static void test_send_with_errors(const uint8_t *data, uint32_t len,
+                                  const uint32_t *at, const uint32_t *flags,
+                                  uint32_t count) {
+    uint32_t sent = 0;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        sent += sim_uart_peer_send(0, &data[sent], at[i] - sent);
+        sim_uart_inject_error(0, flags[i]);
+    }
+    sim_uart_peer_send(0, &data[sent], len - sent);
+}
+
+/**
+ * @brief Framing, noise and overrun errors restart the reception, all other
+ *        bytes are delivered in order.
+ *
+ */
+static void test_rx_errors(void) {
+    test_start();
+    static uint8_t data[3 * USART1_RX_DMA_BUF_SIZE + 10];
+    static uint8_t expect[sizeof(data)];
+    const uint32_t at[] = {
+        USART1_RX_DMA_BUF_SIZE / 3,
+        USART1_RX_DMA_BUF_SIZE + 1,
+        2 * USART1_RX_DMA_BUF_SIZE - 1,
+        2 * USART1_RX_DMA_BUF_SIZE + (USART1_RX_DMA_BUF_SIZE + 1) / 2,
+    };
+    const uint32_t flags[] = {USART_SR_FE, USART_SR_NE, USART_SR_ORE,
+                              USART_SR_FE | USART_SR_NE};
+
+    test_pattern(data, sizeof(data), 7);
+    test_send_with_errors(data, sizeof(data), at, flags, 4);
+
+    /* The byte of overrun is lost. */
+    memcpy(expect, data, at[2]);
+    memcpy(&expect[at[2]], &data[at[2] + 1], sizeof(data) - at[2] - 1);
+
+    CHECK(test_settle(sizeof(data) * 2));
+    CHECK_EQ(test_rx[0].count, sizeof(data) - 1);
+    CHECK(memcmp(test_rx[0].data, expect, sizeof(data) - 1) == 0);
+    CHECK_EQ(sim_uart_get_stats(0)->rx_errors, 3);
+    CHECK_EQ(sim_uart_get_stats(0)->rx_overrun, 1);
+
+    /* The reception is running again. */
+    CHECK_EQ(usart1_handle.RxState, HAL_UART_STATE_BUSY_RX);
+    CHECK(USART1->CR3 & USART_CR3_DMAR);
+    CHECK(!(USART1->SR &
+            (USART_SR_PE | USART_SR_FE | USART_SR_NE | USART_SR_ORE)));
+}
+
+/**
+ * @brief The peer is 2% off the rate: received well. 5% off: every byte has
+ *        a framing error, the data is still delivered.
+ *
+ */
+static void test_rx_rate(void) {
+    test_start();
+    uint8_t data[100];
+
+    test_pattern(data, sizeof(data), 8);
+    sim_uart_set_peer_rate(0, TEST_BAUD * 102 / 100);
+    CHECK_EQ(sim_uart_peer_send(0, data, sizeof(data)), sizeof(data));
+    CHECK(test_settle(400));
+    CHECK_EQ(test_rx[0].count, sizeof(data));
+    CHECK_EQ(sim_uart_get_stats(0)->rx_errors, 0);
+
+    test_rx[0].count = 0;
+    sim_uart_set_peer_rate(0, TEST_BAUD * 105 / 100);
+    CHECK_EQ(sim_uart_peer_send(0, data, sizeof(data)), sizeof(data));
+    CHECK(test_settle(400));
+    CHECK_EQ(test_rx[0].count, sizeof(data));
+    CHECK(memcmp(test_rx[0].data, data, sizeof(data)) == 0);
+    CHECK_EQ(sim_uart_get_stats(0)->rx_errors, sizeof(data));
+}
+
+/**
+ * @brief USART1 and USART2 receive different streams at the same time.
+ *
+ */
+static void test_rx_two_uarts(void) {
+#if USART2_RX_DMA
+    test_start();
+    static uint8_t data[2][1500];
+
+    for (uint32_t u = 0; u < 2; ++u) {
+        test_pattern(data[u], sizeof(data[u]), 9 + u);
+        sim_uart_peer_idle(u, 3 * u);
+        CHECK_EQ(sim_uart_peer_send(u, data[u], sizeof(data[u])),
+                 sizeof(data[u]));
+    }
+
+    CHECK(test_settle(2 * sizeof(data[0])));
+    for (uint32_t u = 0; u < 2; ++u) {
+        CHECK_EQ(test_rx[u].count, sizeof(data[u]));
+        CHECK(memcmp(test_rx[u].data, data[u], sizeof(data[u])) == 0);
+    }
+#endif /* USART2_RX_DMA */
+}
+
+/**
+ * @}
+ */
+
+/*****************************************************************************
+ * @defgroup Transmission.
+ * @{
+ */
+
+/**
+ * @brief The send buf is truncated when full, the DMA sends it back-to-back,
+ *        the UART is ready after TC.
+ *
+ */
+static void test_tx_dma(void) {
+    test_start();
+    static uint8_t data[USART1_TX_DMA_BUF_SIZE + 44];
+    static uint8_t got[sizeof(data)];
+    uint64_t frame = sim_uart_frame_cycles(0);
+
+    test_pattern(data, sizeof(data), 11);
+    CHECK_EQ(uart_dmatx_write(&usart1_handle, data, sizeof(data)),
+             USART1_TX_DMA_BUF_SIZE);
+    CHECK_EQ(uart_dmatx_write(&usart1_handle, data, 1), 0);
+    CHECK_EQ(uart_dmatx_send(&usart1_handle), USART1_TX_DMA_BUF_SIZE);
+    CHECK_EQ(uart_dmatx_send(&usart1_handle), 0);
+    CHECK_EQ(uart_dmatx_resize_buf(&usart1_handle, 64), 3);
+
+    sim_run(frame * (USART1_TX_DMA_BUF_SIZE - 1));
+    CHECK_EQ(sim_uart_peer_received(0), USART1_TX_DMA_BUF_SIZE - 1);
+    sim_run(frame);
+    CHECK_EQ(sim_uart_peer_received(0), USART1_TX_DMA_BUF_SIZE);
+    CHECK_EQ(usart1_handle.gState, HAL_UART_STATE_READY);
+    CHECK_EQ(sim_uart_get_stats(0)->tx_dma, USART1_TX_DMA_BUF_SIZE);
+
+    CHECK_EQ(sim_uart_peer_recv(0, got, sizeof(got)), USART1_TX_DMA_BUF_SIZE);
+    CHECK(memcmp(got, data, USART1_TX_DMA_BUF_SIZE) == 0);
+
+#if CSP_DMA_BUF_STATIC
+    CHECK_EQ(uart_dmatx_resize_buf(&usart1_handle, 64), 2);
+#else  /* CSP_DMA_BUF_STATIC */
+    CHECK_EQ(uart_dmatx_resize_buf(&usart1_handle, 0), 4);
+    CHECK_EQ(uart_dmatx_resize_buf(&usart1_handle, 64), 0);
+    CHECK_EQ(uart_damtx_get_buf_szie(&usart1_handle), 64);
+    CHECK_EQ(uart_dmatx_write(&usart1_handle, data, sizeof(data)), 64);
+    CHECK_EQ(uart_dmatx_send(&usart1_handle), 64);
+    sim_run(frame * 65);
+    CHECK_EQ(sim_uart_peer_recv(0, got, sizeof(got)), 64);
+    CHECK(memcmp(got, data, 64) == 0);
+    CHECK_EQ(uart_dmatx_resize_buf(&usart1_handle, USART1_TX_DMA_BUF_SIZE), 0);
+#endif /* CSP_DMA_BUF_STATIC */
+}
+
+/**
+ * @brief The second send waits for the first one, the bytes are in order
+ *        with no gap on line.
+ *
+ */
+static void test_tx_back_to_back(void) {
+    test_start();
+    uint8_t data[2][100];
+    uint8_t got[sizeof(data)];
+    uint64_t frame = sim_uart_frame_cycles(0);
+    uint64_t start = sim_now();
+
+    for (uint32_t i = 0; i < 2; ++i) {
+        test_pattern(data[i], sizeof(data[i]), 12 + i);
+        CHECK_EQ(uart_dmatx_write(&usart1_handle, data[i], sizeof(data[i])),
+                 sizeof(data[i]));
+        CHECK_EQ(uart_dmatx_send(&usart1_handle), sizeof(data[i]));
+    }
+
+    /* The first send is on line while the second one waits. */
+    CHECK(sim_now() - start >= frame * sizeof(data[0]));
+
+    sim_run(frame * (sizeof(data[1]) + 1));
+    CHECK_EQ(sim_uart_peer_recv(0, got, sizeof(got)), sizeof(got));
+    CHECK(memcmp(got, data, sizeof(data)) == 0);
+}
+
+/**
+ * @brief `uart_printf()` sends by DMA, or by blocking HAL without DMA.
+ *
+ */
+static void test_printf(void) {
+    test_start();
+    char got[32] = {0};
+
+    for (uint32_t u = 0; u < 2; ++u) {
+        CHECK_EQ(uart_printf(test_handle[u], "x=%d,%s\n", 42, "ok"), 8);
+        test_run_frames(10);
+        CHECK_EQ(sim_uart_peer_recv(u, got, sizeof(got) - 1), 8);
+        CHECK(strcmp(got, "x=42,ok\n") == 0);
+    }
+
+#if !USART2_TX_DMA
+    /* Blocking: sent before return. */
+    uint64_t start = sim_now();
+    CHECK_EQ(uart_printf(&usart2_handle, "%s", "abcd"), 4);
+    CHECK(sim_now() - start >= 4 * (uint64_t)sim_uart_frame_cycles(1));
+    CHECK_EQ(sim_uart_peer_received(1), 12);
+#endif /* !USART2_TX_DMA */
+}
+
+/**
+ * @brief `uart_scanf()` parses a message, the longer string printed before
+ *        is not parsed with it.
+ *
+ */
+static void test_scanf(void) {
+    test_start();
+    char word[32];
+    int value = 0;
+
+    for (uint32_t u = 0; u < 2; ++u) {
+        CHECK_EQ(uart_printf(test_handle[u], "%s", "abcdefghijkl"), 12);
+        test_run_frames(16);
+
+        CHECK_EQ(sim_uart_peer_send(u, "12 x", 4), 4);
+        CHECK_EQ(uart_scanf(test_handle[u], "%d %31s", &value, word), 2);
+        CHECK_EQ(value, 12);
+        CHECK(strcmp(word, "x") == 0);
+    }
+}
+
+/**
+ * @}
+ */
+
+/*****************************************************************************
+ * @defgroup Auto baud.
+ * @{
+ */
+
+/**
+ * @brief Detect the rate of peer by 0x55 after some bytes, then receive the
+ *        data after it.
+ *
+ * @param rate Baud rate of peer.
+ * @param prefix The bytes before 0x55, not received.
+ * @param prefix_len Length of prefix.
+ * @param busy USART2 receives at the same time, its interrupts are served
+ *             between the edges.
+ */
+static void test_autobaud_at(uint32_t rate, const uint8_t *prefix,
+                             uint32_t prefix_len, uint8_t busy) {
+    static const uint8_t sync_byte = 0x55;
+    uint32_t expect = SIM_HCLK_FREQ / rate;
+    uint8_t data[24];
+    uint8_t data2[64];
+
+    test_start();
+    CHECK_EQ(usart1_deinit(), UART_DEINIT_OK);
+
+    test_pattern(data, sizeof(data), rate);
+    test_pattern(data2, sizeof(data2), 7);
+    sim_uart_set_peer_rate(0, rate);
+
+    for (uint32_t i = 0; i < prefix_len; ++i) {
+        sim_uart_peer_idle(0, 12);
+        sim_uart_peer_send(0, &prefix[i], 1);
+    }
+    sim_uart_peer_idle(0, 12);
+    sim_uart_peer_send(0, &sync_byte, 1);
+    /* Time for the rest of initialization. */
+    sim_uart_peer_idle(0, 20);
+    sim_uart_peer_send(0, data, sizeof(data));
+
+    if (busy) {
+        CHECK_EQ(sim_uart_peer_send(1, data2, sizeof(data2)), sizeof(data2));
+    }
+    CHECK_EQ(usart1_init(UART_AUTO_BAUD), UART_INIT_OK);
+
+    uint32_t bit = sim_uart_bit_cycles(0);
+    uint32_t diff = (bit > expect) ? (bit - expect) : (expect - bit);
+    CHECK(diff * 100 <= expect);
+
+    CHECK(test_settle(512));
+    CHECK_EQ(sim_uart_get_stats(0)->rx_dropped, prefix_len + 1);
+    CHECK_EQ(test_rx[0].count, sizeof(data));
+    CHECK(memcmp(test_rx[0].data, data, sizeof(data)) == 0);
+    CHECK_EQ(sim_uart_get_stats(0)->rx_errors, 0);
+
+    if (busy) {
+        CHECK_EQ(test_rx[1].count, sizeof(data2));
+        CHECK(memcmp(test_rx[1].data, data2, sizeof(data2)) == 0);
+    }
+}
+
+/**
+ * @brief The rate is detected from slow to fast, the fraction of divider is
+ *        kept in `BRR`.
+ *
+ */
+static void test_autobaud(void) {
+    test_autobaud_at(9600, NULL, 0, USART2_RX_DMA);
+    test_autobaud_at(115200, NULL, 0, USART2_RX_DMA);
+    test_autobaud_at(460800, NULL, 0, 0);
+    /* 72 MHz / 250000 = 288, no rounding. */
+    test_autobaud_at(250000, NULL, 0, 0);
+    CHECK_EQ(USART1->BRR, 288);
+}
+
+/**
+ * @brief The bytes with uneven edges before 0x55 are dropped.
+ *
+ */
+static void test_autobaud_garbage(void) {
+    static const uint8_t garbage[] = {0xF0, 0x00, 0x57, 0xD5};
+
+    test_autobaud_at(57600, garbage, sizeof(garbage), 0);
+}
+
+/**
+ * @}
+ */
+
+#if USART1_SYNC_ENABLE
+
+/*****************************************************************************
+ * @defgroup Synchronous mode.
+ * @{
+ */
+
+/* Rate of synchronous mode, CK is 1 MHz. */
+#define TEST_SYNC_BAUD 1000000
+
+/**
+ * @brief Whether the synchronous transfer is done.
+ *
+ * @return Return 1 if done.
+ */
+static uint8_t test_sync_ready(void) {
+    return HAL_USART_GetState(&usart1_sync_handle) == HAL_USART_STATE_READY;
+}
+
+/**
+ * @brief Switch USART1 to synchronous mode.
+ *
+ */
+static void test_sync_start(void) {
+    test_start();
+    CHECK_EQ(usart1_deinit(), UART_DEINIT_OK);
+    CHECK_EQ(usart1_sync_init(TEST_SYNC_BAUD, USART_POLARITY_HIGH,
+                              USART_PHASE_2EDGE),
+             UART_INIT_OK);
+}
+
+/**
+ * @brief Synchronous and asynchronous mode exclude each other, the CK is
+ *        configured, the circular receive is restored after.
+ *
+ */
+static void test_sync_init(void) {
+    test_start();
+
+    CHECK_EQ(usart1_sync_init(TEST_SYNC_BAUD, USART_POLARITY_LOW,
+                              USART_PHASE_1EDGE),
+             UART_INITED);
+    CHECK_EQ(usart1_deinit(), UART_DEINIT_OK);
+    CHECK_EQ(usart1_sync_init(TEST_SYNC_BAUD, USART_POLARITY_HIGH,
+                              USART_PHASE_2EDGE),
+             UART_INIT_OK);
+    CHECK_EQ(usart1_sync_init(TEST_SYNC_BAUD, USART_POLARITY_HIGH,
+                              USART_PHASE_2EDGE),
+             UART_INITED);
+    CHECK_EQ(usart1_init(TEST_BAUD), UART_INITED);
+    CHECK_EQ(usart1_deinit(), UART_NO_INIT);
+
+    CHECK(test_sync_ready());
+    CHECK_EQ(USART1->BRR, 72);
+    CHECK_EQ(USART1->CR2 & (USART_CR2_CLKEN | USART_CR2_CPOL |
+                            USART_CR2_CPHA | USART_CR2_LBCL),
+             USART_CR2_CLKEN | USART_CR2_CPOL | USART_CR2_CPHA |
+                 USART_CR2_LBCL);
+    CHECK_EQ(USART1->CR1 & (USART_CR1_TE | USART_CR1_RE | USART_CR1_UE),
+             USART_CR1_TE | USART_CR1_RE | USART_CR1_UE);
+    CHECK(!(DMA1_Channel5->CCR & DMA_CCR_CIRC));
+
+    CHECK_EQ(usart1_sync_deinit(), UART_DEINIT_OK);
+    CHECK_EQ(usart1_sync_deinit(), UART_NO_INIT);
+    CHECK_EQ(usart1_init(TEST_BAUD), UART_INIT_OK);
+    CHECK(!(USART1->CR2 & USART_CR2_CLKEN));
+    CHECK(DMA1_Channel5->CCR & DMA_CCR_CIRC);
+
+    /* The asynchronous mode works as before. */
+    CHECK_EQ(sim_uart_peer_send(0, "abc", 3), 3);
+    test_run_frames(16);
+    CHECK_EQ(test_rx[0].count, 3);
+    CHECK(memcmp(test_rx[0].data, "abc", 3) == 0);
+}
+
+/**
+ * @brief Full duplex transfer: the peer gets the bytes sent, the bytes it
+ *        shifts out are received at the same time.
+ *
+ */
+static void test_sync_transfer(void) {
+    uint8_t tx[200], reply[200], rx[200], got[200];
+    uint64_t frame;
+
+    test_sync_start();
+    frame = sim_uart_frame_cycles(0);
+    test_pattern(tx, sizeof(tx), 3);
+    test_pattern(reply, sizeof(reply), 0x5A);
+
+    for (uint32_t len = 1; len <= sizeof(tx); len += 57) {
+        memset(rx, 0, sizeof(rx));
+        CHECK_EQ(sim_uart_peer_send(0, reply, len), len);
+
+        CHECK_EQ(usart_sync_transfer(&usart1_sync_handle, tx, rx, len), 0);
+        CHECK(sim_run_until(test_sync_ready, frame * (len + 4)));
+        CHECK(memcmp(rx, reply, len) == 0);
+
+        CHECK_EQ(sim_uart_peer_recv(0, got, sizeof(got)), len);
+        CHECK(memcmp(got, tx, len) == 0);
+        CHECK_EQ(sim_uart_peer_pending(0), 0);
+    }
+
+    /* Nothing queued by peer, the line is high. */
+    CHECK_EQ(usart_sync_transfer(&usart1_sync_handle, tx, rx, 8), 0);
+    CHECK(sim_run_until(test_sync_ready, frame * 12));
+    for (uint32_t i = 0; i < 8; ++i) {
+        CHECK_EQ(rx[i], 0xFF);
+    }
+
+    CHECK_EQ(sim_uart_get_stats(0)->rx_overrun, 0);
+    CHECK_EQ(sim_uart_get_stats(0)->tx_dma,
+             sim_uart_get_stats(0)->rx_dma);
+}
+
+/**
+ * @brief Transmit only, the bytes clocked in are discarded, the next
+ *        transfer receives only its own bytes.
+ *
+ */
+static void test_sync_transmit(void) {
+    uint8_t tx[64], rx[8], got[64];
+    uint64_t frame;
+
+    test_sync_start();
+    frame = sim_uart_frame_cycles(0);
+    test_pattern(tx, sizeof(tx), 9);
+
+    CHECK_EQ(sim_uart_peer_send(0, "0123456789", 10), 10);
+    CHECK_EQ(usart_sync_transfer(&usart1_sync_handle, tx, NULL, sizeof(tx)),
+             0);
+    CHECK_EQ(HAL_USART_GetState(&usart1_sync_handle),
+             HAL_USART_STATE_BUSY_TX);
+    CHECK(sim_run_until(test_sync_ready, frame * (sizeof(tx) + 4)));
+    CHECK_EQ(sim_uart_peer_recv(0, got, sizeof(got)), sizeof(tx));
+    CHECK(memcmp(got, tx, sizeof(tx)) == 0);
+    CHECK_EQ(sim_uart_peer_pending(0), 0);
+
+    CHECK_EQ(sim_uart_peer_send(0, "abcdefgh", 8), 8);
+    CHECK_EQ(usart_sync_transfer(&usart1_sync_handle, tx, rx, sizeof(rx)), 0);
+    CHECK(sim_run_until(test_sync_ready, frame * 12));
+    CHECK(memcmp(rx, "abcdefgh", 8) == 0);
+}
+
+/**
+ * @brief The transfers are staged in the DMA buffers: the buffers of caller
+ *        can be reused after the call, the received data is copied when
+ *        done, the length is limited by the DMA buffers. The buffers are
+ *        allocated again after switching the mode.
+ *
+ */
+static void test_sync_staging(void) {
+    uint8_t tx[USART1_TX_DMA_BUF_SIZE + 1], sent[64], rx[64], got[64];
+    uint64_t frame;
+
+    test_sync_start();
+    frame = sim_uart_frame_cycles(0);
+    test_pattern(sent, sizeof(sent), 11);
+    memcpy(tx, sent, sizeof(sent));
+    memset(rx, 0xEE, sizeof(rx));
+
+    CHECK_EQ(sim_uart_peer_send(0, "0123456789", 10), 10);
+    CHECK_EQ(usart_sync_transfer(&usart1_sync_handle, tx, rx, 10), 0);
+    memset(tx, 0, sizeof(tx));
+    CHECK_EQ(HAL_USART_GetState(&usart1_sync_handle),
+             HAL_USART_STATE_BUSY_TX_RX);
+    CHECK_EQ(rx[0], 0xEE);
+
+    CHECK(sim_run_until(test_sync_ready, frame * 14));
+    CHECK(memcmp(rx, "0123456789", 10) == 0);
+    CHECK_EQ(rx[10], 0xEE);
+    CHECK_EQ(sim_uart_peer_recv(0, got, sizeof(got)), 10);
+    CHECK(memcmp(got, sent, 10) == 0);
+
+    /* Longer than the send buf. */
+    CHECK_EQ(usart_sync_transfer(&usart1_sync_handle, tx, rx, sizeof(tx)), 3);
+    CHECK_EQ(usart_sync_transfer(&usart1_sync_handle, tx, NULL, sizeof(tx)),
+             3);
+    CHECK(test_sync_ready());
+    CHECK_EQ(sim_uart_get_stats(0)->tx_bytes, 10);
+
+    /* The buffers are released and allocated again. */
+    CHECK_EQ(usart1_sync_deinit(), UART_DEINIT_OK);
+    CHECK_EQ(usart1_init(TEST_BAUD), UART_INIT_OK);
+    CHECK_EQ(usart1_deinit(), UART_DEINIT_OK);
+    CHECK_EQ(usart1_sync_init(TEST_SYNC_BAUD, USART_POLARITY_HIGH,
+                              USART_PHASE_2EDGE),
+             UART_INIT_OK);
+
+    memcpy(tx, sent, sizeof(sent));
+    CHECK_EQ(usart_sync_transfer(&usart1_sync_handle, tx, NULL, sizeof(sent)),
+             0);
+    memset(tx, 0, sizeof(tx));
+    CHECK(sim_run_until(test_sync_ready, frame * (sizeof(sent) + 4)));
+    CHECK_EQ(sim_uart_peer_recv(0, got, sizeof(got)), sizeof(sent));
+    CHECK(memcmp(got, sent, sizeof(sent)) == 0);
+
+    CHECK_EQ(sim_uart_peer_send(0, "abc", 3), 3);
+    CHECK_EQ(usart_sync_transfer(&usart1_sync_handle, sent, rx, 3), 0);
+    CHECK(sim_run_until(test_sync_ready, frame * 7));
+    CHECK(memcmp(rx, "abc", 3) == 0);
+}
+
+/**
+ * @brief The invalid parameters and a transfer in progress are rejected.
+ *
+ */
+static void test_sync_reject(void) {
+    uint8_t tx[16] = {0}, rx[16];
+
+    test_sync_start();
+
+    CHECK_EQ(usart_sync_transfer(NULL, tx, rx, sizeof(tx)), 3);
+    CHECK_EQ(usart_sync_transfer(&usart1_sync_handle, NULL, rx, sizeof(tx)),
+             3);
+    CHECK_EQ(usart_sync_transfer(&usart1_sync_handle, tx, rx, 0), 3);
+
+    CHECK_EQ(usart_sync_transfer(&usart1_sync_handle, tx, rx, sizeof(tx)), 0);
+    CHECK_EQ(usart_sync_transfer(&usart1_sync_handle, tx, rx, sizeof(tx)), 2);
+    CHECK_EQ(usart_sync_transfer(&usart1_sync_handle, tx, NULL, sizeof(tx)),
+             2);
+    CHECK(sim_run_until(test_sync_ready, sim_uart_frame_cycles(0) * 20));
+    CHECK_EQ(sim_uart_get_stats(0)->tx_bytes, sizeof(tx));
+
+    CHECK_EQ(usart1_sync_deinit(), UART_DEINIT_OK);
+    CHECK_EQ(usart_sync_transfer(&usart1_sync_handle, tx, rx, sizeof(tx)), 2);
+}
+
+/**
+ * @}
+ */
+
+#endif /* USART1_SYNC_ENABLE */
+
+int main(void) {
+    static const test_case_t cases[] = {
+        TEST_CASE(test_init_state),   TEST_CASE(test_rx_idle),
+        TEST_CASE(test_rx_half_full), TEST_CASE(test_rx_bursts),
+        TEST_CASE(test_rx_fifo_full), TEST_CASE(test_rx_resize),
+        TEST_CASE(test_rx_errors),    TEST_CASE(test_rx_rate),
+        TEST_CASE(test_rx_two_uarts), TEST_CASE(test_tx_dma),
+        TEST_CASE(test_tx_back_to_back), TEST_CASE(test_printf),
+        TEST_CASE(test_scanf),        TEST_CASE(test_autobaud),
+        TEST_CASE(test_autobaud_garbage),
+#if USART1_SYNC_ENABLE
+        TEST_CASE(test_sync_init),    TEST_CASE(test_sync_transfer),
+        TEST_CASE(test_sync_transmit), TEST_CASE(test_sync_staging),
+        TEST_CASE(test_sync_reject),
+#endif /* USART1_SYNC_ENABLE */
+    };
+
+    return test_run("uart", cases, sizeof(cases) / sizeof(cases[0]));
+}